@@ -0,0 +1,125 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Checks that frustvis' csBoxFrustumTester::TestBoxes() returns the same
+   visibility and clip masks as csIntersect3::BoxFrustum(), with and without
+   SSE, for random boxes and frustums. */
+
+#include "cssysdef.h"
+#include "csgeom/math3d.h"
+#include "csutil/randomgen.h"
+#include "csutil/sysfunc.h"
+#include "plugins/culling/frustvis/boxfrust.h"
+
+CS_IMPLEMENT_APPLICATION
+
+static const int numFrustums = 2000;
+static const int boxesPerFrustum = 500;
+static const int numPlanes = 6;
+
+static float RandomRange (csRandomGen& rng, float min, float max)
+{
+  return min + rng.Get () * (max - min);
+}
+
+static csVector3 RandomVector (csRandomGen& rng, float min, float max)
+{
+  return csVector3 (RandomRange (rng, min, max), RandomRange (rng, min, max),
+    RandomRange (rng, min, max));
+}
+
+/// Compare one batch of boxes; returns the number of differing boxes
+static int CheckBatch (const csBox3* const* boxes, int num,
+  const csPlane3* frustum, uint32 inClipMask, bool useSIMD,
+  int& numVisible, int& numPartial)
+{
+  uint32 masks[csBoxFrustumTester::MAX_BOXES];
+  uint32 visible = csBoxFrustumTester::TestBoxes (boxes, num, frustum,
+    inClipMask, masks, useSIMD);
+  int failed = 0;
+  for (int i = 0; i < num; i++)
+  {
+    uint32 refMask;
+    bool refVisible = csIntersect3::BoxFrustum (*boxes[i], frustum,
+      inClipMask, refMask);
+    bool isVisible = (visible & (1 << i)) != 0;
+    if ((isVisible != refVisible) || (refVisible && (masks[i] != refMask)))
+      failed++;
+    if (refVisible)
+    {
+      numVisible++;
+      if (refMask != 0) numPartial++;
+    }
+  }
+  return failed;
+}
+
+static int CheckBoxes (bool useSIMD)
+{
+  csRandomGen rng (0xb0f5);
+  csPlane3 frustum[numPlanes];
+  csBox3 boxes[csBoxFrustumTester::MAX_BOXES];
+  const csBox3* boxPtrs[csBoxFrustumTester::MAX_BOXES];
+  for (int i = 0; i < csBoxFrustumTester::MAX_BOXES; i++)
+    boxPtrs[i] = &boxes[i];
+
+  int failed = 0, numBoxes = 0, numVisible = 0, numPartial = 0;
+  for (int f = 0; f < numFrustums; f++)
+  {
+    for (int p = 0; p < numPlanes; p++)
+    {
+      csVector3 n = RandomVector (rng, -1.0f, 1.0f);
+      if (n.IsZero ()) n.Set (0, 0, 1);
+      n.Normalize ();
+      frustum[p].Set (n, RandomRange (rng, -5.0f, 5.0f));
+    }
+    // All planes, or a random selection of them
+    uint32 inClipMask = (f & 1) ? (1 << numPlanes) - 1
+      : (rng.Get (1 << numPlanes) | 1);
+
+    for (int b = 0; b < boxesPerFrustum; )
+    {
+      // Batches of all sizes, as frustvis passes at the end of a node
+      int num = 1 + (int)rng.Get (csBoxFrustumTester::MAX_BOXES);
+      for (int i = 0; i < num; i++)
+      {
+        csVector3 center = RandomVector (rng, -10.0f, 10.0f);
+        csVector3 half = RandomVector (rng, 0.0f, 3.0f);
+        boxes[i].Set (center - half, center + half);
+      }
+      failed += CheckBatch (boxPtrs, num, frustum, inClipMask, useSIMD,
+        numVisible, numPartial);
+      numBoxes += num;
+      b += num;
+    }
+  }
+  csPrintf ("%-8s %d boxes, %d visible, %d intersecting a plane: "
+    "%d differ from csIntersect3::BoxFrustum()\n",
+    useSIMD ? "SSE" : "scalar", numBoxes, numVisible, numPartial, failed);
+  return failed;
+}
+
+int main (int, char*[])
+{
+  if (!csBoxFrustumTester::IsSIMDAvailable ())
+    csPrintf ("SSE is not available, only the scalar path is checked\n");
+  int failed = CheckBoxes (false);
+  if (csBoxFrustumTester::IsSIMDAvailable ())
+    failed += CheckBoxes (true);
+  return (failed == 0) ? 0 : 1;
+}
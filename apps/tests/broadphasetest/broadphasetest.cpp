@@ -0,0 +1,209 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csgeom/trimesh.h"
+#include "cstool/initapp.h"
+#include "csutil/randomgen.h"
+#include "iutil/cmdline.h"
+#include "iutil/plugin.h"
+#include "ivaria/collisions.h"
+
+using namespace CS::Collisions;
+
+CS_IMPLEMENT_APPLICATION
+
+enum
+{
+  NUM_MOVE_STEPS = 4,
+  NUM_QUERIES = 1000
+};
+
+static const size_t objectCounts[] = { 100, 1000, 10000, 100000 };
+static const size_t numObjectCounts =
+  sizeof (objectCounts) / sizeof (objectCounts[0]);
+
+/// Space per object; keeps the density constant for all object counts
+static const float spacePerObject = 4.0f;
+/// Length of the beams used for the hit beam queries
+static const float beamLength = 10.0f;
+
+/// Random position within \a extent of the origin on each axis
+static csVector3 RandomPosition (csRandomGen& rng, float extent)
+{
+  float x = rng.Get ();
+  float y = rng.Get ();
+  float z = rng.Get ();
+  return csVector3 (2.0f * x - 1.0f, 2.0f * y - 1.0f, 2.0f * z - 1.0f)
+    * extent;
+}
+
+static csRef<iTriangleMesh> CreateBoxMesh ()
+{
+  csRef<csTriangleMesh> mesh;
+  mesh.AttachNew (new csTriangleMesh);
+  for (int v = 0; v < 8; v++)
+    mesh->AddVertex (csVector3 ((v & 1) ? 0.5f : -0.5f,
+      (v & 2) ? 0.5f : -0.5f, (v & 4) ? 0.5f : -0.5f));
+  static const int faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 },
+    { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+  for (int f = 0; f < 6; f++)
+  {
+    mesh->AddTriangle (faces[f][0], faces[f][2], faces[f][1]);
+    mesh->AddTriangle (faces[f][0], faces[f][3], faces[f][2]);
+  }
+  return csRef<iTriangleMesh> (mesh);
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+
+  csRef<iCommandLineParser> cmdline (
+    csQueryRegistry<iCommandLineParser> (object_reg));
+  const char* pluginID = cmdline->GetOption ("plugin");
+  if (!pluginID) pluginID = "crystalspace.collisions.opcode2";
+
+  csRef<iCollisionSystem> collisionSystem (
+    csLoadPlugin<iCollisionSystem> (object_reg, pluginID));
+  if (!collisionSystem)
+  {
+    csPrintf ("Could not load collision system %s\n", pluginID);
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+
+  csRef<iTriangleMesh> boxMesh (CreateBoxMesh ());
+  csRef<iColliderConcaveMesh> collider (
+    collisionSystem->CreateColliderConcaveMesh (boxMesh));
+  csRef<iCollisionObjectFactory> factory (
+    collisionSystem->CreateCollisionObjectFactory (collider));
+
+  csRandomGen rng (4711);
+
+  csPrintf ("Collision system %s; time in us\n", pluginID);
+  csPrintf ("%8s %10s %10s %10s %10s %10s %10s %10s\n", "objects", "add",
+    "move", "coll/obj", "contacts", "beam/obj", "hits", "remove");
+
+  int failed = 0;
+
+  for (size_t c = 0; c < numObjectCounts; c++)
+  {
+    const size_t numObjects = objectCounts[c];
+    const float extent =
+      0.5f * powf (numObjects * spacePerObject, 1.0f / 3.0f);
+
+    iCollisionSector* sector = collisionSystem->CreateCollisionSector ();
+    csRefArray<iCollisionObject> objects;
+
+    // Populate the sector
+    int64 startTick = csGetMicroTicks ();
+    for (size_t i = 0; i < numObjects; i++)
+    {
+      csRef<iCollisionObject> object (factory->CreateCollisionObject ());
+      object->SetTransform (csOrthoTransform (csMatrix3 (),
+        RandomPosition (rng, extent)));
+      sector->AddCollisionObject (object);
+      objects.Push (object);
+    }
+    int64 addTime = csGetMicroTicks () - startTick;
+
+    // Move all objects by small amounts, as in a typical frame
+    startTick = csGetMicroTicks ();
+    for (int s = 0; s < NUM_MOVE_STEPS; s++)
+    {
+      for (size_t i = 0; i < numObjects; i++)
+      {
+        csOrthoTransform trans (objects[i]->GetTransform ());
+        trans.Translate (RandomPosition (rng, 0.1f));
+        objects[i]->SetTransform (trans);
+      }
+    }
+    int64 moveTime = (csGetMicroTicks () - startTick) / NUM_MOVE_STEPS;
+
+    // Test some objects against all others
+    size_t numContacts = 0;
+    startTick = csGetMicroTicks ();
+    for (int q = 0; q < NUM_QUERIES; q++)
+    {
+      csRef<iCollisionDataList> collisions (sector->CollisionTest (
+        objects[rng.Get (uint32 (numObjects))]));
+      if (collisions) numContacts += collisions->GetCollisionCount ();
+    }
+    int64 collTime = (csGetMicroTicks () - startTick) / NUM_QUERIES;
+
+    // Shoot beams from random positions into random directions
+    size_t numHits = 0;
+    startTick = csGetMicroTicks ();
+    for (int q = 0; q < NUM_QUERIES; q++)
+    {
+      csVector3 start (RandomPosition (rng, extent));
+      csVector3 dir (RandomPosition (rng, 1.0f));
+      if (dir.IsZero ()) dir.Set (0, 0, 1);
+      HitBeamResult result (sector->HitBeam (start,
+        start + dir.Unit () * beamLength));
+      if (result.hasHit) numHits++;
+    }
+    int64 beamTime = (csGetMicroTicks () - startTick) / NUM_QUERIES;
+
+    // Remove every other object
+    startTick = csGetMicroTicks ();
+    for (size_t i = 0; i < numObjects; i += 2)
+      sector->RemoveCollisionObject (objects[i]);
+    int64 removeTime = csGetMicroTicks () - startTick;
+
+    csPrintf ("%8zu %10" PRId64 " %10" PRId64 " %10" PRId64 " %10zu %10"
+      PRId64 " %10zu %10" PRId64 "\n", numObjects, addTime, moveTime,
+      collTime, numContacts, beamTime, numHits, removeTime);
+
+    /* Shoot beams at the centers of random objects: the remaining ones must
+       still be hit and the removed ones must never be reported. */
+    size_t numMissed = 0, numStale = 0;
+    for (int q = 0; q < NUM_QUERIES; q++)
+    {
+      size_t i = rng.Get (uint32 (numObjects));
+      csVector3 center (objects[i]->GetTransform ().GetOrigin ());
+      csVector3 dir (RandomPosition (rng, 1.0f));
+      if (dir.IsZero ()) dir.Set (0, 0, 1);
+      HitBeamResult result (sector->HitBeam (center + dir.Unit () * beamLength,
+        center));
+      if (result.hasHit && result.object->GetSector () != sector)
+        numStale++;
+      else if (!result.hasHit && (i & 1))
+        numMissed++;
+    }
+    if ((sector->GetCollisionObjectCount () != numObjects / 2)
+      || numMissed || numStale)
+    {
+      csPrintf ("%8zu objects left, %zu remaining objects missed, "
+        "%zu removed objects hit\n", sector->GetCollisionObjectCount (),
+        numMissed, numStale);
+      failed++;
+    }
+
+    collisionSystem->DeleteCollisionSector (sector);
+    objects.Empty ();
+  }
+
+  factory.Invalidate ();
+  collider.Invalidate ();
+  collisionSystem.Invalidate ();
+  csInitializer::DestroyApplication (object_reg);
+  return (failed == 0) ? 0 : 1;
+}
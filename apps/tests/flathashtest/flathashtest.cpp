@@ -0,0 +1,104 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csutil/csstring.h"
+#include "csutil/flathash.h"
+#include "csutil/hash.h"
+#include "csutil/sysfunc.h"
+
+CS_IMPLEMENT_APPLICATION
+
+static const size_t elementCounts[] = { 1000, 100000, 1000000 };
+static const size_t numElementCounts =
+  sizeof (elementCounts) / sizeof (elementCounts[0]);
+
+/// Prevents the compiler from optimizing the lookups away
+static volatile size_t sink;
+
+static void PrintTime (const char* what, csMicroTicks ticks, size_t n)
+{
+  csPrintf ("  %-12s %10.3f ms  %8.2f ns/op\n", what, ticks / 1000.0,
+    (ticks * 1000.0) / n);
+}
+
+template<typename HashType, typename Key>
+static void Benchmark (const char* name, const csArray<Key>& keys,
+                       const csArray<Key>& missingKeys)
+{
+  csPrintf ("%s, %zu elements:\n", name, keys.GetSize ());
+  HashType hash;
+  size_t n = keys.GetSize ();
+
+  csMicroTicks start = csGetMicroTicks ();
+  for (size_t i = 0; i < n; i++)
+    hash.Put (keys[i], i);
+  PrintTime ("insert", csGetMicroTicks () - start, n);
+
+  size_t found = 0;
+  start = csGetMicroTicks ();
+  for (size_t i = 0; i < n; i++)
+    found += hash.Get (keys[i], 0);
+  PrintTime ("lookup-hit", csGetMicroTicks () - start, n);
+
+  start = csGetMicroTicks ();
+  for (size_t i = 0; i < n; i++)
+    found += hash.Contains (missingKeys[i]) ? 1 : 0;
+  PrintTime ("lookup-miss", csGetMicroTicks () - start, n);
+
+  start = csGetMicroTicks ();
+  typename HashType::GlobalIterator it (hash.GetIterator ());
+  while (it.HasNext ())
+    found += it.Next ();
+  PrintTime ("iterate", csGetMicroTicks () - start, n);
+
+  sink = found;
+}
+
+int main (int, char*[])
+{
+  for (size_t c = 0; c < numElementCounts; c++)
+  {
+    size_t n = elementCounts[c];
+    csArray<uint> intKeys (n);
+    csArray<uint> intMissing (n);
+    csArray<csString> strKeys (n);
+    csArray<csString> strMissing (n);
+    for (size_t i = 0; i < n; i++)
+    {
+      /* Scatter the keys by multiplying with an odd constant; even keys
+         are inserted, odd keys are used for the misses. */
+      uint key = uint (2 * i) * 2654435761u;
+      uint missing = uint (2 * i + 1) * 2654435761u;
+      intKeys.Push (key);
+      intMissing.Push (missing);
+      strKeys.Push (csString ().Format ("key_%u", key));
+      strMissing.Push (csString ().Format ("key_%u", missing));
+    }
+
+    Benchmark<csHash<size_t, uint> > ("csHash<uint>", intKeys, intMissing);
+    Benchmark<csFlatHash<size_t, uint> > ("csFlatHash<uint>", intKeys,
+      intMissing);
+    Benchmark<csHash<size_t, csString> > ("csHash<csString>", strKeys,
+      strMissing);
+    Benchmark<csFlatHash<size_t, csString> > ("csFlatHash<csString>",
+      strKeys, strMissing);
+    csPrintf ("\n");
+  }
+  return 0;
+}
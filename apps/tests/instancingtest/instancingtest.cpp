@@ -0,0 +1,256 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Checks that the render manager draws identical meshes as instances of
+   one mesh. A number of meshes of one factory is rendered with the null
+   renderer, with and without instance batching, and the draw calls it
+   counted are compared: with batching all meshes have to be drawn with a
+   single instanced draw call. The shader of the meshes has an instancing
+   variant in a file next to it, which the render manager has to find and
+   load by itself. Exits with 1 on a failure. */
+
+#include "cssysdef.h"
+#include "cstool/csview.h"
+#include "cstool/genmeshbuilder.h"
+#include "cstool/initapp.h"
+#include "cstool/primitives.h"
+#include "iengine/camera.h"
+#include "iengine/engine.h"
+#include "iengine/material.h"
+#include "iengine/mesh.h"
+#include "iengine/movable.h"
+#include "iengine/rendermanager.h"
+#include "iengine/sector.h"
+#include "imap/loader.h"
+#include "imesh/genmesh.h"
+#include "imesh/object.h"
+#include "iutil/cfgmgr.h"
+#include "iutil/strset.h"
+#include "iutil/vfs.h"
+#include "ivideo/graph2d.h"
+#include "ivideo/graph3d.h"
+#include "ivideo/material.h"
+#include "ivideo/shader/shader.h"
+
+CS_IMPLEMENT_APPLICATION
+
+/// VFS directory the test shaders and render layers are written to
+static const char* testDir = "/tmp/instancingtest/";
+
+static const int numMeshes = 16;
+
+static const char* layersFile = "layers.xml";
+static const char* layersDoc =
+  "<layerconfig>"
+  "  <layer>"
+  "    <ambient />"
+  "    <shadertype>base</shadertype>"
+  "  </layer>"
+  "</layerconfig>";
+
+/* Shaders without programs, so they work with the null renderer. Only the
+   instancing variant has the instancing parameters. */
+static const char* shaderFile = "instancingtest.xml";
+static const char* shaderDoc =
+  "<shader compiler=\"xmlshader\" name=\"instancingtest\">"
+  "  <technique priority=\"100\">"
+  "    <pass />"
+  "  </technique>"
+  "</shader>";
+static const char* instShaderFile = "instancingtest_instance.xml";
+static const char* instShaderDoc =
+  "<shader compiler=\"xmlshader\" name=\"instancingtest_instance\">"
+  "  <technique priority=\"100\">"
+  "    <pass>"
+  "      <instancesnum>instances num</instancesnum>"
+  "      <instanceparam source=\"instancing transforms\""
+  "        destination=\"attribute 8\" />"
+  "    </pass>"
+  "  </technique>"
+  "</shader>";
+
+static bool WriteTestFile (iVFS* vfs, const char* name, const char* contents)
+{
+  csString path (testDir);
+  path += name;
+  return vfs->WriteFile (path, contents, strlen (contents));
+}
+
+static void DeleteTestFiles (iVFS* vfs)
+{
+  const char* files[] = { layersFile, shaderFile, instShaderFile };
+  for (size_t i = 0; i < sizeof (files) / sizeof (files[0]); i++)
+  {
+    csString path (testDir);
+    path += files[i];
+    vfs->DeleteFile (path);
+  }
+}
+
+/// Set up a sector with \a numMeshes identical boxes in front of the camera
+static bool SetupScene (iObjectRegistry* object_reg, iEngine* engine,
+  csView* view)
+{
+  csRef<iLoader> loader (csQueryRegistry<iLoader> (object_reg));
+  csRef<iStringSet> strings (csQueryRegistryTagInterface<iStringSet> (
+    object_reg, "crystalspace.shared.stringset"));
+  csString shaderPath (testDir);
+  shaderPath += shaderFile;
+  csRef<iShader> shader (loader->LoadShader (shaderPath));
+  if (!shader)
+  {
+    csPrintf ("Could not load the test shader\n");
+    return false;
+  }
+  iMaterialWrapper* material = engine->CreateMaterial ("instancingtest", 0);
+  material->GetMaterial ()->SetShader (strings->Request ("base"), shader);
+
+  iSector* sector = engine->CreateSector ("room");
+  CS::Geometry::Box box (csVector3 (-0.5f), csVector3 (0.5f));
+  csRef<iMeshFactoryWrapper> factory (
+    CS::Geometry::GeneralMeshBuilder::CreateFactory (engine, "box", &box));
+  factory->GetMeshObjectFactory ()->SetMaterialWrapper (material);
+  for (int i = 0; i < numMeshes; i++)
+  {
+    csString name;
+    name.Format ("box%d", i);
+    csRef<iMeshWrapper> mesh (CS::Geometry::GeneralMeshBuilder::CreateMesh (
+      engine, sector, name, factory));
+    // Without manual colors each mesh has its own lit color buffer
+    csRef<iGeneralMeshState> state (
+      scfQueryInterface<iGeneralMeshState> (mesh->GetMeshObject ()));
+    state->SetManualColors (true);
+    mesh->GetMovable ()->SetPosition (
+      csVector3 ((i % 4) * 2.0f - 3.0f, (i / 4) * 2.0f - 3.0f, 10.0f));
+    mesh->GetMovable ()->UpdateMove ();
+  }
+  engine->Prepare ();
+
+  view->GetCamera ()->SetSector (sector);
+  view->GetCamera ()->GetTransform ().SetOrigin (csVector3 (0));
+  iGraphics2D* g2d = view->GetContext ()->GetDriver2D ();
+  view->SetRectangle (0, 0, g2d->GetWidth (), g2d->GetHeight ());
+  return true;
+}
+
+/// Render a frame and get the draw calls and instances the renderer counted
+static void RenderFrame (iEngine* engine, iGraphics3D* g3d, csView* view,
+  uint& draws, uint& instances)
+{
+  g3d->BeginDraw (engine->GetBeginDrawFlags () | CSDRAW_3DGRAPHICS);
+  engine->GetRenderManager ()->RenderView (view);
+  g3d->FinishDraw ();
+  g3d->Print (0);
+  draws = instances = 0;
+  g3d->PerformExtension ("getdrawstats", &draws, &instances);
+}
+
+/// Switch to a new render manager with batching enabled or disabled
+static void SetBatching (iObjectRegistry* object_reg, iEngine* engine,
+  bool enable)
+{
+  csRef<iConfigManager> cfgmgr (csQueryRegistry<iConfigManager> (object_reg));
+  cfgmgr->SetBool ("RenderManager.InstanceBatching", enable);
+  engine->ReloadRenderManager ();
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+  if (!csInitializer::RequestPlugins (object_reg,
+      CS_REQUEST_VFS,
+      CS_REQUEST_PLUGIN ("crystalspace.graphics3d.null", iGraphics3D),
+      CS_REQUEST_ENGINE,
+      CS_REQUEST_IMAGELOADER,
+      CS_REQUEST_LEVELLOADER,
+      CS_REQUEST_REPORTER,
+      CS_REQUEST_REPORTERLISTENER,
+      CS_REQUEST_END))
+  {
+    csPrintf ("Could not load the plugins\n");
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+
+  csRef<iVFS> vfs (csQueryRegistry<iVFS> (object_reg));
+  if (!WriteTestFile (vfs, layersFile, layersDoc)
+      || !WriteTestFile (vfs, shaderFile, shaderDoc)
+      || !WriteTestFile (vfs, instShaderFile, instShaderDoc))
+  {
+    csPrintf ("Could not write the test files to %s\n", testDir);
+    DeleteTestFiles (vfs);
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+  {
+    csRef<iConfigManager> cfgmgr (
+      csQueryRegistry<iConfigManager> (object_reg));
+    cfgmgr->SetStr ("Engine.RenderManager.Default",
+      "crystalspace.rendermanager.unshadowed");
+    csString layersPath (testDir);
+    layersPath += layersFile;
+    cfgmgr->SetStr ("RenderManager.Unshadowed.Layers", layersPath);
+    // Occlusion queries need a real renderer
+    cfgmgr->SetBool ("RenderManager.Unshadowed.OcclusionCulling", false);
+  }
+  if (!csInitializer::OpenApplication (object_reg))
+  {
+    csPrintf ("Could not open the application\n");
+    DeleteTestFiles (vfs);
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+
+  bool failed = false;
+  {
+    csRef<iEngine> engine (csQueryRegistry<iEngine> (object_reg));
+    csRef<iGraphics3D> g3d (csQueryRegistry<iGraphics3D> (object_reg));
+    csRef<csView> view;
+    view.AttachNew (new csView (engine, g3d));
+    if (!SetupScene (object_reg, engine, view))
+      failed = true;
+    else
+    {
+      uint draws[2], instances[2];
+      for (int batching = 0; batching < 2; batching++)
+      {
+        SetBatching (object_reg, engine, batching != 0);
+        RenderFrame (engine, g3d, view, draws[batching], instances[batching]);
+        csPrintf ("batching %-3s %u draw calls, %u instances\n",
+          batching ? "on" : "off", draws[batching], instances[batching]);
+      }
+      if ((draws[0] != numMeshes) || (instances[0] != numMeshes))
+      {
+        csPrintf ("Expected %d draw calls without batching\n", numMeshes);
+        failed = true;
+      }
+      if ((draws[1] != 1) || (instances[1] != numMeshes))
+      {
+        csPrintf ("Expected one draw call of %d instances with batching\n",
+          numMeshes);
+        failed = true;
+      }
+    }
+  }
+
+  DeleteTestFiles (vfs);
+  vfs.Invalidate ();
+  csInitializer::DestroyApplication (object_reg);
+  return failed ? 1 : 0;
+}
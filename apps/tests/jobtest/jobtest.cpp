@@ -20,6 +20,7 @@
 #include "cstool/initapp.h"
 
 #include "csutil/threadjobqueue.h"
+#include "csutil/workstealingjobqueue.h"
 
 using namespace CS::Threading;
 
@@ -29,10 +30,29 @@ enum
 {
   NUM_TIMES = 4,
   MAX_WORKER_THREADS = 8,
-  WORK_UNIT_STEPS = 8
+  WORK_UNIT_STEPS = 8,
+  LATENCY_BURSTS = 64,
+  LATENCY_BURST_SIZE = 256
 };
 
-int64 BenchResult[MAX_WORKER_THREADS][WORK_UNIT_STEPS] = {{0}};
+enum
+{
+  QUEUE_THREADED,
+  QUEUE_WORKSTEALING,
+
+  NUM_QUEUE_TYPES
+};
+
+static const char* const queueNames[NUM_QUEUE_TYPES] =
+{
+  "ThreadedJobQueue",
+  "WorkStealingJobQueue"
+};
+
+int64 BenchResult[NUM_QUEUE_TYPES][MAX_WORKER_THREADS][WORK_UNIT_STEPS] = {{{0}}};
+// Mean and worst enqueue-to-start latency, in microseconds
+int64 LatencyMean[NUM_QUEUE_TYPES][MAX_WORKER_THREADS] = {{0}};
+int64 LatencyMax[NUM_QUEUE_TYPES][MAX_WORKER_THREADS] = {{0}};
 
 template<bool UseMemory>
 void PerformSomeWork (void* membuff, size_t iterations = (1<<16))
@@ -91,18 +111,88 @@ public:
 };
 
 
+// Job recording the time between being enqueued and being started
+class LatencyJob : public scfImplementation1<LatencyJob, iJob>
+{
+public:
+  LatencyJob (int64* latency)
+    : scfImplementationType (this), latency (latency),
+      enqueueTick (csGetMicroTicks ())
+  {
+  }
+
+  virtual void Run ()
+  {
+    *latency = csGetMicroTicks () - enqueueTick;
+    PerformSomeWork<false> (0, 1<<6);
+  }
+
+private:
+  int64* latency;
+  int64 enqueueTick;
+};
+
 unsigned int GetWorkUnits (unsigned int step)
 {
   return 128 << step;
 }
 
-void RunBenchmark (unsigned int numThreads)
+iJobQueue* CreateQueue (int queueType, unsigned int numThreads)
+{
+  switch (queueType)
+  {
+    case QUEUE_WORKSTEALING:
+      return new WorkStealingJobQueue (numThreads, THREAD_PRIO_NORMAL);
+    default:
+      return new ThreadedJobQueue (numThreads, THREAD_PRIO_NORMAL);
+  }
+}
+
+void RunLatencyBenchmark (int queueType, unsigned int numThreads)
+{
+  csRef<iJob> job;
+
+  csRef<iJobQueue> jobQueue;
+  jobQueue.AttachNew (CreateQueue (queueType, numThreads));
+
+  int64 latencies[LATENCY_BURST_SIZE];
+  int64 totalLatency = 0;
+  int64 maxLatency = 0;
+
+  // Bursts of small jobs with pauses in between, so workers go idle
+  for (unsigned int b = 0; b < LATENCY_BURSTS; ++b)
+  {
+    for (unsigned int j = 0; j < LATENCY_BURST_SIZE; ++j)
+    {
+      job.AttachNew (new LatencyJob (latencies + j));
+      jobQueue->Enqueue (job);
+    }
+    job.Invalidate ();
+    jobQueue->WaitAll ();
+
+    for (unsigned int j = 0; j < LATENCY_BURST_SIZE; ++j)
+    {
+      totalLatency += latencies[j];
+      maxLatency = csMax (maxLatency, latencies[j]);
+    }
+    csSleep (1);
+  }
+
+  LatencyMean[queueType][numThreads - 1] +=
+    totalLatency / (LATENCY_BURSTS * LATENCY_BURST_SIZE);
+  LatencyMax[queueType][numThreads - 1] += maxLatency;
+
+  csPrintf(".");
+  fflush(stdout);
+}
+
+void RunBenchmark (int queueType, unsigned int numThreads)
 {
   csRef<iJob> job;
 
   // Setup a job queue
   csRef<iJobQueue> jobQueue;
-  jobQueue.AttachNew (new ThreadedJobQueue(numThreads, THREAD_PRIO_NORMAL));
+  jobQueue.AttachNew (CreateQueue (queueType, numThreads));
 
   // For each number of work units
   for (unsigned int i = 0; i < WORK_UNIT_STEPS; ++i)
@@ -124,16 +214,16 @@ void RunBenchmark (unsigned int numThreads)
     jobQueue->WaitAll ();
 
     int64 endTick = csGetMicroTicks ();
-    BenchResult[numThreads - 1][i] += endTick - startTick;
+    BenchResult[queueType][numThreads - 1][i] += endTick - startTick;
 
     csPrintf(".");
     fflush(stdout);
   }  
 }
 
-void PrintResult ()
+void PrintResult (int queueType)
 {
-  csPrintf("\n");
+  csPrintf("\n%s: total time (us)\n", queueNames[queueType]);
 
   // Header
   csPrintf ("%6s", "WU");
@@ -152,11 +242,19 @@ void PrintResult ()
     // For each number of threads
     for (unsigned int t = 0; t < MAX_WORKER_THREADS; ++t)
     {
-      csPrintf("%8" PRId64, BenchResult[t][WU] / NUM_TIMES);
+      csPrintf("%8" PRId64, BenchResult[queueType][t][WU] / NUM_TIMES);
     }
 
     csPrintf("\n");
   }
+
+  csPrintf("%6s", "lat");
+  for (unsigned int t = 0; t < MAX_WORKER_THREADS; ++t)
+    csPrintf("%8" PRId64, LatencyMean[queueType][t] / NUM_TIMES);
+  csPrintf("\n%6s", "maxlat");
+  for (unsigned int t = 0; t < MAX_WORKER_THREADS; ++t)
+    csPrintf("%8" PRId64, LatencyMax[queueType][t] / NUM_TIMES);
+  csPrintf("\n");
 }
 
 int main(int argc, char* argv[])
@@ -167,13 +265,18 @@ int main(int argc, char* argv[])
 
   for (unsigned int iter = 0; iter < NUM_TIMES; ++iter)
   {
-    for (unsigned int i = 0; i < MAX_WORKER_THREADS; ++i)
+    for (int q = 0; q < NUM_QUEUE_TYPES; ++q)
     {
-      RunBenchmark (i+1);
+      for (unsigned int i = 0; i < MAX_WORKER_THREADS; ++i)
+      {
+        RunBenchmark (q, i+1);
+        RunLatencyBenchmark (q, i+1);
+      }
     }
   }
   
-  PrintResult ();
+  for (int q = 0; q < NUM_QUEUE_TYPES; ++q)
+    PrintResult (q);
 
   csInitializer::DestroyApplication(object_reg);
   return 0;
@@ -0,0 +1,144 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Checks csRadixSorter::Sort(uint64*) against a plain comparison sort for
+   random keys of various distributions. Equal keys must keep their order. */
+
+#include "cssysdef.h"
+#include "csutil/array.h"
+#include "csutil/radixsort.h"
+#include "csutil/randomgen.h"
+#include "csutil/sysfunc.h"
+
+CS_IMPLEMENT_APPLICATION
+
+static const size_t arraySizes[] = { 1, 2, 3, 100, 1000, 100000 };
+static const size_t numArraySizes =
+  sizeof (arraySizes) / sizeof (arraySizes[0]);
+
+enum KeyKind
+{
+  /// All 64 bits random
+  keysFull,
+  /// Only the upper 32 bits random, so the lower passes are skipped
+  keysHigh,
+  /// Few distinct keys with the top bit set, to check stability
+  keysFewHigh,
+  /// Small keys with many duplicates
+  keysSmall,
+  /// Already sorted keys
+  keysSorted,
+
+  numKeyKinds
+};
+
+static const char* const keyKindNames[numKeyKinds] =
+{ "full", "high", "few high", "small", "sorted" };
+
+struct KeyAndIndex
+{
+  uint64 key;
+  size_t index;
+};
+
+/// Orders by key, then by original position, which is what a stable sort
+/// gives.
+static int CompareKeyAndIndex (const KeyAndIndex& a, const KeyAndIndex& b)
+{
+  if (a.key != b.key) return (a.key < b.key) ? -1 : 1;
+  if (a.index != b.index) return (a.index < b.index) ? -1 : 1;
+  return 0;
+}
+
+/// 16 random bits at a time, as Get() only has float precision
+static uint64 Random64 (csRandomGen& rng)
+{
+  uint64 v = 0;
+  for (int i = 0; i < 4; i++)
+    v = (v << 16) | rng.Get (0x10000);
+  return v;
+}
+
+static uint64 RandomKey (csRandomGen& rng, KeyKind kind, size_t i)
+{
+  switch (kind)
+  {
+    case keysFull:
+      return Random64 (rng);
+    case keysHigh:
+      return (Random64 (rng) & CONST_UINT64 (0xffffffff00000000))
+        | 0x12345678;
+    case keysFewHigh:
+      return (CONST_UINT64 (0x8000000000000000) | Random64 (rng))
+        & CONST_UINT64 (0xff00000000000003);
+    case keysSmall:
+      return rng.Get (16);
+    case keysSorted:
+    default:
+      return CONST_UINT64 (0xfedcba9800000000) + i / 3;
+  }
+}
+
+/// Sort one array with \a sorter; returns whether the result is right
+static bool CheckSort (csRadixSorter& sorter, csRandomGen& rng, size_t size,
+                       KeyKind kind)
+{
+  csArray<uint64> keys (size);
+  csArray<KeyAndIndex> expected (size);
+  for (size_t i = 0; i < size; i++)
+  {
+    KeyAndIndex ki;
+    ki.key = RandomKey (rng, kind, i);
+    ki.index = i;
+    keys.Push (ki.key);
+    expected.Push (ki);
+  }
+  expected.Sort (CompareKeyAndIndex);
+
+  sorter.Sort (&keys[0], size);
+  const size_t* ranks = sorter.GetRanks ();
+  for (size_t i = 0; i < size; i++)
+  {
+    if (ranks[i] != expected[i].index)
+    {
+      csPrintf ("%-8s %6zu keys: element %zu is key %zu, expected %zu\n",
+        keyKindNames[kind], size, i, ranks[i], expected[i].index);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main (int, char*[])
+{
+  csRandomGen rng (0x5017);
+  // One sorter for everything, as state is kept between sorts
+  csRadixSorter sorter;
+  int failed = 0;
+  for (int k = 0; k < numKeyKinds; k++)
+  {
+    for (size_t s = 0; s < numArraySizes; s++)
+    {
+      if (!CheckSort (sorter, rng, arraySizes[s], (KeyKind)k))
+        failed++;
+    }
+  }
+  csPrintf ("%d of %zu sorts differ from a plain sort\n", failed,
+    numKeyKinds * numArraySizes);
+  return (failed == 0) ? 0 : 1;
+}
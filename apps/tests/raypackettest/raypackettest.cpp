@@ -0,0 +1,334 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Checks that lighter2's Raytracer::TraceAnyHitPacket() finds the same hits
+   as tracing each ray on its own with Raytracer::TraceAnyHit(). Shadow ray
+   packets of various spreads are traced through a kd-tree of random
+   triangles; every ray has to hit the same primitive at the same distance.
+   Some rays are parallel to the kd-tree splits. Exits with 1 on a failure. */
+
+#include "cssysdef.h"
+#include "csutil/alignedalloc.h"
+#include "csutil/array.h"
+#include "csutil/randomgen.h"
+#include "csutil/sysfunc.h"
+#include "apps/tools/lighter2/common.h"
+#include "apps/tools/lighter2/kdtree.h"
+#include "apps/tools/lighter2/lighter.h"
+#include "apps/tools/lighter2/primitive.h"
+#include "apps/tools/lighter2/raytracer.h"
+
+CS_IMPLEMENT_APPLICATION
+
+/* Only the raytracer part of lighter2 is linked in; its messages go to the
+   console. */
+namespace lighter
+{
+  Lighter* globalLighter = 0;
+
+  bool Lighter::Notify (const char* msg, ...)
+  {
+    va_list arg;
+    va_start (arg, msg);
+    csPrintfV (msg, arg);
+    va_end (arg);
+    csPrintf ("\n");
+    return false;
+  }
+
+  bool Lighter::Report (const char* msg, ...)
+  {
+    va_list arg;
+    va_start (arg, msg);
+    csPrintfV (msg, arg);
+    va_end (arg);
+    csPrintf ("\n");
+    return false;
+  }
+}
+
+using namespace lighter;
+
+static const size_t numTriangles = 5000;
+static const float sceneSize = 100.0f;
+static const size_t maxLeafPrimitives = 4;
+static const size_t maxDepth = 16;
+static const int numPackets = 20000;
+
+static float RandomRange (csRandomGen& rng, float min, float max)
+{
+  return min + rng.Get () * (max - min);
+}
+
+static csVector3 RandomVector (csRandomGen& rng, float min, float max)
+{
+  return csVector3 (RandomRange (rng, min, max), RandomRange (rng, min, max),
+    RandomRange (rng, min, max));
+}
+
+/// Builds a kd-tree with midpoint splits, in the layout lighter2 uses
+class TreeBuilder
+{
+public:
+  TreeBuilder (const csArray<Primitive>& prims) : prims (prims) {}
+
+  KDTree* Build (const csBox3& box)
+  {
+    nodes.SetSize (1);
+    csArray<size_t> all;
+    for (size_t i = 0; i < prims.GetSize (); i++)
+      all.Push (i);
+    BuildNode (0, box, all, 0);
+
+    KDTree* tree = new KDTree;
+    tree->boundingBox = box;
+    tree->nodeList = static_cast<KDTreeNode*> (CS::Memory::AlignedMalloc (
+      sizeof (KDTreeNode) * nodes.GetSize (), 16));
+    tree->primitives = static_cast<KDTreePrimitive*> (
+      CS::Memory::AlignedMalloc (
+        sizeof (KDTreePrimitive) * csMax (leafPrims.GetSize (), (size_t)1),
+        16));
+    for (size_t i = 0; i < leafPrims.GetSize (); i++)
+      FillPrimitive (tree->primitives[i], &prims[leafPrims[i]]);
+
+    for (size_t i = 0; i < nodes.GetSize (); i++)
+    {
+      KDTreeNode* node = tree->nodeList + i;
+      const Node& n = nodes[i];
+      if (n.leaf)
+      {
+        node->leaf.flagAndOffset = 0;
+        KDTreeNode_Op::SetLeaf (node, true);
+        KDTreeNode_Op::SetPrimitiveList (node, tree->primitives + n.first);
+        KDTreeNode_Op::SetPrimitiveListSize (node, n.count);
+      }
+      else
+      {
+        node->inner.flagDimensionAndOffset = 0;
+        KDTreeNode_Op::SetLeaf (node, false);
+        KDTreeNode_Op::SetDimension (node, n.dim);
+        KDTreeNode_Op::SetLeft (node, tree->nodeList + n.first);
+        KDTreeNode_Op::SetLocation (node, n.split);
+      }
+    }
+    return tree;
+  }
+
+private:
+  struct Node
+  {
+    bool leaf;
+    uint dim;
+    float split;
+    // Left child for inner nodes, first primitive for leaves
+    size_t first, count;
+  };
+
+  const csArray<Primitive>& prims;
+  csArray<Node> nodes;
+  csArray<size_t> leafPrims;
+
+  void BuildNode (size_t index, const csBox3& box, const csArray<size_t>& list,
+    size_t depth)
+  {
+    if ((list.GetSize () <= maxLeafPrimitives) || (depth >= maxDepth))
+    {
+      Node& node = nodes[index];
+      node.leaf = true;
+      node.first = leafPrims.GetSize ();
+      node.count = list.GetSize ();
+      for (size_t i = 0; i < list.GetSize (); i++)
+        leafPrims.Push (list[i]);
+      return;
+    }
+
+    const csVector3 size = box.Max () - box.Min ();
+    const uint dim = (size.x > size.y) ? ((size.x > size.z) ? 0 : 2)
+      : ((size.y > size.z) ? 1 : 2);
+    const float split = (box.Min ()[dim] + box.Max ()[dim]) * 0.5f;
+
+    csArray<size_t> left, right;
+    for (size_t i = 0; i < list.GetSize (); i++)
+    {
+      const Primitive& prim = prims[list[i]];
+      const ObjectVertexData& vdata = prim.GetVertexData ();
+      const Primitive::TriangleType& t = prim.GetTriangle ();
+      const float a = vdata.positions[t.a][dim];
+      const float b = vdata.positions[t.b][dim];
+      const float c = vdata.positions[t.c][dim];
+      if (csMin (a, csMin (b, c)) <= split) left.Push (list[i]);
+      if (csMax (a, csMax (b, c)) >= split) right.Push (list[i]);
+    }
+
+    const size_t leftIndex = nodes.GetSize ();
+    nodes.SetSize (leftIndex + 2);
+    Node& node = nodes[index];
+    node.leaf = false;
+    node.dim = dim;
+    node.split = split;
+    node.first = leftIndex;
+
+    csVector3 leftMax (box.Max ()), rightMin (box.Min ());
+    leftMax[dim] = split;
+    rightMin[dim] = split;
+    BuildNode (leftIndex, csBox3 (box.Min (), leftMax), left, depth + 1);
+    BuildNode (leftIndex + 1, csBox3 (rightMin, box.Max ()), right, depth + 1);
+  }
+
+  // Same as KDTreeBuilder's primitive setup
+  static void FillPrimitive (KDTreePrimitive& optPrim, const Primitive* prim)
+  {
+    const csVector3& N = prim->GetPlane ().Normal ();
+    const ObjectVertexData& vdata = prim->GetVertexData ();
+    const Primitive::TriangleType& t = prim->GetTriangle ();
+    const csVector3& A = vdata.positions[t.a];
+    const csVector3& B = vdata.positions[t.b];
+    const csVector3& C = vdata.positions[t.c];
+
+    const int k = N.DominantAxis ();
+    const size_t u = (k+1)%3;
+    const size_t v = (k+2)%3;
+    optPrim.primPointer = const_cast<Primitive*> (prim);
+    optPrim.normal_K = k;
+
+    const float nkinv = 1.0f/N[k];
+    optPrim.normal_U = N[u] * nkinv;
+    optPrim.normal_V = N[v] * nkinv;
+    optPrim.normal_D = (N * A) * nkinv;
+
+    const csVector3 bb = C - A;
+    const csVector3 cc = B - A;
+    const float tmp = 1.0f/(bb[u] * cc[v] - bb[v] * cc[u]);
+
+    optPrim.edgeA_U = -bb[v] * tmp;
+    optPrim.edgeA_V = bb[u] * tmp;
+    optPrim.edgeA_D = (bb[v] * A[u] - bb[u] * A[v]) * tmp;
+
+    optPrim.edgeB_U = cc[v] * tmp;
+    optPrim.edgeB_V = -cc[u] * tmp;
+    optPrim.edgeB_D = (cc[u] * A[v] - cc[v] * A[u]) * tmp;
+  }
+};
+
+/// Random small triangles; some lie in one plane, so rays can touch edges
+static void CreateTriangles (csRandomGen& rng, ObjectVertexData& vdata,
+  csArray<Primitive>& prims)
+{
+  for (size_t i = 0; i < numTriangles; i++)
+  {
+    const csVector3 center = RandomVector (rng, 0.0f, sceneSize);
+    Primitive::TriangleType t;
+    t.a = vdata.positions.Push (center + RandomVector (rng, -2.0f, 2.0f));
+    t.b = vdata.positions.Push (center + RandomVector (rng, -2.0f, 2.0f));
+    t.c = vdata.positions.Push (center + RandomVector (rng, -2.0f, 2.0f));
+    if (i % 50 == 0)
+    {
+      const float x = floorf (center.x);
+      vdata.positions[t.a].x = vdata.positions[t.b].x
+        = vdata.positions[t.c].x = x;
+    }
+
+    Primitive prim (vdata, 0);
+    prim.SetTriangle (t);
+    prim.ComputePlane ();
+    prims.Push (prim);
+  }
+}
+
+/// Shadow rays from a light to points around a target, as lighter2 traces
+static size_t CreatePacket (csRandomGen& rng, Ray* rays)
+{
+  const csVector3 light = RandomVector (rng, -10.0f, sceneSize + 10.0f);
+  const csVector3 target = RandomVector (rng, 0.0f, sceneSize);
+  // Mostly lightmap element quadrants, some far apart
+  const float spreads[] = { 0.1f, 0.5f, 2.0f, 20.0f };
+  const float spread = spreads[rng.Get (4)];
+  const size_t numRays = 2 + rng.Get (Raytracer::PACKET_SIZE - 1);
+
+  for (size_t i = 0; i < numRays; i++)
+  {
+    csVector3 end = target + RandomVector (rng, -spread, spread);
+    // Rays along a splitting plane
+    if (rng.Get (20) == 0) end.x = light.x;
+
+    csVector3 dir = end - light;
+    const float length = dir.Norm ();
+    Ray& ray = rays[i];
+    ray.origin = light;
+    ray.direction = dir / length;
+    ray.minLength = FLT_EPSILON*10.0f;
+    ray.maxLength = length - FLT_EPSILON*10.0f;
+    ray.type = RAY_TYPE_SHADOW;
+  }
+  return numRays;
+}
+
+/* The compiler may evaluate the single ray code in another order than the
+   SSE code (with fast math), so the distances can differ in the last bits */
+static bool SameDistance (float a, float b)
+{
+  return fabsf (a - b) <= 1e-5f * csMax (fabsf (b), 1.0f);
+}
+
+int main (int, char*[])
+{
+  csRandomGen rng (0x5a7d);
+  ObjectVertexData vdata;
+  csArray<Primitive> prims;
+  CreateTriangles (rng, vdata, prims);
+
+  TreeBuilder builder (prims);
+  csBox3 box (csVector3 (-1.0f), csVector3 (sceneSize + 1.0f));
+  KDTree* tree = builder.Build (box);
+
+  int failed = 0, numRays = 0, numHits = 0;
+  for (int p = 0; p < numPackets; p++)
+  {
+    Ray rays[Raytracer::PACKET_SIZE];
+    const size_t num = CreatePacket (rng, rays);
+
+    HitPoint refHits[Raytracer::PACKET_SIZE];
+    uint refMask = 0;
+    for (size_t i = 0; i < num; i++)
+    {
+      if (Raytracer::TraceAnyHit (tree, rays[i], refHits[i]))
+        refMask |= 1 << i;
+    }
+
+    HitPoint hits[Raytracer::PACKET_SIZE];
+    const uint mask = Raytracer::TraceAnyHitPacket (tree, rays, num, hits);
+
+    for (size_t i = 0; i < num; i++)
+    {
+      const bool refHit = (refMask & (1 << i)) != 0;
+      const bool hit = (mask & (1 << i)) != 0;
+      if ((hit != refHit) || (refHit &&
+          ((hits[i].primitive != refHits[i].primitive)
+          || !SameDistance (hits[i].distance, refHits[i].distance))))
+        failed++;
+      if (refHit) numHits++;
+    }
+    numRays += (int)num;
+  }
+  csPrintf ("%d packets, %d rays, %d hits: "
+    "%d differ from Raytracer::TraceAnyHit()\n",
+    numPackets, numRays, numHits, failed);
+
+  delete tree;
+  return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Checks that documents loaded from the scene cache of the loader equal the
+   parsed XML. Each XML file shipped in data/ (and a few values that are
+   easily changed by a conversion to numbers) is parsed, converted to the
+   binary document format and read back the way the loader caches it, and
+   the result is compared with the parsed XML. Exits with 1 on a mismatch.
+   Options:
+     -path=<dir>       Directory to scan (default: the data directory) */
+
+#include "cssysdef.h"
+#include <ctype.h>
+#include "cstool/initapp.h"
+#include "csutil/csstring.h"
+#include "csutil/databuf.h"
+#include "csutil/documenthelper.h"
+#include "csutil/memfile.h"
+#include "csutil/refarr.h"
+#include "csutil/stringarray.h"
+#include "csutil/util.h"
+#include "csutil/xmltiny.h"
+#include "iutil/cmdline.h"
+#include "iutil/databuff.h"
+#include "iutil/document.h"
+#include "iutil/plugin.h"
+#include "iutil/stringarray.h"
+#include "iutil/vfs.h"
+
+CS_IMPLEMENT_APPLICATION
+
+/// VFS directory the scanned directory is mounted at
+static const char* mountPoint = "/scenecachetest/";
+
+/// Values a conversion to numbers would not read back unchanged
+static const char* sampleDoc =
+  "<world>"
+  "<key name=\"a\" value=\"007\"/>"
+  "<key name=\"b\" value=\"1.0\"/>"
+  "<key name=\"c\" value=\"1234.5678\"/>"
+  "<key name=\"d\" value=\"-0\"/>"
+  "<key name=\"e\" value=\"1e5\"/>"
+  "<key name=\"f\" value=\"99999999999\"/>"
+  "<key name=\"g\" value=\"-\"/>"
+  "<key name=\"h\" value=\"12\" other=\"0.5\"/>"
+  "<v>007</v><v>1.0</v><v>1234.5678</v><v>42</v><v>-3.25</v>"
+  "</world>";
+
+/// Collect the files below a VFS directory that look like XML
+static void CollectFiles (iVFS* vfs, const char* dir,
+                          csRefArray<iDataBuffer>& files,
+                          csStringArray& names)
+{
+  csRef<iStringArray> entries (vfs->FindFiles (dir));
+  for (size_t i = 0; i < entries->GetSize (); i++)
+  {
+    const char* entry = entries->Get (i);
+    size_t len = strlen (entry);
+    if ((len > 0) && (entry[len - 1] == '/'))
+    {
+      CollectFiles (vfs, entry, files, names);
+      continue;
+    }
+    csRef<iDataBuffer> data (vfs->ReadFile (entry, false));
+    if (!data || (data->GetSize () == 0)) continue;
+    const char* p = data->GetData ();
+    const char* end = p + data->GetSize ();
+    while ((p < end) && isspace ((unsigned char)*p)) p++;
+    if ((p == end) || (*p != '<')) continue;
+    if (memchr (data->GetData (), 0, data->GetSize ()) != 0) continue;
+    files.Push (data);
+    names.Push (entry);
+  }
+}
+
+/// Convert a document the way the loader writes it to the scene cache
+static csPtr<iDocument> CacheRoundTrip (iDocumentSystem* binDocSys,
+                                        iDocument* doc)
+{
+  csRef<iDocument> binDoc (binDocSys->CreateDocument ());
+  csRef<iDocumentNode> binRoot (binDoc->CreateRoot ());
+  CS::DocSystem::CloneNode (doc->GetRoot (), binRoot);
+  csRef<csMemFile> binFile;
+  binFile.AttachNew (new csMemFile ());
+  if (binDoc->Write (binFile) != 0) return 0;
+  csRef<iDataBuffer> binData (binFile->GetAllData ());
+
+  csRef<iDocument> cachedDoc (binDocSys->CreateDocument ());
+  if (cachedDoc->Parse (binData) != 0) return 0;
+  return csPtr<iDocument> (cachedDoc);
+}
+
+static inline bool SameString (const char* s1, const char* s2)
+{
+  return strcmp (s1 ? s1 : "", s2 ? s2 : "") == 0;
+}
+
+/// Compare two nodes and their children, printing the first difference
+static bool CompareNode (const char* file, iDocumentNode* xmlNode,
+                         iDocumentNode* cachedNode)
+{
+  if ((xmlNode->GetType () != cachedNode->GetType ())
+    || !SameString (xmlNode->GetValue (), cachedNode->GetValue ()))
+  {
+    csPrintf ("%s: node '%s' read back as '%s'\n", file,
+      xmlNode->GetValue (), cachedNode->GetValue ());
+    return false;
+  }
+
+  // The binary format sorts the attributes, so look them up by name
+  size_t numAttrs = 0;
+  csRef<iDocumentAttributeIterator> attrs (xmlNode->GetAttributes ());
+  while (attrs->HasNext ())
+  {
+    csRef<iDocumentAttribute> attr (attrs->Next ());
+    csRef<iDocumentAttribute> cachedAttr (
+      cachedNode->GetAttribute (attr->GetName ()));
+    if (!cachedAttr || !SameString (attr->GetValue (), cachedAttr->GetValue ()))
+    {
+      csPrintf ("%s: attribute '%s' of node '%s' is '%s' instead of '%s'\n",
+        file, attr->GetName (), xmlNode->GetValue (),
+        cachedAttr ? cachedAttr->GetValue () : "(missing)", attr->GetValue ());
+      return false;
+    }
+    numAttrs++;
+  }
+  attrs = cachedNode->GetAttributes ();
+  while (attrs->HasNext ())
+  {
+    attrs->Next ();
+    numAttrs--;
+  }
+  if (numAttrs != 0)
+  {
+    csPrintf ("%s: node '%s' has extra attributes\n", file,
+      xmlNode->GetValue ());
+    return false;
+  }
+
+  csRef<iDocumentNodeIterator> children (xmlNode->GetNodes ());
+  csRef<iDocumentNodeIterator> cachedChildren (cachedNode->GetNodes ());
+  while (children->HasNext ())
+  {
+    csRef<iDocumentNode> child (children->Next ());
+    if (!cachedChildren->HasNext ())
+    {
+      csPrintf ("%s: node '%s' is missing children\n", file,
+        xmlNode->GetValue ());
+      return false;
+    }
+    csRef<iDocumentNode> cachedChild (cachedChildren->Next ());
+    if (!CompareNode (file, child, cachedChild)) return false;
+  }
+  if (cachedChildren->HasNext ())
+  {
+    csPrintf ("%s: node '%s' has extra children\n", file,
+      xmlNode->GetValue ());
+    return false;
+  }
+  return true;
+}
+
+/// Parse XML, pass it through the cache format and compare
+static bool CheckDocument (iDocumentSystem* xmlDocSys,
+                           iDocumentSystem* binDocSys,
+                           const char* name, iDataBuffer* data)
+{
+  csRef<iDocument> doc (xmlDocSys->CreateDocument ());
+  // Files the loader can't parse are never cached
+  if (doc->Parse (data, true) != 0) return true;
+  csRef<iDocument> cachedDoc (CacheRoundTrip (binDocSys, doc));
+  if (!cachedDoc)
+  {
+    csPrintf ("%s: could not convert to the binary format\n", name);
+    return false;
+  }
+  csRef<iDocumentNode> root (doc->GetRoot ());
+  csRef<iDocumentNode> cachedRoot (cachedDoc->GetRoot ());
+  return CompareNode (name, root, cachedRoot);
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+  if (!csInitializer::RequestPlugins (object_reg, CS_REQUEST_VFS,
+      CS_REQUEST_END))
+  {
+    csPrintf ("Could not load VFS\n");
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+
+  csRef<iCommandLineParser> cmdline (
+    csQueryRegistry<iCommandLineParser> (object_reg));
+  csRef<iVFS> vfs (csQueryRegistry<iVFS> (object_reg));
+  csRef<iPluginManager> plugin_mgr (
+    csQueryRegistry<iPluginManager> (object_reg));
+  csRef<iDocumentSystem> binDocSys (csLoadPlugin<iDocumentSystem> (
+    plugin_mgr, "crystalspace.documentsystem.binary"));
+  if (!binDocSys)
+  {
+    csPrintf ("Could not load the binary document system\n");
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+  csRef<iDocumentSystem> xmlDocSys;
+  xmlDocSys.AttachNew (new csTinyDocumentSystem ());
+
+  const char* path = cmdline->GetOption ("path");
+  csString realPath;
+  if (path)
+    realPath.Format ("%s%c", path, CS_PATH_SEPARATOR);
+  else
+    realPath = "$@data$/";
+  if (!vfs->Mount (mountPoint, realPath))
+  {
+    csPrintf ("Could not mount %s\n", realPath.GetData ());
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+  csRefArray<iDataBuffer> files;
+  csStringArray names;
+  CollectFiles (vfs, mountPoint, files, names);
+
+  size_t failed = 0;
+  {
+    csRef<iDataBuffer> sample;
+    sample.AttachNew (new CS::DataBuffer<> (CS::StrDup (sampleDoc),
+      strlen (sampleDoc)));
+    if (!CheckDocument (xmlDocSys, binDocSys, "(sample)", sample))
+      failed++;
+  }
+  for (size_t i = 0; i < files.GetSize (); i++)
+  {
+    if (!CheckDocument (xmlDocSys, binDocSys, names[i], files[i]))
+      failed++;
+  }
+  csPrintf ("%zu XML files, %zu differ after a cache round trip\n",
+    files.GetSize () + 1, failed);
+
+  vfs->Unmount (mountPoint, realPath);
+  files.DeleteAll ();
+  xmlDocSys.Invalidate ();
+  binDocSys.Invalidate ();
+  plugin_mgr.Invalidate ();
+  vfs.Invalidate ();
+  cmdline.Invalidate ();
+  csInitializer::DestroyApplication (object_reg);
+  return failed ? 1 : 0;
+}
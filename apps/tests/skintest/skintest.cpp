@@ -0,0 +1,201 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "cstool/animeshskinning.h"
+#include "cstool/initapp.h"
+#include "csutil/platform.h"
+#include "csutil/randomgen.h"
+#include "csutil/workstealingjobqueue.h"
+#include "imesh/animesh.h"
+
+using namespace CS::Mesh;
+
+CS_IMPLEMENT_APPLICATION
+
+enum
+{
+  NUM_TIMES = 8,
+  NUM_BONES = 64,
+  INFLUENCES_PER_VERTEX = 4,
+  BATCH_SIZE = 1024
+};
+
+static const size_t vertexCounts[] = { 500, 5000, 50000 };
+static const size_t numVertexCounts =
+  sizeof (vertexCounts) / sizeof (vertexCounts[0]);
+
+static float RandomRange (csRandomGen& rng, float min, float max)
+{
+  return min + rng.Get () * (max - min);
+}
+
+struct TestMesh
+{
+  size_t numVertices;
+  csDirtyAccessArray<csVector3> srcVertices, srcNormals, srcTangents,
+    srcBinormals;
+  csDirtyAccessArray<csVector3> dstVertices, dstNormals, dstTangents,
+    dstBinormals;
+  csDirtyAccessArray<AnimatedMeshBoneInfluence> influences;
+
+  void Setup (csRandomGen& rng, size_t n)
+  {
+    numVertices = n;
+    srcVertices.SetSize (n);
+    srcNormals.SetSize (n);
+    srcTangents.SetSize (n);
+    srcBinormals.SetSize (n);
+    dstVertices.SetSize (n);
+    dstNormals.SetSize (n);
+    dstTangents.SetSize (n);
+    dstBinormals.SetSize (n);
+    influences.SetSize (n * INFLUENCES_PER_VERTEX);
+
+    for (size_t v = 0; v < n; v++)
+    {
+      srcVertices[v].Set (RandomRange (rng, -1.0f, 1.0f),
+        RandomRange (rng, -1.0f, 1.0f), RandomRange (rng, -1.0f, 1.0f));
+      srcNormals[v] = srcVertices[v].Unit ();
+      srcTangents[v].Set (srcNormals[v].y, -srcNormals[v].x, 0);
+      srcBinormals[v] = srcNormals[v] % srcTangents[v];
+
+      // Between zero and four influences, mostly two or three
+      float weightSum = 0;
+      int numInfl = int (rng.Get (INFLUENCES_PER_VERTEX + 1));
+      for (int i = 0; i < INFLUENCES_PER_VERTEX; i++)
+      {
+        AnimatedMeshBoneInfluence& infl =
+          influences[v * INFLUENCES_PER_VERTEX + i];
+        infl.bone = rng.Get (NUM_BONES);
+        infl.influenceWeight = (i < numInfl) ? rng.Get () : 0;
+        weightSum += infl.influenceWeight;
+      }
+      for (int i = 0; i < numInfl; i++)
+        influences[v * INFLUENCES_PER_VERTEX + i].influenceWeight /= weightSum;
+    }
+  }
+
+  DualQuaternionSkinner::Buffers GetBuffers ()
+  {
+    DualQuaternionSkinner::Buffers buffers;
+    buffers.srcVertices = srcVertices.GetArray ();
+    buffers.dstVertices = dstVertices.GetArray ();
+    buffers.srcNormals = srcNormals.GetArray ();
+    buffers.dstNormals = dstNormals.GetArray ();
+    buffers.srcTangents = srcTangents.GetArray ();
+    buffers.dstTangents = dstTangents.GetArray ();
+    buffers.srcBinormals = srcBinormals.GetArray ();
+    buffers.dstBinormals = dstBinormals.GetArray ();
+    return buffers;
+  }
+};
+
+static void SetupBones (csRandomGen& rng, DualQuaternionSkinner& skinner)
+{
+  csQuaternion rotations[NUM_BONES];
+  csVector3 offsets[NUM_BONES];
+  for (int b = 0; b < NUM_BONES; b++)
+  {
+    rotations[b].SetAxisAngle (csVector3 (RandomRange (rng, -1.0f, 1.0f),
+      RandomRange (rng, -1.0f, 1.0f), RandomRange (rng, -1.0f, 1.0f)).Unit (),
+      RandomRange (rng, -PI, PI));
+    offsets[b].Set (RandomRange (rng, -1.0f, 1.0f),
+      RandomRange (rng, -1.0f, 1.0f), RandomRange (rng, -1.0f, 1.0f));
+  }
+  skinner.SetupBones (rotations, offsets, NUM_BONES);
+}
+
+static float MaxDifference (const csDirtyAccessArray<csVector3>& a,
+                            const csDirtyAccessArray<csVector3>& b)
+{
+  float maxDiff = 0;
+  for (size_t i = 0; i < a.GetSize (); i++)
+    maxDiff = csMax (maxDiff, (a[i] - b[i]).Norm ());
+  return maxDiff;
+}
+
+// Average time in microseconds to skin all attributes of the mesh
+static int64 RunBenchmark (TestMesh& mesh, DualQuaternionSkinner& skinner,
+                           iJobQueue* jobQueue, size_t numWorkers)
+{
+  DualQuaternionSkinner::Buffers buffers (mesh.GetBuffers ());
+  int64 total = 0;
+  for (int t = 0; t < NUM_TIMES; t++)
+  {
+    int64 startTick = csGetMicroTicks ();
+    if (jobQueue)
+      skinner.SkinParallel (jobQueue, numWorkers, buffers,
+        mesh.influences.GetArray (), INFLUENCES_PER_VERTEX,
+        mesh.numVertices, BATCH_SIZE);
+    else
+      skinner.Skin (buffers, mesh.influences.GetArray (),
+        INFLUENCES_PER_VERTEX, 0, mesh.numVertices);
+    total += csGetMicroTicks () - startTick;
+  }
+  return total / NUM_TIMES;
+}
+
+int main(int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+
+  csRandomGen rng (12341);
+  DualQuaternionSkinner skinner;
+  SetupBones (rng, skinner);
+
+  size_t numWorkers = csMax (CS::Platform::GetProcessorCount (), 2u) - 1;
+  csRef<iJobQueue> jobQueue;
+  jobQueue.AttachNew (new CS::Threading::WorkStealingJobQueue (numWorkers,
+    CS::Threading::THREAD_PRIO_NORMAL, "skinning"));
+
+  csPrintf ("SIMD skinning %s\n",
+    DualQuaternionSkinner::IsSIMDAvailable () ? "available" : "not available");
+  csPrintf ("Skinning vertices, normals, tangents and binormals; "
+    "time in us\n");
+  csPrintf ("%8s %10s %10s %10s %10s %10s\n", "verts", "scalar", "simd",
+    "scalar-mt", "simd-mt", "maxdiff");
+
+  for (size_t c = 0; c < numVertexCounts; c++)
+  {
+    TestMesh mesh;
+    mesh.Setup (rng, vertexCounts[c]);
+
+    skinner.SetSIMDEnabled (false);
+    int64 scalarTime = RunBenchmark (mesh, skinner, 0, 0);
+    csDirtyAccessArray<csVector3> scalarVertices (mesh.dstVertices);
+    csDirtyAccessArray<csVector3> scalarNormals (mesh.dstNormals);
+    int64 scalarMTTime = RunBenchmark (mesh, skinner, jobQueue, numWorkers);
+
+    skinner.SetSIMDEnabled (true);
+    int64 simdTime = RunBenchmark (mesh, skinner, 0, 0);
+    int64 simdMTTime = RunBenchmark (mesh, skinner, jobQueue, numWorkers);
+
+    // Results of the code paths should agree
+    float maxDiff = csMax (MaxDifference (scalarVertices, mesh.dstVertices),
+      MaxDifference (scalarNormals, mesh.dstNormals));
+
+    csPrintf ("%8zu %10" PRId64 " %10" PRId64 " %10" PRId64 " %10" PRId64
+      " %10g\n", mesh.numVertices, scalarTime, simdTime, scalarMTTime,
+      simdMTTime, maxDiff);
+  }
+
+  jobQueue.Invalidate ();
+  csInitializer::DestroyApplication(object_reg);
+  return 0;
+}
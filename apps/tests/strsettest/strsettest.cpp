@@ -0,0 +1,153 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Measures the throughput of a string set shared between threads, comparing
+   the locked CS::Utility::StringSet with CS::Utility::ConcurrentStringSet.
+   Options:
+     -threads=<n>  Maximum number of threads (default: number of processors)
+     -requests=<n> Requests per thread (default: 1000000)
+     -new=<n>      Percentage of requests for new strings (default: 1) */
+
+#include "cssysdef.h"
+#include "csutil/cmdline.h"
+#include "csutil/concurrentstrset.h"
+#include "csutil/csstring.h"
+#include "csutil/platform.h"
+#include "csutil/strset.h"
+#include "csutil/sysfunc.h"
+#include "csutil/threading/barrier.h"
+#include "csutil/threading/thread.h"
+
+CS_IMPLEMENT_APPLICATION
+
+using namespace CS::Threading;
+
+typedef CS::StringSetTag::General Tag;
+
+/// Number of distinct strings present in the set before the benchmark
+static const int numStrings = 2000;
+
+/// Requests strings from a set shared with other threads
+template<typename SetType>
+class Requester : public Runnable
+{
+  SetType& set;
+  Barrier& barrier;
+  int thread;
+  int requests;
+  int newPercent;
+public:
+  Requester (SetType& set, Barrier& barrier, int thread, int requests,
+             int newPercent)
+    : set (set), barrier (barrier), thread (thread), requests (requests),
+      newPercent (newPercent) {}
+
+  void Run ()
+  {
+    // Prepare the strings up front so only the set is measured
+    csArray<csString> strings (numStrings);
+    for (int i = 0; i < numStrings; i++)
+      strings.Push (csString ().Format ("shader var %d", i));
+    csArray<csString> newStrings;
+    int newInterval = newPercent > 0 ? 100 / newPercent : 0;
+    if (newInterval > 0)
+    {
+      for (int i = 0; i < requests / newInterval; i++)
+        newStrings.Push (csString ().Format ("thread %d var %d", thread, i));
+    }
+
+    barrier.Wait ();
+    uint32 x = uint32 (thread) * 2654435761u + 1;
+    size_t n = 0;
+    for (int i = 0; i < requests; i++)
+    {
+      if ((newInterval > 0) && (i % newInterval == 0)
+          && (n < newStrings.GetSize ()))
+      {
+        set.Request (newStrings[n++]);
+        continue;
+      }
+      x = x * 1664525u + 1013904223u;
+      CS::StringID<Tag> id = set.Request (strings[(x >> 8) % numStrings]);
+      // Reverse lookups are about as common as forward lookups
+      set.Request (id);
+    }
+  }
+};
+
+template<typename SetType>
+static void Benchmark (const char* name, int numThreads, int requests,
+                       int newPercent)
+{
+  SetType set;
+  for (int i = 0; i < numStrings; i++)
+    set.Request (csString ().Format ("shader var %d", i));
+
+  // One extra participant: the main thread starts the clock
+  Barrier barrier (numThreads + 1);
+  csRefArray<Thread> threads;
+  csRefArray<Runnable> runnables;
+  for (int t = 0; t < numThreads; t++)
+  {
+    csRef<Runnable> r;
+    r.AttachNew (new Requester<SetType> (set, barrier, t, requests,
+      newPercent));
+    runnables.Push (r);
+    csRef<Thread> thread;
+    thread.AttachNew (new Thread (r, true));
+    threads.Push (thread);
+  }
+  barrier.Wait ();
+  csMicroTicks start = csGetMicroTicks ();
+  for (size_t t = 0; t < threads.GetSize (); t++)
+    threads[t]->Wait ();
+  csMicroTicks ticks = csGetMicroTicks () - start;
+
+  double total = double (numThreads) * requests;
+  csPrintf ("  %-22s %2d threads: %9.2f ms, %7.2f M requests/s\n", name,
+    numThreads, ticks / 1000.0, total / ticks);
+}
+
+int main (int argc, char* argv[])
+{
+  csRef<csCommandLineParser> cmdline;
+  cmdline.AttachNew (new csCommandLineParser (argc, argv));
+
+  int maxThreads = int (CS::Platform::GetProcessorCount ());
+  const char* opt = cmdline->GetOption ("threads");
+  if (opt) maxThreads = atoi (opt);
+  if (maxThreads < 1) maxThreads = 1;
+  int requests = 1000000;
+  opt = cmdline->GetOption ("requests");
+  if (opt) requests = atoi (opt);
+  int newPercent = 1;
+  opt = cmdline->GetOption ("new");
+  if (opt) newPercent = atoi (opt);
+
+  csPrintf ("%d requests per thread, %d%% new strings\n", requests,
+    newPercent);
+  for (int n = 1; ; n = csMin (n * 2, maxThreads))
+  {
+    Benchmark<CS::Utility::StringSet<Tag, true> > ("StringSet (locked)", n,
+      requests, newPercent);
+    Benchmark<CS::Utility::ConcurrentStringSet<Tag> > ("ConcurrentStringSet",
+      n, requests, newPercent);
+    if (n == maxThreads) break;
+  }
+  return 0;
+}
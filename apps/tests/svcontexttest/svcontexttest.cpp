@@ -0,0 +1,224 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csgfx/shadervar.h"
+#include "csgfx/shadervarcontext.h"
+#include "csutil/randomgen.h"
+#include "csutil/refarr.h"
+#include "csutil/sysfunc.h"
+
+CS_IMPLEMENT_APPLICATION
+
+static const size_t contextSizes[] = { 4, 16, 64, 256 };
+static const size_t numContextSizes =
+  sizeof (contextSizes) / sizeof (contextSizes[0]);
+static const size_t stackSizes[] = { 256, 1024 };
+static const size_t numStackSizes =
+  sizeof (stackSizes) / sizeof (stackSizes[0]);
+static const size_t numLookups = 1000000;
+static const size_t numMeshes = 10000;
+static const size_t numLayers = 3;
+
+static void PrintTime (const char* what, csMicroTicks ticks, size_t n)
+{
+  csPrintf ("  %-12s %8.2f ns/op\n", what, (ticks * 1000.0) / n);
+}
+
+/// Lookup as done before the names were kept in a flat array
+static csShaderVariable* FindInRefArray (
+  const csRefArray<csShaderVariable>& variables, CS::ShaderVarStringID name)
+{
+  size_t l = 0, r = variables.GetSize ();
+  while (l < r)
+  {
+    size_t m = (l + r) / 2;
+    CS::ShaderVarStringID mName = variables[m]->GetName ();
+    if (mName == name) return variables[m];
+    if (mName < name)
+      l = m + 1;
+    else
+      r = m;
+  }
+  return 0;
+}
+
+/// Push as done before the names were kept in a flat array
+static void PushFromRefArray (const csRefArray<csShaderVariable>& variables,
+                              csShaderVariableStack& stack)
+{
+  for (size_t i = 0; i < variables.GetSize (); ++i)
+  {
+    CS::ShaderVarStringID name = variables[i]->GetName ();
+    if (name >= stack.GetSize ()) return;
+    stack[name] = variables[i];
+  }
+}
+
+/// Fill \a context with \a num variables with names below \a maxName.
+static void FillContext (csShaderVariableContext* context, size_t num,
+                         size_t maxName, csRandomGen& rng)
+{
+  while (context->GetShaderVariables ().GetSize () < num)
+  {
+    CS::ShaderVarStringID name (rng.Get ((uint32)maxName));
+    if (context->GetVariable (name)) continue;
+    csRef<csShaderVariable> sv;
+    sv.AttachNew (new csShaderVariable (name));
+    context->AddVariable (sv);
+  }
+}
+
+static bool BenchmarkLookup (size_t num, csRandomGen& rng)
+{
+  csPrintf ("GetVariable, %zu variables:\n", num);
+  csRef<csShaderVariableContext> context;
+  context.AttachNew (new csShaderVariableContext);
+  FillContext (context, num, num * 4, rng);
+
+  csArray<CS::ShaderVarStringID> keys (numLookups);
+  for (size_t i = 0; i < numLookups; i++)
+    keys.Push (CS::ShaderVarStringID (rng.Get ((uint32)num * 4)));
+
+  // Check the results against the reference before timing anything
+  const csRefArray<csShaderVariable>& variables =
+    context->GetShaderVariables ();
+  bool ok = true;
+  for (size_t i = 0; i < numLookups; i++)
+  {
+    if (context->GetVariable (keys[i]) != FindInRefArray (variables, keys[i]))
+    {
+      csPrintf ("  lookup of %u differs from reference!\n",
+        (uint)keys[i]);
+      ok = false;
+      break;
+    }
+  }
+
+  // The hit counts are printed so the lookups can't be optimized away
+  size_t refFound = 0;
+  csMicroTicks start = csGetMicroTicks ();
+  for (size_t i = 0; i < numLookups; i++)
+    refFound += FindInRefArray (variables, keys[i]) != 0;
+  PrintTime ("csRefArray", csGetMicroTicks () - start, numLookups);
+
+  size_t found = 0;
+  start = csGetMicroTicks ();
+  for (size_t i = 0; i < numLookups; i++)
+    found += context->GetVariable (keys[i]) != 0;
+  PrintTime ("flat names", csGetMicroTicks () - start, numLookups);
+
+  csPrintf ("  hits: %zu / %zu\n", refFound, found);
+  return ok;
+}
+
+static bool BenchmarkStackSetup (size_t numSVNames, csRandomGen& rng)
+{
+  csPrintf ("Stack setup, %zu SV names, %zu meshes, %zu layers:\n",
+    numSVNames, numMeshes, numLayers);
+
+  // A few materials and mesh contexts shared by the meshes
+  const size_t numShared = 16;
+  csRefArray<csShaderVariableContext> materials;
+  csRefArray<csShaderVariableContext> meshContexts;
+  for (size_t i = 0; i < numShared; i++)
+  {
+    csRef<csShaderVariableContext> context;
+    context.AttachNew (new csShaderVariableContext);
+    FillContext (context, 12, numSVNames, rng);
+    materials.Push (context);
+    context.AttachNew (new csShaderVariableContext);
+    FillContext (context, 4, numSVNames, rng);
+    meshContexts.Push (context);
+  }
+
+  // One stack-sized buffer per layer, reused by all meshes
+  const size_t svArraySize = numLayers * numSVNames;
+  csShaderVariable** svArray = (csShaderVariable**)cs_malloc (
+    svArraySize * sizeof (csShaderVariable*));
+  csShaderVariable** refSVArray = (csShaderVariable**)cs_malloc (
+    svArraySize * sizeof (csShaderVariable*));
+  csShaderVariableStack stack;
+
+  // Check the stacks against the reference before timing anything
+  bool ok = true;
+  for (size_t m = 0; ok && (m < numShared * numShared); m++)
+  {
+    memset (svArray, 0, numSVNames * sizeof (csShaderVariable*));
+    memset (refSVArray, 0, numSVNames * sizeof (csShaderVariable*));
+    stack.Setup (refSVArray, numSVNames);
+    PushFromRefArray (materials[m % numShared]->GetShaderVariables (),
+      stack);
+    PushFromRefArray (
+      meshContexts[(m / numShared) % numShared]->GetShaderVariables (),
+      stack);
+    stack.Setup (svArray, numSVNames);
+    materials[m % numShared]->PushVariables (stack);
+    meshContexts[(m / numShared) % numShared]->PushVariables (stack);
+    if (memcmp (svArray, refSVArray,
+        numSVNames * sizeof (csShaderVariable*)) != 0)
+    {
+      csPrintf ("  stack of mesh %zu differs from reference!\n", m);
+      ok = false;
+    }
+  }
+  memset (svArray, 0, svArraySize * sizeof (csShaderVariable*));
+
+  csMicroTicks start = csGetMicroTicks ();
+  for (size_t m = 0; m < numMeshes; m++)
+  {
+    for (size_t l = 0; l < numLayers; l++)
+    {
+      stack.Setup (svArray + l * numSVNames, numSVNames);
+      PushFromRefArray (materials[m % numShared]->GetShaderVariables (),
+        stack);
+      PushFromRefArray (
+        meshContexts[(m / numShared) % numShared]->GetShaderVariables (),
+        stack);
+    }
+  }
+  PrintTime ("csRefArray", csGetMicroTicks () - start, numMeshes * numLayers);
+
+  start = csGetMicroTicks ();
+  for (size_t m = 0; m < numMeshes; m++)
+  {
+    for (size_t l = 0; l < numLayers; l++)
+    {
+      stack.Setup (svArray + l * numSVNames, numSVNames);
+      materials[m % numShared]->PushVariables (stack);
+      meshContexts[(m / numShared) % numShared]->PushVariables (stack);
+    }
+  }
+  PrintTime ("flat names", csGetMicroTicks () - start, numMeshes * numLayers);
+
+  cs_free (refSVArray);
+  cs_free (svArray);
+  return ok;
+}
+
+int main (int, char*[])
+{
+  csRandomGen rng (0x5eed);
+  bool ok = true;
+  for (size_t c = 0; c < numContextSizes; c++)
+    ok &= BenchmarkLookup (contextSizes[c], rng);
+  csPrintf ("\n");
+  for (size_t s = 0; s < numStackSizes; s++)
+    ok &= BenchmarkStackSetup (stackSizes[s], rng);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Measures how fast the TinyXML document system parses the XML files
+   shipped in data/. Also prints a checksum over everything the iDocument
+   API returns for the parsed documents, which must not change when the
+   parser is changed.
+   Options:
+     -path=<dir>       Directory to scan (default: the data directory)
+     -iterations=<n>   Times each file is parsed (default: 5)
+     -collapse         Condense white space while parsing */
+
+#include "cssysdef.h"
+#include <ctype.h>
+#include "cstool/initapp.h"
+#include "csutil/csstring.h"
+#include "csutil/refarr.h"
+#include "csutil/stringarray.h"
+#include "csutil/sysfunc.h"
+#include "csutil/xmltiny.h"
+#include "iutil/cmdline.h"
+#include "iutil/databuff.h"
+#include "iutil/document.h"
+#include "iutil/stringarray.h"
+#include "iutil/vfs.h"
+
+CS_IMPLEMENT_APPLICATION
+
+/// VFS directory the scanned directory is mounted at
+static const char* mountPoint = "/xmltinytest/";
+
+/// Collect the files below a VFS directory that look like XML
+static void CollectFiles (iVFS* vfs, const char* dir,
+                          csRefArray<iDataBuffer>& files,
+                          csStringArray& names)
+{
+  csRef<iStringArray> entries (vfs->FindFiles (dir));
+  for (size_t i = 0; i < entries->GetSize (); i++)
+  {
+    const char* entry = entries->Get (i);
+    size_t len = strlen (entry);
+    if ((len > 0) && (entry[len - 1] == '/'))
+    {
+      CollectFiles (vfs, entry, files, names);
+      continue;
+    }
+    csRef<iDataBuffer> data (vfs->ReadFile (entry, false));
+    if (!data || (data->GetSize () == 0)) continue;
+    const char* p = data->GetData ();
+    const char* end = p + data->GetSize ();
+    while ((p < end) && isspace ((unsigned char)*p)) p++;
+    if ((p == end) || (*p != '<')) continue;
+    if (memchr (data->GetData (), 0, data->GetSize ()) != 0) continue;
+    files.Push (data);
+    names.Push (entry);
+  }
+}
+
+static inline void HashString (uint32& hash, const char* str)
+{
+  // FNV-1a, including the terminator so that value boundaries count
+  if (!str) str = "";
+  do
+  {
+    hash = (hash ^ (unsigned char)*str) * 16777619u;
+  }
+  while (*str++);
+}
+
+/// Hash everything the document API returns for a node and its children
+static void HashNode (uint32& hash, iDocumentNode* node)
+{
+  csString type;
+  type.Format ("%d", int (node->GetType ()));
+  HashString (hash, type);
+  HashString (hash, node->GetValue ());
+  csRef<iDocumentAttributeIterator> attrs (node->GetAttributes ());
+  while (attrs->HasNext ())
+  {
+    csRef<iDocumentAttribute> attr (attrs->Next ());
+    HashString (hash, attr->GetName ());
+    HashString (hash, attr->GetValue ());
+  }
+  csRef<iDocumentNodeIterator> children (node->GetNodes ());
+  while (children->HasNext ())
+  {
+    csRef<iDocumentNode> child (children->Next ());
+    HashNode (hash, child);
+  }
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+  if (!csInitializer::RequestPlugins (object_reg, CS_REQUEST_VFS,
+      CS_REQUEST_END))
+  {
+    csPrintf ("Could not load VFS\n");
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+
+  csRef<iCommandLineParser> cmdline (
+    csQueryRegistry<iCommandLineParser> (object_reg));
+  csRef<iVFS> vfs (csQueryRegistry<iVFS> (object_reg));
+  const char* path = cmdline->GetOption ("path");
+  csString realPath;
+  if (path)
+    realPath.Format ("%s%c", path, CS_PATH_SEPARATOR);
+  else
+    realPath = "$@data$/";
+  int iterations = 5;
+  const char* iterStr = cmdline->GetOption ("iterations");
+  if (iterStr) iterations = csMax (atoi (iterStr), 1);
+  bool collapse = cmdline->GetBoolOption ("collapse", false);
+
+  if (!vfs->Mount (mountPoint, realPath))
+  {
+    csPrintf ("Could not mount %s\n", realPath.GetData ());
+    csInitializer::DestroyApplication (object_reg);
+    return 1;
+  }
+  csRefArray<iDataBuffer> files;
+  csStringArray names;
+  CollectFiles (vfs, mountPoint, files, names);
+  size_t totalSize = 0;
+  for (size_t i = 0; i < files.GetSize (); i++)
+    totalSize += files[i]->GetSize ();
+  csPrintf ("%zu XML files, %.2f MB\n", files.GetSize (),
+    totalSize / (1024.0 * 1024.0));
+
+  csRef<iDocumentSystem> docsys;
+  docsys.AttachNew (new csTinyDocumentSystem ());
+
+  // Check the files and compute the checksum of the parsed documents.
+  uint32 checksum = 2166136261u;
+  size_t failed = 0;
+  for (size_t i = 0; i < files.GetSize (); i++)
+  {
+    csRef<iDocument> doc (docsys->CreateDocument ());
+    const char* error = doc->Parse (files[i], collapse);
+    if (error)
+    {
+      csPrintf ("%s: %s\n", names[i], error);
+      HashString (checksum, error);
+      failed++;
+      continue;
+    }
+    csRef<iDocumentNode> root (doc->GetRoot ());
+    HashNode (checksum, root);
+  }
+  csPrintf ("checksum %08x, %zu files failed to parse\n", checksum, failed);
+
+  // Parse (and release) all documents; the fastest iteration counts.
+  csMicroTicks best = 0;
+  for (int it = 0; it < iterations; it++)
+  {
+    csMicroTicks start = csGetMicroTicks ();
+    for (size_t i = 0; i < files.GetSize (); i++)
+    {
+      csRef<iDocument> doc (docsys->CreateDocument ());
+      doc->Parse (files[i], collapse);
+    }
+    csMicroTicks ticks = csGetMicroTicks () - start;
+    if ((it == 0) || (ticks < best)) best = ticks;
+  }
+  csPrintf ("parse: %10.3f ms  %8.2f MB/s\n", best / 1000.0,
+    (totalSize / (1024.0 * 1024.0)) / csMax (best / 1000000.0, 1e-6));
+
+  vfs->Unmount (mountPoint, realPath);
+  // The buffers were created by VFS and must go before it is unloaded
+  files.DeleteAll ();
+  docsys.Invalidate ();
+  vfs.Invalidate ();
+  cmdline.Invalidate ();
+  csInitializer::DestroyApplication (object_reg);
+  return 0;
+}
@@ -79,11 +79,90 @@ void DocConv::CloneNode (iDocumentNode* from, iDocumentNode* to)
   }
 }
 
+static bool ValuesMatch (const char* v1, const char* v2)
+{
+  if (!v1) v1 = "";
+  if (!v2) v2 = "";
+  return strcmp (v1, v2) == 0;
+}
+
+bool DocConv::CompareNode (iDocumentNode* from, iDocumentNode* to,
+			   const char* path)
+{
+  csString nodePath;
+  nodePath.Format ("%s/%s", path, from->GetValue ());
+  if (from->GetType () != to->GetType ())
+  {
+    ReportError ("Verification failed: node %s has a different type!",
+      CS::Quote::Single (nodePath.GetData ()));
+    return false;
+  }
+  if (!ValuesMatch (from->GetValue (), to->GetValue ()))
+  {
+    ReportError ("Verification failed: node %s has value %s!",
+      CS::Quote::Single (nodePath.GetData ()),
+      CS::Quote::Single (to->GetValue ()));
+    return false;
+  }
+
+  // Attributes may be reordered by the document system.
+  size_t numAttrs = 0;
+  csRef<iDocumentAttributeIterator> atit = from->GetAttributes ();
+  while (atit->HasNext ())
+  {
+    csRef<iDocumentAttribute> attr = atit->Next ();
+    csRef<iDocumentAttribute> toAttr = to->GetAttribute (attr->GetName ());
+    if (!toAttr || !ValuesMatch (attr->GetValue (), toAttr->GetValue ()))
+    {
+      ReportError ("Verification failed: attribute %s of node %s differs!",
+	CS::Quote::Single (attr->GetName ()),
+	CS::Quote::Single (nodePath.GetData ()));
+      return false;
+    }
+    numAttrs++;
+  }
+  atit = to->GetAttributes ();
+  while (atit->HasNext ())
+  {
+    atit->Next ();
+    numAttrs--;
+  }
+  if (numAttrs != 0)
+  {
+    ReportError ("Verification failed: node %s has additional attributes!",
+      CS::Quote::Single (nodePath.GetData ()));
+    return false;
+  }
+
+  csRef<iDocumentNodeIterator> it = from->GetNodes ();
+  csRef<iDocumentNodeIterator> toIt = to->GetNodes ();
+  while (it->HasNext ())
+  {
+    csRef<iDocumentNode> child = it->Next ();
+    if (!toIt->HasNext ())
+    {
+      ReportError ("Verification failed: node %s is missing children!",
+	CS::Quote::Single (nodePath.GetData ()));
+      return false;
+    }
+    csRef<iDocumentNode> toChild = toIt->Next ();
+    if (!CompareNode (child, toChild, nodePath)) return false;
+  }
+  if (toIt->HasNext ())
+  {
+    ReportError ("Verification failed: node %s has additional children!",
+      CS::Quote::Single (nodePath.GetData ()));
+    return false;
+  }
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 
 DocConv::DocConv ()
 {
   object_reg = 0;
+  verify = false;
 }
 
 DocConv::~DocConv ()
@@ -181,8 +260,11 @@ void DocConv::ConvertFile(const char* val, csRef<iDocumentSystem> inputDS, csRef
 	csTicks cloning_end = csGetTicks();
 	Report (CS_REPORTER_SEVERITY_NOTIFY, " time taken: %f s",
 	  (float)(cloning_end - cloning_start) / (float)1000);
-	root = 0;
-	doc = 0;
+	if (!verify)
+	{
+	  root = 0;
+	  doc = 0;
+	}
 	Report (CS_REPORTER_SEVERITY_NOTIFY, "Writing...");
 	csTicks writing_start = csGetTicks();
         error = newdoc->Write (vfs, filename);
@@ -201,6 +283,34 @@ void DocConv::ConvertFile(const char* val, csRef<iDocumentSystem> inputDS, csRef
 	newdoc = 0;
 	Report (CS_REPORTER_SEVERITY_NOTIFY, "Updating VFS...");
 	vfs->Sync();
+
+	if (verify)
+	{
+	  /* Read the written file back the way the loader would (binary
+	     documents get mapped into memory) and compare with the source. */
+	  Report (CS_REPORTER_SEVERITY_NOTIFY, "Verifying...");
+	  csTicks verify_start = csGetTicks();
+	  csRef<iFile> file = vfs->Open (filename, VFS_FILE_READ);
+	  if (!file)
+	  {
+	    ReportError ("Could not reopen %s!",
+	      CS::Quote::Single ((const char*)filename));
+	    return;
+	  }
+	  csRef<iDocument> checkdoc = newsys->CreateDocument ();
+	  error = checkdoc->Parse (file, true);
+	  if (error != 0)
+	  {
+	    ReportError ("Error parsing written document: %s!", error);
+	    return;
+	  }
+	  csRef<iDocumentNode> checkroot = checkdoc->GetRoot ();
+	  if (!CompareNode (root, checkroot, ""))
+	    return;
+	  csTicks verify_end = csGetTicks();
+	  Report (CS_REPORTER_SEVERITY_NOTIFY, " time taken: %f s",
+	    (float)(verify_end - verify_start) / (float)1000);
+	}
       }
       break;
   }
@@ -222,6 +332,7 @@ void DocConv::Main ()
     op = OP_TRANSLATE;
 
   if (cmdline->GetOption ("help")) op = OP_HELP;
+  verify = cmdline->GetOption ("verify") != 0;
 
   if (op == OP_HELP)
   {
@@ -232,6 +343,9 @@ void DocConv::Main ()
     csPrintf ("     Document system plugin for reading world.\n");
     csPrintf ("  -outds=<plugin>:\n");       
     csPrintf ("     Document system plugin for writing world.\n");
+    csPrintf ("  -verify:\n");
+    csPrintf ("     Read the written world back and compare it with the "
+      "source.\n");
     return;
   }
 
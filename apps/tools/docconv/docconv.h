@@ -55,6 +55,8 @@ public:
   csRef<iVFS> vfs;
   csRef<iCommandLineParser> cmdline;
   csRef<iPluginManager> plugin_mgr;
+  /// Read written documents back and compare them with the source.
+  bool verify;
 
   void ReportError (const char* description, ...);
   void Report (int severity, const char* description, ...);
@@ -63,6 +65,11 @@ public:
    * Clone a node and children.
    */
   void CloneNode (iDocumentNode* from, iDocumentNode* to);
+  /**
+   * Compare a node and children, report the first difference.
+   */
+  bool CompareNode (iDocumentNode* from, iDocumentNode* to,
+    const char* path);
 
   //-----------------------------------------------------------------------
 
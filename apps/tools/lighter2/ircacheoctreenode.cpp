@@ -108,7 +108,7 @@ namespace lighter
   }
 
   void OctreeSampleNode::FindSamples(const IrradianceSample *samp,
-                          NearestSamples* &nearest)
+                          NearestSamples &nearest) const
   {
     globalStats.photonmapping.irCacheLookups++;
 
@@ -122,9 +122,8 @@ namespace lighter
         if(weight > 1.0/alpha)
         {
           {
-            nearest->samples[nearest->count] = Pi;
-            nearest->weights[nearest->count] = weight;
-            nearest->count++;
+            nearest.samples.Push(Pi);
+            nearest.weights.Push(weight);
           }
         }
       }
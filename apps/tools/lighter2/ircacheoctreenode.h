@@ -25,9 +25,8 @@ namespace lighter
 
   struct NearestSamples
   {
-    size_t count;
-    float *weights;
-    IrradianceSample **samples;
+    csArray<float> weights;
+    csArray<IrradianceSample*> samples;
   };
 
   class OctreeSampleNode
@@ -57,7 +56,7 @@ namespace lighter
 
     void AddSample(const size_t newNode);
     void SetBoundingBox(const float newMin[3], const float newMax[3]);
-    void FindSamples(const IrradianceSample *samp, NearestSamples* &nearest);
+    void FindSamples(const IrradianceSample *samp, NearestSamples &nearest) const;
   };
 
 };
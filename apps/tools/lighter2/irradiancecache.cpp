@@ -52,7 +52,7 @@ namespace lighter
                            const float power[3],
                            const float mean)
   {
-    CS::Threading::MutexScopedLock lock(writeMutex);
+    CS::Threading::ScopedWriteLock lock(cacheMutex);
 
     // Check for storage and attempt to expand if needed
     if (storedSamples>=maxSamples && !Expand())
@@ -77,62 +77,48 @@ namespace lighter
       const float pos[3], const float norm[3], float (&power)[3])
   {
     // Put in sample struct
-    IrradianceSample* samp = new IrradianceSample();
-    samp->pos[0] = pos[0];
-    samp->pos[1] = pos[1];
-    samp->pos[2] = pos[2];
-    samp->norm[0] = norm[0];
-    samp->norm[1] = norm[1];
-    samp->norm[2] = norm[2];
-
-    // Build nearest struct
-    NearestSamples* nearest = new NearestSamples();
-    nearest->weights = new float[storedSamples];
-    nearest->samples = new IrradianceSample*[storedSamples];
-    nearest->count = 0;
-
-    // Search Octree
-    root->FindSamples(samp, nearest);
+    IrradianceSample samp;
+    samp.pos[0] = pos[0];
+    samp.pos[1] = pos[1];
+    samp.pos[2] = pos[2];
+    samp.norm[0] = norm[0];
+    samp.norm[1] = norm[1];
+    samp.norm[2] = norm[2];
+
+    // Search Octree, samples can't move while the lock is held
+    CS::Threading::ScopedReadLock lock(cacheMutex);
+    NearestSamples nearest;
+    root->FindSamples(&samp, nearest);
 
     // Check results
-    bool result = false;
-    if(nearest->count > 0)
+    if(nearest.samples.IsEmpty())
+      return false;
+
+    // Compute irradiance estimate
+    power[0] = power[1] = power[2] = 0.0;
+    float weightSum = 0.0;
+
+    for(size_t i = 0; i < nearest.samples.GetSize(); ++i)
     {
-      // Compute irradiance estimate
-      power[0] = power[1] = power[2] = 0.0;
-      float weightSum = 0.0;
-
-      for(size_t i = 0; i < nearest->count; ++i)
-      {
-        // Get local copies of data
-        IrradianceSample* Pi = nearest->samples[i];
-        float Wi = nearest->weights[i];
-
-        // Add weighted power contribution
-        power[0] += Pi->power[0]*Wi;
-        power[1] += Pi->power[1]*Wi;
-        power[2] += Pi->power[2]*Wi;
-
-        // Sum weights
-        weightSum += Wi;
-      }
-
-      // Normalize estimate
-      power[0] /= weightSum;
-      power[1] /= weightSum;
-      power[2] /= weightSum;
-
-      // Signal success
-      result = true;
+      // Get local copies of data
+      IrradianceSample* Pi = nearest.samples[i];
+      float Wi = nearest.weights[i];
+
+      // Add weighted power contribution
+      power[0] += Pi->power[0]*Wi;
+      power[1] += Pi->power[1]*Wi;
+      power[2] += Pi->power[2]*Wi;
+
+      // Sum weights
+      weightSum += Wi;
     }
 
-    // free temporary memory
-    delete samp;
-    delete[] nearest->weights;
-    delete[] nearest->samples;
-    delete nearest;
+    // Normalize estimate
+    power[0] /= weightSum;
+    power[1] /= weightSum;
+    power[2] /= weightSum;
 
-    return result;
+    return true;
   }
 
 
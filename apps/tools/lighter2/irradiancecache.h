@@ -61,6 +61,8 @@ namespace lighter
      * by Ward et al. and determine if it can be averged from values
      * already in the cache.  If so, it will place the estimate in
      * 'power' and return true.  If not, it will return false.
+     * Estimates may be computed from several threads, also while samples
+     * are stored.
      * /param pos - The world position at which to compute irradiance
      * /param norm - The surface normal at pos
      * /param power - On return, holds the irradiance at pos
@@ -84,7 +86,8 @@ namespace lighter
     size_t storedSamples;   ///< Number of samples stored in the internal array
     size_t maxSamples;      ///< Actual allocated size of sample array
 
-    CS::Threading::Mutex writeMutex;  //< Mutex for the store operations
+    /// Store operations lock exclusively, estimates shared
+    CS::Threading::ReadWriteMutex cacheMutex;
   };
 };
 
@@ -91,6 +91,7 @@ namespace lighter
     s.ray.minLength = FLT_EPSILON*10.0f;
     s.ray.maxLength = maxL - FLT_EPSILON*10.0f;
     s.ray.ignoreFlags = KDPRIM_FLAG_NOSHADOW; // Ignore primitives that don't cast shadows
+    s.ray.type = RAY_TYPE_SHADOW;
     s.ray.rayID = ++rayID; // Give unique IDs to rays; needed for the ray debugger.
     s.tree = tree;
 
@@ -223,6 +224,86 @@ namespace lighter
     return (transparentHits.GetSize() != 0) ? occlPartial : occlUnoccluded;
   }
     
+  void VisibilityTester::Occlusion (VisibilityTester* const* testers,
+    size_t num, const Object* ignoreObject, const Primitive* ignorePrim,
+    OcclusionState* results)
+  {
+    OcclusionPacket (testers, num, ignoreObject, ignorePrim, 0, results);
+  }
+
+  void VisibilityTester::Occlusion (VisibilityTester* const* testers,
+    size_t num, const Object* ignoreObject, HitIgnoreCallback* ignoreCB,
+    OcclusionState* results)
+  {
+    OcclusionPacket (testers, num, ignoreObject, 0, ignoreCB, results);
+  }
+
+  void VisibilityTester::OcclusionPacket (VisibilityTester* const* testers,
+    size_t num, const Object* ignoreObject, const Primitive* ignorePrim,
+    HitIgnoreCallback* ignoreCB, OcclusionState* results)
+  {
+    // The ray debugger wants to see every hit, trace one by one then
+    const bool usePackets = !globalLighter->rayDebug.IsEnabled();
+
+    Ray rays[Raytracer::PACKET_SIZE];
+    HitPoint hits[Raytracer::PACKET_SIZE];
+    size_t packetTesters[Raytracer::PACKET_SIZE];
+    size_t packetSize = 0;
+    KDTree* packetTree = 0;
+
+    for (size_t i = 0; i <= num; i++)
+    {
+      VisibilityTester* tester = (i < num) ? testers[i] : 0;
+      const bool inPacket = usePackets && tester
+        && (tester->allSegments.GetSize () == 1);
+
+      // Trace the collected packet once it is complete
+      if ((packetSize > 0) && (!tester 
+        || (packetSize == Raytracer::PACKET_SIZE)
+        || (inPacket && (tester->allSegments[0].tree != packetTree))))
+      {
+        uint hitMask = 0;
+        if (packetSize > 1)
+          hitMask = Raytracer::TraceAnyHitPacket (packetTree, rays,
+            packetSize, hits, ignoreCB);
+
+        for (size_t p = 0; p < packetSize; p++)
+        {
+          const size_t t = packetTesters[p];
+          if ((packetSize > 1) && !(hitMask & (1 << p)))
+            results[t] = occlUnoccluded;
+          else if ((packetSize > 1)
+            && !(hits[p].kdFlags & KDPRIM_FLAG_TRANSPARENT))
+            results[t] = occlOccluded;
+          else if (ignoreCB)
+            // Transparent hits need all hits along the segment
+            results[t] = testers[t]->Occlusion (ignoreObject, ignoreCB);
+          else
+            results[t] = testers[t]->Occlusion (ignoreObject, ignorePrim);
+        }
+        packetSize = 0;
+      }
+
+      if (!tester) break;
+
+      if (inPacket)
+      {
+        Segment& s = tester->allSegments[0];
+        s.ray.ignoreObject = ignoreObject;
+        if (!ignoreCB) s.ray.ignorePrimitive = ignorePrim;
+
+        rays[packetSize] = s.ray;
+        packetTesters[packetSize] = i;
+        packetTree = s.tree;
+        packetSize++;
+      }
+      else if (ignoreCB)
+        results[i] = tester->Occlusion (ignoreObject, ignoreCB);
+      else
+        results[i] = tester->Occlusion (ignoreObject, ignorePrim);
+    }
+  }
+
   csColor VisibilityTester::GetFilterColor ()
   {
     csColor c (1, 1, 1);
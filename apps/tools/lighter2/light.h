@@ -49,6 +49,20 @@ namespace lighter
     OcclusionState Occlusion (const Object* ignoreObject,
       HitIgnoreCallback* ignoreCB);
 
+    //@{
+    /**
+     * Test the occlusion of several testers at once, as Occlusion() does
+     * for each of them. Testers with a single segment in the same kd-tree
+     * are traced together as ray packets.
+     */
+    static void Occlusion (VisibilityTester* const* testers, size_t num,
+      const Object* ignoreObject, const Primitive* ignorePrim,
+      OcclusionState* results);
+    static void Occlusion (VisibilityTester* const* testers, size_t num,
+      const Object* ignoreObject, HitIgnoreCallback* ignoreCB,
+      OcclusionState* results);
+    //@}
+
     
     csColor GetFilterColor ();
 
@@ -71,6 +85,10 @@ namespace lighter
     };
     csArray<Segment> allSegments;
 
+    static void OcclusionPacket (VisibilityTester* const* testers, size_t num,
+      const Object* ignoreObject, const Primitive* ignorePrim,
+      HitIgnoreCallback* ignoreCB, OcclusionState* results);
+
     csArray<HitPoint> transparentHits;
     struct HitCallback : public HitPointCallback
     {
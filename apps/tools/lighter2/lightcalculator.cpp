@@ -26,6 +26,62 @@
 
 namespace lighter
 {
+  LightmapCommitQueue::LightmapCommitQueue (size_t numTiles)
+    : committed (numTiles), nextTile (0)
+  {
+    pending.SetSize (numTiles);
+  }
+
+  void LightmapCommitQueue::Commit (size_t tile,
+    LightmapContributionArray& contributions)
+  {
+    CS::Threading::MutexScopedLock lock (mutex);
+
+    if (tile != nextTile)
+    {
+      // Keep until the preceding tiles are done
+      contributions.TransferTo (pending[tile]);
+      committed.SetBit (tile);
+      return;
+    }
+
+    Apply (contributions);
+    contributions.DeleteAll ();
+    nextTile++;
+    while ((nextTile < pending.GetSize ()) && committed.IsBitSet (nextTile))
+    {
+      Apply (pending[nextTile]);
+      pending[nextTile].DeleteAll ();
+      nextTile++;
+    }
+  }
+
+  void LightmapCommitQueue::Apply (
+    const LightmapContributionArray& contributions)
+  {
+    // Lock each lightmap once, a tile only touches a few of them
+    csArray<Lightmap*> lightmaps;
+    for (size_t i = 0; i < contributions.GetSize (); i++)
+    {
+      Lightmap* lm = contributions[i].lightmap;
+      if (lightmaps.Find (lm) == csArrayItemNotFound)
+      {
+        lm->Lock ();
+        lightmaps.Push (lm);
+      }
+    }
+
+    for (size_t i = 0; i < contributions.GetSize (); i++)
+    {
+      const LightmapContribution& contribution = contributions[i];
+      contribution.lightmap->SetAddPixel (contribution.u, contribution.v,
+        contribution.color);
+    }
+
+    for (size_t i = 0; i < lightmaps.GetSize (); i++)
+      lightmaps[i]->Unlock ();
+  }
+
   //--------------------------------------------------------------------------
   LightCalculator::LightCalculator (const csVector3& tangentSpaceNorm, 
                                     size_t subLightmapNum)
@@ -45,49 +101,37 @@ namespace lighter
     componentOffset.push_back(offset);
   }
 
-  void LightCalculator::ComputeObjectGroupLighting( csArray<csRef<lighter::Object> >* objGroup,
+  void LightCalculator::ComputeObjectTileLighting (Object* obj,
+    size_t first, size_t last, SamplerSequence<2>& masterSampler,
+    LightmapContributionArray& contributions,
     Statistics::ProgressState& progState)
   {
-    // Initialize the sampler
-    SamplerSequence<2> masterSampler;
-
-    Sector* sector = objGroup->Get(0)->GetSector();
+    Sector* sector = obj->GetSector();
 
     // Resize the effecting light list in each component
     for(size_t i=0; i<component.size(); i++)
       component[i]->resizeAffectingLights( sector->allNonPDLights.GetSize ());
 
-    // Reset the object looper and loop though all object again
-    csArray<csRef<lighter::Object> >::Iterator objIterator = objGroup->GetIterator();
-    while (objIterator.HasNext ())
-    {
-      // Get reference to next object
-      csRef<Object> obj = objIterator.Next ();
-
-      // Skip unlight objects
-      if (!obj->GetFlags ().Check (OBJECT_FLAG_NOLIGHT))
-      {
-        // Create the list of affecting lights in each component
-        ComputeAffectingLights (obj);
+    // Create the list of affecting lights in each component
+    ComputeAffectingLights (obj);
 
-        // Either light per vertex or add light to the lightmap
-        if (obj->lightPerVertex)
-        {
-          ComputeObjectStaticLightingForVertex (
-            sector, obj, masterSampler,progState);
-        }
-        else
-        {
-          ComputeObjectStaticLightingForLightmap (
-            sector, obj, masterSampler,progState);
-        }
-      }
+    // Either light per vertex or add light to the lightmap
+    if (obj->lightPerVertex)
+    {
+      ComputeObjectStaticLightingForVertex (
+        sector, obj, first, last, masterSampler, progState);
+    }
+    else
+    {
+      ComputeObjectStaticLightingForLightmap (
+        sector, obj, first, last, masterSampler, contributions, progState);
     }
   }
 
   void LightCalculator::ComputeObjectStaticLightingForLightmap (
-    Sector* sector, Object* obj, 
+    Sector* sector, Object* obj, size_t firstPrim, size_t lastPrim,
     SamplerSequence<2>& masterSampler,
+    LightmapContributionArray& contributions,
     Statistics::ProgressState& progState)
   {
     // Get submesh list for looping through elements
@@ -110,14 +154,20 @@ namespace lighter
       }
     }
 
-    // Loop through all submesh elements
+    // Loop through all submesh elements, primitives are numbered across
+    // the submeshes
+    size_t primIndex = 0;
     for (size_t submesh = 0; submesh < submeshArray.GetSize (); ++submesh)
     {
       // Loop through all element primitives    
       PrimitiveArray& primArray = submeshArray[submesh];
 
-      for (size_t pidx = 0; pidx < primArray.GetSize (); ++pidx)
+      for (size_t pidx = 0; pidx < primArray.GetSize (); ++pidx, ++primIndex)
       {
+        // Only light the primitives of this tile
+        if (primIndex < firstPrim) continue;
+        if (primIndex >= lastPrim) return;
+
         // Get next primitive
         Primitive& prim = primArray[pidx];
 
@@ -125,9 +175,6 @@ namespace lighter
         Lightmap* normalLM = sector->scene->GetLightmap (
           prim.GetGlobalLightmapID (), subLightmapNum, (Light*)0);
 
-        // Lock access to this lightmap
-        ScopedSwapLock<Lightmap> lightLock (*normalLM);
-
         // This seems to have something to do with specular maps but I'm unsure ??
         bool recordInfluence =
           globalConfig.GetLighterProperties().specularDirectionMaps
@@ -137,12 +184,9 @@ namespace lighter
         csArray<Lightmap*> pdLightLMs;
         for (size_t pdli = 0; pdli < PDLights.GetSize (); ++pdli)
         {
-          // Get reference to this light's lightmap
+          // Get reference to this light's lightmap and add it to the list
           Lightmap* lm = sector->scene->GetLightmap (prim.GetGlobalLightmapID (),
             subLightmapNum, PDLights[pdli]);
-
-          // Lock the lightmap for local use only and add it to the list
-          lm->Lock ();
           pdLightLMs.Push (lm);
         }
 
@@ -188,7 +232,12 @@ namespace lighter
           }
 
           // Update the normal lightmap
-          normalLM->SetAddPixel (u, v, c * pixelAreaPart);
+          LightmapContribution contribution;
+          contribution.lightmap = normalLM;
+          contribution.u = u;
+          contribution.v = v;
+          contribution.color = c * pixelAreaPart;
+          contributions.Push (contribution);
 
           // Loop through pseudo-dynamic lights
           for (size_t pdli = 0; pdli < PDLights.GetSize (); ++pdli)
@@ -214,27 +263,21 @@ namespace lighter
             }
 
             // Update this light's light map
-            lm->SetAddPixel (u, v, c * pixelAreaPart);
+            contribution.lightmap = lm;
+            contribution.color = c * pixelAreaPart;
+            contributions.Push (contribution);
           }
 
           // Done with one primitive element
           // Advance the task progress indicator
           progState.Advance ();
         }
-
-        // Release the locks on the pseudo-dynamic light maps
-        // for this object
-        for (size_t pdli = 0; pdli < PDLights.GetSize (); ++pdli)
-        {
-          pdLightLMs[pdli]->Unlock();
-        }
-
       }   // End primitive loop
     }     // End submesh element loop
   }       // End function
 
   void LightCalculator::ComputeObjectStaticLightingForVertex (
-    Sector* sector, Object* obj, 
+    Sector* sector, Object* obj, size_t firstVertex, size_t lastVertex,
     SamplerSequence<2>& masterSampler,
     Statistics::ProgressState& progState)
   {
@@ -253,7 +296,7 @@ namespace lighter
       }
     }
 
-    for (size_t i = 0; i < vdata.positions.GetSize (); ++i)
+    for (size_t i = firstVertex; i < lastVertex; ++i)
     {
       csColor& c = litColors->Get (i);
       const csVector3& normal = ComputeVertexNormal (obj, i);
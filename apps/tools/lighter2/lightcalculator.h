@@ -31,8 +31,44 @@ namespace lighter
 {
   // Forward declarations to avoid unnecessary includes
   class LightComponent;
+  class Lightmap;
   class Sector;
   class Object;
+
+  /// Lightmap pixel contribution computed by a lighting tile
+  struct LightmapContribution
+  {
+    Lightmap* lightmap;
+    size_t u, v;
+    csColor color;
+  };
+  typedef csArray<LightmapContribution> LightmapContributionArray;
+
+  /**
+   * Adds the lightmap contributions of the tiles of one object to the
+   * lightmaps in tile order, whatever the order the tiles finish in.
+   * Pixels on primitive borders receive contributions from several tiles,
+   * so this keeps the lightmaps independent of the thread scheduling.
+   */
+  class LightmapCommitQueue : public csRefCount
+  {
+  public:
+    LightmapCommitQueue (size_t numTiles);
+
+    /**
+     * Hand over the contributions of a tile. They are added as soon as
+     * those of all preceding tiles have been. \a contributions is emptied.
+     */
+    void Commit (size_t tile, LightmapContributionArray& contributions);
+
+  private:
+    void Apply (const LightmapContributionArray& contributions);
+
+    CS::Threading::Mutex mutex;
+    csArray<LightmapContributionArray> pending;
+    csBitArray committed;
+    size_t nextTile;
+  };
   
   // Class to calculate direct lighting
   class LightCalculator : public ThreadedCallable<LightCalculator>,
@@ -49,18 +85,26 @@ namespace lighter
 
     void addComponent(LightComponent* newComponent, float scaler = 1.0, float offset = 0.0);
 
-    // Loop through an ObjectArray from the same sector and calculate the
-    // static light using all attached LightComponents
-    void ComputeObjectGroupLighting( csArray<csRef<lighter::Object> >* objGroup,
+    // Calculate the static light of a tile of an object using all attached
+    // LightComponents. A tile is the range [first, last) of the primitives
+    // of a lightmapped object or of the vertices of a per-vertex lit one.
+    // Lightmap light is appended to contributions instead of being added
+    // to the lightmaps, vertex light is stored in the object directly.
+    void ComputeObjectTileLighting (Object* obj, size_t first, size_t last,
+      SamplerSequence<2>& masterSampler,
+      LightmapContributionArray& contributions,
       Statistics::ProgressState& progState);
 
   private:
     void ComputeObjectStaticLightingForLightmap (Sector* sector,
-        Object* obj, SamplerSequence<2>& masterSampler,
+        Object* obj, size_t firstPrim, size_t lastPrim,
+        SamplerSequence<2>& masterSampler,
+        LightmapContributionArray& contributions,
         Statistics::ProgressState& progState);
 
     void ComputeObjectStaticLightingForVertex (Sector* sector,
-        Object* obj, SamplerSequence<2>& masterSampler,
+        Object* obj, size_t firstVertex, size_t lastVertex,
+        SamplerSequence<2>& masterSampler,
         Statistics::ProgressState& progState);
 
     void ComputeAffectingLights (Object* obj);
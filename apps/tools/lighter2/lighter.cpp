@@ -34,6 +34,7 @@
 #include "photonmapperlighting.h"
 #include "sampler.h"
 #include <csutil/floatrand.h>
+#include <csutil/workstealingjobqueue.h>
 
 CS_IMPLEMENT_APPLICATION
 
@@ -157,17 +158,11 @@ namespace lighter
 
     rayDebug.SetFilterExpression (globalConfig.GetDebugProperties().rayDebugRE);
 
-    // Setup the job manager
-/*    if (globalConfig.GetLighterProperties ().numThreads <= 1)
-    {
-      jobManager.AttachNew (new CS::Utility::SimpleJobQueue);
-    }
-    else*/
-    {
-      /*jobManager.AttachNew (new CS::Threading::ThreadedJobQueue (
-        globalConfig.GetLighterProperties ().numThreads*/
-
-    }
+    // Setup the job manager. Lighting is computed in many small tiles of
+    // uneven cost, which the work stealing queue balances across threads.
+    jobManager.AttachNew (new CS::Threading::WorkStealingJobQueue (
+      csMax (globalConfig.GetLighterProperties ().numThreads, 1u),
+      CS::Threading::THREAD_PRIO_NORMAL, "lighter2"));
 
     // Initialize the TUI
     globalTUI.Redraw ();
@@ -513,6 +508,26 @@ namespace lighter
     progPrepareLightingSector.SetProgress (1);
   }
 
+  namespace
+  {
+    // Job doing the post-processing of one lightmap
+    class FixupLightmapJob : public scfImplementation1<FixupLightmapJob, iJob>
+    {
+    public:
+      FixupLightmapJob (Lightmap* lightmap, const LightmapMask& mask)
+        : scfImplementationType (this), lightmap (lightmap), mask (mask) {}
+
+      void Run ()
+      {
+        lightmap->FixupLightmap (mask);
+      }
+
+    private:
+      Lightmap* lightmap;
+      const LightmapMask& mask;
+    };
+  }
+
   void Lighter::PostprocessLightmaps ()
   {
     size_t realNumLMs = scene->GetLightmaps ().GetSize ();
@@ -572,13 +587,28 @@ namespace lighter
       u = updateFreq = progLM->GetUpdateFrequency (lightmaps.GetSize());
       const float progressStep = updateFreq * (1.0f / lightmaps.GetSize());
 
+      // Lightmaps are fixed up independently of each other
+      csRefArray<iJob> fixupJobs;
+      fixupJobs.SetSize (lightmaps.GetSize ());
       for (size_t lmI = 0; lmI < lightmaps.GetSize (); ++lmI)
       {
         // Might have empty lightmap entries for non-created lightmaps
         if (!lightmaps[lmI])
           continue;
 
-        lightmaps[lmI]->FixupLightmap (*(lmMasks[lmI % realNumLMs]));
+        csRef<iJob> job;
+        job.AttachNew (new FixupLightmapJob (lightmaps[lmI],
+          *(lmMasks[lmI % realNumLMs])));
+        jobManager->Enqueue (job);
+        fixupJobs.Put (lmI, job);
+      }
+
+      for (size_t lmI = 0; lmI < lightmaps.GetSize (); ++lmI)
+      {
+        if (!fixupJobs[lmI])
+          continue;
+
+        jobManager->PullAndRun (fixupJobs[lmI]);
         if (--u == 0)
         {
           progLM->IncProgress (progressStep);
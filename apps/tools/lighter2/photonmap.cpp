@@ -28,24 +28,59 @@
 
 #include "common.h"
 #include "photonmap.h"
+#include "lighter.h"
   
 namespace lighter
 {
   // How many new photons to allocate when expanding the array size
   #define ARRAY_EXPAND_AMOUNT   100000
 
+  // Tag and format version at the start of files written by SaveToFile
+  #define PHOTONMAP_FILE_TAG      "CSPM"
+  #define PHOTONMAP_FILE_VERSION  2
+
   /**
-   * This is the photon
-   * The power is not compressed so the
-   * size is 28 bytes
+   * This is the photon as stored in the balanced kd-tree.
+   * The power is compressed to a shared exponent
+   * format (like Ward's RGBE) so the size is 20 bytes
    */
   struct Photon {
     float pos[3];                  // The position of the photon in space
-    short plane;                   // splitting plane for kd-tree
+    uint8 power[4];                // photon power (RGB mantissas, exponent)
+    unsigned char theta, phi;      // incoming direction
+    uint8 plane;                   // splitting plane for kd-tree
+    uint8 pad;
+  };
+
+  /**
+   * This is the photon while the map is built.
+   * The power is not compressed so the
+   * size is 32 bytes
+   */
+  struct PhotonSample {
+    float pos[3];                  // The position of the photon in space
+    uint8 plane;                   // splitting plane for kd-tree
     unsigned char theta, phi;      // incoming direction
     float power[3];                // photon power (uncompressed)
   };
 
+  // Compress power to 8 bit mantissas with a shared exponent
+  static inline void EncodePower(uint8 rgbe[4], const float power[3])
+  {
+    float maxPower = csMax(power[0], csMax(power[1], power[2]));
+    if (maxPower < 1e-32f)
+    {
+      rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+      return;
+    }
+
+    int exponent;
+    float scale = frexpf(maxPower, &exponent) * 256.0f / maxPower;
+    for (size_t i=0; i<3; i++)
+      rgbe[i] = (uint8)csMin(csMax(power[i], 0.0f) * scale, 255.0f);
+    rgbe[3] = (uint8)csClamp(exponent + 128, 255, 1);
+  }
+
   /**
    * This structure is used only to locate the
    * nearest photons.  Initialize max, pos and
@@ -161,6 +196,64 @@ namespace lighter
   float PhotonMap::sinTheta[256];
   float PhotonMap::cosPhi[256];
   float PhotonMap::sinPhi[256];
+  float PhotonMap::powerExponent[256];
+
+  //--------------------------------------------------------------------------
+
+  void PhotonBuffer::Add(
+                          PhotonMap* map,
+                          const float power[3],
+                          const float pos[3],
+                          const float dir[3] )
+  {
+    BufferedPhoton& photon = photons.GetExtend(photons.GetSize());
+    photon.map = map;
+    for (size_t i=0; i<3; i++) {
+      photon.power[i] = power[i];
+      photon.pos[i] = pos[i];
+      photon.dir[i] = dir[i];
+    }
+  }
+
+  void PhotonBuffer::Flush()
+  {
+    for (size_t i=0; i<photons.GetSize(); i++)
+    {
+      const BufferedPhoton& photon = photons[i];
+      photon.map->Store(photon.power, photon.pos, photon.dir);
+    }
+    photons.DeleteAll();
+  }
+
+  //--------------------------------------------------------------------------
+
+  /// A subtree left to be balanced by a BalanceJob
+  struct PhotonMap::BalanceTask
+  {
+    size_t index, start, end;
+    float bboxMin[3], bboxMax[3];
+  };
+
+  /// Job balancing one subtree of the photon map
+  class PhotonMap::BalanceJob : public scfImplementation1<BalanceJob, iJob>
+  {
+  public:
+    BalanceJob(PhotonMap* map, PhotonSample** pbal, PhotonSample** porg,
+      const BalanceTask& task) : scfImplementationType(this), map(map),
+      pbal(pbal), porg(porg), task(task) {}
+
+    void Run()
+    {
+      map->BalanceSegment(pbal, porg, task.index, task.start, task.end,
+        task.bboxMin, task.bboxMax, 0, 0, 0);
+    }
+
+  private:
+    PhotonMap* map;
+    PhotonSample** pbal;
+    PhotonSample** porg;
+    BalanceTask task;
+  };
 
   /**
    * This is the constructor for the photon map.
@@ -178,7 +271,8 @@ namespace lighter
     prevScale = 1;
     initialSize = maxPhotons = maxPhot;
 
-    photons = (Photon*)malloc( sizeof( Photon ) * ( maxPhotons+1 ) );
+    samples = (PhotonSample*)malloc( sizeof( PhotonSample ) * ( maxPhotons+1 ) );
+    photons = NULL;
 
     bboxMin[0] = bboxMin[1] = bboxMin[2] = FLT_MAX;
     bboxMax[0] = bboxMax[1] = bboxMax[2] = -FLT_MAX;
@@ -194,12 +288,15 @@ namespace lighter
         sinTheta[i] = sin( angle );
         cosPhi[i]   = cos( 2.0*angle );
         sinPhi[i]   = sin( 2.0*angle );
+        // Mantissas are stored as 8 bit integers
+        powerExponent[i] = ldexpf( 1.0f, int(i)-(128+8) );
       }
     }
   }
 
   PhotonMap::~PhotonMap()
   {
+    free( samples );
     free( photons );
   }
 
@@ -213,6 +310,19 @@ namespace lighter
     dir[2] = cosTheta[p->theta];
   }
 
+  /**
+   * PhotonPower() - returns the uncompressed power of a photon
+   */
+  void PhotonMap :: PhotonPower( float *power, const Photon *p ) const
+  {
+    // Mantissas are rounded to the middle of their interval
+    const float f = powerExponent[p->power[3]];
+    const float e = p->power[3] ? 0.5f : 0.0f;
+    power[0] = (p->power[0]+e)*f;
+    power[1] = (p->power[1]+e)*f;
+    power[2] = (p->power[2]+e)*f;
+  }
+
   size_t PhotonMap :: GetPhotonCount() { return storedPhotons; }
 
   float* PhotonMap :: GetBBoxMin() { return bboxMin; }
@@ -268,12 +378,39 @@ namespace lighter
     LocatePhotons( &np, 1 );
     globalStats.photonmapping.numKDLookups += np.found;
 
+    EstimateFromNearest( irrad, np, norm, maxDist, filter );
+  }
+
+  /**
+   * IrradianceEstimates() - computes irradiance estimates
+   * for several surface positions, one after the other
+   */
+  void PhotonMap :: IrradianceEstimates(
+                                         const size_t num,              // number of positions
+                                         float (*irrad)[3],             // returned irradiances
+                                         const float (*pos)[3],         // surface positions
+                                         const float (*norm)[3],        // surface normals at pos
+                                         const float maxDist,           // max distance to look for photons
+                                         const size_t nphotons,         // number of photons to use
+                                         const FilterType filter) const // Filter to apply to photon power
+  {
+    for (size_t q=0; q<num; q++)
+      IrradianceEstimate( irrad[q], pos[q], norm[q], maxDist, nphotons, filter );
+  }
+
+  void PhotonMap :: EstimateFromNearest(
+                                          float irrad[3],
+                                          const NearestPhotons &np,
+                                          const float norm[3],
+                                          const float maxDist,
+                                          const FilterType filter ) const
+  {
     // if less than 8 photons assume black (Note: this may be dangerous)
     if (np.found < 8)
       return;
 
     // Choose weights and norm based on filter
-    float pdir[3], normF;
+    float pdir[3], power[3], normF;
     switch(filter)
     {
       case FILTER_NONE: default:
@@ -285,9 +422,10 @@ namespace lighter
           PhotonDir( pdir, p );
           if ( (pdir[0]*norm[0]+pdir[1]*norm[1]+pdir[2]*norm[2]) < 0.0f )
           {
-            irrad[0] += p->power[0];
-            irrad[1] += p->power[1];
-            irrad[2] += p->power[2];
+            PhotonPower( power, p );
+            irrad[0] += power[0];
+            irrad[1] += power[1];
+            irrad[2] += power[2];
           }
         }
 
@@ -306,9 +444,10 @@ namespace lighter
           if ( (pdir[0]*norm[0]+pdir[1]*norm[1]+pdir[2]*norm[2]) < 0.0f )
           {
             float w = ConeWeight(sqrtf(np.distSq[i]), maxDist, coneK);
-            irrad[0] += p->power[0]*w;
-            irrad[1] += p->power[1]*w;
-            irrad[2] += p->power[2]*w;
+            PhotonPower( power, p );
+            irrad[0] += power[0]*w;
+            irrad[1] += power[1]*w;
+            irrad[2] += power[2]*w;
           }
         }
 
@@ -327,9 +466,10 @@ namespace lighter
           if ( (pdir[0]*norm[0]+pdir[1]*norm[1]+pdir[2]*norm[2]) < 0.0f )
           {
             float w = GaussianWeight(np.distSq[i], np.distSq[0]);
-            irrad[0] += p->power[0]*w;
-            irrad[1] += p->power[1]*w;
-            irrad[2] += p->power[2]*w;
+            PhotonPower( power, p );
+            irrad[0] += power[0]*w;
+            irrad[1] += power[1]*w;
+            irrad[2] += power[2]*w;
           }
         }
 
@@ -431,6 +571,7 @@ namespace lighter
                            const float dir[3] )
   {
     CS::Threading::MutexScopedLock lock(writeMutex);
+    CS_ASSERT_MSG("Photon map is balanced already", photons == NULL);
 
     // Check for storage and attempt to expand if needed
     if (storedPhotons>=maxPhotons && !Expand())
@@ -439,7 +580,8 @@ namespace lighter
     storedPhotons++;
     globalStats.photonmapping.numStoredPhotons++;
     
-    Photon *const node = &(photons[storedPhotons]);
+    PhotonSample *const node = &(samples[storedPhotons]);
+    node->plane = 0;
 
     for (size_t i=0; i<3; i++) {
       node->pos[i] = pos[i];
@@ -475,10 +617,11 @@ namespace lighter
    */
   void PhotonMap :: ScalePhotonPower( const float scale )
   {
+    CS_ASSERT_MSG("Photon map is balanced already", photons == NULL);
     for (size_t i=prevScale; i<=storedPhotons; i++) {
-      photons[i].power[0] *= scale;
-      photons[i].power[1] *= scale;
-      photons[i].power[2] *= scale;
+      samples[i].power[0] *= scale;
+      samples[i].power[1] *= scale;
+      samples[i].power[2] *= scale;
     }
     prevScale = storedPhotons+1;
   }
@@ -489,18 +632,12 @@ namespace lighter
     size_t newMax = maxPhotons + initialSize;
 
     // Allocate a new array
-    Photon *newPhotons = (Photon*)malloc( sizeof( Photon ) * ( newMax+1 ) );
-    if(newPhotons == NULL) return false;
-
-    // Copy over old data
-    for(size_t i=0; i<maxPhotons; i++)
-      newPhotons[i] = photons[i];
-
-    // Free old array
-    free(photons);
+    PhotonSample *newSamples =
+      (PhotonSample*)realloc( samples, sizeof( PhotonSample ) * ( newMax+1 ) );
+    if(newSamples == NULL) return false;
 
     // Replace old variables
-    photons = newPhotons;
+    samples = newSamples;
     maxPhotons = newMax;
 
     // return success
@@ -513,50 +650,88 @@ namespace lighter
    */
   void PhotonMap :: Balance(Statistics::ProgressState &prog)
   {
+    photons = (Photon*)malloc( sizeof( Photon ) * ( storedPhotons+1 ) );
+
     if (storedPhotons>1) {
       // allocate two temporary arrays for the balancing procedure
-      Photon **pa1 = (Photon**)malloc(sizeof(Photon*)*(storedPhotons+1));
-      Photon **pa2 = (Photon**)malloc(sizeof(Photon*)*(storedPhotons+1));
+      PhotonSample **pa1 = (PhotonSample**)malloc(sizeof(PhotonSample*)*(storedPhotons+1));
+      PhotonSample **pa2 = (PhotonSample**)malloc(sizeof(PhotonSample*)*(storedPhotons+1));
 
       for (size_t i=0; i<=storedPhotons; i++)
-        pa2[i] = &(photons[i]);
+        pa2[i] = &(samples[i]);
+
+      // The top of the tree is split here, the subtrees below are
+      // independent of each other and balanced in parallel
+      csArray<BalanceTask> tasks;
+      size_t deferDepth = 0;
+      const size_t numThreads = globalConfig.GetLighterProperties().numThreads;
+      if (storedPhotons >= 4096)
+      {
+        while ((size_t (1) << deferDepth) < 4*numThreads)
+          deferDepth++;
+      }
+      float bmin[3] = { bboxMin[0], bboxMin[1], bboxMin[2] };
+      float bmax[3] = { bboxMax[0], bboxMax[1], bboxMax[2] };
+      BalanceSegment( pa1, pa2, 1, 1, storedPhotons, bmin, bmax,
+        deferDepth > 0 ? &tasks : 0, deferDepth, &prog );
 
-      BalanceSegment( pa1, pa2, 1, 1, storedPhotons, prog );
+      csRefArray<iJob> jobs;
+      for (size_t t=0; t<tasks.GetSize(); t++)
+      {
+        csRef<iJob> job;
+        job.AttachNew (new BalanceJob (this, pa1, pa2, tasks[t]));
+        globalLighter->jobManager->Enqueue (job);
+        jobs.Push (job);
+      }
+      for (size_t t=0; t<tasks.GetSize(); t++)
+      {
+        globalLighter->jobManager->PullAndRun (jobs[t]);
+
+        // One progress step per segment, like the serial balancing
+        for (size_t k=(tasks[t].end-tasks[t].start+1)/2; k>0; k--)
+          prog.Advance();
+      }
       free(pa2);
 
-      // reorganize balanced kd-tree (make a heap)
-      size_t d, j=1, foo=1;
-      Photon fooPhoton = photons[j];
-
-      for (size_t i=1; i<=storedPhotons; i++) {
-        d=pa1[j]-photons;
-        pa1[j] = NULL;
-        if (d != foo)
-          photons[j] = photons [d];
-        else {
-          photons[j] = fooPhoton;
-
-          if (i<storedPhotons) {
-            for (;foo<=storedPhotons; foo++)
-              if (pa1[foo] != NULL)
-                break;
-            fooPhoton = photons [foo];
-            j = foo;
-          }
-          continue;
-        }
-        j = d;
+      // copy the balanced kd-tree (a heap) to the compact photons
+      for (size_t j=1; j<=storedPhotons; j++) {
+        const PhotonSample *src = pa1[j];
+        Photon *const dst = &(photons[j]);
+        dst->pos[0] = src->pos[0];
+        dst->pos[1] = src->pos[1];
+        dst->pos[2] = src->pos[2];
+        EncodePower( dst->power, src->power );
+        dst->theta = src->theta;
+        dst->phi = src->phi;
+        dst->plane = src->plane;
+        dst->pad = 0;
       }
       free(pa1);
     }
+    else if (storedPhotons == 1) {
+      const PhotonSample *src = &(samples[1]);
+      Photon *const dst = &(photons[1]);
+      dst->pos[0] = src->pos[0];
+      dst->pos[1] = src->pos[1];
+      dst->pos[2] = src->pos[2];
+      EncodePower( dst->power, src->power );
+      dst->theta = src->theta;
+      dst->phi = src->phi;
+      dst->plane = 0;
+      dst->pad = 0;
+    }
 
-    if (storedPhotons!=0) halfStoredPhotons = storedPhotons/2-1;
+    // The uncompressed photons are not needed any more
+    free(samples);
+    samples = NULL;
+
+    if (storedPhotons>1) halfStoredPhotons = storedPhotons/2-1;
     globalStats.photonmapping.KDTreeDepth =
       (int)floor(log10f(storedPhotons)/log10f(2.0));
   }
 
 
-  #define swap(ph,a,b) { Photon *ph2=ph[a]; ph[a]=ph[b]; ph[b]=ph2; }
+  #define swap(ph,a,b) { PhotonSample *ph2=ph[a]; ph[a]=ph[b]; ph[b]=ph2; }
 
   /* median_split splits the photon array into two separate
    * pieces around the median, with all photons below
@@ -566,7 +741,7 @@ namespace lighter
    * (inspired by routine in "Algorithms in C++" by Sedgewick)
    */
   void PhotonMap :: MedianSplit(
-                                  Photon **p,
+                                  PhotonSample **p,
                                   const size_t start,                // start of photon block in array
                                   const size_t end,                  // end of photon block in array
                                   const size_t median,               // desired median number
@@ -600,16 +775,35 @@ namespace lighter
 
   /* See "Realistic Image Synthesis using Photon Mapping" Chapter 6
    * for an explanation of this function
+   * Segments 'deferDepth' levels below the given one are not balanced
+   * but added to 'deferred' (if given) to be balanced separately.
    */
   void PhotonMap :: BalanceSegment(
-                                     Photon **pbal,
-                                     Photon **porg,
+                                     PhotonSample **pbal,
+                                     PhotonSample **porg,
                                      const size_t index,
                                      const size_t start,
                                      const size_t end,
-                                     Statistics::ProgressState &prog)
+                                     float bboxMin[3],
+                                     float bboxMax[3],
+                                     csArray<BalanceTask>* deferred,
+                                     const size_t deferDepth,
+                                     Statistics::ProgressState* prog)
   {
-    prog.Advance();
+    if (deferred && deferDepth == 0) {
+      BalanceTask task;
+      task.index = index;
+      task.start = start;
+      task.end = end;
+      for (size_t i=0; i<3; i++) {
+        task.bboxMin[i] = bboxMin[i];
+        task.bboxMax[i] = bboxMax[i];
+      }
+      deferred->Push(task);
+      return;
+    }
+
+    if (prog) prog->Advance();
     //--------------------
     // compute new median
     //--------------------
@@ -654,7 +848,8 @@ namespace lighter
       if ( start < median-1 ) {
         const float tmp=bboxMax[axis];
         bboxMax[axis] = pbal[index]->pos[axis];
-        BalanceSegment( pbal, porg, 2*index, start, median-1, prog );
+        BalanceSegment( pbal, porg, 2*index, start, median-1,
+          bboxMin, bboxMax, deferred, deferDepth-1, prog );
         bboxMax[axis] = tmp;
       } else {
         pbal[ 2*index ] = porg[start];
@@ -666,7 +861,8 @@ namespace lighter
       if ( median+1 < end ) {
         const float tmp = bboxMin[axis];
         bboxMin[axis] = pbal[index]->pos[axis];
-        BalanceSegment( pbal, porg, 2*index+1, median+1, end, prog );
+        BalanceSegment( pbal, porg, 2*index+1, median+1, end,
+          bboxMin, bboxMax, deferred, deferDepth-1, prog );
         bboxMin[axis] = tmp;
       } else {
         pbal[ 2*index+1 ] = porg[end];
@@ -680,6 +876,11 @@ namespace lighter
     FILE* fout = CS::Platform::File::Open (filename, "wb");
     if(fout != NULL)
     {
+      // Write the tag and format version
+      const uint32 version = PHOTONMAP_FILE_VERSION;
+      fwrite(PHOTONMAP_FILE_TAG, 1, 4, fout);
+      fwrite(&version, sizeof(uint32), 1, fout);
+
       // Write the number of photons
       fwrite(&storedPhotons, sizeof(size_t), 1, fout);
 
@@ -689,7 +890,7 @@ namespace lighter
       // Write photon position
       for(size_t j=0; j<3; j++)
       {
-        for(size_t i=0; i<storedPhotons; i++)
+        for(size_t i=1; i<=storedPhotons; i++)
         {
           fwrite(&(photons[i].pos[j]), sizeof(float), 1, fout);
         }
@@ -698,27 +899,29 @@ namespace lighter
       // Write photon power
       for(size_t j=0; j<3; j++)
       {
-        for(size_t i=0; i<storedPhotons; i++)
+        for(size_t i=1; i<=storedPhotons; i++)
         {
-          fwrite(&(photons[i].power[j]), sizeof(float), 1, fout);
+          float power[3];
+          PhotonPower(power, &(photons[i]));
+          fwrite(&(power[j]), sizeof(float), 1, fout);
         }
       }
 
       // Write photon direction
-      for(size_t i=0; i<storedPhotons; i++)
+      for(size_t i=1; i<=storedPhotons; i++)
       {
         fwrite(&(photons[i].theta), sizeof(unsigned char), 1, fout);
       }
 
-      for(size_t i=0; i<storedPhotons; i++)
+      for(size_t i=1; i<=storedPhotons; i++)
       {
         fwrite(&(photons[i].phi), sizeof(unsigned char), 1, fout);
       }
 
       // Write kd-tree splitting plane
-      for(size_t i=0; i<storedPhotons; i++)
+      for(size_t i=1; i<=storedPhotons; i++)
       {
-        fwrite(&(photons[i].plane), sizeof(short), 1, fout);
+        fwrite(&(photons[i].plane), sizeof(unsigned char), 1, fout);
       }
 
       // Close the file
@@ -33,9 +33,38 @@
 
 namespace lighter
 {
+  class PhotonMap;
   struct Photon;
+  struct PhotonSample;
   struct NearestPhotons;
 
+  /**
+   * Collects the photons traced by one emission job. The photons are put
+   * into their photon maps later, in job order, so the maps don't depend on
+   * which thread traced which photon.
+   */
+  class PhotonBuffer
+  {
+  public:
+    /// Add a photon destined for \a map (parameters as PhotonMap::Store())
+    void Add(
+      PhotonMap* map,
+      const float power[3],
+      const float pos[3],
+      const float dir[3] );
+
+    /// Store the buffered photons into their maps and empty the buffer
+    void Flush();
+
+  private:
+    struct BufferedPhoton
+    {
+      PhotonMap* map;
+      float power[3], pos[3], dir[3];
+    };
+    csArray<BufferedPhoton> photons;
+  };
+
   enum FilterType
   {
     FILTER_NONE,
@@ -80,6 +109,9 @@ namespace lighter
      *    Restructure the photon map heap into a balanced kd-tree.
      * You must call this function before using the map with the
      * functions IrradianceEstimate, RadianceEstimate and LocatePhotons.
+     * The subtrees below the top levels are balanced in parallel on the
+     * lighter job queue. Photon power is quantized at this point, so no
+     * photons can be stored or scaled afterwards.
      **/
     void Balance(Statistics::ProgressState &prog);
 
@@ -102,6 +134,27 @@ namespace lighter
       const size_t nphotons,
       const FilterType filter = FILTER_CONE) const;
 
+    /**
+     * IrradianceEstimates
+     *    Estimate the irradiance for several points.  This is a convenience
+     * loop calling IrradianceEstimate() for each point; every point is
+     * searched for separately.
+     * /param num - Number of points
+     * /param irrad - Returned irradiance estimates (num entries)
+     * /param pos - Positions in scene to compute estimates for
+     * /param normal - The surface normals at 'pos'
+     * /param maxDist - The maximum distance to search for neighbors (world units)
+     * /param nphotons - The number of neighbor photons to use for each estimate.
+     **/
+    void IrradianceEstimates(
+      const size_t num,
+      float (*irrad)[3],
+      const float (*pos)[3],
+      const float (*normal)[3],
+      const float maxDist,
+      const size_t nphotons,
+      const FilterType filter = FILTER_CONE) const;
+
     /**
      * LocatePhotons
      *     Search the kd-tree heap to find photons.  the NearestPhotons structure
@@ -127,11 +180,24 @@ namespace lighter
       float *dir,
       const Photon *p ) const;
 
+    /**
+     * PhotonPower
+     *    Uncompress the power stored in a photon.
+     * /param power - returned power (must be an array of 3 floats)
+     * /param p - photon structure to get the power of
+     **/
+    void PhotonPower(
+      float *power,
+      const Photon *p ) const;
+
     /**
      * SaveToFile
      *    Write the contents of the photon map to a file for external use.
      * The file will have the following format:
      *
+     *    <char[4]:"CSPM">
+     *    <uint32:formatVersion>
+     *
      *    <size_t:photonCount>
      *
      *    <float:PositionXCoordinate>*photonCount
@@ -145,10 +211,16 @@ namespace lighter
      *    <unsigned char:DirectionThetaAngle>*photonCount
      *    <unsigned char:DirectionPhiAngle>*photonCount
      *
-     *    <short int:KDTreeSplittingPlane>*photonCount
+     *    <unsigned char:KDTreeSplittingPlane>*photonCount
      *
      * Note: whitespace and newlines above are not part of the file format.
-     * Endiness is the machine native format.
+     * Endiness is the machine native format.  The map must be balanced
+     * and the power is written as stored, i.e. quantized.
+     *
+     * The current format version is 2.  Files without the "CSPM" tag were
+     * written by older versions: they start with the photon count, the
+     * power is not quantized and the splitting plane is stored as a short.
+     * Readers should reject such files or read them with that layout.
      *
      * /param filename - name of file to store photon map data
      **/
@@ -156,29 +228,42 @@ namespace lighter
       const char* filename);
 
   private:
+    struct BalanceTask;
+    class BalanceJob;
 
     static inline float ConeWeight(float dist, float r, float k);
     static inline float GaussianWeight(float distSq, float rSq);
 
+    void EstimateFromNearest(
+      float irrad[3],
+      const NearestPhotons &np,
+      const float norm[3],
+      const float maxDist,
+      const FilterType filter ) const;
+
     bool Expand();
 
     void BalanceSegment(
-      Photon **pbal,
-      Photon **porg,
+      PhotonSample **pbal,
+      PhotonSample **porg,
       const size_t index,
-
       const size_t start,
       const size_t end,
-      Statistics::ProgressState &prog);
+      float bboxMin[3],
+      float bboxMax[3],
+      csArray<BalanceTask>* deferred,
+      const size_t deferDepth,
+      Statistics::ProgressState* prog);
 
     void MedianSplit(
-      Photon **p,
+      PhotonSample **p,
       const size_t start,
       const size_t end,
       const size_t median,
       const int axis );
 
-    Photon *photons;          ///< Internal array of photons (kd-tree heap after call to Balance())
+    PhotonSample *samples;    ///< Internal array of stored photons (until Balance())
+    Photon *photons;          ///< Compact kd-tree heap of photons (after Balance())
 
     size_t initialSize;       ///< The initial requested array size (used for array expansion)
     size_t storedPhotons;     ///< Number of photons stored in the internal array
@@ -198,6 +283,8 @@ namespace lighter
     static float sinTheta[256];
     static float cosPhi[256];
     static float sinPhi[256];
+    // Scale of the shared power exponent
+    static float powerExponent[256];
   };
 };
 
@@ -19,7 +19,9 @@
 
 #include "common.h"
 #include "photonmapperlighting.h"
+#include "lighter.h"
 #include "material.h"
+#include "photonmap.h"
 #include "scene.h"
 
 namespace lighter
@@ -45,10 +47,6 @@ namespace lighter
     indirectLightEnabled =
       (globalConfig.GetLighterProperties ().indirectLightEngine ==
           LIGHT_ENGINE_PHOTONMAPPER);
-
-    // Initialize random number generators
-    randVect.Initialize();
-    randFloat.Initialize();
   }
 
   PhotonmapperLighting::~PhotonmapperLighting () {}
@@ -102,6 +100,18 @@ namespace lighter
         // Count the rays that hit something
         size_t rayCount = 0;
 
+        // The jitter of the final gather rays comes from the light sampler
+        // so the result does not depend on which thread computes it
+        float seed[2];
+        lightSampler.GetNext (seed);
+        csRandomFloatGen randGen (uint (seed[0] * 4294967295.0f));
+
+        // Trace all the rays first and look up the photon map for all the
+        // hit points at once
+        const size_t numRays = numFinalGatherMSubdivs*numFinalGatherNSubdivs;
+        CS_ALLOC_STACK_ARRAY_FALLBACK(csVector3, gatherPoints, numRays, 1024);
+        CS_ALLOC_STACK_ARRAY_FALLBACK(csVector3, gatherNormals, numRays, 1024);
+
         // Loop through an M by N grid of sample rays
         for (size_t j = 1; j <= numFinalGatherMSubdivs; j++)
         {
@@ -109,7 +119,7 @@ namespace lighter
           {
             // Use stratified sampling to sample the hemisphere above our point
             csVector3 sampleDir = StratifiedSample(normal, i, j,
-                  numFinalGatherMSubdivs, numFinalGatherNSubdivs);
+                  numFinalGatherMSubdivs, numFinalGatherNSubdivs, randGen);
 
             // Build a hit and ray structure to use for Final Gather Rays
             lighter::HitPoint hit;
@@ -128,7 +138,6 @@ namespace lighter
               // Compute the direction to the source point
               csVector3 dirToSource = point - hit.hitPoint;
               meanDist += dirToSource.InverseNorm();
-              rayCount++;
               dirToSource.Normalize();
 
               // Calculate the normal at the hit point
@@ -137,12 +146,24 @@ namespace lighter
               // Make sure normal is facing towards source point
               if(dirToSource*hNorm < 0.0) hNorm -= hNorm;
 
-              // Sample the photon map at the hit point and accumulate the energy
-              final += sector->SamplePhoton(hit.hitPoint, hNorm, searchRadius);
+              gatherPoints[rayCount] = hit.hitPoint;
+              gatherNormals[rayCount] = hNorm;
+              rayCount++;
             }
           }
         }
 
+        // Sample the photon map at the hit points and accumulate the energy
+        if (rayCount > 0)
+        {
+          CS_ALLOC_STACK_ARRAY_FALLBACK(csColor, gatherIrradiance, rayCount,
+            1024);
+          sector->SamplePhotons (rayCount, gatherPoints, gatherNormals,
+            searchRadius, gatherIrradiance);
+          for (size_t r = 0; r < rayCount; r++)
+            final += gatherIrradiance[r];
+        }
+
         // Normalize the accumulated energy
         c = final * (PI / (numFinalGatherMSubdivs*numFinalGatherNSubdivs));
 
@@ -219,6 +240,123 @@ namespace lighter
     return causticSector;
   }
 
+  /// Emission settings shared by the photons of one light
+  struct PhotonmapperLighting::PhotonEmission
+  {
+    Sector* sector;
+    Light* light;
+    csLightType lightType;
+    bool caustic;
+
+    // Light position (for caustics of directional lights a position
+    // in front of the caustic object)
+    csVector3 pos;
+    // Direction of spot and directional lights
+    csVector3 lightDir;
+    // Direction towards the caustic object
+    csVector3 objDir;
+    // Radius of directional lights
+    float spRadius;
+    // Outer falloff of spotlights, angle spanned by the caustic object
+    float coneAngle;
+
+    csColor color, power;
+    size_t maxDepth;
+    bool ignoreDirect;
+  };
+
+  /**
+   * Job tracing a share of the photons of one light. Each job has its own
+   * random numbers and photon buffer.
+   */
+  class PhotonmapperLighting::EmissionJob :
+    public scfImplementation1<EmissionJob, iJob>
+  {
+  public:
+    EmissionJob (const PhotonEmission& emission, int numPhotons, uint seed)
+      : scfImplementationType (this), emission (emission),
+        numPhotons (numPhotons), seed (seed) {}
+
+    void Run ()
+    {
+      // Separate generators for uniform directions and everything else
+      csRandomFloatGen randGen (seed);
+      csRandomVectorGen randVect (seed ^ 0x5bd1e995);
+
+      Sector* sect = emission.sector;
+      for (int num = 0; num < numPhotons; ++num)
+      {
+        // Get origin and direction to emit the photon
+        csVector3 photonOrigin = emission.pos;
+        csVector3 dir;
+
+        switch (emission.lightType)
+        {
+          // directional light
+          case CS_LIGHT_DIRECTIONAL:
+            {
+              photonOrigin = DirectionalLightScatter(emission.lightDir,
+                emission.spRadius, emission.pos, randGen);
+              dir = emission.lightDir;
+            }
+            break;
+
+          // spotlight
+          case CS_LIGHT_SPOTLIGHT:
+            {
+              // Generate a random direction within the spotlight cone
+              // (towards the caustic object for caustics)
+              if (emission.caustic)
+                dir = CausticDir(emission.objDir, emission.coneAngle, randGen);
+              else
+                dir = SpotlightDir(emission.lightDir, emission.coneAngle, randGen);
+            }
+            break;
+
+          // Default behavior is to treat a light like a point light
+          case CS_LIGHT_POINTLIGHT:
+          default:
+            {
+              // Generate a random direction vector for uniform light source
+              // sampling, or one towards the caustic object
+              if (emission.caustic)
+                dir = CausticDir(emission.objDir, emission.coneAngle, randGen);
+              else
+                dir = randVect.Get();
+            }
+            break;
+        }
+
+        // Emit a single photon into the sector containing this light
+        const PhotonRay newPhoton = { photonOrigin, dir, emission.color,
+          emission.power, emission.light, RAY_TYPE_OTHER1, 1.0f };
+        EmitPhoton(sect, newPhoton, emission.maxDepth, 0,
+          emission.ignoreDirect, emission.caustic, randGen, buffer);
+      }
+    }
+
+    PhotonEmission emission;
+    int numPhotons;
+    uint seed;
+    PhotonBuffer buffer;
+  };
+
+  void PhotonmapperLighting::QueueEmission (const PhotonEmission& emission,
+    int numPhotons, csRefArray<EmissionJob>& jobs)
+  {
+    for (int first = 0; first < numPhotons; first += EMISSION_JOB_PHOTONS)
+    {
+      // Seed from the job number so the photons are the same for every run
+      uint seed = uint (jobs.GetSize () + 1) * 2654435761u;
+
+      csRef<EmissionJob> job;
+      job.AttachNew (new EmissionJob (emission,
+        csMin (numPhotons - first, int (EMISSION_JOB_PHOTONS)), seed));
+      globalLighter->jobManager->Enqueue (job);
+      jobs.Push (job);
+    }
+  }
+
   void PhotonmapperLighting::EmitPhotons(Sector *sect, Statistics::Progress& progress)
   {
     // Determine maximum allowed photon recursion
@@ -261,12 +399,14 @@ namespace lighter
       }
     }
 
+    // The photons are traced by jobs on the lighter job queue
+    csRefArray<EmissionJob> jobs;
+
     for (size_t lightIdx = 0; lightIdx < allNonPDLights.GetSize(); ++lightIdx)
     {
       // Get the position, color and power for this light source
       Light* curLight = allNonPDLights[lightIdx];
       const csVector3& pos = curLight->GetPosition();
-      csVector3 photonOrigin = pos;
       const csColor& color = curLight->GetColor()*
           globalConfig.GetLighterProperties ().PMLightScale;
       const csColor& power = curLight->GetPower();
@@ -292,10 +432,20 @@ namespace lighter
       bool warning = false, stop = false;
 
       // Setting one time light properties
+      PhotonEmission emission;
+      emission.sector = sect;
+      emission.light = curLight;
+      emission.lightType = curLightType;
+      emission.caustic = false;
+      emission.pos = pos;
+      emission.lightDir.Set (0.0f);
+      emission.objDir.Set (0.0f);
+      emission.spRadius = emission.coneAngle = 0.0f;
+      emission.color = color;
+      emission.power = power;
+      emission.maxDepth = maxDepth;
+      emission.ignoreDirect = !directLightEnabled;
 
-      float spRadius, innerFalloff, outterFalloff;
-      spRadius = innerFalloff = outterFalloff = 0.0f;
-      csVector3 lightDir (0.0f);
       switch (curLightType) 
       {
 
@@ -303,8 +453,8 @@ namespace lighter
       case CS_LIGHT_DIRECTIONAL:
         {
 
-          lightDir = ((DirectionalLight*)curLight)->GetDirection();
-          spRadius = ((DirectionalLight*)curLight)->GetRadius();
+          emission.lightDir = ((DirectionalLight*)curLight)->GetDirection();
+          emission.spRadius = ((DirectionalLight*)curLight)->GetRadius();
         }
         break;
 
@@ -319,9 +469,9 @@ namespace lighter
           }
 
           // Get spotlight properties
-          
-          lightDir = ((SpotLight*)curLight)->GetDirection();
-          ((SpotLight*)curLight)->GetFalloff(innerFalloff, outterFalloff);
+          float innerFalloff;
+          emission.lightDir = ((SpotLight*)curLight)->GetDirection();
+          ((SpotLight*)curLight)->GetFalloff(innerFalloff, emission.coneAngle);
 
         }
         break;
@@ -333,49 +483,11 @@ namespace lighter
 
       }
 
-      // Loop to generate the requested number of photons for this light source
-	  if(!stop)
-	  {
-		  for (int num = 0; num < photonsForCurLight; ++num)
-		  {
-			// Get direction to emit the photon
-			csVector3 dir;
-
-			switch (curLightType) 
-			{
-
-			  // directional light
-			  case CS_LIGHT_DIRECTIONAL:
-				{
-				  photonOrigin = DirectionalLightScatter(lightDir,spRadius,pos);
-				  dir = lightDir;
-				}
-				break;
-
-			  // spotlight
-			  case CS_LIGHT_SPOTLIGHT:
-				{
-				  // Generate a random direction within the spotlight cone
-				  dir = SpotlightDir(lightDir, outterFalloff);
-				}
-				break;
-
-			  // Default behavior is to treat a light like a point light
-			  case CS_LIGHT_POINTLIGHT:
-			  default:
-				{
-				  // Generate a random direction vector for uniform light source sampling
-				  dir = randVect.Get();
-				}
-				break;
-			}
-
-			// Emit a single photon into the sector containing this light
-			const PhotonRay newPhoton = { photonOrigin, dir, color, power, curLight, RAY_TYPE_OTHER1, 1.0f };
-			EmitPhoton(sect, newPhoton, maxDepth, 0, !directLightEnabled, false);
-			progressState.Advance();
-		  }
-	  }
+      // Generate the requested number of photons for this light source
+      if(!stop)
+      {
+        QueueEmission (emission, photonsForCurLight, jobs);
+      }
 
       if (enableCaustics)
       {
@@ -403,12 +515,10 @@ namespace lighter
           int causticPhotonsForMesh = floor(causticPhotonsForCurLight*(radius*radius*radius/totalVolume) + 0.5);
 
           // Setting one time light properties
-      
-          float spRadius, spanAngle;
-          spRadius = spanAngle = 0.0f;
-          csVector3 lightDir (0.0f);
-          csVector3 objDir (0.0f);
-          csVector3 pseudoPos (0.0f);
+          PhotonEmission causticEmission (emission);
+          causticEmission.caustic = true;
+          causticEmission.spRadius = causticEmission.coneAngle = 0.0f;
+          causticEmission.lightDir.Set (0.0f);
 
           switch (curLightType)
           {
@@ -416,20 +526,20 @@ namespace lighter
             // directional light
           case CS_LIGHT_DIRECTIONAL:
             {
-              lightDir = ((DirectionalLight*)curLight)->GetDirection();
-              spRadius = ((DirectionalLight*)curLight)->GetRadius();
+              csVector3 lightDir = ((DirectionalLight*)curLight)->GetDirection();
+              float spRadius = ((DirectionalLight*)curLight)->GetRadius();
 
               csVector3 posDir = sphere.GetCenter()-pos;
               csVector3 lightDirVector = posDir*lightDir;
               csVector3 radVector = lightDirVector-posDir;
               float parallelDist = radVector.SquaredNorm();
-              pseudoPos = pos;
 
               if (spRadius >= parallelDist)
               {
                 float tempDist = csMax (0.f, parallelDist + radius - spRadius);
-                pseudoPos = pos + radVector*(1 - tempDist/(parallelDist*2.0f));
-                spRadius = radius - tempDist/2.0f;
+                causticEmission.pos = pos + radVector*(1 - tempDist/(parallelDist*2.0f));
+                causticEmission.spRadius = radius - tempDist/2.0f;
+                causticEmission.lightDir = lightDir;
               }
               else
               {
@@ -452,11 +562,11 @@ namespace lighter
 
               // Get spotlight properties
               float innerFalloff, outterFalloff;
-              lightDir = ((SpotLight*)curLight)->GetDirection();
+              csVector3 lightDir = ((SpotLight*)curLight)->GetDirection();
               ((SpotLight*)curLight)->GetFalloff(innerFalloff, outterFalloff);
 
-              objDir = sphere.GetCenter() - pos;
-              spanAngle = ABS(atan(radius/objDir.SquaredNorm()));
+              csVector3 objDir = sphere.GetCenter() - pos;
+              float spanAngle = ABS(atan(radius/objDir.SquaredNorm()));
 
               objDir.Normalize();
               lightDir.Normalize();
@@ -467,7 +577,9 @@ namespace lighter
                 stop = true;
                 continue;
               }
-              
+
+              causticEmission.objDir = objDir;
+              causticEmission.coneAngle = spanAngle;
             }
             break;
 
@@ -477,66 +589,36 @@ namespace lighter
             {
               // Get the direction of the caustic object w.r.t the light
               
-              objDir = sphere.GetCenter() - pos;
-              spanAngle = atan(radius/objDir.SquaredNorm());
+              csVector3 objDir = sphere.GetCenter() - pos;
+              causticEmission.coneAngle = atan(radius/objDir.SquaredNorm());
               objDir.Normalize();
-              
+              causticEmission.objDir = objDir;
             }
             break;
           }
 
           // Emit caustic photons for the current light
-
-		  if(!stop)
-		  {
-			  for (int cnum = 0; cnum < causticPhotonsForMesh; ++cnum)
-			  {
-				// Get direction to emit the photon
-				csVector3 dir;
-
-				switch (curLightType)
-				{
-
-				  // directional light
-				  case CS_LIGHT_DIRECTIONAL:
-					{
-
-					  csVector3 emitPos = DirectionalLightScatter(lightDir,spRadius,pseudoPos);
-					  photonOrigin = emitPos;
-					  dir = lightDir;
-	                 
-					}
-					break;
-
-				  // spotlight
-	              
-				  case CS_LIGHT_SPOTLIGHT:
-					{
-					  // Generate a random direction within the spotlight cone towards the caustic
-					  dir = CausticDir(objDir, spanAngle);
-					}
-					break;
-	              
-				  // point light
-				  case CS_LIGHT_POINTLIGHT:
-				  default:
-					{
-					  dir = CausticDir(objDir,spanAngle);
-					}
-					break;
-				}
-
-				// Emit a single photon into the sector containing this light
-				const PhotonRay newPhoton = { photonOrigin, dir, color, power, curLight, RAY_TYPE_OTHER1, 1.0f };
-				EmitPhoton(sect, newPhoton, maxDepth, 0, !directLightEnabled,true);
-	            
-			  }
-		  }
+          if(!stop)
+          {
+            QueueEmission (causticEmission, causticPhotonsForMesh, jobs);
+          }
         }
       }
 
     }
 
+    // Store the photons in emission order, whichever thread traced them
+    for (size_t j = 0; j < jobs.GetSize (); j++)
+    {
+      globalLighter->jobManager->PullAndRun (jobs[j]);
+      jobs[j]->buffer.Flush ();
+      if (!jobs[j]->emission.caustic)
+      {
+        for (int num = 0; num < jobs[j]->numPhotons; ++num)
+          progressState.Advance();
+      }
+    }
+
     // Scale the photons for this light
     //sect->ScalePhotons(1.0/sect->numPhotonsToEmit);
     if (enableCaustics)
@@ -548,7 +630,8 @@ namespace lighter
   }
 
   void PhotonmapperLighting::EmitPhoton(Sector* &sect, const PhotonRay &photon,
-    const size_t &maxDepth, const size_t &depth, const bool &ignoreDirect,bool produceCaustic = false)
+    const size_t &maxDepth, const size_t &depth, const bool &ignoreDirect,
+    bool produceCaustic, csRandomFloatGen& randGen, PhotonBuffer& buffer)
   {
     // Check recursion depth
     if(depth > maxDepth)
@@ -584,7 +667,7 @@ namespace lighter
 
       // Get the color of the primitive at that point
       const lighter::RadMaterial* hitPtMaterial = hit.primitive->GetMaterial();
-      static csColor hitPtColor (1,1,1);
+      csColor hitPtColor (1,1,1);
       if(hitPtMaterial->IsTextureValid())
       {
         hitPtColor = hitPtMaterial->GetTextureValue(uvCordOnPrimitive);
@@ -598,12 +681,12 @@ namespace lighter
       {
         if(!produceCaustic)
         {
-          hitSector->AddPhoton(reflColor, hit.hitPoint, L);
+          hitSector->AddPhoton(buffer, reflColor, hit.hitPoint, L);
         }
         else if (!hitPtMaterial->produceCaustic)
         {
           // Add the photon to the caustic photon map
-          hitSector->AddCausticPhoton(reflColor, hit.hitPoint, L);
+          hitSector->AddCausticPhoton(buffer, reflColor, hit.hitPoint, L);
           return;
         }
       }
@@ -616,7 +699,6 @@ namespace lighter
         {
           // Russian roulette to cut off recursion depth early
           //float avgRefl = (Pd.red + Pd.green + Pd.blue)/3.0;
-          csRandomFloatGen randGen;
           float rand = randGen.Get();
 
           if(dot > rand)
@@ -630,12 +712,13 @@ namespace lighter
 
             // Generate a scattering direction in the hemisphere around the normal
 
-            csVector3 scatterDir = DiffuseScatter(N);
+            csVector3 scatterDir = DiffuseScatter(N, randGen);
 
 
             // Emit a new Photon
             const PhotonRay newPhoton = { hit.hitPoint, scatterDir, newColor, newPower, photon.source, RAY_TYPE_REFLECT, refrIndex };
-            EmitPhoton(hitSector, newPhoton, maxDepth, depth+1, ignoreDirect, produceCaustic);
+            EmitPhoton(hitSector, newPhoton, maxDepth, depth+1, ignoreDirect,
+              produceCaustic, randGen, buffer);
           }
         }
         else
@@ -652,17 +735,16 @@ namespace lighter
 
           // Emit a new Photon
           const PhotonRay newPhoton = { hit.hitPoint, scatterDir, newColor, newPower, photon.source, RAY_TYPE_REFLECT, refrIndex };
-          EmitPhoton(hitSector, newPhoton, maxDepth, depth+1, ignoreDirect, produceCaustic);
+          EmitPhoton(hitSector, newPhoton, maxDepth, depth+1, ignoreDirect,
+              produceCaustic, randGen, buffer);
         }
       }
     }
   }
 
-  csVector3 PhotonmapperLighting::SpotlightDir(const csVector3 &dir, const float cosTheta)
+  csVector3 PhotonmapperLighting::SpotlightDir(const csVector3 &dir, const float cosTheta,
+    csRandomFloatGen& randGen)
   {
-    // Local, static random number generator
-    static csRandomFloatGen randGen;
-
     // Get two uniformly distributed random numbers between 0 and 1
     double e1 = randGen.Get();
     double e2 = randGen.Get();
@@ -674,11 +756,9 @@ namespace lighter
     return RotateAroundN(dir, theta, phi);
   }
 
-  csVector3 PhotonmapperLighting::CausticDir(const csVector3 &dir, const float outerFalloffAngle)
+  csVector3 PhotonmapperLighting::CausticDir(const csVector3 &dir, const float outerFalloffAngle,
+    csRandomFloatGen& randGen)
   {
-    // Local, static random number generator
-    static csRandomFloatGen randGen;
-
     // Get two uniformly distributed random numbers between 0 and 1
     double e1 = randGen.Get();
     double e2 = randGen.Get();
@@ -690,12 +770,10 @@ namespace lighter
     return RotateAroundN(dir, theta, phi);
   }
 
-  csVector3 PhotonmapperLighting::DirectionalLightScatter(const csVector3 &dir, const float spRadius,const csVector3 pos)
+  csVector3 PhotonmapperLighting::DirectionalLightScatter(const csVector3 &dir, const float spRadius,const csVector3 pos,
+    csRandomFloatGen& randGen)
   {
 
-    // Local, static random number generator
-    static csRandomFloatGen randGen;
-
     // Get a uniformly distributed random numbers between 0 and 1
     double e1 = randGen.Get();
     double e2 = randGen.Get();
@@ -709,11 +787,9 @@ namespace lighter
 
 
   }
-  csVector3 PhotonmapperLighting::EqualScatter(const csVector3 &n)
+  csVector3 PhotonmapperLighting::EqualScatter(const csVector3 &n,
+    csRandomFloatGen& randGen)
   {
-    // Local, static random number generator
-    static csRandomFloatGen randGen;
-
     // Get two uniformly distributed random numbers between 0 and 1
     double e1 = randGen.Get();
     double e2 = randGen.Get();
@@ -726,11 +802,9 @@ namespace lighter
     return RotateAroundN(n, theta, phi);
   }
 
-  csVector3 PhotonmapperLighting::DiffuseScatter(const csVector3 &n)
+  csVector3 PhotonmapperLighting::DiffuseScatter(const csVector3 &n,
+    csRandomFloatGen& randGen)
   {
-    // Local, static random number generator
-    static csRandomFloatGen randGen;
-
     // Get two uniformly distributed random numbers between 0 and 1
     double e1 = randGen.Get();
     double e2 = randGen.Get();
@@ -744,11 +818,9 @@ namespace lighter
   }
 
   csVector3 PhotonmapperLighting::StratifiedSample(const csVector3 &n, const size_t i,
-                                      const size_t j, const size_t M, const size_t N)
+                                      const size_t j, const size_t M, const size_t N,
+                                      csRandomFloatGen& randGen)
   {
-    // Local, static random number generator
-    static csRandomFloatGen randGen;
-
     // Get two uniformly distributed random numbers between 0 and 1
     double e1 = randGen.Get();
     double e2 = randGen.Get();
@@ -25,6 +25,8 @@
 
 namespace lighter
 {
+  class PhotonBuffer;
+
   struct PhotonRay
   {
     // Origin (O)
@@ -114,30 +116,37 @@ namespace lighter
     * /param maxDepth - the maximum number of recursive bounces allowed
     * /param depth - the number of times this photon has scattered
     * /param ignoreDirect - weather or not to store direct photons (depth=0)
+    * /param produceCaustic - whether the photon is a caustic photon
+    * /param randGen - random numbers for scattering and russian roulette
+    * /param buffer - buffer receiving the photons until they are stored
     */
     static void EmitPhoton(Sector* &sect, const PhotonRay &photon,
-      const size_t &maxDepth, const size_t &depth, const bool &ignoreDirect, bool produceCaustic );
+      const size_t &maxDepth, const size_t &depth, const bool &ignoreDirect,
+      bool produceCaustic, csRandomFloatGen& randGen, PhotonBuffer& buffer);
 
     /**
      * SpotlightDir
      *    Compute a random direction within the cone of the spotlight with
      * direction 'dir' and falloffOutter as 'cosTheta'.
      **/
-    static csVector3 SpotlightDir(const csVector3 &dir, const float cosTheta);
+    static csVector3 SpotlightDir(const csVector3 &dir, const float cosTheta,
+      csRandomFloatGen& randGen);
 
     /**
      * CausticDir
      *    Compute a random direction within the cone of the caustic spotlight with
      * direction 'dir' and falloffOutter as 'cosTheta'.
      **/
-    static csVector3 CausticDir(const csVector3 &dir, const float outerFalloffAngle);
+    static csVector3 CausticDir(const csVector3 &dir, const float outerFalloffAngle,
+      csRandomFloatGen& randGen);
 
     /**
      *DirectionalLightScatter
      *     Generate a point from a circular plane around the position of 
      * spotlight from where to emit the photon
      **/
-    static csVector3 DirectionalLightScatter(const csVector3 &dir, const float spRadius,const csVector3 pos);
+    static csVector3 DirectionalLightScatter(const csVector3 &dir, const float spRadius,const csVector3 pos,
+      csRandomFloatGen& randGen);
     /**
      * EqualScatter
      *    This function will compute a random direction in the hemisphere
@@ -147,7 +156,7 @@ namespace lighter
      * the hemisphere have an equal chance of occuring.
      * /param n - The surface normal at the photons hit point
      **/
-    static csVector3 EqualScatter(const csVector3 &n);
+    static csVector3 EqualScatter(const csVector3 &n, csRandomFloatGen& randGen);
 
     /**
      * DiffuseScatter
@@ -158,7 +167,7 @@ namespace lighter
      * angle between the normal and the new direction (lambert's law).
      * /param n - The surface normal at the phontons hit point
      **/
-    static csVector3 DiffuseScatter(const csVector3 &n);
+    static csVector3 DiffuseScatter(const csVector3 &n, csRandomFloatGen& randGen);
 
     /**
      * StratifiedSample
@@ -172,7 +181,8 @@ namespace lighter
      * /param N - the number of azimuth subdivisions
      **/
     static csVector3 StratifiedSample(const csVector3 &n, const size_t i,
-                        const size_t j, const size_t M, const size_t N);
+                        const size_t j, const size_t M, const size_t N,
+                        csRandomFloatGen& randGen);
     /**
      * RotateAroundN
      *    This function will rotate the vector n away from itself theta radians
@@ -184,8 +194,15 @@ namespace lighter
      **/
     static csVector3 RotateAroundN(const csVector3 &n, const double theta, const double phi);
 
-    csRandomVectorGen randVect;
-    csRandomFloatGen randFloat;
+    /// Photons are emitted by jobs of this many photons
+    enum { EMISSION_JOB_PHOTONS = 1024 };
+
+    struct PhotonEmission;
+    class EmissionJob;
+
+    /// Queue jobs emitting \a numPhotons photons for \a emission
+    static void QueueEmission (const PhotonEmission& emission, int numPhotons,
+      csRefArray<EmissionJob>& jobs);
 
     // These values all come from the lighter2 global settings
     int numPhotonsPerSector;  ///< Number of photons to emit in each sector of the world
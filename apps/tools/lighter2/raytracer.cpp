@@ -24,6 +24,12 @@
 
 #include "scene.h"
 
+#if defined (CS_PROCESSOR_X86) && (defined (__SSE__) || defined (_M_X64) \
+  || (defined (_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define LIGHTER_RAYPACKET_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace lighter
 {
   RaytraceCore globalRaycore;
@@ -46,11 +52,15 @@ namespace lighter
   {
     traversalStack = static_cast<KDTraversalNode*> (CS::Memory::AlignedMalloc (
       sizeof (KDTraversalNode) * MAX_STACK_DEPTH, 32));
+    packetTraversalStack = static_cast<KDPacketTraversalNode*> (
+      CS::Memory::AlignedMalloc (
+        sizeof (KDPacketTraversalNode) * MAX_STACK_DEPTH, 16));
   }
 
   RaytraceState::~RaytraceState ()
   {
     CS::Memory::AlignedFree (traversalStack);
+    CS::Memory::AlignedFree (packetTraversalStack);
   }
 
   static bool IntersectPrimitiveRay (const KDTreePrimitive &primitive, const Ray &ray,
@@ -285,6 +295,286 @@ namespace lighter
   };
 
 
+#ifdef LIGHTER_RAYPACKET_SSE
+  // Ray packet, one ray per vector lane
+  struct RayPacket
+  {
+    __m128 origin[3];
+    __m128 direction[3];
+    __m128 minLength, maxLength;
+  };
+
+  /* Rays can only be traced together if they visit the children of each
+     kd-tree node in the same order and ignore the same primitives. */
+  static bool IsCoherentPacket (const Ray* rays, size_t numRays)
+  {
+    for (size_t i = 1; i < numRays; i++)
+    {
+      if (rays[i].ignoreFlags != rays[0].ignoreFlags ||
+        rays[i].ignorePrimitive != rays[0].ignorePrimitive ||
+        rays[i].ignoreObject != rays[0].ignoreObject)
+        return false;
+
+      for (size_t dim = 0; dim < 3; ++dim)
+      {
+        if ((rays[i].direction[dim] > 0) != (rays[0].direction[dim] > 0))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  /* Intersect the primitives of a leaf with the rays in lanes. Same tests
+     as IntersectPrimitiveRay(), but for all rays at once. Returns the lanes
+     that hit something. */
+  template<typename HitIgnore>
+  static uint IntersectPrimitivesPacket (const KDTreeNode* node, 
+    const Ray* rays, const RayPacket& packet, size_t packetID, uint lanes,
+    HitPoint* hits, RaytraceState& state, HitIgnore& ignoreCB)
+  {
+    size_t nIdx, nMax;
+    nMax = KDTreeNode_Op::GetPrimitiveListSize (node);
+    uint hitLanes = 0;
+
+    const __m128 zero = _mm_setzero_ps ();
+    const __m128 one = _mm_set1_ps (1.0f);
+
+    // Ignore settings are the same for all rays of a packet
+    const Ray& ray = rays[0];
+
+    KDTreePrimitive* primList = KDTreeNode_Op::GetPrimitiveList (node);
+
+    for (nIdx = 0; nIdx < nMax; nIdx++)
+    {
+      KDTreePrimitive* prim = primList + nIdx;
+
+      if (ray.ignoreFlags & (prim->normal_K & KDPRIM_FLAG_MASK)) 
+        continue; 
+
+      if (ray.ignorePrimitive == prim->primPointer)
+        continue;
+
+      const uint testLanes = state.mailbox.PutPrimitivePacket (
+        prim->primPointer, packetID, lanes);
+      if (!testLanes || ignoreCB (prim->primPointer))
+        continue;
+
+      if (ray.ignorePrimitive && 
+        ray.ignorePrimitive->GetPlane () == prim->primPointer->GetPlane ())
+        continue;
+
+      if ((ray.ignoreObject != 0)
+	  && prim->primPointer->GetObject() == ray.ignoreObject)
+        continue;
+
+      const uint k = prim->normal_K & ~KDPRIM_FLAG_MASK;
+      const uint ku = CS::Math::NextModulo3(k);
+      const uint kv = CS::Math::NextModulo3(ku);
+
+      const __m128 nU = _mm_set1_ps (prim->normal_U);
+      const __m128 nV = _mm_set1_ps (prim->normal_V);
+
+      const __m128 nd = _mm_div_ps (one, _mm_add_ps (_mm_add_ps (
+        packet.direction[k], _mm_mul_ps (nU, packet.direction[ku])),
+        _mm_mul_ps (nV, packet.direction[kv])));
+
+      const __m128 f = _mm_mul_ps (_mm_sub_ps (_mm_sub_ps (_mm_sub_ps (
+        _mm_set1_ps (prim->normal_D), packet.origin[k]),
+        _mm_mul_ps (nU, packet.origin[ku])),
+        _mm_mul_ps (nV, packet.origin[kv])), nd);
+
+      /* Check for distance. No ray in range: skip the barycentric tests.
+         This is the whole packet early out for primitives. Culling against
+         the packet frustum first needs the triangle vertices, which are
+         not in the kd-tree; fetching them from the Primitive rejected most
+         primitives, but made coherent packets up to a fifth slower. */
+      uint isct = testLanes & _mm_movemask_ps (_mm_and_ps (
+        _mm_cmpgt_ps (packet.maxLength, f), 
+        _mm_cmpgt_ps (f, packet.minLength)));
+      if (!isct) continue;
+
+      // Compute hitpoint on plane
+      const __m128 hu = _mm_add_ps (packet.origin[ku], 
+        _mm_mul_ps (f, packet.direction[ku]));
+      const __m128 hv = _mm_add_ps (packet.origin[kv], 
+        _mm_mul_ps (f, packet.direction[kv]));
+
+      // Barycentric coordinates
+      const __m128 lambda = _mm_add_ps (_mm_add_ps (
+        _mm_mul_ps (hu, _mm_set1_ps (prim->edgeA_U)),
+        _mm_mul_ps (hv, _mm_set1_ps (prim->edgeA_V))),
+        _mm_set1_ps (prim->edgeA_D));
+      const __m128 mu = _mm_add_ps (_mm_add_ps (
+        _mm_mul_ps (hu, _mm_set1_ps (prim->edgeB_U)),
+        _mm_mul_ps (hv, _mm_set1_ps (prim->edgeB_V))),
+        _mm_set1_ps (prim->edgeB_D));
+      isct &= _mm_movemask_ps (_mm_and_ps (_mm_and_ps (
+        _mm_cmpnlt_ps (lambda, zero), _mm_cmpnlt_ps (mu, zero)),
+        _mm_cmpngt_ps (_mm_add_ps (lambda, mu), one)));
+      if (!isct) continue;
+
+      // Ok, store the hits
+      float dist[4];
+      _mm_storeu_ps (dist, f);
+      for (size_t i = 0; i < Raytracer::PACKET_SIZE; i++)
+      {
+        if (!(isct & (1 << i))) continue;
+
+        HitPoint& hit = hits[i];
+        hit.hitPoint = rays[i].origin + rays[i].direction * dist[i];
+        hit.distance = dist[i];
+        hit.primitive = prim->primPointer;
+        hit.kdFlags = prim->normal_K & KDPRIM_FLAG_MASK;
+      }
+
+      hitLanes |= isct;
+      lanes &= ~isct;
+      if (!lanes) break;
+    }
+
+    return hitLanes;
+  }
+
+  /* Packet version of TraceFunction<true>(). Every ray visits the same
+     leaves in the same order as it would on its own; the packet descends
+     into a child as soon as one of its rays does, and subtrees none of the
+     remaining rays enter are skipped for the whole packet.
+     Nodes are not tested against the packet frustum: the range of each ray
+     is clipped at every split, so a node is only entered when one of the
+     rays really passes through its cell, and the frustum could not reject
+     it. For primitives see IntersectPrimitivesPacket(). */
+  template<typename HitIgnore>
+  static uint TracePacketFunction (const KDTree* tree, const Ray* rays,
+    size_t numRays, HitPoint* hits, HitIgnore& ignoreCB)
+  {
+    // Clip the rays and distribute them over the lanes
+    float origin[3][4], direction[3][4], invDirection[3][4];
+    float minLength[4], maxLength[4];
+    uint alive = 0;
+    for (size_t i = 0; i < Raytracer::PACKET_SIZE; i++)
+    {
+      Ray myRay = rays[(i < numRays) ? i : 0];
+      if (i < numRays)
+      {
+        RaytraceProfiler prof (1, myRay.type);
+        if (myRay.Clip (tree->boundingBox))
+          alive |= 1 << i;
+      }
+      if (!(alive & (1 << i)))
+      {
+        // Empty range, the lane never becomes active
+        myRay.minLength = 1.0f;
+        myRay.maxLength = 0.0f;
+      }
+
+      for (size_t dim = 0; dim < 3; ++dim)
+      {
+        origin[dim][i] = myRay.origin[dim];
+        direction[dim][i] = myRay.direction[dim];
+        invDirection[dim][i] = RaytraceState::InverseDirection (
+          myRay.direction[dim]);
+      }
+      minLength[i] = myRay.minLength;
+      maxLength[i] = myRay.maxLength;
+    }
+    if (!alive)
+      return 0;
+
+    RayPacket packet;
+    __m128 invD[3];
+    size_t nodeOffset[3][2];
+    for (size_t dim = 0; dim < 3; ++dim)
+    {
+      packet.origin[dim] = _mm_loadu_ps (origin[dim]);
+      packet.direction[dim] = _mm_loadu_ps (direction[dim]);
+      invD[dim] = _mm_loadu_ps (invDirection[dim]);
+
+      const bool positive = rays[0].direction[dim] > 0;
+      nodeOffset[dim][0] = positive ? 0 : 1;
+      nodeOffset[dim][1] = positive ? 1 : 0;
+    }
+    packet.minLength = _mm_loadu_ps (minLength);
+    packet.maxLength = _mm_loadu_ps (maxLength);
+
+    // Get a state object
+    RaytraceState& state = globalRaycore.GetRaytraceState ();
+    RaytraceState::KDPacketTraversalNode* stack = state.packetTraversalStack;
+    size_t stackPtr = 0;
+    const size_t packetID = state.mailbox.GetPacketID ();
+
+    __m128 tmin (packet.minLength), tmax (packet.maxLength);
+    KDTreeNode* node = tree->nodeList;
+    uint hitLanes = 0;
+
+    while (true)
+    {
+      while (!KDTreeNode_Op::IsLeaf (node))
+      {
+        uint dim = KDTreeNode_Op::GetDimension (node);
+        const __m128 thit = _mm_mul_ps (_mm_sub_ps (
+          _mm_set1_ps (node->inner.splitLocation), packet.origin[dim]), 
+          invD[dim]);
+
+        KDTreeNode *leftNode = KDTreeNode_Op::GetLeft (node);
+        KDTreeNode *nearNode = leftNode + nodeOffset[dim][0];
+        KDTreeNode *farNode = leftNode + nodeOffset[dim][1];
+
+        const uint active = alive & _mm_movemask_ps (_mm_cmple_ps (tmin, tmax));
+        const uint needNear = active & _mm_movemask_ps (
+          _mm_cmpnlt_ps (thit, tmin));
+        const uint needFar = active & _mm_movemask_ps (
+          _mm_cmpngt_ps (thit, tmax));
+
+        if (!needFar)
+        {
+          node = nearNode;
+        }
+        else if (!needNear)
+        {
+          node = farNode;
+        }
+        else
+        {
+          /* Rays only entering one of the children get an empty range for
+             the other. A NaN split distance keeps the whole range. */
+          _mm_store_ps (stack[stackPtr].tnear, _mm_max_ps (thit, tmin));
+          _mm_store_ps (stack[stackPtr].tfar, tmax);
+          stack[stackPtr].node = farNode;
+          stackPtr++;
+          CS_ASSERT(stackPtr < RaytraceState::MAX_STACK_DEPTH);
+
+          node = nearNode;
+          tmax = _mm_min_ps (thit, tmax);
+        }
+      }
+
+      const uint active = alive & _mm_movemask_ps (_mm_cmple_ps (tmin, tmax));
+      if (active)
+      {
+        const uint isct = IntersectPrimitivesPacket (node, rays, packet, 
+          packetID, active, hits, state, ignoreCB);
+        hitLanes |= isct;
+        alive &= ~isct;
+        if (!alive) break;
+      }
+
+      // Continue with the next subtree any remaining ray enters
+      bool haveNode = false;
+      while (!haveNode && stackPtr > 0)
+      {
+        stackPtr--;
+        node = stack[stackPtr].node;
+        tmin = _mm_load_ps (stack[stackPtr].tnear);
+        tmax = _mm_load_ps (stack[stackPtr].tfar);
+        haveNode = (alive & _mm_movemask_ps (_mm_cmple_ps (tmin, tmax))) != 0;
+      }
+      if (!haveNode) break;
+    }
+
+    return hitLanes;
+  }
+#endif // LIGHTER_RAYPACKET_SSE
+
   //-- Primary ray trace functions
 
   bool Raytracer::TraceAnyHit (const KDTree* tree, const Ray &ray, 
@@ -371,5 +661,35 @@ namespace lighter
       return TraceFunction<false> (tree, ray, hit, hitCB, ignCB);
     }
   }
-}
 
+  uint Raytracer::TraceAnyHitPacket (const KDTree* tree, const Ray* rays,
+    size_t numRays, HitPoint* hits, HitIgnoreCallback* ignoreCB)
+  {
+    CS_ASSERT (numRays <= PACKET_SIZE);
+
+#ifdef LIGHTER_RAYPACKET_SSE
+    if ((numRays > 1) && tree && tree->nodeList &&
+      IsCoherentPacket (rays, numRays))
+    {
+      if (ignoreCB)
+      {
+        IgnoreCallbackObj ignCB (ignoreCB);
+        return TracePacketFunction (tree, rays, numRays, hits, ignCB);
+      }
+      else
+      {
+        IgnoreCallbackNone ignCB;
+        return TracePacketFunction (tree, rays, numRays, hits, ignCB);
+      }
+    }
+#endif
+
+    uint hitMask = 0;
+    for (size_t i = 0; i < numRays; i++)
+    {
+      if (TraceAnyHit (tree, rays[i], hits[i], ignoreCB))
+        hitMask |= 1 << i;
+    }
+    return hitMask;
+  }
+}
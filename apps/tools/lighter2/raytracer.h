@@ -199,6 +199,18 @@ namespace lighter
       return rayID++;
     }
 
+    /**
+     * Get an ID for a ray packet. The low 4 bits of the returned value are
+     * zero; the 16 IDs starting with it are never handed out as ray IDs.
+     */
+    CS_FORCEINLINE size_t GetPacketID ()
+    {
+      rayID = (rayID + 15) & ~size_t (15);
+      size_t packet = rayID;
+      rayID += 16;
+      return packet;
+    }
+
     CS_FORCEINLINE bool PutPrimitiveRay (const Primitive* prim, size_t ray)
     {
       size_t hashPos = (reinterpret_cast<uintptr_t> (prim) >> 3) & (HASH_SIZE-1);
@@ -216,6 +228,28 @@ namespace lighter
       return false;
     }
 
+    /**
+     * Packet version of PutPrimitiveRay(): record that the rays in \a lanes
+     * of \a packet test \a prim. Returns the lanes which did not test it
+     * before.
+     */
+    CS_FORCEINLINE uint PutPrimitivePacket (const Primitive* prim, 
+      size_t packet, uint lanes)
+    {
+      size_t hashPos = (reinterpret_cast<uintptr_t> (prim) >> 3) & (HASH_SIZE-1);
+      
+      HashEntry& e = hash[hashPos];
+
+      uint tested = 0;
+      if (e.primPointer == prim &&
+        (e.rayID & ~size_t (15)) == packet)
+        tested = uint (e.rayID & 15);
+
+      e.primPointer = prim;
+      e.rayID = packet | tested | lanes;
+      return lanes & ~tested;
+    }
+
   private:
     size_t rayID;
 
@@ -254,12 +288,24 @@ namespace lighter
           nodeOffset[dim][0] = 1;
           nodeOffset[dim][1] = 0;
         }
-        invD[dim] = 1.0f / ray.direction[dim];
+        invD[dim] = InverseDirection (ray.direction[dim]);
       }
 
       ray.rayID = mailbox.GetRayID ();
     }
 
+    /**
+     * Inverse of a direction component for the split distances. Zero is
+     * taken as a tiny negative value, as it picks the near child like a
+     * negative one, so a ray parallel to a split plane only enters the
+     * child its origin is in. An infinite inverse would send it the wrong
+     * way (and is not reliable with fast math).
+     */
+    static CS_FORCEINLINE float InverseDirection (float d)
+    {
+      return 1.0f / ((d != 0) ? d : -1e-30f);
+    }
+
     // Stack handling
     CS_FORCEINLINE void PutNode (KDTreeNode* node, float tnear, float tfar)
     {
@@ -309,6 +355,15 @@ namespace lighter
     size_t traversalStackPtr;
     KDTraversalNode* traversalStack;
 
+    // Helperstruct for kd traversal of ray packets
+    struct KDPacketTraversalNode
+    {
+      float tnear[4], tfar[4];
+      KDTreeNode *node;
+      uint8 pad[16 - sizeof (KDTreeNode*)];
+    };
+    KDPacketTraversalNode* packetTraversalStack;
+
     size_t nodeOffset[3][2];
     csVector3 invD;
   };
@@ -353,6 +408,19 @@ namespace lighter
      */
     static bool TraceAllHits (const KDTree* tree, const Ray &ray, 
       HitPointCallback* hitCallback, HitIgnoreCallback* ignoreCB = 0);
+
+    /// Maximum number of rays traced together by TraceAnyHitPacket()
+    enum { PACKET_SIZE = 4 };
+
+    /**
+     * Raytrace up to PACKET_SIZE rays until there is any hit for each.
+     * Returns a bit mask of the rays which hit something; \a hits receives
+     * their hit points. Rays with the same direction signs and ignore
+     * settings are traced together through the tree with SSE, others one
+     * by one.
+     */
+    static uint TraceAnyHitPacket (const KDTree* tree, const Ray* rays,
+      size_t numRays, HitPoint* hits, HitIgnoreCallback* ignoreCB = 0);
   };
 
   class RaytraceProfiler
@@ -362,6 +430,8 @@ namespace lighter
     {
       if(type == RAY_TYPE_IGNORE) return;
 
+      if (globalStats.raytracer.numRays == 0)
+        globalStats.raytracer.startTime = csGetTicks ();
       globalStats.raytracer.numRays += numRays;
 
       switch(type)
@@ -168,44 +168,43 @@ namespace lighter
       v += size_t (floorf (minUV.y));
     }
 
+    // The four quadrants are shaded together
+    CS_COMPILE_ASSERT(Raytracer::PACKET_SIZE >= 4);
+    csVector3 pos[4], normal[4];
+    InfluenceRecorder inflRec[4];
     for (size_t qi = 0; qi < 4; ++qi)
     {
       const csVector3 offsetVector = uVec * ElementQuadrantConstants[qi].x +
         vVec * ElementQuadrantConstants[qi].y;
 
-      csVector3 pos = elementC + offsetVector;
+      pos[qi] = elementC + offsetVector;
       
-      const csVector3 normal = ComputeElementNormal (element, pos);
+      normal[qi] = ComputeElementNormal (element, pos[qi]);
       if (elemType == Primitive::ELEMENT_BORDER)
       {
         const float fudge = EPSILON;
         /* Slightly offset the point on the primitive to work around unwanted 
            occlusions by e.g. neighbouring prims */
-        pos -= element.primitive.GetPlane().Normal() * fudge;
+        pos[qi] -= element.primitive.GetPlane().Normal() * fudge;
       }
 
       if (recordInfluence)
       {
         csMatrix3 ts (element.primitive.GetObject()->ComputeTangentSpace (
-          &element.primitive, pos));
+          &element.primitive, pos[qi]));
         
-        InfluenceRecorder inflRec (element.primitive.GetObject(),
+        inflRec[qi] = InfluenceRecorder (element.primitive.GetObject(),
           u, v, ts, element.primitive.GetGroupID(), 0.25f);
-        
-        res += shade.ShadeLight (element.primitive.GetObject(), 
-	        pos, normal, lightSampler,
-	        &element.primitive,
-	        elemType == Primitive::ELEMENT_BORDER,
-	        &inflRec);
-      }
-      else
-      {
-        res += shade.ShadeLight (element.primitive.GetObject(), 
-          pos, normal, lightSampler,
-        &element.primitive,
-        elemType == Primitive::ELEMENT_BORDER);
       }
     }
+
+    csColor colors[4];
+    shade.ShadeLight (element.primitive.GetObject(), 4, pos, normal, 
+      lightSampler, colors, &element.primitive,
+      elemType == Primitive::ELEMENT_BORDER,
+      recordInfluence ? inflRec : 0);
+    for (size_t qi = 0; qi < 4; ++qi)
+      res += colors[qi];
     
     return 0.25f * res;
   }
@@ -225,28 +224,33 @@ namespace lighter
     influences.AddDirection (u, v, dirT, color.Luminance() * weight);
   }
   
-  csColor RaytracerLighting::ShadeAllLightsNonPD::ShadeLight (Object* obj, 
-    const csVector3& point, const csVector3& normal, 
-    SamplerSequence<2>& lightSampler,
+  void RaytracerLighting::ShadeAllLightsNonPD::ShadeLight (Object* obj, 
+    size_t num, const csVector3* points, const csVector3* normals, 
+    SamplerSequence<2>& lightSampler, csColor* colors,
     const Primitive* shadowIgnorePrimitive, 
-    bool fullIgnore, InfluenceRecorder* influenceRec)
+    bool fullIgnore, InfluenceRecorder* influenceRecs)
   {
-    csColor res (0);
+    for (size_t p = 0; p < num; ++p)
+      colors[p].Set (0, 0, 0);
+
     for (size_t i = 0; i < allLights.GetSize (); ++i)
     {
       if (!lighting.affectingLights.IsBitSet (i)) 
         continue;
 
-      csVector3 lightVec;
-      csColor litColor (lighting.ShadeLight (allLights[i], obj, point,
-        normal, lightSampler,
-        shadowIgnorePrimitive, fullIgnore, &lightVec));
+      csVector3 lightVec[Raytracer::PACKET_SIZE];
+      csColor litColor[Raytracer::PACKET_SIZE];
+      lighting.ShadeLight (allLights[i], obj, num, points, normals,
+        lightSampler, litColor, shadowIgnorePrimitive, fullIgnore, lightVec);
       
-      if (influenceRec)
-        influenceRec->RecordInfluence (allLights[i], lightVec, litColor);
-      res += litColor;
+      for (size_t p = 0; p < num; ++p)
+      {
+        if (influenceRecs)
+          influenceRecs[p].RecordInfluence (allLights[i], lightVec[p],
+            litColor[p]);
+        colors[p] += litColor[p];
+      }
     }
-    return res;
   }
 
   // Shade a primitive element with direct lighting
@@ -259,27 +263,34 @@ namespace lighter
     return UniformShadeElement (shade, element, lightSampler, recordInfluence);
   }
 
-  csColor RaytracerLighting::ShadeRndLightNonPD::ShadeLight (Object* obj, 
-    const csVector3& point, const csVector3& normal, 
-    SamplerSequence<2>& sampler, 
+  void RaytracerLighting::ShadeRndLightNonPD::ShadeLight (Object* obj, 
+    size_t num, const csVector3* points, const csVector3* normals, 
+    SamplerSequence<2>& sampler, csColor* colors,
     const Primitive* shadowIgnorePrimitive, 
-    bool fullIgnore, InfluenceRecorder* influenceRec)
+    bool fullIgnore, InfluenceRecorder* influenceRecs)
   {
-    float rndValues[3];
-    
-    lightSampler.GetNext (rndValues);
-    size_t lightIdx = (size_t) floorf (allLights.GetSize () * rndValues[2]);
+    // Each point picks its own light, so there are no packets to trace
+    for (size_t p = 0; p < num; ++p)
+    {
+      float rndValues[3];
+      
+      lightSampler.GetNext (rndValues);
+      size_t lightIdx = (size_t) floorf (allLights.GetSize () * rndValues[2]);
 
-    if (!lighting.affectingLights.IsBitSet (lightIdx)) 
-      return csColor (0);
+      if (!lighting.affectingLights.IsBitSet (lightIdx)) 
+      {
+        colors[p].Set (0, 0, 0);
+        continue;
+      }
 
-    csVector3 lightVec;
-    csColor litColor (lighting.ShadeLight (allLights[lightIdx], obj, point,
-      normal, sampler,
-      shadowIgnorePrimitive, fullIgnore, &lightVec));
-    if (influenceRec)
-      influenceRec->RecordInfluence (allLights[lightIdx], lightVec, litColor);
-    return litColor;
+      csVector3 lightVec;
+      colors[p] = lighting.ShadeLight (allLights[lightIdx], obj, points[p],
+        normals[p], sampler,
+        shadowIgnorePrimitive, fullIgnore, &lightVec);
+      if (influenceRecs)
+        influenceRecs[p].RecordInfluence (allLights[lightIdx], lightVec,
+          colors[p]);
+    }
   }
 
   // Shade a primitive element with direct lighting using a single light
@@ -301,19 +312,20 @@ namespace lighter
     return ShadeLight (light, obj, point, normal, sampler);
   }
 
-  csColor RaytracerLighting::ShadeOneLight::ShadeLight (Object* obj, 
-    const csVector3& point, const csVector3& normal, 
-    SamplerSequence<2>& sampler,
+  void RaytracerLighting::ShadeOneLight::ShadeLight (Object* obj, 
+    size_t num, const csVector3* points, const csVector3* normals, 
+    SamplerSequence<2>& sampler, csColor* colors,
     const Primitive* shadowIgnorePrimitive,
-    bool fullIgnore, InfluenceRecorder* influenceRec)
+    bool fullIgnore, InfluenceRecorder* influenceRecs)
   {
-    csVector3 lightVec;
-    csColor litColor (lighting.ShadeLight (light, obj, point,
-      normal, sampler,
-      shadowIgnorePrimitive, fullIgnore, &lightVec));
-    if (influenceRec)
-      influenceRec->RecordInfluence (light, lightVec, litColor);
-    return litColor;
+    csVector3 lightVec[Raytracer::PACKET_SIZE];
+    lighting.ShadeLight (light, obj, num, points, normals, sampler, colors,
+      shadowIgnorePrimitive, fullIgnore, lightVec);
+    if (influenceRecs)
+    {
+      for (size_t p = 0; p < num; ++p)
+        influenceRecs[p].RecordInfluence (light, lightVec[p], colors[p]);
+    }
   }
 
   csColor RaytracerLighting::UniformShadeOneLight (Sector* sector, ElementProxy element,
@@ -326,9 +338,8 @@ namespace lighter
   class RaytracerLightingBorderIgnoreCb : public HitIgnoreCallback
   {
   public:
-    explicit RaytracerLightingBorderIgnoreCb (const Primitive* ignorePrim,
-      const csVector3& rayDir, const csVector3& point) : ignorePrim (ignorePrim), 
-        rayDir (rayDir), point (point)
+    explicit RaytracerLightingBorderIgnoreCb (const Primitive* ignorePrim)
+      : ignorePrim (ignorePrim)
     {}
 
     virtual bool IgnoreHit (const Primitive* prim)
@@ -342,8 +353,6 @@ namespace lighter
 
   private:
     const Primitive* ignorePrim;
-    const csVector3 rayDir;
-    const csVector3 point;
   };
   
   csColor RaytracerLighting::ShadeLight (Light* light, Object* obj, 
@@ -352,50 +361,91 @@ namespace lighter
     const Primitive* shadowIgnorePrimitive, bool fullIgnore,
     csVector3* incomingLightVec)
   {
+    csColor color;
+    ShadeLight (light, obj, 1, &point, &normal, lightSampler, &color,
+      shadowIgnorePrimitive, fullIgnore, incomingLightVec);
+    return color;
+  }
+
+  void RaytracerLighting::ShadeLight (Light* light, Object* obj, size_t num,
+    const csVector3* points, const csVector3* normals, 
+    SamplerSequence<2>& lightSampler, csColor* colors,
+    const Primitive* shadowIgnorePrimitive, bool fullIgnore,
+    csVector3* incomingLightVecs)
+  {
+    CS_ASSERT (num <= Raytracer::PACKET_SIZE);
+    CS_COMPILE_ASSERT(Raytracer::PACKET_SIZE == 4);
+
     // Some variables..
-    VisibilityTester visTester (light, obj);
-    float lightPdf, cosineTerm = 0;
-    csVector3 lightVec;
+    VisibilityTester visTester[Raytracer::PACKET_SIZE] = {
+      VisibilityTester (light, obj), VisibilityTester (light, obj),
+      VisibilityTester (light, obj), VisibilityTester (light, obj) };
+    float lightPdf[Raytracer::PACKET_SIZE];
+    float cosineTerm[Raytracer::PACKET_SIZE];
     const Object* ignObj = obj->GetFlags().Check (OBJECT_FLAG_NOSELFSHADOW)
       ? obj : 0;
 
     const bool isDelta = true; //light->IsDeltaLight (); no support for area lights yet
 
-    float lightSamples[2] = {0};
-    if (!isDelta)
-      lightSampler.GetNext (lightSamples);
+    // Points that need an occlusion test
+    VisibilityTester* occlTester[Raytracer::PACKET_SIZE];
+    size_t occlPoint[Raytracer::PACKET_SIZE];
+    size_t numOccl = 0;
 
-    csColor lightColor = light->SampleLight (point, normal, lightSamples[0],
-      lightSamples[1], lightVec, lightPdf, visTester);
-
-    if (incomingLightVec) *incomingLightVec = lightVec;
-    if (lightPdf > 0.0f && !lightColor.IsBlack () &&
-      (cosineTerm = normal * lightVec) > 0)
+    for (size_t p = 0; p < num; ++p)
     {
-      VisibilityTester::OcclusionState occlusion;
-      if (fullIgnore)
+      float lightSamples[2] = {0};
+      if (!isDelta)
+        lightSampler.GetNext (lightSamples);
+
+      csVector3 lightVec;
+      colors[p] = light->SampleLight (points[p], normals[p], lightSamples[0],
+        lightSamples[1], lightVec, lightPdf[p], visTester[p]);
+
+      if (incomingLightVecs) incomingLightVecs[p] = lightVec;
+      if (lightPdf[p] > 0.0f && !colors[p].IsBlack () &&
+        (cosineTerm[p] = normals[p] * lightVec) > 0)
       {
-        RaytracerLightingBorderIgnoreCb icb (shadowIgnorePrimitive, -lightVec,
-          point);
-        occlusion = visTester.Occlusion (ignObj, &icb);
+        occlTester[numOccl] = &visTester[p];
+        occlPoint[numOccl] = p;
+        numOccl++;
       }
       else
+        colors[p].Set (0, 0, 0);
+    }
+    if (numOccl == 0) return;
+
+    VisibilityTester::OcclusionState occlusion[Raytracer::PACKET_SIZE];
+    if (fullIgnore)
+    {
+      RaytracerLightingBorderIgnoreCb icb (shadowIgnorePrimitive);
+      VisibilityTester::Occlusion (occlTester, numOccl, ignObj, &icb,
+        occlusion);
+    }
+    else
+    {
+      VisibilityTester::Occlusion (occlTester, numOccl, ignObj,
+        shadowIgnorePrimitive, occlusion);
+    }
+
+    for (size_t i = 0; i < numOccl; ++i)
+    {
+      const size_t p = occlPoint[i];
+      csColor& lightColor = colors[p];
+      if (occlusion[i] == VisibilityTester::occlOccluded)
       {
-        occlusion = visTester.Occlusion (ignObj, shadowIgnorePrimitive);
+        lightColor.Set (0, 0, 0);
+        continue;
       }
-      if (occlusion == VisibilityTester::occlOccluded)
-        return csColor (0, 0, 0);
-      else if (occlusion == VisibilityTester::occlPartial)
-        lightColor *= visTester.GetFilterColor ();
+      else if (occlusion[i] == VisibilityTester::occlPartial)
+        lightColor *= visTester[p].GetFilterColor ();
         
       if (isDelta)
-        return lightColor * fabsf (cosineTerm) / lightPdf;
+        lightColor = lightColor * fabsf (cosineTerm[p]) / lightPdf[p];
       else
         // Properly handle area sources! See pbrt page 732
-        return lightColor * fabsf (cosineTerm) / lightPdf;
+        lightColor = lightColor * fabsf (cosineTerm[p]) / lightPdf[p];
     }
-
-    return csColor (0,0,0);
   }
 
   csVector3 RaytracerLighting::ComputeElementNormal (ElementProxy element,
@@ -101,10 +101,12 @@ namespace lighter
     {
       Object* obj;
       size_t u, v;
-      const csMatrix3& ts;
+      csMatrix3 ts;
       uint primGroup;
       float weight;
     
+      InfluenceRecorder () : obj (0), u (0), v (0), primGroup (0),
+        weight (0) {}
       InfluenceRecorder (Object* obj, size_t u, size_t v,
         const csMatrix3& ts, uint primGroup,
         float weight) : obj (obj), u (u), v (v), ts (ts),
@@ -121,10 +123,11 @@ namespace lighter
       ShadeAllLightsNonPD (RaytracerLighting& lighting, 
         const LightRefArray& allLights) : lighting (lighting), 
         allLights (allLights) {}
-      inline csColor ShadeLight (Object* obj, const csVector3& point, 
-        const csVector3& normal, SamplerSequence<2>& lightSampler, 
+      inline void ShadeLight (Object* obj, size_t num, 
+        const csVector3* points, const csVector3* normals, 
+        SamplerSequence<2>& lightSampler, csColor* colors,
         const Primitive* shadowIgnorePrimitive = 0, 
-        bool fullIgnore = false, InfluenceRecorder* influenceRec = 0);
+        bool fullIgnore = false, InfluenceRecorder* influenceRecs = 0);
     };
 
     struct ShadeRndLightNonPD
@@ -136,10 +139,11 @@ namespace lighter
         const LightRefArray& allLights, SamplerSequence<3>& lightSampler) : 
         lighting (lighting), allLights (allLights), 
         lightSampler (lightSampler) {}
-      inline csColor ShadeLight (Object* obj, const csVector3& point, 
-        const csVector3& normal, SamplerSequence<2>& sampler, 
+      inline void ShadeLight (Object* obj, size_t num, 
+        const csVector3* points, const csVector3* normals, 
+        SamplerSequence<2>& sampler, csColor* colors,
         const Primitive* shadowIgnorePrimitive = 0, 
-        bool fullIgnore = false, InfluenceRecorder* influenceRec = 0);
+        bool fullIgnore = false, InfluenceRecorder* influenceRecs = 0);
     };
 
     struct ShadeOneLight
@@ -148,10 +152,11 @@ namespace lighter
       Light* light;
       ShadeOneLight (RaytracerLighting& lighting, Light* light) : 
         lighting (lighting), light (light) {}
-      inline csColor ShadeLight (Object* obj, const csVector3& point, 
-        const csVector3& normal, SamplerSequence<2>& sampler, 
+      inline void ShadeLight (Object* obj, size_t num, 
+        const csVector3* points, const csVector3* normals, 
+        SamplerSequence<2>& sampler, csColor* colors,
         const Primitive* shadowIgnorePrimitive = 0, 
-        bool fullIgnore = false, InfluenceRecorder* influenceRec = 0);
+        bool fullIgnore = false, InfluenceRecorder* influenceRecs = 0);
     };
 
     // Methods...
@@ -161,6 +166,14 @@ namespace lighter
       const Primitive* shadowIgnorePrimitive = 0, 
       bool fullIgnore = false, csVector3* incomingLightVec = 0);
 
+    /* Shade up to Raytracer::PACKET_SIZE points with one light. The shadow
+       rays are traced together as a packet. */
+    void ShadeLight (Light* light, Object* obj, size_t num,
+      const csVector3* points, const csVector3* normals, 
+      SamplerSequence<2>& lightSampler, csColor* colors,
+      const Primitive* shadowIgnorePrimitive = 0, 
+      bool fullIgnore = false, csVector3* incomingLightVecs = 0);
+
     // Helpers
     csVector3 ComputeElementNormal (ElementProxy element, const csVector3& pt) const;
     
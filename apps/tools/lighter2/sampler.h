@@ -88,8 +88,8 @@ namespace lighter
   class SampleSequenceIndex : public csRefCount
   {
   public:
-    SampleSequenceIndex ()
-      : sequenceIndex (1)
+    SampleSequenceIndex (uint startIndex = 1)
+      : sequenceIndex (startIndex)
     {
     }
 
@@ -114,6 +114,12 @@ namespace lighter
       seqIndexHolder.AttachNew (new SampleSequenceIndex);
     }
 
+    /// Start the sequence at a given index instead of the beginning
+    explicit SamplerSequence (uint startIndex)
+    {
+      seqIndexHolder.AttachNew (new SampleSequenceIndex (startIndex));
+    }
+
     SamplerSequence (const SamplerSequence& other)
     {
       seqIndexHolder = other.GetIndexHolder ();
@@ -306,24 +306,24 @@ namespace lighter
     }
   }
 
-  void Sector::AddPhoton(const csColor power, const csVector3 pos,
-    const csVector3 dir )
+  void Sector::AddPhoton(PhotonBuffer& buffer, const csColor power,
+    const csVector3 pos, const csVector3 dir )
   {
     const float fPower[3] = { power.red, power.green, power.blue };
     const float fPos[3] = { pos.x, pos.y, pos.z };
     const float fDir[3] = { dir.x, dir.y, dir.z };
 
-    photonMap->Store(fPower, fPos, fDir);
+    buffer.Add(photonMap, fPower, fPos, fDir);
   }
 
-  void Sector::AddCausticPhoton(const csColor power, const csVector3 pos,
-    const csVector3 dir )
+  void Sector::AddCausticPhoton(PhotonBuffer& buffer, const csColor power,
+    const csVector3 pos, const csVector3 dir )
   {
     const float fPower[3] = { power.red, power.green, power.blue };
     const float fPos[3] = { pos.x, pos.y, pos.z };
     const float fDir[3] = { dir.x, dir.y, dir.z };
 
-    causticPhotonMap->Store(fPower, fPos, fDir);
+    buffer.Add(causticPhotonMap, fPower, fPos, fDir);
   }
 
   void Sector::ScalePhotons(const float scale)
@@ -384,29 +384,48 @@ namespace lighter
   csColor Sector::SamplePhoton(const csVector3 point, const csVector3 normal,
                     const float searchRad)
   {
-    if (photonMap->GetPhotonCount() == 0) return csColor(0, 0, 0);
+    csColor result;
+    SamplePhotons(1, &point, &normal, searchRad, &result);
+    return result;
+  }
+
+  void Sector::SamplePhotons(size_t num, const csVector3* points,
+                    const csVector3* normals, const float searchRad,
+                    csColor* irrad)
+  {
+    if (photonMap->GetPhotonCount() == 0)
+    {
+      for (size_t i = 0; i < num; i++)
+        irrad[i].Set(0, 0, 0);
+      return;
+    }
 
     // Local copy of the global options
     const static size_t densitySamples =
       globalConfig.GetIndirectProperties ().maxDensitySamples;
 
+    // Vectors and colors are laid out as three floats
+    const float (*fPos)[3] = reinterpret_cast<const float (*)[3]> (points);
+    const float (*fNorm)[3] = reinterpret_cast<const float (*)[3]> (normals);
+    float (*result)[3] = reinterpret_cast<float (*)[3]> (irrad);
+
     // Sample the photon map
-    float result[3] = {0, 0, 0};
-    float fPos[3] = { point.x, point.y, point.z };
-    float fNorm[3] = { normal.x, normal.y, normal.z };
-    photonMap->IrradianceEstimate(result, fPos, fNorm, searchRad, densitySamples);
+    photonMap->IrradianceEstimates(num, result, fPos, fNorm, searchRad,
+      densitySamples);
     
     if ((causticPhotonMap != NULL) && (causticPhotonMap->GetPhotonCount() > 0))
     {
-      float causticIrradiance[3] = {0,0,0};
-      causticPhotonMap->IrradianceEstimate(causticIrradiance,fPos,fNorm,searchRad,densitySamples);
-      result [0] += causticIrradiance[0];
-      result [1] += causticIrradiance[1];
-      result [2] += causticIrradiance[2];
+      CS_ALLOC_STACK_ARRAY_FALLBACK(float, causticIrradiance, num*3, 3*1024);
+      float (*caustic)[3] = reinterpret_cast<float (*)[3]> (causticIrradiance);
+      causticPhotonMap->IrradianceEstimates(num, caustic, fPos, fNorm,
+        searchRad, densitySamples);
+      for (size_t i = 0; i < num; i++)
+      {
+        result[i][0] += caustic[i][0];
+        result[i][1] += caustic[i][1];
+        result[i][2] += caustic[i][2];
+      }
     }
-    
-    // Return result as a csColor
-    return csColor(result[0], result[1], result[2]);
   }
 
   void Sector::AddToIRCache(const csVector3 point, const csVector3 normal,
@@ -420,82 +439,77 @@ namespace lighter
     irradianceCache->Store(fPos, fNorm, fPow, mean);
   }
 
-  csArray<csArray<csRef<Object> > *> Sector::getObjectBatches(size_t& primitivesCount)
+  void Sector::SavePhotonMap(const char* filename)
   {
-    primitivesCount = 0;
-
-    // We multiply the number of thread by 2 because sometimes all the jobs
-    // don't request the same amount of time
-    const int numJobs = ((float)globalConfig.GetLighterProperties().numThreads)*2.0f;
-
-    csArray<csArray<csRef<lighter::Object> >*> objectsBatches;
+    if((photonMap != NULL)&&(photonMap->GetPhotonCount() > 0))
+    {
+      photonMap->SaveToFile(filename);
+    }
+  }
 
-    for (int i =0; i < numJobs; i++){
-      objectsBatches.Push(new csArray<csRef<lighter::Object> >());
+  void Sector::SaveCausticPhotonMap(const char* filename)
+  {
+    if((causticPhotonMap != NULL)&&(causticPhotonMap->GetPhotonCount() > 0))
+    {
+      causticPhotonMap->SaveToFile(filename);
     }
+  }
 
-    int assignedBatch=0;
+  //-------------------------------------------------------------------------
 
-    // Sum up total amount of elements for progress display purposes
-    ObjectHash::GlobalIterator giter = allObjects.GetIterator ();
-    while (giter.HasNext ())
-    {
-      // Get the next object and skip unlight objects
-      csRef<Object> obj = giter.Next ();
-      if (!obj->GetFlags ().Check (OBJECT_FLAG_NOLIGHT))
-      {
+  LightingTile::LightingTile (Object* obj, int pass, size_t first,
+    size_t last, size_t tile, LightmapCommitQueue* commitQueue,
+    uint sampleIndex, bool enableRaytracer, bool enablePhotonMapper,
+    Statistics::Progress* progress, size_t totalElements,
+    float progressFactor)
+    : scfImplementationType (this), obj (obj), pass (pass), first (first),
+      last (last), tile (tile), commitQueue (commitQueue),
+      sampleIndex (sampleIndex), enableRaytracer (enableRaytracer),
+      enablePhotonMapper (enablePhotonMapper), progress (progress),
+      totalElements (totalElements), progressFactor (progressFactor)
+  {
+  }
 
-        // Count elements (vertices or primitives depending on global settings)
-        if (obj->lightPerVertex)
-          primitivesCount += obj->GetVertexData().positions.GetSize();
+  void LightingTile::Run ()
+  {
+    const csVector3 bases[4] =
+    {
+      csVector3 (0, 0, 1),
+      csVector3 (/* -1/sqrt(6) */ -0.408248f, /* 1/sqrt(2) */ 0.707107f, /* 1/sqrt(3) */ 0.577350f),
+      csVector3 (/* sqrt(2/3) */ 0.816497f, 0, /* 1/sqrt(3) */ 0.577350f),
+      csVector3 (/* -1/sqrt(6) */ -0.408248f, /* -1/sqrt(2) */ -0.707107f, /* 1/sqrt(3) */ 0.577350f)
+    };
 
-        else
-        {
-          // Loop through submesses to get a count all primitives
-          csArray<PrimitiveArray>& submeshArray = obj->GetPrimitives ();
-          for (size_t submesh = 0; submesh < submeshArray.GetSize (); ++submesh)
-          {
-            PrimitiveArray& primArray = submeshArray[submesh];
+    LightCalculator lighting (bases[pass],pass);
 
-            for (size_t pidx = 0; pidx < primArray.GetSize (); ++pidx)
-            {
-              Primitive& prim = primArray[pidx];
-              primitivesCount += prim.GetElementCount();
-            }
-          }
-        }
+    // Add components to the light calculator
+    RaytracerLighting *raytracerComponent = NULL;
+    PhotonmapperLighting *photonmapperComponent = NULL;
 
-        objectsBatches[assignedBatch]->Push(obj);
-        assignedBatch = (assignedBatch+1)%numJobs;
-      }
+    if(enableRaytracer)
+    {
+      raytracerComponent = new RaytracerLighting (bases[pass],pass);
+      lighting.addComponent(raytracerComponent, 1.0f, 0.0f);
     }
 
-    // Prevent empty batch
-    int batchId = objectsBatches.GetSize()-1;
-    while ((batchId >= 0 ) && objectsBatches[batchId]->IsEmpty())
+    if(enablePhotonMapper)
     {
-      delete objectsBatches[batchId];
-      objectsBatches.DeleteIndex(batchId);
-      batchId--;
+      photonmapperComponent = new PhotonmapperLighting();
+      lighting.addComponent(photonmapperComponent, 1.0f, 0.0f);
     }
 
-    return objectsBatches;
-  }
+    SamplerSequence<2> sampler (sampleIndex);
+    LightmapContributionArray contributions;
+    Statistics::ProgressState progressState(*progress,totalElements,progressFactor);
+    lighting.ComputeObjectTileLighting (obj, first, last, sampler,
+      contributions, progressState);
+    progressState.Finish();
 
-  void Sector::SavePhotonMap(const char* filename)
-  {
-    if((photonMap != NULL)&&(photonMap->GetPhotonCount() > 0))
-    {
-      photonMap->SaveToFile(filename);
-    }
-  }
+    if (commitQueue)
+      commitQueue->Commit (tile, contributions);
 
-  void Sector::SaveCausticPhotonMap(const char* filename)
-  {
-    if((causticPhotonMap != NULL)&&(causticPhotonMap->GetPhotonCount() > 0))
-    {
-      causticPhotonMap->SaveToFile(filename);
-    }
+    if(raytracerComponent != NULL) delete raytracerComponent;
+    if(photonmapperComponent != NULL) delete photonmapperComponent;
   }
 
   //-------------------------------------------------------------------------
@@ -578,63 +592,146 @@ namespace lighter
     }
   }
 
+  void SectorGroup::QueueTile (LightingTile* tile)
+  {
+    csRef<iJob> job;
+    job.AttachNew (tile);
+    globalLighter->jobManager->Enqueue (job);
+    lightingTiles.Push (job);
+  }
+
   void SectorGroup::ComputeLighting(bool enableRaytracer, bool enablePhotonMapper,
     Statistics::Progress& progress)
   { 
     int numPasses = 
       globalConfig.GetLighterProperties().directionalLMs ? 4 : 1;
 
-    csRefArray<iThreadReturn> returns;
-    SectorHash::GlobalIterator sectIt = sectors.GetIterator();
+    // Light influences are accumulated without synchronization, so objects
+    // recording them are lit in a single tile
+    bool recordInfluence =
+      globalConfig.GetLighterProperties().specularDirectionMaps;
 
-    csArray<csArray<csArray<csRef<lighter::Object> >*> >sectorObjectBatch;
-    size_t totalPrimitivesCount = 0;
+    size_t totalElements = 0;
     float totalObject = 0;
 
-    
+    // Sum up total amount of elements for progress display purposes
+    SectorHash::GlobalIterator sectIt = sectors.GetIterator();
     while (sectIt.HasNext())
     {
       csRef<Sector> sector = sectIt.Next();
       totalObject += sector->allObjects.GetSize();
-      size_t sectorPrimitivesCount;
-      csArray<csArray<csRef<lighter::Object> >*> batches = sector->getObjectBatches(sectorPrimitivesCount);
-      if (!batches.IsEmpty())
-      {
-        totalPrimitivesCount += sectorPrimitivesCount;
-        sectorObjectBatch.Push(batches);
-      }
-    }
-
-    float progressFactor = totalObject / ((float) globalStats.scene.numObjects);
 
-    csArray<csArray<csRef<lighter::Object> >*> objectBatch;
-    int id = 0;
-    while (!sectorObjectBatch.IsEmpty())
-    {
-      id %= sectorObjectBatch.GetSize();
+      ObjectHash::GlobalIterator objIt = sector->allObjects.GetIterator ();
+      while (objIt.HasNext ())
+      {
+        csRef<Object> obj = objIt.Next ();
+        if (obj->GetFlags ().Check (OBJECT_FLAG_NOLIGHT))
+          continue;
 
-      objectBatch.Push(sectorObjectBatch[id].Pop());
-      if (sectorObjectBatch[id].IsEmpty()) {
-        sectorObjectBatch.DeleteIndex(id);
-      }
-      else {
-        id += 1;
+        // Count elements (vertices or primitives depending on global settings)
+        if (obj->lightPerVertex)
+        {
+          totalElements += obj->GetVertexData().positions.GetSize();
+          continue;
+        }
+        csArray<PrimitiveArray>& submeshArray = obj->GetPrimitives ();
+        for (size_t submesh = 0; submesh < submeshArray.GetSize (); ++submesh)
+        {
+          PrimitiveArray& primArray = submeshArray[submesh];
+          for (size_t pidx = 0; pidx < primArray.GetSize (); ++pidx)
+            totalElements += primArray[pidx].GetElementCount();
+        }
       }
     }
+    totalElements *= numPasses;
+
+    float progressFactor =
+      totalObject / ((float) globalStats.scene.numObjects) * 0.90f;
 
-    csArray<csArray<csRef<lighter::Object> >*>::Iterator batchIt = objectBatch.GetIterator();
+    // Split the objects into tiles. The tiles are independent of the number
+    // of threads and each one gets its own stretch of the sample sequence,
+    // so the result doesn't depend on which thread lights which tile.
     for (int pass=0; pass < numPasses; pass ++)
     {
-      while (batchIt.HasNext())
+      sectIt.Reset();
+      while (sectIt.HasNext())
       {
-        lightComputations.Push(sectorProcessor->ComputeObjectGroupLighting(batchIt.Next(),
-          enableRaytracer,enablePhotonMapper,pass,
-          &progress,totalPrimitivesCount,progressFactor));
+        csRef<Sector> sector = sectIt.Next();
+
+        ObjectHash::GlobalIterator objIt = sector->allObjects.GetIterator ();
+        while (objIt.HasNext ())
+        {
+          csRef<Object> obj = objIt.Next ();
+          if (obj->GetFlags ().Check (OBJECT_FLAG_NOLIGHT))
+            continue;
+
+          if (obj->lightPerVertex)
+          {
+            // Tiles write disjoint vertices, but can't create the colors
+            // of pseudo-dynamic lights concurrently
+            const LightRefArray& allPDLights = sector->allPDLights;
+            for (size_t pdli = 0; pdli < allPDLights.GetSize (); ++pdli)
+            {
+              Light* pdl = allPDLights[pdli];
+              if (pdl->GetBoundingSphere().TestIntersect (
+                  obj->GetBoundingSphere()))
+                obj->GetLitColorsPD (pdl, pass);
+            }
+
+            size_t numVertices = obj->GetVertexData().positions.GetSize();
+            for (size_t first = 0; first < numVertices; first += TILE_ELEMENTS)
+            {
+              QueueTile (new LightingTile (obj, pass, first,
+                csMin (first + TILE_ELEMENTS, numVertices), 0, 0,
+                uint (1 + first * SAMPLES_PER_ELEMENT),
+                enableRaytracer, enablePhotonMapper,
+                &progress, totalElements, progressFactor));
+            }
+            continue;
+          }
+
+          // Tiles of whole primitives with about TILE_ELEMENTS elements
+          csArray<size_t> tileStart, tileFirstElement;
+          size_t numPrimitives = 0, numElements = 0, tileElements = 0;
+          bool singleTile = recordInfluence && (pass == 0);
+          csArray<PrimitiveArray>& submeshArray = obj->GetPrimitives ();
+          for (size_t submesh = 0; submesh < submeshArray.GetSize (); ++submesh)
+          {
+            PrimitiveArray& primArray = submeshArray[submesh];
+            for (size_t pidx = 0; pidx < primArray.GetSize (); ++pidx)
+            {
+              if (tileStart.IsEmpty ()
+                || (!singleTile && (tileElements >= TILE_ELEMENTS)))
+              {
+                tileStart.Push (numPrimitives);
+                tileFirstElement.Push (numElements);
+                tileElements = 0;
+              }
+              size_t elements = primArray[pidx].GetElementCount();
+              tileElements += elements;
+              numElements += elements;
+              numPrimitives++;
+            }
+          }
+          if (numPrimitives == 0)
+            continue;
+          tileStart.Push (numPrimitives);
+
+          // Border pixels get light from several tiles, add it in tile order
+          size_t numTiles = tileFirstElement.GetSize ();
+          csRef<LightmapCommitQueue> commitQueue;
+          commitQueue.AttachNew (new LightmapCommitQueue (numTiles));
+          for (size_t t = 0; t < numTiles; t++)
+          {
+            QueueTile (new LightingTile (obj, pass, tileStart[t],
+              tileStart[t+1], t, commitQueue,
+              uint (1 + tileFirstElement[t] * SAMPLES_PER_ELEMENT),
+              enableRaytracer, enablePhotonMapper,
+              &progress, totalElements, progressFactor));
+          }
+        }
       }
-   
-      batchIt.Reset();
     }
-
   }
 
   int SectorGroup::computeNeededPhotonNumber()
@@ -706,57 +803,12 @@ namespace lighter
     return true;
   }
 
-  THREADED_CALLABLE_IMPL7(SectorProcessor,ComputeObjectGroupLighting, csArray<csRef<Object> >* objectsBatches,
-    bool enableRaytracer, bool enablePhotonMapper, int pass,
-    Statistics::Progress* progress, size_t totalPrimitives, float progressFactor)
-  {
-    const csVector3 bases[4] =
-    {
-      csVector3 (0, 0, 1),
-      csVector3 (/* -1/sqrt(6) */ -0.408248f, /* 1/sqrt(2) */ 0.707107f, /* 1/sqrt(3) */ 0.577350f),
-      csVector3 (/* sqrt(2/3) */ 0.816497f, 0, /* 1/sqrt(3) */ 0.577350f),
-      csVector3 (/* -1/sqrt(6) */ -0.408248f, /* -1/sqrt(2) */ -0.707107f, /* 1/sqrt(3) */ 0.577350f)
-    };
-
-    LightCalculator lighting (bases[pass],pass);
-
-    // Add components to the light calculator
-    RaytracerLighting *raytracerComponent = NULL;
-    PhotonmapperLighting *photonmapperComponent = NULL;
-
-    if(enableRaytracer)
-    {
-      raytracerComponent = new RaytracerLighting (bases[pass],pass);
-      lighting.addComponent(raytracerComponent, 1.0f, 0.0f);
-    }
-
-    if(enablePhotonMapper)
-    {
-      photonmapperComponent = new PhotonmapperLighting();
-      lighting.addComponent(photonmapperComponent, 1.0f, 0.0f);
-    }
-    
-    Statistics::ProgressState progressState(*progress,totalPrimitives,progressFactor*0.90f);
-    objectsBatches->Get(0)->GetSector();
-    lighting.ComputeObjectGroupLighting(objectsBatches,progressState);
-    progressState.Finish();
-
-    if(raytracerComponent != NULL) delete raytracerComponent;
-    if(photonmapperComponent != NULL) delete photonmapperComponent;
-
-    int numPasses = globalConfig.GetLighterProperties().directionalLMs ? 4 : 1;
-    if ( pass == numPasses)
-    {
-      objectsBatches->DeleteAll();
-      delete objectsBatches;
-    }
-
-    return true;
-  }
-
   THREADED_CALLABLE_IMPL1(SectorProcessor,SaveLightmaps,csRef<SectorGroup> sectorGroup)
   {
-    globalLighter->threadManager->Wait(sectorGroup->lightComputations,false);
+    // Help with the tiles still queued, wait for the others
+    for (size_t i = 0; i < sectorGroup->lightingTiles.GetSize (); i++)
+      globalLighter->jobManager->PullAndRun (sectorGroup->lightingTiles[i]);
+    sectorGroup->lightingTiles.DeleteAll ();
 
     sectorGroup->SaveLightmaps();
 
@@ -32,6 +32,7 @@ namespace lighter
   class Scene;
   class Sector;
   class PhotonMap;
+  class PhotonBuffer;
   class IrradianceCache;
   class SectorGroup;
 
@@ -103,10 +104,6 @@ namespace lighter
     THREADED_CALLABLE_DECL2(SectorProcessor,BalancePhotonMaps,csThreadReturn,
       csRef<Sector>,sector,Statistics::Progress*, progress,THREADED,false,true)
 
-    THREADED_CALLABLE_DECL7(SectorProcessor,ComputeObjectGroupLighting,csThreadReturn,
-      csArray<csRef<Object> >*,objectsBatch, bool, enableRaytracer, bool, enablePhotonMapper,int,pass,
-      Statistics::Progress*, progress,size_t, totalPrimitives, float, progressFactor,THREADED,false,true);
-
     THREADED_CALLABLE_DECL1(SectorProcessor,SaveLightmaps,csThreadReturn,
       csRef<SectorGroup>,sectorGroup,THREADED,false,true);
 
@@ -149,11 +146,13 @@ namespace lighter
     // caustic map and irradiance cache
     void FreePhotonMappingData();
 
-    void AddPhoton(const csColor power, const csVector3 pos,
-      const csVector3 dir );
+    // Add photons to the buffer of an emission job, they reach the photon
+    // maps when the buffer is flushed
+    void AddPhoton(PhotonBuffer& buffer, const csColor power,
+      const csVector3 pos, const csVector3 dir );
 
-    void AddCausticPhoton(const csColor power, const csVector3 pos,
-      const csVector3 dir );
+    void AddCausticPhoton(PhotonBuffer& buffer, const csColor power,
+      const csVector3 pos, const csVector3 dir );
 
     void ScalePhotons(const float scale);
 
@@ -169,12 +168,14 @@ namespace lighter
     csColor SamplePhoton(const csVector3 point, const csVector3 normal,
                          const float searchRad);
 
+    // Sample the photon maps at several points
+    void SamplePhotons(size_t num, const csVector3* points,
+                       const csVector3* normals, const float searchRad,
+                       csColor* irrad);
+
     void AddToIRCache(const csVector3 point, const csVector3 normal,
                       const csColor irrad, const float mean);
 
-    // Return 2.0 * numThread group of object to be lighted
-    csArray<csArray<csRef<Object> > *> getObjectBatches(size_t& primitivesCount);
-
     // Hash of all mesh names and materials
 
     //csHash <csString,csRef<RadMaterial>> materialHash;
@@ -219,6 +220,40 @@ namespace lighter
   };
   typedef csHash<csRef<Sector>, csString> SectorHash;
 
+  /**
+   * Job computing the static lighting of one tile of an object for one
+   * lightmap pass: a range of its primitives or, for per-vertex lit
+   * objects, of its vertices.
+   */
+  class LightingTile : public scfImplementation1<LightingTile, iJob>
+  {
+  public:
+    /**
+     * \a tile is the index of the tile among those of the object sharing
+     * \a commitQueue (0 for per-vertex lit objects). The tile samples
+     * lights starting at \a sampleIndex of the low discrepancy sequence.
+     */
+    LightingTile (Object* obj, int pass, size_t first, size_t last,
+      size_t tile, LightmapCommitQueue* commitQueue, uint sampleIndex,
+      bool enableRaytracer, bool enablePhotonMapper,
+      Statistics::Progress* progress, size_t totalElements,
+      float progressFactor);
+
+    void Run ();
+
+  private:
+    csRef<Object> obj;
+    int pass;
+    size_t first, last;
+    size_t tile;
+    csRef<LightmapCommitQueue> commitQueue;
+    uint sampleIndex;
+    bool enableRaytracer, enablePhotonMapper;
+    Statistics::Progress* progress;
+    size_t totalElements;
+    float progressFactor;
+  };
+
   class SectorGroup : public csRefCount
   {
     public :
@@ -233,9 +268,19 @@ namespace lighter
 
       int computeNeededPhotonNumber();
 
-      csRefArray<iThreadReturn> lightComputations;
+      // Lighting tiles queued on the lighter's job queue
+      csRefArray<iJob> lightingTiles;
 
     private :
+      enum
+      {
+        /// Number of lightmap elements (or vertices) lit by a tile
+        TILE_ELEMENTS = 256,
+        /// Stretch of the sample sequence reserved per element of a tile
+        SAMPLES_PER_ELEMENT = 8
+      };
+
+      inline void QueueTile (LightingTile* tile);
 
       inline void BuildKDTreeAndPhotonMaps(bool buildPhotonMaps,Statistics::Progress& progress);
 
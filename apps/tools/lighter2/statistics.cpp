@@ -24,6 +24,8 @@ namespace lighter
 {
   Statistics globalStats;
 
+  CS::Threading::Mutex Statistics::ProgressState::updateMutex;
+
   Statistics::Progress::Progress (const char* name, float amount, 
     Progress* parent) : parent (parent ? parent : &globalStats.progress),
     taskName (name), totalAmount (0),
@@ -114,6 +114,10 @@ namespace lighter
     };
     GlobalProgress progress;
 
+    /**
+     * Helper to advance a progress in steps. Several states may advance the
+     * same progress from different threads.
+     */
     class ProgressState
     {
       Statistics::Progress& progress;
@@ -121,6 +125,17 @@ namespace lighter
       size_t u;
       float progressStep;
 
+      // Serializes updates of the shared progress objects
+      static CS::Threading::Mutex updateMutex;
+
+      void IncProgress (float inc)
+      {
+        {
+          CS::Threading::MutexScopedLock lock (updateMutex);
+          progress.IncProgress (inc);
+        }
+        globalTUI.Redraw (TUI::TUI_DRAW_RAYCORE | TUI::TUI_DRAW_PMCORE);
+      }
     public:
       // Factor is percent of filling
       ProgressState (Statistics::Progress& progress, size_t total, float factor = 1.0f) : 
@@ -132,20 +147,19 @@ namespace lighter
       {
         if (--u == 0)
         {
-          progress.IncProgress (progressStep);
+          IncProgress (progressStep);
           u = updateFreq;
-          globalTUI.Redraw (TUI::TUI_DRAW_RAYCORE | TUI::TUI_DRAW_PMCORE);
         }
       }
 
       CS_FORCEINLINE void Finish()
       {
-        if (u != 0)
+        if (u != updateFreq)
         {
-          u=0;
+          // Account for the items advanced since the last update
           float ratio = float(updateFreq-u) / float(updateFreq);
-          progress.IncProgress(progressStep*ratio);
-          globalTUI.Redraw (TUI::TUI_DRAW_RAYCORE | TUI::TUI_DRAW_PMCORE);
+          IncProgress (progressStep*ratio);
+          u = updateFreq;
         }
       }
     };
@@ -155,7 +169,7 @@ namespace lighter
       Raytracer ()
         : numRays (0), numEyeRays (0), numLightRays (0),
           numReflectionRays (0), numRefractionRays (0),
-          numShadowRays (0)
+          numShadowRays (0), numFinalGatherRays (0), startTime (0)
       {}
 
       /// Total number of rays traced
@@ -178,6 +192,17 @@ namespace lighter
 
       /// Number of rays generated to gather photons for indirect lighting
       uint64 numFinalGatherRays;
+
+      /// Time the first ray was traced
+      csTicks startTime;
+
+      /// Average number of rays traced per second since the first one
+      double GetRaysPerSecond () const
+      {
+        const csTicks elapsed = csGetTicks () - startTime;
+        if (numRays == 0 || elapsed == 0) return 0;
+        return double (numRays) * 1000.0 / elapsed;
+      }
     } raytracer;
 
     struct Photonmapping
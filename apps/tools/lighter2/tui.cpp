@@ -172,7 +172,7 @@ namespace lighter
     csPrintf ("|   FinalG:          | Irradiance Cache   | KD-Tree Stats                     |\n");
     csPrintf ("|                    |                    |   Nodes:                          |\n");
     csPrintf ("| Total:             |   Prime:           |   Depth:                          |\n");
-    csPrintf ("|                    |   Secnd:           |   Prims:                          |\n");
+    csPrintf ("| Rays/s:            |   Secnd:           |   Prims:                          |\n");
     csPrintf ("|                    |   Lookps:          |-----------------------------------|\n");
     csPrintf ("|                    |   Splits:          | SwapCache                         |\n");
     csPrintf ("|                    |                    |                                   |\n");
@@ -285,6 +285,7 @@ namespace lighter
     uint64 refractRays = globalStats.raytracer.numRefractionRays;
     uint64 finalGatherRays = globalStats.raytracer.numFinalGatherRays;
     uint64 totalRays = globalStats.raytracer.numRays;
+    uint64 raysPerSecond = uint64 (globalStats.raytracer.GetRaysPerSecond ());
 
     // Output ray counters with suffix
     csPrintf (CS_ANSI_CURSOR(12,9) "%s", FormatAmount (directRays).GetData());
@@ -293,6 +294,7 @@ namespace lighter
     csPrintf (CS_ANSI_CURSOR(12,12) "%s", FormatAmount (refractRays).GetData());
     csPrintf (CS_ANSI_CURSOR(12,13) "%s", FormatAmount (finalGatherRays).GetData());
     csPrintf (CS_ANSI_CURSOR(10,15) "%s", FormatAmount (totalRays).GetData());
+    csPrintf (CS_ANSI_CURSOR(10,16) "%s", FormatAmount (raysPerSecond).GetData());
 
     csPrintf (CS_ANSI_CURSOR(1,1));
   }
@@ -442,6 +444,13 @@ namespace lighter
     csPrintf ("P: %8zu / %8.03f\n", globalStats.kdtree.numPrimitives, 
       (float)globalStats.kdtree.numPrimitives / (float)globalStats.kdtree.leafNodes);
 
+    // Print raytracer stats
+    csPrintf ("Raytracer: \n");
+    csPrintf ("R: %s\n", 
+      FormatAmount (globalStats.raytracer.numRays, 8).GetData());
+    csPrintf ("R/s: %s\n", FormatAmount (
+      uint64 (globalStats.raytracer.GetRaysPerSecond ()), 6).GetData());
+
     kdLastNumNodes = globalStats.kdtree.numNodes;
   }
 
@@ -22,6 +22,7 @@
 
 #include "csextern.h"
 
+#include "csutil/dirtyaccessarray.h"
 #include "csutil/scf_implementation.h"
 
 #include "ivideo/shader/shader.h"
@@ -39,12 +40,31 @@ namespace CS
      * Simple implementation for iShaderVariableContext.
      * Can be inherited from for use in SCF classes. For an example,
      * see csShaderVariableContext.
+     *
+     * The variables are kept sorted by name. The names are also stored in a
+     * separate flat array, so lookups only touch that array instead of
+     * dereferencing each variable.
      */
     class CS_CRYSTALSPACE_EXPORT ShaderVariableContextImpl :
       public virtual iShaderVariableContext
     {
     protected:
+      /**
+       * The variables, sorted by name. If modified directly, \c names must
+       * be updated accordingly.
+       */
       csRefArray<csShaderVariable> variables;
+      /// Names of the variables, in the same order as \c variables.
+      csDirtyAccessArray<StringIDValue> names;
+
+      /// Index of the variable \a name or csArrayItemNotFound.
+      size_t FindVariable (ShaderVarStringID name) const;
+      /// Index of the first variable with a name not less than \a name.
+      size_t FindInsertPosition (ShaderVarStringID name) const;
+      /// Insert \a variable at \a index, keeping \c names in sync.
+      void InsertVariable (size_t index, csShaderVariable* variable);
+      /// Delete the variable at \a index, keeping \c names in sync.
+      void DeleteVariable (size_t index);
   
     public:
       virtual ~ShaderVariableContextImpl();
@@ -56,7 +76,7 @@ namespace CS
       virtual void PushVariables (csShaderVariableStack& stacks) const;
       virtual bool IsEmpty() const { return variables.GetSize () == 0; }  
       virtual void ReplaceVariable (csShaderVariable *variable);
-      virtual void Clear () { variables.Empty(); }
+      virtual void Clear () { variables.Empty(); names.Empty(); }
       virtual bool RemoveVariable (csShaderVariable* variable);
       virtual bool RemoveVariable (ShaderVarStringID name);
     };
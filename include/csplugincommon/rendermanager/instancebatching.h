@@ -0,0 +1,181 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSPLUGINCOMMON_RENDERMANAGER_INSTANCEBATCHING_H__
+#define __CS_CSPLUGINCOMMON_RENDERMANAGER_INSTANCEBATCHING_H__
+
+/**\file
+ * Automatic merging of render meshes into instanced draws
+ */
+
+#include "csgfx/shadervar.h"
+#include "csutil/bitarray.h"
+#include "csutil/hash.h"
+#include "csutil/refarr.h"
+#include "ivideo/rendermesh.h"
+#include "ivideo/shader/shader.h"
+
+struct iObjectRegistry;
+struct iShaderManager;
+
+namespace CS
+{
+  namespace RenderManager
+  {
+    /**
+     * Merging of render meshes into instanced draws.
+     *
+     * Consecutive meshes of a mesh node which stem from the same factory,
+     * use the same render buffers, material and shader and for which the
+     * shader variables used by the shader have the same values, apart from
+     * the object to world transforms, are collected into a batch when the
+     * shader tickets are set up (see TicketSetup). Meshes with buffers of
+     * their own, like genmeshes with lit vertex colors (not using manual
+     * colors), aren't merged. The first mesh of a batch is drawn with the
+     * instancing variant of its shader, with the transforms of all meshes,
+     * relative to the first one, in the "instancing transforms" shader
+     * variable. The other meshes of the batch get no shader, so they aren't
+     * drawn on their own.
+     *
+     * The instancing variant of a shader is found by its name, following the
+     * naming of the stock shaders: "_instance" is inserted before one of the
+     * parts of the name separated by underscores or appended to the name,
+     * or "_instanced" is appended (so "lighting_default_binalpha" becomes
+     * "lighting_default_instance_binalpha" and "z_only" becomes
+     * "z_only_instanced"). If no such shader is registered but the original
+     * shader was loaded from a file, a file named the same way in the same
+     * directory is loaded. Meshes whose shader has no instancing variant are
+     * drawn one by one.
+     *
+     * An instance of this class is part of the render tree persistent data.
+     */
+    class CS_CRYSTALSPACE_EXPORT InstanceBatching
+    {
+    public:
+      InstanceBatching ();
+
+      /**
+       * Initialize data. Must be called when the render manager plugin is
+       * initialized.
+       */
+      void Initialize (iShaderManager* shmgr);
+
+      /**
+       * Allow instancing variants of shaders that are not registered yet to
+       * be loaded from files.
+       */
+      void EnableShaderLoading (iObjectRegistry* objectReg);
+
+      /// Enable or disable the merging of meshes. Enabled by default.
+      void SetEnabled (bool enable) { enabled = enable; }
+      /// Whether meshes are merged.
+      bool IsEnabled () const { return enabled; }
+
+      /**
+       * Forget all batches. Must only be called once the batches have been
+       * drawn, as their shader variables are reused.
+       */
+      void ClearBatches ();
+
+      /**
+       * Whether the mesh properties relevant to drawing allow to draw
+       * \a mesh as an instance of \a leader.
+       */
+      static bool IsInstanceable (const csRenderMesh* leader,
+        const csRenderMesh* mesh);
+
+      /**
+       * Whether the shader variables in \a usedSVs (usually the ones used by
+       * the shader, see iShader::GetUsedShaderVars()) have the same values
+       * for two meshes, apart from the ones that differ between instances.
+       */
+      bool HasSameShaderVars (const csShaderVariableStack& leaderStack,
+        const csShaderVariableStack& stack, const csBitArray& usedSVs) const;
+
+      /**
+       * Whether a mesh with the given shader variable stack can be the first
+       * mesh of a batch, ie it doesn't use instancing already.
+       */
+      bool CanLeadBatch (const csShaderVariableStack& stack) const;
+
+      /**
+       * Get the instancing variant of \a shader. Returns 0 if there is
+       * none. The result is cached.
+       */
+      iShader* GetInstancingShader (iShader* shader);
+
+      /**
+       * Start a batch of meshes. Call AddInstance() for every mesh of the
+       * batch, starting with the first one, then EndBatch().
+       */
+      void BeginBatch ();
+      /// Add the mesh with the given object to world transform to the batch.
+      void AddInstance (const csReversibleTransform& object2world);
+      /**
+       * Finish the current batch and put its instancing shader variables on
+       * \a stack, the shader variable stack of the first mesh.
+       */
+      void EndBatch (csShaderVariableStack& stack);
+      /**
+       * Remove the instancing shader variables from the stack of the first
+       * mesh of a batch again, if it can't be drawn instanced after all.
+       */
+      void RemoveBatchShaderVars (csShaderVariableStack& stack) const;
+
+      /// Get number of batches collected since the last ClearBatches()
+      size_t GetBatchNum () const { return usedBatches; }
+    private:
+      bool enabled;
+      iShaderManager* shaderManager;
+      iObjectRegistry* objectReg;
+
+      CS::ShaderVarStringID svObjectToWorldName;
+      CS::ShaderVarStringID svObjectToWorldInvName;
+      CS::ShaderVarStringID svTransformsName;
+      CS::ShaderVarStringID svInstancesNumName;
+
+      /// Inverse transform of the first mesh of the current batch
+      csReversibleTransform leaderInverse;
+
+      /**\name Shader variables reused from frame to frame
+       * @{ */
+      csRefArray<csShaderVariable> transformArrays;
+      csRefArray<csShaderVariable> instancesNums;
+      /// Number of used elements of \c transformArrays and \c instancesNums
+      size_t usedBatches;
+      csRefArray<csShaderVariable> transforms;
+      /// Number of used elements of \c transforms
+      size_t usedTransforms;
+      /** @} */
+
+      /// A shader and its instancing variant
+      struct InstancingShader
+      {
+        csRef<iShader> shader;
+        csRef<iShader> instancing;
+      };
+      /// Instancing variants of shaders, keyed by the original shader
+      csHash<InstancingShader, csPtrKey<iShader> > instancingShaders;
+
+      /// Look up or load the instancing variant of \a shader
+      csPtr<iShader> FindInstancingShader (iShader* shader);
+    };
+  } // namespace RenderManager
+} // namespace CS
+
+#endif // __CS_CSPLUGINCOMMON_RENDERMANAGER_INSTANCEBATCHING_H__
@@ -738,7 +738,7 @@ namespace RenderManager
     }
   public:
     struct PersistentData;
-    typedef csArray<iShader*> ShaderArrayType;
+    typedef CS::RenderManager::ShaderArrayType ShaderArrayType;
     typedef ShadowHandler ShadowHandlerType;
     typedef typename ShadowHandler::ShadowParameters ShadowParamType;
 
@@ -784,29 +784,57 @@ namespace RenderManager
         node, shadowParam);
       ShadowNone<RenderTree, LayerConfigType> noShadows;
 
+      // Query the lights for all meshes of the node in one go
+      persist.lightQueries.SetSize (node->meshes.GetSize ());
       for (size_t i = 0; i < node->meshes.GetSize (); ++i)
       {
         typename RenderTree::MeshNode::SingleMesh& mesh = node->meshes[i];
+        csLightBatchQuery& query = persist.lightQueries[i];
 
-        size_t numLights = 0;
-        csLightInfluence* influences = 0;
-        LightingSorter sortedLights (persist.lightSorterPersist, 0);
-
-        if (!mesh.meshFlags.Check(CS_ENTITY_NOLIGHTING))
+        query.boundingBox = &mesh.renderMesh->bbox;
+        query.bboxToWorld = &mesh.renderMesh->object2world;
+        if (mesh.meshFlags.Check(CS_ENTITY_NOLIGHTING))
+          query.flags = CS_LIGHTQUERY_GET_ALL & ~CS_LIGHTQUERY_GET_TYPE_ALL;
+        else
         {
 	  bool meshIsStaticLit = mesh.meshFlags.Check (CS_ENTITY_STATICLIT);
 	  bool skipStatic = meshIsStaticLit
 	    && layerConfig.GetStaticLightsSettings ().nodraw;
 	    
-          uint relevantLightsFlags =
+          query.flags =
             skipStatic ? ((CS_LIGHTQUERY_GET_ALL & ~CS_LIGHTQUERY_GET_TYPE_ALL)
                             | CS_LIGHTQUERY_GET_TYPE_DYNAMIC)
                        : CS_LIGHTQUERY_GET_ALL;
-          
-          lightmgr->GetRelevantLightsSorted (node->GetOwner().sector,
-            mesh.renderMesh->bbox, influences, numLights, allMaxLights,
-            &mesh.renderMesh->object2world,
-            relevantLightsFlags);
+        }
+      }
+      if (node->meshes.GetSize () > 0)
+      {
+        size_t neededInfluences;
+        while ((neededInfluences = lightmgr->GetRelevantLightsBatch (
+            node->GetOwner().sector, persist.lightQueries.GetArray (),
+            persist.lightQueries.GetSize (),
+            persist.lightInfluences.GetArray (),
+            persist.lightInfluences.GetSize (), allMaxLights, true))
+          > persist.lightInfluences.GetSize ())
+        {
+          persist.lightInfluences.SetSize (neededInfluences);
+        }
+      }
+
+      for (size_t i = 0; i < node->meshes.GetSize (); ++i)
+      {
+        typename RenderTree::MeshNode::SingleMesh& mesh = node->meshes[i];
+
+        size_t numLights = 0;
+        csLightInfluence* influences = 0;
+        LightingSorter sortedLights (persist.lightSorterPersist, 0);
+
+        if (!mesh.meshFlags.Check(CS_ENTITY_NOLIGHTING))
+        {
+          const csLightBatchQuery& query = persist.lightQueries[i];
+          numLights = query.numInfluences;
+          influences = persist.lightInfluences.GetArray ()
+            + query.firstInfluence;
 
           sortedLights.SetNumLights (numLights);
           for (size_t l = 0; l < numLights; ++l)
@@ -870,8 +898,6 @@ namespace RenderManager
           }
           lightOffset += handledLights;
         }
-
-        lightmgr->FreeInfluenceArray (influences);
       }
 
       if (shadows.NeedFinalHandleLight())
@@ -966,6 +992,10 @@ namespace RenderManager
       LightingVariablesHelper::PersistentData varsHelperPersist;
       typedef csHash<CachedLightData, csPtrKey<iLight> > LightDataCache;
       LightDataCache lightDataCache;
+      /// Per-mesh light queries of the node currently set up
+      csDirtyAccessArray<csLightBatchQuery> lightQueries;
+      /// Influences returned for lightQueries
+      csDirtyAccessArray<csLightInfluence> lightInfluences;
 
       ~PersistentData()
       {
@@ -434,6 +434,16 @@ namespace CS
       void TraverseTreePlanes(VisTree* node, iVisibilityCullerListener* viscallback,
         csPlane3* planes, uint32 frustum_mask);
 
+      // Objects found by a visibility test of several views.
+      struct ViewsData;
+
+      /**
+       * Traverses the tree checking for objects that are in any of the
+       * volumes formed by the planes of the views.
+       */
+      void TraverseTreeViews(VisTree* node, ViewsData& data, uint32 viewMask,
+        uint32 const* frustumMasks);
+
     public:
       csOccluvis(iObjectRegistry* object_reg);
       virtual ~csOccluvis();
@@ -485,6 +495,12 @@ namespace CS
        */
       virtual void VisTest(csPlane3* planes, int num_planes, iVisibilityCullerListener* viscallback);
 
+      /**
+       * Notify the callback about all objects visible in any of the views.
+       */
+      virtual void VisTest(csVisibilityCullerView const* views, size_t numViews,
+        iVisibilityCullerMultiViewListener* viscallback);
+
       /**
        * Return all objects hit by the beam. May include objects that aren't hit, but are close to the beam.
        */
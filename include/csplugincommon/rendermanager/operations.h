@@ -27,6 +27,9 @@
 #include "csplugincommon/rendermanager/rendertree.h"
 #include "csutil/set.h"
 #include "csutil/compositefunctor.h"
+#include "csutil/parallelfor.h"
+#include "csutil/refcount.h"
+#include "iutil/job.h"
 
 namespace CS
 {
@@ -113,6 +116,83 @@ namespace RenderManager
       csSet<IterationObject>& objectSet;
     };
 
+    /// Calls a functor for an unordered resp. numbered operation.
+    template<bool Numbered>
+    struct ParallelOperationInvoke
+    {
+      template<typename Fn, typename ObjectType>
+      static void Call (Fn& fn, size_t, const ObjectType& obj)
+      {
+        fn (obj);
+      }
+    };
+
+    template<>
+    struct ParallelOperationInvoke<true>
+    {
+      template<typename Fn, typename ObjectType>
+      static void Call (Fn& fn, size_t index, const ObjectType& obj)
+      {
+        fn (index, obj);
+      }
+    };
+
+    /// Type independent interface to ParallelOperationBatch.
+    class ParallelOperationBatchBase : public CS::Utility::AtomicRefCount
+    {
+    public:
+      /**
+       * Run the functor for all collected objects, spread over \a jobQueue
+       * and the calling thread. Returns when all objects are processed.
+       */
+      virtual void Run (iJobQueue* jobQueue, size_t numWorkers) = 0;
+    };
+
+    /**
+     * Objects collected by a parallel operation, processed in chunks by
+     * jobs and the calling thread.
+     */
+    template<typename Fn, typename ObjectType, bool Numbered>
+    class ParallelOperationBatch : public ParallelOperationBatchBase
+    {
+      struct Item
+      {
+        size_t index;
+        ObjectType object;
+
+        Item (size_t index, const ObjectType& object)
+          : index (index), object (object) {}
+      };
+
+      Fn* function;
+      csArray<Item> items;
+    public:
+      ParallelOperationBatch (Fn& fn) : function (&fn) {}
+
+      void Add (size_t index, const ObjectType& object)
+      {
+        items.Push (Item (index, object));
+      }
+
+      void Run (iJobQueue* jobQueue, size_t numWorkers)
+      {
+        // A few chunks per thread so uneven work balances out
+        size_t chunkSize =
+          csMax (items.GetSize () / ((numWorkers + 1) * 4), size_t (1));
+        CS::Threading::ParallelFor (jobQueue, numWorkers, items.GetSize (),
+          chunkSize, *this);
+      }
+
+      void operator() (size_t first, size_t last)
+      {
+        for (size_t i = first; i < last; i++)
+        {
+          ParallelOperationInvoke<Numbered>::Call (*function,
+            items[i].index, items[i].object);
+        }
+      }
+    };
+
     /**
      * Helper for dispatching the actual function call in ForEach methods below.
      * Split into two-level hierarchy to avoid partial specialization when that is needed     
@@ -134,10 +214,13 @@ namespace RenderManager
       template<>
       struct OperationCaller<OperationUnordered>
       {
-        OperationCaller (Fn& fn, OperationBlock& block)
+        OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* = 0,
+          size_t = 0)
           : function (fn), block (block)
         {}
 
+        void Finish () {}
+
         template<typename ObjectType>
         void operator() (const ObjectType& context)
         {
@@ -155,10 +238,13 @@ namespace RenderManager
       template<>
       struct OperationCaller<OperationNumbered>
       {
-        OperationCaller (Fn& fn, OperationBlock& block)
+        OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* = 0,
+          size_t = 0)
           : function (fn), block (block), index (0)
         {}
 
+        void Finish () {}
+
         template<typename ObjectType>
         void operator() (const ObjectType& context)
         {          
@@ -176,14 +262,18 @@ namespace RenderManager
 
       /**
        * Executor for unordered calls
+       * (Parallel execution is not supported on this compiler)
        */
       template<>
       struct OperationCaller<OperationUnorderedParallel>
       {
-        OperationCaller (Fn& fn, OperationBlock& block)
+        OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* = 0,
+          size_t = 0)
           : function (fn), block (block)
         {}
 
+        void Finish () {}
+
         template<typename ObjectType>
         void operator() (const ObjectType& context)
         {
@@ -197,14 +287,18 @@ namespace RenderManager
 
       /**
        * Executor for numbered calls
+       * (Parallel execution is not supported on this compiler)
        */
       template<>
       struct OperationCaller<OperationNumberedParallel>
       {
-        OperationCaller (Fn& fn, OperationBlock& block)
+        OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* = 0,
+          size_t = 0)
           : function (fn), block (block), index (0)
         {}
 
+        void Finish () {}
+
         template<typename ObjectType>
         void operator() (const ObjectType& context)
         {          
@@ -225,7 +319,8 @@ namespace RenderManager
     struct OperationCaller : 
       public OperationCallerWorkAround<Fn, OperationBlock>::OperationCaller<Type>
     {
-      OperationCaller (Fn& fn, OperationBlock& block)
+      OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* = 0,
+        size_t = 0)
         : OperationCallerWorkAround<Fn, OperationBlock>::OperationCaller<Type> (fn, block)
       {}
     };
@@ -243,10 +338,13 @@ namespace RenderManager
     template<typename Fn, typename OperationBlock>
     struct OperationCaller<Fn, OperationBlock, OperationUnordered>
     {
-      OperationCaller (Fn& fn, OperationBlock& block)
+      OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* = 0,
+        size_t = 0)
         : function (fn), block (block)
       {}
 
+      void Finish () {}
+
       template<typename ObjectType>
       void operator() (const ObjectType& context)
       {
@@ -264,10 +362,13 @@ namespace RenderManager
     template<typename Fn, typename OperationBlock>
     struct OperationCaller<Fn, OperationBlock, OperationNumbered>
     {
-      OperationCaller (Fn& fn, OperationBlock& block)
+      OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* = 0,
+        size_t = 0)
         : function (fn), block (block), index (0)
       {}
 
+      void Finish () {}
+
       template<typename ObjectType>
       void operator() (const ObjectType& context)
       {          
@@ -282,47 +383,109 @@ namespace RenderManager
     };
 
     /**
-     * Executor for unordered calls
+     * Executor for unordered, possibly parallel calls.
+     * Objects not blocked are collected and the functor is run for them
+     * on the job queue and the calling thread in Finish(). The blocker is
+     * always called serially. Without a job queue the functor is called
+     * right away.
      */
     template<typename Fn, typename OperationBlock>
     struct OperationCaller<Fn, OperationBlock, OperationUnorderedParallel>
     {
-      OperationCaller (Fn& fn, OperationBlock& block)
-        : function (fn), block (block)
+      OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* jobQueue = 0,
+        size_t numWorkers = 0)
+        : function (fn), block (block), jobQueue (jobQueue),
+          numWorkers (numWorkers)
       {}
 
       template<typename ObjectType>
       void operator() (const ObjectType& context)
       {
-        if (!block (context))
+        if (block (context))
+          return;
+
+        if (!jobQueue || (numWorkers == 0))
           function (context);
+        else
+          GetBatch<ObjectType> ().Add (0, context);
+      }
+
+      void Finish ()
+      {
+        if (batch)
+        {
+          batch->Run (jobQueue, numWorkers);
+          batch.Invalidate ();
+        }
       }
 
       Fn& function;
       OperationBlock block;
+      iJobQueue* jobQueue;
+      size_t numWorkers;
+    private:
+      csRef<ParallelOperationBatchBase> batch;
+
+      template<typename ObjectType>
+      ParallelOperationBatch<Fn, ObjectType, false>& GetBatch ()
+      {
+        typedef ParallelOperationBatch<Fn, ObjectType, false> BatchType;
+        if (!batch) batch.AttachNew (new BatchType (function));
+        return *(static_cast<BatchType*> ((ParallelOperationBatchBase*)batch));
+      }
     };
 
     /**
-     * Executor for numbered calls
+     * Executor for numbered, possibly parallel calls.
+     * Numbers are assigned in iteration order, just as with serial execution.
+     * \sa OperationCaller<Fn, OperationBlock, OperationUnorderedParallel>
      */
     template<typename Fn, typename OperationBlock>
     struct OperationCaller<Fn, OperationBlock, OperationNumberedParallel>
     {
-      OperationCaller (Fn& fn, OperationBlock& block)
-        : function (fn), block (block), index (0)
+      OperationCaller (Fn& fn, OperationBlock& block, iJobQueue* jobQueue = 0,
+        size_t numWorkers = 0)
+        : function (fn), block (block), jobQueue (jobQueue),
+          numWorkers (numWorkers), index (0)
       {}
 
       template<typename ObjectType>
       void operator() (const ObjectType& context)
-      {          
+      {
         if (!block (context))
-          function (index, context);
+        {
+          if (!jobQueue || (numWorkers == 0))
+            function (index, context);
+          else
+            GetBatch<ObjectType> ().Add (index, context);
+        }
         index++;
       }
 
+      void Finish ()
+      {
+        if (batch)
+        {
+          batch->Run (jobQueue, numWorkers);
+          batch.Invalidate ();
+        }
+      }
+
       Fn& function;
       OperationBlock block;
+      iJobQueue* jobQueue;
+      size_t numWorkers;
       size_t index;
+    private:
+      csRef<ParallelOperationBatchBase> batch;
+
+      template<typename ObjectType>
+      ParallelOperationBatch<Fn, ObjectType, true>& GetBatch ()
+      {
+        typedef ParallelOperationBatch<Fn, ObjectType, true> BatchType;
+        if (!batch) batch.AttachNew (new BatchType (function));
+        return *(static_cast<BatchType*> ((ParallelOperationBatchBase*)batch));
+      }
     };
 
 #endif
@@ -438,7 +601,8 @@ namespace RenderManager
       Fn, 
       Implementation::NoOperationBlock<typename RenderTree::ContextNode*>,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, noBlock);
+    > caller (fn, noBlock, tree.GetPersistentData ().operationJobQueue,
+      tree.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -447,6 +611,7 @@ namespace RenderManager
 
       caller (context);
     }
+    caller.Finish ();
   }
 
   /**
@@ -464,7 +629,8 @@ namespace RenderManager
       Fn, 
       Blocker,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, block);
+    > caller (fn, block, tree.GetPersistentData ().operationJobQueue,
+      tree.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -473,6 +639,7 @@ namespace RenderManager
 
       caller (context);
     }
+    caller.Finish ();
   }
 
   /**
@@ -491,7 +658,8 @@ namespace RenderManager
       Fn, 
       Implementation::NoOperationBlock<typename RenderTree::ContextNode*>,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, noBlock);
+    > caller (fn, noBlock, tree.GetPersistentData ().operationJobQueue,
+      tree.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -500,6 +668,7 @@ namespace RenderManager
 
       caller (context);
     }
+    caller.Finish ();
   }
 
   /**
@@ -517,7 +686,8 @@ namespace RenderManager
       Fn, 
       Blocker,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, block);
+    > caller (fn, block, tree.GetPersistentData ().operationJobQueue,
+      tree.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -526,6 +696,7 @@ namespace RenderManager
 
       caller (context);
     }
+    caller.Finish ();
   }
 
   //@}
@@ -546,7 +717,9 @@ namespace RenderManager
       Fn, 
       Implementation::NoOperationBlock<typename ContextType::TreeType::MeshNode*>,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, noBlock);
+    > caller (fn, noBlock,
+      context.owner.GetPersistentData ().operationJobQueue,
+      context.owner.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -555,6 +728,7 @@ namespace RenderManager
 
       caller (node);
     }
+    caller.Finish ();
   }
 
   /**
@@ -571,7 +745,9 @@ namespace RenderManager
       Fn, 
       Blocker,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, blocker);
+    > caller (fn, blocker,
+      context.owner.GetPersistentData ().operationJobQueue,
+      context.owner.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -580,6 +756,7 @@ namespace RenderManager
 
       caller (node);
     }
+    caller.Finish ();
   }
 
   /**
@@ -597,7 +774,9 @@ namespace RenderManager
       Fn, 
       Implementation::NoOperationBlock<typename ContextType::TreeType::MeshNode*>,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, noBlock);
+    > caller (fn, noBlock,
+      context.owner.GetPersistentData ().operationJobQueue,
+      context.owner.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -606,6 +785,7 @@ namespace RenderManager
 
       caller (node);
     }
+    caller.Finish ();
   }
 
   /**
@@ -622,7 +802,9 @@ namespace RenderManager
       Fn, 
       Blocker,
       typename OperationTraits<Fn>::Ordering
-    > caller (fn, blocker);
+    > caller (fn, blocker,
+      context.owner.GetPersistentData ().operationJobQueue,
+      context.owner.GetPersistentData ().operationJobWorkers);
 
     while (it.HasNext ())
     {
@@ -631,6 +813,7 @@ namespace RenderManager
 
       caller (node);
     }
+    caller.Finish ();
   }
 
   namespace Implementation
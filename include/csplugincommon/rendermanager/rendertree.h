@@ -24,9 +24,15 @@
  */
 
 #include "iengine/camera.h"
+#include "iutil/objreg.h"
+#include "iutil/verbositymanager.h"
+#include "ivaria/reporter.h"
 #include "csplugincommon/rendermanager/standardtreetraits.h"
+#include "csplugincommon/rendermanager/instancebatching.h"
 #include "csutil/dirtyaccessarray.h"
+#include "csutil/lineararena.h"
 #include "csutil/metautils.h"
+#include "csutil/parallelfor.h"
 #include "csutil/redblacktree.h"
 #include "cstool/rendermeshholder.h"
 
@@ -204,6 +210,13 @@ namespace RenderManager
     csArray<DebugLineScreen> debugLinesScreen;
   };
 
+  /// Array of per-mesh shaders of a context, allocated from the frame arena
+  typedef csDirtyAccessArray<iShader*, csArrayElementHandler<iShader*>,
+    CS::Memory::AllocatorLinearArena> ShaderArrayType;
+  /// Array of per-mesh tickets of a context, allocated from the frame arena
+  typedef csArray<size_t, csArrayElementHandler<size_t>,
+    CS::Memory::AllocatorLinearArena> TicketArrayType;
+
   /**
    * RenderTree is the main data-structure for the rendermanagers.
    * It contains the entire setup of meshes and where to render those meshes,
@@ -252,6 +265,8 @@ namespace RenderManager
     struct PersistentData : 
       public CS::Meta::EBOptHelper<typename TreeTraitsType::PersistentDataExtraDataType>
     {
+      PersistentData () : operationJobWorkers (0), arenaReportReg (0) {}
+
       /**
        * Initialize data. Fetches various required values from objects in
        * the object registry. Must be called when the render manager plugin is 
@@ -265,15 +280,64 @@ namespace RenderManager
           shmgr->GetSVNameStringset()->Request ("object2world transform inverse");
         svFogplaneName = 
           shmgr->GetSVNameStringset()->Request ("fogplane");
+        instanceBatching.Initialize (shmgr);
           
         dbgDebugClearScreen = debugPersist.RegisterDebugFlag ("debugclear");
       }
 
+      /**
+       * Set up parallel execution of operations tagged
+       * OperationUnorderedParallel or OperationNumberedParallel on the
+       * shared parallel loop job queue (see
+       * CS::Threading::GetParallelForJobQueue()).
+       * \param objectReg Object registry.
+       * \param numThreads Total number of threads to use, including the
+       *   thread calling the ForEach*() helpers. 0 picks the number of
+       *   processors; 1 executes all operations serially.
+       */
+      void SetupParallelOperations (iObjectRegistry* objectReg,
+        uint numThreads = 0)
+      {
+        operationJobQueue.Invalidate ();
+        operationJobWorkers = 0;
+        if (numThreads == 1) return;
+
+        size_t queueWorkers;
+        operationJobQueue = CS::Threading::GetParallelForJobQueue (objectReg,
+          queueWorkers);
+        operationJobWorkers = (numThreads == 0) ? queueWorkers
+          : csMin (size_t (numThreads - 1), queueWorkers);
+      }
+
+      /**
+       * Report the memory used from the frame arena each time a render tree
+       * is destroyed. Reports are only made if the verbosity flag
+       * "rendermanager.framearena" is given explicitly, a plain
+       * <tt>--verbose</tt> does not enable them.
+       */
+      void SetupFrameArenaReport (iObjectRegistry* objectReg)
+      {
+        csRef<iVerbosityManager> verbosity =
+          csQueryRegistry<iVerbosityManager> (objectReg);
+        arenaReportReg = verbosity
+          && verbosity->Enabled ("rendermanager.framearena", false)
+          ? objectReg : 0;
+      }
+
       void Clear ()
       {
         // Clean up the persistent data
         contextNodeAllocator.Empty ();
         meshNodeAllocator.Empty ();
+        // All nodes are gone, so their arrays can be released at once
+        frameArena.Reset ();
+        // The batches have been drawn
+        instanceBatching.ClearBatches ();
+        if (arenaReportReg)
+          csReport (arenaReportReg, CS_REPORTER_SEVERITY_NOTIFY,
+            "crystalspace.rendermanager.framearena",
+            "Render tree used %zu bytes of arena memory (peak %zu)",
+            frameArena.GetLastUsedBytes (), frameArena.GetPeakUsedBytes ());
       }
 
       csBlockAllocator<MeshNode> meshNodeAllocator;
@@ -289,6 +353,24 @@ namespace RenderManager
       
       DebugPersistent debugPersist;
       uint dbgDebugClearScreen;
+
+      /// Merging of meshes into instanced draws
+      InstanceBatching instanceBatching;
+
+      /**
+       * Memory for the per-mesh arrays of the tree nodes. Released in one go
+       * when the tree is destroyed; the number of bytes used by the last tree
+       * is available from its GetLastUsedBytes(). Only to be allocated from
+       * by the thread building the tree.
+       */
+      CS::Memory::LinearArena frameArena;
+
+      /// Job queue parallel operations are executed on (may be 0)
+      csRef<iJobQueue> operationJobQueue;
+      /// Number of jobs parallel operations are spread over
+      size_t operationJobWorkers;
+      /// Registry to report the frame arena usage to, 0 if not reported
+      iObjectRegistry* arenaReportReg;
     };
 
     /**
@@ -342,7 +424,9 @@ namespace RenderManager
       typedef typename TreeType::ContextNode ContextNodeType;
 
       //-- Some local types
-      typedef csArray<SingleMesh> MeshArrayType;
+      typedef csArray<SingleMesh, csArrayElementHandler<SingleMesh>,
+        CS::Memory::AllocatorLinearArena,
+        CS::Container::ArrayCapacityExponential<> > MeshArrayType;
       typedef typename MeshArrayType::Iterator MeshArrayIteratorType;
 
       /// Owner
@@ -358,7 +442,11 @@ namespace RenderManager
       MeshArrayType meshes;
 
       MeshNode (ContextNode& owner)
-        : owner (&owner)
+        : meshes (0,
+            CS::Memory::AllocatorLinearArena (
+              &owner.owner.GetPersistentData().frameArena),
+            CS::Container::ArrayCapacityExponential<> ()),
+          owner (&owner)
       {}
     protected:
       ContextNode* owner;
@@ -440,9 +528,9 @@ namespace RenderManager
       SVArrayHolder svArrays;
 
       /// Arrays of per-mesh shader
-      csDirtyAccessArray<iShader*> shaderArray;
+      ShaderArrayType shaderArray;
       /// Arrays of per-mesh ticket info
-      csArray<size_t> ticketArray;
+      TicketArrayType ticketArray;
 
       /// Total number of render meshes within the context
       size_t totalRenderMeshes;
@@ -451,6 +539,14 @@ namespace RenderManager
         : owner (owner), drawFlags (0),
 	  renderGrouping (CS::rpgByLayer),
           meshNodes (MeshNodeTreeBlockRefAlloc (meshNodeAlloc)),
+          shaderArray (0,
+            CS::Memory::AllocatorLinearArena (
+              &owner.GetPersistentData().frameArena),
+            CS::Container::ArrayCapacityDefault ()),
+          ticketArray (0,
+            CS::Memory::AllocatorLinearArena (
+              &owner.GetPersistentData().frameArena),
+            CS::Container::ArrayCapacityDefault ()),
           totalRenderMeshes (0) 
       {}
       
@@ -34,9 +34,6 @@ namespace CS
 namespace RenderManager
 {
 
-  typedef csArray<size_t> TicketArrayType;
-  typedef csArray<iShader*> ShaderArrayType;
-
   /**
    * Default shader setup functor.
    * Setup per mesh & layer shader arrays for each node.
@@ -98,6 +95,10 @@ namespace RenderManager
   /**
    * Default shader ticket setup.
    * Assumes that the contextLocalId in each mesh is set.
+   * If instance batching is enabled (see InstanceBatching) the meshes
+   * of a batch are also set up here: the first mesh gets the instancing
+   * shader, its ticket and the instancing shader variables, the others no
+   * shader.
    *
    * Typically used through SetupStandardTicket().
    * Must be done after shader setup (usually SetupStandardShader()).
@@ -108,7 +109,7 @@ namespace RenderManager
   public:    
 
     TicketSetup (SVArrayHolder& svArrays, csShaderVariableStack& varStack,       
-      const ShaderArrayType& shaderArray, TicketArrayType& tickets, 
+      ShaderArrayType& shaderArray, TicketArrayType& tickets, 
       const LayerConfigType& layerConfig)
       : svArrays (svArrays), varStack (varStack), 
       shaderArray (shaderArray), ticketArray (tickets),
@@ -137,16 +138,132 @@ namespace RenderManager
           ticketArray[mesh.contextLocalId+layerOffset] = shader ? shader->GetTicket (*mesh.renderMesh, varStack) : ~0;
         }
       }
+
+      InstanceBatching& batching =
+        node->GetOwner().owner.GetPersistentData().instanceBatching;
+      if (batching.IsEnabled ())
+      {
+        for (size_t layer = 0; layer < layerConfig.GetLayerCount (); ++layer)
+          SetupInstanceBatches (node, batching, layer);
+      }
     }
 
   private:
     SVArrayHolder& svArrays;
     csShaderVariableStack& varStack;
-    const ShaderArrayType& shaderArray;
+    ShaderArrayType& shaderArray;
     TicketArrayType& ticketArray;
     const LayerConfigType& layerConfig;
+
+    /// Shader variables used by a shader and ticket, for batching
+    csBitArray usedSVs;
+
+    /**
+     * Collect runs of meshes that can be drawn as instances of the first
+     * mesh of the run and switch them to the instancing shader.
+     */
+    void SetupInstanceBatches (typename RenderTree::MeshNode* node,
+      InstanceBatching& batching, size_t layer)
+    {
+      const size_t layerOffset = layer*node->GetOwner().totalRenderMeshes;
+      csShaderVariableStack stack;
+      iShader* lastShader = 0;
+      size_t lastTicket = (size_t)~0;
+      size_t m = 0;
+      while (m + 1 < node->meshes.GetSize ())
+      {
+        const typename RenderTree::MeshNode::SingleMesh& leader =
+          node->meshes[m];
+        const size_t leaderIndex = leader.contextLocalId+layerOffset;
+        iShader* shader = shaderArray[leaderIndex];
+        const size_t leaderTicket = ticketArray[leaderIndex];
+        svArrays.SetupSVStack (varStack, layer, leader.contextLocalId);
+
+        size_t end = m + 1;
+        if (shader && (leaderTicket != (size_t)~0)
+            && leader.meshWrapper && leader.meshWrapper->GetFactory ()
+            && batching.CanLeadBatch (varStack))
+        {
+          if ((shader != lastShader) || (leaderTicket != lastTicket))
+          {
+            GetUsedShaderVars (shader, leaderTicket);
+            lastShader = shader;
+            lastTicket = leaderTicket;
+          }
+          while (end < node->meshes.GetSize ())
+          {
+            const typename RenderTree::MeshNode::SingleMesh& mesh =
+              node->meshes[end];
+            const size_t meshIndex = mesh.contextLocalId+layerOffset;
+            if ((shaderArray[meshIndex] != shader)
+                || (ticketArray[meshIndex] != leaderTicket)
+                || !mesh.meshWrapper
+                || (mesh.meshWrapper->GetFactory ()
+                  != leader.meshWrapper->GetFactory ())
+                || (mesh.zmode != leader.zmode)
+                || (mesh.preCopyNum != 0)
+                || !InstanceBatching::IsInstanceable (leader.renderMesh,
+                  mesh.renderMesh))
+              break;
+            svArrays.SetupSVStack (stack, layer, mesh.contextLocalId);
+            if (!batching.HasSameShaderVars (varStack, stack, usedSVs)) break;
+            end++;
+          }
+        }
+
+        iShader* instShader = (end - m > 1)
+          ? batching.GetInstancingShader (shader) : 0;
+        if (instShader)
+        {
+          batching.BeginBatch ();
+          for (size_t i = m; i < end; i++)
+            batching.AddInstance (node->meshes[i].renderMesh->object2world);
+          batching.EndBatch (varStack);
+
+          size_t ticket = instShader->GetTicket (*leader.renderMesh, varStack);
+          /* The instancing variant may use shader variables the original
+             shader does not, so check these as well. */
+          bool batchValid = (ticket != (size_t)~0);
+          if (batchValid)
+          {
+            GetUsedShaderVars (instShader, ticket);
+            lastShader = 0;
+            for (size_t i = m + 1; batchValid && (i < end); i++)
+            {
+              svArrays.SetupSVStack (stack, layer,
+                node->meshes[i].contextLocalId);
+              batchValid = batching.HasSameShaderVars (varStack, stack,
+                usedSVs);
+            }
+          }
+          if (batchValid)
+          {
+            shaderArray[leaderIndex] = instShader;
+            ticketArray[leaderIndex] = ticket;
+            // The other meshes are drawn as instances of the first one
+            for (size_t i = m + 1; i < end; i++)
+            {
+              const size_t index = node->meshes[i].contextLocalId+layerOffset;
+              shaderArray[index] = 0;
+              ticketArray[index] = (size_t)~0;
+            }
+          }
+          else
+            batching.RemoveBatchShaderVars (varStack);
+        }
+        m = end;
+      }
+    }
+
+    void GetUsedShaderVars (iShader* shader, size_t ticket)
+    {
+      usedSVs.SetSize (varStack.GetSize ());
+      usedSVs.Clear ();
+      shader->GetUsedShaderVars (ticket, usedSVs);
+    }
   };
 
+  /// Not parallel safe: all nodes share the shader manager's SV stack.
   template<typename RenderTree, typename LayerConfigType>
   struct OperationTraits<TicketSetup<RenderTree, LayerConfigType> >
   {
@@ -27,6 +27,7 @@
 #include "ivideo/shader/shader.h"
 
 #include "csutil/cfgacc.h"
+#include "csutil/dirtyaccessarray.h"
 
 #include "cstool/meshfilter.h"
 
@@ -325,6 +326,19 @@ namespace RenderManager
       {
 	if(recurseCount > maxPortalRecurse) return;
 
+	PrepareView(context);
+
+	// Do the culling
+	CS::RenderManager::RenderView* rview = context.renderView;
+	iVisibilityCuller* culler = rview->GetThisSector()->GetVisibilityCuller();
+	Viscull<RenderTreeType>(context, rview, culler);
+
+	FinishSetup(context, portalSetupData, recursePortals);
+      }
+
+      // set up the view of a context for culling
+      void PrepareView(typename RenderTreeType::ContextNode& context)
+      {
 	CS::RenderManager::RenderView* rview = context.renderView;
 	iSector* sector = rview->GetThisSector();
     
@@ -336,11 +350,16 @@ namespace RenderManager
 
 	if(debugSplits)
 	  context.owner.AddDebugClipPlanes(rview);
-	
-	// Do the culling
-	iVisibilityCuller* culler = sector->GetVisibilityCuller();
-	Viscull<RenderTreeType>(context, rview, culler);
-	
+      }
+
+      // set up a context after it has been culled
+      void FinishSetup(typename RenderTreeType::ContextNode& context,
+		       typename PortalSetupType::ContextSetupData& portalSetupData,
+		       bool recursePortals = true)
+      {
+	CS::RenderManager::RenderView* rview = context.renderView;
+	iSector* sector = rview->GetThisSector();
+
 	// Set up all portals
 	if(recursePortals)
 	{
@@ -976,6 +995,12 @@ namespace RenderManager
 	// get current frame
 	uint currentFrame = rview->GetCurrentFrameNumber();
 
+	// frustums with slices that will be drawn
+	csArray<FrustumRef> drawFrustums;
+
+	// frustums whose casters have to be updated
+	csDirtyAccessArray<FrustumRef> setupFrustums;
+
 	// go over all lights and get the frustums
 	typename PersistentData::LightHash::GlobalIterator it = persist.lightHash.GetIterator();
 	while(it.HasNext())
@@ -993,112 +1018,232 @@ namespace RenderManager
 	    if(!frustum.slicesHash.Contains(rview))
 	      continue;
 
-	    // keep track whether any slice will be drawn at all
-	    bool draw = false;
-
-	    // get slice array
-	    csArray<typename LightData::Slice>& slices = frustum.slicesHash[rview]->slices;
-
-	    // check which slices will be drawn
-	    CS_ALLOC_STACK_ARRAY(bool, sliceDraw, slices.GetSize());
-	    for(size_t s = 0; s < slices.GetSize(); ++s)
-	    {
-	      typename LightData::Slice& slice = slices[s];
-
-	      // check whether this slice will be used
-	      sliceDraw[s] = slice.draw && (!slice.receiversPS.Empty() || (persist.doFixedCloseShadow && s == 0));
-	      draw |= sliceDraw[s];
-	    }
-
 	    // skip setup if this frustum won't be used
-	    if(!draw)
+	    if(!IsFrustumDrawn(frustum))
 	      continue;
 
+	    FrustumRef ref = { light, &lightData, &frustum };
+	    drawFrustums.Push(ref);
+
 	    // ensure projection space casters box and mesh filter are up to date
 	    if(frustum.setupFrame != currentFrame)
 	    {
 	      // update setup-frame
 	      frustum.setupFrame = currentFrame;
 
-	      // update casters bounding box and filter
-	      SetupFrustum(lightData, frustum);
+	      setupFrustums.Push(ref);
 	    }
+	  }
+	}
 
-	    // @@@TODO: could we use cubemaps for point lights?
-	    // @@@TODO: could we draw all slices at once using instancing?
+	// update casters bounding boxes and filters of all frustums at once
+	SetupFrustums(setupFrustums);
 
-	    // setup the slices that'll be used
-	    for(size_t s = 0; s < slices.GetSize(); ++s)
-	    {
-	      typename LightData::Slice& slice = slices[s];
+	// contexts created for the slices
+	csDirtyAccessArray<typename RenderTreeType::ContextNode*> contexts;
 
-	      // not used, skip
-	      if(!sliceDraw[s])
-		continue;
+	for(size_t f = 0; f < drawFrustums.GetSize(); ++f)
+	{
+	  const FrustumRef& ref = drawFrustums[f];
 
-	      // set up SVs and create the target
-	      SetupTarget(light, lightData, frustum, slice, persist.doFixedCloseShadow && s == 0);
+	  // get slice array
+	  csArray<typename LightData::Slice>& slices = ref.frustum->slicesHash[rview]->slices;
 
-	      // set clipping range
-	      slice.clipSV->SetValue(csVector2(persist.splitDists[s], persist.splitDists[s+1]));
-	    }
+	  // @@@TODO: could we use cubemaps for point lights?
+	  // @@@TODO: could we draw all slices at once using instancing?
+
+	  // setup the slices that'll be used
+	  for(size_t s = 0; s < slices.GetSize(); ++s)
+	  {
+	    typename LightData::Slice& slice = slices[s];
+
+	    // not used, skip
+	    if(!IsSliceDrawn(slice, s))
+	      continue;
+
+	    // set up SVs and create the target
+	    typename RenderTreeType::ContextNode* context = SetupTarget(ref.light,
+	      *ref.lightData, *ref.frustum, slice, persist.doFixedCloseShadow && s == 0);
+	    if(context)
+	      contexts.Push(context);
+
+	    // set clipping range
+	    slice.clipSV->SetValue(csVector2(persist.splitDists[s], persist.splitDists[s+1]));
 	  }
 	}
+
+	// set up the contexts of all slices
+	SetupContexts(contexts);
       }
 
     protected:
-      void SetupFrustum(LightData& lightData, typename LightData::Frustum& frustum)
+      // a frustum of a light
+      struct FrustumRef
       {
-	// clear casters box
-	frustum.castersPS.StartBoundingBox();
-
-	// clear filter
-	frustum.meshFilter.Clear();
+	iLight* light;
+	LightData* lightData;
+	typename LightData::Frustum* frustum;
+      };
 
-	// get all meshes in the frustum box
-	iVisibilityCuller* culler = sector->GetVisibilityCuller();
-	csRef<iVisibilityObjectIterator> objects = culler->VisTest(frustum.boxLS / lightData.light2world);
+      // listener adding the objects found for several frustums to their casters
+      class CasterCollector :
+	public scfImplementation1<CasterCollector, iVisibilityCullerMultiViewListener>
+      {
+      public:
+	CasterCollector(ShadowParameters& params)
+	  : scfImplementation1<CasterCollector, iVisibilityCullerMultiViewListener>(this),
+	    params(params), frustums(0)
+	{
+	}
 
-	// calculate world -> light -> frustum transform
-	csTransform frust2world(frustum.frust2light * lightData.light2world);
+	void SetFrustums(const FrustumRef* frustums)
+	{
+	  this->frustums = frustums;
+	}
 
-	// iterate over all meshes
-	while(objects->HasNext())
+	virtual void ObjectVisible(iVisibilityObject* object, iMeshWrapper*,
+	  uint32 viewMask, const uint32*)
 	{
-	  // get object
-	  iVisibilityObject* object = objects->Next();
+	  for(size_t v = 0; viewMask; ++v, viewMask >>= 1)
+	  {
+	    if(viewMask & 1)
+	      params.AddCaster(*frustums[v].lightData, *frustums[v].frustum, object);
+	  }
+	}
 
-	  // get mesh wrapper
-	  iMeshWrapper* meshWrapper = object->GetMeshWrapper();
+      private:
+	ShadowParameters& params;
+	const FrustumRef* frustums;
+      };
 
-	  // get mesh flags
-	  csFlags meshFlags = meshWrapper->GetFlags();
+      // check whether a slice will be drawn
+      bool IsSliceDrawn(const typename LightData::Slice& slice, size_t s) const
+      {
+	return slice.draw && (!slice.receiversPS.Empty() || (persist.doFixedCloseShadow && s == 0));
+      }
 
-	  // check whether this object is a caster in our mode
-	  bool casting = (!persist.limitedShadow && !meshFlags.Check(CS_ENTITY_NOSHADOWCAST))
-		      || ( persist.limitedShadow &&  meshFlags.Check(CS_ENTITY_LIMITEDSHADOWCAST));
+      // check whether any slice of a frustum will be drawn
+      bool IsFrustumDrawn(typename LightData::Frustum& frustum) const
+      {
+	csArray<typename LightData::Slice>& slices = frustum.slicesHash[rview]->slices;
+	for(size_t s = 0; s < slices.GetSize(); ++s)
+	{
+	  if(IsSliceDrawn(slices[s], s))
+	    return true;
+	}
+	return false;
+      }
 
-	  // check whether we want this mesh filtered:
-	  //   for limited casting casters are included
-	  //   for normal casting non-casters are excluded
-	  if(casting ^ !persist.limitedShadow)
+      // update casters bounding box and filter of the given frustums
+      // all frustums are tested with a single query of the culler
+      void SetupFrustums(const csDirtyAccessArray<FrustumRef>& frustums)
+      {
+	iVisibilityCuller* culler = sector->GetVisibilityCuller();
+	CasterCollector collector(*this);
+
+	// the culler tests at most 32 views at once
+	for(size_t first = 0; first < frustums.GetSize(); first += 32)
+	{
+	  size_t numViews = csMin(frustums.GetSize() - first, size_t(32));
+	  csPlane3 planes[32][6];
+	  csVisibilityCullerView views[32];
+
+	  for(size_t v = 0; v < numViews; ++v)
 	  {
-	    frustum.meshFilter.AddFilterMesh(meshWrapper);
+	    const FrustumRef& ref = frustums[first + v];
+
+	    // clear casters box
+	    ref.frustum->castersPS.StartBoundingBox();
+
+	    // clear filter
+	    ref.frustum->meshFilter.Clear();
+
+	    // get all meshes in the frustum box - bound it by planes facing inwards
+	    csBox3 box(ref.frustum->boxLS / ref.lightData->light2world);
+	    planes[v][0].Set( 1,  0,  0, -box.MinX());
+	    planes[v][1].Set(-1,  0,  0,  box.MaxX());
+	    planes[v][2].Set( 0,  1,  0, -box.MinY());
+	    planes[v][3].Set( 0, -1,  0,  box.MaxY());
+	    planes[v][4].Set( 0,  0,  1, -box.MinZ());
+	    planes[v][5].Set( 0,  0, -1,  box.MaxZ());
+	    views[v].planes = planes[v];
+	    views[v].planes_mask = 0x3f;
 	  }
 
-	  // if this mesh is a caster add it's bounding box to the caster box
-	  if(casting)
-	  {
-	    // project bounding box
-	    csBox3 meshBoxPS(ProjectBox(frust2world * object->GetBBox(), lightData.project, lightData.projectInverse));
+	  collector.SetFrustums(frustums.GetArray() + first);
+	  culler->VisTest(views, numViews, &collector);
+	}
+      }
 
-	    // add box to casters bounding box
-	    frustum.castersPS += meshBoxPS;
-	  }
+      // add an object in the box of a frustum to its casters
+      void AddCaster(LightData& lightData, typename LightData::Frustum& frustum,
+		     iVisibilityObject* object)
+      {
+	// get mesh wrapper
+	iMeshWrapper* meshWrapper = object->GetMeshWrapper();
+
+	// get mesh flags
+	csFlags meshFlags = meshWrapper->GetFlags();
+
+	// check whether this object is a caster in our mode
+	bool casting = (!persist.limitedShadow && !meshFlags.Check(CS_ENTITY_NOSHADOWCAST))
+		    || ( persist.limitedShadow &&  meshFlags.Check(CS_ENTITY_LIMITEDSHADOWCAST));
+
+	// check whether we want this mesh filtered:
+	//   for limited casting casters are included
+	//   for normal casting non-casters are excluded
+	if(casting ^ !persist.limitedShadow)
+	{
+	  frustum.meshFilter.AddFilterMesh(meshWrapper);
+	}
+
+	// if this mesh is a caster add it's bounding box to the caster box
+	if(casting)
+	{
+	  // calculate world -> light -> frustum transform
+	  csTransform frust2world(frustum.frust2light * lightData.light2world);
+
+	  // project bounding box
+	  csBox3 meshBoxPS(ProjectBox(frust2world * object->GetBBox(), lightData.project, lightData.projectInverse));
+
+	  // add box to casters bounding box
+	  frustum.castersPS += meshBoxPS;
 	}
       }
 
-      void SetupTarget(iLight* light, LightData& lightData, typename LightData::Frustum& frustum, typename LightData::Slice& slice, bool fixed)
+      // set up the contexts created for the slices
+      // the views of all contexts are culled at once
+      void SetupContexts(const csDirtyAccessArray<typename RenderTreeType::ContextNode*>& contexts)
+      {
+	if(contexts.IsEmpty())
+	  return;
+
+	ShadowContextSetup contextSetup(persist.layerConfig, persist.shaderManager,
+					persist.portalPersist, persist.maxPortalRecurse,
+					renderTree.IsDebugFlagEnabled(persist.dbgSplit));
+
+	for(size_t c = 0; c < contexts.GetSize(); ++c)
+	{
+	  contextSetup.PrepareView(*contexts[c]);
+	}
+
+	// do the culling
+	iVisibilityCuller* culler = sector->GetVisibilityCuller();
+	Viscull<RenderTreeType>(contexts.GetArray(), contexts.GetSize(), culler);
+
+	for(size_t c = 0; c < contexts.GetSize(); ++c)
+	{
+	  // create portal data
+	  typename ShadowContextSetup::PortalSetupType::ContextSetupData portalData(contexts[c]);
+
+	  // setup the new context
+	  contextSetup.FinishSetup(*contexts[c], portalData);
+	}
+      }
+
+      // set up SVs of a slice and create the context rendering it
+      // returns 0 if there's nothing to draw
+      typename RenderTreeType::ContextNode* SetupTarget(iLight* light, LightData& lightData, typename LightData::Frustum& frustum, typename LightData::Slice& slice, bool fixed)
       {
 	// @@@TODO: add slice caching (persistent SVs, ...)
 
@@ -1275,7 +1420,7 @@ namespace RenderManager
 	    if(renderTree.IsDebugFlagEnabled(persist.dbgShadowTex))
 	      renderTree.AddDebugTexture(tex);
 	  }
-	  return;
+	  return 0;
 	}
 
 	// create camera
@@ -1329,14 +1474,7 @@ namespace RenderManager
 	    renderTree.AddDebugTexture(tex);
 	}
 
-	// create portal data
-	typename ShadowContextSetup::PortalSetupType::ContextSetupData portalData(context);
-    
-	// setup the new context
-	ShadowContextSetup contextSetup(persist.layerConfig, persist.shaderManager,
-					persist.portalPersist, persist.maxPortalRecurse,
-					renderTree.IsDebugFlagEnabled(persist.dbgSplit));
-	contextSetup(*context, portalData);
+	return context;
       }
 
       // handle setup for a mesh - done after all lights are known
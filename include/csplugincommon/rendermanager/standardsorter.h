@@ -27,6 +27,7 @@
 
 #include "ivideo/rendermesh.h"
 #include "csgeom/vector3.h"
+#include "csutil/radixsort.h"
 
 namespace CS
 {
@@ -37,6 +38,8 @@ namespace RenderManager
    * Standard rendermesh sorter.
    * Sorts mesh nodes depending on their render priority, either 
    * back2front/front2back or based on material and factories.
+   * Each mesh gets a 64 bit key for its node's sorting mode, and the keys
+   * are sorted with a csRadixSorter.
    *
    * Usage: with mesh node iteration.
    * SetupCameraLocation () must be called with the current camera location.
@@ -58,13 +61,15 @@ namespace RenderManager
     StandardMeshSorter (iEngine* engine)
       : engine (engine), cameraOrigin (0,0,0)
     {
-      // Build table of sorting options
+      /* Build table of sorting options. Filled up front so sorting itself
+       * never writes shared state and can run in parallel. */
       renderPriorityCount = uint (engine->GetRenderPriorityCount ());
       sortingTypeTable = new int[renderPriorityCount];
       
       for (uint i = 0; i < renderPriorityCount; ++i)
       {       
-        sortingTypeTable[i] = -1;
+        sortingTypeTable[i] = engine->GetRenderPrioritySorting (
+          CS::Graphics::RenderPriority (i));
       }      
     }
 
@@ -89,106 +94,124 @@ namespace RenderManager
       
       int sorting = GetSorting (renderPrio);
       meshNode->sorting = sorting;
+
+      const size_t numMeshes = meshNode->meshes.GetSize ();
+      if (numMeshes < 2) return;
+
+      /* Compute a key per mesh once, then radix sort the keys. This avoids
+       * dereferencing the render meshes and recomputing distances for every
+       * comparison. */
+      CS_ALLOC_STACK_ARRAY_FALLBACK(uint64, keys, numMeshes, 4096);
       switch (sorting)
       {
       case CS_RENDPRI_SORT_NONE:
         {
-          NormalSorter sorter;
-          meshNode->meshes.SortStable (sorter); // Use a stable sort to keep some b2f
+          for (size_t i = 0; i < numMeshes; i++)
+            keys[i] = NormalKey (meshNode->meshes[i].renderMesh);
         }
         break;
       case CS_RENDPRI_SORT_BACK2FRONT:
         {
 	  // B2F: we want to render meshes with the larger distance first.
-          DistanceSorter sorter (cameraOrigin, -1);
-          meshNode->meshes.Sort (sorter);
+          for (size_t i = 0; i < numMeshes; i++)
+          {
+            const csRenderMesh* rm = meshNode->meshes[i].renderMesh;
+            keys[i] = DistanceKey (rm, ~DistanceBits (rm));
+          }
         }
         break;
       case CS_RENDPRI_SORT_FRONT2BACK:
         {
 	  // F2B: we want to render meshes with the smaller distance first.
-          DistanceSorter sorter (cameraOrigin, 1);
-          meshNode->meshes.Sort (sorter);
+          for (size_t i = 0; i < numMeshes; i++)
+          {
+            const csRenderMesh* rm = meshNode->meshes[i].renderMesh;
+            keys[i] = DistanceKey (rm, DistanceBits (rm));
+          }
         }
         break;
       default:
         CS_ASSERT_MSG("Invalid sorting mode!", 0);
+        return;
+      }
+
+      // The 64 bit sort is stable, which keeps some b2f for unsorted meshes
+      csRadixSorter sorter;
+      sorter.Sort (keys, numMeshes);
+
+      /* Apply the order by following the cycles of the permutation; this
+       * moves each (fairly large) mesh entry once and needs no temporary
+       * array. Entries are marked as done by making their rank point to
+       * themselves. */
+      typename Tree::MeshNode::MeshArrayType& meshes = meshNode->meshes;
+      size_t* ranks = sorter.GetRanks ();
+      for (size_t i = 0; i < numMeshes; i++)
+      {
+        if (ranks[i] == i) continue;
+
+        typename Tree::MeshNode::SingleMesh first (meshes[i]);
+        size_t j = i;
+        while (ranks[j] != i)
+        {
+          size_t next = ranks[j];
+          meshes[j] = meshes[next];
+          ranks[j] = j;
+          j = next;
+        }
+        meshes[j] = first;
+        ranks[j] = j;
       }
     }
     
 
   private:
+    /// Bits of a pointer used to tell it apart from other heap pointers
+    static uint32 PointerBits (const void* p)
+    {
+      return uint32 (uintptr_t (p) >> 4);
+    }
 
     /**
-     * Sorter functor doing normal sorting
+     * Key for normal sorting: groups meshes by material, then by geometry.
+     * The order of the groups is arbitrary.
      */
-    class NormalSorter
+    static uint64 NormalKey (const csRenderMesh* rm)
     {
-    public:
-      bool operator() (typename Tree::MeshNode::SingleMesh const& m1,
-        typename Tree::MeshNode::SingleMesh const& m2)
-      {
-        const csRenderMesh* rm1 = m1.renderMesh;
-        const csRenderMesh* rm2 = m2.renderMesh;
-
-        if(rm1->material < rm2->material)
-          return true;
-
-        if((rm1->material == rm2->material) &&
-          (rm1->geometryInstance < rm2->geometryInstance))
-          return true;
-
-        return false;
-      }
-
-    };
+      return (uint64 (PointerBits (rm->material)) << 32)
+        | PointerBits (rm->geometryInstance);
+    }
 
     /**
-     * Sorter function sorting based on distance between render mesh and
-     * camera origin.
-     * Meshes with the smaller (scaled) distance to the camera are sorted first.
-     * Scale factor is used to be able to invert sorting.
+     * The squared distance of a render mesh to the camera, as integer
+     * ordered the same way. This works since the distance is never
+     * negative.
      */
-    class DistanceSorter : NormalSorter
+    uint32 DistanceBits (const csRenderMesh* rm) const
     {
-    public:
-      DistanceSorter (const csVector3& cameraOrigin, const float scaleFactor)
-        : cameraOrigin (cameraOrigin), scaleFactor (scaleFactor)
-      {}
-
-      bool operator() (typename Tree::MeshNode::SingleMesh const& m1,
-        typename Tree::MeshNode::SingleMesh const& m2)
+      union
       {
-        const csRenderMesh* rm1 = m1.renderMesh;
-        const csRenderMesh* rm2 = m2.renderMesh;
-
-        const float distSqRm1 = scaleFactor*(rm1->worldspace_origin - cameraOrigin).SquaredNorm ();
-        const float distSqRm2 = scaleFactor*(rm2->worldspace_origin - cameraOrigin).SquaredNorm ();
-
-        if (distSqRm1 < distSqRm2)
-          return true;
-
-        if (distSqRm2 < distSqRm1)
-          return false;
-
-        return NormalSorter::operator () (m1, m2);
-      }
-
+        float f;
+        uint32 u;
+      } distSq;
+      distSq.f = (rm->worldspace_origin - cameraOrigin).SquaredNorm ();
+      return distSq.u;
+    }
 
-    private:
-      const csVector3& cameraOrigin;
-      const float scaleFactor;
-    };
+    /**
+     * Key for distance sorting: the distance in the upper 32 bits, meshes
+     * at the same distance are grouped by material and geometry.
+     */
+    static uint64 DistanceKey (const csRenderMesh* rm, uint32 distanceBits)
+    {
+      return (uint64 (distanceBits) << 32)
+        | ((PointerBits (rm->material) & 0xffff) << 16)
+        | (PointerBits (rm->geometryInstance) & 0xffff);
+    }
   
-    csRenderPrioritySorting GetSorting (CS::Graphics::RenderPriority renderPrio)
+    csRenderPrioritySorting GetSorting (CS::Graphics::RenderPriority renderPrio) const
     {
       CS_ASSERT(renderPrio.IsValid() && renderPrio < renderPriorityCount);
 
-      if (sortingTypeTable[renderPrio] < 0)
-      {
-        sortingTypeTable[renderPrio] = engine->GetRenderPrioritySorting (renderPrio);
-      }
-
       return (csRenderPrioritySorting)sortingTypeTable[renderPrio];
     }
 
@@ -198,11 +221,11 @@ namespace RenderManager
     csVector3 cameraOrigin;
   };
   
-  /// The sorter is currently non-parallel safe due to how the caching is implemented.
+  /// Each mesh node is sorted independently, so sorting can run in parallel.
   template<typename RenderTree>  
   struct OperationTraits<StandardMeshSorter<RenderTree> >
   {
-    typedef OperationUnordered Ordering;
+    typedef OperationUnorderedParallel Ordering;
   };
 
 }
@@ -22,6 +22,9 @@
 /**\file
  * Holder for shader variable arrays.
  */
+#include "csutil/lineararena.h"
+#include "csutil/mempool.h"
+
 class csShaderVariable;
 
 namespace CS
@@ -49,14 +52,14 @@ namespace RenderManager
      */
     SVArrayHolder (size_t numLayers = 1, size_t numSVNames = 0, size_t numSets = 0)
       : numLayers (numLayers), numSVNames (numSVNames), numSets (numSets), svArray (0),
-        memAllocSetUp (false)
+        arena (0), memAllocSetUp (false)
     {
       if (numSVNames && numSets && numLayers)
         Setup (numLayers, numSVNames, numSets);
     }
 
     SVArrayHolder (const SVArrayHolder& other)
-      : svArray (0), memAllocSetUp (false)
+      : svArray (0), arena (0), memAllocSetUp (false)
     {
       *this = other;
     }
@@ -69,6 +72,8 @@ namespace RenderManager
     SVArrayHolder& operator= (const SVArrayHolder& other)
     {
       if (memAllocSetUp) GetMemAlloc().~csMemoryPool();
+      // A copy always uses an own pool
+      arena = 0;
 
       numLayers = other.numLayers;
       numSVNames = other.numSVNames;
@@ -98,26 +103,33 @@ namespace RenderManager
     /**
      * Initialize storage for SVs, given a number of layers, sets and SV names,
      * Note that additional layers can be inserted later, sets and SVs cannot.
+     * If \a arena is given the storage is allocated from it instead of an
+     * own memory pool; the arena must not be reset while the holder is used.
      */
-    void Setup (size_t numLayers, size_t numSVNames, size_t numSets)
+    void Setup (size_t numLayers, size_t numSVNames, size_t numSets,
+      CS::Memory::LinearArena* arena = 0)
     {
       this->numLayers = numLayers;
       this->numSVNames = numSVNames;
       this->numSets = numSets;
+      this->arena = arena;
 
       const size_t sliceSVs = numSVNames*numSets;
       const size_t sliceSize = sizeof(csShaderVariable*)*sliceSVs;
+      if (!arena)
+      {
 #ifndef DOXYGEN_RUN
 #include "csutil/custom_new_disable.h"
 #endif
-      new (&memAlloc) csMemoryPool (sliceSize * 4);
+        new (&memAlloc) csMemoryPool (sliceSize * 4);
 #ifndef DOXYGEN_RUN
 #include "csutil/custom_new_enable.h"
 #endif
-      memAllocSetUp = true;
+        memAllocSetUp = true;
+      }
 
       csShaderVariable** superSlice = reinterpret_cast<csShaderVariable**> (
-        GetMemAlloc().Alloc (numLayers * sliceSize));
+        AllocSlices (numLayers * sliceSize));
       memset (superSlice, 0, numLayers * sliceSize);
 
       for (size_t l = 0; l < numLayers; l++)
@@ -199,7 +211,7 @@ namespace RenderManager
       const size_t sliceSize = sizeof(csShaderVariable*)*numSVNames*numSets;
 
       csShaderVariable** slice = reinterpret_cast<csShaderVariable**> (
-        GetMemAlloc().Alloc (sliceSize));
+        AllocSlices (sliceSize));
       svArray.Insert (after+1, slice);
 
       memcpy (slice, svArray[replicateFrom], sliceSize);
@@ -224,6 +236,12 @@ namespace RenderManager
     size_t numSVNames;
     size_t numSets;
     csArray<csShaderVariable**> svArray;
+    CS::Memory::LinearArena* arena;
+
+    void* AllocSlices (size_t size)
+    {
+      return arena ? arena->Alloc (size) : GetMemAlloc().Alloc (size);
+    }
 
     csMemoryPool& GetMemAlloc()
     { 
@@ -26,6 +26,7 @@
 #include "iengine/portal.h"
 #include "iengine/sector.h"
 #include "ivideo/material.h"
+#include "csutil/dirtyaccessarray.h"
 
 #include "csplugincommon/rendermanager/rendertree.h"
 #include "csplugincommon/rendermanager/operations.h"
@@ -60,8 +61,13 @@ namespace RenderManager
 
     StandardSVSetup (SVArrayHolder& svArrays, 
       const LayerConfigType& layerConfig) 
-      : svArrays (svArrays), layerConfig (layerConfig)
+      : svArrays (svArrays)
     {
+      // Query the layer contexts once instead of for every mesh
+      const size_t numLayers = layerConfig.GetLayerCount ();
+      layerContexts.SetSize (numLayers);
+      for (size_t layer = 0; layer < numLayers; ++layer)
+        layerContexts[layer] = layerConfig.GetSVContext (layer);
     }  
 
     /// Operator doing main work
@@ -78,7 +84,9 @@ namespace RenderManager
         typename RenderTree::MeshNode::SingleMesh& mesh = node->meshes[i];
 
         csRenderMesh* rm = mesh.renderMesh;
-        for (size_t layer = 0; layer < layerConfig.GetLayerCount (); ++layer)
+        iShaderVariableContext* materialContext =
+          rm->material ? rm->material->GetMaterial () : 0;
+        for (size_t layer = 0; layer < layerContexts.GetSize (); ++layer)
         {
           svArrays.SetupSVStack (localStack, layer, mesh.contextLocalId);
 
@@ -86,11 +94,10 @@ namespace RenderManager
           // @@TODO: get more of them        
           localStack[svO2wName] = mesh.svObjectToWorld;
           localStack[svO2wIName] = mesh.svObjectToWorldInv;
-          iShaderVariableContext* layerContext =
-            layerConfig.GetSVContext (layer);
+          iShaderVariableContext* layerContext = layerContexts[layer];
           if (layerContext) layerContext->PushVariables (localStack);
-          if (rm->material)
-            rm->material->GetMaterial ()->PushVariables (localStack);
+          if (materialContext)
+            materialContext->PushVariables (localStack);
           if (rm->variablecontext)
             rm->variablecontext->PushVariables (localStack);
           if (mesh.meshObjSVs)
@@ -102,13 +109,15 @@ namespace RenderManager
 
   private:
     SVArrayHolder& svArrays;
-    const LayerConfigType& layerConfig;
+    /// SV context of each layer
+    csDirtyAccessArray<iShaderVariableContext*> layerContexts;
   };  
 
+  /// Only touches the SV slots of the meshes in the node, parallel safe.
   template<typename RenderTree, typename LayerConfigType>
   struct OperationTraits<StandardSVSetup<RenderTree, LayerConfigType> >
   {
-    typedef OperationUnordered Ordering;
+    typedef OperationUnorderedParallel Ordering;
   };
 
   
@@ -122,8 +131,8 @@ namespace RenderManager
   class ShaderSVSetup
   {
   public:    
-    typedef csArray<iShader*> ShaderArrayType;
-    typedef csArray<size_t> TicketArrayType;
+    typedef CS::RenderManager::ShaderArrayType ShaderArrayType;
+    typedef CS::RenderManager::TicketArrayType TicketArrayType;
 
     ShaderSVSetup (SVArrayHolder& svArrays, const ShaderArrayType& shaderArray,
       const TicketArrayType& tickets, const LayerConfigType& layerConfig)
@@ -170,6 +179,7 @@ namespace RenderManager
     const LayerConfigType& layerConfig;
   };
 
+  /// Not parallel safe: all nodes share tempStack.
   template<typename RenderTree, typename LayerConfigType>
   struct OperationTraits<ShaderSVSetup<RenderTree, LayerConfigType> >
   {
@@ -198,7 +208,8 @@ namespace RenderManager
     context.svArrays.Setup (
       layerConfig.GetLayerCount(), 
       shaderManager->GetSVNameStringset ()->GetSize (),
-      context.totalRenderMeshes);
+      context.totalRenderMeshes,
+      &context.owner.GetPersistentData().frameArena);
 
     // Push the default stuff
     csShaderVariableStack& svStack = shaderManager->GetShaderVariableStack ();
@@ -26,6 +26,7 @@
 #include "csplugincommon/rendermanager/rendertree.h"
 #include "csplugincommon/rendermanager/renderview.h"
 #include "iengine/viscull.h"
+#include "csutil/refarr.h"
 
 namespace CS
 {
@@ -37,6 +38,10 @@ namespace RenderManager
   bool Viscull (typename RenderTree::ContextNode& context, RenderView* rw, 
     iVisibilityCuller* culler);
 
+  template<typename RenderTree>
+  bool Viscull (typename RenderTree::ContextNode** contexts, size_t numContexts,
+    iVisibilityCuller* culler);
+
   namespace Implementation
   {
     /**
@@ -174,6 +179,43 @@ namespace RenderManager
       iSector* sector;
       const CS::Utility::MeshFilter* filter;
     };
+
+    /**
+     * Helper class for culling several contexts at once: hands the objects
+     * visible in each view to the ViscullCallback of the respective context.
+     */
+    template<typename RenderTree>
+    class ViscullMultiViewCallback : 
+      public scfImplementation1<ViscullMultiViewCallback<RenderTree>,
+                                iVisibilityCullerMultiViewListener>
+    {
+    public:
+      typedef ViscullCallback<RenderTree> ViewCallbackType;
+
+      ViscullMultiViewCallback ()
+        : scfImplementation1<ViscullMultiViewCallback,
+            iVisibilityCullerMultiViewListener> (this)
+      {}
+
+      /// Add the callback for the next view.
+      void AddView (ViewCallbackType* cb)
+      {
+        callbacks.Push (cb);
+      }
+
+      virtual void ObjectVisible (iVisibilityObject *visobject, 
+        iMeshWrapper *imesh, uint32 view_mask, const uint32* frustum_masks)
+      {
+        for (size_t v = 0; v < callbacks.GetSize (); ++v)
+        {
+          if (view_mask & (uint32 (1) << v))
+            callbacks[v]->ObjectVisible (visobject, imesh, frustum_masks[v]);
+        }
+      }
+
+    private:
+      csRefArray<ViewCallbackType> callbacks;
+    };
   }
   
   /**
@@ -205,6 +247,51 @@ namespace RenderManager
 
     return true;
   }
+
+  /**
+   * Cull several contexts sharing the same visibility culler at once, e.g.
+   * the slices of a shadow map. The culler tests the views of all contexts
+   * in a single traversal; all found meshes are added to the respective
+   * context.
+   *
+   * Unlike the single context version only the clip planes of the render
+   * views are used, the views must be set up (PrepareDraw(), clip planes)
+   * before.
+   */
+  template<typename RenderTree>
+  bool Viscull (typename RenderTree::ContextNode** contexts, size_t numContexts,
+    iVisibilityCuller* culler)
+  {
+    typedef CS::RenderManager::Implementation::ViscullMultiViewCallback<
+      RenderTree> MultiViewCallbackType;
+    typedef typename MultiViewCallbackType::ViewCallbackType CallbackType;
+
+    // Cullers test at most 32 views at once
+    for (size_t first = 0; first < numContexts; first += 32)
+    {
+      size_t numViews = csMin (numContexts - first, size_t (32));
+      csVisibilityCullerView views[32];
+      MultiViewCallbackType cb;
+
+      for (size_t v = 0; v < numViews; ++v)
+      {
+        typename RenderTree::ContextNode& context = *contexts[first + v];
+        RenderView* rw = context.renderView;
+        csRenderContext* ctxt = rw->GetRenderContext ();
+        views[v].planes = ctxt->clip_planes;
+        views[v].planes_mask = ctxt->clip_planes_mask;
+
+        csRef<CallbackType> viewCallback;
+        viewCallback.AttachNew (new CallbackType (context, rw,
+          &rw->GetMeshFilter ()));
+        cb.AddView (viewCallback);
+      }
+
+      culler->VisTest (views, numViews, &cb);
+    }
+
+    return true;
+  }
  
 }
 }
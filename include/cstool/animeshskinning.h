@@ -0,0 +1,133 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSTOOL_ANIMESHSKINNING_H__
+#define __CS_CSTOOL_ANIMESHSKINNING_H__
+
+/**\file
+ * CPU dual quaternion skinning for CS::Mesh::iAnimatedMesh's
+ */
+
+#include "csextern.h"
+#include "csgeom/dualquaternion.h"
+#include "csgeom/vector3.h"
+#include "csutil/dirtyaccessarray.h"
+
+struct iJobQueue;
+
+namespace CS {
+namespace Animation {
+class AnimatedMeshState;
+} // namespace Animation
+
+namespace Mesh {
+
+struct AnimatedMeshBoneInfluence;
+
+/**
+ * Dual quaternion skinning of vertex attributes on the CPU.
+ *
+ * The bone transforms are converted to dual quaternions once per
+ * SetupBones() call. Skin() then blends them for each vertex and
+ * transforms the attributes. If the compiler and processor support SSE,
+ * vertices are processed four at a time in structure-of-arrays form.
+ * SkinParallel() additionally spreads the vertices over a job queue.
+ */
+class CS_CRYSTALSPACE_EXPORT DualQuaternionSkinner
+{
+public:
+  /**
+   * Vertex attributes to skin. Leave the pointers of an attribute 0 to
+   * not skin it. Tangents and binormals are only skinned together.
+   */
+  struct Buffers
+  {
+    const csVector3* srcVertices;
+    csVector3* dstVertices;
+    const csVector3* srcNormals;
+    csVector3* dstNormals;
+    const csVector3* srcTangents;
+    csVector3* dstTangents;
+    const csVector3* srcBinormals;
+    csVector3* dstBinormals;
+
+    Buffers () : srcVertices (0), dstVertices (0), srcNormals (0),
+      dstNormals (0), srcTangents (0), dstTangents (0), srcBinormals (0),
+      dstBinormals (0) {}
+  };
+
+  DualQuaternionSkinner ();
+
+  /// Whether the SIMD code path is supported by this build and processor.
+  static bool IsSIMDAvailable ();
+
+  /**
+   * Enable or disable the use of the SIMD code path. It is enabled by
+   * default if available.
+   */
+  void SetSIMDEnabled (bool enable);
+  /// Whether the SIMD code path is used.
+  bool IsSIMDEnabled () const { return useSIMD; }
+
+  /**
+   * Set up the bone transforms from the current state of a skeleton.
+   * Must be called before skinning if the state changed.
+   */
+  void SetupBones (const CS::Animation::AnimatedMeshState* state);
+
+  /**
+   * Set up the bone transforms from bone rotations and offsets.
+   */
+  void SetupBones (const csQuaternion* rotations, const csVector3* offsets,
+    size_t numBones);
+
+  /**
+   * Skin the vertices from \a first to \a last (exclusive).
+   * Different ranges of the same buffers can be skinned concurrently.
+   * \param buffers Attributes to skin.
+   * \param influences Bone influences of all vertices,
+   *   \a influencesPerVertex consecutive entries per vertex.
+   * \param influencesPerVertex Number of bone influences per vertex.
+   * \param first First vertex to skin.
+   * \param last One past the last vertex to skin.
+   */
+  void Skin (const Buffers& buffers,
+    const AnimatedMeshBoneInfluence* influences, size_t influencesPerVertex,
+    size_t first, size_t last) const;
+
+  /**
+   * Skin \a numVertices vertices, split into batches of \a batchSize
+   * vertices which are processed by the job queue and the calling thread.
+   * Returns when all vertices are skinned.
+   * \param jobQueue Job queue to use.
+   * \param numWorkers Number of jobs to spread the batches over.
+   * \sa Skin(), CS::Threading::ParallelFor()
+   */
+  void SkinParallel (iJobQueue* jobQueue, size_t numWorkers,
+    const Buffers& buffers, const AnimatedMeshBoneInfluence* influences,
+    size_t influencesPerVertex, size_t numVertices,
+    size_t batchSize = 1024) const;
+private:
+  bool useSIMD;
+  csDirtyAccessArray<csDualQuaternion> boneTransforms;
+};
+
+} // namespace Mesh
+} // namespace CS
+
+#endif // __CS_CSTOOL_ANIMESHSKINNING_H__
@@ -37,6 +37,66 @@
 
 struct csFileTime;
 
+/**
+ * Sequential reader for the contents of a file in a ZIP archive, reading
+ * directly from the archive data in memory (usually a memory mapping of the
+ * archive file). Compressed files are inflated in pieces as they are read,
+ * so no buffer for the complete file contents is needed.
+ *
+ * Set up with csArchive::OpenEntryStream(). A stream can be used from any
+ * thread, but only from one thread at a time.
+ */
+class CS_CRYSTALSPACE_EXPORT csArchiveEntryStream
+{
+public:
+  csArchiveEntryStream ();
+  ~csArchiveEntryStream ();
+
+  /// Whether the stream was set up successfully
+  bool IsValid () const { return archiveData.IsValid (); }
+  /// Get the uncompressed size of the file
+  size_t GetSize () const { return ucsize; }
+  /// Get the current position in the uncompressed file
+  size_t GetPos () const { return pos; }
+
+  /**
+   * Read up to \a size bytes. Returns the number of bytes read, which is
+   * less than \a size at the end of the file or if the data is broken.
+   */
+  size_t Read (char* data, size_t size);
+  /**
+   * Set the position in the uncompressed file. For compressed files, going
+   * back requires inflating the data from the start again.
+   */
+  bool SetPos (size_t newPos);
+
+  /**
+   * If the file is stored uncompressed, get a buffer with the file contents
+   * that directly references the archive data. Returns 0 otherwise.
+   */
+  csPtr<iDataBuffer> GetStoredData ();
+private:
+  friend class csArchive;
+
+  csRef<iDataBuffer> archiveData;
+  /// Start of the (compressed) file data
+  size_t dataOffset;
+  size_t csize;
+  size_t ucsize;
+  int method;
+  size_t pos;
+
+  /// Inflate state; valid if inflateUsed is true
+  z_stream zs;
+  bool inflateUsed;
+  /// Amount of compressed data consumed so far
+  size_t consumed;
+
+  void Reset ();
+  bool RestartInflate ();
+  size_t Inflate (char* data, size_t size);
+};
+
 /**
  * This class can be used to work with standard ZIP archives.
  * Constructor accepts a file name - if such a file is not found, it is
@@ -110,6 +170,8 @@ private:
   char *filename;		// Archive file name
   // Archive file pointer.
   csRef<iFile> file;
+  // Whether to replace the archive file instead of overwriting it on flush
+  bool preserveFile;
 
   size_t comment_length;	// Archive comment length
   char *comment;		// Archive comment
@@ -228,6 +290,26 @@ public:
    */
   bool Flush ();
 
+  /**
+   * Set up \a stream to read the file \a entry from \a archiveData, which
+   * must contain the complete archive file (e.g. a memory mapping of it).
+   * Only the archive directory and \a archiveData are read, so this can be
+   * called from several threads simultaneously as long as the archive is
+   * not modified (by Flush()) at the same time. Returns false if the entry
+   * is broken or compressed with an unsupported method.
+   */
+  bool OpenEntryStream (void *entry, iDataBuffer* archiveData,
+    csArchiveEntryStream& stream) const;
+
+  /**
+   * Set whether Flush() should create a new archive file instead of
+   * overwriting the existing file. Enable this while the archive file is
+   * memory mapped: on systems that support it, the old contents stay
+   * accessible through the mapping.
+   */
+  void SetPreserveFileOnFlush (bool enable)
+  { preserveFile = enable; }
+
   /// Get Nth file in archive or 0
   void *GetFile (size_t no)
   { return (no < dir.GetSize ()) ? dir.Get (no) : 0; }
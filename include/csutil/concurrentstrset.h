@@ -0,0 +1,454 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSUTIL_CONCURRENTSTRSET_H__
+#define __CS_CSUTIL_CONCURRENTSTRSET_H__
+
+/**\file
+ * String-to-ID table with lock-free lookups.
+ */
+
+#include "csextern.h"
+#include "csutil/hashcomputer.h"
+#include "csutil/mempool.h"
+#include "csutil/noncopyable.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/mutex.h"
+#include "iutil/strset.h"
+
+namespace CS
+{
+namespace Utility
+{
+/**
+ * A string set which can be shared between threads, optimized for the case
+ * that most requests are for strings which are already in the set.
+ *
+ * The interface is the same as that of StringSet. Looking up strings and
+ * IDs never blocks: no lock is taken and no shared memory is written.
+ * Only adding and removing strings is serialized with a mutex.
+ *
+ * To achieve this, the string table is replaced as a whole when it grows,
+ * and the old tables as well as all stored strings are only freed when the
+ * set is destroyed. String pointers returned by Request() thus stay valid
+ * for the life time of the set, even across Delete() and Empty().
+ *
+ * \sa StringSet
+ */
+template<typename Tag>
+class ConcurrentStringSet : private CS::NonCopyable
+{
+private:
+  typedef CS::Threading::AtomicOperations Atomic;
+  typedef StringID<Tag> StringIDType;
+
+  /// An entry of the string table
+  struct Slot
+  {
+    /// The string; 0 for unused slots. Set last when filling a slot.
+    const char* str;
+    /// Hash of the string
+    uint32 hash;
+    /// ID of the string; the invalid ID if the string was deleted
+    int32 id;
+  };
+
+  /// Open addressing hash table of strings, with linear probing
+  struct Table
+  {
+    /// Next older retired table
+    Table* retired;
+    /// Number of slots - 1
+    size_t mask;
+    /// Number of slots with a string (including deleted ones)
+    size_t used;
+    Slot slots[1];
+  };
+
+  /// Number of entries in the first reverse mapping block
+  enum { reverseBaseSize = 64 };
+  /// Enough reverse mapping blocks to cover all 32 bit IDs
+  enum { maxReverseBlocks = 27 };
+
+  /**
+   * Current table. Writers only fill unused slots and change the IDs of
+   * existing slots; everything else requires replacing the table.
+   */
+  Table* table;
+  /// Replaced tables that may still be in use by readers
+  Table* retiredTables;
+  /**
+   * ID to string mapping. Block \c b contains the strings for
+   * <tt>reverseBaseSize << b</tt> consecutive IDs.
+   */
+  const char** reverse[maxReverseBlocks];
+  /// Storage for strings
+  csMemoryPool pool;
+  /// Serializes all modifications
+  CS::Threading::Mutex mutex;
+  size_t initialSize;
+  StringIDValue nextID;
+  int32 count;
+
+  static int32 InvalidID ()
+  {
+    return int32 (StringIDValue (CS::InvalidStringID<Tag> ()));
+  }
+
+  /// Make \a value visible to readers of \a target. Requires the mutex.
+  template<typename T>
+  static void Publish (T** target, T* value)
+  {
+    Atomic::CompareAndSet ((void**)target, (void*)value, (void*)*target);
+  }
+  static void Publish (int32* target, int32 value)
+  {
+    Atomic::CompareAndSet (target, value, *target);
+  }
+
+  template<typename T>
+  static T* Load (T* const* p)
+  {
+    return (T*)Atomic::ReadAcquire ((void* const*)p);
+  }
+
+  static Table* AllocTable (size_t capacity)
+  {
+    size_t size = sizeof (Table) + (capacity - 1) * sizeof (Slot);
+    Table* t = (Table*)cs_malloc (size);
+    memset (t, 0, size);
+    t->mask = capacity - 1;
+    return t;
+  }
+
+  /// Number of slots for a table holding \a n strings
+  static size_t CapacityForSize (size_t n)
+  {
+    size_t capacity = 16;
+    while (capacity < n * 2) capacity *= 2;
+    return capacity;
+  }
+
+  /// Find the slot of a string. Does not take the mutex.
+  static const Slot* FindSlot (const Table* t, const char* s, uint32 hash)
+  {
+    for (size_t i = hash & t->mask; ; i = (i + 1) & t->mask)
+    {
+      const Slot& slot = t->slots[i];
+      const char* str = Load (&slot.str);
+      if (str == 0) return 0;
+      if ((slot.hash == hash) && (strcmp (str, s) == 0)) return &slot;
+    }
+  }
+
+  static Slot* FindSlot (Table* t, const char* s, uint32 hash)
+  {
+    return const_cast<Slot*> (
+      FindSlot (const_cast<const Table*> (t), s, hash));
+  }
+
+  /// Find an unused slot for a string with the given hash
+  static Slot* FindFreeSlot (Table* t, uint32 hash)
+  {
+    size_t i = hash & t->mask;
+    while (t->slots[i].str != 0) i = (i + 1) & t->mask;
+    return &t->slots[i];
+  }
+
+  /// Ensure there is room for one more string. Requires the mutex.
+  void Reserve ()
+  {
+    if (!table)
+    {
+      Publish (&table, AllocTable (CapacityForSize (initialSize)));
+      return;
+    }
+    if ((table->used + 1) * 4 <= (table->mask + 1) * 3) return;
+
+    // Build a new table with the strings that were not deleted
+    Table* newTable = AllocTable (CapacityForSize (size_t (count) + 1));
+    for (size_t i = 0; i <= table->mask; i++)
+    {
+      const Slot& slot = table->slots[i];
+      if ((slot.str == 0) || (slot.id == InvalidID ())) continue;
+      *FindFreeSlot (newTable, slot.hash) = slot;
+      newTable->used++;
+    }
+    // Readers may still be using the old table, so keep it around
+    table->retired = retiredTables;
+    retiredTables = table;
+    Publish (&table, newTable);
+  }
+
+  /// Get the location of the reverse mapping for an ID
+  static bool LocateReverse (StringIDValue id, size_t& block, size_t& index)
+  {
+    size_t n = id / reverseBaseSize + 1;
+    block = 0;
+    while (n >>= 1) block++;
+    if (block >= maxReverseBlocks) return false;
+    index = id - reverseBaseSize * ((size_t (1) << block) - 1);
+    return true;
+  }
+
+  /// Set the reverse mapping for an ID. Requires the mutex.
+  void SetReverse (StringIDValue id, const char* str)
+  {
+    size_t block, index;
+    if (!LocateReverse (id, block, index)) return;
+    if (!reverse[block])
+    {
+      size_t size = (size_t (reverseBaseSize) << block) * sizeof (char*);
+      const char** newBlock = (const char**)cs_malloc (size);
+      memset (newBlock, 0, size);
+      Publish (&reverse[block], newBlock);
+    }
+    Publish (&reverse[block][index], str);
+  }
+
+  /// Remove the string in \a slot. Requires the mutex.
+  void DeleteSlot (Slot* slot)
+  {
+    SetReverse (StringIDValue (slot->id), 0);
+    Publish (&slot->id, InvalidID ());
+    Atomic::Decrement (&count);
+  }
+
+  /// Look up the ID of a string. Does not take the mutex.
+  StringIDType Lookup (const char* s) const
+  {
+    const Table* t = Load (&table);
+    if (!t) return CS::InvalidStringID<Tag> ();
+    const Slot* slot = FindSlot (t, s, csHashCompute (s));
+    if (!slot) return CS::InvalidStringID<Tag> ();
+    return StringIDValue (Atomic::ReadAcquire (&slot->id));
+  }
+
+public:
+  /**
+   * Iterator over the strings of a set.
+   * The set may be modified while iterating; strings added or deleted after
+   * the iterator was created may or may not be iterated over.
+   */
+  class GlobalIterator
+  {
+    friend class ConcurrentStringSet;
+
+    const Table* table;
+    size_t index;
+
+    GlobalIterator (const Table* table) : table (table), index (0)
+    {
+      Skip ();
+    }
+
+    /// Advance to the next string which was not deleted
+    void Skip ()
+    {
+      if (!table) return;
+      while ((index <= table->mask)
+          && ((Load (&table->slots[index].str) == 0)
+            || (Atomic::ReadAcquire (&table->slots[index].id) == InvalidID ())))
+        index++;
+    }
+  public:
+    /// Returns a boolean indicating whether or not the set has more elements.
+    bool HasNext () const
+    {
+      return table && (index <= table->mask);
+    }
+
+    /// Get the next string and its ID.
+    StringIDType Next (const char*& str)
+    {
+      const Slot& slot = table->slots[index++];
+      str = slot.str;
+      StringIDType id (StringIDValue (Atomic::ReadAcquire (&slot.id)));
+      Skip ();
+      return id;
+    }
+
+    /// Get the ID of the next string.
+    StringIDType Next ()
+    {
+      const char* str;
+      return Next (str);
+    }
+  };
+
+  /// Constructor.
+  ConcurrentStringSet (size_t size = 23) : table (0), retiredTables (0),
+    initialSize (size), nextID (0), count (0)
+  {
+    for (size_t b = 0; b < maxReverseBlocks; b++) reverse[b] = 0;
+  }
+
+  /// Destructor.
+  ~ConcurrentStringSet ()
+  {
+    cs_free (table);
+    while (retiredTables)
+    {
+      Table* next = retiredTables->retired;
+      cs_free (retiredTables);
+      retiredTables = next;
+    }
+    for (size_t b = 0; b < maxReverseBlocks; b++) cs_free (reverse[b]);
+  }
+
+  /**
+   * Request the numeric ID for the given string.
+   * \return The ID of the string.
+   * \remarks Creates a new ID if the string is not yet present in the set,
+   *   else returns the previously assigned ID.
+   */
+  StringIDType Request (const char* s)
+  {
+    StringIDType id = Lookup (s);
+    if (id != CS::InvalidStringID<Tag> ()) return id;
+
+    CS::Threading::MutexScopedLock lock (mutex);
+    uint32 hash = csHashCompute (s);
+    Slot* slot = table ? FindSlot (table, s, hash) : 0;
+    if (slot)
+    {
+      // Added by another thread in the mean time, or deleted before
+      if (slot->id != InvalidID ()) return StringIDValue (slot->id);
+      id = nextID++;
+      SetReverse (id, slot->str);
+      Publish (&slot->id, int32 (StringIDValue (id)));
+    }
+    else
+    {
+      Reserve ();
+      const char* str = pool.Store (s);
+      id = nextID++;
+      SetReverse (id, str);
+      slot = FindFreeSlot (table, hash);
+      slot->hash = hash;
+      slot->id = int32 (StringIDValue (id));
+      Publish (&slot->str, str);
+      table->used++;
+    }
+    Atomic::Increment (&count);
+    return id;
+  }
+
+  /**
+   * Request the string corresponding to the given ID.
+   * \return Null if the string * has not been requested (yet), else the string
+   *   corresponding to the ID.
+   */
+  char const* Request (StringIDType id) const
+  {
+    size_t block, index;
+    if ((id == CS::InvalidStringID<Tag> ())
+        || !LocateReverse (id, block, index))
+      return 0;
+    const char* const* blockPtr = Load (&reverse[block]);
+    return blockPtr ? Load (&blockPtr[index]) : 0;
+  }
+
+  /**
+   * Check if the set contains a particular string.
+   */
+  bool Contains (char const* s) const
+  { return Lookup (s) != CS::InvalidStringID<Tag> (); }
+
+  /**
+   * Check if the set contains a string with a particular ID.
+   * \remarks This is rigidly equivalent to
+   *   <tt>return Request(id) != NULL</tt>, but more idomatic.
+   */
+  bool Contains (StringIDType id) const
+  { return Request (id) != 0; }
+
+  /**
+   * Remove specified string.
+   * \return True if a matching string was in thet set; else false.
+   */
+  bool Delete (char const* s)
+  {
+    CS::Threading::MutexScopedLock lock (mutex);
+    Slot* slot = table ? FindSlot (table, s, csHashCompute (s)) : 0;
+    if (!slot || (slot->id == InvalidID ())) return false;
+    DeleteSlot (slot);
+    return true;
+  }
+
+  /**
+   * Remove a string with the specified ID.
+   * \return True if a matching string was in thet set; else false.
+   */
+  bool Delete (StringIDType id)
+  {
+    CS::Threading::MutexScopedLock lock (mutex);
+    const char* s = Request (id);
+    if (!s) return false;
+    DeleteSlot (FindSlot (table, s, csHashCompute (s)));
+    return true;
+  }
+
+  /**
+   * Remove all stored strings. When new strings are registered again, new
+   * ID values will be used; the old ID's will not be re-used.
+   * \remarks The memory used by the strings is not freed until the set is
+   *   destroyed.
+   */
+  void Empty ()
+  {
+    CS::Threading::MutexScopedLock lock (mutex);
+    if (table)
+    {
+      table->retired = retiredTables;
+      retiredTables = table;
+      Publish (&table, (Table*)0);
+    }
+    for (size_t b = 0; b < maxReverseBlocks; b++)
+    {
+      if (!reverse[b]) continue;
+      for (size_t i = 0; i < (size_t (reverseBaseSize) << b); i++)
+      {
+        if (reverse[b][i]) Publish (&reverse[b][i], (const char*)0);
+      }
+    }
+    Atomic::Set (&count, 0);
+  }
+
+  /// Get the number of elements in the hash.
+  size_t GetSize () const
+  { return size_t (Atomic::ReadAcquire (&count)); }
+
+  /**
+   * Return true if the hash is empty.
+   * \remarks Rigidly equivalent to <tt>return GetSize() == 0</tt>, but more
+   *   idiomatic.
+   */
+  bool IsEmpty () const
+  { return GetSize () == 0; }
+
+  /**
+   * Return an iterator for the set which iterates over all strings.
+   */
+  GlobalIterator GetIterator () const
+  { return GlobalIterator (Load (&table)); }
+};
+} // namespace Utility
+} // namespace CS
+
+#endif // __CS_CSUTIL_CONCURRENTSTRSET_H__
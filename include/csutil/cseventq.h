@@ -33,6 +33,7 @@
 #include "csextern.h"
 
 #include "csutil/array.h"
+#include "csutil/flathash.h"
 #include "csutil/hash.h"
 #include "csutil/ref.h"
 #include "csutil/refarr.h"
@@ -89,11 +90,11 @@ private:
   // of this.
   csEventTree *EventTree;
   // Shortcut to per-event-name delivery queues.
-  csHash<csEventTree *,csEventID> EventHash;
+  csFlatHash<csEventTree *,csEventID> EventHash;
   // Array of allocated event outlets.
   csArray<csEventOutlet*> EventOutlets;
   // Array of allocated event cords.
-  csHash<csRef<csEventCord>, csEventID> EventCords;
+  csFlatHash<csRef<csEventCord>, csEventID> EventCords;
   // Pool of event objects
   csPoolEvent* EventPool;
   /// Registered event handler (used for proper cleanup in RemoveAllListeners())
@@ -60,6 +60,15 @@ public:
     const CapacityHandler& ch = CapacityHandler())
     : csArray<T, ElementHandler, MemoryAllocator, CapacityHandler> (
       in_capacity, ch) {}
+  /**
+   * Initialize object to have initial capacity of \c in_capacity elements
+   * and with specific memory allocator and capacity handler initializations.
+   */
+  csDirtyAccessArray (size_t in_capacity,
+    const MemoryAllocator& alloc,
+    const CapacityHandler& ch)
+    : csArray<T, ElementHandler, MemoryAllocator, CapacityHandler> (
+      in_capacity, alloc, ch) {}
 
   /// Get the pointer to the start of the array.
   T* GetArray ()
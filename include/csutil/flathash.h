@@ -0,0 +1,864 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_UTIL_FLATHASH_H__
+#define __CS_UTIL_FLATHASH_H__
+
+/**\file
+ * A hash table with open addressing
+ */
+
+#include "csextern.h"
+#include "csgeom/math.h"
+#include "csutil/array.h"
+#include "csutil/comparator.h"
+#include "csutil/tuple.h"
+#include "csutil/hashcomputer.h"
+
+#include "csutil/custom_new_disable.h"
+#include <new>
+#include "csutil/custom_new_enable.h"
+
+/**\addtogroup util_containers
+ * @{ */
+
+/**
+ * A hash table with open addressing, storing all elements in one flat
+ * array.
+ *
+ * Collisions are resolved with linear probing; on insertion, elements far
+ * away from their preferred slot take precedence over elements close to it
+ * ("Robin Hood hashing"), which keeps probe sequences short even at high
+ * load. Next to every slot the (scrambled) hash value of the key is stored,
+ * so most mismatches are rejected without comparing keys. Compared to
+ * csHash, a lookup touches one or two cache lines instead of a bucket array
+ * and a separately allocated bucket, and growing the table only needs one
+ * allocation.
+ *
+ * The interface is the same as that of csHash, so csFlatHash can replace a
+ * csHash by changing a typedef. Like csHash, keys are hashed with
+ * csHashComputer<> and compared with csComparator<>, and multiple values can
+ * be stored for one key. However, values are stored in-place, so adding
+ * elements moves the existing elements; pointers and references to values
+ * are only valid until the next insertion.
+ *
+ * Keys and values must be copy-constructible. Like csArray, elements are
+ * moved around in memory with memcpy().
+ */
+template <class T, class K = unsigned int,
+  class MemoryAlloc = CS::Memory::AllocatorMalloc>
+class csFlatHash
+{
+public:
+  typedef csFlatHash<T, K, MemoryAlloc> ThisType;
+  typedef T ValueType;
+  typedef K KeyType;
+  typedef MemoryAlloc AllocatorType;
+
+protected:
+  struct Element
+  {
+    K key;
+    T value;
+
+    Element (const K& key, const T& value) : key (key), value (value) {}
+  };
+
+  /// Allocator for the table memory; also holds the table pointers
+  struct TableAlloc : public MemoryAlloc
+  {
+    /// Scrambled hash of each slot, 0 for empty slots
+    uint32* hashes;
+    /// Elements, only constructed for non-empty slots
+    Element* elements;
+
+    TableAlloc () : hashes (0), elements (0) {}
+  } table;
+  /// Number of slots (a power of two) or 0 if no table is allocated
+  size_t capacity;
+  /// capacity - 1
+  size_t mask;
+  /// Shift to get a slot index from a scrambled hash
+  uint shift;
+  size_t size;
+  size_t initCapacity;
+
+  /// Maximum load is loadNumerator/loadDenominator of the capacity
+  enum { loadNumerator = 7, loadDenominator = 8, minCapacity = 8 };
+
+  static uint32 ScrambleHash (const K& key)
+  {
+    /* Fibonacci hashing: spreads the bits of weak hashes (e.g. integers or
+       pointers) into the high bits, which select the slot. 0 marks empty
+       slots. */
+    uint32 h = uint32 (csHashComputer<K>::ComputeHash (key)) * 2654435769u;
+    return h ? h : 1;
+  }
+
+  size_t HomeSlot (uint32 h) const
+  {
+    return size_t (h >> shift);
+  }
+
+  /// Distance of the element in \a slot from its preferred slot
+  size_t ProbeDistance (size_t slot) const
+  {
+    return (slot - HomeSlot (table.hashes[slot])) & mask;
+  }
+
+  /// Move an element from \a src to the unconstructed slot \a dst
+  static void Relocate (Element* dst, const Element* src)
+  {
+    memcpy ((void*)dst, (const void*)src, sizeof (Element));
+  }
+
+  static size_t CapacityForSize (size_t n)
+  {
+    size_t cap = minCapacity;
+    while (cap * loadNumerator < n * loadDenominator)
+      cap *= 2;
+    return cap;
+  }
+
+  void Allocate (size_t newCapacity)
+  {
+    /* One allocation for the hashes and the elements. The capacity is at
+       least 8, so the element array is at least 32 bytes aligned relative
+       to the start of the block. */
+    uint8* block = (uint8*)table.Alloc (
+      newCapacity * (sizeof (uint32) + sizeof (Element)));
+    table.hashes = (uint32*)block;
+    table.elements = (Element*)(block + newCapacity * sizeof (uint32));
+    memset (table.hashes, 0, newCapacity * sizeof (uint32));
+    capacity = newCapacity;
+    mask = newCapacity - 1;
+    shift = 32;
+    for (size_t c = newCapacity; c > 1; c >>= 1) shift--;
+  }
+
+  void FreeTable ()
+  {
+    if (!table.hashes) return;
+    for (size_t i = 0; i < capacity; i++)
+    {
+      if (table.hashes[i] != 0) table.elements[i].~Element ();
+    }
+    table.Free (table.hashes);
+    table.hashes = 0;
+    table.elements = 0;
+    capacity = 0;
+    mask = 0;
+  }
+
+  void Rehash (size_t newCapacity)
+  {
+    uint32* oldHashes = table.hashes;
+    Element* oldElements = table.elements;
+    size_t oldCapacity = capacity;
+
+    Allocate (newCapacity);
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+      if (oldHashes[i] == 0) continue;
+      Element* slot = PlaceElement (oldHashes[i]);
+      Relocate (slot, &oldElements[i]);
+    }
+    if (oldHashes) table.Free (oldHashes);
+  }
+
+  /// Ensure there is room for one more element
+  void Reserve ()
+  {
+    if (capacity == 0)
+      Allocate (CapacityForSize (csMax (initCapacity, size_t (1))));
+    else if ((size + 1) * loadDenominator > capacity * loadNumerator)
+      Rehash (capacity * 2);
+  }
+
+  /**
+   * Make room for an element with scrambled hash \a h, following the Robin
+   * Hood rule. There must be room for it. Returns the (unconstructed) slot
+   * for the new element.
+   */
+  Element* PlaceElement (uint32 h)
+  {
+    size_t slot = HomeSlot (h);
+    size_t dist = 0;
+    while ((table.hashes[slot] != 0) && (ProbeDistance (slot) >= dist))
+    {
+      slot = (slot + 1) & mask;
+      dist++;
+    }
+    if (table.hashes[slot] != 0)
+    {
+      /* Take the slot from a "richer" element; shift the following elements
+         up to the next empty slot along by one. This keeps the Robin Hood
+         ordering since each of them moves one slot further away from its
+         preferred slot. */
+      size_t empty = (slot + 1) & mask;
+      while (table.hashes[empty] != 0) empty = (empty + 1) & mask;
+      while (empty != slot)
+      {
+        size_t prev = (empty - 1) & mask;
+        Relocate (&table.elements[empty], &table.elements[prev]);
+        table.hashes[empty] = table.hashes[prev];
+        empty = prev;
+      }
+    }
+    table.hashes[slot] = h;
+    return &table.elements[slot];
+  }
+
+  /**
+   * Insert an element with scrambled hash \a h. There must be room for it.
+   * Returns the slot of the new element.
+   */
+  size_t InsertElement (uint32 h, const K& key, const T& value)
+  {
+    Element* slot = PlaceElement (h);
+    new (slot) Element (key, value);
+    return slot - table.elements;
+  }
+
+  /// Find the slot of the first element with \a key at or after \a slot
+  size_t FindSlot (const K& key, uint32 h, size_t slot) const
+  {
+    size_t dist = (slot - HomeSlot (h)) & mask;
+    while (true)
+    {
+      uint32 slotHash = table.hashes[slot];
+      // An element with the key can't be beyond a "richer" element
+      if ((slotHash == 0) || (ProbeDistance (slot) < dist))
+        return csArrayItemNotFound;
+      if ((slotHash == h)
+          && (csComparator<K, K>::Compare (table.elements[slot].key, key) == 0))
+        return slot;
+      slot = (slot + 1) & mask;
+      dist++;
+    }
+  }
+
+  size_t FindSlot (const K& key) const
+  {
+    if (size == 0) return csArrayItemNotFound;
+    uint32 h = ScrambleHash (key);
+    return FindSlot (key, h, HomeSlot (h));
+  }
+
+  /// Remove the element in \a slot, moving following elements back
+  void RemoveSlot (size_t slot)
+  {
+    table.elements[slot].~Element ();
+    size_t next = (slot + 1) & mask;
+    while ((table.hashes[next] != 0) && (ProbeDistance (next) != 0))
+    {
+      Relocate (&table.elements[slot], &table.elements[next]);
+      table.hashes[slot] = table.hashes[next];
+      slot = next;
+      next = (next + 1) & mask;
+    }
+    table.hashes[slot] = 0;
+    size--;
+  }
+
+  /// Find an empty slot. Requires a table.
+  size_t FindEmptySlot () const
+  {
+    size_t slot = 0;
+    while (table.hashes[slot] != 0) slot++;
+    return slot;
+  }
+
+  void CopyFrom (const csFlatHash& other)
+  {
+    initCapacity = other.initCapacity;
+    if (other.size == 0) return;
+    Allocate (other.capacity);
+    for (size_t i = 0; i < capacity; i++)
+    {
+      table.hashes[i] = other.table.hashes[i];
+      if (table.hashes[i] != 0)
+        new (&table.elements[i]) Element (other.table.elements[i]);
+    }
+    size = other.size;
+  }
+
+public:
+  /**
+   * Construct a hash table with room for \a initSize elements before
+   * growing.
+   * \a grow_rate and \a max_size are accepted for compatibility with csHash
+   * and ignored; the table always keeps a load of at most 7/8.
+   */
+  csFlatHash (size_t initSize = 23, size_t grow_rate = 5,
+    size_t max_size = 20000)
+    : capacity (0), mask (0), shift (32), size (0), initCapacity (initSize)
+  {
+    (void)grow_rate; (void)max_size;
+  }
+
+  /// Copy constructor.
+  csFlatHash (const csFlatHash& other)
+    : capacity (0), mask (0), shift (32), size (0), initCapacity (0)
+  {
+    CopyFrom (other);
+  }
+
+  ~csFlatHash ()
+  {
+    FreeTable ();
+  }
+
+  /// Assignment operator.
+  csFlatHash& operator= (const csFlatHash& other)
+  {
+    if (&other != this)
+    {
+      DeleteAll ();
+      CopyFrom (other);
+    }
+    return *this;
+  }
+
+  /**
+   * Add an element to the hash table.
+   * \remarks If \a key is already present, does NOT replace the existing value,
+   *   but merely adds \a value as an additional value of \a key. To retrieve all
+   *   values for a given key, use GetAll(). If you instead want to replace an
+   *   existing value for \a key, use PutUnique().
+   */
+  T& Put (const K& key, const T &value)
+  {
+    Reserve ();
+    size_t slot = InsertElement (ScrambleHash (key), key, value);
+    size++;
+    return table.elements[slot].value;
+  }
+
+  /// Get all the elements, or empty if there are none.
+  csArray<T> GetAll () const
+  {
+    csArray<T> ret (size);
+    for (size_t i = 0; i < capacity; i++)
+    {
+      if (table.hashes[i] != 0) ret.Push (table.elements[i].value);
+    }
+    return ret;
+  }
+
+  /// Get all the elements with the given key, or empty if there are none.
+  csArray<T> GetAll (const K& key) const
+  {
+    return GetAll<typename csArray<T>::ElementHandlerType,
+      typename csArray<T>::AllocatorType> (key);
+  }
+
+  /// Get all the elements with the given key, or empty if there are none.
+  template<typename H, typename M>
+  csArray<T, H, M> GetAll (const K& key) const
+  {
+    csArray<T, H, M> ret;
+    ConstIterator it (GetIterator (key));
+    while (it.HasNext ())
+      ret.Push (it.Next ());
+    return ret;
+  }
+
+  /// Add an element to the hash table, overwriting if the key already exists.
+  T& PutUnique (const K& key, const T &value)
+  {
+    size_t slot = FindSlot (key);
+    if (slot != csArrayItemNotFound)
+    {
+      table.elements[slot].value = value;
+      return table.elements[slot].value;
+    }
+    return Put (key, value);
+  }
+
+  /// Returns whether at least one element matches the given key.
+  bool Contains (const K& key) const
+  {
+    return FindSlot (key) != csArrayItemNotFound;
+  }
+
+  /**
+   * Returns whether at least one element matches the given key.
+   * \remarks This is rigidly equivalent to Contains(key), but may be
+   *   considered more idiomatic by some.
+   */
+  bool In (const K& key) const
+  { return Contains(key); }
+
+  /**
+   * Get a pointer to the first element matching the given key,
+   * or 0 if there is none.
+   */
+  const T* GetElementPointer (const K& key) const
+  {
+    size_t slot = FindSlot (key);
+    return (slot != csArrayItemNotFound) ? &table.elements[slot].value : 0;
+  }
+
+  /**
+   * Get a pointer to the first element matching the given key,
+   * or 0 if there is none.
+   */
+  T* GetElementPointer (const K& key)
+  {
+    size_t slot = FindSlot (key);
+    return (slot != csArrayItemNotFound) ? &table.elements[slot].value : 0;
+  }
+
+  /**
+   * h["key"] shorthand notation for h.GetElementPointer ("key")
+   */
+  T* operator[] (const K& key)
+  {
+    return GetElementPointer (key);
+  }
+
+  /**
+   * Get the first element matching the given key, or \a fallback if there is
+   * none.
+   */
+  const T& Get (const K& key, const T& fallback) const
+  {
+    size_t slot = FindSlot (key);
+    return (slot != csArrayItemNotFound) ? table.elements[slot].value
+      : fallback;
+  }
+
+  /**
+   * Get the first element matching the given key, or \a fallback if there is
+   * none.
+   */
+  T& Get (const K& key, T& fallback)
+  {
+    size_t slot = FindSlot (key);
+    return (slot != csArrayItemNotFound) ? table.elements[slot].value
+      : fallback;
+  }
+
+  /**
+   * Get the first element matching the given key, or, if there is
+   * none, insert \a default and return a reference to the new entry.
+   */
+  T& GetOrCreate (const K& key, const T& defaultValue = T())
+  {
+    size_t slot = FindSlot (key);
+    if (slot != csArrayItemNotFound) return table.elements[slot].value;
+    return Put (key, defaultValue);
+  }
+
+  /// Delete all the elements.
+  void DeleteAll ()
+  {
+    FreeTable ();
+    size = 0;
+  }
+
+  /// Delete all the elements. (Idiomatic alias for DeleteAll().)
+  void Empty() { DeleteAll(); }
+
+  /// Delete all the elements matching the given key.
+  bool DeleteAll (const K& key)
+  {
+    if (size == 0) return false;
+    uint32 h = ScrambleHash (key);
+    size_t slot = FindSlot (key, h, HomeSlot (h));
+    if (slot == csArrayItemNotFound) return false;
+    do
+    {
+      // Following elements move back into the slot, so search from there
+      RemoveSlot (slot);
+      slot = FindSlot (key, h, slot);
+    }
+    while (slot != csArrayItemNotFound);
+    return true;
+  }
+
+  /// Delete all the elements matching the given key and value.
+  bool Delete (const K& key, const T &value)
+  {
+    if (size == 0) return false;
+    bool ret = false;
+    uint32 h = ScrambleHash (key);
+    size_t slot = FindSlot (key, h, HomeSlot (h));
+    while (slot != csArrayItemNotFound)
+    {
+      if (csComparator<T, T>::Compare (table.elements[slot].value, value) == 0)
+      {
+        RemoveSlot (slot);
+        ret = true;
+      }
+      else
+        slot = (slot + 1) & mask;
+      slot = FindSlot (key, h, slot);
+    }
+    return ret;
+  }
+
+  /// Get the number of elements in the hash.
+  size_t GetSize () const
+  {
+    return size;
+  }
+
+  /**
+   * Return true if the hash is empty.
+   * \remarks Rigidly equivalent to <tt>return GetSize() == 0</tt>, but more
+   *   idiomatic.
+   */
+  bool IsEmpty() const
+  {
+    return GetSize() == 0;
+  }
+
+  /// An iterator class for the csFlatHash class.
+  class Iterator
+  {
+  private:
+    csFlatHash* hash;
+    K key;
+    uint32 h;
+    size_t slot;
+
+  protected:
+    Iterator (csFlatHash* hash0, const K& key0) : hash (hash0), key (key0),
+      h (ScrambleHash (key0))
+    { Reset (); }
+
+    friend class csFlatHash;
+  public:
+    /// Returns a boolean indicating whether or not the hash has more elements.
+    bool HasNext () const
+    {
+      return slot != csArrayItemNotFound;
+    }
+
+    /// Get the next element's value.
+    T& Next ()
+    {
+      T& ret = hash->table.elements[slot].value;
+      slot = hash->FindSlot (key, h, (slot + 1) & hash->mask);
+      return ret;
+    }
+
+    /// Move the iterator back to the first element.
+    void Reset ()
+    {
+      slot = (hash->size > 0)
+        ? hash->FindSlot (key, h, hash->HomeSlot (h)) : csArrayItemNotFound;
+    }
+  };
+  friend class Iterator;
+
+  /**
+   * An iterator class for the csFlatHash class.
+   * The iteration starts after an empty slot and wraps around the table;
+   * as elements are only moved back up to an empty slot on deletion,
+   * DeleteElement() never moves an element that was already visited.
+   */
+  class GlobalIterator
+  {
+  private:
+    csFlatHash* hash;
+    /// Empty slot the iteration starts after
+    size_t start;
+    /// Number of slots visited
+    size_t visited;
+
+    size_t Slot () const
+    { return (start + 1 + visited) & hash->mask; }
+
+    void FindItem ()
+    {
+      while ((visited < hash->capacity) && (hash->table.hashes[Slot ()] == 0))
+        visited++;
+    }
+
+  protected:
+    GlobalIterator (csFlatHash* hash0) : hash (hash0)
+    { Reset (); }
+
+    friend class csFlatHash;
+  public:
+    /// Empty constructor.
+    GlobalIterator () : hash (0), start (0), visited (0) {}
+
+    /// Returns a boolean indicating whether or not the hash has more elements.
+    bool HasNext () const
+    {
+      return hash && (visited < hash->capacity);
+    }
+
+    /// Advance the iterator of one step
+    void Advance ()
+    {
+      visited++;
+      FindItem ();
+    }
+
+    /// Get the next element's value, don't move the iterator.
+    T& NextNoAdvance ()
+    {
+      return hash->table.elements[Slot ()].value;
+    }
+
+    /// Get the next element's value.
+    T& Next ()
+    {
+      T &ret = NextNoAdvance ();
+      Advance ();
+      return ret;
+    }
+
+    /// Get the next element's value and key, don't move the iterator.
+    T& NextNoAdvance (K &key)
+    {
+      key = hash->table.elements[Slot ()].key;
+      return NextNoAdvance ();
+    }
+
+    /// Get the next element's value and key.
+    T& Next (K &key)
+    {
+      key = hash->table.elements[Slot ()].key;
+      return Next ();
+    }
+
+    /// Return a tuple of the value and key.
+    const csTuple2<T, K> NextTuple ()
+    {
+      const Element& e = hash->table.elements[Slot ()];
+      csTuple2<T, K> t (e.value, e.key);
+      Advance ();
+      return t;
+    }
+
+    /// Move the iterator back to the first element.
+    void Reset ()
+    {
+      visited = 0;
+      if (hash->size == 0)
+      {
+        start = 0;
+        visited = hash->capacity;
+        return;
+      }
+      start = hash->FindEmptySlot ();
+      FindItem ();
+    }
+  };
+  friend class GlobalIterator;
+
+  /// A const iterator class for the csFlatHash class.
+  class ConstIterator
+  {
+  private:
+    const csFlatHash* hash;
+    K key;
+    uint32 h;
+    size_t slot;
+
+  protected:
+    ConstIterator (const csFlatHash* hash0, const K& key0) : hash (hash0),
+      key (key0), h (ScrambleHash (key0))
+    { Reset (); }
+
+    friend class csFlatHash;
+  public:
+    /// Returns a boolean indicating whether or not the hash has more elements.
+    bool HasNext () const
+    {
+      return slot != csArrayItemNotFound;
+    }
+
+    /// Get the next element's value.
+    const T& Next ()
+    {
+      const T& ret = hash->table.elements[slot].value;
+      slot = hash->FindSlot (key, h, (slot + 1) & hash->mask);
+      return ret;
+    }
+
+    /// Move the iterator back to the first element.
+    void Reset ()
+    {
+      slot = (hash->size > 0)
+        ? hash->FindSlot (key, h, hash->HomeSlot (h)) : csArrayItemNotFound;
+    }
+  };
+  friend class ConstIterator;
+
+  /// A const iterator class for the csFlatHash class.
+  class ConstGlobalIterator
+  {
+  private:
+    const csFlatHash* hash;
+    size_t start;
+    size_t visited;
+
+    size_t Slot () const
+    { return (start + 1 + visited) & hash->mask; }
+
+    void FindItem ()
+    {
+      while ((visited < hash->capacity) && (hash->table.hashes[Slot ()] == 0))
+        visited++;
+    }
+
+  protected:
+    ConstGlobalIterator (const csFlatHash* hash0) : hash (hash0)
+    { Reset (); }
+
+    friend class csFlatHash;
+  public:
+    /// Empty constructor.
+    ConstGlobalIterator () : hash (0), start (0), visited (0) {}
+
+    /// Returns a boolean indicating whether or not the hash has more elements.
+    bool HasNext () const
+    {
+      return hash && (visited < hash->capacity);
+    }
+
+    /// Advance the iterator of one step
+    void Advance ()
+    {
+      visited++;
+      FindItem ();
+    }
+
+    /// Get the next element's value, don't move the iterator.
+    const T& NextNoAdvance ()
+    {
+      return hash->table.elements[Slot ()].value;
+    }
+
+    /// Get the next element's value.
+    const T& Next ()
+    {
+      const T &ret = NextNoAdvance ();
+      Advance ();
+      return ret;
+    }
+
+    /// Get the next element's value and key, don't move the iterator.
+    const T& NextNoAdvance (K &key)
+    {
+      key = hash->table.elements[Slot ()].key;
+      return NextNoAdvance ();
+    }
+
+    /// Get the next element's value and key.
+    const T& Next (K &key)
+    {
+      key = hash->table.elements[Slot ()].key;
+      return Next ();
+    }
+
+    /// Return a tuple of the value and key.
+    const csTuple2<T, K> NextTuple ()
+    {
+      const Element& e = hash->table.elements[Slot ()];
+      csTuple2<T, K> t (e.value, e.key);
+      Advance ();
+      return t;
+    }
+
+    /// Move the iterator back to the first element.
+    void Reset ()
+    {
+      visited = 0;
+      if (hash->size == 0)
+      {
+        start = 0;
+        visited = hash->capacity;
+        return;
+      }
+      start = hash->FindEmptySlot ();
+      FindItem ();
+    }
+  };
+  friend class ConstGlobalIterator;
+
+  /// Delete the element pointed by the iterator. This is safe for this
+  /// iterator, not for the others.
+  void DeleteElement (GlobalIterator& iterator)
+  {
+    // Following elements move back into the slot, so don't advance
+    RemoveSlot (iterator.Slot ());
+    iterator.FindItem ();
+  }
+
+  /// Delete the element pointed by the iterator. This is safe for this
+  /// iterator, not for the others.
+  void DeleteElement (ConstGlobalIterator& iterator)
+  {
+    RemoveSlot (iterator.Slot ());
+    iterator.FindItem ();
+  }
+
+  /**
+   * Return an iterator for the hash, to iterate only over the elements
+   * with the given key.
+   * \warning Modifying the hash (except with DeleteElement()) while you have
+   *   open iterators will result in undefined behaviour.
+   */
+  Iterator GetIterator (const K& key)
+  {
+    return Iterator (this, key);
+  }
+
+  /**
+   * Return an iterator for the hash, to iterate over all elements.
+   * \warning Modifying the hash (except with DeleteElement()) while you have
+   *   open iterators will result in undefined behaviour.
+   */
+  GlobalIterator GetIterator ()
+  {
+    return GlobalIterator (this);
+  }
+
+  /**
+   * Return a const iterator for the hash, to iterate only over the elements
+   * with the given key.
+   * \warning Modifying the hash (except with DeleteElement()) while you have
+   *   open iterators will result in undefined behaviour.
+   */
+  ConstIterator GetIterator (const K& key) const
+  {
+    return ConstIterator (this, key);
+  }
+
+  /**
+   * Return a const iterator for the hash, to iterate over all elements.
+   * \warning Modifying the hash (except with DeleteElement()) while you have
+   *   open iterators will result in undefined behaviour.
+   */
+  ConstGlobalIterator GetIterator () const
+  {
+    return ConstGlobalIterator (this);
+  }
+};
+
+/** @} */
+
+#endif // __CS_UTIL_FLATHASH_H__
@@ -0,0 +1,158 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSUTIL_LINEARARENA_H__
+#define __CS_CSUTIL_LINEARARENA_H__
+
+/**\file
+ * Linear allocator for data with a common life time
+ */
+
+#include "cssysdef.h"
+#include "csextern.h"
+
+/**\addtogroup util_memory
+ * @{ */
+
+namespace CS
+{
+  namespace Memory
+  {
+    /**
+     * Linear ("bump pointer") allocator for data that is freed all at once,
+     * e.g. data only needed during one frame.
+     *
+     * Allocations are carved out of large blocks; Free() only reclaims the
+     * most recent allocation and Reset() makes the whole memory available
+     * again. If a period between two resets needed more than one block, the
+     * blocks are merged into one on Reset(), so in the steady state no
+     * further heap allocations are made.
+     *
+     * The arena does not run constructors or destructors and is not
+     * thread-safe.
+     */
+    class CS_CRYSTALSPACE_EXPORT LinearArena
+    {
+    public:
+      /// Alignment of all allocations
+      enum { alignment = 16 };
+
+      /**
+       * Construct. \a blockSize is the size of the first block, allocated
+       * with the first allocation.
+       */
+      LinearArena (size_t blockSize = 64*1024);
+      ~LinearArena ();
+
+      /// Allocate \a size bytes.
+      CS_ATTRIBUTE_MALLOC void* Alloc (size_t size);
+      /**
+       * Resize an allocation. This only succeeds if \a p is the most recent
+       * allocation and the new size fits into the current block; otherwise
+       * 0 is returned and \a p stays valid.
+       */
+      void* Realloc (void* p, size_t newSize);
+      /**
+       * Free an allocation. The memory is only reused before the next
+       * Reset() if \a p is the most recent allocation.
+       */
+      void Free (void* p);
+
+      /**
+       * Free all allocations at once. Also records the number of bytes used
+       * since the last reset, see GetLastUsedBytes().
+       */
+      void Reset ();
+
+      /// Get the number of bytes allocated since the last reset
+      size_t GetUsedBytes () const { return usedBytes; }
+      /// Get the number of bytes allocated between the last two resets
+      size_t GetLastUsedBytes () const { return lastUsedBytes; }
+      /// Get the largest number of bytes allocated between two resets
+      size_t GetPeakUsedBytes () const { return peakUsedBytes; }
+      /// Get the number of bytes reserved from the heap
+      size_t GetCapacity () const { return capacity; }
+    private:
+      struct Block
+      {
+        Block* next;
+        size_t size;
+      };
+      /// Most recently allocated block, start of the block list
+      Block* blocks;
+      /// Start of free space in the current block
+      uint8* top;
+      /// End of the current block
+      uint8* end;
+      /// Most recent allocation
+      uint8* lastAlloc;
+
+      size_t blockSize;
+      size_t capacity;
+      size_t usedBytes;
+      size_t lastUsedBytes;
+      size_t peakUsedBytes;
+
+      /// Add a block with room for at least \a size bytes
+      void NewBlock (size_t size);
+      /// Free all blocks
+      void FreeBlocks ();
+      /// Get start of the usable memory of a block
+      static uint8* BlockStart (Block* block);
+    };
+
+    /**
+     * Memory allocator for containers, allocating from a LinearArena.
+     * A default constructed allocator uses the heap instead.
+     * \remarks Use a container with exponential growth, e.g. with
+     *   CS::Container::ArrayCapacityExponential, as memory released by
+     *   resizing is generally not reused before the arena is reset.
+     */
+    class AllocatorLinearArena
+    {
+      LinearArena* arena;
+    public:
+      AllocatorLinearArena () : arena (0) {}
+      explicit AllocatorLinearArena (LinearArena* arena) : arena (arena) {}
+
+      /// Allocate a block of memory of size \p n.
+      CS_ATTRIBUTE_MALLOC void* Alloc (const size_t n)
+      { return arena ? arena->Alloc (n) : cs_malloc (n); }
+      /// Free the block \p p.
+      void Free (void* p)
+      {
+        if (arena)
+          arena->Free (p);
+        else
+          cs_free (p);
+      }
+      /// Resize the allocated block \p p to size \p newSize.
+      void* Realloc (void* p, size_t newSize)
+      { return arena ? arena->Realloc (p, newSize) : cs_realloc (p, newSize); }
+      /// Set the information used for memory tracking.
+      void SetMemTrackerInfo (const char* info)
+      {
+        (void)info;
+      }
+    };
+  } // namespace Memory
+} // namespace CS
+
+/** @} */
+
+#endif // __CS_CSUTIL_LINEARARENA_H__
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSUTIL_PARALLELFOR_H__
+#define __CS_CSUTIL_PARALLELFOR_H__
+
+/**\file
+ * Data parallel loops on a job queue
+ */
+
+#include "csextern.h"
+#include "csutil/ref.h"
+#include "csutil/refcount.h"
+#include "iutil/job.h"
+
+struct iObjectRegistry;
+
+namespace CS
+{
+namespace Threading
+{
+  /**
+   * Get the job queue shared by the parallel loops of all modules, creating
+   * it on the first call. Sharing one queue keeps the number of threads from
+   * growing with the number of modules (or module instances) running loops
+   * in parallel. The queue is kept in the object registry under the tag
+   * "crystalspace.jobqueue.parallelfor" and has one worker thread per
+   * processor besides the thread running a loop.
+   * \param objectReg Object registry.
+   * \param numWorkers Receives the number of worker threads of the queue.
+   * \return The queue, or 0 on single processor machines.
+   */
+  CS_CRYSTALSPACE_EXPORT csRef<iJobQueue> GetParallelForJobQueue (
+    iObjectRegistry* objectReg, size_t& numWorkers);
+
+  /**
+   * Type independent part of ParallelFor(). Jobs keep the loop alive: a job
+   * only starting after Run() returned finds no chunks left and never calls
+   * ProcessRange().
+   */
+  class CS_CRYSTALSPACE_EXPORT ParallelForBase :
+    public CS::Utility::AtomicRefCount
+  {
+  public:
+    ParallelForBase (size_t numItems, size_t chunkSize);
+    virtual ~ParallelForBase ();
+
+    /**
+     * Process all chunks, spread over up to \a numWorkers jobs on
+     * \a jobQueue and the calling thread. Returns when all chunks are
+     * processed.
+     */
+    void Run (iJobQueue* jobQueue, size_t numWorkers);
+  protected:
+    /// Process the items from \a first up to, but not including, \a last.
+    virtual void ProcessRange (size_t first, size_t last) = 0;
+  private:
+    class Job;
+
+    size_t numItems;
+    size_t chunkSize;
+    int32 numChunks;
+    int32 nextChunk;
+    int32 chunksDone;
+
+    void ProcessChunks ();
+  };
+
+  /// ParallelFor() loop calling a functor.
+  template<typename Fn>
+  class ParallelForFunctor : public ParallelForBase
+  {
+    Fn* function;
+  public:
+    ParallelForFunctor (Fn& fn, size_t numItems, size_t chunkSize)
+      : ParallelForBase (numItems, chunkSize), function (&fn) {}
+  protected:
+    void ProcessRange (size_t first, size_t last)
+    {
+      (*function) (first, last);
+    }
+  };
+
+  /**
+   * Call \a fn (first, last) for consecutive ranges of the items from 0 up
+   * to \a numItems. The ranges are at most \a chunkSize items long and are
+   * processed by up to \a numWorkers jobs on \a jobQueue as well as the
+   * calling thread. Returns when all items are processed.
+   *
+   * Without a queue or workers, or if there is only one chunk, \a fn is
+   * called once for all items on the calling thread.
+   */
+  template<typename Fn>
+  void ParallelFor (iJobQueue* jobQueue, size_t numWorkers, size_t numItems,
+    size_t chunkSize, Fn& fn)
+  {
+    if (numItems == 0) return;
+    if (!jobQueue || (numWorkers == 0) || (numItems <= chunkSize))
+    {
+      fn (size_t (0), numItems);
+      return;
+    }
+
+    csRef<ParallelForFunctor<Fn> > loop;
+    loop.AttachNew (new ParallelForFunctor<Fn> (fn, numItems, chunkSize));
+    loop->Run (jobQueue, numWorkers);
+  }
+} // namespace Threading
+} // namespace CS
+
+#endif // __CS_CSUTIL_PARALLELFOR_H__
@@ -73,9 +73,16 @@ public:
   class Pool : public CS::Threading::OptionalMutex<Locked>
   {
     friend class scfImplementationPooled<Super, Allocator, Locked>;
-    struct Entry
+    /* Each instance is preceded by an entry. It links free instances and
+       holds the pool of allocated ones: the pool can't be stored in the
+       instance itself before it's constructed, as compilers may drop
+       stores to an object that is about to be constructed. */
+    union Entry
     {
       Entry* next;
+      Pool* pool;
+      // Keeps the instance following the entry aligned
+      long double align;
     };
     CS::Memory::AllocatorPointerWrapper<Entry, Allocator> pool;
     size_t allocedEntries;
@@ -98,6 +105,12 @@ public:
 	allocedEntries == 0);
     }
   };
+private:
+  /// Get the pool an instance was allocated from.
+  static Pool* PoolOf (void* instance)
+  {
+    return (static_cast<typename Pool::Entry*> (instance) - 1)->pool;
+  }
 protected:
   /// Pointer to the pool this instance is from.
   Pool* scfPool;
@@ -118,15 +131,13 @@ public:
       }
       else
       {
-	newEntry = static_cast<PoolEntry*> (p.pool.Alloc (n));
+	newEntry = static_cast<PoolEntry*> (
+	  p.pool.Alloc (sizeof (PoolEntry) + n));
       }
       p.allocedEntries++;
     }
-    scfClassType* newInst = reinterpret_cast<scfClassType*> (newEntry);
-    /* A bit nasty: set scfPool member of the (still unconstructed!) 
-     * instance... */
-    static_cast<scfPooledImplementationType*> (newInst)->scfPool = &p;
-    return newInst;
+    newEntry->pool = &p;
+    return newEntry + 1;
   }
 
   //@{
@@ -134,7 +145,7 @@ public:
   inline void operator delete (void* instance, Pool& p) 
   {
     typedef typename Pool::Entry PoolEntry;
-    PoolEntry* entry = static_cast<PoolEntry*> (instance);
+    PoolEntry* entry = static_cast<PoolEntry*> (instance) - 1;
     {
       CS::Threading::ScopedLock<Pool> lock (p);
       entry->next = p.pool.p;
@@ -144,9 +155,7 @@ public:
   }
   inline void operator delete (void* instance) 
   {
-    scfClassType* object = static_cast<scfClassType*> (instance);
-    Pool& p = *(static_cast<scfImplementationPooled*> (object)->scfPool);
-    scfImplementationPooled::operator delete (object, p);
+    scfImplementationPooled::operator delete (instance, *PoolOf (instance));
   }
   //@}
 
@@ -165,22 +174,28 @@ public:
    * Constructor. Call from the derived class with 'this' as first argument.
    */
   scfImplementationPooled (scfClassType* object) : 
-    Super (object) {}
+    Super (object),
+    scfPool (PoolOf (object)) {}
   template<typename A>
   scfImplementationPooled (scfClassType* object, A a) : 
-    Super (object, a) {}
+    Super (object, a),
+    scfPool (PoolOf (object)) {}
   template<typename A, typename B>
   scfImplementationPooled (scfClassType* object, A a, B b) : 
-    Super (object, a, b) {}
+    Super (object, a, b),
+    scfPool (PoolOf (object)) {}
   template<typename A, typename B, typename C>
   scfImplementationPooled (scfClassType* object, A a, B b, C c) : 
-    Super (object, a, b, c) {}
+    Super (object, a, b, c),
+    scfPool (PoolOf (object)) {}
   template<typename A, typename B, typename C, typename D>
   scfImplementationPooled (scfClassType* object, A a, B b, C c, D d) : 
-    Super (object, a, b, c, d) {}
+    Super (object, a, b, c, d),
+    scfPool (PoolOf (object)) {}
   template<typename A, typename B, typename C, typename D, typename E>
   scfImplementationPooled (scfClassType* object, A a, B b, C c, D d, E e) : 
-    Super (object, a, b, c, d, e) {}
+    Super (object, a, b, c, d, e),
+    scfPool (PoolOf (object)) {}
   //@}
 };
 
@@ -34,6 +34,7 @@
 
 /**
  * A radix-sorter for signed and unsigned integers as well as floats.
+ * 64-bit unsigned integers can be used to sort by compound keys.
  * Creates an index-table instead of reordering elements.
  * Based on ideas by Pierre Terdiman
  */
@@ -64,6 +65,15 @@ public:
    */
   void Sort(float* array, size_t size);
 
+  /**
+   * Sort array of 64-bit unsigned integers.
+   * Unlike the other variants this sort is always stable: elements with
+   * equal values keep their relative order.
+   * \param array Array of integers to sort
+   * \param size Number of elements in array
+   */
+  void Sort(uint64* array, size_t size);
+
   /**
    * Get the last generated ranks array.
    */
@@ -20,6 +20,7 @@
 #define __CS_STRHASH_H__
 
 #include "csextern.h"
+#include "csutil/flathash.h"
 #include "csutil/hash.h"
 #include "csutil/mempool.h"
 #include "iutil/strset.h"
@@ -43,7 +44,7 @@ template<typename Tag>
 class CS_CRYSTALSPACE_EXPORT StringHash
 {
 private:
-  typedef csHash<StringID<Tag>, char const*> HashType;
+  typedef csFlatHash<StringID<Tag>, char const*> HashType;
   HashType registry;
   csMemoryPool pool;
 
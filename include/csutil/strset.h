@@ -39,9 +39,12 @@ namespace Utility
  * performing string comparisons, you instead compare the numeric string ID's.
  *
  * If \a Locked is true operations on an instance of the set are locked are
- * for concurrent accesses.
+ * for concurrent accesses. If the set is shared between threads and most
+ * requests are lookups of existing strings, ConcurrentStringSet, which does
+ * not lock for lookups, is a better choice.
  *
  * \sa csStringHash
+ * \sa ConcurrentStringSet
  * \sa iStringSet
  */
 template<typename Tag, bool Locked = false>
@@ -50,7 +53,7 @@ class StringSet
  private:
   typedef CS::Threading::OptionalMutex<Locked> MutexType;
   StringHash<Tag> registry;
-  csHash<const char*, CS::StringID<Tag> > reverse; // ID to string mapping.
+  csFlatHash<const char*, CS::StringID<Tag> > reverse; // ID to string mapping.
   /* Inherit from OptionalMutex<> to avoid spending extra memory if locking
      is disabled */
   struct LockAndId : public MutexType
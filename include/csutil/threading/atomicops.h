@@ -116,6 +116,44 @@ namespace Threading
       return Impl::CompareAndSet (
         const_cast<void**> (target), (void*)0, (void*)0);
     }
+
+    /**
+     * Read value pointed to by target with "acquire" semantics: memory
+     * accesses after this read are not moved before it. Unlike Read(),
+     * this does not write to \a target, so concurrent readers do not
+     * compete for the cache line.
+     */
+    CS_FORCEINLINE_TEMPLATEMETHOD
+    static int32 ReadAcquire (const int32* target)
+    {
+#if defined(__ATOMIC_ACQUIRE)
+      return __atomic_load_n (target, __ATOMIC_ACQUIRE);
+#elif defined(CS_COMPILER_MSVC) && defined(CS_PROCESSOR_X86)
+      int32 value = *(const volatile int32*)target;
+      _ReadWriteBarrier ();
+      return value;
+#else
+      return Read (target);
+#endif
+    }
+
+    /**
+     * Read pointer pointed to by target with "acquire" semantics.
+     * \sa ReadAcquire(const int32*)
+     */
+    CS_FORCEINLINE_TEMPLATEMETHOD
+    static void* ReadAcquire (void* const* target)
+    {
+#if defined(__ATOMIC_ACQUIRE)
+      return __atomic_load_n (target, __ATOMIC_ACQUIRE);
+#elif defined(CS_COMPILER_MSVC) && defined(CS_PROCESSOR_X86)
+      void* value = *(void* const volatile*)target;
+      _ReadWriteBarrier ();
+      return value;
+#else
+      return Read (target);
+#endif
+    }
   };
 }
 }
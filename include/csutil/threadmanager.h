@@ -52,20 +52,41 @@ class CS_CRYSTALSPACE_EXPORT csThreadManager : public scfImplementation1<csThrea
 
     void Enqueue(iJob* job, QueueType type);
     void ProcessQueue(uint num);
+    void ProcessQueueTimed(csMicroTicks budget);
     int32 GetQueueCount() const;
     void ProcessAll ();
+
+    void SetAgingPeriod(csMicroTicks period) { agingPeriod = period; }
+    csMicroTicks GetAgingPeriod() const { return agingPeriod; }
+
+    void GetStatistics(QueueType type, csThreadQueueStatistics& stats);
+    void ResetStatistics();
   private:
-    inline void ProcessHighQueue(uint& i, uint& num);
-    inline void ProcessMedQueue(uint& i, uint& num);
-    inline void ProcessLowQueue(uint& i, uint& num);
-
-    CS::Threading::RecursiveMutex highQueueLock;
-    CS::Threading::RecursiveMutex medQueueLock;
-    CS::Threading::RecursiveMutex lowQueueLock;
-    csFIFO<csRef<iJob> > highqueue;
-    csFIFO<csRef<iJob> > medqueue;
-    csFIFO<csRef<iJob> > lowqueue;
+    struct QueuedJob
+    {
+      csRef<iJob> job;
+      csMicroTicks enqueueTime;
+    };
+
+    struct PriorityQueue
+    {
+      CS::Threading::RecursiveMutex lock;
+      csFIFO<QueuedJob> jobs;
+      csThreadQueueStatistics stats;
+    };
+
+    enum { numQueues = 3 };
+    // Queues for HIGH, MED and LOW jobs
+    PriorityQueue queues[numQueues];
+    CS::Threading::Mutex statsLock;
+    csMicroTicks agingPeriod;
     int32 total;
+
+    /**
+     * Run the job that waited longest relative to its priority.
+     * Returns false if there was none.
+     */
+    bool ProcessNext();
   };
 public:
   csThreadManager(iObjectRegistry* objReg);
@@ -78,6 +99,31 @@ public:
   /// Process all pending events
   void ProcessAll ();
 
+  void ProcessFor(csMicroTicks budget);
+
+  inline void SetFrameBudget(csMicroTicks budget)
+  {
+    frameBudget = budget;
+  }
+
+  inline csMicroTicks GetFrameBudget()
+  {
+    return frameBudget;
+  }
+
+  inline void SetAgingPeriod(csMicroTicks period)
+  {
+    listQueue->SetAgingPeriod(period);
+  }
+
+  inline csMicroTicks GetAgingPeriod()
+  {
+    return listQueue->GetAgingPeriod();
+  }
+
+  void GetQueueStatistics(QueueType queueType, csThreadQueueStatistics& stats);
+  void ResetQueueStatistics();
+
   inline void PushToQueue(QueueType queueType, iJob* job)
   {
     if(queueType == THREADED || queueType == THREADEDL)
@@ -159,6 +205,7 @@ private:
   csRef<iEventQueue> eventQueue;
   csTicks waitingTime;
   bool exiting;
+  csMicroTicks frameBudget;
 
   class TMEventHandler : public scfImplementation1<TMEventHandler, 
       iEventHandler>
@@ -179,7 +226,14 @@ private:
       {
         if(!parent->alwaysRunNow)
         {
-          parent->Process(5);
+          if(parent->frameBudget > 0)
+          {
+            parent->ProcessFor(parent->frameBudget);
+          }
+          else
+          {
+            parent->Process(5);
+          }
         }
       }
       return false;
@@ -0,0 +1,249 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSUTIL_WORKSTEALINGJOBQUEUE_H__
+#define __CS_CSUTIL_WORKSTEALINGJOBQUEUE_H__
+
+/**\file
+ * Implementation of iJobQueue with per-worker lock-free deques and
+ * work stealing.
+ */
+
+#include "csextern.h"
+#include "csutil/fifo.h"
+#include "csutil/randomgen.h"
+#include "csutil/scf_implementation.h"
+#include "csutil/threadmanager.h"
+#include "csutil/csstring.h"
+#include "iutil/job.h"
+
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/condition.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/threading/thread.h"
+#include "csutil/threading/tls.h"
+
+namespace CS
+{
+namespace Threading
+{
+
+/**
+ * Job queue with work stealing.
+ *
+ * Drop-in alternative to ThreadedJobQueue for workloads with many small or
+ * bursty jobs. Every worker owns a bounded lock-free deque (Chase-Lev style):
+ * the owner pushes and pops at the bottom without any locking, idle workers
+ * steal from the top of randomly chosen victims.
+ *
+ * Jobs enqueued from a worker thread (i.e. jobs spawning jobs) go straight to
+ * that worker's deque. Jobs enqueued from other threads go to a small
+ * per-worker inbox which the worker moves into its deque in batches; inboxes
+ * are picked round-robin and only try-locked, so producers rarely contend.
+ *
+ * Idle workers spin (trying to steal) for a while before parking on a
+ * condition variable; producers only touch the condition if a worker is
+ * actually parked.
+ */
+class CS_CRYSTALSPACE_EXPORT WorkStealingJobQueue :
+  public ThreadedCallable<WorkStealingJobQueue>,
+  public scfImplementation1<WorkStealingJobQueue, iJobQueue>
+{
+public:
+  /**
+   * Construct job queue.
+   * \param numWorkers Number of worker threads to use.
+   * \param priority Priority of worker threads.
+   * \param name Optional name of the queue.
+   *   Used in worker thread naming and shows up in the debugger,
+   *   if supported.
+   */
+  WorkStealingJobQueue (size_t numWorkers = 1,
+    ThreadPriority priority = THREAD_PRIO_NORMAL, const char* name = 0);
+  /**
+   * Construct job queue.
+   * \param objectReg Object registry.
+   * \param numWorkers Number of worker threads to use.
+   * \param priority Priority of worker threads.
+   * \param name Optional name of the queue.
+   *   Used in worker thread naming and shows up in the debugger,
+   *   if supported.
+   * \remarks A job queue constructed with an object registry can interact
+   *  with the thread manager which can avoid deadlocks in certain scenarios.
+   */
+  WorkStealingJobQueue (iObjectRegistry* objectReg,
+    size_t numWorkers = 1, ThreadPriority priority = THREAD_PRIO_NORMAL,
+    const char* name = 0);
+  virtual ~WorkStealingJobQueue ();
+
+  virtual void Enqueue (iJob* job);
+  virtual JobStatus Dequeue (iJob* job, bool waitForCompletion);
+  virtual JobStatus PullAndRun (iJob* job, bool waitForCompletion = true);
+  virtual bool IsFinished ();
+  virtual int32 GetQueueCount();
+  virtual void WaitAll ();
+
+  /// Get name of this queue
+  const char* GetName () const { return name; }
+
+  /**
+   * Set the number of unsuccessful steal rounds an idle worker does before
+   * parking. Higher values lower the wake-up latency for bursty workloads at
+   * the cost of burning CPU while idle. 0 parks immediately.
+   */
+  void SetSpinCount (uint spins)
+  { AtomicOperations::Set (&spinCount, (int32)spins); }
+  /// Get the number of steal rounds an idle worker does before parking.
+  uint GetSpinCount () const
+  { return (uint)AtomicOperations::Read (&spinCount); }
+private:
+  iObjectRegistry* GetObjectRegistry() const { return objectReg; }
+
+  void Init (ThreadPriority priority);
+
+  THREADED_CALLABLE_DECL2(WorkStealingJobQueue, InternalPullAndRun,
+    csThreadReturn, csRef<iJob>, job, bool, waitForCompletion, HIGH, true,
+    true);
+  JobStatus InternalPullAndRunImpl (iJob* job, bool waitForCompletion);
+
+  bool PullFromQueues (iJob* job);
+  JobStatus CheckCompletion (iJob* job, bool waitForCompletion);
+
+  struct WorkerState;
+
+  /**
+   * Bounded work-stealing deque.
+   * Slots hold a reference to the job. Whoever takes a job ownership (owner
+   * pop, thief steal, or Dequeue()/PullAndRun() claiming a particular job)
+   * does so by atomically swapping the slot to null, which makes every job
+   * run exactly once even if it races with a claim by job identity.
+   */
+  class JobDeque
+  {
+  public:
+    enum { Capacity = 4096 };
+
+    JobDeque ();
+    ~JobDeque ();
+
+    /// Push at the bottom. Owner only. Returns false if full.
+    bool Push (iJob* job);
+    /// Pop from the bottom. Owner only. Returned job carries a reference.
+    iJob* Pop ();
+    /// Steal from the top. Any thread. Returned job carries a reference.
+    iJob* Steal ();
+    /// Claim a specific job wherever it is in the deque. Any thread.
+    bool Claim (iJob* job);
+    /// Approximate number of jobs in the deque.
+    int32 GetSize () const;
+  private:
+    iJob* TakeSlot (int32 index);
+    void* slots[Capacity];
+    int32 top;
+    int32 bottom;
+  };
+
+  class WorkerRunnable : public Runnable
+  {
+  public:
+    WorkerRunnable (WorkStealingJobQueue* queue, WorkerState* ws,
+      unsigned int id);
+
+    virtual void Run ();
+    virtual const char* GetName () const;
+  private:
+    friend class WorkStealingJobQueue;
+
+    /// Find some work: own deque, own inbox, then other workers.
+    iJob* FindJob ();
+    /// Park until a job is enqueued or the queue shuts down.
+    void Park ();
+
+    WorkStealingJobQueue* ownerQueue;
+    WorkerState* workerState;
+    csString name;
+  };
+
+  // Per thread state
+  struct WorkerState
+  {
+    WorkerState (WorkStealingJobQueue* queue, unsigned int id);
+
+    csRef<WorkerRunnable> runnable;
+    csRef<Thread> threadObject;
+
+    JobDeque deque;
+
+    /// Jobs enqueued from outside the worker threads.
+    Mutex inboxMutex;
+    csFIFO<csRef<iJob> > inbox;
+    int32 inboxSize;
+
+    /// Job currently executed by this worker.
+    void* currentJob;
+    /**
+     * Odd while the worker is between taking a job out of a queue and
+     * publishing it in currentJob.
+     */
+    int32 takeEpoch;
+    /// Threads waiting for currentJob to change.
+    int32 numJobWaiters;
+    Mutex jobFinishedMutex;
+    Condition jobFinished;
+
+    csRandomGen victimRand;
+  };
+
+  void WakeWorker ();
+  void JobDone ();
+
+  iObjectRegistry* objectReg;
+  WorkerState** allWorkerState;
+  ThreadGroup allThreads;
+  /// TLS slot holding the WorkerState of the current worker thread
+  ThreadLocalBase currentWorker;
+
+  size_t numWorkerThreads;
+  /// Jobs enqueued and not yet finished (queued or running).
+  int32 outstandingJobs;
+  /// Jobs enqueued and not yet picked up by anyone.
+  int32 queuedJobs;
+  /// Round-robin counter for picking an inbox on Enqueue().
+  int32 nextInbox;
+  int32 spinCount;
+  int32 shutdown;
+
+  /// Parked workers.
+  int32 numParked;
+  Mutex parkMutex;
+  Condition parkCondition;
+
+  /// Threads waiting in WaitAll().
+  int32 numAllWaiters;
+  Mutex allFinishedMutex;
+  Condition allFinished;
+
+  csString name;
+};
+
+}
+}
+
+typedef CS::Threading::WorkStealingJobQueue csWorkStealingJobQueue;
+
+#endif // __CS_CSUTIL_WORKSTEALINGJOBQUEUE_H__
@@ -89,6 +89,31 @@ struct csLightInfluence
   }
 };
 
+/**
+ * A single bounding box query for iLightManager::GetRelevantLightsBatch().
+ */
+struct csLightBatchQuery
+{
+  /// The bounding box to use when querying lights.
+  const csBox3* boundingBox;
+  /**
+   * Optional transformation from bounding box to world space. 'this' space
+   * is bounding box space, 'other' space is world space. 0 has the same
+   * effect as an identity transform.
+   */
+  const csReversibleTransform* bboxToWorld;
+  /// Flags provided by csLightQueryFlags.
+  uint flags;
+
+  /// Returns: index of the first influence for this box in the output array.
+  size_t firstInfluence;
+  /// Returns: number of influences for this box.
+  size_t numInfluences;
+
+  csLightBatchQuery () : boundingBox (0), bboxToWorld (0),
+    flags (CS_LIGHTQUERY_GET_ALL), firstInfluence (0), numInfluences (0) {}
+};
+
 /**
  * 
  */
@@ -131,7 +156,7 @@ struct iLightInfluenceCallback : public virtual iBase
  */
 struct iLightManager : public virtual iBase
 {
-  SCF_INTERFACE(iLightManager,5,0,1);
+  SCF_INTERFACE(iLightManager,5,1,0);
 
   /**
    * Return all 'relevant' light that hit this object. Depending on 
@@ -329,6 +354,30 @@ struct iLightManager : public virtual iBase
     size_t& numLights, size_t maxLights = (size_t)~0,
     const csReversibleTransform* bboxToWorld = 0,
     uint flags = CS_LIGHTQUERY_GET_ALL) = 0;
+
+  /**
+   * Return all 'relevant' lights for a number of bounding boxes within a
+   * specified sector. This is considerably cheaper than querying each box
+   * separately as the sector's lights are only traversed once for the whole
+   * group.
+   * \param sector is the sector to check for.
+   * \param queries The boxes to query. The influences for each box are
+   *   returned in the \a firstInfluence and \a numInfluences members.
+   * \param numQueries Number of entries in \a queries.
+   * \param influences Array receiving the influences of all boxes.
+   * \param maxInfluences Size of \a influences.
+   * \param maxLights The maximum number of lights per box that you (as
+   *   the caller of this function) are interested in.
+   * \param sorted Whether to sort the lights of each box by the intensity at
+   *   the closest point on(or in) the box.
+   * \return The size \a influences needs to have to hold all results. If
+   *   this is larger than \a maxInfluences the results are incomplete;
+   *   enlarge the array and repeat the query.
+   */
+  virtual size_t GetRelevantLightsBatch (iSector* sector,
+    csLightBatchQuery* queries, size_t numQueries,
+    csLightInfluence* influences, size_t maxInfluences,
+    size_t maxLights = (size_t)~0, bool sorted = false) = 0;
 };
 
 /** @} */
@@ -93,6 +93,39 @@ struct iVisibilityCullerListener : public virtual iBase
     csSectorVisibleRenderMeshes*& meshList) = 0;
 };
 
+/**
+ * A view tested by iVisibilityCuller::VisTest() for several views at once.
+ */
+struct csVisibilityCullerView
+{
+  /// Clip planes of the view. Objects are visible if inside all of them.
+  const csPlane3* planes;
+  /// Mask of the planes to use (bit n for planes[n]).
+  uint32 planes_mask;
+};
+
+/**
+ * Implement this interface when you want to get notified about visible
+ * objects detected by a visibility test of several views at once.
+ *
+ * This callback is used by:
+ * - iVisibilityCuller::VisTest(const csVisibilityCullerView*, size_t,
+ *   iVisibilityCullerMultiViewListener*)
+ */
+struct iVisibilityCullerMultiViewListener : public virtual iBase
+{
+  SCF_INTERFACE(iVisibilityCullerMultiViewListener, 1, 0, 0);
+  /**
+   * This function is called once for every object visible in at least one
+   * of the views. Bit n of \a view_mask is set if the object is visible in
+   * view n. For these views, \a frustum_masks[n] holds the planes of the
+   * view the object intersects, like the frustum_mask passed to
+   * iVisibilityCullerListener::ObjectVisible().
+   */
+  virtual void ObjectVisible (iVisibilityObject *visobject,
+    iMeshWrapper *mesh, uint32 view_mask, const uint32* frustum_masks) = 0;
+};
+
 /**
  * This interface represents a visibility culling system.
  * To use it you first register visibility objects (which are all the
@@ -102,6 +135,7 @@ struct iVisibilityCullerListener : public virtual iBase
  * Main creators of instances implementing this interface:
  * - Dynavis culler plugin (crystalspace.culling.dynavis)
  * - Frustvis culler plugin (crystalspace.culling.frustvis)
+ * - Occlvis culler plugin (crystalspace.culling.occlvis)
  *
  * Main ways to get pointers to this interface:
  * - csLoadPlugin()
@@ -112,7 +146,7 @@ struct iVisibilityCullerListener : public virtual iBase
  */
 struct iVisibilityCuller : public virtual iBase
 {
-  SCF_INTERFACE (iVisibilityCuller, 5, 1, 0);
+  SCF_INTERFACE (iVisibilityCuller, 5, 2, 0);
 
   /**
    * Setup all data for this visibility culler. This needs
@@ -239,6 +273,18 @@ struct iVisibilityCuller : public virtual iBase
    * Ends precache culling.
    */
   virtual void EndPrecacheCulling () = 0;
+
+  /**
+   * Test the visibility of the objects for several views at once, e.g.
+   * the cascades of a shadow map. Cullers test all views in a single
+   * traversal of their data structures, which is a lot cheaper than
+   * testing the views one after the other. Every object visible in at least
+   * one view is reported once, along with the views it is visible in.
+   * Objects flagged with #CS_ENTITY_INVISIBLEMESH are not reported.
+   * \remarks At most 32 views can be tested at once.
+   */
+  virtual void VisTest (const csVisibilityCullerView* views, size_t num_views,
+    iVisibilityCullerMultiViewListener* viscallback) = 0;
 };
 
 /** \name GetCullerFlags() flags
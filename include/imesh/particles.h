@@ -249,6 +249,55 @@ struct csParticleBuffer
   size_t particleCount;
 };
 
+/**
+ * Structure-of-arrays storage of the frequently updated particle data.
+ * Each stream holds one float per particle and starts on a 16 byte
+ * boundary, so the streams can be processed with SIMD instructions.
+ *
+ * A particle system using this layout (see 
+ * iParticleSystem::SetUseParticleStreams()) keeps the position, linear
+ * velocity, mass, time to live and color of the particles only in the
+ * streams. The members of csParticle and csParticleAux holding these values
+ * are not kept up to date; the other members (such as the orientation)
+ * are still stored in the csParticleBuffer.
+ */
+struct csParticleStreams
+{
+  /**
+   * \name Position
+   * @{ */
+  float* positionX;
+  float* positionY;
+  float* positionZ;
+  /** @} */
+
+  /**
+   * \name Linear velocity
+   * @{ */
+  float* linearVelocityX;
+  float* linearVelocityY;
+  float* linearVelocityZ;
+  /** @} */
+
+  /// Particle mass
+  float* mass;
+
+  /// Time to live
+  float* timeToLive;
+
+  /**
+   * \name Color
+   * @{ */
+  float* colorRed;
+  float* colorGreen;
+  float* colorBlue;
+  float* colorAlpha;
+  /** @} */
+
+  /// Number of valid particles in the streams
+  size_t particleCount;
+};
+
 /**
  * A particle emitter.
  * The particle emitters are responsible for adding new particles and
@@ -386,6 +435,34 @@ struct iParticleEffector : public virtual iBase
     const csParticleBuffer& particleBuffer, float dt, float totalTime) = 0;
 };
 
+/**
+ * Optional interface of particle effectors that can work directly on the
+ * particle streams (csParticleStreams) of a particle system.
+ *
+ * Particle systems using the stream layout call EffectParticleStreams()
+ * on effectors implementing this interface. For all other effectors the
+ * particle data is copied back into the csParticle records before calling
+ * iParticleEffector::EffectParticles(), which is considerably slower.
+ */
+struct iParticleStreamEffector : public virtual iBase
+{
+  SCF_INTERFACE(iParticleStreamEffector,1,0,0);
+
+  /**
+   * Calculate effect on particles and update their velocities.
+   * \param system The particle system.
+   * \param streams The frequently updated particle data.
+   * \param particleBuffer The remaining particle data. The members stored
+   *   in \a streams are not valid.
+   * \param dt Time step, in seconds.
+   * \param totalTime Total time the particle system has been running,
+   *   in seconds.
+   */
+  virtual void EffectParticleStreams (iParticleSystemBase* system,
+    const csParticleStreams& streams, const csParticleBuffer& particleBuffer,
+    float dt, float totalTime) = 0;
+};
+
 
 /** 
  * Base properties for particle system.
@@ -501,7 +578,7 @@ struct iParticleSystemFactory : public iParticleSystemBase
  */
 struct iParticleSystem : public iParticleSystemBase
 {
-  SCF_INTERFACE(iParticleSystem,1,0,1);
+  SCF_INTERFACE(iParticleSystem,1,1,0);
 
   /// Get number of particles currently in the system
   virtual size_t GetParticleCount () const = 0;
@@ -530,6 +607,22 @@ struct iParticleSystem : public iParticleSystemBase
    * system grows proportionally with the time to advance!
    */
   virtual void Advance (csTicks time) = 0;
+
+  /**
+   * Set whether the position, velocity, mass, time to live and color of the
+   * particles are stored as separate streams (see csParticleStreams) instead
+   * of in the csParticle records. The stream layout allows the builtin
+   * effectors and the vertex setup to process many particles at once.
+   *
+   * The default is taken from the \c Mesh.Particles.Streams configuration
+   * setting. Particles returned by GetParticle() and GetParticleAux() are
+   * kept consistent with the streams, but accessing them while using the
+   * stream layout is slow.
+   */
+  virtual void SetUseParticleStreams (bool useStreams) = 0;
+
+  /// Get whether the particle data is stored as separate streams.
+  virtual bool GetUseParticleStreams () const = 0;
 };
 
 /** @} */
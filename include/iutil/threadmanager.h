@@ -59,6 +59,27 @@ enum QueueType
   LOW
 };
 
+/**
+ * Statistics of the jobs run from one of the main thread queues
+ * (HIGH, MED or LOW) of the thread manager. Times are in microseconds.
+ */
+struct csThreadQueueStatistics
+{
+  /// Number of jobs run
+  uint64 jobsRun;
+  /// Total time the jobs waited in the queue before they were run
+  csMicroTicks totalLatency;
+  /// Longest time a job waited in the queue
+  csMicroTicks maxLatency;
+  /// Total time spent running the jobs
+  csMicroTicks totalRunTime;
+  /// Longest time a single job ran
+  csMicroTicks maxRunTime;
+
+  csThreadQueueStatistics () : jobsRun (0), totalLatency (0), maxLatency (0),
+    totalRunTime (0), maxRunTime (0) {}
+};
+
 /**
  * This is the thread manager.
  *
@@ -72,7 +93,7 @@ enum QueueType
 
 struct iThreadManager : public virtual iBase
 {
-  SCF_INTERFACE(iThreadManager, 3, 0, 1);
+  SCF_INTERFACE(iThreadManager, 3, 1, 0);
 
   virtual void Init(iConfigManager* config) = 0;
   virtual void Process(uint num = 1) = 0;
@@ -85,6 +106,36 @@ struct iThreadManager : public virtual iBase
   virtual bool Exiting() = 0;
   /// Process all pending events
   virtual void ProcessAll () = 0;
+
+  /**
+   * Process main thread jobs for about \a budget microseconds.
+   * At least one job is run if any is queued. Jobs are not interrupted,
+   * so the budget is exceeded by up to the duration of the last job.
+   */
+  virtual void ProcessFor(csMicroTicks budget) = 0;
+
+  /**
+   * Set the time spent on main thread jobs each frame, in microseconds.
+   * 0 runs a fixed number of jobs per frame instead.
+   */
+  virtual void SetFrameBudget(csMicroTicks budget) = 0;
+  /// Get the time spent on main thread jobs each frame.
+  virtual csMicroTicks GetFrameBudget() = 0;
+
+  /**
+   * Set the time, in microseconds, after which a job waiting in a main
+   * thread queue is treated as if it had one priority level more.
+   * This keeps lower priority jobs from starving. 0 disables aging.
+   */
+  virtual void SetAgingPeriod(csMicroTicks period) = 0;
+  /// Get the time after which a waiting job is raised in priority.
+  virtual csMicroTicks GetAgingPeriod() = 0;
+
+  /// Get the statistics of a main thread queue (HIGH, MED or LOW).
+  virtual void GetQueueStatistics(QueueType queueType,
+    csThreadQueueStatistics& stats) = 0;
+  /// Reset the statistics of all main thread queues.
+  virtual void ResetQueueStatistics() = 0;
 };
 
 // Interface macros
@@ -24,10 +24,18 @@
  */
 
 #include "csutil/array.h"
+#include "csutil/ref.h"
 #include "csutil/scf_interface.h"
 #include "csutil/sysfunc.h"
 #include "csutil/threading/atomicops.h"
+#include "csutil/threading/thread.h"
+#include "csutil/threading/tls.h"
 
+#if defined (CS_PROCESSOR_X86) && defined (CS_COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
+struct iDataBuffer;
 struct iObjectRegistry;
 
 //#define CS_USE_PROFILER
@@ -36,12 +44,118 @@ namespace CS
 {
 namespace Debug
 {
+  class ProfileEventRecorder;
+
+  /**
+   * Get a timestamp for profiling.
+   * Where available, this reads the time stamp counter of the processor,
+   * which is considerably cheaper than csGetMicroTicks(). The unit of the
+   * timestamp is thus unspecified; use iProfiler::TimestampToMicroseconds()
+   * to convert differences of timestamps.
+   */
+  CS_FORCEINLINE uint64 ProfileTimestamp ()
+  {
+#if defined (CS_PROCESSOR_X86) && defined (CS_COMPILER_GCC)
+    uint32 lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (uint64 (hi) << 32) | lo;
+#elif defined (CS_PROCESSOR_X86) && defined (CS_COMPILER_MSVC)
+    return __rdtsc ();
+#else
+    return uint64 (csGetMicroTicks ());
+#endif
+  }
+
+  /**
+   * Values accumulated by each thread separately, so updating them needs no
+   * synchronization between threads. The values of all threads are merged
+   * when read.
+   */
+  template<typename T>
+  class ProfileThreadValues
+  {
+  public:
+    /// Value of one thread
+    struct Slot
+    {
+      CS::Threading::ThreadID threadId;
+      T value;
+      Slot* next;
+    };
+
+    ProfileThreadValues () : slots (0) {}
+
+    ~ProfileThreadValues ()
+    {
+      while (slots)
+      {
+        Slot* next = slots->next;
+        delete slots;
+        slots = next;
+      }
+    }
+
+    /// Get the value of the calling thread
+    T& Get ()
+    {
+      CS::Threading::ThreadID threadId = CS::Threading::Thread::GetThreadID ();
+      Slot* head = GetFirst ();
+      for (Slot* slot = head; slot != 0; slot = slot->next)
+      {
+        if (slot->threadId == threadId) return slot->value;
+      }
+
+      // Threads only ever add their own slot, at the front
+      Slot* newSlot = new Slot;
+      newSlot->threadId = threadId;
+      newSlot->value = T ();
+      void* prevHead;
+      do
+      {
+        prevHead = head;
+        newSlot->next = head;
+        head = static_cast<Slot*> (
+          CS::Threading::AtomicOperations::CompareAndSet (
+            (void**)&slots, newSlot, prevHead));
+      }
+      while (head != prevHead);
+      return newSlot->value;
+    }
+
+    /// Get the first slot, for iterating the values of all threads
+    Slot* GetFirst () const
+    {
+      return static_cast<Slot*> (
+        CS::Threading::AtomicOperations::ReadAcquire ((void* const*)&slots));
+    }
+
+    /// Reset the values of all threads
+    void Reset ()
+    {
+      for (Slot* slot = GetFirst (); slot != 0; slot = slot->next)
+        slot->value = T ();
+    }
+
+  private:
+    Slot* slots;
+  };
+
   class ProfileZone
   {
   public:
+    /// Time spent in a zone by one thread
+    struct Times
+    {
+      /// Total time spent in the zone, in ProfileTimestamp() units
+      uint64 totalTime;
+      uint32 enterCount;
+
+      Times () : totalTime (0), enterCount (0) {}
+    };
+
     // Methods
     ProfileZone ()
-      : zoneName (0), parentZone (0), totalTime (0), enterCount (0)
+      : zoneName (0), parentZone (0), recorder (0)
     {}
 
     ~ProfileZone ()
@@ -49,11 +163,33 @@ namespace Debug
       delete[] zoneName;
     }
 
+    /// Total time spent in this zone by all threads
+    uint64 GetTotalTime () const
+    {
+      uint64 totalTime = 0;
+      for (ProfileThreadValues<Times>::Slot* slot = threadTimes.GetFirst ();
+           slot != 0; slot = slot->next)
+        totalTime += slot->value.totalTime;
+      return totalTime;
+    }
+
+    /// How often this zone was entered by all threads
+    uint32 GetEnterCount () const
+    {
+      uint32 enterCount = 0;
+      for (ProfileThreadValues<Times>::Slot* slot = threadTimes.GetFirst ();
+           slot != 0; slot = slot->next)
+        enterCount += slot->value.enterCount;
+      return enterCount;
+    }
+
     // Data
     const char* zoneName;
     ProfileZone* parentZone;
-    uint64 totalTime;
-    uint32 enterCount;
+    /// Recorder for the events of this zone, if any
+    ProfileEventRecorder* recorder;
+    /// Times spent in this zone by each thread
+    ProfileThreadValues<Times> threadTimes;
   };
 
 
@@ -63,7 +199,7 @@ namespace Debug
     // Methods
 
     ProfileCounter ()
-      : counterName (0), counterValue (0)
+      : counterName (0)
     {
     }
 
@@ -72,9 +208,146 @@ namespace Debug
       delete[] counterName;
     }
 
+    /// Value of this counter, summed over all threads
+    uint64 GetValue () const
+    {
+      uint64 value = 0;
+      for (ProfileThreadValues<uint64>::Slot* slot = threadValues.GetFirst ();
+           slot != 0; slot = slot->next)
+        value += slot->value;
+      return value;
+    }
+
     // Data
     const char* counterName;
-    uint64 counterValue;
+    /// Value of this counter for each thread
+    ProfileThreadValues<uint64> threadValues;
+  };
+
+  /// One pass of a thread through a profile zone
+  struct ProfileEvent
+  {
+    const ProfileZone* zone;
+    uint64 startTime;
+    uint64 endTime;
+  };
+
+  /**
+   * Ring buffer of the profile events of one thread.
+   * Events are only pushed by the thread owning the buffer and collected by
+   * one other thread at a time; neither side takes a lock. If the buffer
+   * is full new events are dropped.
+   */
+  class ProfileEventBuffer
+  {
+  public:
+    /// Create a buffer for \a capacity events; must be a power of two.
+    ProfileEventBuffer (uint32 threadId, uint32 capacity)
+      : threadId (threadId), released (0), droppedEvents (0),
+        capacity (capacity), writeIndex (0), cachedReadIndex (0),
+        readIndex (0)
+    {
+      CS_ASSERT ((capacity & (capacity - 1)) == 0);
+      events = new ProfileEvent[capacity];
+    }
+
+    ~ProfileEventBuffer ()
+    {
+      delete[] events;
+    }
+
+    /// Add an event. Must only be called by the owning thread.
+    void Push (const ProfileZone* zone, uint64 startTime, uint64 endTime)
+    {
+      int32 w = writeIndex;
+      if (uint32 (w - cachedReadIndex) >= capacity)
+      {
+        cachedReadIndex =
+          CS::Threading::AtomicOperations::Read (&readIndex);
+        if (uint32 (w - cachedReadIndex) >= capacity)
+        {
+          droppedEvents++;
+          return;
+        }
+      }
+      ProfileEvent& event = events[w & (capacity - 1)];
+      event.zone = zone;
+      event.startTime = startTime;
+      event.endTime = endTime;
+      // Publish the event
+      CS::Threading::AtomicOperations::Set (&writeIndex, w + 1);
+    }
+
+    /**
+     * Take the oldest event from the buffer. Returns false if the buffer
+     * is empty.
+     */
+    bool Pop (ProfileEvent& event)
+    {
+      int32 r = readIndex;
+      if (r == CS::Threading::AtomicOperations::Read (&writeIndex))
+        return false;
+      event = events[r & (capacity - 1)];
+      CS::Threading::AtomicOperations::Set (&readIndex, r + 1);
+      return true;
+    }
+
+    /// Identifier of the owning thread
+    uint32 threadId;
+    /// Set when the owning thread exited
+    int32 released;
+    /// Number of events that did not fit into the buffer
+    uint32 droppedEvents;
+
+  private:
+    ProfileEvent* events;
+    uint32 capacity;
+    // Written by the owning thread
+    int32 writeIndex;
+    int32 cachedReadIndex;
+    // Written by the collecting thread
+    int32 readIndex;
+  };
+
+  /**
+   * Hands out the event buffers of the threads passing through profile
+   * zones. Implemented by the profiler.
+   */
+  class ProfileEventRecorder
+  {
+  public:
+    ProfileEventRecorder (
+        CS::Threading::ThreadLocalBase::DestructorFn releaseBuffer)
+      : recording (0), threadBuffer (releaseBuffer)
+    {}
+    virtual ~ProfileEventRecorder () {}
+
+    /**
+     * Get the event buffer of the calling thread, or 0 if events are not
+     * recorded currently.
+     */
+    ProfileEventBuffer* GetThreadBuffer ()
+    {
+      if (!recording) return 0;
+      ProfileEventBuffer* buffer =
+        static_cast<ProfileEventBuffer*> (threadBuffer.GetValue ());
+      if (!buffer)
+      {
+        buffer = CreateThreadBuffer ();
+        threadBuffer.SetValue (buffer);
+      }
+      return buffer;
+    }
+
+  protected:
+    /// Whether events are recorded
+    volatile int32 recording;
+
+    /// Create the event buffer for the calling thread
+    virtual ProfileEventBuffer* CreateThreadBuffer () = 0;
+
+  private:
+    CS::Threading::ThreadLocalBase threadBuffer;
   };
 
   class ProfilerZoneScope
@@ -83,26 +356,31 @@ namespace Debug
     ProfilerZoneScope (ProfileZone* zone)
     {
       this->zone = zone;
-      startTime = csGetMicroTicks ();
+      eventBuffer = zone->recorder ? zone->recorder->GetThreadBuffer () : 0;
+      startTime = ProfileTimestamp ();
     }
 
     ~ProfilerZoneScope ()
     {
-      csMicroTicks stopTime = csGetMicroTicks ();
+      uint64 stopTime = ProfileTimestamp ();
 
-      zone->enterCount++;
-      zone->totalTime += (stopTime - startTime);
+      ProfileZone::Times& times = zone->threadTimes.Get ();
+      times.enterCount++;
+      times.totalTime += (stopTime - startTime);
+      if (eventBuffer)
+        eventBuffer->Push (zone, startTime, stopTime);
     }
 
 
   private:
-    csMicroTicks startTime;
+    uint64 startTime;
     ProfileZone* zone;
+    ProfileEventBuffer* eventBuffer;
   };
 
   inline void ProfilerCounterAdd (ProfileCounter* counter)
   {
-    counter->counterValue++;
+    counter->threadValues.Get ()++;
   }
 }
 }
@@ -113,7 +391,7 @@ namespace Debug
  */
 struct iProfiler : public virtual iBase
 {
-  SCF_INTERFACE (iProfiler, 3,0,1);
+  SCF_INTERFACE (iProfiler, 3,1,0);
   
   /**\name Deprecated methods
    * \deprecated These methods are present solely for source code 
@@ -169,8 +447,35 @@ struct iProfiler : public virtual iBase
 
   /**
    * Stop logging.
+   * The events recorded while logging are written to a file with the
+   * same name as the log but the extension <tt>.json</tt>, in Chrome
+   * trace event format.
    */
   virtual void StopLogging () = 0;
+
+  /**
+   * Convert a difference of CS::Debug::ProfileTimestamp() values, such as
+   * ProfileZone::totalTime, to microseconds.
+   */
+  virtual double TimestampToMicroseconds (uint64 timestamp) = 0;
+
+  /**
+   * Start recording every pass of any thread through a profile zone.
+   * Events recorded earlier are discarded.
+   */
+  virtual void StartEventRecording () = 0;
+
+  /**
+   * Stop recording profile zone passes.
+   */
+  virtual void StopEventRecording () = 0;
+
+  /**
+   * Get the events recorded since the last StartEventRecording() as JSON
+   * in the Chrome trace event format, which can be viewed with
+   * <tt>chrome://tracing</tt>.
+   */
+  virtual csPtr<iDataBuffer> GetChromeTrace () = 0;
 };
 
 /**
@@ -216,7 +521,7 @@ static inline CS::Debug::ProfileCounter* CS_DEBUG_Profiler_GetProfileCounter ##
 {\
   if (!CS_DEBUG_Profiler_staticProfileCounter ## name) \
   {\
-    CS_DEBUG_Profiler_staticProfileCounter ## name = CS_DEBUG_Profiler_GetProfiler ()->GetProfileZone (#name); \
+    CS_DEBUG_Profiler_staticProfileCounter ## name = CS_DEBUG_Profiler_GetProfiler ()->GetProfileCounter (#name); \
   }\
   return CS_DEBUG_Profiler_staticProfileCounter ## name; \
 }
@@ -19,6 +19,13 @@
 
 #include "cssysdef.h"
 #include "csgfx/shadervarcontext.h"
+#include "csutil/bitops.h"
+
+#if defined (CS_PROCESSOR_X86) && (defined (__SSE2__) || defined (_M_X64) \
+  || (defined (_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define CS_SVCONTEXT_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace CS
 {
@@ -30,40 +37,98 @@ ShaderVariableContextImpl::~ShaderVariableContextImpl ()
 
 namespace
 {
-class SvVarArrayCmp : public csArrayCmp<csShaderVariable*, 
-  CS::ShaderVarStringID>
-{
-  static int SvKeyCompare (csShaderVariable* const& r,
-		                         CS::ShaderVarStringID const& k)
-  { 
-    return r->GetName() - k;
+  /* Below this many names the range left by the binary search is scanned
+     linearly. */
+  enum { linearSearchNames = 16 };
+
+  /// Index of the first name not less than \a name.
+  static size_t LowerBound (const StringIDValue* names, size_t num,
+                            StringIDValue name)
+  {
+    /* Branchless binary search: the comparison only selects the base
+       pointer, so it compiles to a conditional move. */
+    const StringIDValue* base = names;
+    size_t n = num;
+    while (n > 1)
+    {
+      size_t half = n / 2;
+      base = (base[half - 1] < name) ? base + half : base;
+      n -= half;
+    }
+    return (base - names) + (((n == 1) && (*base < name)) ? 1 : 0);
   }
-public:
-  SvVarArrayCmp (CS::ShaderVarStringID key) : 
-    csArrayCmp<csShaderVariable*, CS::ShaderVarStringID> (key, SvKeyCompare)
+
+  /// Index of \a name in the sorted \a names or csArrayItemNotFound.
+  static size_t FindName (const StringIDValue* names, size_t num,
+                          StringIDValue name)
   {
+    const StringIDValue* base = names;
+    size_t n = num;
+    while (n > linearSearchNames)
+    {
+      size_t half = n / 2;
+      base = (base[half - 1] < name) ? base + half : base;
+      n -= half;
+    }
+    size_t i = 0;
+#ifdef CS_SVCONTEXT_SSE2
+    // Names are unique, so at most one lane matches.
+    const __m128i key = _mm_set1_epi32 ((int)name);
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*)(base + i));
+      int mask = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (v, key)));
+      if (mask != 0)
+        return (base - names) + i + CS::Utility::BitOps::ComputeBitsSet (
+          uint32 (mask - 1) & 0xf);
+    }
+#endif
+    for (; i < n; i++)
+    {
+      if (base[i] == name) return (base - names) + i;
+    }
+    return csArrayItemNotFound;
   }
-};
+}
+
+size_t ShaderVariableContextImpl::FindVariable (ShaderVarStringID name) const
+{
+  return FindName (names.GetArray (), names.GetSize (), name);
+}
 
-static int SvCompare (csShaderVariable* const& r, csShaderVariable* const& k)
-{ 
-  return r->GetName() - k->GetName();
+size_t ShaderVariableContextImpl::FindInsertPosition (
+  ShaderVarStringID name) const
+{
+  return LowerBound (names.GetArray (), names.GetSize (), name);
 }
+
+void ShaderVariableContextImpl::InsertVariable (size_t index,
+                                                csShaderVariable* variable)
+{
+  variables.Insert (index, variable);
+  names.Insert (index, variable->GetName ());
+}
+
+void ShaderVariableContextImpl::DeleteVariable (size_t index)
+{
+  variables.DeleteIndex (index);
+  names.DeleteIndex (index);
 }
 
 void ShaderVariableContextImpl::AddVariable (csShaderVariable *variable) 
 {
-  csShaderVariable* var = GetVariable (variable->GetName());
-  if (var == 0)
-    variables.InsertSorted (variable, SvCompare);
+  ShaderVarStringID name = variable->GetName ();
+  size_t index = FindInsertPosition (name);
+  if ((index < names.GetSize ()) && (names[index] == name))
+    *variables[index] = *variable;
   else
-    *var = *variable;
+    InsertVariable (index, variable);
 }
 
 csShaderVariable* ShaderVariableContextImpl::GetVariable (
   ShaderVarStringID name) const 
 {
-  size_t index = variables.FindSortedKey (SvVarArrayCmp (name));
+  size_t index = FindVariable (name);
   if (index != csArrayItemNotFound)
     return variables[index];
   return 0;
@@ -72,38 +137,42 @@ csShaderVariable* ShaderVariableContextImpl::GetVariable (
 void ShaderVariableContextImpl::PushVariables (
   csShaderVariableStack& stack) const
 {
-  for (size_t i = 0; i < variables.GetSize (); ++i)
-  {
-    ShaderVarStringID name = variables[i]->GetName ();
-    if (name >= stack.GetSize ())
-      /* Not really an error: can happen if new shader vars are created
-       * after the stack was set up */
-      return;
-    stack[name] = variables[i];
-  }
+  /* Names beyond the stack are not really an error: can happen if new
+   * shader vars are created after the stack was set up. As the names are
+   * sorted they are all at the end. */
+  size_t num = names.GetSize ();
+  if ((num > 0) && (names[num - 1] >= stack.GetSize ()))
+    num = LowerBound (names.GetArray (), num, StringIDValue (stack.GetSize ()));
+  const StringIDValue* nameArray = names.GetArray ();
+  for (size_t i = 0; i < num; ++i)
+    stack[nameArray[i]] = variables[i];
 }
 
 void ShaderVariableContextImpl::ReplaceVariable (csShaderVariable *variable) 
 {
-  size_t index = variables.FindSortedKey (SvVarArrayCmp (
-    variable->GetName()));
-  if (index != csArrayItemNotFound)
+  ShaderVarStringID name = variable->GetName ();
+  size_t index = FindInsertPosition (name);
+  if ((index < names.GetSize ()) && (names[index] == name))
     variables.Put (index, variable);
   else
-    variables.InsertSorted (variable, SvCompare);
+    InsertVariable (index, variable);
 }
 
 bool ShaderVariableContextImpl::RemoveVariable (csShaderVariable* variable)
 {
-  return variables.Delete (variable);
+  size_t index = variables.Find (variable);
+  if (index == csArrayItemNotFound) return false;
+  DeleteVariable (index);
+  return true;
 }
 
 bool ShaderVariableContextImpl::RemoveVariable (ShaderVarStringID name)
 {
-  size_t index = variables.FindSortedKey (SvVarArrayCmp (name));
+  size_t index = FindVariable (name);
   if (index != csArrayItemNotFound)
   {
-      return variables.DeleteIndex (index);
+    DeleteVariable (index);
+    return true;
   }
   return false;
 }
@@ -125,6 +194,7 @@ csShaderVariableContext::csShaderVariableContext (
   scfImplementationType(this), CS::ShaderVariableContextImpl ()
 {
   variables = other.variables;
+  names = other.names;
 }
 
 csShaderVariableContext::~csShaderVariableContext ()
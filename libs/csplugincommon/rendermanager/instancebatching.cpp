@@ -0,0 +1,323 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csplugincommon/rendermanager/instancebatching.h"
+
+#include "imap/loader.h"
+#include "iutil/object.h"
+#include "iutil/objreg.h"
+#include "iutil/vfs.h"
+#include "ivideo/shader/shader.h"
+#include "csutil/stringarray.h"
+
+namespace CS
+{
+  namespace RenderManager
+  {
+    /* Names the instancing variant of a shader named \a name may have, in
+       the order they are tried. */
+    static void GetInstancingNames (const char* name, csStringArray& names)
+    {
+      csString str (name);
+      names.Push (str + "_instance");
+      names.Push (str + "_instanced");
+      for (size_t i = str.Length (); i-- > 1; )
+      {
+        if (str[i] != '_') continue;
+        csString insertName (str);
+        insertName.Insert (i, "_instance");
+        names.Push (insertName);
+      }
+    }
+
+    /* Whether two shader variables have the same value. Some variables,
+       like the light variables, are set up for every mesh, so they can
+       differ even if their values don't. */
+    static bool HaveSameValue (csShaderVariable* sv1, csShaderVariable* sv2)
+    {
+      if (sv1 == sv2) return true;
+      if (!sv1 || !sv2) return false;
+      // Values from accessors may be computed for each mesh
+      if (sv1->GetAccessor () || sv2->GetAccessor ()) return false;
+      if (sv1->GetType () != sv2->GetType ()) return false;
+      switch (sv1->GetType ())
+      {
+        case csShaderVariable::INT:
+          {
+            int v1, v2;
+            sv1->GetValue (v1);
+            sv2->GetValue (v2);
+            return v1 == v2;
+          }
+        case csShaderVariable::FLOAT:
+        case csShaderVariable::VECTOR2:
+        case csShaderVariable::VECTOR3:
+        case csShaderVariable::VECTOR4:
+          {
+            csVector4 v1, v2;
+            sv1->GetValue (v1);
+            sv2->GetValue (v2);
+            return v1 == v2;
+          }
+        case csShaderVariable::TEXTURE:
+          {
+            iTextureWrapper* w1, * w2;
+            iTextureHandle* h1, * h2;
+            sv1->GetValue (w1);
+            sv2->GetValue (w2);
+            sv1->GetValue (h1);
+            sv2->GetValue (h2);
+            return (w1 == w2) && (h1 == h2);
+          }
+        case csShaderVariable::RENDERBUFFER:
+          {
+            iRenderBuffer* b1, * b2;
+            sv1->GetValue (b1);
+            sv2->GetValue (b2);
+            return b1 == b2;
+          }
+        case csShaderVariable::ARRAY:
+          {
+            if (sv1->GetArraySize () != sv2->GetArraySize ()) return false;
+            for (size_t i = 0; i < sv1->GetArraySize (); i++)
+            {
+              if (!HaveSameValue (sv1->GetArrayElement (i),
+                  sv2->GetArrayElement (i)))
+                return false;
+            }
+            return true;
+          }
+        default:
+          return false;
+      }
+    }
+
+    InstanceBatching::InstanceBatching ()
+      : enabled (true), shaderManager (0), objectReg (0),
+        svObjectToWorldName (CS::InvalidShaderVarStringID),
+        svObjectToWorldInvName (CS::InvalidShaderVarStringID),
+        svTransformsName (CS::InvalidShaderVarStringID),
+        svInstancesNumName (CS::InvalidShaderVarStringID),
+        usedBatches (0), usedTransforms (0)
+    {
+    }
+
+    void InstanceBatching::Initialize (iShaderManager* shmgr)
+    {
+      shaderManager = shmgr;
+      iShaderVarStringSet* strings = shmgr->GetSVNameStringset ();
+      svObjectToWorldName = strings->Request ("object2world transform");
+      svObjectToWorldInvName =
+        strings->Request ("object2world transform inverse");
+      svTransformsName = strings->Request ("instancing transforms");
+      svInstancesNumName = strings->Request ("instances num");
+    }
+
+    void InstanceBatching::EnableShaderLoading (iObjectRegistry* objectReg)
+    {
+      this->objectReg = objectReg;
+    }
+
+    void InstanceBatching::ClearBatches ()
+    {
+      usedBatches = 0;
+      usedTransforms = 0;
+    }
+
+    bool InstanceBatching::IsInstanceable (const csRenderMesh* leader,
+                                           const csRenderMesh* mesh)
+    {
+      // Same geometry...
+      if ((leader->geometryInstance == 0)
+          || (leader->geometryInstance != mesh->geometryInstance)
+          || (leader->meshtype != mesh->meshtype)
+          || (leader->indexstart != mesh->indexstart)
+          || (leader->indexend != mesh->indexend)
+          || (leader->multiRanges != 0) || (mesh->multiRanges != 0))
+        return false;
+      // ...same material and render state...
+      if ((leader->material != mesh->material)
+          || (leader->mixmode != mesh->mixmode)
+          || (leader->alphaToCoverage != mesh->alphaToCoverage)
+          || (leader->cullMode != mesh->cullMode)
+          || (leader->alphaType != mesh->alphaType)
+          || (leader->zoffset != mesh->zoffset)
+          || (leader->do_mirror != mesh->do_mirror)
+          || (leader->clip_portal != mesh->clip_portal)
+          || (leader->clip_plane != mesh->clip_plane)
+          || (leader->clip_z_plane != mesh->clip_z_plane))
+        return false;
+      // ...and not special in some other way
+      if (leader->portal || mesh->portal
+          || leader->doInstancing || mesh->doInstancing)
+        return false;
+
+      // The buffers must be the same as well (not just the holders)
+      if (leader->buffers != mesh->buffers)
+      {
+        if (!leader->buffers || !mesh->buffers) return false;
+        for (int b = CS_BUFFER_INDEX; b < CS_BUFFER_COUNT; b++)
+        {
+          csRenderBufferName name = csRenderBufferName (b);
+          if (leader->buffers->GetRenderBuffer (name)
+              != mesh->buffers->GetRenderBuffer (name))
+            return false;
+        }
+      }
+      return true;
+    }
+
+    bool InstanceBatching::HasSameShaderVars (
+      const csShaderVariableStack& leaderStack,
+      const csShaderVariableStack& stack, const csBitArray& usedSVs) const
+    {
+      CS_ASSERT (leaderStack.GetSize () == stack.GetSize ());
+      const size_t num = csMin (stack.GetSize (), usedSVs.GetSize ());
+      for (size_t i = 0; i < num; i++)
+      {
+        if (!usedSVs.IsBitSet (i)) continue;
+        // Differences in the object to world transform are expected
+        if ((i == size_t (svObjectToWorldName))
+            || (i == size_t (svObjectToWorldInvName)))
+          continue;
+        // The first mesh of a batch may have the instancing variables already
+        if ((i == size_t (svTransformsName))
+            || (i == size_t (svInstancesNumName)))
+          continue;
+        if (!HaveSameValue (leaderStack[i], stack[i])) return false;
+      }
+      return true;
+    }
+
+    bool InstanceBatching::CanLeadBatch (
+      const csShaderVariableStack& stack) const
+    {
+      if ((size_t (svTransformsName) >= stack.GetSize ())
+          || (size_t (svInstancesNumName) >= stack.GetSize ()))
+        return false;
+      return (stack[svTransformsName] == 0)
+        && (stack[svInstancesNumName] == 0);
+    }
+
+    iShader* InstanceBatching::GetInstancingShader (iShader* shader)
+    {
+      const InstancingShader* cached =
+        instancingShaders.GetElementPointer (shader);
+      if (cached) return cached->instancing;
+
+      InstancingShader entry;
+      entry.shader = shader;
+      entry.instancing = FindInstancingShader (shader);
+      instancingShaders.Put (shader, entry);
+      return entry.instancing;
+    }
+
+    csPtr<iShader> InstanceBatching::FindInstancingShader (iShader* shader)
+    {
+      const char* name = shader->QueryObject ()->GetName ();
+      if (!name || !shaderManager) return 0;
+
+      csStringArray names;
+      GetInstancingNames (name, names);
+      for (size_t i = 0; i < names.GetSize (); i++)
+      {
+        csRef<iShader> instShader (shaderManager->GetShader (names[i]));
+        if (instShader) return csPtr<iShader> (instShader);
+      }
+
+      // Try the files next to the file the shader was loaded from
+      const char* fileName = shader->GetFileName ();
+      if (!objectReg || !fileName || (*fileName != '/')) return 0;
+      csRef<iVFS> vfs (csQueryRegistry<iVFS> (objectReg));
+      csRef<iLoader> loader (csQueryRegistry<iLoader> (objectReg));
+      if (!vfs || !loader) return 0;
+
+      csString path (fileName);
+      size_t slash = path.FindLast ('/');
+      csString dir (path.Slice (0, slash + 1));
+      csString base (path.Slice (slash + 1));
+      if (base.EndsWith (".xml")) base.Truncate (base.Length () - 4);
+
+      names.Empty ();
+      GetInstancingNames (base, names);
+      for (size_t i = 0; i < names.GetSize (); i++)
+      {
+        csString file (dir + names[i] + ".xml");
+        if (!vfs->Exists (file)) continue;
+        csRef<iShader> instShader (loader->LoadShader (file));
+        if (instShader) return csPtr<iShader> (instShader);
+      }
+      return 0;
+    }
+
+    void InstanceBatching::BeginBatch ()
+    {
+      if (usedBatches >= transformArrays.GetSize ())
+      {
+        csRef<csShaderVariable> array;
+        array.AttachNew (new csShaderVariable (svTransformsName));
+        array->SetType (csShaderVariable::ARRAY);
+        transformArrays.Push (array);
+
+        csRef<csShaderVariable> num;
+        num.AttachNew (new csShaderVariable (svInstancesNumName));
+        instancesNums.Push (num);
+      }
+      transformArrays[usedBatches]->SetArraySize (0);
+    }
+
+    void InstanceBatching::AddInstance (
+      const csReversibleTransform& object2world)
+    {
+      csShaderVariable* batchTransforms = transformArrays[usedBatches];
+      if (batchTransforms->GetArraySize () == 0)
+        leaderInverse = object2world.GetInverse ();
+
+      if (usedTransforms >= transforms.GetSize ())
+      {
+        csRef<csShaderVariable> sv;
+        sv.AttachNew (new csShaderVariable);
+        transforms.Push (sv);
+      }
+      csShaderVariable* sv = transforms[usedTransforms++];
+      /* The instance transform is applied before the object to world
+         transform of the first mesh, so undo the latter. */
+      sv->SetValue (leaderInverse * object2world);
+      batchTransforms->AddVariableToArray (sv);
+    }
+
+    void InstanceBatching::EndBatch (csShaderVariableStack& stack)
+    {
+      csShaderVariable* batchTransforms = transformArrays[usedBatches];
+      csShaderVariable* instancesNum = instancesNums[usedBatches];
+      usedBatches++;
+      instancesNum->SetValue (int (batchTransforms->GetArraySize ()));
+      stack[svTransformsName] = batchTransforms;
+      stack[svInstancesNumName] = instancesNum;
+    }
+
+    void InstanceBatching::RemoveBatchShaderVars (
+      csShaderVariableStack& stack) const
+    {
+      stack[svTransformsName] = 0;
+      stack[svInstancesNumName] = 0;
+    }
+  } // namespace RenderManager
+} // namespace CS
@@ -1462,6 +1462,132 @@ namespace CS
       TraverseTreePlanes(this, viscallback, planes, (1 << num_planes) - 1);
     }
 
+    //======== VisTest views ===================================================
+    struct csOccluvis::ViewsData
+    {
+      csVisibilityCullerView const* views;
+      size_t numViews;
+
+      // index of the objects found so far
+      csHash<size_t, csPtrKey<VisTreeNode> > objectIndex;
+      csArray<VisTreeNode*> objects;
+
+      // for every object: the views it was tested against, the views it is
+      // visible in and the clip masks for all views
+      csDirtyAccessArray<uint32> masks;
+    };
+
+    void csOccluvis::TraverseTreeViews(VisTree* node, ViewsData& data,
+                                       uint32 viewMask,
+                                       uint32 const* frustumMasks)
+    {
+      size_t const stride = data.numViews + 2;
+
+      // find the views the node's bbox intersects with
+      uint32 nodeMasks[32];
+      uint32 nodeViews = 0;
+      for(size_t v = 0; v < data.numViews; ++v)
+      {
+        if(!(viewMask & (uint32(1) << v)))
+          continue;
+
+        if(csIntersect3::BoxFrustum(node->GetNodeBBox(), data.views[v].planes,
+                                    frustumMasks[v], nodeMasks[v]))
+        {
+          nodeViews |= uint32(1) << v;
+        }
+      }
+
+      // not visible in any view, we're done
+      if(!nodeViews)
+        return;
+
+      // get all objects in this node
+      VisTreeNode** objects = node->GetObjects();
+
+      // go over all of them
+      for(int i = 0; i < node->GetObjectCount(); ++i)
+      {
+	// get object
+	VisTreeNode* object = objects[i];
+
+	// skip invisible meshes
+	iMeshWrapper* mesh = GetNodeVisObject(object)->GetMeshWrapper();
+	if(mesh && mesh->GetFlags().Check(CS_ENTITY_INVISIBLEMESH))
+	  continue;
+
+	// get the results for this object, objects may be in several nodes
+	size_t index = data.objectIndex.Get(object, csArrayItemNotFound);
+	if(index == csArrayItemNotFound)
+	{
+	  index = data.objects.Push(object);
+	  data.objectIndex.Put(object, index);
+	  data.masks.SetSize(data.masks.GetSize() + stride, 0);
+	}
+	uint32* masks = data.masks.GetArray() + index * stride;
+
+	// test it against the views it wasn't tested against yet
+	uint32 testViews = nodeViews & ~masks[0];
+	masks[0] |= testViews;
+	for(size_t v = 0; v < data.numViews; ++v)
+	{
+	  if(!(testViews & (uint32(1) << v)))
+	    continue;
+
+	  if(csIntersect3::BoxFrustum(object->GetBBox(), data.views[v].planes,
+	                              nodeMasks[v], masks[2 + v]))
+	  {
+	    masks[1] |= uint32(1) << v;
+	  }
+	}
+      }
+
+      // check whether this node has childs
+      if(node->GetChild1())
+      {
+	// continue traversal
+        TraverseTreeViews(node->GetChild1(), data, nodeViews, nodeMasks);
+        TraverseTreeViews(node->GetChild2(), data, nodeViews, nodeMasks);
+      }
+    }
+
+    void csOccluvis::VisTest(csVisibilityCullerView const* views, size_t numViews,
+                              iVisibilityCullerMultiViewListener* viscallback)
+    {
+      CS_ASSERT(numViews <= 32);
+      if(numViews > 32)
+        numViews = 32;
+
+      ViewsData data;
+      data.views = views;
+      data.numViews = numViews;
+
+      // start with all planes of all views
+      uint32 viewMask = 0;
+      uint32 frustumMasks[32];
+      for(size_t v = 0; v < numViews; ++v)
+      {
+        viewMask |= uint32(1) << v;
+        frustumMasks[v] = views[v].planes_mask;
+      }
+
+      // traverse tree performing the visibility test for all views
+      if(viewMask)
+        TraverseTreeViews(this, data, viewMask, frustumMasks);
+
+      // notify listener about all objects visible in any view
+      size_t const stride = numViews + 2;
+      for(size_t i = 0; i < data.objects.GetSize(); ++i)
+      {
+        uint32 const* masks = data.masks.GetArray() + i * stride;
+        if(!masks[1])
+          continue;
+
+        iVisibilityObject* visobj = GetNodeVisObject(data.objects[i]);
+        viscallback->ObjectVisible(visobj, visobj->GetMeshWrapper(), masks[1], masks + 2);
+      }
+    }
+
     //======== IntersectSegment ================================================
 
     // hitbeam tracing for objects, if sloppy is true, add all objects that may intersect
@@ -0,0 +1,464 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "imesh/animesh.h"
+#include "imesh/skeleton2.h"
+#include "iutil/job.h"
+#include "csutil/parallelfor.h"
+#include "csutil/processorspecdetection.h"
+#include "cstool/animeshskinning.h"
+
+#if defined (CS_PROCESSOR_X86) && (defined (__SSE__) || defined (_M_X64) \
+  || (defined (_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define CS_ANIMESHSKINNING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace CS {
+namespace Mesh {
+
+namespace
+{
+  // Used in place of the bone transform for influences without weight
+  static const csDualQuaternion zeroTransform (csQuaternion (0,0,0,0),
+    csQuaternion (0,0,0,0));
+
+  template<bool SkinV, bool SkinN, bool SkinTB>
+  void SkinScalar (const csDualQuaternion* bones,
+                   const DualQuaternionSkinner::Buffers& buffers,
+                   const AnimatedMeshBoneInfluence* influences,
+                   size_t influencesPerVertex, size_t first, size_t last)
+  {
+    const AnimatedMeshBoneInfluence* influence =
+      influences + first * influencesPerVertex;
+
+    for (size_t i = first; i < last; ++i)
+    {
+      // Accumulate data for the vertex
+      int numInfluences = 0;
+
+      csDualQuaternion dq (csQuaternion (0,0,0,0), csQuaternion (0,0,0,0));
+      csQuaternion pivot;
+
+      for (size_t j = 0; j < influencesPerVertex; ++j, ++influence)
+      {
+        if (influence->influenceWeight > SMALL_EPSILON)
+        {
+          numInfluences++;
+
+          const csDualQuaternion& inflQuat = bones[influence->bone];
+          float weight = influence->influenceWeight;
+
+          if (numInfluences == 1)
+          {
+            pivot = inflQuat.real;
+          }
+          else if (inflQuat.real.Dot (pivot) < -SMALL_EPSILON)
+          {
+            weight = -weight;
+          }
+
+          dq += inflQuat * weight;
+        }
+      }
+
+      if (numInfluences == 0)
+      {
+        if (SkinV) buffers.dstVertices[i] = buffers.srcVertices[i];
+        if (SkinN) buffers.dstNormals[i] = buffers.srcNormals[i];
+        if (SkinTB)
+        {
+          buffers.dstTangents[i] = buffers.srcTangents[i];
+          buffers.dstBinormals[i] = buffers.srcBinormals[i];
+        }
+      }
+      else
+      {
+        dq = dq.Unit ();
+
+        if (SkinV)
+          buffers.dstVertices[i] = dq.TransformPoint (buffers.srcVertices[i]);
+        if (SkinN)
+          buffers.dstNormals[i] = dq.Transform (buffers.srcNormals[i]);
+        if (SkinTB)
+        {
+          buffers.dstTangents[i] = dq.Transform (buffers.srcTangents[i]);
+          buffers.dstBinormals[i] = dq.Transform (buffers.srcBinormals[i]);
+        }
+      }
+    }
+  }
+
+#ifdef CS_ANIMESHSKINNING_SSE
+  /// Three float components of four vertices
+  struct Vector3x4
+  {
+    __m128 x, y, z;
+  };
+
+  static CS_FORCEINLINE Vector3x4 Cross (const Vector3x4& a, const Vector3x4& b)
+  {
+    Vector3x4 r;
+    r.x = _mm_sub_ps (_mm_mul_ps (a.y, b.z), _mm_mul_ps (a.z, b.y));
+    r.y = _mm_sub_ps (_mm_mul_ps (a.z, b.x), _mm_mul_ps (a.x, b.z));
+    r.z = _mm_sub_ps (_mm_mul_ps (a.x, b.y), _mm_mul_ps (a.y, b.x));
+    return r;
+  }
+
+  static CS_FORCEINLINE Vector3x4 Load (const csVector3* v)
+  {
+    Vector3x4 r;
+    r.x = _mm_setr_ps (v[0].x, v[1].x, v[2].x, v[3].x);
+    r.y = _mm_setr_ps (v[0].y, v[1].y, v[2].y, v[3].y);
+    r.z = _mm_setr_ps (v[0].z, v[1].z, v[2].z, v[3].z);
+    return r;
+  }
+
+  static CS_FORCEINLINE void Store (csVector3* dst, const Vector3x4& v,
+                                    const Vector3x4& src, __m128 useSrc)
+  {
+    CS_ALIGNED_MEMBER(float x[4], 16);
+    CS_ALIGNED_MEMBER(float y[4], 16);
+    CS_ALIGNED_MEMBER(float z[4], 16);
+    _mm_store_ps (x, _mm_or_ps (_mm_and_ps (useSrc, src.x),
+      _mm_andnot_ps (useSrc, v.x)));
+    _mm_store_ps (y, _mm_or_ps (_mm_and_ps (useSrc, src.y),
+      _mm_andnot_ps (useSrc, v.y)));
+    _mm_store_ps (z, _mm_or_ps (_mm_and_ps (useSrc, src.z),
+      _mm_andnot_ps (useSrc, v.z)));
+    for (int k = 0; k < 4; k++)
+      dst[k].Set (x[k], y[k], z[k]);
+  }
+
+  /// Four blended dual quaternions
+  struct DualQuaternionx4
+  {
+    Vector3x4 realV, dualV;
+    __m128 realW, dualW;
+
+    /// Rotate \a v (dual quaternion Transform())
+    CS_FORCEINLINE Vector3x4 Rotate (const Vector3x4& v) const
+    {
+      Vector3x4 c = Cross (realV, v);
+      c.x = _mm_add_ps (c.x, _mm_mul_ps (realW, v.x));
+      c.y = _mm_add_ps (c.y, _mm_mul_ps (realW, v.y));
+      c.z = _mm_add_ps (c.z, _mm_mul_ps (realW, v.z));
+      Vector3x4 r = Cross (realV, c);
+      const __m128 two = _mm_set1_ps (2.0f);
+      r.x = _mm_add_ps (v.x, _mm_mul_ps (two, r.x));
+      r.y = _mm_add_ps (v.y, _mm_mul_ps (two, r.y));
+      r.z = _mm_add_ps (v.z, _mm_mul_ps (two, r.z));
+      return r;
+    }
+
+    /// Transform the point \a v (dual quaternion TransformPoint())
+    CS_FORCEINLINE Vector3x4 TransformPoint (const Vector3x4& v) const
+    {
+      Vector3x4 r = Rotate (v);
+      Vector3x4 t = Cross (realV, dualV);
+      const __m128 two = _mm_set1_ps (2.0f);
+      t.x = _mm_add_ps (t.x, _mm_sub_ps (_mm_mul_ps (realW, dualV.x),
+        _mm_mul_ps (dualW, realV.x)));
+      t.y = _mm_add_ps (t.y, _mm_sub_ps (_mm_mul_ps (realW, dualV.y),
+        _mm_mul_ps (dualW, realV.y)));
+      t.z = _mm_add_ps (t.z, _mm_sub_ps (_mm_mul_ps (realW, dualV.z),
+        _mm_mul_ps (dualW, realV.z)));
+      r.x = _mm_add_ps (r.x, _mm_mul_ps (two, t.x));
+      r.y = _mm_add_ps (r.y, _mm_mul_ps (two, t.y));
+      r.z = _mm_add_ps (r.z, _mm_mul_ps (two, t.z));
+      return r;
+    }
+  };
+
+  static CS_FORCEINLINE __m128 Select (__m128 mask, __m128 a, __m128 b)
+  {
+    return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+  }
+
+  /**
+   * Blend the bone transforms for the four vertices starting at \a first.
+   * Same semantics as the scalar code: influences not heavier than
+   * SMALL_EPSILON are ignored, influences pointing away from the first one
+   * are flipped. Returns the mask of vertices without any influence.
+   */
+  static CS_FORCEINLINE __m128 Blend (const csDualQuaternion* bones,
+    const AnimatedMeshBoneInfluence* influences, size_t influencesPerVertex,
+    DualQuaternionx4& dq)
+  {
+    const __m128 zero = _mm_setzero_ps ();
+    const __m128 epsilon = _mm_set1_ps (SMALL_EPSILON);
+    const __m128 minusEpsilon = _mm_set1_ps (-SMALL_EPSILON);
+    const __m128 signMask = _mm_set1_ps (-0.0f);
+
+    __m128 rx = zero, ry = zero, rz = zero, rw = zero;
+    __m128 dx = zero, dy = zero, dz = zero, dw = zero;
+    __m128 px = zero, py = zero, pz = zero, pw = zero;
+    __m128 hasPivot = zero;
+
+    for (size_t j = 0; j < influencesPerVertex; j++)
+    {
+      const float* boneData[4];
+      float weights[4];
+      for (int k = 0; k < 4; k++)
+      {
+        const AnimatedMeshBoneInfluence& infl =
+          influences[k * influencesPerVertex + j];
+        weights[k] = infl.influenceWeight;
+        const csDualQuaternion& bone = (infl.influenceWeight > SMALL_EPSILON)
+          ? bones[infl.bone] : zeroTransform;
+        boneData[k] = &bone.real.v.x;
+      }
+
+      __m128 weight = _mm_loadu_ps (weights);
+      const __m128 valid = _mm_cmpgt_ps (weight, epsilon);
+      weight = _mm_and_ps (weight, valid);
+
+      // Transpose bone data into SoA form
+      __m128 qrx = _mm_loadu_ps (boneData[0]);
+      __m128 qry = _mm_loadu_ps (boneData[1]);
+      __m128 qrz = _mm_loadu_ps (boneData[2]);
+      __m128 qrw = _mm_loadu_ps (boneData[3]);
+      _MM_TRANSPOSE4_PS (qrx, qry, qrz, qrw);
+      __m128 qdx = _mm_loadu_ps (boneData[0] + 4);
+      __m128 qdy = _mm_loadu_ps (boneData[1] + 4);
+      __m128 qdz = _mm_loadu_ps (boneData[2] + 4);
+      __m128 qdw = _mm_loadu_ps (boneData[3] + 4);
+      _MM_TRANSPOSE4_PS (qdx, qdy, qdz, qdw);
+
+      // Flip influences on the other side of the pivot
+      const __m128 dot = _mm_add_ps (
+        _mm_add_ps (_mm_mul_ps (qrx, px), _mm_mul_ps (qry, py)),
+        _mm_add_ps (_mm_mul_ps (qrz, pz), _mm_mul_ps (qrw, pw)));
+      const __m128 flip = _mm_and_ps (hasPivot, _mm_cmplt_ps (dot, minusEpsilon));
+      weight = _mm_xor_ps (weight, _mm_and_ps (flip, signMask));
+
+      // The first influence of a vertex becomes its pivot
+      const __m128 newPivot = _mm_andnot_ps (hasPivot, valid);
+      px = Select (newPivot, qrx, px);
+      py = Select (newPivot, qry, py);
+      pz = Select (newPivot, qrz, pz);
+      pw = Select (newPivot, qrw, pw);
+      hasPivot = _mm_or_ps (hasPivot, valid);
+
+      rx = _mm_add_ps (rx, _mm_mul_ps (qrx, weight));
+      ry = _mm_add_ps (ry, _mm_mul_ps (qry, weight));
+      rz = _mm_add_ps (rz, _mm_mul_ps (qrz, weight));
+      rw = _mm_add_ps (rw, _mm_mul_ps (qrw, weight));
+      dx = _mm_add_ps (dx, _mm_mul_ps (qdx, weight));
+      dy = _mm_add_ps (dy, _mm_mul_ps (qdy, weight));
+      dz = _mm_add_ps (dz, _mm_mul_ps (qdz, weight));
+      dw = _mm_add_ps (dw, _mm_mul_ps (qdw, weight));
+    }
+
+    // Normalize (csDualQuaternion::Unit())
+    const __m128 lenReal = _mm_sqrt_ps (_mm_add_ps (
+      _mm_add_ps (_mm_mul_ps (rx, rx), _mm_mul_ps (ry, ry)),
+      _mm_add_ps (_mm_mul_ps (rz, rz), _mm_mul_ps (rw, rw))));
+    const __m128 lenRealInv = Select (_mm_cmpgt_ps (lenReal, zero),
+      _mm_div_ps (_mm_set1_ps (1.0f), lenReal), _mm_set1_ps (1.0f));
+    rx = _mm_mul_ps (rx, lenRealInv);
+    ry = _mm_mul_ps (ry, lenRealInv);
+    rz = _mm_mul_ps (rz, lenRealInv);
+    rw = _mm_mul_ps (rw, lenRealInv);
+    dx = _mm_mul_ps (dx, lenRealInv);
+    dy = _mm_mul_ps (dy, lenRealInv);
+    dz = _mm_mul_ps (dz, lenRealInv);
+    dw = _mm_mul_ps (dw, lenRealInv);
+    const __m128 rd = _mm_add_ps (
+      _mm_add_ps (_mm_mul_ps (rx, dx), _mm_mul_ps (ry, dy)),
+      _mm_add_ps (_mm_mul_ps (rz, dz), _mm_mul_ps (rw, dw)));
+    dq.realV.x = rx;
+    dq.realV.y = ry;
+    dq.realV.z = rz;
+    dq.realW = rw;
+    dq.dualV.x = _mm_sub_ps (dx, _mm_mul_ps (rx, rd));
+    dq.dualV.y = _mm_sub_ps (dy, _mm_mul_ps (ry, rd));
+    dq.dualV.z = _mm_sub_ps (dz, _mm_mul_ps (rz, rd));
+    dq.dualW = _mm_sub_ps (dw, _mm_mul_ps (rw, rd));
+
+    return _mm_cmpeq_ps (hasPivot, zero);
+  }
+
+  template<bool SkinV, bool SkinN, bool SkinTB>
+  void SkinSSE (const csDualQuaternion* bones,
+                const DualQuaternionSkinner::Buffers& buffers,
+                const AnimatedMeshBoneInfluence* influences,
+                size_t influencesPerVertex, size_t first, size_t last)
+  {
+    size_t i = first;
+    for (; i + 4 <= last; i += 4)
+    {
+      DualQuaternionx4 dq;
+      const __m128 noInfluence = Blend (bones,
+        influences + i * influencesPerVertex, influencesPerVertex, dq);
+
+      if (SkinV)
+      {
+        Vector3x4 v = Load (buffers.srcVertices + i);
+        Store (buffers.dstVertices + i, dq.TransformPoint (v), v, noInfluence);
+      }
+      if (SkinN)
+      {
+        Vector3x4 v = Load (buffers.srcNormals + i);
+        Store (buffers.dstNormals + i, dq.Rotate (v), v, noInfluence);
+      }
+      if (SkinTB)
+      {
+        Vector3x4 t = Load (buffers.srcTangents + i);
+        Store (buffers.dstTangents + i, dq.Rotate (t), t, noInfluence);
+        Vector3x4 b = Load (buffers.srcBinormals + i);
+        Store (buffers.dstBinormals + i, dq.Rotate (b), b, noInfluence);
+      }
+    }
+
+    // Remaining vertices
+    SkinScalar<SkinV, SkinN, SkinTB> (bones, buffers, influences,
+      influencesPerVertex, i, last);
+  }
+#endif // CS_ANIMESHSKINNING_SSE
+
+  typedef void (*SkinFunc) (const csDualQuaternion*,
+    const DualQuaternionSkinner::Buffers&, const AnimatedMeshBoneInfluence*,
+    size_t, size_t, size_t);
+
+  template<bool SkinV, bool SkinN, bool SkinTB>
+  SkinFunc GetSkinFunc (bool useSIMD)
+  {
+#ifdef CS_ANIMESHSKINNING_SSE
+    if (useSIMD) return &SkinSSE<SkinV, SkinN, SkinTB>;
+#endif
+    return &SkinScalar<SkinV, SkinN, SkinTB>;
+  }
+
+  /// Skins the vertex ranges handed out by SkinParallel()
+  struct SkinRange
+  {
+    const DualQuaternionSkinner* skinner;
+    const DualQuaternionSkinner::Buffers* buffers;
+    const AnimatedMeshBoneInfluence* influences;
+    size_t influencesPerVertex;
+
+    void operator() (size_t first, size_t last)
+    {
+      skinner->Skin (*buffers, influences, influencesPerVertex, first, last);
+    }
+  };
+}
+
+DualQuaternionSkinner::DualQuaternionSkinner ()
+  : useSIMD (IsSIMDAvailable ())
+{
+}
+
+bool DualQuaternionSkinner::IsSIMDAvailable ()
+{
+#ifdef CS_ANIMESHSKINNING_SSE
+  static int available = -1;
+  if (available < 0)
+  {
+    CS::Platform::ProcessorSpecDetection procSpec;
+    available = procSpec.HasSSE () ? 1 : 0;
+  }
+  return available != 0;
+#else
+  return false;
+#endif
+}
+
+void DualQuaternionSkinner::SetSIMDEnabled (bool enable)
+{
+  useSIMD = enable && IsSIMDAvailable ();
+}
+
+void DualQuaternionSkinner::SetupBones (
+  const CS::Animation::AnimatedMeshState* state)
+{
+  const size_t numBones = state->GetBoneCount ();
+  boneTransforms.SetSize (numBones);
+  for (size_t b = 0; b < numBones; b++)
+  {
+    boneTransforms[b] = csDualQuaternion (state->GetQuaternion (b),
+      state->GetVector (b));
+  }
+}
+
+void DualQuaternionSkinner::SetupBones (const csQuaternion* rotations,
+                                        const csVector3* offsets,
+                                        size_t numBones)
+{
+  boneTransforms.SetSize (numBones);
+  for (size_t b = 0; b < numBones; b++)
+    boneTransforms[b] = csDualQuaternion (rotations[b], offsets[b]);
+}
+
+void DualQuaternionSkinner::Skin (const Buffers& buffers,
+                                  const AnimatedMeshBoneInfluence* influences,
+                                  size_t influencesPerVertex,
+                                  size_t first, size_t last) const
+{
+  if (first >= last) return;
+
+  const bool skinV = buffers.dstVertices != 0;
+  const bool skinN = buffers.dstNormals != 0;
+  const bool skinTB = buffers.dstTangents != 0;
+
+  SkinFunc skin;
+  if (skinV)
+  {
+    if (skinN)
+      skin = skinTB ? GetSkinFunc<true, true, true> (useSIMD)
+                    : GetSkinFunc<true, true, false> (useSIMD);
+    else
+      skin = skinTB ? GetSkinFunc<true, false, true> (useSIMD)
+                    : GetSkinFunc<true, false, false> (useSIMD);
+  }
+  else
+  {
+    if (skinN)
+      skin = skinTB ? GetSkinFunc<false, true, true> (useSIMD)
+                    : GetSkinFunc<false, true, false> (useSIMD);
+    else if (skinTB)
+      skin = GetSkinFunc<false, false, true> (useSIMD);
+    else
+      return;
+  }
+
+  skin (boneTransforms.GetArray (), buffers, influences, influencesPerVertex,
+    first, last);
+}
+
+void DualQuaternionSkinner::SkinParallel (iJobQueue* jobQueue,
+                                          size_t numWorkers,
+                                          const Buffers& buffers,
+                                          const AnimatedMeshBoneInfluence* influences,
+                                          size_t influencesPerVertex,
+                                          size_t numVertices,
+                                          size_t batchSize) const
+{
+  SkinRange skinRange;
+  skinRange.skinner = this;
+  skinRange.buffers = &buffers;
+  skinRange.influences = influences;
+  skinRange.influencesPerVertex = influencesPerVertex;
+  CS::Threading::ParallelFor (jobQueue, numWorkers, numVertices,
+    csMax (batchSize, size_t (4)), skinRange);
+}
+
+} // namespace Mesh
+} // namespace CS
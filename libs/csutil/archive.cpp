@@ -21,9 +21,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include "csgeom/math.h"
 #include "csutil/archive.h"
 #include "csutil/csendian.h"
 #include "csutil/csstring.h"
+#include "csutil/parasiticdatabuffer.h"
 #include "csutil/physfile.h"
 #include "csutil/set.h"
 #include "csutil/snprintf.h"
@@ -78,6 +80,7 @@ csArchive::csArchive (const char *filename)
 {
   comment = 0;
   comment_length = 0;
+  preserveFile = false;
   csArchive::filename = CS::StrDup (filename);
 
   file.AttachNew (new csPhysicalFile (filename, "rb"));
@@ -468,6 +471,43 @@ bool csArchive::ReadEntry (iFile* infile, ArchiveEntry * f, char* out_buff)
   return true;
 }
 
+bool csArchive::OpenEntryStream (void *entry, iDataBuffer* archiveData,
+                                  csArchiveEntryStream& stream) const
+{
+  stream.Reset ();
+  ArchiveEntry* f = (ArchiveEntry*)entry;
+  if (!f || !archiveData) return false;
+  if ((f->info.compression_method != ZIP_STORE)
+      && (f->info.compression_method != ZIP_DEFLATE))
+    return false;
+
+  /* The local header may have different name and extra field lengths than
+     the central directory, so look at it to find the file data. */
+  const size_t archiveSize = archiveData->GetSize ();
+  const size_t lfhOffset = f->info.relative_offset_local_header;
+  const size_t lfhEnd = lfhOffset + sizeof (hdr_local)
+    + ZIP_LOCAL_FILE_HEADER_SIZE;
+  if (lfhEnd > archiveSize)
+    return false;
+  const char* lfh = archiveData->GetData () + lfhOffset;
+  if (memcmp (lfh, hdr_local, sizeof (hdr_local)) != 0)
+    return false;
+  const char* buff = lfh + sizeof (hdr_local);
+  const size_t dataOffset = lfhEnd + BUFF_GET_SHORT (L_FILENAME_LENGTH)
+    + BUFF_GET_SHORT (L_EXTRA_FIELD_LENGTH);
+  // Sizes from the local header may be 0 if a data descriptor is used
+  if ((dataOffset > archiveSize)
+      || (archiveSize - dataOffset < f->info.csize))
+    return false;
+
+  stream.archiveData = archiveData;
+  stream.dataOffset = dataOffset;
+  stream.csize = f->info.csize;
+  stream.ucsize = f->info.ucsize;
+  stream.method = f->info.compression_method;
+  return true;
+}
+
 void *csArchive::NewFile (const char *name, size_t size, bool pack)
 {
   DeleteFile (name);
@@ -670,6 +710,13 @@ skip_entry:
 
     temp->SetPos (0);
 
+    if (preserveFile)
+    {
+      /* Remove the old file instead of truncating it, so memory mappings
+         of it keep seeing the old contents. */
+      file.Invalidate ();
+      unlink (filename);
+    }
     file.AttachNew (new csPhysicalFile (filename, "wb"));
     if (file->GetStatus() != VFS_STATUS_OK)
     {
@@ -1133,3 +1180,119 @@ bool csArchive::ArchiveEntry::WriteFile (iFile* outfile)
   outfile->SetPos (outfile->GetPos() + info.csize);
   return true;
 }
+
+//-- csArchiveEntryStream ---------------------------------------------------
+
+csArchiveEntryStream::csArchiveEntryStream () : dataOffset (0), csize (0),
+  ucsize (0), method (ZIP_STORE), pos (0), inflateUsed (false), consumed (0)
+{
+}
+
+csArchiveEntryStream::~csArchiveEntryStream ()
+{
+  Reset ();
+}
+
+void csArchiveEntryStream::Reset ()
+{
+  if (inflateUsed) inflateEnd (&zs);
+  inflateUsed = false;
+  archiveData.Invalidate ();
+  dataOffset = csize = ucsize = 0;
+  method = ZIP_STORE;
+  pos = 0;
+  consumed = 0;
+}
+
+bool csArchiveEntryStream::RestartInflate ()
+{
+  int err;
+  if (inflateUsed)
+    err = inflateReset (&zs);
+  else
+  {
+    memset (&zs, 0, sizeof (zs));
+    /* Undocumented: if wbits is negative, zlib skips header check */
+    err = inflateInit2 (&zs, -DEF_WBITS);
+  }
+  inflateUsed = (err == Z_OK);
+  consumed = 0;
+  pos = 0;
+  return inflateUsed;
+}
+
+size_t csArchiveEntryStream::Inflate (char* data, size_t size)
+{
+  if (!inflateUsed && !RestartInflate ())
+    return 0;
+
+  // zlib counts in uInt
+  const size_t maxChunk = 1u << 30;
+  const z_Byte* compData =
+    (const z_Byte*)archiveData->GetData () + dataOffset;
+  size_t done = 0;
+  while (done < size)
+  {
+    const size_t outChunk = csMin (size - done, maxChunk);
+    const size_t inChunk = csMin (csize - consumed, maxChunk);
+    zs.next_out = (z_Byte*)data + done;
+    zs.avail_out = (uInt)outChunk;
+    zs.next_in = const_cast<z_Byte*> (compData + consumed);
+    zs.avail_in = (uInt)inChunk;
+
+    int err = inflate (&zs, Z_SYNC_FLUSH);
+    consumed += inChunk - zs.avail_in;
+    const size_t produced = outChunk - zs.avail_out;
+    done += produced;
+    if ((err != Z_OK) || (produced == 0))
+      break;  // End of data, or broken data
+  }
+  return done;
+}
+
+size_t csArchiveEntryStream::Read (char* data, size_t size)
+{
+  if (!archiveData) return 0;
+  size = csMin (size, ucsize - pos);
+  if (size == 0) return 0;
+
+  size_t read;
+  if (method == ZIP_STORE)
+  {
+    memcpy (data, archiveData->GetData () + dataOffset + pos, size);
+    read = size;
+  }
+  else
+    read = Inflate (data, size);
+  pos += read;
+  return read;
+}
+
+bool csArchiveEntryStream::SetPos (size_t newPos)
+{
+  if (!archiveData) return false;
+  newPos = csMin (newPos, ucsize);
+  if ((method == ZIP_STORE) || (newPos == pos))
+  {
+    pos = newPos;
+    return true;
+  }
+
+  // Compressed data can only be skipped by inflating it
+  if ((newPos < pos) && !RestartInflate ())
+    return false;
+  char skipBuf[4096];
+  while (pos < newPos)
+  {
+    size_t n = Read (skipBuf, csMin (newPos - pos, sizeof (skipBuf)));
+    if (n == 0) return false;
+  }
+  return true;
+}
+
+csPtr<iDataBuffer> csArchiveEntryStream::GetStoredData ()
+{
+  if (!archiveData || (method != ZIP_STORE)) return 0;
+  return csPtr<iDataBuffer> (
+    new csParasiticDataBuffer (archiveData, dataOffset, ucsize));
+}
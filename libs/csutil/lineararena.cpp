@@ -0,0 +1,130 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csutil/lineararena.h"
+#include "csgeom/math.h"
+
+namespace CS
+{
+  namespace Memory
+  {
+    static inline size_t AlignSize (size_t n)
+    {
+      return (n + LinearArena::alignment - 1)
+        & ~size_t (LinearArena::alignment - 1);
+    }
+
+    LinearArena::LinearArena (size_t blockSize)
+      : blocks (0), top (0), end (0), lastAlloc (0),
+        blockSize (AlignSize (blockSize)), capacity (0), usedBytes (0),
+        lastUsedBytes (0), peakUsedBytes (0)
+    {
+    }
+
+    LinearArena::~LinearArena ()
+    {
+      FreeBlocks ();
+    }
+
+    uint8* LinearArena::BlockStart (Block* block)
+    {
+      return ((uint8*)block) + AlignSize (sizeof (Block));
+    }
+
+    void LinearArena::NewBlock (size_t size)
+    {
+      size_t newSize = csMax (blockSize, size);
+      Block* block = (Block*)cs_malloc (AlignSize (sizeof (Block)) + newSize);
+      block->next = blocks;
+      block->size = newSize;
+      blocks = block;
+      capacity += newSize;
+
+      top = BlockStart (block);
+      end = top + newSize;
+    }
+
+    void LinearArena::FreeBlocks ()
+    {
+      while (blocks != 0)
+      {
+        Block* next = blocks->next;
+        cs_free (blocks);
+        blocks = next;
+      }
+      top = end = lastAlloc = 0;
+      capacity = 0;
+    }
+
+    void* LinearArena::Alloc (size_t size)
+    {
+      size = AlignSize (size);
+      if (size > size_t (end - top))
+        NewBlock (size);
+      lastAlloc = top;
+      top += size;
+      usedBytes += size;
+      return lastAlloc;
+    }
+
+    void* LinearArena::Realloc (void* p, size_t newSize)
+    {
+      if (p == 0) return Alloc (newSize);
+      if (p != lastAlloc) return 0;
+      newSize = AlignSize (newSize);
+      if (newSize > size_t (end - lastAlloc)) return 0;
+      usedBytes -= top - lastAlloc;
+      top = lastAlloc + newSize;
+      usedBytes += newSize;
+      return p;
+    }
+
+    void LinearArena::Free (void* p)
+    {
+      if ((p == 0) || (p != lastAlloc)) return;
+      usedBytes -= top - lastAlloc;
+      top = lastAlloc;
+      lastAlloc = 0;
+    }
+
+    void LinearArena::Reset ()
+    {
+      lastUsedBytes = usedBytes;
+      peakUsedBytes = csMax (peakUsedBytes, usedBytes);
+      usedBytes = 0;
+      lastAlloc = 0;
+
+      if (blocks == 0) return;
+      if (blocks->next != 0)
+      {
+        /* More than one block was needed: replace all by a single block
+           large enough for the peak usage. */
+        size_t newSize = blockSize;
+        while (newSize < peakUsedBytes) newSize *= 2;
+        FreeBlocks ();
+        NewBlock (newSize);
+      }
+      else
+      {
+        top = BlockStart (blocks);
+        end = top + blocks->size;
+      }
+    }
+  } // namespace Memory
+} // namespace CS
@@ -0,0 +1,113 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csutil/parallelfor.h"
+#include "csutil/platform.h"
+#include "csutil/scf_implementation.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/threading/thread.h"
+#include "csutil/workstealingjobqueue.h"
+#include "iutil/objreg.h"
+
+namespace CS
+{
+namespace Threading
+{
+  static const char parallelForQueueTag[] = "crystalspace.jobqueue.parallelfor";
+  static Mutex parallelForQueueLock;
+
+  csRef<iJobQueue> GetParallelForJobQueue (iObjectRegistry* objectReg,
+    size_t& numWorkers)
+  {
+    numWorkers = 0;
+    uint numProcessors = CS::Platform::GetProcessorCount ();
+    if (numProcessors <= 1) return 0;
+
+    ScopedLock<Mutex> lock (parallelForQueueLock);
+    csRef<iJobQueue> jobQueue = csQueryRegistryTagInterface<iJobQueue> (
+      objectReg, parallelForQueueTag);
+    if (!jobQueue)
+    {
+      jobQueue.AttachNew (new WorkStealingJobQueue (numProcessors - 1,
+        THREAD_PRIO_NORMAL, "parallel for"));
+      objectReg->Register (jobQueue, parallelForQueueTag);
+    }
+    numWorkers = numProcessors - 1;
+    return jobQueue;
+  }
+
+  //-------------------------------------------------------------------------
+
+  class ParallelForBase::Job : public scfImplementation1<Job, iJob>
+  {
+  public:
+    Job (ParallelForBase* loop) : scfImplementation1<Job, iJob> (this),
+      loop (loop) {}
+
+    void Run ()
+    {
+      loop->ProcessChunks ();
+    }
+  private:
+    csRef<ParallelForBase> loop;
+  };
+
+  ParallelForBase::ParallelForBase (size_t numItems, size_t chunkSize)
+    : numItems (numItems), chunkSize (csMax (chunkSize, size_t (1))),
+      nextChunk (0), chunksDone (0)
+  {
+    numChunks = int32 ((numItems + this->chunkSize - 1) / this->chunkSize);
+  }
+
+  ParallelForBase::~ParallelForBase ()
+  {
+  }
+
+  void ParallelForBase::ProcessChunks ()
+  {
+    while (true)
+    {
+      int32 chunk = AtomicOperations::Increment (&nextChunk) - 1;
+      if (chunk >= numChunks) return;
+
+      size_t first = chunk * chunkSize;
+      ProcessRange (first, csMin (first + chunkSize, numItems));
+      AtomicOperations::Increment (&chunksDone);
+    }
+  }
+
+  void ParallelForBase::Run (iJobQueue* jobQueue, size_t numWorkers)
+  {
+    size_t numJobs = csMin (numWorkers, size_t (numChunks - 1));
+    for (size_t j = 0; j < numJobs; j++)
+    {
+      csRef<iJob> job;
+      job.AttachNew (new Job (this));
+      jobQueue->Enqueue (job);
+    }
+
+    // Help out, then wait for the chunks other threads picked up
+    ProcessChunks ();
+    while (AtomicOperations::Read (&chunksDone) < numChunks)
+      Thread::Yield ();
+  }
+} // namespace Threading
+} // namespace CS
@@ -492,3 +492,85 @@ void csRadixSorter::Sort (float* array, size_t size)
     }
   }
 }
+
+void csRadixSorter::Sort (uint64* array, size_t size)
+{
+  if(!array || size == 0)
+    return;
+
+  // Always start from the identity to keep the sort stable
+  ranksValid = false;
+
+  Resize(size);
+
+  //Stack-allocated histogram. As we do generation in a single pass we need
+  //2048 entries in the histogram (8kb in total)
+  uint32 histogram[256*8];
+  //Link-table. Used to avoid one extra-level of indirection on offset calculation
+  size_t* links[256];
+
+  memset(histogram, 0, sizeof(histogram));
+  bool alreadySorted = true;
+  uint64 prevVal = array[0];
+  for(size_t i = 0; i < size; i++)
+  {
+    uint64 val = array[i];
+    if(val < prevVal)
+      alreadySorted = false;
+    prevVal = val;
+
+    // Byte order independent, unlike the 32-bit variants
+    for(size_t b = 0; b < 8; b++)
+    {
+      histogram[(b<<8) + size_t ((val >> (b*8)) & 0xff)]++;
+    }
+  }
+
+  if(alreadySorted)
+  {
+    for(size_t i = 0; i < size; ++i)
+    {
+      ranks1[i] = i;
+    }
+    ranksValid = true;
+    return;
+  }
+
+  // Radix-sort. 8 passes at most
+  for(size_t pass = 0; pass < 8; pass++)
+  {
+    uint32* Hpass = &histogram[pass<<8];
+    const size_t shift = pass*8;
+
+    // Skip the pass if all values have the same byte
+    if(Hpass[size_t ((array[0] >> shift) & 0xff)] == size)
+      continue;
+
+    links[0] = ranks2;
+    for(size_t i = 1; i < 256; i++)
+    {
+      links[i] = links[i-1] + Hpass[i-1];
+    }
+
+    if(!ranksValid)
+    {
+      for(size_t i = 0; i<size; i++)
+      {
+        *links[size_t ((array[i] >> shift) & 0xff)]++ = i;
+      }
+      ranksValid = true;
+    }
+    else
+    {
+      size_t* indices = ranks1;
+      size_t* indicesEnd = ranks1+size;
+      while(indices != indicesEnd)
+      {
+        size_t id = *indices++;
+        *links[size_t ((array[id] >> shift) & 0xff)]++ = id;
+      }
+    }
+    // Swap for next pass
+    size_t* t = ranks1; ranks1 = ranks2; ranks2 = t;
+  }
+}
@@ -0,0 +1,234 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csutil/concurrentstrset.h"
+#include "csutil/csstring.h"
+#include "csutil/threading/thread.h"
+
+typedef CS::Utility::ConcurrentStringSet<CS::StringSetTag::General>
+  csConcurrentStringSet;
+
+/**
+ * Test CS::Utility::ConcurrentStringSet operations.
+ */
+class csConcurrentStringSetTest : public CppUnit::TestFixture
+{
+public:
+  void testRequest();
+  void testContains();
+  void testDelete();
+  void testSizing();
+  void testGrowing();
+  void testIterator();
+  void testThreads();
+
+  CPPUNIT_TEST_SUITE(csConcurrentStringSetTest);
+    CPPUNIT_TEST(testRequest);
+    CPPUNIT_TEST(testContains);
+    CPPUNIT_TEST(testDelete);
+    CPPUNIT_TEST(testSizing);
+    CPPUNIT_TEST(testGrowing);
+    CPPUNIT_TEST(testIterator);
+    CPPUNIT_TEST(testThreads);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void csConcurrentStringSetTest::testRequest()
+{
+  csConcurrentStringSet s;
+  CPPUNIT_ASSERT_EQUAL(s.Request(34), (char const*)0);
+  CPPUNIT_ASSERT_EQUAL(s.Request(csInvalidStringID), (char const*)0);
+  csStringID const bar = s.Request("bar");
+  CPPUNIT_ASSERT(bar != csInvalidStringID);
+  csStringID const foo1 = s.Request("foo");
+  CPPUNIT_ASSERT(foo1 != bar);
+  csStringID const foo2 = s.Request("foo");
+  CPPUNIT_ASSERT_EQUAL(foo1, foo2);
+  CPPUNIT_ASSERT_EQUAL(std::string("foo"), std::string(s.Request(foo1)));
+  CPPUNIT_ASSERT_EQUAL(std::string("bar"), std::string(s.Request(bar)));
+}
+
+void csConcurrentStringSetTest::testContains()
+{
+  csConcurrentStringSet s;
+  CPPUNIT_ASSERT(!s.Contains("foo"));
+  CPPUNIT_ASSERT(!s.Contains(34));
+  CPPUNIT_ASSERT(!s.Contains(csInvalidStringID));
+  csStringID const foo = s.Request("foo");
+  CPPUNIT_ASSERT(s.Contains("foo"));
+  CPPUNIT_ASSERT(s.Contains(foo));
+  CPPUNIT_ASSERT(!s.Contains("bar"));
+  CPPUNIT_ASSERT(!s.Contains(34));
+}
+
+void csConcurrentStringSetTest::testDelete()
+{
+  csConcurrentStringSet s;
+  csStringID const foo = s.Request("foo");
+  csStringID const bar = s.Request("bar");
+  CPPUNIT_ASSERT(s.Delete("foo"));
+  CPPUNIT_ASSERT(!s.Delete(foo));
+  CPPUNIT_ASSERT(!s.Contains("foo"));
+  CPPUNIT_ASSERT(s.Delete(bar));
+  CPPUNIT_ASSERT(!s.Delete("bar"));
+  CPPUNIT_ASSERT(s.IsEmpty());
+  // A string requested again gets a new ID
+  csStringID const foo2 = s.Request("foo");
+  CPPUNIT_ASSERT(foo2 != foo);
+  CPPUNIT_ASSERT(!s.Contains(foo));
+  CPPUNIT_ASSERT_EQUAL(std::string("foo"), std::string(s.Request(foo2)));
+}
+
+void csConcurrentStringSetTest::testSizing()
+{
+  csConcurrentStringSet s;
+  CPPUNIT_ASSERT(s.IsEmpty());
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)0);
+  s.Request("foo");
+  s.Request("bar");
+  CPPUNIT_ASSERT(!s.IsEmpty());
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)2);
+  s.Delete("cow");
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)2);
+  s.Delete("bar");
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)1);
+  s.Delete("foo");
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)0);
+  s.Request("foo");
+  csStringID const bar = s.Request("bar");
+  CPPUNIT_ASSERT(!s.IsEmpty());
+  s.Empty();
+  CPPUNIT_ASSERT(s.IsEmpty());
+  CPPUNIT_ASSERT(!s.Contains("bar"));
+  CPPUNIT_ASSERT(!s.Contains(bar));
+  CPPUNIT_ASSERT(s.Request("bar") != bar);
+}
+
+void csConcurrentStringSetTest::testGrowing()
+{
+  csConcurrentStringSet s;
+  csArray<csStringID> ids;
+  // Enough strings to replace the table and add reverse mapping blocks
+  for (int i = 0; i < 5000; i++)
+  {
+    ids.Push (s.Request (csString().Format ("string%d", i)));
+    // Deleted strings leave unused slots behind
+    if (i % 3 == 0) s.Delete (csString().Format ("string%d", i));
+  }
+  for (int i = 0; i < 5000; i++)
+  {
+    csString str;
+    str.Format ("string%d", i);
+    if (i % 3 == 0)
+    {
+      CPPUNIT_ASSERT(!s.Contains (str));
+      CPPUNIT_ASSERT(!s.Contains (ids[i]));
+    }
+    else
+    {
+      CPPUNIT_ASSERT_EQUAL(ids[i], s.Request (str));
+      CPPUNIT_ASSERT(str == s.Request (ids[i]));
+    }
+  }
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)3333);
+}
+
+void csConcurrentStringSetTest::testIterator()
+{
+  csConcurrentStringSet s;
+  csStringID const foo = s.Request("foo");
+  csStringID const bar = s.Request("bar");
+  csStringID const cow = s.Request("cow");
+  s.Request("moo");
+  s.Delete("moo");
+  csConcurrentStringSet::GlobalIterator iter = s.GetIterator();
+  int n = 0;
+  while (iter.HasNext())
+  {
+    n++;
+    char const* t;
+    csStringID i = iter.Next(t);
+    std::string x(t);
+    CPPUNIT_ASSERT(x == "foo" || x == "bar" || x == "cow");
+    if (x == "foo")
+      CPPUNIT_ASSERT_EQUAL(i, foo);
+    else if (x == "bar")
+      CPPUNIT_ASSERT_EQUAL(i, bar);
+    else // (x == "cow")
+      CPPUNIT_ASSERT_EQUAL(i, cow);
+  }
+  CPPUNIT_ASSERT_EQUAL(n, 3);
+}
+
+namespace
+{
+  /// Requests strings from a shared set
+  class StringRequester : public CS::Threading::Runnable
+  {
+    csConcurrentStringSet& set;
+    int offset;
+  public:
+    csArray<csStringID> ids;
+    bool ok;
+
+    StringRequester (csConcurrentStringSet& set, int offset)
+      : set (set), offset (offset), ok (true) {}
+
+    void Run ()
+    {
+      // The threads request overlapping ranges of strings
+      for (int i = 0; i < 2000; i++)
+      {
+        csString str;
+        str.Format ("string%d", i + offset);
+        csStringID id = set.Request (str);
+        ids.Push (id);
+        const char* reverse = set.Request (id);
+        if (!reverse || (str != reverse)) ok = false;
+      }
+    }
+  };
+}
+
+void csConcurrentStringSetTest::testThreads()
+{
+  csConcurrentStringSet s;
+  enum { numThreads = 4 };
+  csRef<StringRequester> requesters[numThreads];
+  csRef<CS::Threading::Thread> threads[numThreads];
+  for (int t = 0; t < numThreads; t++)
+  {
+    requesters[t].AttachNew (new StringRequester (s, t * 1000));
+    threads[t].AttachNew (new CS::Threading::Thread (requesters[t], true));
+  }
+  for (int t = 0; t < numThreads; t++)
+    threads[t]->Wait ();
+
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)(2000 + (numThreads - 1) * 1000));
+  for (int t = 0; t < numThreads; t++)
+  {
+    CPPUNIT_ASSERT(requesters[t]->ok);
+    // All threads must have gotten the same IDs for the same strings
+    for (int i = 0; i < 2000; i++)
+    {
+      csString str;
+      str.Format ("string%d", i + t * 1000);
+      CPPUNIT_ASSERT_EQUAL(s.Request (str), requesters[t]->ids[i]);
+    }
+  }
+}
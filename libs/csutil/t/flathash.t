@@ -0,0 +1,248 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csutil/csstring.h"
+#include "csutil/flathash.h"
+#include "csutil/hash.h"
+#include "csutil/randomgen.h"
+
+/**
+ * Test csFlatHash operations.
+ */
+class csFlatHashTest : public CppUnit::TestFixture
+{
+public:
+  void testPutGet();
+  void testPutUnique();
+  void testMultipleValues();
+  void testDelete();
+  void testIterator();
+  void testDeleteElement();
+  void testStringKeys();
+  void testCopy();
+  void testCompareWithHash();
+
+  CPPUNIT_TEST_SUITE(csFlatHashTest);
+    CPPUNIT_TEST(testPutGet);
+    CPPUNIT_TEST(testPutUnique);
+    CPPUNIT_TEST(testMultipleValues);
+    CPPUNIT_TEST(testDelete);
+    CPPUNIT_TEST(testIterator);
+    CPPUNIT_TEST(testDeleteElement);
+    CPPUNIT_TEST(testStringKeys);
+    CPPUNIT_TEST(testCopy);
+    CPPUNIT_TEST(testCompareWithHash);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void csFlatHashTest::testPutGet()
+{
+  csFlatHash<int, int> h;
+  CPPUNIT_ASSERT(h.IsEmpty());
+  CPPUNIT_ASSERT_EQUAL(h.Get(1, -1), -1);
+  CPPUNIT_ASSERT(h.GetElementPointer(1) == 0);
+  // Enough elements to grow the table a few times
+  for (int i = 0; i < 1000; i++)
+    h.Put(i, i * 2);
+  CPPUNIT_ASSERT_EQUAL(h.GetSize(), (size_t)1000);
+  for (int i = 0; i < 1000; i++)
+  {
+    CPPUNIT_ASSERT_EQUAL(h.Get(i, -1), i * 2);
+    CPPUNIT_ASSERT(h.Contains(i));
+  }
+  CPPUNIT_ASSERT(!h.Contains(1000));
+  CPPUNIT_ASSERT(!h.Contains(-1));
+  CPPUNIT_ASSERT_EQUAL(h.GetOrCreate(2000, 5), 5);
+  CPPUNIT_ASSERT_EQUAL(h.GetOrCreate(2000, 6), 5);
+  CPPUNIT_ASSERT_EQUAL(h.GetSize(), (size_t)1001);
+}
+
+void csFlatHashTest::testPutUnique()
+{
+  csFlatHash<int, int> h;
+  h.PutUnique(7, 1);
+  h.PutUnique(7, 2);
+  CPPUNIT_ASSERT_EQUAL(h.GetSize(), (size_t)1);
+  CPPUNIT_ASSERT_EQUAL(h.Get(7, 0), 2);
+}
+
+void csFlatHashTest::testMultipleValues()
+{
+  csFlatHash<int, int> h;
+  for (int i = 0; i < 100; i++)
+  {
+    h.Put(i, i);
+    h.Put(3, 100 + i);
+  }
+  csArray<int> all3 (h.GetAll(3));
+  CPPUNIT_ASSERT_EQUAL(all3.GetSize(), (size_t)101);
+  int sum = 0;
+  for (size_t i = 0; i < all3.GetSize(); i++)
+    sum += all3[i];
+  CPPUNIT_ASSERT_EQUAL(sum, 3 + 100 * 100 + 99 * 100 / 2);
+  CPPUNIT_ASSERT_EQUAL(h.GetAll(4).GetSize(), (size_t)1);
+  CPPUNIT_ASSERT_EQUAL(h.GetAll(1000).GetSize(), (size_t)0);
+}
+
+void csFlatHashTest::testDelete()
+{
+  csFlatHash<int, int> h;
+  for (int i = 0; i < 500; i++)
+  {
+    h.Put(i, i);
+    h.Put(i, -i);
+  }
+  for (int i = 0; i < 500; i += 2)
+    CPPUNIT_ASSERT(h.DeleteAll(i));
+  CPPUNIT_ASSERT(!h.DeleteAll(0));
+  CPPUNIT_ASSERT_EQUAL(h.GetSize(), (size_t)500);
+  for (int i = 1; i < 500; i += 2)
+    CPPUNIT_ASSERT(h.Delete(i, -i));
+  CPPUNIT_ASSERT_EQUAL(h.GetSize(), (size_t)250);
+  for (int i = 0; i < 500; i++)
+  {
+    if (i & 1)
+      CPPUNIT_ASSERT_EQUAL(h.Get(i, 0), i);
+    else
+      CPPUNIT_ASSERT(!h.Contains(i));
+  }
+  h.DeleteAll();
+  CPPUNIT_ASSERT(h.IsEmpty());
+  CPPUNIT_ASSERT(!h.Contains(1));
+  h.Put(1, 1);
+  CPPUNIT_ASSERT_EQUAL(h.Get(1, 0), 1);
+}
+
+void csFlatHashTest::testIterator()
+{
+  csFlatHash<int, int> h;
+  for (int i = 0; i < 300; i++)
+    h.Put(i, i);
+  h.Put(5, 1000);
+
+  csFlatHash<int, int>::GlobalIterator it (h.GetIterator());
+  int n = 0, sum = 0;
+  while (it.HasNext())
+  {
+    int key;
+    int v = it.Next(key);
+    CPPUNIT_ASSERT((v == key) || ((key == 5) && (v == 1000)));
+    sum += v;
+    n++;
+  }
+  CPPUNIT_ASSERT_EQUAL(n, 301);
+  CPPUNIT_ASSERT_EQUAL(sum, 299 * 300 / 2 + 1000);
+
+  csFlatHash<int, int>::ConstIterator keyIt (
+    static_cast<const csFlatHash<int, int>&> (h).GetIterator(5));
+  n = 0;
+  while (keyIt.HasNext())
+  {
+    int v = keyIt.Next();
+    CPPUNIT_ASSERT((v == 5) || (v == 1000));
+    n++;
+  }
+  CPPUNIT_ASSERT_EQUAL(n, 2);
+
+  csFlatHash<int, int> empty;
+  CPPUNIT_ASSERT(!empty.GetIterator().HasNext());
+  CPPUNIT_ASSERT(!empty.GetIterator(1).HasNext());
+}
+
+void csFlatHashTest::testDeleteElement()
+{
+  csFlatHash<int, int> h;
+  for (int i = 0; i < 1000; i++)
+    h.Put(i, i);
+  // Delete odd values while iterating; every element must be seen once
+  csFlatHash<int, int>::GlobalIterator it (h.GetIterator());
+  int n = 0;
+  while (it.HasNext())
+  {
+    int v = it.NextNoAdvance();
+    n++;
+    if (v & 1)
+      h.DeleteElement(it);
+    else
+      it.Advance();
+  }
+  CPPUNIT_ASSERT_EQUAL(n, 1000);
+  CPPUNIT_ASSERT_EQUAL(h.GetSize(), (size_t)500);
+  for (int i = 0; i < 1000; i++)
+    CPPUNIT_ASSERT_EQUAL(h.Contains(i), (i & 1) == 0);
+}
+
+void csFlatHashTest::testStringKeys()
+{
+  csFlatHash<int, csString> h;
+  h.Put("foo", 1);
+  h.Put("bar", 2);
+  CPPUNIT_ASSERT_EQUAL(h.Get("foo", 0), 1);
+  CPPUNIT_ASSERT_EQUAL(h.Get("bar", 0), 2);
+  CPPUNIT_ASSERT_EQUAL(h.Get("baz", 0), 0);
+
+  csFlatHash<int, const char*> h2;
+  h2.Put("foo", 3);
+  csString foo ("foo");
+  CPPUNIT_ASSERT_EQUAL(h2.Get(foo.GetData(), 0), 3);
+}
+
+void csFlatHashTest::testCopy()
+{
+  csFlatHash<csString, int> h;
+  for (int i = 0; i < 50; i++)
+    h.Put(i, csString().Format("%d", i));
+  csFlatHash<csString, int> h2 (h);
+  h.DeleteAll();
+  CPPUNIT_ASSERT_EQUAL(h2.GetSize(), (size_t)50);
+  CPPUNIT_ASSERT(*h2.GetElementPointer(42) == "42");
+  csFlatHash<csString, int> h3;
+  h3 = h2;
+  CPPUNIT_ASSERT(*h3.GetElementPointer(7) == "7");
+}
+
+void csFlatHashTest::testCompareWithHash()
+{
+  // Random operations must give the same results as with csHash
+  csRandomGen rng (1234);
+  csFlatHash<int, int> flat;
+  csHash<int, int> hash;
+  for (int i = 0; i < 20000; i++)
+  {
+    int key = rng.Get (2000);
+    switch (rng.Get (4))
+    {
+      case 0:
+        flat.Put (key, i);
+        hash.Put (key, i);
+        break;
+      case 1:
+        flat.PutUnique (key, i);
+        hash.PutUnique (key, i);
+        break;
+      case 2:
+        CPPUNIT_ASSERT_EQUAL(flat.DeleteAll (key), hash.DeleteAll (key));
+        break;
+      default:
+        CPPUNIT_ASSERT_EQUAL(flat.GetAll (key).GetSize (),
+          hash.GetAll (key).GetSize ());
+        break;
+    }
+    CPPUNIT_ASSERT_EQUAL(flat.GetSize (), hash.GetSize ());
+  }
+}
@@ -24,11 +24,21 @@
 #include "csutil/sysfunc.h"
 #include "csutil/threadjobqueue.h"
 #include "csutil/randomgen.h"
+#include "ivaria/profile.h"
 
 namespace
 {
   static CS::Threading::Mutex rgenLock;
   static csRandomGen rgen;
+
+  CS_DECLARE_PROFILER
+  CS_DECLARE_PROFILER_ZONE(ThreadedJobQueue_RunJob)
+
+  static inline void RunJob (iJob* job)
+  {
+    CS_PROFILER_ZONE(ThreadedJobQueue_RunJob)
+    job->Run ();
+  }
 }
 
 namespace CS
@@ -184,7 +194,7 @@ namespace Threading
 
     if (removedJob)
     {      
-      job->Run ();
+      RunJob (job);
       return Dequeued;
     }
     else
@@ -359,7 +369,7 @@ namespace Threading
         threadState->currentJob = currentJob;        
         threadState->tsMutex.Unlock (); // Unlock our own TS after getting a job
 
-        currentJob->Run ();
+        RunJob (currentJob);
 
 	/* Release reference to job only until after the last access of the
 	   thread manager.
@@ -17,6 +17,7 @@
 */
 
 #include "cssysdef.h"
+#include "csgeom/math.h"
 #include "csutil/platform.h"
 #include "csutil/sysfunc.h"
 #include "csutil/threadjobqueue.h"
@@ -26,7 +27,7 @@
 
 using namespace CS::Threading;
 
-csThreadManager::ListAccessQueue::ListAccessQueue() : total(0)
+csThreadManager::ListAccessQueue::ListAccessQueue() : agingPeriod(0), total(0)
 {
 }
 
@@ -37,39 +38,92 @@ csThreadManager::ListAccessQueue::~ListAccessQueue()
 
 void csThreadManager::ListAccessQueue::Enqueue(iJob* job, QueueType type)
 {
-  if(type == HIGH)
-  {
-    RecursiveMutexScopedLock lock(highQueueLock);
-    highqueue.Push(job);
-  }
-  else if(type == MED)
-  {
-    RecursiveMutexScopedLock lock(medQueueLock);
-    medqueue.Push(job);
-  }
-  else if(type == LOW)
+  if(type < HIGH || type > LOW)
+    return;
+
+  QueuedJob queued;
+  queued.job = job;
+  queued.enqueueTime = csGetMicroTicks();
+
+  PriorityQueue& queue = queues[type - HIGH];
   {
-    RecursiveMutexScopedLock lock(lowQueueLock);
-    lowqueue.Push(job);
+    RecursiveMutexScopedLock lock(queue.lock);
+    queue.jobs.Push(queued);
   }
   
   AtomicOperations::Increment(&total);
 }
 
-void csThreadManager::ListAccessQueue::ProcessQueue(uint num)
+bool csThreadManager::ListAccessQueue::ProcessNext()
 {
-  uint i=0;
+  csMicroTicks now = csGetMicroTicks();
+
+  /* Pick the queue by priority. With aging, each agingPeriod a job waited
+     counts as one priority level, so old low priority jobs eventually win
+     against new high priority ones. */
+  int best = -1;
+  csMicroTicks bestRank = 0;
+  for(int q = 0; q < numQueues; q++)
+  {
+    RecursiveMutexScopedLock lock(queues[q].lock);
+    if(queues[q].jobs.GetSize() == 0)
+      continue;
+
+    csMicroTicks rank = q;
+    if(agingPeriod > 0)
+    {
+      csMicroTicks waited = now - queues[q].jobs.Top().enqueueTime;
+      rank = q * agingPeriod - waited;
+    }
+    if(best < 0 || rank < bestRank)
+    {
+      best = q;
+      bestRank = rank;
+    }
+  }
 
-  ProcessHighQueue(i, num);
+  if(best < 0)
+    return false;
 
-  if(i<num)
+  QueuedJob queued;
   {
-    ProcessMedQueue(i, num);
+    RecursiveMutexScopedLock lock(queues[best].lock);
+    if(queues[best].jobs.GetSize() == 0)
+      return true;
+    queued = queues[best].jobs.PopTop();
   }
+  AtomicOperations::Decrement(&total);
+
+  csMicroTicks startTime = csGetMicroTicks();
+  queued.job->Run();
+  csMicroTicks runTime = csGetMicroTicks() - startTime;
+  csMicroTicks latency = startTime - queued.enqueueTime;
 
-  if(i<num)
   {
-    ProcessLowQueue(i, num);
+    MutexScopedLock lock(statsLock);
+    csThreadQueueStatistics& stats = queues[best].stats;
+    stats.jobsRun++;
+    stats.totalLatency += latency;
+    stats.maxLatency = csMax(stats.maxLatency, latency);
+    stats.totalRunTime += runTime;
+    stats.maxRunTime = csMax(stats.maxRunTime, runTime);
+  }
+
+  return true;
+}
+
+void csThreadManager::ListAccessQueue::ProcessQueue(uint num)
+{
+  for(uint i = 0; i < num && ProcessNext(); i++) {}
+}
+
+void csThreadManager::ListAccessQueue::ProcessQueueTimed(csMicroTicks budget)
+{
+  csMicroTicks startTime = csGetMicroTicks();
+  while(ProcessNext())
+  {
+    if(csGetMicroTicks() - startTime >= budget)
+      break;
   }
 }
 
@@ -80,42 +134,28 @@ int32 csThreadManager::ListAccessQueue::GetQueueCount() const
 
 void csThreadManager::ListAccessQueue::ProcessAll ()
 {
-  while (GetQueueCount() > 0)
-    ProcessQueue (total);
+  while (ProcessNext ()) {}
 }
 
-inline void csThreadManager::ListAccessQueue::ProcessHighQueue(uint& i, uint& num)
+void csThreadManager::ListAccessQueue::GetStatistics(QueueType type,
+  csThreadQueueStatistics& stats)
 {
-  RecursiveMutexScopedLock lock(highQueueLock);
-  for(; i<num && highqueue.GetSize() != 0; i++)
+  if(type < HIGH || type > LOW)
   {
-    AtomicOperations::Decrement(&total);
-    highqueue.PopTop()->Run();
+    stats = csThreadQueueStatistics();
+    return;
   }
-}
 
-inline void csThreadManager::ListAccessQueue::ProcessMedQueue(uint& i, uint& num)
-{
-  ProcessHighQueue(i, num);
-  RecursiveMutexScopedLock lock(medQueueLock);
-  for(; i<num && medqueue.GetSize() != 0; i++)
-  {
-    AtomicOperations::Decrement(&total);
-    medqueue.PopTop()->Run();
-    ProcessHighQueue(i, num);
-  }
+  MutexScopedLock lock(statsLock);
+  stats = queues[type - HIGH].stats;
 }
 
-inline void csThreadManager::ListAccessQueue::ProcessLowQueue(uint& i, uint& num)
+void csThreadManager::ListAccessQueue::ResetStatistics()
 {
-  ProcessHighQueue(i, num);
-  RecursiveMutexScopedLock lock(lowQueueLock);
-  for(; i<num && lowqueue.GetSize() != 0; i++)
+  MutexScopedLock lock(statsLock);
+  for(int q = 0; q < numQueues; q++)
   {
-    AtomicOperations::Decrement(&total);
-    lowqueue.PopTop()->Run();
-    ProcessHighQueue(i, num);
-    ProcessMedQueue(i, num);
+    queues[q].stats = csThreadQueueStatistics();
   }
 }
   
@@ -124,7 +164,8 @@ inline void csThreadManager::ListAccessQueue::ProcessLowQueue(uint& i, uint& num
 ThreadID csThreadManager::tid;
 
 csThreadManager::csThreadManager(iObjectRegistry* objReg) : scfImplementationType(this), 
-  waiting(0), alwaysRunNow(false), objectReg(objReg), exiting(false)
+  waiting(0), alwaysRunNow(false), objectReg(objReg), exiting(false),
+  frameBudget(0)
 {
   tid = Thread::GetThreadID();
 
@@ -141,6 +182,7 @@ csThreadManager::csThreadManager(iObjectRegistry* objReg) : scfImplementationTyp
   threadQueue.AttachNew(new ThreadedJobQueue(threadCount, THREAD_PRIO_LOW,
     "thread manager"));
   listQueue.AttachNew(new ListAccessQueue());
+  listQueue->SetAgingPeriod(250000);
 
   // Event handler.
   tMEventHandler.AttachNew(new TMEventHandler(this));
@@ -169,6 +211,12 @@ void csThreadManager::Init(iConfigManager* config)
   }
 
   alwaysRunNow = config->GetBool("ThreadManager.AlwaysRunNow");
+
+  // Both given in milliseconds
+  frameBudget = csMicroTicks(config->GetFloat("ThreadManager.FrameBudget",
+    frameBudget / 1000.0f) * 1000);
+  listQueue->SetAgingPeriod(csMicroTicks(config->GetFloat(
+    "ThreadManager.AgingPeriod", listQueue->GetAgingPeriod() / 1000.0f) * 1000));
 }
 
 void csThreadManager::Process(uint num)
@@ -176,6 +224,22 @@ void csThreadManager::Process(uint num)
   listQueue->ProcessQueue(num);  
 }
 
+void csThreadManager::ProcessFor(csMicroTicks budget)
+{
+  listQueue->ProcessQueueTimed(budget);
+}
+
+void csThreadManager::GetQueueStatistics(QueueType queueType,
+  csThreadQueueStatistics& stats)
+{
+  listQueue->GetStatistics(queueType, stats);
+}
+
+void csThreadManager::ResetQueueStatistics()
+{
+  listQueue->ResetStatistics();
+}
+
 bool csThreadManager::Wait(csRefArray<iThreadReturn>& threadReturns, bool process)
 {
   Condition* c;
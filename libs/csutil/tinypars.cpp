@@ -24,9 +24,16 @@ distribution.
 
 #include "cssysdef.h"
 #include "tinyxml.h"
+#include "csutil/bitops.h"
 #include "csutil/csstring.h"
 #include <ctype.h>
 
+#if defined (CS_PROCESSOR_X86) && (defined (__SSE2__) || defined (_M_X64) \
+  || (defined (_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define CS_TINYXML_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace CS
 {
 namespace Implementation
@@ -47,12 +54,112 @@ const TiXmlBase::Entity TiXmlBase::entity[ NUM_ENTITY ] =
 };
 
 
+/* The scanners below look at 16 characters at a time with SSE2. Loads are
+   aligned, so they never cross into a page past the terminating null, and
+   bits for characters before the start are masked out. Characters with the
+   high bit set are left to the scalar code as whether they are white space
+   depends on the locale. */
+
+#ifdef CS_TINYXML_SSE2
+/// Bit mask of the ASCII white space characters in a block.
+static inline uint32 SpaceMask (__m128i v)
+{
+  // '\t', '\n', '\v', '\f' and '\r' are 9 to 13
+  __m128i t = _mm_sub_epi8 (v, _mm_set1_epi8 (9));
+  __m128i ctrl = _mm_cmpeq_epi8 (_mm_min_epu8 (t, _mm_set1_epi8 (4)), t);
+  return _mm_movemask_epi8 (_mm_or_si128 (ctrl,
+    _mm_cmpeq_epi8 (v, _mm_set1_epi8 (' '))));
+}
+
+/// Count the new lines in a block marked in 'newlines'.
+static inline void CountNewLines (ParseInfo& parse, const char* block,
+                                  uint32 newlines)
+{
+  if (!newlines) return;
+  parse.linenum += CS::Utility::BitOps::ComputeBitsSet (newlines);
+  // Clear all but the highest bit to find the last new line.
+  while (newlines & (newlines - 1)) newlines &= newlines - 1;
+  unsigned long last;
+  CS::Utility::BitOps::ScanBitForward (newlines, last);
+  parse.startOfLine = block + last + 1;
+}
+#endif
+
+/**
+ * Find the first character from \a p on that ReadText() has to look at
+ * individually: the terminating null, an entity, a new line, the first
+ * character of the end tag and, if \a stopAtSpace is set, white space and
+ * non-ASCII characters. Everything before can be copied as is.
+ */
+static inline const char* ScanPlainText (const char* p, char endChar,
+                                         bool stopAtSpace)
+{
+#ifdef CS_TINYXML_SSE2
+  const char* block = (const char*)(uintptr_t (p) & ~uintptr_t (15));
+  uint32 valid = 0xffff & (0xffff << (p - block));
+  const __m128i vEnd = _mm_set1_epi8 (endChar);
+  const __m128i vAmp = _mm_set1_epi8 ('&');
+  const __m128i vNewLine = _mm_set1_epi8 ('\n');
+  const __m128i vZero = _mm_setzero_si128 ();
+  while (true)
+  {
+    __m128i v = _mm_load_si128 ((const __m128i*)block);
+    __m128i special = _mm_or_si128 (
+      _mm_or_si128 (_mm_cmpeq_epi8 (v, vZero), _mm_cmpeq_epi8 (v, vAmp)),
+      _mm_or_si128 (_mm_cmpeq_epi8 (v, vNewLine), _mm_cmpeq_epi8 (v, vEnd)));
+    uint32 stop = _mm_movemask_epi8 (special);
+    if (stopAtSpace) stop |= SpaceMask (v) | _mm_movemask_epi8 (v);
+    stop &= valid;
+    if (stop)
+    {
+      unsigned long first;
+      CS::Utility::BitOps::ScanBitForward (stop, first);
+      return block + first;
+    }
+    block += 16;
+    valid = 0xffff;
+  }
+#else
+  while (*p && (*p != '&') && (*p != '\n') && (*p != endChar)
+    && !(stopAtSpace && (((unsigned char)*p & 0x80) || isspace (*p))))
+    p++;
+  return p;
+#endif
+}
+
 const char* TiXmlBase::SkipWhiteSpace( ParseInfo& parse, const char* p )
 {
   if ( !p || !*p )
   {
     return 0;
   }
+#ifdef CS_TINYXML_SSE2
+  // Skip longer runs, like indentation, a block at a time.
+  if ((*p == ' ') || (*p == '\n') || (*p == '\t') || (*p == '\r'))
+  {
+    const char* block = (const char*)(uintptr_t (p) & ~uintptr_t (15));
+    uint32 valid = 0xffff & (0xffff << (p - block));
+    const __m128i vNewLine = _mm_set1_epi8 ('\n');
+    while (true)
+    {
+      __m128i v = _mm_load_si128 ((const __m128i*)block);
+      uint32 stop = ~SpaceMask (v) & valid;
+      uint32 newlines = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, vNewLine))
+        & valid;
+      if (stop)
+      {
+        unsigned long first;
+        CS::Utility::BitOps::ScanBitForward (stop, first);
+        CountNewLines (parse, block, newlines & ((1u << first) - 1));
+        p = block + first;
+        break;
+      }
+      CountNewLines (parse, block, newlines);
+      block += 16;
+      valid = 0xffff;
+    }
+  }
+#endif
   while ( isspace ((unsigned char)*p))
   {
     if (*p == '\n')
@@ -73,11 +180,13 @@ const char* TiXmlBase::ReadName( const char* p, csString& name)
   // but tinyxml can't tell namespaces from names.)
   if (p && *p && (isalpha ((unsigned char) *p) || *p == '_'))
   {
+    const char* start = p;
     while ((isalnum ((unsigned char) *p) 
       || *p == '_' || *p == '-' || *p == ':'))
     {
-      name << *p++;
+      p++;
     }
+    name.Append (start, p - start);
     return p;
   }
   return 0;
@@ -185,6 +294,11 @@ public:
     buf.Append (c);
   }
 
+  void AddChars (const char* s, size_t n)
+  {
+    buf.Append (s, n);
+  }
+
   char* GetNewCopy ()
   {
     char* copy = (char*)cs_malloc (buf.Length()+1);
@@ -210,6 +324,13 @@ const char* TiXmlBase::ReadText(ParseInfo& parse, const char* p,
     // Keep all the white space.
     while (*p && !StringEqual ( p, endTag))
     {
+      const char* plain = ScanPlainText (p, *endTag, false);
+      if (plain != p)
+      {
+        buf.AddChars (p, plain - p);
+        p = plain;
+        continue;
+      }
       if (*p == '\n')
       {
 	parse.linenum++;
@@ -228,15 +349,23 @@ const char* TiXmlBase::ReadText(ParseInfo& parse, const char* p,
     p = SkipWhiteSpace( parse, p );
     while (  *p && !StringEqual ( p, endTag) )
     {
-      if (*p == '\n')
+      const char* plain = ScanPlainText (p, *endTag, true);
+      if (plain != p)
       {
-	parse.linenum++;
-	parse.startOfLine = p + 1;
+        if ( whitespace )
+        {
+          buf.AddChar (' ');
+          whitespace = false;
+        }
+        buf.AddChars (p, plain - p);
+        p = plain;
+        continue;
       }
       if ( isspace( *p ) )
       {
+        // SkipWhiteSpace() also counts the lines.
         whitespace = true;
-        ++p;
+        p = SkipWhiteSpace( parse, p );
       }
       else
       {
@@ -257,6 +386,54 @@ const char* TiXmlBase::ReadText(ParseInfo& parse, const char* p,
   return p + strlen( endTag );
 }
 
+char* TiXmlBase::ReadTextInSitu( ParseInfo& parse, char* p, char endChar )
+{
+  char* out = p;
+  while (*p && (*p != endChar))
+  {
+    const char* plain = ScanPlainText (p, endChar, false);
+    if (plain != p)
+    {
+      size_t n = plain - p;
+      // Only move if entities made the text shorter.
+      if (out != p) memmove (out, p, n);
+      out += n;
+      p += n;
+      continue;
+    }
+    if (*p == '\n')
+    {
+      parse.linenum++;
+      parse.startOfLine = p + 1;
+    }
+    char c;
+    p = const_cast<char*> (GetChar( p, &c ));
+    *out++ = c;
+  }
+  // Don't step over the terminating null of unterminated text.
+  char* end = *p ? p + 1 : p;
+  *out = 0;
+  return end;
+}
+
+/**
+ * Check for the end tag of the element \a name, ignoring case. Returns a
+ * pointer past it or 0 if there is none.
+ */
+static const char* MatchEndTag (const char* p, const char* name)
+{
+  if ((p[0] != '<') || (p[1] != '/')) return 0;
+  p += 2;
+  while (*name)
+  {
+    if (tolower (*p) != tolower (*name)) return 0;
+    p++;
+    name++;
+  }
+  if (*p != '>') return 0;
+  return p + 1;
+}
+
 const char* TiDocumentNode::Parse( ParseInfo& parse, const char* p )
 {
   switch (Type())
@@ -349,10 +526,6 @@ const char* TiXmlElement::Parse( ParseInfo& parse, const char* p )
   const char* reg_name = parse.document->strings.Request (name_id);
   SetValueRegistered (reg_name);
 
-  TiXmlString endTag ("</");
-  endTag += value;
-  endTag += ">";
-
   // Check for and read attributes. Also look for an empty
   // tag or an end tag.
   while ( p && *p )
@@ -390,11 +563,11 @@ const char* TiXmlElement::Parse( ParseInfo& parse, const char* p )
       }
 
       // We should find the end tag now
-      if ( StringEqualIgnoreCase( p, endTag.c_str()) )
+      const char* endTagEnd = MatchEndTag (p, value);
+      if ( endTagEnd )
       {
-        p += endTag.length();
         attributeSet.set.ShrinkBestFit ();
-        return p;
+        return endTagEnd;
       }
       else
       {
@@ -414,9 +587,7 @@ const char* TiXmlElement::Parse( ParseInfo& parse, const char* p )
         parse.document->SetError( TIXML_ERROR_PARSING_ELEMENT, this, p );
         return 0;
       }
-      GetAttributeRegistered (attrib.Name()).
-        TakeOverValue (attrib.Value());
-      attrib.TakeOverValue (0);
+      GetAttributeRegistered (attrib.Name()).TakeOverValue (attrib);
     }
   }
   attributeSet.set.ShrinkBestFit ();
@@ -605,26 +776,31 @@ const char* TiDocumentAttribute::Parse( ParseInfo& parse, TiDocumentNode* node,
   
   const char* end;
 
-  cs_free (value);
-  GrowString buf;
   if ( *p == '\'' )
   {
-    ++p;
     end = "\'";
-    p = TiXmlBase::ReadText( parse, p, buf, false, end);
   }
   else if ( *p == '"' )
   {
-    ++p;
     end = "\"";
-    p = TiXmlBase::ReadText( parse, p, buf, false, end);
   }
   else
   {
     parse.document->SetError( TIXML_ERROR_READING_ATTRIBUTES, node, p );
     return 0;
   }
-  value = buf.GetNewCopy ();
+  ++p;
+  if (parse.inSitu)
+  {
+    // The value stays in the parsed data, which the document owns.
+    char* start = const_cast<char*> (p);
+    p = TiXmlBase::ReadTextInSitu( parse, start, *end );
+    SetValueInSitu (start);
+    return p;
+  }
+  GrowString buf;
+  p = TiXmlBase::ReadText( parse, p, buf, false, end);
+  TakeOverValue (buf.GetNewCopy ());
   return p;
 }
 
@@ -718,7 +718,8 @@ TiDocument::TiDocument() :
   //  ignoreWhiteSpace = true;
   SetType (DOCUMENT);
   parse.document = this;
-  parse.document = this;
+  parse.inSitu = false;
+  inSituBuffer = 0;
 }
 
 TiDocument::TiDocument( const char * documentName ) :
@@ -732,7 +733,8 @@ TiDocument::TiDocument( const char * documentName ) :
   errorId = TIXML_NO_ERROR;
   SetType (DOCUMENT);
   parse.document = this;
-  parse.document = this;
+  parse.inSitu = false;
+  inSituBuffer = 0;
 }
 
 TiDocument::~TiDocument ()
@@ -743,6 +745,7 @@ TiDocument::~TiDocument ()
   // The Clear() call may have enqueue a number of nodes to delete,
   // and it needs to be emptied *before* we're destructed.
   EmptyDestroyQueue ();
+  cs_free (inSituBuffer);
 }
 
 csPtr<TiDocumentNode> TiDocument::Clone(TiDocument* document) const
@@ -92,6 +92,11 @@ struct ParseInfo
 {
   TiDocument* document;
   bool condenseWhiteSpace;
+  /**
+   * Whether the data being parsed is owned by the document and may be
+   * modified, so attribute values can be decoded in place.
+   */
+  bool inSitu;
   
   const char* startOfLine;
   int linenum;
@@ -204,6 +209,13 @@ public:
         bool ignoreWhiteSpace,
         const char* endTag);
 
+  /**
+   * Reads text up to the end character in place: entities are decoded
+   * into the same buffer and the text is null terminated where it ends.
+   * Returns a pointer past the end character.
+   */
+  static char* ReadTextInSitu( ParseInfo& parse, char* in, char endChar );
+
   /**
    * Puts a string to a stream, expanding entities as it goes.
    * Note this should not contian the '<', '>', etc, or they will be
@@ -444,8 +456,8 @@ class TiDocumentAttribute
 
 public:
   /// Construct an empty attribute.
-  TiDocumentAttribute() { name = 0; value = 0; }
-  ~TiDocumentAttribute () { cs_free (value); }
+  TiDocumentAttribute() { name = 0; value = 0; ownValue = true; }
+  ~TiDocumentAttribute () { if (ownValue) cs_free (value); }
 
   const char* Name()  const { return name; }
   const char* Value() const { return value; }
@@ -456,13 +468,35 @@ public:
   void SetName( const char* _name )  { name = _name; }
   void SetValue( const char* _value )
   {
-    cs_free (value);
+    if (ownValue) cs_free (value);
     value = CS::StrDup (_value);
+    ownValue = true;
   }
   /// Take over value so that this attribute has ownership.
   void TakeOverValue( char* _value )
   {
+    if (ownValue) cs_free (value);
+    value = _value;
+    ownValue = true;
+  }
+  /// Take over the value of another attribute, leaving it empty.
+  void TakeOverValue( TiDocumentAttribute& other )
+  {
+    if (ownValue) cs_free (value);
+    value = other.value;
+    ownValue = other.ownValue;
+    other.value = 0;
+    other.ownValue = true;
+  }
+  /**
+   * Set a value that is parsed in place and owned by the document. It is
+   * not freed by the attribute.
+   */
+  void SetValueInSitu( char* _value )
+  {
+    if (ownValue) cs_free (value);
     value = _value;
+    ownValue = false;
   }
 
   void SetIntValue( int value );
@@ -495,6 +529,8 @@ private:
 
   const char* name;
   char* value;
+  /// Whether 'value' was allocated for this attribute.
+  bool ownValue;
 };
 
 
@@ -971,6 +1007,22 @@ public:
     parse.BeginParse (p);
     return Parse (parse, p);
   }
+  /**
+   * Parse the given null terminated block of xml data in place. The
+   * document takes ownership of the block, which must have been allocated
+   * with cs_malloc(): attribute values are decoded into it and point to
+   * it instead of being copied.
+   */
+  const char* ParseInSitu( char* p )
+  {
+    CS_ASSERT (inSituBuffer == 0);
+    inSituBuffer = p;
+    parse.BeginParse (p);
+    parse.inSitu = true;
+    const char* ret = Parse (parse, p);
+    parse.inSitu = false;
+    return ret;
+  }
 
   /// If, during parsing, a error occurs, Error will be set to true.
   bool Error() const { return errorId != TIXML_NO_ERROR; }
@@ -1050,6 +1102,8 @@ protected :
 private:
   int  errorId;
   ParseInfo parse;
+  /// Data parsed with ParseInSitu(), freed with the document.
+  char* inSituBuffer;
   TiXmlString errorDesc;
   TiXmlString value;
 };
@@ -0,0 +1,530 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csutil/sysfunc.h"
+#include "csutil/workstealingjobqueue.h"
+#include "ivaria/profile.h"
+
+namespace CS
+{
+namespace Threading
+{
+  CS_DECLARE_PROFILER
+  CS_DECLARE_PROFILER_ZONE(WorkStealingJobQueue_RunJob)
+
+  static inline void RunJob (iJob* job)
+  {
+    CS_PROFILER_ZONE(WorkStealingJobQueue_RunJob)
+    job->Run ();
+  }
+
+  /* Deque indices are free-running 32-bit counters; all differences are
+   * computed in unsigned arithmetic so wrap-around is harmless. */
+  static inline int32 IndexDiff (int32 a, int32 b)
+  {
+    return int32 (uint32 (a) - uint32 (b));
+  }
+
+  static inline int32 IndexAdd (int32 a, int32 b)
+  {
+    return int32 (uint32 (a) + uint32 (b));
+  }
+
+  //-------------------------------------------------------------------------
+
+  WorkStealingJobQueue::JobDeque::JobDeque () : top (0), bottom (0)
+  {
+    memset (slots, 0, sizeof (slots));
+  }
+
+  WorkStealingJobQueue::JobDeque::~JobDeque ()
+  {
+    for (size_t i = 0; i < Capacity; i++)
+    {
+      iJob* job = static_cast<iJob*> (slots[i]);
+      if (job) job->DecRef ();
+    }
+  }
+
+  iJob* WorkStealingJobQueue::JobDeque::TakeSlot (int32 index)
+  {
+    void** slot = slots + (uint32 (index) & (Capacity - 1));
+    return static_cast<iJob*> (AtomicOperations::Set (slot, (void*)0));
+  }
+
+  bool WorkStealingJobQueue::JobDeque::Push (iJob* job)
+  {
+    // Only the owner writes bottom, so a plain read is fine
+    const int32 b = bottom;
+    const int32 t = AtomicOperations::Read (&top);
+    if (IndexDiff (b, t) >= Capacity - 1) return false;
+
+    /* The slot may still be occupied if a thief won the index Capacity
+     * entries ago but has not swapped the job out yet. Don't overwrite it. */
+    void** slot = slots + (uint32 (b) & (Capacity - 1));
+    if (AtomicOperations::Read (slot) != 0) return false;
+
+    job->IncRef ();
+    AtomicOperations::Set (slot, (void*)job);
+    // Publish (full barrier)
+    AtomicOperations::Set (&bottom, IndexAdd (b, 1));
+    return true;
+  }
+
+  iJob* WorkStealingJobQueue::JobDeque::Pop ()
+  {
+    while (true)
+    {
+      const int32 b = IndexAdd (bottom, -1);
+      AtomicOperations::Set (&bottom, b);
+      const int32 t = AtomicOperations::Read (&top);
+      const int32 size = IndexDiff (b, t);
+      if (size < 0)
+      {
+        // Empty
+        AtomicOperations::Set (&bottom, t);
+        return 0;
+      }
+      if (size == 0)
+      {
+        // Last job, race against thieves for it
+        bool won = AtomicOperations::CompareAndSet (&top, IndexAdd (t, 1), t)
+          == t;
+        AtomicOperations::Set (&bottom, IndexAdd (t, 1));
+        if (!won) return 0;
+      }
+      iJob* job = TakeSlot (b);
+      if (job) return job;
+      // Job was claimed by Dequeue()/PullAndRun(); look at the next one
+    }
+  }
+
+  iJob* WorkStealingJobQueue::JobDeque::Steal ()
+  {
+    while (true)
+    {
+      const int32 t = AtomicOperations::Read (&top);
+      const int32 b = AtomicOperations::Read (&bottom);
+      if (IndexDiff (b, t) <= 0) return 0;
+      // Lost against the owner or another thief: let the caller look elsewhere
+      if (AtomicOperations::CompareAndSet (&top, IndexAdd (t, 1), t) != t)
+        return 0;
+      iJob* job = TakeSlot (t);
+      if (job) return job;
+    }
+  }
+
+  bool WorkStealingJobQueue::JobDeque::Claim (iJob* job)
+  {
+    const int32 t = AtomicOperations::Read (&top);
+    const int32 b = AtomicOperations::Read (&bottom);
+    for (int32 i = t; IndexDiff (b, i) > 0; i = IndexAdd (i, 1))
+    {
+      void** slot = slots + (uint32 (i) & (Capacity - 1));
+      if (AtomicOperations::CompareAndSet (slot, (void*)0, (void*)job) == job)
+        return true;
+    }
+    return false;
+  }
+
+  int32 WorkStealingJobQueue::JobDeque::GetSize () const
+  {
+    const int32 t = AtomicOperations::Read (&top);
+    const int32 b = AtomicOperations::Read (&bottom);
+    return csMax (IndexDiff (b, t), 0);
+  }
+
+  //-------------------------------------------------------------------------
+
+  WorkStealingJobQueue::WorkerState::WorkerState (WorkStealingJobQueue* queue,
+    unsigned int id) : inboxSize (0), currentJob (0), takeEpoch (0),
+    numJobWaiters (0),
+    victimRand (0x9e3779b9u * (id + 1))
+  {
+    runnable.AttachNew (new WorkerRunnable (queue, this, id));
+    threadObject.AttachNew (new Thread (runnable, false));
+  }
+
+  //-------------------------------------------------------------------------
+
+  WorkStealingJobQueue::WorkStealingJobQueue (size_t numWorkers,
+    ThreadPriority priority, const char* name)
+    : scfImplementationType (this),
+    objectReg (nullptr),
+    numWorkerThreads (csMax (numWorkers, size_t (1))),
+    outstandingJobs (0), queuedJobs (0), nextInbox (0), spinCount (64),
+    shutdown (0), numParked (0), numAllWaiters (0), name (name)
+  {
+    Init (priority);
+  }
+
+  WorkStealingJobQueue::WorkStealingJobQueue (iObjectRegistry* objectReg,
+    size_t numWorkers, ThreadPriority priority, const char* name)
+    : scfImplementationType (this),
+    objectReg (objectReg),
+    numWorkerThreads (csMax (numWorkers, size_t (1))),
+    outstandingJobs (0), queuedJobs (0), nextInbox (0), spinCount (64),
+    shutdown (0), numParked (0), numAllWaiters (0), name (name)
+  {
+    Init (priority);
+  }
+
+  void WorkStealingJobQueue::Init (ThreadPriority priority)
+  {
+    if (this->name.IsEmpty())
+      this->name.Format ("Queue [%p]", this);
+
+    allWorkerState = new WorkerState*[numWorkerThreads];
+
+    for (size_t i = 0; i < numWorkerThreads; ++i)
+    {
+      allWorkerState[i] = new WorkerState (this, (unsigned int)i);
+      allWorkerState[i]->threadObject->SetPriority (priority);
+
+      allThreads.Add (allWorkerState[i]->threadObject);
+    }
+
+    allThreads.StartAll ();
+  }
+
+  WorkStealingJobQueue::~WorkStealingJobQueue ()
+  {
+    AtomicOperations::Set (&shutdown, 1);
+    {
+      MutexScopedLock l (parkMutex);
+      parkCondition.NotifyAll ();
+    }
+
+    allThreads.WaitAll ();
+
+    // Releases any jobs that never ran
+    for (size_t i = 0; i < numWorkerThreads; ++i)
+      delete allWorkerState[i];
+    delete[] allWorkerState;
+  }
+
+  void WorkStealingJobQueue::Enqueue (iJob* job)
+  {
+    if (!job)
+      return;
+
+    AtomicOperations::Increment (&outstandingJobs);
+
+    WorkerState* ws = static_cast<WorkerState*> (currentWorker.GetValue ());
+    if (!ws || !ws->deque.Push (job))
+    {
+      // Enqueued from outside the pool (or own deque full): use an inbox
+      const size_t start =
+        (uint32)AtomicOperations::Increment (&nextInbox) % numWorkerThreads;
+      bool queued = false;
+      for (size_t i = 0; i < numWorkerThreads && !queued; ++i)
+      {
+        WorkerState* target = allWorkerState[(start + i) % numWorkerThreads];
+        // Might be contended, so try next if locked
+        if (target->inboxMutex.TryLock ())
+        {
+          target->inbox.Push (job);
+          AtomicOperations::Increment (&target->inboxSize);
+          target->inboxMutex.Unlock ();
+          queued = true;
+        }
+      }
+      if (!queued)
+      {
+        WorkerState* target = allWorkerState[start];
+        MutexScopedLock l (target->inboxMutex);
+        target->inbox.Push (job);
+        AtomicOperations::Increment (&target->inboxSize);
+      }
+    }
+
+    AtomicOperations::Increment (&queuedJobs);
+    WakeWorker ();
+  }
+
+  void WorkStealingJobQueue::WakeWorker ()
+  {
+    if (AtomicOperations::Read (&numParked) > 0)
+    {
+      MutexScopedLock l (parkMutex);
+      parkCondition.NotifyOne ();
+    }
+  }
+
+  void WorkStealingJobQueue::JobDone ()
+  {
+    if ((AtomicOperations::Decrement (&outstandingJobs) == 0)
+      && (AtomicOperations::Read (&numAllWaiters) > 0))
+    {
+      MutexScopedLock l (allFinishedMutex);
+      allFinished.NotifyAll ();
+    }
+  }
+
+  iJobQueue::JobStatus WorkStealingJobQueue::Dequeue (iJob* job,
+    bool waitForCompletion)
+  {
+    if (PullFromQueues (job))
+    {
+      AtomicOperations::Decrement (&queuedJobs);
+      JobDone ();
+      job->DecRef ();
+      return Dequeued;
+    }
+    return CheckCompletion (job, waitForCompletion);
+  }
+
+  iJobQueue::JobStatus WorkStealingJobQueue::PullAndRun (iJob* job,
+    bool waitForCompletion)
+  {
+    if (!objectReg) return InternalPullAndRunImpl (job, waitForCompletion);
+
+    csRef<iThreadReturn> ret (InternalPullAndRun (job, waitForCompletion));
+    return static_cast<iJobQueue::JobStatus> (
+      reinterpret_cast<uintptr_t> (ret->GetResultPtr()));
+  }
+
+  THREADED_CALLABLE_IMPL2(WorkStealingJobQueue, InternalPullAndRun,
+    csRef<iJob> job, bool waitForCompletion)
+  {
+    ret->SetResult (reinterpret_cast<void*> (
+      static_cast<uintptr_t> (InternalPullAndRunImpl (job, waitForCompletion))));
+    return true;
+  }
+
+  iJobQueue::JobStatus WorkStealingJobQueue::InternalPullAndRunImpl (
+    iJob* job, bool waitForCompletion)
+  {
+    if (PullFromQueues (job))
+    {
+      AtomicOperations::Decrement (&queuedJobs);
+      RunJob (job);
+      JobDone ();
+      job->DecRef ();
+      return Dequeued;
+    }
+    return CheckCompletion (job, waitForCompletion);
+  }
+
+  bool WorkStealingJobQueue::PullFromQueues (iJob* job)
+  {
+    for (size_t i = 0; i < numWorkerThreads; ++i)
+    {
+      WorkerState* ws = allWorkerState[i];
+      if (AtomicOperations::Read (&ws->inboxSize) > 0)
+      {
+        csRef<iJob> jobRef (job);
+        MutexScopedLock l (ws->inboxMutex);
+        if (ws->inbox.Delete (jobRef))
+        {
+          AtomicOperations::Decrement (&ws->inboxSize);
+          // Caller takes over the reference the inbox held
+          job->IncRef ();
+          return true;
+        }
+      }
+      if (ws->deque.Claim (job))
+        return true;
+    }
+    return false;
+  }
+
+  iJobQueue::JobStatus WorkStealingJobQueue::CheckCompletion (iJob* job,
+    bool waitForCompletion)
+  {
+    for (size_t i = 0; i < numWorkerThreads; ++i)
+    {
+      WorkerState* ws = allWorkerState[i];
+      /* The job might have just been taken out of a queue, but not been
+       * published as current yet. Wait for the take to settle. */
+      const int32 epoch = AtomicOperations::Read (&ws->takeEpoch);
+      while ((epoch & 1) && (AtomicOperations::Read (&ws->takeEpoch) == epoch))
+        Thread::Yield ();
+      if (AtomicOperations::Read (&ws->currentJob) != job) continue;
+
+      if (!waitForCompletion) return Pending;
+
+      AtomicOperations::Increment (&ws->numJobWaiters);
+      {
+        MutexScopedLock l (ws->jobFinishedMutex);
+        while (AtomicOperations::Read (&ws->currentJob) == job)
+          ws->jobFinished.Wait (ws->jobFinishedMutex);
+      }
+      AtomicOperations::Decrement (&ws->numJobWaiters);
+      return Dequeued;
+    }
+    return NotEnqueued;
+  }
+
+  void WorkStealingJobQueue::WaitAll ()
+  {
+    AtomicOperations::Increment (&numAllWaiters);
+    {
+      MutexScopedLock l (allFinishedMutex);
+      while (AtomicOperations::Read (&outstandingJobs) != 0)
+        allFinished.Wait (allFinishedMutex);
+    }
+    AtomicOperations::Decrement (&numAllWaiters);
+  }
+
+  bool WorkStealingJobQueue::IsFinished ()
+  {
+    int32 c = AtomicOperations::Read (&outstandingJobs);
+    return c == 0;
+  }
+
+  int32 WorkStealingJobQueue::GetQueueCount()
+  {
+    return AtomicOperations::Read (&outstandingJobs);
+  }
+
+  //-------------------------------------------------------------------------
+
+  WorkStealingJobQueue::WorkerRunnable::WorkerRunnable (
+    WorkStealingJobQueue* queue, WorkerState* ws, unsigned int id)
+    : ownerQueue (queue), workerState (ws)
+  {
+    name.Format ("#%u %s", id, queue->GetName());
+  }
+
+  iJob* WorkStealingJobQueue::WorkerRunnable::FindJob ()
+  {
+    WorkerState* ws = workerState;
+
+    // Own deque first
+    iJob* job = ws->deque.Pop ();
+    if (job) return job;
+
+    // Then jobs enqueued from outside; move them into the deque so they can
+    // be stolen without locking
+    if (AtomicOperations::Read (&ws->inboxSize) > 0)
+    {
+      MutexScopedLock l (ws->inboxMutex);
+      if (ws->inbox.GetSize () > 0)
+      {
+        csRef<iJob> inboxJob (ws->inbox.PopTop ());
+        job = inboxJob;
+        job->IncRef ();
+        AtomicOperations::Decrement (&ws->inboxSize);
+      }
+      while (ws->inbox.GetSize () > 0)
+      {
+        if (!ws->deque.Push (ws->inbox.Top ())) break;
+        ws->inbox.PopTop ();
+        AtomicOperations::Decrement (&ws->inboxSize);
+      }
+      if (job) return job;
+    }
+
+    // Steal, starting at a random victim
+    const size_t numWorkers = ownerQueue->numWorkerThreads;
+    const size_t start = ws->victimRand.Get ((uint32)numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i)
+    {
+      WorkerState* victim = ownerQueue->allWorkerState[(start + i) % numWorkers];
+      if (victim == ws) continue;
+
+      job = victim->deque.Steal ();
+      if (job) return job;
+
+      // Victim may be busy and not have emptied its inbox; never wait for it
+      if ((AtomicOperations::Read (&victim->inboxSize) > 0)
+        && victim->inboxMutex.TryLock ())
+      {
+        if (victim->inbox.GetSize () > 0)
+        {
+          csRef<iJob> inboxJob (victim->inbox.PopTop ());
+          job = inboxJob;
+          job->IncRef ();
+          AtomicOperations::Decrement (&victim->inboxSize);
+        }
+        victim->inboxMutex.Unlock ();
+        if (job) return job;
+      }
+    }
+
+    return 0;
+  }
+
+  void WorkStealingJobQueue::WorkerRunnable::Park ()
+  {
+    MutexScopedLock l (ownerQueue->parkMutex);
+    AtomicOperations::Increment (&ownerQueue->numParked);
+    /* Enqueue() bumps queuedJobs before looking at numParked, so checking
+     * it after announcing ourselves as parked can't miss a wakeup. */
+    if ((AtomicOperations::Read (&ownerQueue->queuedJobs) <= 0)
+      && (AtomicOperations::Read (&ownerQueue->shutdown) == 0))
+      ownerQueue->parkCondition.Wait (ownerQueue->parkMutex);
+    AtomicOperations::Decrement (&ownerQueue->numParked);
+  }
+
+  void WorkStealingJobQueue::WorkerRunnable::Run ()
+  {
+    ownerQueue->currentWorker.SetValue (workerState);
+
+    int32 idleRounds = 0;
+    while (AtomicOperations::Read (&ownerQueue->shutdown) == 0)
+    {
+      AtomicOperations::Increment (&workerState->takeEpoch);
+      iJob* job = FindJob ();
+      if (job)
+        AtomicOperations::Set (&workerState->currentJob, (void*)job);
+      AtomicOperations::Increment (&workerState->takeEpoch);
+
+      if (job)
+      {
+        idleRounds = 0;
+        AtomicOperations::Decrement (&ownerQueue->queuedJobs);
+
+        RunJob (job);
+        AtomicOperations::Set (&workerState->currentJob, (void*)0);
+        if (AtomicOperations::Read (&workerState->numJobWaiters) > 0)
+        {
+          MutexScopedLock l (workerState->jobFinishedMutex);
+          workerState->jobFinished.NotifyAll ();
+        }
+
+        ownerQueue->JobDone ();
+        /* Release reference to job only after the last access of the queue;
+           the job may hold the last reference to whatever owns the queue. */
+        job->DecRef ();
+      }
+      else if (idleRounds < ownerQueue->spinCount)
+      {
+        idleRounds++;
+        Thread::Yield ();
+      }
+      else
+      {
+        Park ();
+        idleRounds = 0;
+      }
+    }
+
+    ownerQueue->currentWorker.SetValue (0);
+  }
+
+  const char* WorkStealingJobQueue::WorkerRunnable::GetName () const
+  {
+    return name.GetDataSafe ();
+  }
+
+}
+}
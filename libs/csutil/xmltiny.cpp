@@ -601,9 +601,7 @@ const char* csTinyXmlDocument::Parse (iFile* file, bool collapse)
     return "File contains one or more null characters";
   }
 #endif
-  const char *error = Parse (data, collapse);
-  cs_free (data);
-  return error;
+  return ParseInSitu (data, collapse);
 }
 
 const char* csTinyXmlDocument::Parse (iDataBuffer* buf, bool collapse)
@@ -619,9 +617,7 @@ const char* csTinyXmlDocument::Parse (iDataBuffer* buf, bool collapse)
     return "File contains one or more null characters";
   }
 #endif
-  const char *error = Parse (data, collapse);
-  cs_free (data);
-  return error;
+  return ParseInSitu (data, collapse);
 }
 
 const char* csTinyXmlDocument::Parse (iString* str, bool collapse)
@@ -639,6 +635,16 @@ const char* csTinyXmlDocument::Parse (const char* buf, bool collapse)
   return 0;
 }
 
+const char* csTinyXmlDocument::ParseInSitu (char* buf, bool collapse)
+{
+  CreateRoot ();
+  root->SetCondenseWhiteSpace(collapse);
+  root->ParseInSitu (buf);
+  if (root->Error ())
+    return root->ErrorDesc ();
+  return 0;
+}
+
 const char* csTinyXmlDocument::Write (iFile* file)
 {
   return root->Print (file);
@@ -261,6 +261,11 @@ private:
   csTinyXmlNode* Alloc ();
   /// Allocate a node instance
   csTinyXmlNode* Alloc (TiDocumentNode*);
+  /**
+   * Parse a buffer allocated with cs_malloc() in place. The document takes
+   * ownership of it.
+   */
+  const char* ParseInSitu (char* buf, bool collapse);
 public:
   csTinyXmlDocument (csTinyDocumentSystem* sys);
   virtual ~csTinyXmlDocument ();
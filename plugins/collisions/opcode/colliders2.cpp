@@ -18,120 +18,90 @@
 
 #include "cssysdef.h"
 #include "csgeom/tri.h"
-#include "iengine/movable.h"
-#include "igeom/trimesh.h"
-#include "iengine/mesh.h"
-#include "csutil/stringquote.h"
-#include "imesh/objmodel.h"
 #include "colliders2.h"
-#include "collisionobject2.h"
 
 using namespace CS::Collisions;
 
 CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
-csRef<iTriangleMesh> FindColdetTriangleMesh (iMeshWrapper* mesh,
-  csStringID baseID, csStringID colldetID)
+csOpcodeCollider::csOpcodeCollider ()
+  : scfImplementationType (this), volume (0), model (nullptr),
+  indexholder (nullptr), vertholder (nullptr)
 {
-  iObjectModel* objModel = mesh->GetMeshObject ()->GetObjectModel ();
-  csRef<iTriangleMesh> triMesh;
-  bool use_trimesh = objModel->IsTriangleDataSet (baseID);
-  if (use_trimesh)
-  {
-    if  (objModel->GetTriangleData (colldetID))
-      triMesh = objModel->GetTriangleData (colldetID);
-    else
-      triMesh = objModel->GetTriangleData (baseID);
-  }
-
-  if (!triMesh || triMesh->GetVertexCount () == 0
-    || triMesh->GetTriangleCount () == 0)
-  {
-    csFPrintf (stderr, "iCollider: No collision polygons, triangles or vertices on mesh factory %s\n",
-      CS::Quote::Single (mesh->QueryObject ()->GetName ()));
-
-    return NULL;
-  }
-  return triMesh;
+  opcMeshInt.SetCallback (&MeshCallback, this);
 }
 
-csOpcodeCollider::csOpcodeCollider (iMeshWrapper* mesh, csOpcodeCollisionSystem* sys)
-  : scfImplementationType (this), system (sys), mesh (mesh), model (NULL),
-  indexholder (NULL), vertholder (NULL), scale (1.0, 1.0, 1.0)
+csOpcodeCollider::csOpcodeCollider (iTriangleMesh* mesh)
+  : scfImplementationType (this), triMesh (mesh), volume (0), model (nullptr),
+  indexholder (nullptr), vertholder (nullptr)
 {
   opcMeshInt.SetCallback (&MeshCallback, this);
 
-  csRef<iTriangleMesh> triMesh = FindColdetTriangleMesh (mesh, 
-    system->baseID, system->colldetID);
-  if (!triMesh)
-    return;
-
   csVector3* vertices = triMesh->GetVertices ();
   size_t vertcount = triMesh->GetVertexCount ();
   csTriangle* triangles = triMesh->GetTriangles ();
   size_t tri_count = triMesh->GetTriangleCount ();
+  if ((vertcount == 0) || (tri_count == 0))
+    return;
+
+  vertholder = new Point [vertcount];
+  indexholder = new unsigned int[3*tri_count];
 
-  Opcode::OPCODECREATE OPCC;
   size_t i;
+  for (i = 0; i < vertcount; i++)
+    vertholder[i].Set (vertices[i].x , vertices[i].y , vertices[i].z);
 
-  if (tri_count>=1)
+  int index = 0;
+  for (i = 0 ; i < tri_count ; i++)
   {
-    model = new Opcode::Model;
-    if (!model)
-      return;
-
-    vertholder = new Point [vertcount];
-    indexholder = new unsigned int[3*tri_count];
+    indexholder[index++] = triangles[i].a;
+    indexholder[index++] = triangles[i].b;
+    indexholder[index++] = triangles[i].c;
+  }
 
-    aabbox.StartBoundingBox ();
-    for (i = 0; i < vertcount; i++)
-    {
-      aabbox.AddBoundingVertex (vertices[i]);
-      vertholder[i].Set (vertices[i].x , vertices[i].y , vertices[i].z);
-    }
+  BuildModel (vertcount, tri_count, false);
+}
 
-    volume = aabbox.Volume ();
+csOpcodeCollider::~csOpcodeCollider ()
+{
+  delete model;
+  delete[] indexholder;
+  delete[] vertholder;
+}
 
-    int index = 0;
-    for (i = 0 ; i < tri_count ; i++)
-    {
-      indexholder[index++] = triangles[i].a;
-      indexholder[index++] = triangles[i].b;
-      indexholder[index++] = triangles[i].c;
-    }
+void csOpcodeCollider::BuildModel (size_t numVertices, size_t numTriangles,
+                                   bool canRemap)
+{
+  aabbox.StartBoundingBox ();
+  for (size_t i = 0; i < numVertices; i++)
+    aabbox.AddBoundingVertex (vertholder[i].x, vertholder[i].y,
+      vertholder[i].z);
+  volume = aabbox.Volume ();
 
-    opcMeshInt.SetNbTriangles ((udword)tri_count);
-    opcMeshInt.SetNbVertices ((udword)vertcount);
+  opcMeshInt.SetNbTriangles ((udword)numTriangles);
+  opcMeshInt.SetNbVertices ((udword)numVertices);
 
-    // Mesh data
-    OPCC.mIMesh = &opcMeshInt;
-    OPCC.mSettings.mRules = Opcode::SPLIT_SPLATTER_POINTS | Opcode::SPLIT_GEOM_CENTER;
-    OPCC.mNoLeaf = true;
-    OPCC.mQuantized = true;
-    OPCC.mKeepOriginal = false;
-    OPCC.mCanRemap = false;
-  }
-  else
-    return;
+  Opcode::OPCODECREATE OPCC;
+  OPCC.mIMesh = &opcMeshInt;
+  OPCC.mSettings.mRules = Opcode::SPLIT_SPLATTER_POINTS | Opcode::SPLIT_GEOM_CENTER;
+  OPCC.mNoLeaf = true;
+  OPCC.mQuantized = true;
+  OPCC.mKeepOriginal = false;
+  OPCC.mCanRemap = canRemap;
 
-  // this should create the OPCODE model
-  bool status = model->Build (OPCC);
-  if (!status) 
+  model = new Opcode::Model;
+  if (!model->Build (OPCC))
   {
     delete model;
-    model = NULL;
+    model = nullptr;
+    aabbox.StartBoundingBox ();
   }
 }
 
-csOpcodeCollider::~csOpcodeCollider ()
+const csOrthoTransform& csOpcodeCollider::GetChildTransform (size_t index) const
 {
-  if (model)
-  {
-    delete model;
-    model = NULL;
-  }
-  delete[] indexholder;
-  delete[] vertholder;
+  static const csOrthoTransform identity;
+  return identity;
 }
 
 void csOpcodeCollider::MeshCallback (udword triangle_index,
@@ -148,34 +118,17 @@ void csOpcodeCollider::MeshCallback (udword triangle_index,
   triangle.Vertex[2] = &vertholder [tri_array[index + 2]];
 }
 
-csOpcodeColliderTerrain::csOpcodeColliderTerrain (iTerrainCell* cell, csOrthoTransform trans, csOpcodeCollisionSystem* sys)
- : scfImplementationType (this, sys), cell (cell), cellTransform (trans)
+csOpcodeColliderTerrainCell::csOpcodeColliderTerrainCell (iTerrainCell* cell)
+ : scfImplementationType (this), cell (cell)
 {
-  mesh = nullptr;
-  opcMeshInt.SetCallback (&MeshCallback, this);
-
-  Opcode::OPCODECREATE OPCC;
-
   unsigned int width = cell->GetGridWidth ();
   unsigned int height = cell->GetGridHeight ();
+  if ((width < 2) || (height < 2))
+    return;
 
   vertholder = new Point [width * height];
   indexholder = new unsigned int[3 * 2 * (width - 1) * (height - 1)];
 
-  model = new Opcode::Model;
-
-  opcMeshInt.SetNbTriangles (2 * (width-1) * (height-1));
-  opcMeshInt.SetNbVertices ((udword)width * height);
-
-  // Mesh data
-  OPCC.mIMesh = &opcMeshInt;
-  OPCC.mSettings.mRules = Opcode::SPLIT_SPLATTER_POINTS |
-    Opcode::SPLIT_GEOM_CENTER;
-  OPCC.mNoLeaf = true;
-  OPCC.mQuantized = true;
-  OPCC.mKeepOriginal = false;
-  OPCC.mCanRemap = true;
-
   float offset_x = cell->GetPosition ().x;
   float offset_y = cell->GetPosition ().y;
 
@@ -209,111 +162,11 @@ csOpcodeColliderTerrain::csOpcodeColliderTerrain (iTerrainCell* cell, csOrthoTra
     }
   }
 
-  model->Build (OPCC);
-}
-
-csOpcodeColliderTerrain::~csOpcodeColliderTerrain ()
-{
-  if (model)
-  {
-    delete model;
-    model = NULL;
-  }
-  if (indexholder)
-    delete[] indexholder;
-  indexholder = NULL;
-
-  if (vertholder)
-    delete[] vertholder;
-  vertholder = NULL;
+  BuildModel (width * height, 2 * (width - 1) * (height - 1), true);
 }
 
-void csOpcodeColliderTerrain::MeshCallback (udword triangle_index,
-                                     Opcode::VertexPointers& triangle,
-                                     void* user_data)
+csOpcodeColliderTerrainCell::~csOpcodeColliderTerrainCell ()
 {
-  csOpcodeColliderTerrain* collider = (csOpcodeColliderTerrain*)user_data;
-
-  udword *tri_array = collider->indexholder;
-  Point *vertholder = collider->vertholder;
-  int index = 3 * triangle_index;
-  triangle.Vertex[0] = &vertholder [tri_array[index]] ;
-  triangle.Vertex[1] = &vertholder [tri_array[index + 1]];
-  triangle.Vertex[2] = &vertholder [tri_array[index + 2]];
-}
-
-csOpcodeCollisionTerrain::csOpcodeCollisionTerrain (iTerrainSystem* terrain,
-                                                  csOpcodeCollisionSystem* sys)
- : scfImplementationType (this), terrainSystem (terrain), system (sys), sector(nullptr)
-{
-  unload = true;
-
-  terrain->AddCellLoadListener (this);
-
-  // Find the transform of the terrain
-  csRef<iMeshObject> meshObj = scfQueryInterface<iMeshObject> (terrain);
-  terrainTransform = meshObj->GetMeshWrapper ()->GetMovable ()->GetFullTransform ();
-  if(unload)
-  {
-    for (size_t i =0; i<terrainSystem->GetCellCount (); i++)
-    {
-      iTerrainCell* cell = terrainSystem->GetCell (i);
-
-      if (cell->GetLoadState () != iTerrainCell::Loaded)
-        continue;
-      LoadCellToCollider (cell);       
-    }
-    unload = true;
-  }
-
-  volume = FLT_MAX;
-}
-
-csOpcodeCollisionTerrain::~csOpcodeCollisionTerrain ()
-{
-}
-
-void csOpcodeCollisionTerrain::OnCellLoad (iTerrainCell *cell)
-{
-  LoadCellToCollider (cell);
-}
-
-void csOpcodeCollisionTerrain::OnCellPreLoad (iTerrainCell *cell)
-{
-
-}
-
-void csOpcodeCollisionTerrain::OnCellUnload (iTerrainCell *cell)
-{
-  for (size_t i = 0;i<objects.GetSize ();i++)
-  {
-    csOpcodeColliderTerrain* collider = dynamic_cast<csOpcodeColliderTerrain*>(objects[i]->GetCollider());
-    if (collider->cell == cell)
-    {
-      objects.DeleteIndexFast (i);
-      break;
-    }
-  }
-}
-
-void csOpcodeCollisionTerrain::LoadCellToCollider (iTerrainCell* cell)
-{
-  csOrthoTransform cellTransform;
-  cellTransform.Identity ();
-
-  csRef<csOpcodeColliderTerrain> collider = csPtr<csOpcodeColliderTerrain>(new csOpcodeColliderTerrain (cell, cellTransform, system));
-  
-  CollisionObjectProperties props(collider);
-  props.SetName("terrain");
-
-  csRef<iCollisionObject> iobj = csPtr<iCollisionObject>(system->CreateCollisionObject(&props));
-  csOpcodeCollisionObject* obj = dynamic_cast<csOpcodeCollisionObject*>(&*iobj);
-
-  objects.Push (obj);
-  if (sector)
-  {
-    sector->AddCollisionObject(iobj);
-  }
 }
 }
-CS_PLUGIN_NAMESPACE_END (Opcode2)
\ No newline at end of file
+CS_PLUGIN_NAMESPACE_END (Opcode2)
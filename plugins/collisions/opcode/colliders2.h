@@ -19,139 +19,94 @@
 #ifndef __CS_OPCODE_COLLIDER_H__
 #define __CS_OPCODE_COLLIDER_H__
 
+#include "csgeom/box.h"
+#include "csutil/scf_implementation.h"
+#include "csutil/weakref.h"
+#include "igeom/trimesh.h"
 #include "imesh/terrain2.h"
 #include "ivaria/collisions.h"
 #include "Opcode.h"
-#include "opcodecollisionsystem.h"
 
 CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
-class csOpcodeCollider : public scfImplementation1<
+class csOpcodeCollisionSystem;
+
+/**
+ * A concave triangle mesh collider. This is the only kind of collider the
+ * Opcode plugin can test; it has no children.
+ */
+class csOpcodeCollider : public scfVirtImplementation1<
   csOpcodeCollider, CS::Collisions::iColliderConcaveMesh>
 {
   friend class csOpcodeCollisionObject;
   friend class csOpcodeCollisionSector;
 
 protected:
-  csOpcodeCollisionSystem* system;
-  iMeshWrapper* mesh;
+  csRef<iTriangleMesh> triMesh;
   float volume;
   Opcode::Model* model;
   Opcode::MeshInterface opcMeshInt;
   unsigned int* indexholder;
   Point *vertholder;
-  csVector3 scale;
   csBox3 aabbox;
 
   static void MeshCallback (udword triangle_index, 
     Opcode::VertexPointers& triangle, void* user_data);
 
+  /// Build the Opcode model from vertholder and indexholder
+  void BuildModel (size_t numVertices, size_t numTriangles, bool canRemap);
+
   // for overriding
-  csOpcodeCollider (csOpcodeCollisionSystem* sys) : scfImplementationType (this), system (sys), mesh (nullptr) {}
+  csOpcodeCollider ();
 
 public:
-  csOpcodeCollider (iMeshWrapper* mesh, csOpcodeCollisionSystem* sys);
+  csOpcodeCollider (iTriangleMesh* mesh);
   virtual ~csOpcodeCollider();
-  virtual CS::Collisions::ColliderType GetColliderType () const {return CS::Collisions::COLLIDER_CONCAVE_MESH;}
-  virtual iMeshWrapper* GetMesh () {return mesh;}
-  virtual void SetLocalScale (const csVector3& scale) {}
-  virtual const csVector3& GetLocalScale () const {return scale;}
-  virtual void SetMargin (float margin) {}
-  virtual float GetMargin () const {return 0;}
-  virtual float GetVolume () const {return volume;}
-  virtual bool IsDynamic () const {return false;}
 
-  virtual void GetAABB(csVector3& aabbMin, csVector3& aabbMax) const { /* TODO */ }
-  
-  virtual void AddCollider (CS::Collisions::iCollider* collider, const csOrthoTransform& relaTrans = csOrthoTransform ()) {}
-  virtual void RemoveCollider (CS::Collisions::iCollider* collider) {}
-  virtual void RemoveCollider (size_t index) {}
-
-  virtual CS::Collisions::iCollider* GetCollider (size_t index) { return this; }
-  virtual size_t GetColliderCount () { return 1;}
-  
-  /// Get the frame of reference
-  virtual csOrthoTransform GetPrincipalAxisTransform() const 
-  {
-    csOrthoTransform trans;
-    return trans;
-  }
-
-  /// Set the frame of reference
-  virtual void SetPrincipalAxisTransform(const csOrthoTransform& trans)
-  {
-    // Does nothing for now
-  }
+  //-- CS::Collisions::iCollider
+  virtual CS::Collisions::ColliderType GetColliderType () const
+  { return CS::Collisions::COLLIDER_CONCAVE_MESH; }
+  virtual void SetLocalScale (const csVector3& scale) {}
+  virtual csVector3 GetLocalScale () const { return csVector3 (1.0f); }
+  virtual float GetVolume () const { return volume; }
+  virtual bool IsDynamic () const { return false; }
+
+  virtual void AddChild (CS::Collisions::iCollider* collider,
+    const csOrthoTransform& transform = csOrthoTransform ()) {}
+  virtual void RemoveChild (CS::Collisions::iCollider* collider) {}
+  virtual void RemoveChild (size_t index) {}
+  virtual size_t GetChildrenCount () const { return 0; }
+  virtual CS::Collisions::iCollider* GetChild (size_t index)
+  { return nullptr; }
+  virtual void SetChildTransform (size_t index,
+    const csOrthoTransform& transform) {}
+  virtual const csOrthoTransform& GetChildTransform (size_t index) const;
+
+  //-- CS::Collisions::iColliderConcaveMesh
+  virtual iTriangleMesh* GetMesh () const { return triMesh; }
+
+  /// Bounding box in collider space (empty if there is no model)
+  const csBox3& GetBBox () const { return aabbox; }
 };
 
-class csOpcodeColliderTerrain : public scfVirtImplementationExt1<
-  csOpcodeColliderTerrain, 
+/// A collider for one cell of a csOpcodeCollisionTerrain
+class csOpcodeColliderTerrainCell : public scfVirtImplementationExt1<
+  csOpcodeColliderTerrainCell, 
   csOpcodeCollider, 
-  CS::Collisions::iColliderTerrain>
+  CS::Collisions::iColliderTerrainCell>
 {
-  friend class csOpcodeCollisionObject;
-
-  static void MeshCallback (udword triangle_index, 
-    Opcode::VertexPointers& triangle, void* user_data);
+  csWeakRef<iTerrainCell> cell;
 
 public:
-  iTerrainCell* cell;
-  csOrthoTransform cellTransform;
-
-  csOpcodeColliderTerrain(iTerrainCell* cell, csOrthoTransform trans, csOpcodeCollisionSystem* sys);
-  virtual ~csOpcodeColliderTerrain();
+  csOpcodeColliderTerrainCell (iTerrainCell* cell);
+  virtual ~csOpcodeColliderTerrainCell ();
   
-  virtual CS::Collisions::ColliderType GetColliderType () const {return CS::Collisions::COLLIDER_TERRAIN;}
-  virtual iTerrainCell* GetCell() const { return cell; }
-
-  /// Get the frame of reference
-  virtual csOrthoTransform GetPrincipalAxisTransform() const 
-  {
-    csOrthoTransform trans;
-    return trans;
-  }
-
-  /// Set the frame of reference
-  virtual void SetPrincipalAxisTransform(const csOrthoTransform& trans)
-  {
-    // Does nothing for now
-  }
-};
-
-class csOpcodeCollisionTerrain : public scfVirtImplementation2<
-  csOpcodeCollisionTerrain,
-  CS::Collisions::iCollisionTerrain, 
-  iTerrainCellLoadCallback>
-{
-  friend class csOpcodeCollisionObject;
-  friend class csOpcodeCollisionSector;
-
-  csRefArray<csOpcodeCollisionObject> objects;
-  iTerrainSystem* terrainSystem;
-  csOpcodeCollisionSystem* system;
-
-  csOpcodeCollisionSector* sector;
-  csOrthoTransform terrainTransform;
-  float volume;
-  bool unload;
-  csVector3 scale;
-
-public:
-  csOpcodeCollisionTerrain(iTerrainSystem* terrain, csOpcodeCollisionSystem* sys);
-  virtual ~csOpcodeCollisionTerrain();
-  virtual CS::Collisions::ColliderType GetType() const {return CS::Collisions::COLLIDER_TERRAIN;}
-  virtual iTerrainSystem* GetTerrain() const {return terrainSystem;}
-  virtual void SetLocalScale (const csVector3& scale) {}
-  virtual const csVector3& GetLocalScale () const {return scale;}
-  virtual void SetMargin (float margin) {}
-  virtual float GetMargin () const {return 0;}
-  virtual float GetVolume () const {return volume;}
-
-  virtual void OnCellLoad (iTerrainCell *cell);
-  virtual void OnCellPreLoad (iTerrainCell *cell);
-  virtual void OnCellUnload (iTerrainCell *cell);
+  //-- CS::Collisions::iCollider
+  virtual CS::Collisions::ColliderType GetColliderType () const
+  { return CS::Collisions::COLLIDER_TERRAIN_CELL; }
 
-  void LoadCellToCollider (iTerrainCell* cell);
+  //-- CS::Collisions::iColliderTerrainCell
+  virtual iTerrainCell* GetCell () const { return cell; }
 };
 }
 CS_PLUGIN_NAMESPACE_END (Opcode2)
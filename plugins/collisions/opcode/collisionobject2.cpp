@@ -19,132 +19,250 @@
 #include "cssysdef.h"
 #include "iengine/movable.h"
 #include "collisionobject2.h"
+#include "opcodecollisionsector.h"
+#include "opcodecollisionsystem.h"
 
 using namespace CS::Collisions;
 
 CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
-void csOpcodeCollisionObject::CreateCollisionObject(CS::Collisions::CollisionObjectProperties* props)
+csOpcodeCollisionObject::csOpcodeCollisionObject (csOpcodeCollisionSystem* sys,
+                                                  CollisionObjectType type)
+  : scfImplementationType (this), system (sys), sector (nullptr), type (type),
+  group (sys->GetDefaultGroup ()), deactivable (true), owner (nullptr),
+  inTree (false)
 {
-  SetCollider(props->GetCollider());
-  SetName(props->GetName());
+  transform.Identity ();
+}
+
+csOpcodeCollisionObject::~csOpcodeCollisionObject ()
+{
+  if (sceneNode && movableListener)
+    sceneNode->GetMovable ()->RemoveListener (movableListener);
+}
+
+void csOpcodeCollisionObject::MovableListener::MovableChanged (
+  iMovable* movable)
+{
+  object->transform = movable->GetFullTransform ();
+  object->UpdateBounds ();
+}
+
+bool csOpcodeCollisionObject::GetWorldBBox (csBox3& box) const
+{
+  csOpcodeCollider* opcCollider = GetOpcodeCollider ();
+  if (!opcCollider || opcCollider->GetBBox ().Empty ())
+    return false;
+  box = GetColliderWorldTransform ().This2Other (opcCollider->GetBBox ());
+  return true;
+}
+
+void csOpcodeCollisionObject::UpdateBounds ()
+{
+  if (sector)
+    sector->UpdateObjectBounds (this);
+}
+
+void csOpcodeCollisionObject::AddOpcodeObject ()
+{
+  sector->InsertObjectBounds (this);
+}
+
+void csOpcodeCollisionObject::RemoveOpcodeObject ()
+{
+  sector->RemoveObjectBounds (this);
+}
+
+csOpcodeCollider* csOpcodeCollisionObject::GetOpcodeCollider () const
+{
+  CS::Collisions::iCollider* col = collider;
+  csOpcodeCollider* opcCollider = dynamic_cast<csOpcodeCollider*> (col);
+  if (!opcCollider || !opcCollider->model)
+    return nullptr;
+  return opcCollider;
+}
+
+bool csOpcodeCollisionObject::CollidesWith (
+  const csOpcodeCollisionObject* other) const
+{
+  return (group->value & other->group->mask)
+    && (other->group->value & group->mask);
+}
+
+void csOpcodeCollisionObject::SetSector (iCollisionSector* sector)
+{
+  if (this->sector) this->sector->RemoveCollisionObject (this);
+  if (sector) sector->AddCollisionObject (this);
+}
+
+iCollisionSector* csOpcodeCollisionObject::GetSector () const
+{
+  return sector;
+}
+
+void csOpcodeCollisionObject::SetAttachedSceneNode (iSceneNode* newSceneNode)
+{
+  if (sceneNode == newSceneNode) return;
 
-  if (props->GetCollisionGroup().name.Length())
+  if (sceneNode)
   {
-    SetCollisionGroup(props->GetCollisionGroup());
+    iMovable* movable = sceneNode->GetMovable ();
+    if (movableListener)
+      movable->RemoveListener (movableListener);
+    if (sector && sector->GetSector ())
+    {
+      // Remove the previous movable from the engine sector
+      movable->SetSector (nullptr);
+      movable->UpdateMove ();
+    }
   }
-  else
+
+  sceneNode = newSceneNode;
+
+  if (sceneNode)
   {
-    SetCollisionGroup(system->FindCollisionGroup("Default"));
+    iMovable* movable = sceneNode->GetMovable ();
+    movable->SetFullTransform (transform);
+    if (sector && sector->GetSector ())
+      // Add the new movable to the engine sector
+      movable->SetSector (sector->GetSector ());
+    movable->UpdateMove ();
+
+    if (!movableListener)
+      movableListener.AttachNew (new MovableListener (this));
+    movable->AddListener (movableListener);
   }
 }
 
-csOpcodeCollisionObject::csOpcodeCollisionObject (csOpcodeCollisionSystem* sys)
-  : scfImplementationType (this), system (sys), sector (NULL),
-  collider (NULL),
-  collCb (NULL)
+void csOpcodeCollisionObject::SetAttachedCamera (iCamera* newCamera)
 {
-  transform.Identity ();
+  if (camera == newCamera) return;
+
+  camera = newCamera;
+  if (camera)
+  {
+    camera->SetTransform (transform);
+    if (sector && sector->GetSector ())
+      camera->SetSector (sector->GetSector ());
+  }
 }
 
-csOpcodeCollisionObject::~csOpcodeCollisionObject ()
+void csOpcodeCollisionObject::SetCollider (CS::Collisions::iCollider* newCollider,
+                                           const csOrthoTransform& trans)
 {
+  collider = newCollider;
+  colliderTransform = trans;
+  UpdateBounds ();
+}
 
+void csOpcodeCollisionObject::SetColliderTransform (
+  const csOrthoTransform& trans)
+{
+  colliderTransform = trans;
+  UpdateBounds ();
 }
 
 void csOpcodeCollisionObject::SetTransform (const csOrthoTransform& trans)
 {
   transform = trans;
-  if (movable)
-    movable->SetFullTransform (transform);
+  if (sceneNode)
+  {
+    // The movable listener updates the bounds
+    sceneNode->GetMovable ()->SetFullTransform (transform);
+    sceneNode->GetMovable ()->UpdateMove ();
+  }
+  else
+    UpdateBounds ();
   if (camera)
     camera->SetTransform (transform);
 }
 
-csOrthoTransform csOpcodeCollisionObject::GetTransform () const
+void csOpcodeCollisionObject::SetCollisionGroup (iCollisionGroup* group)
 {
-  if (movable)
-    return movable->GetFullTransform ();
-  if (camera)
-    return camera->GetTransform ();
-  return transform;
+  this->group = dynamic_cast<CollisionGroup*> (group);
+  if (!this->group) this->group = system->GetDefaultGroup ();
 }
 
-void csOpcodeCollisionObject::SetRotation (const csMatrix3& rot)
+iCollisionGroup* csOpcodeCollisionObject::GetCollisionGroup () const
 {
-  csOrthoTransform trans = GetTransform ();
-  trans.SetT2O (rot);
-  SetTransform (trans);
+  return group;
 }
 
-void csOpcodeCollisionObject::Rotate (const csVector3& v, float angle)
+csPtr<iCollisionData> csOpcodeCollisionObject::Collide (
+  iCollisionObject* otherObject) const
 {
-  csOrthoTransform trans = GetTransform ();
-  trans.RotateThis (v, angle);
-  SetTransform (trans);
+  csOpcodeCollisionObject* obj =
+    dynamic_cast<csOpcodeCollisionObject*> (otherObject);
+  if (!sector || !obj || !CollidesWith (obj))
+    return csPtr<iCollisionData> (nullptr);
+  // Terrains test the other object against each of their cells
+  if (obj->GetObjectType () == COLLISION_OBJECT_TERRAIN)
+    return obj->Collide (const_cast<csOpcodeCollisionObject*> (this));
+
+  csRef<CollisionData> data = sector->CollideObject (
+    const_cast<csOpcodeCollisionObject*> (this), obj);
+  if (data && collCb)
+    collCb->OnCollision (data);
+  return csPtr<iCollisionData> (data);
 }
 
-void csOpcodeCollisionObject::IncreasePitch(float pitchDelta)
+HitBeamResult csOpcodeCollisionObject::HitBeam (const csVector3& start,
+                                                const csVector3& end) const
 {
-  Rotate(CS_VEC_TILT_UP, pitchDelta);
+  if (!sector) return HitBeamResult ();
+  float depth;
+  return sector->HitBeamObject (const_cast<csOpcodeCollisionObject*> (this),
+    start, end, depth);
 }
 
-void csOpcodeCollisionObject::IncreaseYaw(float yawDelta)
+//There's no step function now. Maybe use ContactTest is better.
+size_t csOpcodeCollisionObject::GetContactObjectsCount () {return 0;}
+
+iCollisionObject* csOpcodeCollisionObject::GetContactObject (size_t index)
 {
-  Rotate (CS_VEC_ROT_RIGHT, yawDelta);
+  return nullptr;
 }
 
-void csOpcodeCollisionObject::RebuildObject ()
+//-------------------------- csOpcodeCollisionObjectFactory --------------------------
+
+csOpcodeCollisionObjectFactory::csOpcodeCollisionObjectFactory (
+  csOpcodeCollisionSystem* system, CS::Collisions::iCollider* collider,
+  CollisionObjectType type)
+  : scfImplementationType (this), system (system), collider (collider),
+  group (system->GetDefaultGroup ()), type (type)
 {
-  // does nothing
 }
 
-void csOpcodeCollisionObject::SetCollisionGroup (const char* name)
+iCollisionSystem* csOpcodeCollisionObjectFactory::GetSystem () const
 {
-  this->collGroup = system->FindCollisionGroup(name);
+  return system;
 }
 
-void csOpcodeCollisionObject::SetCollisionGroup (const CS::Collisions::CollisionGroup& group)
+csPtr<iCollisionObject> csOpcodeCollisionObjectFactory::CreateCollisionObject ()
 {
-  this->collGroup = group;
+  csRef<csOpcodeCollisionObject> object;
+  object.AttachNew (new csOpcodeCollisionObject (system, type));
+  object->SetCollider (collider, colliderTransform);
+  object->SetCollisionGroup (group);
+  return csPtr<iCollisionObject> (object);
 }
 
-bool csOpcodeCollisionObject::Collide (CS::Collisions::iCollisionObject* otherObject)
+void csOpcodeCollisionObjectFactory::SetCollider (CS::Collisions::iCollider* value,
+  const csOrthoTransform& transform)
 {
-  csOpcodeCollisionObject* obj = dynamic_cast<csOpcodeCollisionObject*> (otherObject);
-  bool collides = (obj->collGroup.value & collGroup.mask) != 0;
-  collides = collides && (collGroup.value & obj->collGroup.mask);
-
-  if(!collides)
-    return false;
-
-  csArray<CS::Collisions::CollisionData> collisions;
-
-  bool contact = sector->CollideObject (this, obj, collisions);
-  if (contact)
-  {
-    if (collCb)
-    {
-      collCb->OnCollision (this, obj, collisions);
-    }
-  }
-  return contact;
+  collider = value;
+  colliderTransform = transform;
 }
 
-CS::Collisions::HitBeamResult csOpcodeCollisionObject::HitBeam (const csVector3& start, const csVector3& end)
+void csOpcodeCollisionObjectFactory::SetCollisionGroup (iCollisionGroup* group)
 {
-  //CS::Collisions::iCollider* col = collider;
-  float dep;
-  CS::Collisions::HitBeamResult result = sector->HitBeamObject (this, start, end, dep);
-  return result;
+  this->group = dynamic_cast<CollisionGroup*> (group);
+  if (!this->group) this->group = system->GetDefaultGroup ();
 }
 
-//There's no step function now. Maybe use ContactTest is better.
-size_t csOpcodeCollisionObject::GetContactObjectsCount (){return 0;}
-
-CS::Collisions::iCollisionObject* csOpcodeCollisionObject::GetContactObject (size_t index)
+iCollisionGroup* csOpcodeCollisionObjectFactory::GetCollisionGroup () const
 {
-  return NULL;
+  return group;
 }
 }
 CS_PLUGIN_NAMESPACE_END (Opcode2)
@@ -19,94 +19,172 @@
 #ifndef __CS_OPCODE_COLLISIONOBJECT_H__
 #define __CS_OPCODE_COLLISIONOBJECT_H__
 
+#include "csgeom/box.h"
+#include "csutil/csobject.h"
+#include "csutil/weakref.h"
 #include "iengine/camera.h"
-#include "opcodecollisionsystem.h"
+#include "iengine/movable.h"
+#include "iengine/scenenode.h"
+#include "ivaria/collisions.h"
 #include "colliders2.h"
 
 CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
+class CollisionGroup;
 class csOpcodeCollisionSector;
 class csOpcodeCollisionSystem;
-class csOpcodeCollider;
 
-class csOpcodeCollisionObject: public scfImplementationExt1<
-  csOpcodeCollisionObject, csObject, CS::Collisions::iGhostCollisionObject>
+class csOpcodeCollisionObject: public scfVirtImplementationExt1<
+  csOpcodeCollisionObject, csObject, CS::Collisions::iCollisionObject>
 {
   friend class csOpcodeCollisionSector;
-private:
+  friend class csOpcodeCollisionTerrain;
+protected:
+  /// Keeps the transform and the broadphase bounds in sync with the movable
+  class MovableListener : public scfImplementation1<MovableListener,
+    iMovableListener>
+  {
+    csOpcodeCollisionObject* object;
+  public:
+    MovableListener (csOpcodeCollisionObject* object)
+      : scfImplementationType (this), object (object) {}
+
+    virtual void MovableChanged (iMovable* movable);
+    virtual void MovableDestroyed (iMovable* movable) {}
+  };
+
   csOpcodeCollisionSystem* system;
   csOpcodeCollisionSector* sector;
-  csWeakRef<iMovable> movable;
+  csRef<iSceneNode> sceneNode;
   csWeakRef<iCamera> camera;
   csRef<CS::Collisions::iCollider> collider;
+  csOrthoTransform colliderTransform;
   CS::Collisions::CollisionObjectType type;
-  CS::Collisions::CollisionGroup collGroup;
+  CollisionGroup* group;
   csRef<CS::Collisions::iCollisionCallback> collCb;
-  csRefArray<csOpcodeCollisionObject> contactObjects;
   csOrthoTransform transform;
-
-  bool insideWorld;
+  csRef<MovableListener> movableListener;
+  bool deactivable;
+  /// Object reported in collisions and hits instead of this one (or 0)
+  csOpcodeCollisionObject* owner;
+
+  /// Bounds of this object in the broadphase tree of the sector
+  csBox3 bbox;
+  /// Whether this object is in the broadphase tree (or has no bounds)
+  bool inTree;
+
+  /// Compute the world space box of the collider. Returns false if unknown.
+  bool GetWorldBBox (csBox3& box) const;
+  /// Tell the sector about a changed transform or collider
+  void UpdateBounds ();
+  /// Add this object to the broadphase of the sector
+  virtual void AddOpcodeObject ();
+  /// Remove this object from the broadphase of the sector
+  virtual void RemoveOpcodeObject ();
   
 public:
-  void CreateCollisionObject(CS::Collisions::CollisionObjectProperties* props);
-
-public:
-  csOpcodeCollisionObject (csOpcodeCollisionSystem* sys);
+  csOpcodeCollisionObject (csOpcodeCollisionSystem* sys,
+    CS::Collisions::CollisionObjectType type
+    = CS::Collisions::COLLISION_OBJECT_SIMPLE);
   virtual ~csOpcodeCollisionObject ();
 
+  //-- CS::Collisions::iCollisionObject
   virtual iObject* QueryObject (void) { return (iObject*) this; }
-  virtual CS::Collisions::iCollisionObject* QueryCollisionObject () {return dynamic_cast<iCollisionObject*> (this);}
-  virtual CS::Physics::iPhysicalBody* QueryPhysicalBody () {return nullptr;}
-  virtual CS::Collisions::iActor* QueryActor () {return nullptr;}
-
-  /// Returns the sector to which is this object has been added or nullptr, if not in world
-  virtual CS::Collisions::iCollisionSector* GetSector () const { return sector; }
+  virtual CS::Physics::iPhysicalBody* QueryPhysicalBody () { return nullptr; }
+  virtual CS::Collisions::iCollisionActor* QueryCollisionActor ()
+  { return nullptr; }
 
-  /// Whether this object is currently added to the world
-  virtual bool IsInWorld () const { return sector != nullptr; }
+  virtual void SetSector (CS::Collisions::iCollisionSector* sector);
+  virtual CS::Collisions::iCollisionSector* GetSector () const;
 
-  /// Whether this is a rigid or soft body object
-  virtual bool IsPhysicalObject() const { return false; }
+  virtual CS::Collisions::CollisionObjectType GetObjectType () const
+  { return type; }
 
-  virtual CS::Collisions::CollisionObjectType GetObjectType () const 
-  {
-      // doesn't really matter
-      return CS::Collisions::COLLISION_OBJECT_GHOST;
-  }
+  virtual void SetDeactivable (bool d) { deactivable = d; }
+  virtual bool GetDeactivable () const { return deactivable; }
 
-  virtual void SetAttachedMovable (iMovable* movable){this->movable = movable;}
-  virtual iMovable* GetAttachedMovable (){return movable;}
+  virtual void SetAttachedSceneNode (iSceneNode* sceneNode);
+  virtual iSceneNode* GetAttachedSceneNode () const { return sceneNode; }
 
-  virtual void SetAttachedCamera (iCamera* camera){this->camera = camera;}
-  virtual iCamera* GetAttachedCamera () const {return camera;}
+  virtual void SetAttachedCamera (iCamera* camera);
+  virtual iCamera* GetAttachedCamera () const { return camera; }
 
-  virtual void SetTransform (const csOrthoTransform& trans);
-  virtual csOrthoTransform GetTransform () const;
+  virtual void SetCollider (CS::Collisions::iCollider* collider,
+    const csOrthoTransform& transform = csOrthoTransform ());
+  virtual CS::Collisions::iCollider* GetCollider () const { return collider; }
 
-  virtual void SetRotation (const csMatrix3& rot);
-  virtual void Rotate (const csVector3& v, float angle);
-  virtual void IncreasePitch(float pitchDelta);
-  virtual void IncreaseYaw(float yawDelta);
+  virtual void SetColliderTransform (const csOrthoTransform& transform);
+  virtual const csOrthoTransform& GetColliderTransform () const
+  { return colliderTransform; }
 
-  virtual void GetAABB(csVector3& aabbMin, csVector3& aabbMax) const { /* TODO */ }
-  
-  virtual void SetCollider (CS::Collisions::iCollider* newCollider) { collider = newCollider; }
-  virtual CS::Collisions::iCollider* GetCollider () const { return collider; }
+  virtual void SetTransform (const csOrthoTransform& trans);
+  virtual csOrthoTransform GetTransform () const { return transform; }
 
-  virtual void RebuildObject ();
-  
-  virtual void SetCollisionGroup (const char* name);
-  virtual void SetCollisionGroup (const CS::Collisions::CollisionGroup& group);
-  virtual const CS::Collisions::CollisionGroup& GetCollisionGroup () const {return collGroup;}
+  virtual void SetCollisionGroup (CS::Collisions::iCollisionGroup* group);
+  virtual CS::Collisions::iCollisionGroup* GetCollisionGroup () const;
 
-  virtual void SetCollisionCallback (CS::Collisions::iCollisionCallback* cb) {collCb = cb;}
-  virtual CS::Collisions::iCollisionCallback* GetCollisionCallback () {return collCb;}
+  virtual void SetCollisionCallback (CS::Collisions::iCollisionCallback* cb)
+  { collCb = cb; }
+  virtual CS::Collisions::iCollisionCallback* GetCollisionCallback ()
+  { return collCb; }
 
-  virtual bool Collide (iCollisionObject* otherObject);
-  virtual CS::Collisions::HitBeamResult HitBeam (const csVector3& start, const csVector3& end);
+  virtual csPtr<CS::Collisions::iCollisionData> Collide (
+    CS::Collisions::iCollisionObject* otherObject) const;
+  virtual CS::Collisions::HitBeamResult HitBeam (const csVector3& start,
+    const csVector3& end) const;
 
   virtual size_t GetContactObjectsCount ();
   virtual CS::Collisions::iCollisionObject* GetContactObject (size_t index);
+
+  /// Get the collider if it can be tested by Opcode, or 0
+  csOpcodeCollider* GetOpcodeCollider () const;
+  /// World space transform of the collider
+  csOrthoTransform GetColliderWorldTransform () const
+  { return colliderTransform * transform; }
+  /// Whether the collision groups of this and \a other let them collide
+  bool CollidesWith (const csOpcodeCollisionObject* other) const;
+  /// The object to report in collisions and hits with this one
+  csOpcodeCollisionObject* GetReportedObject ()
+  { return owner ? owner : this; }
+
+  /// Bounding box used by the broadphase tree
+  const csBox3& GetBBox () const { return bbox; }
+};
+
+class csOpcodeCollisionObjectFactory : public scfVirtImplementationExt1<
+  csOpcodeCollisionObjectFactory, csObject,
+  CS::Collisions::iCollisionObjectFactory>
+{
+protected:
+  csRef<csOpcodeCollisionSystem> system;
+  csRef<CS::Collisions::iCollider> collider;
+  csOrthoTransform colliderTransform;
+  CollisionGroup* group;
+  CS::Collisions::CollisionObjectType type;
+
+public:
+  csOpcodeCollisionObjectFactory (csOpcodeCollisionSystem* system,
+    CS::Collisions::iCollider* collider,
+    CS::Collisions::CollisionObjectType type
+    = CS::Collisions::COLLISION_OBJECT_SIMPLE);
+
+  //-- CS::Collisions::iCollisionObjectFactory
+  virtual iObject *QueryObject () { return this; }
+  virtual CS::Collisions::iCollisionSystem* GetSystem () const;
+
+  virtual csPtr<CS::Collisions::iCollisionObject> CreateCollisionObject ();
+
+  virtual void SetCollider (CS::Collisions::iCollider* value,
+    const csOrthoTransform& transform = csOrthoTransform ());
+  virtual CS::Collisions::iCollider* GetCollider () const { return collider; }
+
+  virtual void SetColliderTransform (const csOrthoTransform& transform)
+  { colliderTransform = transform; }
+  virtual const csOrthoTransform& GetColliderTransform () const
+  { return colliderTransform; }
+
+  virtual void SetCollisionGroup (CS::Collisions::iCollisionGroup* group);
+  virtual CS::Collisions::iCollisionGroup* GetCollisionGroup () const;
 };
 }
 CS_PLUGIN_NAMESPACE_END (Opcode2)
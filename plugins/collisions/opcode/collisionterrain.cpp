@@ -0,0 +1,221 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "imesh/object.h"
+#include "iengine/mesh.h"
+#include "iengine/movable.h"
+#include "collisionterrain.h"
+#include "opcodecollisionsector.h"
+#include "opcodecollisionsystem.h"
+
+using namespace CS::Collisions;
+
+CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
+{
+//-------------------------- csOpcodeCollisionTerrainFactory --------------------------
+
+csOpcodeCollisionTerrainFactory::csOpcodeCollisionTerrainFactory (
+  csOpcodeCollisionSystem* system, iTerrainFactory* terrain)
+  : scfImplementationType (this, system, nullptr,
+    COLLISION_OBJECT_TERRAIN), terrain (terrain)
+{
+}
+
+csPtr<iCollisionObject> csOpcodeCollisionTerrainFactory::CreateCollisionObject ()
+{
+  // A terrain object needs the terrain to collide with
+  return csPtr<iCollisionObject> (nullptr);
+}
+
+csPtr<iCollisionTerrain> csOpcodeCollisionTerrainFactory::CreateTerrain (
+  iTerrainSystem* terrain)
+{
+  // Check that the terrain factory is the same
+  csRef<iMeshObject> mesh = scfQueryInterface<iMeshObject> (terrain);
+  csRef<iTerrainFactory> factory =
+    scfQueryInterface<iTerrainFactory> (mesh->GetFactory ());
+  if (this->terrain != factory)
+  {
+    system->ReportWarning ("Could not create the terrain collision object "
+      "because the terrain factory is not the same");
+    return csPtr<iCollisionTerrain> (nullptr);
+  }
+
+  return new csOpcodeCollisionTerrain (system, terrain, group);
+}
+
+//-------------------------- csOpcodeCollisionTerrain --------------------------
+
+csOpcodeCollisionTerrain::csOpcodeCollisionTerrain (
+  csOpcodeCollisionSystem* system, iTerrainSystem* terrain,
+  CollisionGroup* group)
+  : scfImplementationType (this, system, COLLISION_OBJECT_TERRAIN),
+  terrainSystem (terrain)
+{
+  this->group = group;
+
+  // Find the transform of the terrain
+  csRef<iMeshObject> mesh = scfQueryInterface<iMeshObject> (terrain);
+  transform = mesh->GetMeshWrapper ()->GetMovable ()->GetFullTransform ();
+
+  // Create the objects of the cells that are already loaded
+  terrain->AddCellLoadListener (this);
+  for (size_t i = 0; i < terrainSystem->GetCellCount (); i++)
+  {
+    iTerrainCell* cell = terrainSystem->GetCell (i);
+    if (cell->GetLoadState () == iTerrainCell::Loaded)
+      CreateCellObject (cell);
+  }
+}
+
+csOpcodeCollisionTerrain::~csOpcodeCollisionTerrain ()
+{
+  terrainSystem->RemoveCellLoadListener (this);
+}
+
+void csOpcodeCollisionTerrain::CreateCellObject (iTerrainCell* cell)
+{
+  // The vertices of the cell collider are in terrain space
+  csRef<csOpcodeColliderTerrainCell> collider;
+  collider.AttachNew (new csOpcodeColliderTerrainCell (cell));
+
+  csRef<csOpcodeCollisionObject> cellObject;
+  cellObject.AttachNew (new csOpcodeCollisionObject (system));
+  cellObject->owner = this;
+  cellObject->group = group;
+  cellObject->collider = collider;
+  cellObject->transform = transform;
+  cellObjects.Push (cellObject);
+
+  if (sector)
+  {
+    cellObject->sector = sector;
+    sector->InsertObjectBounds (cellObject);
+  }
+}
+
+void csOpcodeCollisionTerrain::AddOpcodeObject ()
+{
+  for (size_t i = 0; i < cellObjects.GetSize (); i++)
+  {
+    cellObjects[i]->sector = sector;
+    sector->InsertObjectBounds (cellObjects[i]);
+  }
+}
+
+void csOpcodeCollisionTerrain::RemoveOpcodeObject ()
+{
+  for (size_t i = 0; i < cellObjects.GetSize (); i++)
+  {
+    sector->RemoveObjectBounds (cellObjects[i]);
+    cellObjects[i]->sector = nullptr;
+  }
+}
+
+void csOpcodeCollisionTerrain::SetCollisionGroup (iCollisionGroup* group)
+{
+  csOpcodeCollisionObject::SetCollisionGroup (group);
+  for (size_t i = 0; i < cellObjects.GetSize (); i++)
+    cellObjects[i]->group = this->group;
+}
+
+csPtr<iCollisionData> csOpcodeCollisionTerrain::Collide (
+  iCollisionObject* otherObject) const
+{
+  csOpcodeCollisionObject* obj =
+    dynamic_cast<csOpcodeCollisionObject*> (otherObject);
+  if (!sector || !obj || !CollidesWith (obj))
+    return csPtr<iCollisionData> (nullptr);
+
+  // Gather the contacts with all cells
+  csRef<CollisionData> data;
+  for (size_t i = 0; i < cellObjects.GetSize (); i++)
+  {
+    csRef<CollisionData> cellData =
+      sector->CollideObject (cellObjects[i], obj);
+    if (!cellData) continue;
+    if (!data)
+      data = cellData;
+    else
+      for (size_t j = 0; j < cellData->contacts.GetSize (); j++)
+        data->contacts.Push (cellData->contacts[j]);
+  }
+  if (data && collCb)
+    collCb->OnCollision (data);
+  return csPtr<iCollisionData> (data);
+}
+
+HitBeamResult csOpcodeCollisionTerrain::HitBeam (const csVector3& start,
+                                                 const csVector3& end) const
+{
+  HitBeamResult result;
+  if (!sector) return result;
+  float depth = FLT_MAX;
+  for (size_t i = 0; i < cellObjects.GetSize (); i++)
+  {
+    float cellDepth;
+    HitBeamResult res = sector->HitBeamObject (cellObjects[i], start, end,
+      cellDepth);
+    if (res.hasHit && cellDepth < depth)
+    {
+      depth = cellDepth;
+      result = res;
+    }
+  }
+  return result;
+}
+
+iColliderTerrainCell* csOpcodeCollisionTerrain::GetCell (size_t index) const
+{
+  CS::Collisions::iCollider* collider = cellObjects[index]->collider;
+  return dynamic_cast<csOpcodeColliderTerrainCell*> (collider);
+}
+
+iColliderTerrainCell* csOpcodeCollisionTerrain::GetCell (
+  iTerrainCell* cell) const
+{
+  for (size_t i = 0; i < cellObjects.GetSize (); i++)
+  {
+    iColliderTerrainCell* collider = GetCell (i);
+    if (collider->GetCell () == cell)
+      return collider;
+  }
+  return nullptr;
+}
+
+void csOpcodeCollisionTerrain::OnCellLoad (iTerrainCell *cell)
+{
+  CreateCellObject (cell);
+}
+
+void csOpcodeCollisionTerrain::OnCellUnload (iTerrainCell *cell)
+{
+  for (size_t i = 0; i < cellObjects.GetSize (); i++)
+  {
+    if (GetCell (i)->GetCell () == cell)
+    {
+      if (sector)
+        sector->RemoveObjectBounds (cellObjects[i]);
+      cellObjects.DeleteIndexFast (i);
+      break;
+    }
+  }
+}
+}
+CS_PLUGIN_NAMESPACE_END (Opcode2)
@@ -0,0 +1,105 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_OPCODE_COLLISIONTERRAIN_H__
+#define __CS_OPCODE_COLLISIONTERRAIN_H__
+
+#include "imesh/terrain2.h"
+#include "collisionobject2.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
+{
+class csOpcodeCollisionTerrainFactory : public scfVirtImplementationExt1<
+  csOpcodeCollisionTerrainFactory, csOpcodeCollisionObjectFactory,
+  CS::Collisions::iCollisionTerrainFactory>
+{
+  csRef<iTerrainFactory> terrain;
+
+public:
+  csOpcodeCollisionTerrainFactory (csOpcodeCollisionSystem* system,
+    iTerrainFactory* terrain);
+
+  //-- CS::Collisions::iCollisionObjectFactory
+  virtual csPtr<CS::Collisions::iCollisionObject> CreateCollisionObject ();
+
+  virtual void SetCollider (CS::Collisions::iCollider* value,
+    const csOrthoTransform& transform = csOrthoTransform ()) {}
+  virtual void SetColliderTransform (const csOrthoTransform& transform) {}
+
+  //-- CS::Collisions::iCollisionTerrainFactory
+  virtual iTerrainFactory* GetTerrainFactory () const { return terrain; }
+  virtual csPtr<CS::Collisions::iCollisionTerrain> CreateTerrain (
+    iTerrainSystem* terrain);
+};
+
+/**
+ * A terrain, made of one collision object per loaded cell. The cell objects
+ * are kept in the broadphase of the sector in place of the terrain, and hits
+ * on them are reported as hits on the terrain.
+ */
+class csOpcodeCollisionTerrain : public scfVirtImplementationExt2<
+  csOpcodeCollisionTerrain, csOpcodeCollisionObject,
+  CS::Collisions::iCollisionTerrain, iTerrainCellLoadCallback>
+{
+  csRef<iTerrainSystem> terrainSystem;
+  csRefArray<csOpcodeCollisionObject> cellObjects;
+
+  void CreateCellObject (iTerrainCell* cell);
+
+protected:
+  virtual void AddOpcodeObject ();
+  virtual void RemoveOpcodeObject ();
+
+public:
+  csOpcodeCollisionTerrain (csOpcodeCollisionSystem* system,
+    iTerrainSystem* terrain, CollisionGroup* group);
+  virtual ~csOpcodeCollisionTerrain ();
+
+  //-- CS::Collisions::iCollisionObject
+  virtual iObject* QueryObject () { return this; }
+  virtual CS::Collisions::CollisionObjectType GetObjectType () const
+  { return CS::Collisions::COLLISION_OBJECT_TERRAIN; }
+
+  virtual void SetAttachedSceneNode (iSceneNode* newSceneNode)
+  { sceneNode = newSceneNode; }
+  virtual void SetCollider (CS::Collisions::iCollider* collider,
+    const csOrthoTransform& transform = csOrthoTransform ()) {}
+  virtual void SetColliderTransform (const csOrthoTransform& transform) {}
+  virtual void SetTransform (const csOrthoTransform& trans) {}
+  virtual void SetCollisionGroup (CS::Collisions::iCollisionGroup* group);
+
+  virtual csPtr<CS::Collisions::iCollisionData> Collide (
+    CS::Collisions::iCollisionObject* otherObject) const;
+  virtual CS::Collisions::HitBeamResult HitBeam (const csVector3& start,
+    const csVector3& end) const;
+
+  //-- CS::Collisions::iCollisionTerrain
+  virtual iTerrainSystem* GetTerrain () const { return terrainSystem; }
+  virtual CS::Collisions::iColliderTerrainCell* GetCell (size_t index) const;
+  virtual CS::Collisions::iColliderTerrainCell* GetCell (
+    iTerrainCell* cell) const;
+  virtual size_t GetCellCount () const { return cellObjects.GetSize (); }
+
+  //-- iTerrainCellLoadCallback
+  virtual void OnCellLoad (iTerrainCell *cell);
+  virtual void OnCellPreLoad (iTerrainCell *cell) {}
+  virtual void OnCellUnload (iTerrainCell *cell);
+};
+}
+CS_PLUGIN_NAMESPACE_END (Opcode2)
+#endif // __CS_OPCODE_COLLISIONTERRAIN_H__
@@ -23,6 +23,8 @@
 #include "iengine/scenenode.h"
 #include "iengine/mesh.h"
 #include "iengine/light.h"
+#include "csgeom/math3d.h"
+#include "csgeom/segment.h"
 #include "csgeom/transfrm.h"
 #include "csutil/scfstr.h"
 #include "iutil/string.h"
@@ -35,62 +37,241 @@ CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
 using namespace Opcode;
 
+namespace
+{
+  /* Enlargement of the bounds of objects in the broadphase tree, relative to
+     the largest extent of the object. */
+  static const float boundsMarginFactor = 0.1f;
+  static const float boundsMinMargin = 0.01f;
+
+  typedef csOpcodeCollisionSector::ObjectTree ObjectTree;
+
+  struct CollectBoxInner
+  {
+    const csBox3& box;
+
+    CollectBoxInner (const csBox3& box) : box (box) {}
+
+    bool operator() (const ObjectTree::Node* node)
+    {
+      return node->GetBBox ().Overlap (box);
+    }
+  };
+
+  struct CollectBoxLeaf
+  {
+    const csBox3& box;
+    csArray<csOpcodeCollisionObject*>& candidates;
+
+    CollectBoxLeaf (const csBox3& box,
+                    csArray<csOpcodeCollisionObject*>& candidates)
+      : box (box), candidates (candidates) {}
+
+    bool operator() (const ObjectTree::Node* node)
+    {
+      for (size_t i = 0; i < node->GetObjectCount (); i++)
+      {
+        csOpcodeCollisionObject* obj = node->GetLeafData (i);
+        if (obj->GetBBox ().Overlap (box))
+          candidates.Push (obj);
+      }
+      return true;
+    }
+  };
+
+  static bool SegmentHitsBox (const csSegment3& seg, const csBox3& segBox,
+                              const csBox3& box)
+  {
+    if (!segBox.Overlap (box)) return false;
+    csVector3 isect;
+    return csIntersect3::BoxSegment (box, seg, isect) >= 0;
+  }
+
+  struct CollectSegmentInner
+  {
+    const csSegment3& seg;
+    const csBox3& segBox;
+
+    CollectSegmentInner (const csSegment3& seg, const csBox3& segBox)
+      : seg (seg), segBox (segBox) {}
+
+    bool operator() (const ObjectTree::Node* node)
+    {
+      return SegmentHitsBox (seg, segBox, node->GetBBox ());
+    }
+  };
+
+  struct CollectSegmentLeaf
+  {
+    const csSegment3& seg;
+    const csBox3& segBox;
+    csArray<csOpcodeCollisionObject*>& candidates;
+
+    CollectSegmentLeaf (const csSegment3& seg, const csBox3& segBox,
+                        csArray<csOpcodeCollisionObject*>& candidates)
+      : seg (seg), segBox (segBox), candidates (candidates) {}
+
+    bool operator() (const ObjectTree::Node* node)
+    {
+      for (size_t i = 0; i < node->GetObjectCount (); i++)
+      {
+        csOpcodeCollisionObject* obj = node->GetLeafData (i);
+        if (SegmentHitsBox (seg, segBox, obj->GetBBox ()))
+          candidates.Push (obj);
+      }
+      return true;
+    }
+  };
+}
+
 csOpcodeCollisionSector::csOpcodeCollisionSector (csOpcodeCollisionSystem* sys)
-: scfImplementationType (this), sys (sys)
+: scfImplementationType (this), sys (sys), gravity (0.0f, -9.81f, 0.0f)
 {
 }
 
 csOpcodeCollisionSector::~csOpcodeCollisionSector ()
 {
-
+  DeleteAll ();
 }
 
-CS::Collisions::iCollisionSystem* csOpcodeCollisionSector::GetSystem()
+CS::Collisions::iCollisionSystem* csOpcodeCollisionSector::GetSystem () const
 {
   return sys;
 }
 
+void csOpcodeCollisionSector::SetSector (iSector* newSector)
+{
+  if (sector == newSector) return;
+  for (size_t i = 0; i < collisionObjects.GetSize (); i++)
+    UpdateEngineSector (collisionObjects[i], newSector);
+  sector = newSector;
+}
+
 void csOpcodeCollisionSector::SetGravity (const csVector3& v)
 {
-//Set gravity for what?
+  // Only kept for the users, nothing falls in a pure collision sector
+  gravity = v;
 }
 
 void csOpcodeCollisionSector::AddCollisionObject (CS::Collisions::iCollisionObject* object)
 {
   csRef<csOpcodeCollisionObject> obj (dynamic_cast<csOpcodeCollisionObject*>(object));
+  CS_ASSERT (obj);
+  if (obj->sector == this) return;
+  if (obj->sector) obj->sector->RemoveCollisionObject (obj);
+
   collisionObjects.Push (obj);
   obj->sector = this;
-
-  AddMovableToSector (object);
+  obj->AddOpcodeObject ();
+  UpdateEngineSector (obj, sector);
 }
 
 void csOpcodeCollisionSector::RemoveCollisionObject (CS::Collisions::iCollisionObject* object)
 {
   csOpcodeCollisionObject* collObject = dynamic_cast<csOpcodeCollisionObject*> (object);
   CS_ASSERT (collObject);
+  if (collObject->sector != this) return;
+  // Keep the object alive until it is fully removed
+  csRef<csOpcodeCollisionObject> objRef (collObject);
+  collObject->RemoveOpcodeObject ();
+  UpdateEngineSector (collObject, nullptr);
+  collObject->sector = nullptr;
   collisionObjects.Delete (collObject);
-  RemoveMovableFromSector (object);
 }
 
-CS::Collisions::iCollisionObject* csOpcodeCollisionSector::GetCollisionObject (size_t index)
+void csOpcodeCollisionSector::DeleteAll ()
+{
+  while (collisionObjects.GetSize ())
+    RemoveCollisionObject (collisionObjects[collisionObjects.GetSize () - 1]);
+}
+
+void csOpcodeCollisionSector::UpdateEngineSector (csOpcodeCollisionObject* obj,
+                                                  iSector* newSector)
 {
-  if (index >= 0 && index < collisionObjects.GetSize ())
-    return collisionObjects[index]->QueryCollisionObject ();
+  if (obj->sceneNode)
+  {
+    iMovable* movable = obj->sceneNode->GetMovable ();
+    if (newSector)
+      movable->SetSector (newSector);
+    else if (sector)
+      movable->GetSectors ()->Remove (sector);
+    movable->UpdateMove ();
+  }
+  if (obj->camera && newSector)
+    obj->camera->SetSector (newSector);
+}
+
+void csOpcodeCollisionSector::InsertObjectBounds (csOpcodeCollisionObject* obj)
+{
+  csBox3 box;
+  if (obj->GetWorldBBox (box))
+  {
+    const csVector3 size (box.GetSize ());
+    float margin = csMax (boundsMarginFactor
+      * csMax (size.x, csMax (size.y, size.z)), boundsMinMargin);
+    obj->bbox.Set (box.Min () - csVector3 (margin),
+      box.Max () + csVector3 (margin));
+    obj->inTree = true;
+    objectTree.AddObject (obj);
+  }
   else
-    return NULL;
+  {
+    obj->inTree = false;
+    unboundedObjects.Push (obj);
+  }
 }
 
-CS::Collisions::iCollisionObject* csOpcodeCollisionSector::FindCollisionObject (const char* name)
+void csOpcodeCollisionSector::RemoveObjectBounds (csOpcodeCollisionObject* obj)
 {
-  return collisionObjects.FindByName (name);
+  // Must be called before obj->bbox changes as the tree is searched with it
+  if (obj->inTree)
+    objectTree.RemoveObject (obj);
+  else
+    unboundedObjects.Delete (obj);
 }
 
-void csOpcodeCollisionSector::AddCollisionTerrain(CS::Collisions::iCollisionTerrain *terrain)
+void csOpcodeCollisionSector::UpdateObjectBounds (csOpcodeCollisionObject* obj)
 {
-  csOpcodeCollisionTerrain* csTerrain = dynamic_cast<csOpcodeCollisionTerrain*>(terrain);
-  csTerrain->sector = this;
+  csBox3 box;
+  bool bounded = obj->GetWorldBBox (box);
+  // Nothing to do as long as the object stays within its enlarged box
+  if ((bounded == obj->inTree) && (!bounded || obj->bbox.Contains (box)))
+    return;
+  RemoveObjectBounds (obj);
+  InsertObjectBounds (obj);
 }
 
+void csOpcodeCollisionSector::CollectCandidates (const csBox3& box) const
+{
+  candidates.SetSize (0);
+  CollectBoxInner inner (box);
+  CollectBoxLeaf leaf (box, candidates);
+  objectTree.Traverse (inner, leaf);
+  for (size_t i = 0; i < unboundedObjects.GetSize (); i++)
+    candidates.Push (unboundedObjects[i]);
+}
+
+void csOpcodeCollisionSector::CollectCandidates (const csVector3& start,
+                                                 const csVector3& end) const
+{
+  candidates.SetSize (0);
+  csSegment3 seg (start, end);
+  csBox3 segBox (start);
+  segBox.AddBoundingVertex (end);
+  CollectSegmentInner inner (seg, segBox);
+  CollectSegmentLeaf leaf (seg, segBox, candidates);
+  objectTree.Traverse (inner, leaf);
+  for (size_t i = 0; i < unboundedObjects.GetSize (); i++)
+    candidates.Push (unboundedObjects[i]);
+}
+
+CS::Collisions::iCollisionObject* csOpcodeCollisionSector::GetCollisionObject (size_t index)
+{
+  if (index < collisionObjects.GetSize ())
+    return collisionObjects[index];
+  else
+    return nullptr;
+}
 
 void csOpcodeCollisionSector::AddPortal (iPortal* portal, const csOrthoTransform& meshTrans)
 {
@@ -102,16 +283,16 @@ void csOpcodeCollisionSector::RemovePortal (iPortal* portal)
 //TODO
 }
 
-CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeam(const csVector3& start, 
-                                                                const csVector3& end)
+CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeam (const csVector3& start, 
+                                                                const csVector3& end) const
 {
   CS::Collisions::HitBeamResult result;
-  //Maybe at first do an AABB-ray collide. (Does Opcode support AABB-ray collide?)
   float depth = FLT_MAX;
-  for (size_t i = 0; i < collisionObjects.GetSize (); i++)
+  CollectCandidates (start, end);
+  for (size_t i = 0; i < candidates.GetSize (); i++)
   {
     float dep;
-    CS::Collisions::HitBeamResult res = HitBeamObject (collisionObjects[i], start, end, dep);
+    CS::Collisions::HitBeamResult res = HitBeamObject (candidates[i], start, end, dep);
     if (res.hasHit && dep < depth)
     {
       depth = dep;
@@ -121,8 +302,8 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeam(const csVector3&
   return result;
 }
 
-CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamPortal(const csVector3& start, 
-                                                                      const csVector3& end)
+CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamPortal (const csVector3& start, 
+                                                                      const csVector3& end) const
 {
   CS::Collisions::HitBeamResult result = HitBeam (start, end);
 
@@ -130,86 +311,53 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamPortal(const csVec
   return result;
 }
 
-bool csOpcodeCollisionSector::CollisionTest (CS::Collisions::iCollisionObject* object, csArray<CS::Collisions::CollisionData>& collisions)
+CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamPortals (const csVector3& start, 
+                                                                       const csVector3& end) const
 {
-  size_t length = collisions.GetSize ();
-  csOpcodeCollisionObject* obj = dynamic_cast<csOpcodeCollisionObject*> (object);
-  for (size_t i = 0; i < collisionObjects.GetSize (); i++)
-  {
-    if (collisionObjects[i]->QueryCollisionObject () != object)
-    {
-      bool collides = (obj->collGroup.value & collisionObjects[i]->collGroup.mask) != 0;
-      collides = collides && (collisionObjects[i]->collGroup.value & obj->collGroup.mask);
-
-      if(!collides)
-        continue;
-
-      CollideObject (obj, collisionObjects[i], collisions);
-    }
-  }
-  if (length != collisions.GetSize ())
-    return true;
-  else
-    return false;
-}
-
-void csOpcodeCollisionSector::AddCollisionActor (CS::Collisions::iCollisionActor* actor)
-{
-//TODO
-}
+  CS::Collisions::HitBeamResult result = HitBeam (start, end);
 
-void csOpcodeCollisionSector::RemoveCollisionActor ()
-{
-//TODO
+  //TODO
+  return result;
 }
 
-CS::Collisions::iCollisionActor* csOpcodeCollisionSector::GetCollisionActor ()
+csPtr<CS::Collisions::iCollisionDataList> csOpcodeCollisionSector::CollisionTest (
+  CS::Collisions::iCollisionObject* object)
 {
-  return NULL;
-}
+  csRef<CollisionDataList> dataList;
+  dataList.AttachNew (new CollisionDataList ());
 
-void csOpcodeCollisionSector::AddMovableToSector (CS::Collisions::iCollisionObject* obj)
-{
-  iMovable* movable = obj->GetAttachedMovable ();
-  if (movable && sector)
+  csOpcodeCollisionObject* obj = dynamic_cast<csOpcodeCollisionObject*> (object);
+  csBox3 box;
+  if (!obj->GetWorldBBox (box))
+    // Without bounds every object is a candidate
+    box.Set (csVector3 (-CS_BOUNDINGBOX_MAXVALUE),
+      csVector3 (CS_BOUNDINGBOX_MAXVALUE));
+  CollectCandidates (box);
+  for (size_t i = 0; i < candidates.GetSize (); i++)
   {
-    iMeshWrapper* mesh = movable->GetSceneNode ()->QueryMesh ();
-    iLight* light = movable->GetSceneNode ()->QueryLight ();
-    if (mesh)
-      sector->GetMeshes ()->Add (mesh);
-    else
-      sector->GetLights ()->Add (light);
-  }
-}
+    csOpcodeCollisionObject* other = candidates[i];
+    if (other->GetReportedObject () == obj || !obj->CollidesWith (other))
+      continue;
 
-void csOpcodeCollisionSector::RemoveMovableFromSector (CS::Collisions::iCollisionObject* obj)
-{
-  iMovable* movable = obj->GetAttachedMovable ();
-  if (movable && sector)
-  {
-    iMeshWrapper* mesh = movable->GetSceneNode ()->QueryMesh ();
-    iLight* light = movable->GetSceneNode ()->QueryLight ();
-    if (mesh)
-      sector->GetMeshes ()->Remove (mesh);
-    else
-      sector->GetLights ()->Remove (light);
+    csRef<CollisionData> data = CollideObject (obj, other);
+    if (data)
+      dataList->collisions.Push (data);
   }
+  return csPtr<CS::Collisions::iCollisionDataList> (dataList);
 }
 
 CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamObject (csOpcodeCollisionObject* object,
                                                                       const csVector3& start,
                                                                       const csVector3& end,
-                                                                      float& depth)
+                                                                      float& depth) const
 {
-  CS::Collisions::iCollider* col = object->collider;
-  csOpcodeCollider* collider = dynamic_cast<csOpcodeCollider*> (col);
-  CS::Collisions::HitBeamResult res = HitBeamCollider (collider->model, collider->vertholder, 
-    collider->indexholder, object->transform, start, end, depth);
+  csOpcodeCollider* collider = object->GetOpcodeCollider ();
+  if (!collider) return CS::Collisions::HitBeamResult ();
 
-  //HitBeamCollider (terrainColl->GetColliderModel (i), terrainColl->GetVertexHolder (i),
-  //    terrainColl->GetIndexHolder (i), terrainColl->GetColliderTransform (i), start, end, depth);
+  CS::Collisions::HitBeamResult res = HitBeamCollider (collider->model, collider->vertholder, 
+    collider->indexholder, object->GetColliderWorldTransform (), start, end, depth);
   if (res.hasHit)
-    res.object = object;
+    res.object = object->GetReportedObject ();
 
   return res;
 }
@@ -226,7 +374,7 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamCollider (Opcode::
                                                                         const csOrthoTransform& trans, 
                                                                         const csVector3& start, 
                                                                         const csVector3& end,
-                                                                        float& depth)
+                                                                        float& depth) const
 {
   ColCache.Model0 = model;
 
@@ -258,6 +406,7 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamCollider (Opcode::
   transform.m[3][2] = u.z;
 
   csVector3 len = end - start;
+  float segLength = len.Norm ();
   len.Normalize ();
 
   Ray ray (Point (start.x, start.y, start.z),
@@ -265,6 +414,7 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamCollider (Opcode::
 
   RayCol.SetHitCallback (ray_cb);
   RayCol.SetUserData ((void*)&collision_faces);
+  RayCol.SetMaxDist (segLength);
   collision_faces.SetSize (0);
 
   CS::Collisions::HitBeamResult result;
@@ -326,35 +476,37 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamCollider (Opcode::
 
 }
 
-bool csOpcodeCollisionSector::CollideObject (csOpcodeCollisionObject* objA,
-                                             csOpcodeCollisionObject* objB, 
-                                             csArray<CS::Collisions::CollisionData>& collisions)
+csPtr<CollisionData> csOpcodeCollisionSector::CollideObject (
+  csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB) const
 {
-  CS::Collisions::iCollider* col = objA->collider;
-  csOpcodeCollider* colliderA = dynamic_cast<csOpcodeCollider*> (col);
-  col = objB->collider;
-  csOpcodeCollider* colliderB = dynamic_cast<csOpcodeCollider*> (col);
-  if (CollideDetect (colliderA->model, colliderB->model, 
-    objA->transform, objB->transform))
-  {
-    
-    GetCollisionData (colliderA->model, colliderB->model, 
-      colliderA->vertholder, colliderB->vertholder,
-      colliderA->indexholder, colliderB->indexholder,
-      objA->transform, objB->transform);
-    curCollisionData.objectA = objA;
-    curCollisionData.objectB = objB;
-    collisions.Push (curCollisionData);
-    
-    return true;
-  }
-  return false;
+  csOpcodeCollider* colliderA = objA->GetOpcodeCollider ();
+  csOpcodeCollider* colliderB = objB->GetOpcodeCollider ();
+  if (!colliderA || !colliderB)
+    return csPtr<CollisionData> (nullptr);
+
+  csOrthoTransform transA (objA->GetColliderWorldTransform ());
+  csOrthoTransform transB (objB->GetColliderWorldTransform ());
+  if (!CollideDetect (colliderA->model, colliderB->model, transA, transB))
+    return csPtr<CollisionData> (nullptr);
+
+  csRef<CollisionData> data;
+  data.AttachNew (new CollisionData ());
+  data->objectA = objA->GetReportedObject ();
+  data->objectB = objB->GetReportedObject ();
+  csRef<CollisionContact> contact;
+  contact.AttachNew (new CollisionContact ());
+  GetCollisionData (colliderA->model, colliderB->model, 
+    colliderA->vertholder, colliderB->vertholder,
+    colliderA->indexholder, colliderB->indexholder,
+    transA, transB, contact);
+  data->contacts.Push (contact);
+  return csPtr<CollisionData> (data);
 }
 
 bool csOpcodeCollisionSector::CollideDetect (Opcode::Model* modelA,
                                              Opcode::Model* modelB, 
                                              const csOrthoTransform& transA, 
-                                             const csOrthoTransform& transB)
+                                             const csOrthoTransform& transB) const
 {
   ColCache.Model0 = modelA;
   ColCache.Model1 = modelB;
@@ -428,7 +580,8 @@ void csOpcodeCollisionSector::GetCollisionData (Opcode::Model* modelA,
                                                 udword* indexholderA, 
                                                 udword* indexholderB, 
                                                 const csOrthoTransform& transA,
-                                                const csOrthoTransform& transB)
+                                                const csOrthoTransform& transB,
+                                                CollisionContact* contact) const
 {
   int size = (int) (udword(TreeCollider.GetNbPairs ()));
   if (size == 0) return;
@@ -512,10 +665,10 @@ void csOpcodeCollisionSector::GetCollisionData (Opcode::Model* modelA,
 
   csVector3 disBetweenPoints = posi1 - posi2;
 
-  curCollisionData.normalWorldOnB = transB.This2Other (normal2);
-  curCollisionData.positionWorldOnA = transA.This2Other (posi1);
-  curCollisionData.positionWorldOnB = transB.This2Other (posi2);
-  curCollisionData.penetration = csVector3::Norm (posi1 - posi2);
+  contact->normalOnB = transB.This2OtherRelative (normal2);
+  contact->positionOnA = transA.This2Other (posi1);
+  contact->positionOnB = transB.This2Other (posi2);
+  contact->penetration = csVector3::Norm (posi1 - posi2);
 }
 }
 CS_PLUGIN_NAMESPACE_END (Opcode2)
@@ -27,98 +27,123 @@
 #include "iengine/sector.h"
 #include "iengine/movable.h"
 #include "csutil/csobject.h"
+#include "csgeom/aabbtree.h"
 #include "Opcode.h"
+#include "collisiondata.h"
 
 CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
 class csOpcodeCollisionSystem;
 class csOpcodeCollisionObject;
+class csOpcodeCollisionTerrain;
 
 class csOpcodeCollisionSector : public scfImplementationExt1<
   csOpcodeCollisionSector, csObject, CS::Collisions::iCollisionSector>
 {
 
   friend class csOpcodeCollisionObject;
-  Opcode::AABBTreeCollider TreeCollider;
-  Opcode::RayCollider RayCol;
-  Opcode::BVTCache ColCache;
+  friend class csOpcodeCollisionTerrain;
+public:
+  /// Broadphase tree of the collision objects
+  typedef CS::Geometry::AABBTree<csOpcodeCollisionObject, 2> ObjectTree;
 
-  struct csBulletCollisionPortal
-  {
-    iPortal* portal;
-    csOpcodeCollisionObject* ghostPortal1;
-  };
+private:
+  // Scratch state of the Opcode queries
+  mutable Opcode::AABBTreeCollider TreeCollider;
+  mutable Opcode::RayCollider RayCol;
+  mutable Opcode::BVTCache ColCache;
 
   csRef<iSector> sector;
   csOpcodeCollisionSystem* sys;
   csVector3 gravity;
   csRefArrayObject<csOpcodeCollisionObject> collisionObjects;
-  csArray<csBulletCollisionPortal> portals;
-  csArray<int> collision_faces;
-  CS::Collisions::CollisionData curCollisionData;
+  mutable csArray<int> collision_faces;
+
+  /**\name Broadphase
+   * Objects with known bounds are kept in a dynamic AABB tree, using
+   * slightly enlarged boxes so that small movements don't require a tree
+   * update. Objects without bounds are tested against every query.
+   * @{ */
+  ObjectTree objectTree;
+  csArray<csOpcodeCollisionObject*> unboundedObjects;
+  /// Objects found by the last broadphase query
+  mutable csArray<csOpcodeCollisionObject*> candidates;
+
+  void InsertObjectBounds (csOpcodeCollisionObject* obj);
+  void RemoveObjectBounds (csOpcodeCollisionObject* obj);
+  /// Collect the objects whose bounds overlap a box into \c candidates
+  void CollectCandidates (const csBox3& box) const;
+  /// Collect the objects whose bounds intersect a segment into \c candidates
+  void CollectCandidates (const csVector3& start, const csVector3& end) const;
+  /** @} */
+
+  /// Add or remove the attached scene node and camera to the engine sector
+  void UpdateEngineSector (csOpcodeCollisionObject* obj, iSector* sector);
 
 public:
   csOpcodeCollisionSector (csOpcodeCollisionSystem* sys);
   virtual ~csOpcodeCollisionSector ();
 
-  /// The system to which this sector belongs
-  virtual CS::Collisions::iCollisionSystem* GetSystem();
+  //-- CS::Collisions::iCollisionSector
+  virtual CS::Collisions::iCollisionSystem* GetSystem () const;
+  virtual iObject* QueryObject () const
+  { return (iObject*) this; }
+  virtual CS::Collisions::CollisionObjectType GetSectorType () const
+  { return CS::Collisions::COLLISION_OBJECT_SIMPLE; }
+  virtual CS::Physics::iPhysicalSector* QueryPhysicalSector () const
+  { return nullptr; }
+
+  virtual void SetSector (iSector* sector);
+  virtual iSector* GetSector () { return sector; }
 
-  virtual iObject* QueryObject () { return (iObject*) this; }
-  
-  //iCollisionSector
   virtual void SetGravity (const csVector3& v);
-  virtual csVector3 GetGravity () const {return gravity;}
+  virtual csVector3 GetGravity () const { return gravity; }
 
-  virtual void AddCollisionObject(CS::Collisions::iCollisionObject* object);
-  virtual void RemoveCollisionObject(CS::Collisions::iCollisionObject* object);
+  virtual void AddCollisionObject (CS::Collisions::iCollisionObject* object);
+  virtual void RemoveCollisionObject (CS::Collisions::iCollisionObject* object);
 
-  virtual size_t GetCollisionObjectCount () {return collisionObjects.GetSize ();}
+  virtual size_t GetCollisionObjectCount ()
+  { return collisionObjects.GetSize (); }
   virtual CS::Collisions::iCollisionObject* GetCollisionObject (size_t index);
-  virtual CS::Collisions::iCollisionObject* FindCollisionObject (const char* name);
-
-  virtual void AddCollisionTerrain(CS::Collisions::iCollisionTerrain *terrain);
-
-  virtual void AddPortal(iPortal* portal, const csOrthoTransform& meshTrans);
-  virtual void RemovePortal(iPortal* portal);
-
-  virtual void SetSector(iSector* sector) {this->sector = sector;}
-  virtual iSector* GetSector(){return sector;}
-
-  virtual CS::Collisions::HitBeamResult HitBeam(const csVector3& start, 
-    const csVector3& end);
 
-  virtual CS::Collisions::HitBeamResult HitBeamPortal(const csVector3& start, 
-    const csVector3& end);
+  virtual void AddPortal (iPortal* portal, const csOrthoTransform& meshTrans);
+  virtual void RemovePortal (iPortal* portal);
 
-  virtual bool CollisionTest(CS::Collisions::iCollisionObject* object, 
-    csArray<CS::Collisions::CollisionData>& collisions);
+  virtual void DeleteAll ();
 
-  virtual void AddCollisionActor (CS::Collisions::iCollisionActor* actor);
-  virtual void RemoveCollisionActor ();
-  virtual CS::Collisions::iCollisionActor* GetCollisionActor ();
+  virtual CS::Collisions::HitBeamResult HitBeam (const csVector3& start, 
+    const csVector3& end) const;
+  virtual CS::Collisions::HitBeamResult HitBeamPortal (const csVector3& start, 
+    const csVector3& end) const;
+  virtual CS::Collisions::HitBeamResult HitBeamPortals (const csVector3& start,
+    const csVector3& end) const;
 
-  void AddMovableToSector (CS::Collisions::iCollisionObject* obj);
+  virtual csPtr<CS::Collisions::iCollisionDataList> CollisionTest (
+    CS::Collisions::iCollisionObject* object);
 
-  void RemoveMovableFromSector (CS::Collisions::iCollisionObject* obj);
+  /// Update the broadphase after the transform or collider of \a obj changed
+  void UpdateObjectBounds (csOpcodeCollisionObject* obj);
 
-  CS::Collisions::HitBeamResult HitBeamCollider (Opcode::Model* model, Point* vertholder, udword* indexholder,
-    const csOrthoTransform& trans, const csVector3& start, const csVector3& end, float& depth);
+  CS::Collisions::HitBeamResult HitBeamCollider (Opcode::Model* model,
+    Point* vertholder, udword* indexholder, const csOrthoTransform& trans,
+    const csVector3& start, const csVector3& end, float& depth) const;
 
   CS::Collisions::HitBeamResult HitBeamObject (csOpcodeCollisionObject* object,
-    const csVector3& start, const csVector3& end, float& depth);
+    const csVector3& start, const csVector3& end, float& depth) const;
 
   bool CollideDetect (Opcode::Model* modelA, Opcode::Model* modelB,
-    const csOrthoTransform& transA, const csOrthoTransform& transB);
+    const csOrthoTransform& transA, const csOrthoTransform& transB) const;
 
   void GetCollisionData (Opcode::Model* modelA, Opcode::Model* modelB,
     Point* vertholderA, Point* vertholderB,
     udword* indexholderA, udword* indexholderB,
-    const csOrthoTransform& transA, const csOrthoTransform& transB);
+    const csOrthoTransform& transA, const csOrthoTransform& transB,
+    CollisionContact* contact) const;
 
-  bool CollideObject (csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB, 
-    csArray<CS::Collisions::CollisionData>& collisions);
+  /// Test two objects, returning the collision data or 0 if they don't collide
+  csPtr<CollisionData> CollideObject (csOpcodeCollisionObject* objA,
+    csOpcodeCollisionObject* objB) const;
 };
 }
 CS_PLUGIN_NAMESPACE_END (Opcode2)
-#endif
\ No newline at end of file
+#endif
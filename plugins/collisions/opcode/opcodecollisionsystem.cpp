@@ -30,13 +30,12 @@
 #include "csutil/scfarray.h"
 #include "opcodecollisionsystem.h"
 #include "collisionobject2.h"
+#include "collisionterrain.h"
 
 CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
 using namespace Opcode;
 
-static const CS::Collisions::CollisionGroupMask CollisionsAllFilter = -1;
-
 void Opcode_Log (const char* msg, ...)
 {
   va_list args;
@@ -62,138 +61,164 @@ SCF_IMPLEMENT_FACTORY (csOpcodeCollisionSystem)
 
 iObjectRegistry* csOpcodeCollisionSystem::rep_object_reg = NULL;
 
-csOpcodeCollisionSystem::csOpcodeCollisionSystem (iBase* iParent)
-: scfImplementationType (this, iParent)
+//--------------------------------- CollisionGroup ---------------------------------
+
+CollisionGroup::CollisionGroup (const char* name, char index)
+  : scfImplementationType (this), name (name), index (index)
+{
+  value = 1 << index;
+  mask = -1;
+}
+
+void CollisionGroup::SetCollisionEnabled (iCollisionGroup* other, bool enabled)
+{
+  CollisionGroup* group = dynamic_cast<CollisionGroup*> (other);
+  if (enabled)
+  {
+    mask |= 1 << group->index;
+    group->mask |= 1 << index;
+  }
+  else
+  {
+    mask &= ~(1 << group->index);
+    group->mask &= ~(1 << index);
+  }
+}
+
+bool CollisionGroup::GetCollisionEnabled (iCollisionGroup* other)
 {
+  CollisionGroup* group = dynamic_cast<CollisionGroup*> (other);
+  return mask & (1 << group->index);
+}
 
-  CS::Collisions::CollisionGroup defaultGroup ("Default");
-  defaultGroup.value = 1;
-  defaultGroup.mask = CollisionsAllFilter;
-  collGroups.Push (defaultGroup);
+//--------------------------------- csOpcodeCollisionSystem ---------------------------------
 
-  CS::Collisions::CollisionGroup staticGroup ("Static");
-  staticGroup.value = 2;
-  staticGroup.mask = CollisionsAllFilter ^ 2;
-  collGroups.Push (staticGroup);
-  systemFilterCount = 2;
+csOpcodeCollisionSystem::csOpcodeCollisionSystem (iBase* iParent)
+: scfImplementationType (this, iParent), object_reg (nullptr),
+  simulationSpeed (1.0f)
+{
+  // Create the default collision group
+  csRef<CollisionGroup> group;
+  group.AttachNew (new CollisionGroup ("Default", 0));
+  defaultGroup = collisionGroups.Put ("Default", group);
 }
 
 csOpcodeCollisionSystem::~csOpcodeCollisionSystem ()
 {
   rep_object_reg = 0;
   collSectors.DeleteAll ();
+  collisionGroups.DeleteAll ();
 }
 
 bool csOpcodeCollisionSystem::Initialize (iObjectRegistry* object_reg)
 {
   this->object_reg = object_reg;
   rep_object_reg = object_reg;
-  csRef<iStringSet> strings = csQueryRegistryTagInterface<iStringSet> (
-    object_reg, "crystalspace.shared.stringset");
-  baseID = strings->Request ("base");
-  colldetID = strings->Request ("colldet");
   return true;
 }
 
-void csOpcodeCollisionSystem::SetInternalScale (float scale)
+void csOpcodeCollisionSystem::DeleteAll ()
+{
+  collSectors.DeleteAll ();
+  collisionGroups.DeleteAll ();
+
+  // Create the default collision group
+  csRef<CollisionGroup> group;
+  group.AttachNew (new CollisionGroup ("Default", 0));
+  defaultGroup = collisionGroups.Put ("Default", group);
+}
+
+csPtr<CS::Collisions::iCollider> csOpcodeCollisionSystem::CreateCollider ()
 {
-  //use internal scale?
+  return csPtr<CS::Collisions::iCollider> (nullptr);
 }
 
-csPtr<CS::Collisions::iColliderConvexMesh> csOpcodeCollisionSystem::CreateColliderConvexMesh (iMeshWrapper* mesh, bool simplify /* = false */)
+csPtr<CS::Collisions::iColliderConvexMesh> csOpcodeCollisionSystem::CreateColliderConvexMesh (iTriangleMesh* mesh)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderConvexMesh> (nullptr);
 }
 
-csPtr<CS::Collisions::iColliderConcaveMesh> csOpcodeCollisionSystem::CreateColliderConcaveMesh (iMeshWrapper* mesh)
+csPtr<CS::Collisions::iColliderConcaveMesh> csOpcodeCollisionSystem::CreateColliderConcaveMesh (iTriangleMesh* mesh,
+                                                                                              bool dynamicEnabled)
 {
-  return csPtr<CS::Collisions::iColliderConcaveMesh>(new csOpcodeCollider (mesh,this));
+  return csPtr<CS::Collisions::iColliderConcaveMesh> (new csOpcodeCollider (mesh));
 }
 
 csPtr<CS::Collisions::iColliderConcaveMeshScaled> csOpcodeCollisionSystem::CreateColliderConcaveMeshScaled
-(CS::Collisions::iColliderConcaveMesh* collider, csVector3 scale)
+(CS::Collisions::iColliderConcaveMesh* collider, const csVector3& scale)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderConcaveMeshScaled> (nullptr);
 }
 
 csPtr<CS::Collisions::iColliderCylinder> csOpcodeCollisionSystem::CreateColliderCylinder (float length, float radius)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderCylinder> (nullptr);
 }
 
 csPtr<CS::Collisions::iColliderBox> csOpcodeCollisionSystem::CreateColliderBox (const csVector3& size)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderBox> (nullptr);
 }
 
 csPtr<CS::Collisions::iColliderSphere> csOpcodeCollisionSystem::CreateColliderSphere (float radius)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderSphere> (nullptr);
 }
 
 csPtr<CS::Collisions::iColliderCapsule> csOpcodeCollisionSystem::CreateColliderCapsule (float length, float radius)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderCapsule> (nullptr);
 }
 
 csPtr<CS::Collisions::iColliderCone> csOpcodeCollisionSystem::CreateColliderCone (float length, float radius)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderCone> (nullptr);
 }
 
 csPtr<CS::Collisions::iColliderPlane> csOpcodeCollisionSystem::CreateColliderPlane (const csPlane3& plane)
 {
-  return NULL;
+  return csPtr<CS::Collisions::iColliderPlane> (nullptr);
 }
 
-csPtr<CS::Collisions::iCollisionTerrain> csOpcodeCollisionSystem::CreateCollisionTerrain (iTerrainSystem* terrain,
-                                                               float minHeight, float maxHeight)
+CS::Collisions::iCollisionSector* csOpcodeCollisionSystem::CreateCollisionSector (iSector* sector)
 {
-  csRef<CS::Collisions::iCollisionTerrain> collider;
-  collider.AttachNew (new csOpcodeCollisionTerrain (terrain, this));
+  // Look first if there is already a collision sector associated to the given engine sector
+  if (sector)
+  {
+    CS::Collisions::iCollisionSector* collisionSector = FindCollisionSector (sector);
+    if (collisionSector) return collisionSector;
+  }
 
-  return csPtr<CS::Collisions::iCollisionTerrain>(collider);
+  csRef<csOpcodeCollisionSector> collSector;
+  collSector.AttachNew (new csOpcodeCollisionSector (this));
+  if (sector) collSector->SetSector (sector);
+  collSectors.Push (collSector);
+  return collSector;
 }
 
-csPtr<CS::Collisions::iCollisionObject> csOpcodeCollisionSystem::CreateCollisionObject (CS::Collisions::CollisionObjectProperties* props)
+void csOpcodeCollisionSystem::DeleteCollisionSector (CS::Collisions::iCollisionSector* sector)
 {
-  csRef<csOpcodeCollisionObject> collObject;
-  collObject.AttachNew (new csOpcodeCollisionObject (this));
-
-  collObject->CreateCollisionObject(props);
-
-  return csPtr<CS::Collisions::iCollisionObject>(collObject);
+  csOpcodeCollisionSector* collSector = dynamic_cast<csOpcodeCollisionSector*> (sector);
+  collSectors.Delete (collSector);
 }
 
-csPtr<CS::Collisions::iGhostCollisionObject> csOpcodeCollisionSystem::CreateGhostCollisionObject(CS::Collisions::GhostCollisionObjectProperties* props)
+void csOpcodeCollisionSystem::DeleteCollisionSectors ()
 {
-  csRef<csOpcodeCollisionObject> collObject;
-  collObject.AttachNew (new csOpcodeCollisionObject (this));
-
-  return csPtr<CS::Collisions::iGhostCollisionObject>(collObject);
+  collSectors.DeleteAll ();
 }
 
-csPtr<CS::Collisions::iCollisionActor> csOpcodeCollisionSystem::CreateCollisionActor (CS::Collisions::CollisionActorProperties* props)
+CS::Collisions::iCollisionSector* csOpcodeCollisionSystem::GetCollisionSector (size_t index)
 {
-  //TODO
-  return NULL;
-}
-
-csPtr<CS::Collisions::iCollisionSector> csOpcodeCollisionSystem::CreateCollisionSector ()
-{
-  csRef<csOpcodeCollisionSector> collSector;
-  collSector.AttachNew (new csOpcodeCollisionSector (this));
-
-  collSectors.Push (collSector);
-  return csPtr<CS::Collisions::iCollisionSector>(collSector);
+  CS_ASSERT (index < collSectors.GetSize ());
+  return collSectors[index];
 }
 
 CS::Collisions::iCollisionSector* csOpcodeCollisionSystem::FindCollisionSector (const char* name)
 {
-  return this->collSectors.FindByName (name);
+  return collSectors.FindByName (name);
 }
 
-CS::Collisions::iCollisionSector* csOpcodeCollisionSystem::GetCollisionSector (const iSector* sceneSector)
+CS::Collisions::iCollisionSector* csOpcodeCollisionSystem::FindCollisionSector (const iSector* sceneSector)
 {
   for (size_t i = 0; i < collSectors.GetSize (); i++)
   {
@@ -205,73 +230,84 @@ CS::Collisions::iCollisionSector* csOpcodeCollisionSystem::GetCollisionSector (c
   return nullptr;
 }
 
-void csOpcodeCollisionSystem::DecomposeConcaveMesh (CS::Collisions::iCollider* object,
-                                   iMeshWrapper* mesh, bool simplify)
+CS::Collisions::iCollisionGroup* csOpcodeCollisionSystem::CreateCollisionGroup (const char* name)
 {
+  csRef<CollisionGroup>* group = collisionGroups.GetElementPointer (name);
+  if (group) return *group;
+
+  size_t groupCount = collisionGroups.GetSize ();
+  if (groupCount >= 16)
+    return nullptr;
+
+  csRef<CollisionGroup> newGroup;
+  newGroup.AttachNew (new CollisionGroup (name, (char) groupCount));
+  collisionGroups.Put (name, newGroup);
+  return newGroup;
 }
 
-void csOpcodeCollisionSystem::OpcodeReportV (int severity, const char* message, 
-                           va_list args)
+CS::Collisions::iCollisionGroup* csOpcodeCollisionSystem::FindCollisionGroup (const char* name) const
 {
-  csReportV (rep_object_reg,
-    severity, "crystalspace.collisiondetection.opcode", message, args);
+  const csRef<CollisionGroup>* group = collisionGroups.GetElementPointer (name);
+  if (group) return *group;
+  else return nullptr;
 }
 
-CS::Collisions::CollisionGroup& csOpcodeCollisionSystem::CreateCollisionGroup (const char* name)
+size_t csOpcodeCollisionSystem::GetCollisionGroupCount () const
 {
-  size_t groupCount = collGroups.GetSize ();
-  if (groupCount >= sizeof (CS::Collisions::CollisionGroupMask) * 8)
-    return collGroups[0];
+  return collisionGroups.GetSize ();
+}
 
-  CS::Collisions::CollisionGroup newGroup(name);
-  newGroup.value = 1 << groupCount;
-  newGroup.mask = CollisionsAllFilter ^ newGroup.value;
-  collGroups.Push (newGroup);
-  return collGroups[groupCount];
+CS::Collisions::iCollisionGroup* csOpcodeCollisionSystem::GetCollisionGroup (size_t index) const
+{
+  CS_ASSERT (index < collisionGroups.GetSize ());
+  csHash< csRef<CollisionGroup>, const char*>::ConstGlobalIterator it =
+    collisionGroups.GetIterator ();
+  for (size_t i = 0; i < index; i++) it.Next ();
+  return it.Next ();
 }
 
-CS::Collisions::CollisionGroup& csOpcodeCollisionSystem::FindCollisionGroup (const char* name)
+csPtr<CS::Collisions::iCollisionObjectFactory> csOpcodeCollisionSystem::CreateCollisionObjectFactory
+  (CS::Collisions::iCollider* collider)
 {
-  size_t index = collGroups.FindKey (CollisionGroupVector::KeyCmp (name));
-  if (index == csArrayItemNotFound)
-    return collGroups[0];
-  else
-    return collGroups[index];
+  return csPtr<CS::Collisions::iCollisionObjectFactory> (
+    new csOpcodeCollisionObjectFactory (this, collider));
 }
 
-void csOpcodeCollisionSystem::SetGroupCollision (const char* name1, const char* name2, bool collide)
+csPtr<CS::Collisions::iCollisionObjectFactory> csOpcodeCollisionSystem::CreateGhostCollisionObjectFactory
+  (CS::Collisions::iCollider* collider)
 {
-  size_t index1 = collGroups.FindKey (CollisionGroupVector::KeyCmp (name1));
-  size_t index2 = collGroups.FindKey (CollisionGroupVector::KeyCmp (name2));
-  if (index1 == csArrayItemNotFound || index2 == csArrayItemNotFound)
-    return;
-  if (!collide)
-  {
-    if (index1 >= systemFilterCount)
-      collGroups[index1].value &= ~(1 << index2);
-    if (index2 >= systemFilterCount)
-      collGroups[index2].value &= ~(1 << index1);
-  }
-  else
-  {
-    if (index1 >= systemFilterCount)
-      collGroups[index1].value |= 1 << index2;
-    if (index2 >= systemFilterCount)
-      collGroups[index2].value |= 1 << index1;
-  }
+  return csPtr<CS::Collisions::iCollisionObjectFactory> (
+    new csOpcodeCollisionObjectFactory (this, collider,
+      CS::Collisions::COLLISION_OBJECT_GHOST));
 }
 
-bool csOpcodeCollisionSystem::GetGroupCollision (const char* name1, const char* name2)
+csPtr<CS::Collisions::iCollisionActorFactory> csOpcodeCollisionSystem::CreateCollisionActorFactory
+  (CS::Collisions::iCollider* collider)
 {
-  size_t index1 = collGroups.FindKey (CollisionGroupVector::KeyCmp (name1));
-  size_t index2 = collGroups.FindKey (CollisionGroupVector::KeyCmp (name2));
-  if (index1 == csArrayItemNotFound || index2 == csArrayItemNotFound)
-    return false;
-  if ((collGroups[index1].value & (1 << index2)) != 0 
-    || (collGroups[index2].value & (1 << index1)) != 0)
-    return true;
-  else
-    return false;
+  //TODO
+  return csPtr<CS::Collisions::iCollisionActorFactory> (nullptr);
+}
+
+csPtr<CS::Collisions::iCollisionTerrainFactory> csOpcodeCollisionSystem::CreateCollisionTerrainFactory
+  (iTerrainFactory* terrain)
+{
+  return csPtr<CS::Collisions::iCollisionTerrainFactory> (
+    new csOpcodeCollisionTerrainFactory (this, terrain));
+}
+
+void csOpcodeCollisionSystem::OpcodeReportV (int severity, const char* message, 
+                           va_list args)
+{
+  csReportV (rep_object_reg,
+    severity, "crystalspace.collisiondetection.opcode", message, args);
+}
+
+void csOpcodeCollisionSystem::ReportWarning (const char* msg, ...)
+{
+  va_list args;
+  va_start (args, msg);
+  OpcodeReportV (CS_REPORTER_SEVERITY_WARNING, msg, args);
+  va_end (args);
 }
 }
 CS_PLUGIN_NAMESPACE_END (Opcode2)
@@ -26,6 +26,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "ivaria/collisions.h"
 #include "iengine/sector.h"
 #include "iengine/movable.h"
+#include "csutil/hash.h"
 #include "csutil/csobject.h"
 #include "Opcode.h"
 #include "opcodecollisionsector.h"
@@ -36,21 +37,27 @@ CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
   class csOpcodeCollisionSystem;
   class csOpcodeCollisionObject;
 
-
-  class CollisionGroupVector : public csArray<CS::Collisions::CollisionGroup>
+  class CollisionGroup : public scfImplementation1<CollisionGroup,
+    CS::Collisions::iCollisionGroup>
   {
+  private:
+    csString name;
+    char index;
+
   public:
-    CollisionGroupVector () : csArray<CS::Collisions::CollisionGroup> () {}
-    static int CompareKey (CS::Collisions::CollisionGroup const& item,
-      char const* const& key)
-    {
-      return strcmp (item.name.GetData (), key);
-    }
-    static csArrayCmp<CS::Collisions::CollisionGroup, char const*>
-      KeyCmp(char const* k)
-    {
-      return csArrayCmp<CS::Collisions::CollisionGroup, char const*> (k,CompareKey);
-    }
+    /// The value of the group.
+    int value;
+
+    /// The mask of the group.
+    int mask;
+
+    CollisionGroup (const char* name, char index);
+
+    virtual const char* GetName () const
+    { return name.GetData (); }
+
+    virtual void SetCollisionEnabled (iCollisionGroup* other, bool enabled);
+    virtual bool GetCollisionEnabled (iCollisionGroup* other);
   };
 
   class csOpcodeCollisionSystem : public scfImplementation2<
@@ -61,11 +68,10 @@ CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
   private:
     iObjectRegistry* object_reg;
     csRefArrayObject<csOpcodeCollisionSector> collSectors;
-    csStringID baseID;
-    csStringID colldetID;
+    csHash< csRef<CollisionGroup>, const char*> collisionGroups;
+    CollisionGroup* defaultGroup;
+    float simulationSpeed;
 
-    CollisionGroupVector collGroups;
-    size_t systemFilterCount;
   public:
     csOpcodeCollisionSystem (iBase* iParent);
     virtual ~csOpcodeCollisionSystem ();
@@ -74,41 +80,56 @@ CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
     virtual bool Initialize (iObjectRegistry* object_reg);
 
     // iCollisionSystem
-    virtual void SetInternalScale (float scale);
-    virtual csPtr<CS::Collisions::iColliderCompound> CreateColliderCompound()
-    { return csPtr<CS::Collisions::iColliderCompound> (nullptr); }
+    virtual CS::Physics::iPhysicalSystem* QueryPhysicalSystem ()
+    { return nullptr; }
+
+    virtual void SetSimulationSpeed (float speed) { simulationSpeed = speed; }
+    virtual float GetSimulationSpeed () const { return simulationSpeed; }
+
+    virtual void DeleteAll ();
+
+    virtual csPtr<CS::Collisions::iCollider> CreateCollider ();
     virtual csPtr<CS::Collisions::iColliderConvexMesh> CreateColliderConvexMesh (
-      iMeshWrapper* mesh, bool simplify = false);
-    virtual csPtr<CS::Collisions::iColliderConcaveMesh> CreateColliderConcaveMesh (iMeshWrapper* mesh);
+      iTriangleMesh* mesh);
+    virtual csPtr<CS::Collisions::iColliderConcaveMesh> CreateColliderConcaveMesh (
+      iTriangleMesh* mesh, bool dynamicEnabled = false);
     virtual csPtr<CS::Collisions::iColliderConcaveMeshScaled> CreateColliderConcaveMeshScaled
-      (CS::Collisions::iColliderConcaveMesh* collider, csVector3 scale);
+      (CS::Collisions::iColliderConcaveMesh* collider, const csVector3& scale);
     virtual csPtr<CS::Collisions::iColliderCylinder> CreateColliderCylinder (float length, float radius);
     virtual csPtr<CS::Collisions::iColliderBox> CreateColliderBox (const csVector3& size);
     virtual csPtr<CS::Collisions::iColliderSphere> CreateColliderSphere (float radius);
     virtual csPtr<CS::Collisions::iColliderCapsule> CreateColliderCapsule (float length, float radius);
     virtual csPtr<CS::Collisions::iColliderCone> CreateColliderCone (float length, float radius);
     virtual csPtr<CS::Collisions::iColliderPlane> CreateColliderPlane (const csPlane3& plane);
-    virtual csPtr<CS::Collisions::iCollisionTerrain> CreateCollisionTerrain (iTerrainSystem* terrain,
-      float minHeight = 0, float maxHeight = 0);
 
-    virtual csPtr<CS::Collisions::iCollisionObject> CreateCollisionObject (CS::Collisions::CollisionObjectProperties* props);
-    virtual csPtr<CS::Collisions::iGhostCollisionObject> CreateGhostCollisionObject (CS::Collisions::GhostCollisionObjectProperties* props);
-    virtual csPtr<CS::Collisions::iCollisionActor> CreateCollisionActor (CS::Collisions::CollisionActorProperties* props);
-    virtual csPtr<CS::Collisions::iCollisionSector> CreateCollisionSector ();
+    virtual CS::Collisions::iCollisionSector* CreateCollisionSector (iSector* sector = nullptr);
+    virtual void DeleteCollisionSector (CS::Collisions::iCollisionSector* sector);
+    virtual void DeleteCollisionSectors ();
+    virtual size_t GetCollisionSectorCount () const { return collSectors.GetSize (); }
+    virtual CS::Collisions::iCollisionSector* GetCollisionSector (size_t index);
+    virtual CS::Collisions::iCollisionSector* FindCollisionSector (const iSector* sceneSector);
     virtual CS::Collisions::iCollisionSector* FindCollisionSector (const char* name);
-    virtual CS::Collisions::iCollisionSector* GetCollisionSector (const iSector* sceneSector);
 
-    virtual void DecomposeConcaveMesh (CS::Collisions::iCollider* object,
-      iMeshWrapper* mesh, bool simplify = false); 
+    virtual CS::Collisions::iCollisionGroup* CreateCollisionGroup (const char* name);
+    virtual CS::Collisions::iCollisionGroup* FindCollisionGroup (const char* name) const;
+    virtual size_t GetCollisionGroupCount () const;
+    virtual CS::Collisions::iCollisionGroup* GetCollisionGroup (size_t index) const;
 
-    static void OpcodeReportV (int severity, const char* message, 
-      va_list args);
+    virtual csPtr<CS::Collisions::iCollisionObjectFactory> CreateCollisionObjectFactory
+      (CS::Collisions::iCollider* collider = nullptr);
+    virtual csPtr<CS::Collisions::iCollisionObjectFactory> CreateGhostCollisionObjectFactory
+      (CS::Collisions::iCollider* collider = nullptr);
+    virtual csPtr<CS::Collisions::iCollisionActorFactory> CreateCollisionActorFactory
+      (CS::Collisions::iCollider* collider = nullptr);
+    virtual csPtr<CS::Collisions::iCollisionTerrainFactory> CreateCollisionTerrainFactory
+      (iTerrainFactory* terrain);
 
-    virtual CS::Collisions::CollisionGroup& CreateCollisionGroup (const char* name);
-    virtual CS::Collisions::CollisionGroup& FindCollisionGroup (const char* name);
+    /// Group of the objects without a valid group
+    CollisionGroup* GetDefaultGroup () const { return defaultGroup; }
 
-    virtual void SetGroupCollision (const char* name1, const char* name2, bool collide);
-    virtual bool GetGroupCollision (const char* name1, const char* name2);
+    static void OpcodeReportV (int severity, const char* message, 
+      va_list args);
+    void ReportWarning (const char* msg, ...);
 
   public:
     static iObjectRegistry* rep_object_reg;
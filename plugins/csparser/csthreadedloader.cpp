@@ -21,18 +21,25 @@
 
 #include <ctype.h>
 #include "csqint.h"
+#include "csver.h"
 
 #include "cstool/saverref.h"
 #include "cstool/saverfile.h"
 #include "cstool/unusedresourcehelper.h"
 #include "cstool/vfsdirchange.h"
 
+#include "csutil/cfgacc.h"
+#include "csutil/csendian.h"
+#include "csutil/databuf.h"
 #include "csutil/documenthelper.h"
 #include "csutil/event.h"
 #include "csutil/eventnames.h"
+#include "csutil/memfile.h"
+#include "csutil/parasiticdatabuffer.h"
 #include "csutil/scfstr.h"
 #include "csutil/scfstringarray.h"
 #include "csutil/threadmanager.h"
+#include "csutil/vfshiercache.h"
 #include "csutil/xmltiny.h"
 
 #include "iengine/engine.h"
@@ -65,6 +72,7 @@
 #include "iutil/event.h"
 #include "iutil/eventq.h"
 #include "iutil/document.h"
+#include "iutil/hiercache.h"
 #include "iutil/object.h"
 #include "iutil/objreg.h"
 #include "iutil/plugin.h"
@@ -72,6 +80,7 @@
 #include "iutil/vfs.h"
 
 #include "ivaria/keyval.h"
+#include "ivaria/profile.h"
 
 #include "ivideo/material.h"
 
@@ -81,6 +90,12 @@
 
 CS_PLUGIN_NAMESPACE_BEGIN(csparser)
 {
+  CS_DECLARE_PROFILER
+  CS_DECLARE_PROFILER_ZONE(csThreadedLoader_LoadMapFile)
+  CS_DECLARE_PROFILER_ZONE(csThreadedLoader_LoadNode)
+  CS_DECLARE_PROFILER_ZONE(csThreadedLoader_LoadLibraryFromNode)
+  CS_DECLARE_PROFILER_ZONE(csThreadedLoader_LoadMeshObject)
+
   SCF_IMPLEMENT_FACTORY(csThreadedLoader)
 
   csThreadedLoader::csThreadedLoader(iBase *p)
@@ -158,6 +173,27 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     // TODO: Don't hardcode path
     shaderSets.ParseShaderSets ("/config/shadersets-default.xml");
 
+    csConfigAccess config (object_reg, "/config/loader.cfg");
+    if (config->GetBool ("Loader.SceneCache.Enable", false))
+    {
+      const char* cachePath = config->GetStr ("Loader.SceneCache.Path",
+        "/scenecache");
+      sceneCacheDocSys = csLoadPlugin<iDocumentSystem> (plugin_mgr,
+        "crystalspace.documentsystem.binary");
+      if (cachePath && *cachePath && sceneCacheDocSys.IsValid())
+      {
+        sceneCache.AttachNew (new CS::Utility::VfsHierarchicalCache (object_reg,
+          csString().Format ("%s/" CS_VERSION_MAJOR "." CS_VERSION_MINOR,
+          cachePath)));
+      }
+      else
+      {
+        ReportWarning ("crystalspace.maploader.scenecache",
+          "Scene cache disabled: no cache path or binary document system");
+        sceneCacheDocSys.Invalidate();
+      }
+    }
+
     // Optional
     eseqmgr = csQueryRegistryOrLoad<iEngineSequenceManager> (object_reg,
       "crystalspace.utilities.sequence.engine", false);
@@ -644,6 +680,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     bool clearEngine, csRef<iCollection> collection, csRef<iStreamSource> ssource,
     csRef<iMissingLoaderData> missingdata, uint keepFlags, bool do_verbose)
   {
+    CS_PROFILER_ZONE(csThreadedLoader_LoadMapFile)
     csVfsDirectoryChanger dirChange(vfs);
     dirChange.ChangeToFull(cwd);
 
@@ -864,6 +901,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
       csRef<iCollection> collection, csRef<iSector> sector, csRef<iStreamSource> ssource,
       csRef<iMissingLoaderData> missingdata, uint keepFlags, bool do_verbose)
   {
+    CS_PROFILER_ZONE(csThreadedLoader_LoadNode)
     csVfsDirectoryChanger dirChange(vfs);
     dirChange.ChangeToFull(cwd);
 
@@ -1789,6 +1827,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     csRefArray<iDocumentNode>* libs, csArray<csString>* libIDs,
     const char* cwd)
   {
+    CS_PROFILER_ZONE(csThreadedLoader_LoadLibraryFromNode)
     csVfsDirectoryChanger dirChange(vfs);
     dirChange.ChangeToFull(cwd);
 
@@ -2675,6 +2714,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     csRef<iMeshWrapper> mesh, csRef<iMeshWrapper> parent, csRef<iDocumentNode> node, 
     csRef<iStreamSource> ssource, csRef<iSector> sector, csString name, const char* cwd)
   {
+    CS_PROFILER_ZONE(csThreadedLoader_LoadMeshObject)
     csVfsDirectoryChanger dirChange(vfs);
     dirChange.ChangeToFull(cwd);
 
@@ -3511,6 +3551,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
   bool csThreadedLoader::LoadStructuredDoc (const char* file, iFile* buf,
     csRef<iDocument>& doc)
   {
+    if (sceneCache && file)
+    {
+      // Cached documents are looked up by the file contents
+      csRef<iDataBuffer> data = buf->GetAllData ();
+      return LoadStructuredDoc (file, data, doc);
+    }
+
     csRef<iDocumentSystem> docsys (
       csQueryRegistry<iDocumentSystem> (object_reg));
     if (!docsys) docsys = csPtr<iDocumentSystem> (new csTinyDocumentSystem ());
@@ -3531,6 +3578,17 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
   bool csThreadedLoader::LoadStructuredDoc (const char* file, iDataBuffer* buf,
     csRef<iDocument>& doc)
   {
+    bool useCache = sceneCache && file;
+    CS::Utility::Checksum::MD5::Digest sourceDigest;
+    if (useCache)
+    {
+      sourceDigest = CS::Utility::Checksum::MD5::Encode (buf->GetData (),
+        buf->GetSize ());
+      doc = ReadCachedDoc (file, sourceDigest);
+      if (doc.IsValid ())
+        return true;
+    }
+
     csRef<iDocumentSystem> docsys (
       csQueryRegistry<iDocumentSystem> (object_reg));
     if (!docsys) docsys = csPtr<iDocumentSystem> (new csTinyDocumentSystem ());
@@ -3547,9 +3605,98 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
       doc = 0;
       return false;
     }
+
+    if (useCache)
+      CacheDoc (file, sourceDigest, doc);
     return true;
   }
 
+  /* A scene cache item is a header followed by the document in the format of
+     the binary document system. */
+  struct SceneCacheHeader
+  {
+    uint32 magic;
+    uint32 version;
+    // MD5 digest of the file the document was parsed from
+    uint8 sourceDigest[16];
+  };
+
+  static const uint32 sceneCacheMagic = 0x43534c53; // 'SLSC'
+  static const uint32 sceneCacheVersion = 1;
+
+  csString csThreadedLoader::GetSceneCachePath (const char* file)
+  {
+    // Items are named after the full VFS path of the file
+    csRef<iDataBuffer> path = vfs->ExpandPath (file);
+    csString name (CS::Utility::Checksum::MD5::Encode (path->GetData (),
+      path->GetSize ()).HexString ());
+    return csString().Format ("/%s", name.GetData());
+  }
+
+  csPtr<iDocument> csThreadedLoader::ReadCachedDoc (const char* file,
+    const CS::Utility::Checksum::MD5::Digest& sourceDigest)
+  {
+    csString cachePath (GetSceneCachePath (file));
+    csRef<iDataBuffer> cacheData;
+    {
+      CS::Threading::MutexScopedLock lock (sceneCacheLock);
+      cacheData = sceneCache->ReadCache (cachePath);
+    }
+    if (!cacheData.IsValid ()
+      || (cacheData->GetSize () < sizeof (SceneCacheHeader)))
+      return 0;
+
+    // Ignore items from other versions or made from different file contents
+    const SceneCacheHeader* header = (const SceneCacheHeader*)cacheData->GetData ();
+    if ((csLittleEndian::UInt32 (header->magic) != sceneCacheMagic)
+      || (csLittleEndian::UInt32 (header->version) != sceneCacheVersion)
+      || (memcmp (header->sourceDigest, sourceDigest.data,
+        sizeof (header->sourceDigest)) != 0))
+      return 0;
+
+    // The binary document is used in place, no parsing needed
+    csRef<iDataBuffer> docData;
+    docData.AttachNew (new csParasiticDataBuffer (cacheData,
+      sizeof (SceneCacheHeader)));
+    csRef<iDocument> doc = sceneCacheDocSys->CreateDocument ();
+    if (doc->Parse (docData) != 0)
+      return 0;
+    return csPtr<iDocument> (doc);
+  }
+
+  void csThreadedLoader::CacheDoc (const char* file,
+    const CS::Utility::Checksum::MD5::Digest& sourceDigest, iDocument* doc)
+  {
+    if (!sceneCache->IsCacheWriteable ())
+      return;
+
+    // Convert the document to the binary format
+    csRef<iDocument> binDoc = sceneCacheDocSys->CreateDocument ();
+    csRef<iDocumentNode> binRoot = binDoc->CreateRoot ();
+    CS::DocSystem::CloneNode (doc->GetRoot (), binRoot);
+    csRef<csMemFile> binFile;
+    binFile.AttachNew (new csMemFile ());
+    if (binDoc->Write (binFile) != 0)
+      return;
+    csRef<iDataBuffer> binData = binFile->GetAllData ();
+
+    csRef<csDataBuffer> cacheData;
+    cacheData.AttachNew (new csDataBuffer (sizeof (SceneCacheHeader)
+      + binData->GetSize ()));
+    SceneCacheHeader* header = (SceneCacheHeader*)cacheData->GetData ();
+    header->magic = csLittleEndian::UInt32 (sceneCacheMagic);
+    header->version = csLittleEndian::UInt32 (sceneCacheVersion);
+    memcpy (header->sourceDigest, sourceDigest.data,
+      sizeof (header->sourceDigest));
+    memcpy (cacheData->GetData () + sizeof (SceneCacheHeader),
+      binData->GetData (), binData->GetSize ());
+
+    csString cachePath (GetSceneCachePath (file));
+    CS::Threading::MutexScopedLock lock (sceneCacheLock);
+    sceneCache->CacheData (cacheData->GetData (), cacheData->GetSize (),
+      cachePath);
+  }
+
   bool csThreadedLoader::LoadProxyTextures(csSafeCopyArray<ProxyTexture> &proxyTextures,
     csWeakRefArray<iMaterialWrapper> &materialArray)
   {
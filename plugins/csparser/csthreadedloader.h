@@ -21,6 +21,7 @@
 #define __CS_THREADED_LOADER_H__
 
 #include "csutil/cscolor.h"
+#include "csutil/md5.h"
 #include "csutil/threadmanager.h"
 #include "csutil/scf_implementation.h"
 #include "csutil/strhash.h"
@@ -49,7 +50,9 @@
 class csReversibleTransform;
 struct iCollection;
 struct iDocumentNode;
+struct iDocumentSystem;
 struct iEngine;
+struct iHierarchicalCache;
 struct iImageIO;
 struct iImposterFactory;
 struct iLODControl;
@@ -552,6 +555,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     // Weak event handler
     csRef<iEventHandler> eventHandler;
 
+    // Cache of parsed documents, 0 if disabled
+    csRef<iHierarchicalCache> sceneCache;
+    // Document system for the cached documents
+    csRef<iDocumentSystem> sceneCacheDocSys;
+    CS::Threading::Mutex sceneCacheLock;
+
     // For checking whether to schedule a engine list sync.
     CS::Threading::ReadWriteMutex listSyncLock;
     bool listSync;
@@ -791,6 +800,21 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
      */
     bool LoadStructuredDoc (const char* file, iDataBuffer* buf, csRef<iDocument>& doc);
 
+    /**
+     * Get the document for a file from the scene cache.
+     * \return 0 if the cache has no document for the file or if it was
+     *   made from different file contents.
+     */
+    csPtr<iDocument> ReadCachedDoc (const char* file,
+      const CS::Utility::Checksum::MD5::Digest& sourceDigest);
+
+    /// Store the document parsed from a file in the scene cache.
+    void CacheDoc (const char* file,
+      const CS::Utility::Checksum::MD5::Digest& sourceDigest, iDocument* doc);
+
+    /// Get the path of the scene cache item for a file.
+    csString GetSceneCachePath (const char* file);
+
     /**
      * Load sounds from a SOUNDS(...) argument.
      * This function is normally called automatically by the parser.
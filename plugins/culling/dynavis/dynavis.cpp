@@ -2056,6 +2056,125 @@ void csDynaVis::VisTest (csPlane3* planes, int num_planes,
   	(void*)&data, frustum_mask);
 }
 
+//======== VisTest views ===================================================
+
+struct VisTestViews_Data
+{
+  const csVisibilityCullerView* views;
+  size_t num_views;
+  uint32 cur_timestamp;
+
+  // The objects found in the views so far.
+  csArray<csVisibilityObjectWrapper*> objects;
+  /* For every object: the views it was tested against, the views it is
+     visible in and the clip masks for all views. */
+  csDirtyAccessArray<uint32> masks;
+};
+
+static void VisTestViews_Traverse (csKDTree* treenode,
+	VisTestViews_Data* data, uint32 view_mask, const uint32* frustum_masks)
+{
+  const size_t num_views = data->num_views;
+  const size_t stride = num_views + 2;
+
+  // Find the views the node is visible in.
+  const csBox3& node_bbox = treenode->GetNodeBBox ();
+  uint32 node_masks[32];
+  uint32 node_views = 0;
+  size_t v;
+  for (v = 0 ; v < num_views ; v++)
+  {
+    if (!(view_mask & (uint32 (1) << v))) continue;
+    if (csIntersect3::BoxFrustum (node_bbox, data->views[v].planes,
+	frustum_masks[v], node_masks[v]))
+      node_views |= uint32 (1) << v;
+  }
+  if (node_views == 0)
+    return;
+
+  treenode->Distribute ();
+
+  int num_objects = treenode->GetObjectCount ();
+  csKDTreeChild** objects = treenode->GetObjects ();
+  int i;
+  for (i = 0 ; i < num_objects ; i++)
+  {
+    csKDTreeChild* child = objects[i];
+    csVisibilityObjectWrapper* visobj_wrap = (csVisibilityObjectWrapper*)
+      child->GetObject ();
+    iMeshWrapper* mesh = visobj_wrap->mesh;
+    if (mesh && mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH))
+      continue;
+
+    if (child->timestamp != data->cur_timestamp)
+    {
+      child->timestamp = data->cur_timestamp;
+      visobj_wrap->view_result = data->objects.Push (visobj_wrap);
+      size_t n = data->masks.GetSize ();
+      data->masks.SetSize (n + stride, 0);
+    }
+    uint32* masks = data->masks.GetArray ()
+      + visobj_wrap->view_result * stride;
+
+    // An object in several nodes is only tested once for every view.
+    uint32 test_views = node_views & ~masks[0];
+    if (test_views == 0) continue;
+    masks[0] |= test_views;
+    const csBox3& obj_bbox = child->GetBBox ();
+    for (v = 0 ; v < num_views ; v++)
+    {
+      if (!(test_views & (uint32 (1) << v))) continue;
+      if (csIntersect3::BoxFrustum (obj_bbox, data->views[v].planes,
+	  node_masks[v], masks[2 + v]))
+	masks[1] |= uint32 (1) << v;
+    }
+  }
+
+  csKDTree* child1 = treenode->GetChild1 ();
+  if (child1)
+  {
+    VisTestViews_Traverse (child1, data, node_views, node_masks);
+    VisTestViews_Traverse (treenode->GetChild2 (), data, node_views,
+      node_masks);
+  }
+}
+
+void csDynaVis::VisTest (const csVisibilityCullerView* views,
+	size_t num_views, iVisibilityCullerMultiViewListener* viscallback)
+{
+  UpdateObjects ();
+  current_vistest_nr++;
+
+  CS_ASSERT (num_views <= 32);
+  if (num_views > 32) num_views = 32;
+  if (num_views == 0) return;
+
+  VisTestViews_Data data;
+  data.views = views;
+  data.num_views = num_views;
+  data.cur_timestamp = kdtree->NewTraversal ();
+
+  uint32 view_mask = 0;
+  uint32 frustum_masks[32];
+  size_t v;
+  for (v = 0 ; v < num_views ; v++)
+  {
+    view_mask |= uint32 (1) << v;
+    frustum_masks[v] = views[v].planes_mask;
+  }
+  VisTestViews_Traverse (kdtree, &data, view_mask, frustum_masks);
+
+  const size_t stride = num_views + 2;
+  for (size_t i = 0 ; i < data.objects.GetSize () ; i++)
+  {
+    const uint32* masks = data.masks.GetArray () + i * stride;
+    if (masks[1] == 0) continue;
+    csVisibilityObjectWrapper* visobj_wrap = data.objects[i];
+    viscallback->ObjectVisible (visobj_wrap->visobj, visobj_wrap->mesh,
+      masks[1], masks + 2);
+  }
+}
+
 //======== VisTest box =====================================================
 
 struct VisTestBox_Front2BackData
@@ -93,6 +93,8 @@ public:
   bool full_transform_identity;	// Cache for IsFullTransformIdentity().
 
   uint32 last_visible_vistestnr;
+  // Index of the object's results in a VisTest() of several views.
+  size_t view_result;
 
   csVisibilityObjectHistory* history;
   // Optional data for shadows. Both fields can be 0.
@@ -340,6 +342,8 @@ public:
   	int num_planes);
   virtual void VisTest (csPlane3* planes, int num_planes,
     iVisibilityCullerListener *viscallback);
+  virtual void VisTest (const csVisibilityCullerView* views,
+    size_t num_views, iVisibilityCullerMultiViewListener* viscallback);
   virtual csPtr<iVisibilityObjectIterator> IntersectSegmentSloppy (
     const csVector3& start, const csVector3& end);
   virtual csPtr<iVisibilityObjectIterator> IntersectSegment (
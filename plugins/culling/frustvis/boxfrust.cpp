@@ -0,0 +1,116 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csgeom/math3d.h"
+#include "csutil/processorspecdetection.h"
+#include "boxfrust.h"
+
+#if defined (CS_PROCESSOR_X86) && (defined (__SSE__) || defined (_M_X64) \
+  || (defined (_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define CS_BOXFRUST_SSE
+#include <xmmintrin.h>
+#endif
+
+bool csBoxFrustumTester::IsSIMDAvailable ()
+{
+#ifdef CS_BOXFRUST_SSE
+  static int available = -1;
+  if (available < 0)
+  {
+    CS::Platform::ProcessorSpecDetection procSpec;
+    available = procSpec.HasSSE () ? 1 : 0;
+  }
+  return available != 0;
+#else
+  return false;
+#endif
+}
+
+uint32 csBoxFrustumTester::TestBoxes (const csBox3* const* boxes, int num,
+  const csPlane3* frustum, uint32 inClipMask, uint32* outClipMasks,
+  bool useSIMD)
+{
+  CS_ASSERT (num <= MAX_BOXES);
+#ifdef CS_BOXFRUST_SSE
+  if (useSIMD && IsSIMDAvailable ())
+  {
+    /* Centers and half diagonals of the boxes, one box per lane. Unused
+       lanes repeat the first box. They are computed just like
+       csIntersect3::BoxFrustum() does so the results are the same. */
+    float mx[4], my[4], mz[4], dx[4], dy[4], dz[4];
+    for (int i = 0; i < 4; i++)
+    {
+      const csBox3& box = *boxes[(i < num) ? i : 0];
+      csVector3 m = box.GetCenter ();
+      csVector3 d = box.Max () - m;
+      mx[i] = m.x; my[i] = m.y; mz[i] = m.z;
+      dx[i] = d.x; dy[i] = d.y; dz[i] = d.z;
+    }
+    const __m128 vmx = _mm_loadu_ps (mx);
+    const __m128 vmy = _mm_loadu_ps (my);
+    const __m128 vmz = _mm_loadu_ps (mz);
+    const __m128 vdx = _mm_loadu_ps (dx);
+    const __m128 vdy = _mm_loadu_ps (dy);
+    const __m128 vdz = _mm_loadu_ps (dz);
+    const __m128 zero = _mm_setzero_ps ();
+
+    // Clip masks are collected as bit patterns in float lanes.
+    union { uint32 u[4]; float f[4]; } lanes;
+    __m128 outside = zero;
+    __m128 partial = zero;
+    const int allLanes = (1 << num) - 1;
+    const csPlane3* f = frustum;
+    for (uint32 mk = 1; mk <= inClipMask; mk += mk, f++)
+    {
+      if (!(inClipMask & mk)) continue;
+
+      __m128 NP = _mm_add_ps (_mm_add_ps (
+	  _mm_mul_ps (vdx, _mm_set1_ps (fabsf (f->A ()))),
+	  _mm_mul_ps (vdy, _mm_set1_ps (fabsf (f->B ())))),
+	_mm_mul_ps (vdz, _mm_set1_ps (fabsf (f->C ()))));
+      __m128 MP = _mm_add_ps (_mm_add_ps (_mm_add_ps (
+	  _mm_mul_ps (vmx, _mm_set1_ps (f->A ())),
+	  _mm_mul_ps (vmy, _mm_set1_ps (f->B ()))),
+	  _mm_mul_ps (vmz, _mm_set1_ps (f->C ()))),
+	_mm_set1_ps (f->D ()));
+
+      // Behind the plane: the box is invisible.
+      outside = _mm_or_ps (outside, _mm_cmplt_ps (_mm_add_ps (MP, NP), zero));
+      if ((_mm_movemask_ps (outside) & allLanes) == allLanes) return 0;
+      // Intersecting the plane: it has to be tested further down.
+      lanes.u[0] = mk;
+      partial = _mm_or_ps (partial, _mm_and_ps (
+	_mm_cmplt_ps (_mm_sub_ps (MP, NP), zero), _mm_set1_ps (lanes.f[0])));
+    }
+    _mm_storeu_ps (lanes.f, partial);
+    for (int i = 0; i < num; i++)
+      outClipMasks[i] = lanes.u[i];
+    return uint32 (~_mm_movemask_ps (outside) & allLanes);
+  }
+#endif
+
+  uint32 visible = 0;
+  for (int i = 0; i < num; i++)
+  {
+    if (csIntersect3::BoxFrustum (*boxes[i], frustum, inClipMask,
+	outClipMasks[i]))
+      visible |= 1 << i;
+  }
+  return visible;
+}
@@ -0,0 +1,51 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_BOXFRUST_H__
+#define __CS_BOXFRUST_H__
+
+#include "csgeom/box.h"
+#include "csgeom/plane3.h"
+
+/**
+ * Tests several boxes against the clip planes of a frustum at once. With
+ * SSE four boxes are tested in parallel, one per vector lane; otherwise
+ * the boxes are tested one after the other with csIntersect3::BoxFrustum().
+ */
+class csBoxFrustumTester
+{
+public:
+  /// Maximum number of boxes tested by one call of TestBoxes().
+  enum { MAX_BOXES = 4 };
+
+  /// Whether the processor supports the SSE box test.
+  static bool IsSIMDAvailable ();
+
+  /**
+   * Test \a num boxes (at most MAX_BOXES) against the planes of \a frustum
+   * selected by \a inClipMask. Returns a bit mask of the boxes that are at
+   * least partially inside. For those, \a outClipMasks receives the planes
+   * the box intersects, as csIntersect3::BoxFrustum() would return.
+   * \a useSIMD is ignored if SSE is not available.
+   */
+  static uint32 TestBoxes (const csBox3* const* boxes, int num,
+    const csPlane3* frustum, uint32 inClipMask, uint32* outClipMasks,
+    bool useSIMD);
+};
+
+#endif // __CS_BOXFRUST_H__
@@ -35,7 +35,10 @@
 #include "csgeom/sphere.h"
 #include "csgeom/kdtree.h"
 #include "imesh/objmodel.h"
+#include "csutil/cfgacc.h"
+#include "csutil/dirtyaccessarray.h"
 #include "csutil/flags.h"
+#include "csutil/parallelfor.h"
 #include "iutil/objreg.h"
 #include "ivideo/graph2d.h"
 #include "ivideo/graph3d.h"
@@ -48,9 +51,15 @@
 #include "imesh/object.h"
 #include "iutil/object.h"
 #include "ivaria/reporter.h"
+#include "boxfrust.h"
 #include "frustvis.h"
 
-
+/* If at least this many objects and at least half of all objects moved
+   since the last VisTest(), the kdtree is rebuilt instead of updated. */
+#define FRUSTVIS_REBUILD_MIN 256
+/* The tree is split into about this many tasks per thread in VisTest(), so
+   threads finishing early can pick up more work. */
+#define FRUSTVIS_TASKS_PER_THREAD 4
 
 SCF_IMPLEMENT_FACTORY (csFrustumVis)
 
@@ -155,6 +164,12 @@ csFrustumVis::csFrustumVis (iBase *iParent) :
   current_vistest_nr = 1;
   vistest_objects_inuse = false;
   updating = false;
+  distribute_needed = false;
+  numThreads = 0;
+  numWorkers = 0;
+  useSIMD = csBoxFrustumTester::IsSIMDAvailable ();
+  parallelMinObjects = 1024;
+  num_vistest_tasks = 0;
 }
 
 csFrustumVis::~csFrustumVis ()
@@ -212,11 +227,17 @@ bool csFrustumVis::Initialize (iObjectRegistry *object_reg)
     scr_height = 480;
   }
 
-  kdtree = new csKDTree ();
-  kdtree->SetMinimumSplitAmount (50);
-  csRef<csFrustVisObjectDescriptor> desc;
-  desc.AttachNew (new csFrustVisObjectDescriptor ());
-  kdtree->SetObjectDescriptor (desc);
+  kdtree = CreateTree ();
+
+  csConfigAccess cfg (object_reg, "/config/frustvis.cfg");
+  useSIMD = cfg->GetBool ("Culling.Frustvis.SIMD", true)
+    && csBoxFrustumTester::IsSIMDAvailable ();
+  parallelMinObjects = cfg->GetInt ("Culling.Frustvis.ParallelMinObjects",
+    1024);
+  // 0 means one thread per processor
+  numThreads = cfg->GetInt ("Culling.Frustvis.Threads", 0);
+  jobQueue.Invalidate ();
+  numWorkers = 0;
 
   csRef<iGraphics2D> g2d = csQueryRegistry<iGraphics2D> (object_reg);
   if (g2d)
@@ -234,6 +255,30 @@ void csFrustumVis::Setup (const char* /*name*/)
 {
 }
 
+iJobQueue* csFrustumVis::GetJobQueue ()
+{
+  if (!jobQueue && (numThreads != 1))
+  {
+    // The thread calling VisTest() also works on the tasks
+    jobQueue = CS::Threading::GetParallelForJobQueue (object_reg, numWorkers);
+    if (numThreads > 1)
+      numWorkers = csMin (size_t (numThreads - 1), numWorkers);
+    // Don't ask again on single processor machines
+    if (!jobQueue) numThreads = 1;
+  }
+  return jobQueue;
+}
+
+csKDTree* csFrustumVis::CreateTree ()
+{
+  csKDTree* tree = new csKDTree ();
+  tree->SetMinimumSplitAmount (50);
+  csRef<csFrustVisObjectDescriptor> desc;
+  desc.AttachNew (new csFrustVisObjectDescriptor ());
+  tree->SetObjectDescriptor (desc);
+  return tree;
+}
+
 void csFrustumVis::CalculateVisObjBBox (iVisibilityObject* visobj, csBox3& bbox)
 {
   iMovable* movable = visobj->GetMovable ();
@@ -303,6 +348,7 @@ void csFrustumVis::RegisterVisObject (iVisibilityObject* visobj)
   CalculateVisObjBBox (visobj, bbox);
   visobj_wrap->child = kdtree->AddObject (bbox, (void*)visobj_wrap);
   kdtree_box += bbox;
+  distribute_needed = true;
 
   iMeshWrapper* mesh = visobj->GetMeshWrapper ();
   visobj_wrap->mesh = mesh;
@@ -350,31 +396,84 @@ void csFrustumVis::AddObjectToUpdateQueue (csFrustVisObjectWrapper* visobj_wrap)
 
 void csFrustumVis::UpdateObjects ()
 {
+  if (update_queue.GetSize () == 0) return;
+
   updating = true;
   {
+    // Calculate all new boxes before touching the tree.
     csSet<csPtrKey<csFrustVisObjectWrapper> >::GlobalIterator it = 
       update_queue.GetIterator ();
     while (it.HasNext ())
     {
       csFrustVisObjectWrapper* vw = it.Next ();
-      UpdateObject (vw);
+      CS_ASSERT (vw->frustvis != (csFrustumVis*)0xdeadbeef);
+      csBox3 bbox;
+      CalculateVisObjBBox (vw->visobj, bbox);
+      update_objects.Push (vw);
+      update_boxes.Push (bbox);
     }
   }
   update_queue.DeleteAll ();
+
+  size_t num_updates = update_objects.GetSize ();
+  if ((num_updates >= FRUSTVIS_REBUILD_MIN)
+      && (num_updates * 2 >= visobj_vector.GetSize ()))
+  {
+    // Moving most objects one by one costs more than building a new tree.
+    for (size_t i = 0 ; i < num_updates ; i++)
+    {
+      csFrustVisObjectWrapper* vw = update_objects[i];
+      vw->child->SetBounds (update_boxes[i]);
+      kdtree_box += update_boxes[i];
+      vw->shape_number = vw->visobj->GetObjectModel ()->GetShapeNumber ();
+      vw->update_number = vw->visobj->GetMovable ()->GetUpdateNumber ();
+    }
+    RebuildTree ();
+  }
+  else
+  {
+    for (size_t i = 0 ; i < num_updates ; i++)
+      MoveObject (update_objects[i], update_boxes[i]);
+  }
+  update_objects.Empty ();
+  update_boxes.Empty ();
+  distribute_needed = true;
   updating = false;
 }
 
 void csFrustumVis::UpdateObject (csFrustVisObjectWrapper* visobj_wrap)
 {
   CS_ASSERT (visobj_wrap->frustvis != (csFrustumVis*)0xdeadbeef);
-  iVisibilityObject* visobj = visobj_wrap->visobj;
-  iMovable* movable = visobj->GetMovable ();
   csBox3 bbox;
-  CalculateVisObjBBox (visobj, bbox);
+  CalculateVisObjBBox (visobj_wrap->visobj, bbox);
+  MoveObject (visobj_wrap, bbox);
+  distribute_needed = true;
+}
+
+void csFrustumVis::MoveObject (csFrustVisObjectWrapper* visobj_wrap,
+	const csBox3& bbox)
+{
+  iVisibilityObject* visobj = visobj_wrap->visobj;
   kdtree->MoveObject (visobj_wrap->child, bbox);
   kdtree_box += bbox;
   visobj_wrap->shape_number = visobj->GetObjectModel ()->GetShapeNumber ();
-  visobj_wrap->update_number = movable->GetUpdateNumber ();
+  visobj_wrap->update_number = visobj->GetMovable ()->GetUpdateNumber ();
+}
+
+void csFrustumVis::RebuildTree ()
+{
+  // The new tree is distributed by the next VisTest().
+  csKDTree* old_tree = kdtree;
+  kdtree = CreateTree ();
+  for (size_t i = 0 ; i < visobj_vector.GetSize () ; i++)
+  {
+    csFrustVisObjectWrapper* visobj_wrap = visobj_vector[i];
+    csKDTreeChild* old_child = visobj_wrap->child;
+    visobj_wrap->child = kdtree->AddObject (old_child->GetBBox (),
+      (void*)visobj_wrap);
+    old_tree->RemoveObject (old_child);
+  }
+  delete old_tree;
 }
 
 struct FrustTest_Front2BackData
@@ -382,8 +481,8 @@ struct FrustTest_Front2BackData
   csVector3 pos;
   iRenderView* rview;
   csPlane3* frustum;
-  // this is the callback to call when we discover a visible node
-  iVisibilityCullerListener* viscallback;
+  // Test boxes with SSE
+  bool use_simd;
 };
 
 int csFrustumVis::TestNodeVisibility (csKDTree* treenode,
@@ -407,105 +506,201 @@ int csFrustumVis::TestNodeVisibility (csKDTree* treenode,
   return NODE_VISIBLE;
 }
 
-bool csFrustumVis::TestObjectVisibility (csFrustVisObjectWrapper* obj,
-  	FrustTest_Front2BackData* data, uint32 frustum_mask)
-{
-  if (obj->mesh && obj->mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH))
-    return false;
+//======== VisTest =========================================================
 
-  const csBox3& obj_bbox = obj->child->GetBBox ();
-  if (obj_bbox.Contains (data->pos))
-  {
-    data->viscallback->ObjectVisible (obj->visobj, obj->mesh, frustum_mask);
-    return true;
-  }
-  
-  uint32 new_mask;
-  if (!csIntersect3::BoxFrustum (obj_bbox, data->frustum,
-		frustum_mask, new_mask))
+namespace
+{
+  /// Runs the task ranges of a VisTest() handed out by ParallelFor()
+  struct FrustTest_RunTasks
   {
-    return false;
-  }
-
-  data->viscallback->ObjectVisible (obj->visobj, obj->mesh, new_mask);
+    csFrustumVis* frustvis;
+    FrustTest_Front2BackData* data;
 
-  return true;
+    void operator() (size_t first, size_t last)
+    {
+      for (size_t task = first; task < last; task++)
+        frustvis->RunVisTestTask (task, data);
+    }
+  };
 }
 
-//======== VisTest =========================================================
+static inline void FrustTest_AddResult (csArray<csFrustVisResult>& results,
+	csFrustVisObjectWrapper* visobj_wrap, uint32 frustum_mask)
+{
+  csFrustVisResult result;
+  result.obj = visobj_wrap;
+  result.frustum_mask = frustum_mask;
+  results.Push (result);
+}
 
-static void CallVisibilityCallbacksForSubtree (csKDTree* treenode,
-	FrustTest_Front2BackData* data, uint32 cur_timestamp)
+static void FrustTest_CollectSubtree (csKDTree* treenode,
+	csArray<csFrustVisResult>& results)
 {
   int num_objects = treenode->GetObjectCount ();
   csKDTreeChild** objects = treenode->GetObjects ();
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
-    {
-      objects[i]->timestamp = cur_timestamp;
-      csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
-      	objects[i]->GetObject ();
-      iMeshWrapper* mesh = visobj_wrap->mesh;
-      if (!(mesh && mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH)))
-        data->viscallback->ObjectVisible (visobj_wrap->visobj, mesh, 0);
-    }
+    csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
+      objects[i]->GetObject ();
+    iMeshWrapper* mesh = visobj_wrap->mesh;
+    if (!(mesh && mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH)))
+      FrustTest_AddResult (results, visobj_wrap, 0);
   }
 
   csKDTree* child1 = treenode->GetChild1 ();
-  if (child1) CallVisibilityCallbacksForSubtree (child1, data, cur_timestamp);
+  if (child1) FrustTest_CollectSubtree (child1, results);
   csKDTree* child2 = treenode->GetChild2 ();
-  if (child2) CallVisibilityCallbacksForSubtree (child2, data, cur_timestamp);
+  if (child2) FrustTest_CollectSubtree (child2, results);
+}
 
+// Test a batch of up to four object boxes.
+static void FrustTest_TestBatch (FrustTest_Front2BackData* data,
+	const csBox3* const* boxes, csFrustVisObjectWrapper* const* objs,
+	int num, uint32 frustum_mask, csArray<csFrustVisResult>& results)
+{
+  uint32 masks[csBoxFrustumTester::MAX_BOXES];
+  uint32 visible = csBoxFrustumTester::TestBoxes (boxes, num, data->frustum,
+    frustum_mask, masks, data->use_simd);
+  for (int i = 0 ; i < num ; i++)
+  {
+    if (visible & (1 << i))
+      FrustTest_AddResult (results, objs[i], masks[i]);
+  }
+}
+
+void csFrustumVis::FrustTest_TestObjects (csKDTree* treenode,
+	FrustTest_Front2BackData* data, uint32 frustum_mask,
+	csArray<csFrustVisResult>& results)
+{
+  const csBox3* boxes[csBoxFrustumTester::MAX_BOXES];
+  csFrustVisObjectWrapper* objs[csBoxFrustumTester::MAX_BOXES];
+  int num_batch = 0;
+
+  int num_objects = treenode->GetObjectCount ();
+  csKDTreeChild** objects = treenode->GetObjects ();
+  int i;
+  for (i = 0 ; i < num_objects ; i++)
+  {
+    csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
+      objects[i]->GetObject ();
+    iMeshWrapper* mesh = visobj_wrap->mesh;
+    if (mesh && mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH))
+      continue;
+
+    const csBox3& obj_bbox = objects[i]->GetBBox ();
+    if (obj_bbox.Contains (data->pos))
+    {
+      FrustTest_AddResult (results, visobj_wrap, frustum_mask);
+      continue;
+    }
+
+    boxes[num_batch] = &obj_bbox;
+    objs[num_batch] = visobj_wrap;
+    if (++num_batch == csBoxFrustumTester::MAX_BOXES)
+    {
+      FrustTest_TestBatch (data, boxes, objs, num_batch, frustum_mask,
+        results);
+      num_batch = 0;
+    }
+  }
+  if (num_batch > 0)
+    FrustTest_TestBatch (data, boxes, objs, num_batch, frustum_mask, results);
 }
 
 void csFrustumVis::FrustTest_Traverse (csKDTree* treenode,
-	FrustTest_Front2BackData* data,
-	uint32 cur_timestamp, uint32 frustum_mask)
+	FrustTest_Front2BackData* data, uint32 frustum_mask,
+	csArray<csFrustVisResult>& results)
 {
   // In the first part of this test we are going to test if the node
   // itself is visible. If it is not then we don't need to continue.
   int nodevis = TestNodeVisibility (treenode, data, frustum_mask);
   if (nodevis == NODE_INVISIBLE)
     return;
+  FrustTest_TraverseVisible (treenode, data, frustum_mask,
+    nodevis == NODE_INSIDE, results);
+}
 
-  if (nodevis == NODE_VISIBLE && frustum_mask == 0)
+void csFrustumVis::FrustTest_TraverseVisible (csKDTree* treenode,
+	FrustTest_Front2BackData* data, uint32 frustum_mask, bool inside,
+	csArray<csFrustVisResult>& results)
+{
+  if (!inside && frustum_mask == 0)
   {
     // Special case. The node is visible and the frustum mask is 0.
     // This means that the node is completely visible and it doesn't
     // make sense to continue testing visibility. However we need
-    // to call the callback on all visible objects. So we traverse the
-    // tree manually from this point on. To stop the Front2Back traversal
-    // we return false here.
-    CallVisibilityCallbacksForSubtree (treenode, data, cur_timestamp);
+    // to report all visible objects.
+    FrustTest_CollectSubtree (treenode, results);
     return;
   }
 
-  treenode->Distribute ();
+  FrustTest_TestObjects (treenode, data, frustum_mask, results);
 
-  int num_objects;
-  csKDTreeChild** objects;
-  num_objects = treenode->GetObjectCount ();
-  objects = treenode->GetObjects ();
-  int i;
-  for (i = 0 ; i < num_objects ; i++)
+  csKDTree* child1 = treenode->GetChild1 ();
+  if (!child1) return;
+
+  // Test both children together.
+  csKDTree* children[2] = { child1, treenode->GetChild2 () };
+  csBox3 child_bbox[2];
+  const csBox3* boxes[2];
+  int c;
+  for (c = 0 ; c < 2 ; c++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
-    {
-      objects[i]->timestamp = cur_timestamp;
-      csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
-      	objects[i]->GetObject ();
-      TestObjectVisibility (visobj_wrap, data, frustum_mask);
-    }
+    child_bbox[c] = children[c]->GetNodeBBox ();
+    child_bbox[c] *= kdtree_box;
+    boxes[c] = &child_bbox[c];
+  }
+  uint32 masks[2];
+  uint32 visible = csBoxFrustumTester::TestBoxes (boxes, 2, data->frustum,
+    frustum_mask, masks, data->use_simd);
+  for (c = 0 ; c < 2 ; c++)
+  {
+    if (child_bbox[c].Contains (data->pos))
+      FrustTest_TraverseVisible (children[c], data, frustum_mask, true,
+        results);
+    else if (visible & (1 << c))
+      FrustTest_TraverseVisible (children[c], data, masks[c], false,
+        results);
   }
+}
+
+void csFrustumVis::AddVisTestTask (csKDTree* treenode, uint32 frustum_mask,
+	bool objects_only)
+{
+  csFrustVisTask& task = vistest_tasks.GetExtend (num_vistest_tasks++);
+  task.node = treenode;
+  task.frustum_mask = frustum_mask;
+  task.objects_only = objects_only;
+  task.results.SetSize (0);
+}
 
+void csFrustumVis::FrustTest_Split (csKDTree* treenode,
+	FrustTest_Front2BackData* data, uint32 frustum_mask, int max_objects)
+{
   csKDTree* child1 = treenode->GetChild1 ();
-  if (child1) FrustTest_Traverse (child1, data, cur_timestamp, frustum_mask);
-  csKDTree* child2 = treenode->GetChild2 ();
-  if (child2) FrustTest_Traverse (child2, data, cur_timestamp, frustum_mask);
+  if (!child1 || treenode->GetEstimatedObjectCount () <= max_objects)
+  {
+    AddVisTestTask (treenode, frustum_mask, false);
+    return;
+  }
 
-  return;
+  if (TestNodeVisibility (treenode, data, frustum_mask) == NODE_INVISIBLE)
+    return;
+  if (treenode->GetObjectCount () > 0)
+    AddVisTestTask (treenode, frustum_mask, true);
+  FrustTest_Split (child1, data, frustum_mask, max_objects);
+  FrustTest_Split (treenode->GetChild2 (), data, frustum_mask, max_objects);
+}
+
+void csFrustumVis::RunVisTestTask (size_t task,
+	FrustTest_Front2BackData* data)
+{
+  csFrustVisTask& t = vistest_tasks[task];
+  if (t.objects_only)
+    FrustTest_TestObjects (t.node, data, t.frustum_mask, t.results);
+  else
+    FrustTest_Traverse (t.node, data, t.frustum_mask, t.results);
 }
 
 bool csFrustumVis::VisTest (iRenderView* rview, 
@@ -517,6 +712,13 @@ bool csFrustumVis::VisTest (iRenderView* rview,
   UpdateObjects ();
   current_vistest_nr++;
 
+  // The tasks only read the tree, so it has to be distributed up front.
+  if (distribute_needed)
+  {
+    kdtree->FullDistribute ();
+    distribute_needed = false;
+  }
+
   // just make sure we have a callback
   if (viscallback == 0)
     return false;
@@ -529,12 +731,46 @@ bool csFrustumVis::VisTest (iRenderView* rview,
   data.frustum = ctxt->clip_planes;
   uint32 frustum_mask = ctxt->clip_planes_mask;
 
-  // The big routine: traverse from front to back and mark all objects
-  // visible that are visible.
   data.pos = rview->GetCamera ()->GetTransform ().GetOrigin ();
   data.rview = rview;
-  data.viscallback = viscallback;
-  FrustTest_Traverse (kdtree, &data, kdtree->NewTraversal (), frustum_mask);
+  data.use_simd = useSIMD;
+
+  // Split the tree into tasks if it is large enough to be worth it.
+  num_vistest_tasks = 0;
+  int num_objects = kdtree->GetEstimatedObjectCount ();
+  if (num_objects >= parallelMinObjects && GetJobQueue ())
+  {
+    int max_objects = num_objects
+      / int (FRUSTVIS_TASKS_PER_THREAD * (numWorkers + 1));
+    FrustTest_Split (kdtree, &data, frustum_mask, max_objects);
+  }
+  else
+  {
+    AddVisTestTask (kdtree, frustum_mask, false);
+  }
+
+  FrustTest_RunTasks runTasks;
+  runTasks.frustvis = this;
+  runTasks.data = &data;
+  CS::Threading::ParallelFor (jobQueue, numWorkers, num_vistest_tasks, 1,
+    runTasks);
+
+  // Report the visible objects in traversal order. Objects in several
+  // nodes may have been found more than once but are reported only once.
+  uint32 cur_timestamp = kdtree->NewTraversal ();
+  for (size_t t = 0 ; t < num_vistest_tasks ; t++)
+  {
+    const csArray<csFrustVisResult>& results = vistest_tasks[t].results;
+    for (size_t i = 0 ; i < results.GetSize () ; i++)
+    {
+      csFrustVisObjectWrapper* visobj_wrap = results[i].obj;
+      csKDTreeChild* child = visobj_wrap->child;
+      if (child->timestamp == cur_timestamp) continue;
+      child->timestamp = cur_timestamp;
+      viscallback->ObjectVisible (visobj_wrap->visobj, visobj_wrap->mesh,
+        results[i].frustum_mask);
+    }
+  }
 
   return true;
 }
@@ -659,6 +895,127 @@ void csFrustumVis::VisTest (csPlane3* planes,
   	(void*)&data, frustum_mask);
 }
 
+//======== VisTest views ===================================================
+
+struct FrustTestViews_Data
+{
+  const csVisibilityCullerView* views;
+  size_t num_views;
+  uint32 cur_timestamp;
+
+  // The objects found in the views so far.
+  csArray<csFrustVisObjectWrapper*> objects;
+  /* For every object: the views it was tested against, the views it is
+     visible in and the clip masks for all views. */
+  csDirtyAccessArray<uint32> masks;
+};
+
+void csFrustumVis::FrustTestViews_Traverse (csKDTree* treenode,
+	FrustTestViews_Data* data, uint32 view_mask,
+	const uint32* frustum_masks)
+{
+  const size_t num_views = data->num_views;
+  const size_t stride = num_views + 2;
+
+  // Find the views the node is visible in.
+  csBox3 node_bbox = treenode->GetNodeBBox ();
+  node_bbox *= kdtree_box;
+  uint32 node_masks[32];
+  uint32 node_views = 0;
+  size_t v;
+  for (v = 0 ; v < num_views ; v++)
+  {
+    if (!(view_mask & (uint32 (1) << v))) continue;
+    if (csIntersect3::BoxFrustum (node_bbox, data->views[v].planes,
+	frustum_masks[v], node_masks[v]))
+      node_views |= uint32 (1) << v;
+  }
+  if (node_views == 0)
+    return;
+
+  treenode->Distribute ();
+
+  int num_objects = treenode->GetObjectCount ();
+  csKDTreeChild** objects = treenode->GetObjects ();
+  int i;
+  for (i = 0 ; i < num_objects ; i++)
+  {
+    csKDTreeChild* child = objects[i];
+    csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
+      child->GetObject ();
+    iMeshWrapper* mesh = visobj_wrap->mesh;
+    if (mesh && mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH))
+      continue;
+
+    if (child->timestamp != data->cur_timestamp)
+    {
+      child->timestamp = data->cur_timestamp;
+      visobj_wrap->view_result = data->objects.Push (visobj_wrap);
+      size_t n = data->masks.GetSize ();
+      data->masks.SetSize (n + stride, 0);
+    }
+    uint32* masks = data->masks.GetArray ()
+      + visobj_wrap->view_result * stride;
+
+    // An object in several nodes is only tested once for every view.
+    uint32 test_views = node_views & ~masks[0];
+    if (test_views == 0) continue;
+    masks[0] |= test_views;
+    const csBox3& obj_bbox = child->GetBBox ();
+    for (v = 0 ; v < num_views ; v++)
+    {
+      if (!(test_views & (uint32 (1) << v))) continue;
+      if (csIntersect3::BoxFrustum (obj_bbox, data->views[v].planes,
+	  node_masks[v], masks[2 + v]))
+	masks[1] |= uint32 (1) << v;
+    }
+  }
+
+  csKDTree* child1 = treenode->GetChild1 ();
+  if (child1)
+  {
+    FrustTestViews_Traverse (child1, data, node_views, node_masks);
+    FrustTestViews_Traverse (treenode->GetChild2 (), data, node_views,
+      node_masks);
+  }
+}
+
+void csFrustumVis::VisTest (const csVisibilityCullerView* views,
+	size_t num_views, iVisibilityCullerMultiViewListener* viscallback)
+{
+  UpdateObjects ();
+  current_vistest_nr++;
+
+  CS_ASSERT (num_views <= 32);
+  if (num_views > 32) num_views = 32;
+  if (num_views == 0) return;
+
+  FrustTestViews_Data data;
+  data.views = views;
+  data.num_views = num_views;
+  data.cur_timestamp = kdtree->NewTraversal ();
+
+  uint32 view_mask = 0;
+  uint32 frustum_masks[32];
+  size_t v;
+  for (v = 0 ; v < num_views ; v++)
+  {
+    view_mask |= uint32 (1) << v;
+    frustum_masks[v] = views[v].planes_mask;
+  }
+  FrustTestViews_Traverse (kdtree, &data, view_mask, frustum_masks);
+
+  const size_t stride = num_views + 2;
+  for (size_t i = 0 ; i < data.objects.GetSize () ; i++)
+  {
+    const uint32* masks = data.masks.GetArray () + i * stride;
+    if (masks[1] == 0) continue;
+    csFrustVisObjectWrapper* visobj_wrap = data.objects[i];
+    viscallback->ObjectVisible (visobj_wrap->visobj, visobj_wrap->mesh,
+      masks[1], masks + 2);
+  }
+}
+
 //======== VisTest box =====================================================
 
 struct FrustTestBox_Front2BackData
@@ -22,6 +22,7 @@
 #include "iutil/eventh.h"
 #include "iutil/comp.h"
 #include "iutil/dbghelp.h"
+#include "iutil/job.h"
 #include "csutil/array.h"
 #include "csutil/parray.h"
 #include "csutil/scf_implementation.h"
@@ -40,6 +41,7 @@ struct iMovable;
 struct iMeshWrapper;
 
 struct FrustTest_Front2BackData;
+struct FrustTestViews_Data;
 
 /**
  * This object is a wrapper for an iVisibilityObject from the engine.
@@ -54,6 +56,8 @@ public:
   csKDTreeChild* child;
   long update_number;	// Last used update_number from movable.
   long shape_number;	// Last used shape_number from model.
+  // Index of the object's results in a VisTest() of several views.
+  size_t view_result;
 
   // Optional data for shadows. Both fields can be 0.
   csRef<iMeshWrapper> mesh;
@@ -70,6 +74,29 @@ public:
   virtual void MovableDestroyed (iMovable*) { }
 };
 
+/// An object found visible by VisTest().
+struct csFrustVisResult
+{
+  csFrustVisObjectWrapper* obj;
+  // Clip planes the object intersects.
+  uint32 frustum_mask;
+};
+
+/**
+ * A part of the kd-tree tested by VisTest(). Tasks are run in parallel on
+ * the job queue; every task has its own result array so the jobs don't
+ * need any locking. The arrays are only truncated when a task is reused,
+ * so their memory is kept between frames.
+ */
+struct csFrustVisTask
+{
+  csKDTree* node;
+  uint32 frustum_mask;
+  // If true only the objects of the node are tested, not its children.
+  bool objects_only;
+  csArray<csFrustVisResult> results;
+};
+
 #include "csutil/deprecated_warn_off.h"
 
 /**
@@ -87,7 +114,7 @@ public:
   VistestObjectsArray vistest_objects;
   bool vistest_objects_inuse;	// If true the vector is in use.
 
-private:
+protected:
   iObjectRegistry *object_reg;
   csEventID CanvasResize;
   csRef<iEventHandler> weakEventHandler;
@@ -109,16 +136,71 @@ private:
   // again).
   bool updating;
 
+  // Set if objects were added or moved since the tree was last
+  // distributed. The tree is distributed before VisTest() traverses it
+  // because the jobs can't modify it.
+  bool distribute_needed;
+  // Boxes of the objects being updated in UpdateObjects().
+  csArray<csFrustVisObjectWrapper*> update_objects;
+  csArray<csBox3> update_boxes;
+
+  // Number of threads to use, including the calling thread (0 for one
+  // per processor).
+  int numThreads;
+  // Shared parallel loop queue, fetched by GetJobQueue() once a tree is
+  // large enough to be split, and the number of jobs to spread work over.
+  csRef<iJobQueue> jobQueue;
+  size_t numWorkers;
+  // Whether to test boxes with SSE.
+  bool useSIMD;
+  // Trees with fewer objects are tested by the calling thread alone.
+  int parallelMinObjects;
+  // Tasks of the current VisTest(), in traversal order.
+  csArray<csFrustVisTask> vistest_tasks;
+  size_t num_vistest_tasks;
+
+  // Get the job queue for VisTest() (0 if not threaded). Subclasses may
+  // use it for their own work.
+  iJobQueue* GetJobQueue ();
+
+  // Create an empty kd-tree.
+  csKDTree* CreateTree ();
+
   // Update all objects in the update queue.
   void UpdateObjects ();
 
+  // Set the box of an object in the kdtree.
+  void MoveObject (csFrustVisObjectWrapper* visobj_wrap, const csBox3& bbox);
+
+  // Rebuild the kdtree from scratch with the current object boxes.
+  void RebuildTree ();
+
   // Fill the bounding box with the current object status.
   void CalculateVisObjBBox (iVisibilityObject* visobj, csBox3& bbox);
 
+  // Split the kdtree into tasks for frustum culling.
+  void FrustTest_Split (csKDTree* treenode, FrustTest_Front2BackData* data,
+	uint32 frustum_mask, int max_objects);
+  void AddVisTestTask (csKDTree* treenode, uint32 frustum_mask,
+	bool objects_only);
+
   // Traverse the kdtree for frustum culling.
   void FrustTest_Traverse (csKDTree* treenode,
-	FrustTest_Front2BackData* data,
-	uint32 cur_timestamp, uint32 frustum_mask);
+	FrustTest_Front2BackData* data, uint32 frustum_mask,
+	csArray<csFrustVisResult>& results);
+  // Traverse a node known to be visible.
+  void FrustTest_TraverseVisible (csKDTree* treenode,
+	FrustTest_Front2BackData* data, uint32 frustum_mask, bool inside,
+	csArray<csFrustVisResult>& results);
+  // Test the objects of a node.
+  void FrustTest_TestObjects (csKDTree* treenode,
+	FrustTest_Front2BackData* data, uint32 frustum_mask,
+	csArray<csFrustVisResult>& results);
+
+  // Traverse the kdtree for a VisTest() of several views.
+  void FrustTestViews_Traverse (csKDTree* treenode,
+	FrustTestViews_Data* data, uint32 view_mask,
+	const uint32* frustum_masks);
 
 public:
   csFrustumVis (iBase *iParent);
@@ -135,9 +217,8 @@ public:
   int TestNodeVisibility (csKDTree* treenode,
   	FrustTest_Front2BackData* data, uint32& frustum_mask);
 
-  // Test visibility for the given object. Returns true if visible.
-  bool TestObjectVisibility (csFrustVisObjectWrapper* obj,
-  	FrustTest_Front2BackData* data, uint32 frustum_mask);
+  // Run one of the tasks of the current VisTest(). Called by the jobs.
+  void RunVisTestTask (size_t task, FrustTest_Front2BackData* data);
 
   // Add an object to the update queue. That way it will be updated
   // in the kdtree later when needed.
@@ -161,6 +242,8 @@ public:
   	int num_planes);
   virtual void VisTest (csPlane3* planes,
   	int num_planes, iVisibilityCullerListener* viscallback);
+  virtual void VisTest (const csVisibilityCullerView* views,
+	size_t num_views, iVisibilityCullerMultiViewListener* viscallback);
   virtual csPtr<iVisibilityObjectIterator> IntersectSegmentSloppy (
     const csVector3& start, const csVector3& end);
   virtual csPtr<iVisibilityObjectIterator> IntersectSegment (
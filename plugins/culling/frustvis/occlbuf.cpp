@@ -0,0 +1,491 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include <float.h>
+#include "iutil/job.h"
+#include "csutil/parallelfor.h"
+#include "csutil/processorspecdetection.h"
+#include "occlbuf.h"
+
+#if defined (CS_PROCESSOR_X86) && (defined (__SSE__) || defined (_M_X64) \
+  || (defined (_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define CS_OCCLBUF_SSE
+#include <xmmintrin.h>
+#endif
+
+// Vertices closer to the camera plane than this are clipped away.
+#define OCCLBUF_NEAR_W 0.001f
+/* Triangles are clipped to a guard band this many times the size of the
+   screen, keeping the projected coordinates in a range where the edge
+   functions remain precise. */
+#define OCCLBUF_GUARD_BAND 2.0f
+
+// Clip space outcodes
+#define OUT_NEAR	1
+#define OUT_RIGHT	2
+#define OUT_LEFT	4
+#define OUT_TOP		8
+#define OUT_BOTTOM	16
+#define OUT_COUNT	5
+
+namespace
+{
+  /// Rasterizes the bin ranges handed out by Rasterize()
+  struct RasterizeBins
+  {
+    csOcclusionBuffer* buffer;
+
+    void operator() (size_t first, size_t last)
+    {
+      for (size_t bin = first; bin < last; bin++)
+        buffer->RasterizeBin (int (bin));
+    }
+  };
+
+  inline uint32 ComputeOutcodes (const csVector4& v)
+  {
+    const float g = OCCLBUF_GUARD_BAND * v.w;
+    uint32 codes = 0;
+    if (v.w < OCCLBUF_NEAR_W) codes |= OUT_NEAR;
+    if (v.x > g) codes |= OUT_RIGHT;
+    if (v.x < -g) codes |= OUT_LEFT;
+    if (v.y > g) codes |= OUT_TOP;
+    if (v.y < -g) codes |= OUT_BOTTOM;
+    return codes;
+  }
+
+  /// Signed distance to a clip plane, positive on the inside.
+  inline float PlaneDistance (const csVector4& v, int plane)
+  {
+    switch (plane)
+    {
+      case 0: return v.w - OCCLBUF_NEAR_W;
+      case 1: return OCCLBUF_GUARD_BAND * v.w - v.x;
+      case 2: return OCCLBUF_GUARD_BAND * v.w + v.x;
+      case 3: return OCCLBUF_GUARD_BAND * v.w - v.y;
+      default: return OCCLBUF_GUARD_BAND * v.w + v.y;
+    }
+  }
+}
+
+csOcclusionBuffer::csOcclusionBuffer ()
+  : width (0), height (0), tilesX (0), tilesY (0), binsX (0), binsY (0),
+    useSIMD (IsSIMDAvailable ()), depthSign (1.0f)
+{
+}
+
+csOcclusionBuffer::~csOcclusionBuffer ()
+{
+}
+
+void csOcclusionBuffer::SetResolution (int w, int h)
+{
+  width = (csMax (w, 1) + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+  height = (csMax (h, 1) + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+  tilesX = width / TILE_SIZE;
+  tilesY = height / TILE_SIZE;
+  binsX = (width + BIN_SIZE - 1) / BIN_SIZE;
+  binsY = (height + BIN_SIZE - 1) / BIN_SIZE;
+
+  depth.SetSize (width * height, FLT_MAX);
+  tileMax.SetSize (tilesX * tilesY, FLT_MAX);
+  binTriangles.SetSize (binsX * binsY);
+  triangles.Empty ();
+}
+
+bool csOcclusionBuffer::IsSIMDAvailable ()
+{
+#ifdef CS_OCCLBUF_SSE
+  static int available = -1;
+  if (available < 0)
+  {
+    CS::Platform::ProcessorSpecDetection procSpec;
+    available = procSpec.HasSSE () ? 1 : 0;
+  }
+  return available != 0;
+#else
+  return false;
+#endif
+}
+
+void csOcclusionBuffer::SetSIMDEnabled (bool enable)
+{
+  useSIMD = enable && IsSIMDAvailable ();
+}
+
+void csOcclusionBuffer::Begin (const CS::Math::Matrix4& projection,
+                               const CS::Math::Matrix4& worldToCamera)
+{
+  worldToClip = projection * worldToCamera;
+
+  // Find out in which direction the projected depth grows
+  csVector4 nearPt = projection * csVector4 (0, 0, 1, 1);
+  csVector4 farPt = projection * csVector4 (0, 0, 2, 1);
+  depthSign = (farPt.z / farPt.w >= nearPt.z / nearPt.w) ? 1.0f : -1.0f;
+
+  triangles.Empty ();
+  for (size_t b = 0; b < binTriangles.GetSize (); b++)
+    binTriangles[b].Empty ();
+}
+
+void csOcclusionBuffer::AddOccluder (const CS::Math::Matrix4& objectToWorld,
+                                     const csVector3* vertices,
+                                     size_t numVertices,
+                                     const csTriangle* tris,
+                                     size_t numTriangles)
+{
+  if (width == 0) return;
+
+  CS::Math::Matrix4 objectToClip (worldToClip * objectToWorld);
+  clipVertices.SetSize (numVertices);
+  for (size_t v = 0; v < numVertices; v++)
+    clipVertices[v] = objectToClip * csVector4 (vertices[v], 1.0f);
+
+  for (size_t t = 0; t < numTriangles; t++)
+  {
+    const csTriangle& tri = tris[t];
+    const csVector4& v0 = clipVertices[tri.a];
+    const csVector4& v1 = clipVertices[tri.b];
+    const csVector4& v2 = clipVertices[tri.c];
+    uint32 c0 = ComputeOutcodes (v0);
+    uint32 c1 = ComputeOutcodes (v1);
+    uint32 c2 = ComputeOutcodes (v2);
+    // Entirely outside one of the planes
+    if (c0 & c1 & c2) continue;
+    if ((c0 | c1 | c2) == 0)
+      AddTriangle (v0, v1, v2);
+    else
+      ClipTriangle (v0, v1, v2, c0 | c1 | c2);
+  }
+}
+
+void csOcclusionBuffer::ClipTriangle (const csVector4& v0,
+                                      const csVector4& v1,
+                                      const csVector4& v2,
+                                      uint32 outcodes)
+{
+  // Every plane adds at most one vertex
+  csVector4 poly[2][3 + OUT_COUNT];
+  int num = 3;
+  poly[0][0] = v0;
+  poly[0][1] = v1;
+  poly[0][2] = v2;
+  int cur = 0;
+
+  for (int plane = 0; plane < OUT_COUNT; plane++)
+  {
+    if (!(outcodes & (1 << plane))) continue;
+
+    const csVector4* in = poly[cur];
+    csVector4* out = poly[cur ^ 1];
+    int numOut = 0;
+    for (int i = 0; i < num; i++)
+    {
+      const csVector4& a = in[i];
+      const csVector4& b = in[(i + 1) % num];
+      float da = PlaneDistance (a, plane);
+      float db = PlaneDistance (b, plane);
+      if (da >= 0) out[numOut++] = a;
+      if ((da >= 0) != (db >= 0))
+        out[numOut++] = a + (b - a) * (da / (da - db));
+    }
+    num = numOut;
+    cur ^= 1;
+    if (num < 3) return;
+  }
+
+  for (int i = 2; i < num; i++)
+    AddTriangle (poly[cur][0], poly[cur][i - 1], poly[cur][i]);
+}
+
+void csOcclusionBuffer::AddTriangle (const csVector4& v0, const csVector4& v1,
+                                     const csVector4& v2)
+{
+  // Project to pixel coordinates
+  const float hw = 0.5f * width;
+  const float hh = 0.5f * height;
+  float x[3], y[3], z[3];
+  const csVector4* v[3] = { &v0, &v1, &v2 };
+  for (int i = 0; i < 3; i++)
+  {
+    float inv_w = 1.0f / v[i]->w;
+    x[i] = (v[i]->x * inv_w + 1.0f) * hw;
+    y[i] = (v[i]->y * inv_w + 1.0f) * hh;
+    z[i] = v[i]->z * inv_w * depthSign;
+  }
+
+  /* Both sides of an occluder hide what is behind them, so instead of
+     culling back faces all triangles are made counter-clockwise. */
+  float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  if (area < 0)
+  {
+    float t;
+    t = x[1]; x[1] = x[2]; x[2] = t;
+    t = y[1]; y[1] = y[2]; y[2] = t;
+    t = z[1]; z[1] = z[2]; z[2] = t;
+    area = -area;
+  }
+  if (area <= SMALL_EPSILON) return;
+
+  // Range of pixels whose centers may be covered
+  float fminX = csMin (x[0], csMin (x[1], x[2]));
+  float fmaxX = csMax (x[0], csMax (x[1], x[2]));
+  float fminY = csMin (y[0], csMin (y[1], y[2]));
+  float fmaxY = csMax (y[0], csMax (y[1], y[2]));
+  Triangle tri;
+  tri.minX = csMax (int (ceilf (fminX - 0.5f)), 0);
+  tri.maxX = csMin (int (floorf (fmaxX - 0.5f)) + 1, width);
+  tri.minY = csMax (int (ceilf (fminY - 0.5f)), 0);
+  tri.maxY = csMin (int (floorf (fmaxY - 0.5f)) + 1, height);
+  if ((tri.minX >= tri.maxX) || (tri.minY >= tri.maxY)) return;
+
+  /* Edge i is opposite vertex i. The pixel center offset is folded into
+     the constant terms so the rasterizer evaluates at integer positions. */
+  for (int i = 0; i < 3; i++)
+  {
+    int va = (i + 1) % 3;
+    int vb = (i + 2) % 3;
+    tri.a[i] = y[va] - y[vb];
+    tri.b[i] = x[vb] - x[va];
+    tri.c[i] = -(tri.a[i] * x[va] + tri.b[i] * y[va])
+      + 0.5f * (tri.a[i] + tri.b[i]);
+  }
+  float inv_area = 1.0f / area;
+  tri.zx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0]))
+    * inv_area;
+  tri.zy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0]))
+    * inv_area;
+  tri.z0 = z[0];
+  tri.refX = x[0] - 0.5f;
+  tri.refY = y[0] - 0.5f;
+  tri.zmin = csMin (z[0], csMin (z[1], z[2]));
+
+  uint32 index = uint32 (triangles.Push (tri));
+  int bx0 = tri.minX / BIN_SIZE;
+  int bx1 = (tri.maxX - 1) / BIN_SIZE;
+  int by0 = tri.minY / BIN_SIZE;
+  int by1 = (tri.maxY - 1) / BIN_SIZE;
+  for (int by = by0; by <= by1; by++)
+    for (int bx = bx0; bx <= bx1; bx++)
+      binTriangles[by * binsX + bx].Push (index);
+}
+
+void csOcclusionBuffer::Rasterize (iJobQueue* jobQueue, size_t numWorkers)
+{
+  // Empty bins are only cleared, not worth handing out
+  if (triangles.GetSize () == 0) jobQueue = 0;
+
+  RasterizeBins rasterizeBins;
+  rasterizeBins.buffer = this;
+  CS::Threading::ParallelFor (jobQueue, numWorkers, binsX * binsY, 1,
+    rasterizeBins);
+}
+
+void csOcclusionBuffer::RasterizeBin (int bin)
+{
+  const int x0 = (bin % binsX) * BIN_SIZE;
+  const int y0 = (bin / binsX) * BIN_SIZE;
+  const int x1 = csMin (x0 + int (BIN_SIZE), width);
+  const int y1 = csMin (y0 + int (BIN_SIZE), height);
+
+  for (int y = y0; y < y1; y++)
+  {
+    float* row = depth.GetArray () + y * width;
+    for (int x = x0; x < x1; x++)
+      row[x] = FLT_MAX;
+  }
+
+  const csArray<uint32>& binTris = binTriangles[bin];
+  for (size_t t = 0; t < binTris.GetSize (); t++)
+  {
+    const Triangle& tri = triangles[binTris[t]];
+    int tx0 = csMax (tri.minX, x0);
+    int ty0 = csMax (tri.minY, y0);
+    int tx1 = csMin (tri.maxX, x1);
+    int ty1 = csMin (tri.maxY, y1);
+#ifdef CS_OCCLBUF_SSE
+    if (useSIMD)
+    {
+      RasterizeTriangleSSE (tri, tx0, ty0, tx1, ty1);
+      continue;
+    }
+#endif
+    RasterizeTriangleScalar (tri, tx0, ty0, tx1, ty1);
+  }
+
+  UpdateTiles (x0, y0, x1, y1);
+}
+
+void csOcclusionBuffer::RasterizeTriangleScalar (const Triangle& tri,
+                                                 int x0, int y0,
+                                                 int x1, int y1)
+{
+  for (int y = y0; y < y1; y++)
+  {
+    float* row = depth.GetArray () + y * width;
+    const float fy = float (y);
+    const float e0row = tri.b[0] * fy + tri.c[0];
+    const float e1row = tri.b[1] * fy + tri.c[1];
+    const float e2row = tri.b[2] * fy + tri.c[2];
+    const float zrow = tri.z0 + tri.zy * (fy - tri.refY);
+    for (int x = x0; x < x1; x++)
+    {
+      const float fx = float (x);
+      if ((tri.a[0] * fx + e0row >= 0) && (tri.a[1] * fx + e1row >= 0)
+          && (tri.a[2] * fx + e2row >= 0))
+      {
+        float d = csMax (zrow + tri.zx * (fx - tri.refX), tri.zmin);
+        if (d < row[x]) row[x] = d;
+      }
+    }
+  }
+}
+
+#ifdef CS_OCCLBUF_SSE
+void csOcclusionBuffer::RasterizeTriangleSSE (const Triangle& tri,
+                                              int x0, int y0,
+                                              int x1, int y1)
+{
+  /* Four pixels of a row at a time. Bins and the buffer width are
+     multiples of the tile size, so rounding the span out to multiples of
+     four stays inside the bin; the edge functions reject the extra
+     pixels. */
+  const int xs = x0 & ~3;
+  const int xe = (x1 + 3) & ~3;
+
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 four = _mm_set1_ps (4.0f);
+  const __m128 a0 = _mm_set1_ps (tri.a[0]);
+  const __m128 a1 = _mm_set1_ps (tri.a[1]);
+  const __m128 a2 = _mm_set1_ps (tri.a[2]);
+  const __m128 zx = _mm_set1_ps (tri.zx);
+  const __m128 refX = _mm_set1_ps (tri.refX);
+  const __m128 zmin = _mm_set1_ps (tri.zmin);
+  const __m128 xstart = _mm_add_ps (_mm_set1_ps (float (xs)),
+    _mm_set_ps (3.0f, 2.0f, 1.0f, 0.0f));
+
+  /* The same operations as the scalar version, per lane, so both give
+     identical results. */
+  for (int y = y0; y < y1; y++)
+  {
+    float* row = depth.GetArray () + y * width;
+    const float fy = float (y);
+    const __m128 e0row = _mm_set1_ps (tri.b[0] * fy + tri.c[0]);
+    const __m128 e1row = _mm_set1_ps (tri.b[1] * fy + tri.c[1]);
+    const __m128 e2row = _mm_set1_ps (tri.b[2] * fy + tri.c[2]);
+    const __m128 zrow = _mm_set1_ps (tri.z0 + tri.zy * (fy - tri.refY));
+    __m128 fx = xstart;
+
+    for (int x = xs; x < xe; x += 4)
+    {
+      __m128 e0 = _mm_add_ps (_mm_mul_ps (a0, fx), e0row);
+      __m128 e1 = _mm_add_ps (_mm_mul_ps (a1, fx), e1row);
+      __m128 e2 = _mm_add_ps (_mm_mul_ps (a2, fx), e2row);
+      __m128 inside = _mm_and_ps (
+        _mm_and_ps (_mm_cmpge_ps (e0, zero), _mm_cmpge_ps (e1, zero)),
+        _mm_cmpge_ps (e2, zero));
+      if (_mm_movemask_ps (inside))
+      {
+        __m128 z = _mm_add_ps (zrow, _mm_mul_ps (zx, _mm_sub_ps (fx, refX)));
+        __m128 old = _mm_loadu_ps (row + x);
+        __m128 d = _mm_min_ps (old, _mm_max_ps (z, zmin));
+        _mm_storeu_ps (row + x, _mm_or_ps (_mm_and_ps (inside, d),
+          _mm_andnot_ps (inside, old)));
+      }
+      fx = _mm_add_ps (fx, four);
+    }
+  }
+}
+#endif
+
+void csOcclusionBuffer::UpdateTiles (int x0, int y0, int x1, int y1)
+{
+  for (int ty = y0 / TILE_SIZE; ty < y1 / TILE_SIZE; ty++)
+  {
+    for (int tx = x0 / TILE_SIZE; tx < x1 / TILE_SIZE; tx++)
+    {
+      float m = 0;
+      for (int y = 0; y < TILE_SIZE; y++)
+      {
+        const float* row = depth.GetArray ()
+          + (ty * TILE_SIZE + y) * width + tx * TILE_SIZE;
+        for (int x = 0; x < TILE_SIZE; x++)
+          m = csMax (m, row[x]);
+      }
+      tileMax[ty * tilesX + tx] = m;
+    }
+  }
+}
+
+bool csOcclusionBuffer::TestBox (const csBox3& box) const
+{
+  if ((width == 0) || (triangles.GetSize () == 0)) return true;
+
+  float minX = FLT_MAX, minY = FLT_MAX;
+  float maxX = -FLT_MAX, maxY = -FLT_MAX;
+  float nearest = FLT_MAX;
+  for (int i = 0; i < 8; i++)
+  {
+    csVector4 c = worldToClip * csVector4 (box.GetCorner (i), 1.0f);
+    // Boxes reaching behind the camera are always considered visible
+    if (c.w < OCCLBUF_NEAR_W) return true;
+    float inv_w = 1.0f / c.w;
+    float x = c.x * inv_w;
+    float y = c.y * inv_w;
+    minX = csMin (minX, x);
+    maxX = csMax (maxX, x);
+    minY = csMin (minY, y);
+    maxY = csMax (maxY, y);
+    nearest = csMin (nearest, c.z * inv_w * depthSign);
+  }
+
+  // Pixels touched by the projected box
+  const float hw = 0.5f * width;
+  const float hh = 0.5f * height;
+  int x0 = csMax (int (floorf ((minX + 1.0f) * hw)), 0);
+  int x1 = csMin (int (ceilf ((maxX + 1.0f) * hw)), width);
+  int y0 = csMax (int (floorf ((minY + 1.0f) * hh)), 0);
+  int y1 = csMin (int (ceilf ((maxY + 1.0f) * hh)), height);
+  if ((x0 >= x1) || (y0 >= y1)) return false;
+
+  const int tx0 = x0 / TILE_SIZE;
+  const int tx1 = (x1 - 1) / TILE_SIZE;
+  const int ty0 = y0 / TILE_SIZE;
+  const int ty1 = (y1 - 1) / TILE_SIZE;
+  for (int ty = ty0; ty <= ty1; ty++)
+  {
+    for (int tx = tx0; tx <= tx1; tx++)
+    {
+      // All pixels of the tile are in front of the box
+      if (tileMax[ty * tilesX + tx] < nearest) continue;
+
+      int px0 = csMax (x0, tx * TILE_SIZE);
+      int px1 = csMin (x1, (tx + 1) * TILE_SIZE);
+      int py0 = csMax (y0, ty * TILE_SIZE);
+      int py1 = csMin (y1, (ty + 1) * TILE_SIZE);
+      for (int y = py0; y < py1; y++)
+      {
+        const float* row = depth.GetArray () + y * width;
+        for (int x = px0; x < px1; x++)
+          if (row[x] >= nearest) return true;
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,160 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_OCCLBUF_H__
+#define __CS_OCCLBUF_H__
+
+#include "csutil/array.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csgeom/box.h"
+#include "csgeom/matrix4.h"
+#include "csgeom/tri.h"
+#include "csgeom/vector4.h"
+
+struct iJobQueue;
+
+/**
+ * A low resolution software depth buffer for occlusion culling.
+ *
+ * Occluder triangles are transformed to clip space, clipped, set up and
+ * sorted into screen space bins by AddOccluder(). Rasterize() then fills
+ * the bins, in parallel if a job queue is given. Each bin is owned by a
+ * single thread, so no locking is needed while rasterizing.
+ *
+ * Besides the per pixel depth the buffer keeps the farthest depth of every
+ * 8x8 pixel tile. TestBox() first checks boxes against these tiles and only
+ * looks at single pixels for tiles that are not entirely in front of the box.
+ *
+ * Depths are the projected z/w, flipped if needed so that larger values are
+ * always farther away. Pixels not covered by an occluder are infinitely far.
+ */
+class csOcclusionBuffer
+{
+public:
+  enum
+  {
+    /// Width and height of a tile in the hierarchical depth buffer.
+    TILE_SIZE = 8,
+    /// Width and height of a bin rasterized as one job.
+    BIN_SIZE = 64
+  };
+
+  csOcclusionBuffer ();
+  ~csOcclusionBuffer ();
+
+  /**
+   * Set the resolution of the buffer. Width and height are rounded up to a
+   * multiple of the tile size.
+   */
+  void SetResolution (int width, int height);
+  int GetWidth () const { return width; }
+  int GetHeight () const { return height; }
+
+  /// Whether the processor supports the SSE rasterizer.
+  static bool IsSIMDAvailable ();
+  /// Enable or disable the SSE rasterizer (if available).
+  void SetSIMDEnabled (bool enable);
+
+  /**
+   * Start a new frame for the given camera. Discards all occluders of the
+   * previous frame.
+   */
+  void Begin (const CS::Math::Matrix4& projection,
+    const CS::Math::Matrix4& worldToCamera);
+
+  /**
+   * Add the triangles of an occluder. \a objectToWorld transforms the
+   * vertices to world space.
+   */
+  void AddOccluder (const CS::Math::Matrix4& objectToWorld,
+    const csVector3* vertices, size_t numVertices,
+    const csTriangle* triangles, size_t numTriangles);
+
+  /// Number of triangles (after clipping) added since Begin().
+  size_t GetTriangleCount () const { return triangles.GetSize (); }
+
+  /**
+   * Rasterize all occluders added since Begin(). The calling thread works
+   * on the bins together with up to \a numWorkers jobs queued on
+   * \a jobQueue; if no queue is given all bins are rasterized by the
+   * calling thread.
+   */
+  void Rasterize (iJobQueue* jobQueue, size_t numWorkers);
+
+  /**
+   * Test whether a world space box may be visible. Returns false if the
+   * box is hidden behind the occluders or outside the screen.
+   */
+  bool TestBox (const csBox3& box) const;
+
+  /// Get the depth of a pixel (after Rasterize()).
+  float GetDepth (int x, int y) const { return depth[y * width + x]; }
+
+  /// Rasterize one bin. Used by the rasterizer jobs.
+  void RasterizeBin (int bin);
+
+private:
+  /// A triangle set up for rasterization.
+  struct Triangle
+  {
+    /* Edge functions a*x + b*y + c in pixel coordinates. A pixel center is
+       inside if all three are non-negative. */
+    float a[3], b[3], c[3];
+    /* Depth plane: depth = z0 + zx*(x - refX) + zy*(y - refY). Relative to
+       a vertex, so the constant term doesn't cancel out precision. */
+    float zx, zy, z0, refX, refY;
+    /// Nearest depth of the vertices, clamps the interpolated depth.
+    float zmin;
+    /// Pixel bounds (max exclusive)
+    int minX, minY, maxX, maxY;
+  };
+
+  int width, height;
+  int tilesX, tilesY;
+  int binsX, binsY;
+  bool useSIMD;
+
+  csDirtyAccessArray<float> depth;
+  /// Farthest depth of every tile.
+  csDirtyAccessArray<float> tileMax;
+
+  /// Transform from world to clip space of the current frame.
+  CS::Math::Matrix4 worldToClip;
+  /// 1 or -1, makes depths grow with distance from the camera.
+  float depthSign;
+
+  csArray<Triangle> triangles;
+  /// Indices of the triangles overlapping each bin.
+  csArray<csArray<uint32> > binTriangles;
+  /// Clip space vertices of the occluder being added.
+  csArray<csVector4> clipVertices;
+
+  /// Clip a triangle against the near plane and the guard band and add it.
+  void ClipTriangle (const csVector4& v0, const csVector4& v1,
+    const csVector4& v2, uint32 outcodes);
+  /// Set up a projected triangle and add it to the bins it overlaps.
+  void AddTriangle (const csVector4& v0, const csVector4& v1,
+    const csVector4& v2);
+  void RasterizeTriangleScalar (const Triangle& tri, int x0, int y0,
+    int x1, int y1);
+  void RasterizeTriangleSSE (const Triangle& tri, int x0, int y0,
+    int x1, int y1);
+  void UpdateTiles (int x0, int y0, int x1, int y1);
+};
+
+#endif // __CS_OCCLBUF_H__
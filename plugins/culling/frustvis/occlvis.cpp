@@ -0,0 +1,290 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csgeom/math3d.h"
+#include "csgeom/kdtree.h"
+#include "csutil/cfgacc.h"
+#include "csutil/flags.h"
+#include "iengine/camera.h"
+#include "iengine/mesh.h"
+#include "iengine/movable.h"
+#include "iengine/rview.h"
+#include "igeom/trimesh.h"
+#include "imesh/objmodel.h"
+#include "iutil/objreg.h"
+#include "ivideo/graph3d.h"
+#include "occlvis.h"
+
+SCF_IMPLEMENT_FACTORY (csOcclusionVis)
+
+//----------------------------------------------------------------------
+
+struct OcclTest_Front2BackData
+{
+  csVector3 pos;
+  csPlane3* frustum;
+  csBox3 kdtree_box;
+
+  // Occluder candidates are collected here in the first traversal.
+  csArray<csOcclusionVis::Occluder>* occluders;
+  float min_occluder_size;
+
+  // Used to test visibility in the second traversal.
+  const csOcclusionBuffer* buffer;
+  const csSet<csPtrKey<csFrustVisObjectWrapper> >* rasterized;
+  iVisibilityCullerListener* viscallback;
+};
+
+// Test a kd-tree node against the frustum. Returns false if invisible.
+static bool OcclTest_Node (csKDTree* treenode, OcclTest_Front2BackData* data,
+	uint32& frustum_mask, csBox3& node_bbox)
+{
+  node_bbox = treenode->GetNodeBBox ();
+  node_bbox *= data->kdtree_box;
+  if (node_bbox.Contains (data->pos))
+    return true;
+
+  uint32 new_mask;
+  if (!csIntersect3::BoxFrustum (node_bbox, data->frustum, frustum_mask,
+  	new_mask))
+    return false;
+  frustum_mask = new_mask;
+  return true;
+}
+
+static bool OcclCollect_Front2Back (csKDTree* treenode, void* userdata,
+	uint32 cur_timestamp, uint32& frustum_mask)
+{
+  OcclTest_Front2BackData* data = (OcclTest_Front2BackData*)userdata;
+
+  csBox3 node_bbox;
+  if (!OcclTest_Node (treenode, data, frustum_mask, node_bbox))
+    return false;
+
+  treenode->Distribute ();
+
+  int num_objects = treenode->GetObjectCount ();
+  csKDTreeChild** objects = treenode->GetObjects ();
+  for (int i = 0 ; i < num_objects ; i++)
+  {
+    if (objects[i]->timestamp == cur_timestamp) continue;
+    objects[i]->timestamp = cur_timestamp;
+    csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
+      objects[i]->GetObject ();
+
+    // Only opaque meshes writing the Z buffer hide what is behind them.
+    iMeshWrapper* mesh = visobj_wrap->mesh;
+    if (!mesh) continue;
+    if (mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH | CS_ENTITY_CAMERA))
+      continue;
+    if (mesh->GetZBufMode () != CS_ZBUF_USE) continue;
+    const csFlags& culler_flags = visobj_wrap->visobj->GetCullerFlags ();
+    if (culler_flags.Check (CS_CULLER_HINT_BADOCCLUDER)) continue;
+
+    const csBox3& obj_bbox = visobj_wrap->child->GetBBox ();
+    float score;
+    if (obj_bbox.Contains (data->pos))
+    {
+      score = 1.0f;
+    }
+    else
+    {
+      uint32 new_mask;
+      if (!csIntersect3::BoxFrustum (obj_bbox, data->frustum,
+		frustum_mask, new_mask))
+	continue;
+      float radius = 0.5f * (obj_bbox.Max () - obj_bbox.Min ()).Norm ();
+      float dist = (obj_bbox.GetCenter () - data->pos).Norm ();
+      score = (dist > radius) ? radius / dist : 1.0f;
+    }
+
+    if (culler_flags.Check (CS_CULLER_HINT_GOODOCCLUDER))
+      score += 1.0f;
+    else if (score < data->min_occluder_size)
+      continue;
+
+    csOcclusionVis::Occluder occluder;
+    occluder.obj = visobj_wrap;
+    occluder.score = score;
+    data->occluders->Push (occluder);
+  }
+
+  return true;
+}
+
+static bool OcclTest_Front2Back (csKDTree* treenode, void* userdata,
+	uint32 cur_timestamp, uint32& frustum_mask)
+{
+  OcclTest_Front2BackData* data = (OcclTest_Front2BackData*)userdata;
+
+  csBox3 node_bbox;
+  if (!OcclTest_Node (treenode, data, frustum_mask, node_bbox))
+    return false;
+  if (!node_bbox.Contains (data->pos) && !data->buffer->TestBox (node_bbox))
+    return false;
+
+  treenode->Distribute ();
+
+  int num_objects = treenode->GetObjectCount ();
+  csKDTreeChild** objects = treenode->GetObjects ();
+  for (int i = 0 ; i < num_objects ; i++)
+  {
+    if (objects[i]->timestamp == cur_timestamp) continue;
+    objects[i]->timestamp = cur_timestamp;
+    csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
+      objects[i]->GetObject ();
+    iMeshWrapper* mesh = visobj_wrap->mesh;
+    if (mesh && mesh->GetFlags ().Check (CS_ENTITY_INVISIBLEMESH))
+      continue;
+
+    const csBox3& obj_bbox = visobj_wrap->child->GetBBox ();
+    if (obj_bbox.Contains (data->pos))
+    {
+      data->viscallback->ObjectVisible (visobj_wrap->visobj, mesh,
+        frustum_mask);
+      continue;
+    }
+
+    uint32 new_mask;
+    if (!csIntersect3::BoxFrustum (obj_bbox, data->frustum,
+	      frustum_mask, new_mask))
+      continue;
+    /* Occluders are not tested against themselves: rounding could make
+       their surface appear slightly in front of their box. */
+    if (!data->rasterized->Contains (visobj_wrap)
+        && !data->buffer->TestBox (obj_bbox))
+      continue;
+
+    data->viscallback->ObjectVisible (visobj_wrap->visobj, mesh, new_mask);
+  }
+
+  return true;
+}
+
+static int CompareOccluders (csOcclusionVis::Occluder const& o1,
+	csOcclusionVis::Occluder const& o2)
+{
+  if (o1.score > o2.score) return -1;
+  if (o1.score < o2.score) return 1;
+  return 0;
+}
+
+//----------------------------------------------------------------------
+
+csOcclusionVis::csOcclusionVis (iBase *iParent) :
+  scfImplementationType (this, iParent),
+  maxOccluders (64), maxOccluderTriangles (20000), minOccluderSize (0.1f),
+  base_id (csInvalidStringID), viscull_id (csInvalidStringID)
+{
+}
+
+csOcclusionVis::~csOcclusionVis ()
+{
+}
+
+bool csOcclusionVis::Initialize (iObjectRegistry *object_reg)
+{
+  if (!csFrustumVis::Initialize (object_reg))
+    return false;
+
+  csRef<iStringSet> strset = csQueryRegistryTagInterface<iStringSet> (
+      object_reg, "crystalspace.shared.stringset");
+  base_id = strset->Request ("base");
+  viscull_id = strset->Request ("viscull");
+
+  csConfigAccess cfg (object_reg, "/config/occlvis.cfg");
+  buffer.SetResolution (cfg->GetInt ("Culling.Occlvis.Width", 320),
+    cfg->GetInt ("Culling.Occlvis.Height", 192));
+  buffer.SetSIMDEnabled (cfg->GetBool ("Culling.Occlvis.SIMD", true));
+  maxOccluders = csMax (cfg->GetInt ("Culling.Occlvis.MaxOccluders", 64), 0);
+  maxOccluderTriangles = csMax (cfg->GetInt (
+    "Culling.Occlvis.MaxOccluderTriangles", 20000), 0);
+  minOccluderSize = cfg->GetFloat ("Culling.Occlvis.MinOccluderSize", 0.1f);
+
+  return true;
+}
+
+void csOcclusionVis::RasterizeOccluders (iCamera* camera)
+{
+  buffer.Begin (camera->GetProjectionMatrix (),
+    CS::Math::Matrix4 (camera->GetTransform ()));
+  rasterized.DeleteAll ();
+
+  occluders.Sort (CompareOccluders);
+  size_t triangle_budget = maxOccluderTriangles;
+  for (size_t i = 0 ; i < occluders.GetSize () ; i++)
+  {
+    if (rasterized.GetSize () >= maxOccluders) break;
+
+    csFrustVisObjectWrapper* visobj_wrap = occluders[i].obj;
+    iVisibilityObject* visobj = visobj_wrap->visobj;
+    iObjectModel* model = visobj->GetObjectModel ();
+    iTriangleMesh* trimesh = model->IsTriangleDataSet (viscull_id)
+      ? model->GetTriangleData (viscull_id)
+      : model->GetTriangleData (base_id);
+    if (!trimesh) continue;
+    size_t num_tris = trimesh->GetTriangleCount ();
+    if ((num_tris == 0) || (num_tris > triangle_budget)) continue;
+    triangle_budget -= num_tris;
+
+    csReversibleTransform trans = visobj->GetMovable ()->GetFullTransform ();
+    buffer.AddOccluder (CS::Math::Matrix4 (trans.GetInverse ()),
+      trimesh->GetVertices (), trimesh->GetVertexCount (),
+      trimesh->GetTriangles (), num_tris);
+    rasterized.Add (visobj_wrap);
+  }
+
+  // The frustum culler's job queue is idle at this point
+  iJobQueue* rasterizeQueue = GetJobQueue ();
+  buffer.Rasterize (rasterizeQueue, numWorkers);
+}
+
+bool csOcclusionVis::VisTest (iRenderView* rview,
+                              iVisibilityCullerListener* viscallback, int, int)
+{
+  UpdateObjects ();
+  current_vistest_nr++;
+
+  // just make sure we have a callback
+  if (viscallback == 0)
+    return false;
+
+  csRenderContext* ctxt = rview->GetRenderContext ();
+  iCamera* camera = rview->GetCamera ();
+
+  OcclTest_Front2BackData data;
+  data.pos = camera->GetTransform ().GetOrigin ();
+  data.frustum = ctxt->clip_planes;
+  data.kdtree_box = kdtree_box;
+  data.occluders = &occluders;
+  data.min_occluder_size = minOccluderSize;
+  data.buffer = &buffer;
+  data.rasterized = &rasterized;
+  data.viscallback = viscallback;
+
+  // Pick and rasterize the occluders, then cull against them.
+  occluders.Empty ();
+  kdtree->Front2Back (data.pos, OcclCollect_Front2Back, (void*)&data,
+    ctxt->clip_planes_mask);
+  RasterizeOccluders (camera);
+  kdtree->Front2Back (data.pos, OcclTest_Front2Back, (void*)&data,
+    ctxt->clip_planes_mask);
+
+  return true;
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright (C) 2026 by Crystal Space Development Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_OCCLVIS_H__
+#define __CS_OCCLVIS_H__
+
+#include "iutil/strset.h"
+#include "frustvis.h"
+#include "occlbuf.h"
+
+struct iCamera;
+
+/**
+ * A frustum culler that additionally culls objects hidden behind other
+ * objects. It works entirely on the CPU, so it can be used without a
+ * renderer.
+ *
+ * Every VisTest() first picks the occluders among the objects in the view
+ * frustum: objects flagged with #CS_CULLER_HINT_GOODOCCLUDER and objects
+ * that appear large from the camera, unless they are flagged with
+ * #CS_CULLER_HINT_BADOCCLUDER. Their triangles ("viscull" triangle data if
+ * present, "base" otherwise) are rasterized into a low resolution depth
+ * buffer (see csOcclusionBuffer). The kd-tree of the frustum culler is then
+ * traversed front to back and nodes and objects whose boxes are hidden
+ * behind the depth buffer are culled.
+ */
+class csOcclusionVis :
+  public scfImplementationExt0<csOcclusionVis, csFrustumVis>
+{
+public:
+  /// An occluder candidate found in the view frustum.
+  struct Occluder
+  {
+    csFrustVisObjectWrapper* obj;
+    /// How much of the view the object covers (approximately)
+    float score;
+  };
+
+private:
+  csOcclusionBuffer buffer;
+
+  size_t maxOccluders;
+  size_t maxOccluderTriangles;
+  float minOccluderSize;
+  csStringID base_id;
+  csStringID viscull_id;
+
+  csArray<Occluder> occluders;
+  // The occluders rasterized in the current VisTest().
+  csSet<csPtrKey<csFrustVisObjectWrapper> > rasterized;
+
+  // Rasterize the best occluder candidates.
+  void RasterizeOccluders (iCamera* camera);
+
+public:
+  csOcclusionVis (iBase *iParent);
+  virtual ~csOcclusionVis ();
+  virtual bool Initialize (iObjectRegistry *object_reg);
+
+  using csFrustumVis::VisTest;
+  virtual bool VisTest (iRenderView* rview,
+    iVisibilityCullerListener* viscallback, int w = 0, int h = 0);
+
+  CS_EVENTHANDLER_NAMES("crystalspace.occlvis")
+};
+
+#endif // __CS_OCCLVIS_H__
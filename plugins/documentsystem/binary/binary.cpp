@@ -23,6 +23,8 @@
 #include "csutil/scf.h"
 #include "iutil/document.h"
 #include "iutil/databuff.h"
+#include "iutil/objreg.h"
+#include "iutil/vfs.h"
 
 #include "binary.h"
 #include "bindoc.h"
@@ -41,11 +43,13 @@ csBinaryDocumentSystem::~csBinaryDocumentSystem ()
 
 csRef<iDocument> csBinaryDocumentSystem::CreateDocument ()
 {
-  return csPtr<iDocument> (new csBinaryDocument);
+  csRef<iVFS> fileSystem (vfs);
+  return csPtr<iDocument> (new csBinaryDocument (fileSystem));
 }
 
-bool csBinaryDocumentSystem::Initialize (iObjectRegistry* /*objreg*/)
+bool csBinaryDocumentSystem::Initialize (iObjectRegistry* objreg)
 {
+  vfs = csQueryRegistry<iVFS> (objreg);
   return true;
 }
 
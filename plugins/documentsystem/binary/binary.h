@@ -23,8 +23,10 @@
 #include "iutil/comp.h"
 #include "iutil/document.h"
 #include "csutil/scf_implementation.h"
+#include "csutil/weakref.h"
 
 struct iObjectRegistry;
+struct iVFS;
 
 CS_PLUGIN_NAMESPACE_BEGIN(BinDoc)
 {
@@ -34,6 +36,8 @@ class csBinaryDocumentSystem :
                             iDocumentSystem, 
                             iComponent>
 {
+  /// Passed to documents to map files into memory.
+  csWeakRef<iVFS> vfs;
 public:
   csBinaryDocumentSystem (iBase* parent = 0);
   virtual ~csBinaryDocumentSystem ();
@@ -23,6 +23,7 @@
 #include "csutil/csstring.h"
 #include "csutil/databuf.h"
 #include "csutil/memfile.h"
+#include "csutil/mmapio.h"
 #include "csutil/snprintf.h"
 #include "csutil/sysfunc.h"
 #include "csutil/util.h"
@@ -41,8 +42,15 @@ CS_PLUGIN_NAMESPACE_BEGIN(BinDoc)
 //  csBinaryDocAttributeIterator
 // =================================================
 
+void csBinaryDocAttributeIterator::DecRef ()
+{
+  // Keep the doc, which owns the iterator pool, alive while we're freed
+  csRef<csBinaryDocument> tmp (parentNode->doc);
+  scfPooledImplementationType::DecRef();
+}
+
 csBinaryDocAttributeIterator::csBinaryDocAttributeIterator () :
-  scfImplementationType (this)
+  scfPooledImplementationType (this)
 {
 }
 
@@ -154,14 +162,13 @@ const char* csBdAttr::GetValueStr (csBinaryDocument* doc) const
 csBinaryDocAttribute::csBinaryDocAttribute (csBdAttr* ptr,
 				            csBinaryDocNode* owner) :
   scfPooledImplementationType (this), node (owner), attrPtr (ptr),
-  vstr (0), vsptr (0)
+  vsptr (0)
 {
 }
 
 csBinaryDocAttribute::~csBinaryDocAttribute ()
 {
   CleanData ();
-  cs_free (vstr); 
 }
 
 void csBinaryDocAttribute::CleanData ()
@@ -186,11 +193,8 @@ const char* csBinaryDocAttribute::GetValue ()
       {
 	if (vsptr != attrPtr)
 	{
-  	  char buf[50];
-	  cs_snprintf (buf, sizeof (buf) - 1, "%" PRId32, 
+	  cs_snprintf (vstr, sizeof (vstr), "%" PRId32, 
 	    (int32)csLittleEndian::UInt32 (attrPtr->value));
-	  cs_free (vstr); 
-	  vstr = CS::StrDup (buf);
 	  vsptr = attrPtr;
 	}
 	return vstr;
@@ -199,11 +203,8 @@ const char* csBinaryDocAttribute::GetValue ()
       {
 	if (vsptr != attrPtr)
 	{
-  	  char buf[50];
-	  cs_snprintf (buf, sizeof (buf) - 1,
+	  cs_snprintf (vstr, sizeof (vstr),
 	    "%g", node->doc->ConvertToFloat (csLittleEndian::UInt32 (attrPtr->value)));
-	  cs_free (vstr); 
-	  vstr = CS::StrDup (buf);
 	  vsptr = attrPtr;
 	}
 	return vstr;
@@ -313,8 +314,11 @@ static inline bool checkInt (const char* str, int &v)
     if (!(isdigit (*c)) && (*c != '-')) return false;
     c++;
   }
-  sscanf (str, "%d", &v);
-  return true;
+  if (sscanf (str, "%d", &v) != 1) return false;
+  // Only store a number if it reads back as the same string
+  char buf[16];
+  cs_snprintf (buf, sizeof (buf), "%d", v);
+  return strcmp (buf, str) == 0;
 }
 
 static inline bool checkFloat (const char* str, float &v)
@@ -330,7 +334,11 @@ static inline bool checkFloat (const char* str, float &v)
   }
   char dummy;
   int ret = sscanf (str, "%g%c", &v, &dummy);
-  return (ret == 1);
+  if (ret != 1) return false;
+  // Only store a number if it reads back as the same string
+  char buf[32];
+  cs_snprintf (buf, sizeof (buf), "%g", v);
+  return strcmp (buf, str) == 0;
 }
 
 void csBinaryDocAttribute::SetValue (const char* val)
@@ -338,7 +346,7 @@ void csBinaryDocAttribute::SetValue (const char* val)
   if (attrPtr->flags & BD_NODE_MODIFIED)
   {
     cs_free (attrPtr->vstr); attrPtr->vstr = 0;
-    cs_free (vstr); vstr = 0;
+    vsptr = 0;
     int v;
     float f;
     if (val == 0) val = ""; 
@@ -369,7 +377,7 @@ void csBinaryDocAttribute::SetValueAsInt (int v)
   if (attrPtr->flags & BD_NODE_MODIFIED)
   {
     cs_free (attrPtr->vstr); attrPtr->vstr = 0;
-    cs_free (vstr); vstr = 0;
+    vsptr = 0;
     attrPtr->flags = (attrPtr->flags & ~BD_VALUE_TYPE_MASK) | 
       BD_VALUE_TYPE_INT;
     attrPtr->value = csLittleEndian::UInt32 ((long)v);
@@ -381,7 +389,7 @@ void csBinaryDocAttribute::SetValueAsFloat (float f)
   if (attrPtr->flags & BD_NODE_MODIFIED)
   {
     cs_free (attrPtr->vstr); attrPtr->vstr = 0;
-    cs_free (vstr); vstr = 0;
+    vsptr = 0;
     attrPtr->flags = (attrPtr->flags & ~BD_VALUE_TYPE_MASK) | 
       BD_VALUE_TYPE_FLOAT;
     attrPtr->value = csLittleEndian::UInt32 (csIEEEfloat::FromNative (f));
@@ -447,9 +455,22 @@ void csBinaryDocAttribute::Store (csMemFile* nodesFile)
 //  csBinaryDocNodeIterator
 // =================================================
 
+void csBinaryDocNodeIterator::DecRef ()
+{
+  // Keep the doc, which owns the iterator pool, alive while we're freed
+  csRef<csBinaryDocument> tmp (parentNode->doc);
+  scfPooledImplementationType::DecRef();
+}
+
 csBinaryDocNodeIterator::csBinaryDocNodeIterator () :
-  scfImplementationType (this), value (0)
+  scfPooledImplementationType (this), value (0)
+{
+}
+
+void csBinaryDocNodeIterator::FreeValue ()
 {
+  if (value != valueBuf) cs_free (value);
+  value = 0;
 }
 
 void csBinaryDocNodeIterator::SetTo (csBdNode* node,
@@ -458,14 +479,17 @@ void csBinaryDocNodeIterator::SetTo (csBdNode* node,
 {
   parentNode = parent; 
   pos = 0;
-  cs_free (value);
+  FreeValue ();
   if (onlyval) 
   {
-    value = CS::StrDup (onlyval);
-  }
-  else
-  {
-    value = 0;
+    size_t len = strlen (onlyval) + 1;
+    if (len <= sizeof (valueBuf))
+    {
+      memcpy (valueBuf, onlyval, len);
+      value = valueBuf;
+    }
+    else
+      value = CS::StrDup (onlyval);
   }
   if (!(node->flags & BD_NODE_HAS_CHILDREN))
   {
@@ -480,7 +504,7 @@ void csBinaryDocNodeIterator::SetTo (csBdNode* node,
 
 csBinaryDocNodeIterator::~csBinaryDocNodeIterator ()
 {
-  cs_free (value);
+  FreeValue ();
 }
 
 void csBinaryDocNodeIterator::FastForward()
@@ -768,14 +792,13 @@ csBinaryDocNode::csBinaryDocNode (csBdNode* ptr,
 			          csBinaryDocNode* parent)
   : scfPooledImplementationType (this),
     nodeData (ptr), 
-    vstr (0), vsptr (0), Parent (parent)
+    vsptr (0), Parent (parent)
 {
 }
 
 csBinaryDocNode::~csBinaryDocNode ()
 {
   CleanData();
-  cs_free (vstr);
 }
 
 csDocumentNodeType csBinaryDocNode::GetType ()
@@ -818,11 +841,8 @@ const char* csBinaryDocNode::nodeValueStr (csBdNode* nodeData)
       {
 	if (vsptr != nodeData)
 	{
-  	  char buf[50];
-	  cs_snprintf (buf, sizeof (buf) - 1, "%" PRId32, 
+	  cs_snprintf (vstr, sizeof (vstr), "%" PRId32, 
 	    (int32)csLittleEndian::UInt32 (nodeData->value));
-	  cs_free (vstr); 
-	  vstr = CS::StrDup (buf);
 	  vsptr = nodeData;
 	}
 	return vstr;
@@ -831,11 +851,8 @@ const char* csBinaryDocNode::nodeValueStr (csBdNode* nodeData)
       {
 	if (vsptr != nodeData)
 	{
-  	  char buf[50];
-	  cs_snprintf (buf, sizeof (buf) - 1, "%g", 
+	  cs_snprintf (vstr, sizeof (vstr), "%g", 
 	    doc->ConvertToFloat (csLittleEndian::UInt32 (nodeData->value)));
-	  cs_free (vstr);
-	  vstr = CS::StrDup (buf);
 	  vsptr = nodeData;
 	}
 	return vstr;
@@ -1000,7 +1017,7 @@ void csBinaryDocNode::SetValue (const char* value)
 {
   if (nodeData->flags & BD_NODE_MODIFIED)
   {
-    cs_free (vstr); vstr = 0;
+    vsptr = 0;
     cs_free (nodeData->vstr); nodeData->vstr = 0;
     int v;
     float f;
@@ -1031,7 +1048,7 @@ void csBinaryDocNode::SetValueAsInt (int value)
 {
   if (nodeData->flags & BD_NODE_MODIFIED)
   {
-    cs_free (vstr); vstr = 0;
+    vsptr = 0;
     nodeData->flags = (nodeData->flags & ~BD_VALUE_TYPE_MASK) |
       BD_VALUE_TYPE_INT;
     nodeData->value = csLittleEndian::UInt32 ((int32)value);
@@ -1042,7 +1059,7 @@ void csBinaryDocNode::SetValueAsFloat (float value)
 {
   if (nodeData->flags & BD_NODE_MODIFIED)
   {
-    cs_free (vstr); vstr = 0;
+    vsptr = 0;
     nodeData->flags = (nodeData->flags & ~BD_VALUE_TYPE_MASK) | 
       BD_VALUE_TYPE_FLOAT;
     nodeData->value = csLittleEndian::UInt32 (csIEEEfloat::FromNative (value));
@@ -1056,14 +1073,14 @@ csRef<iDocumentNode> csBinaryDocNode::GetParent ()
 
 csRef<iDocumentNodeIterator> csBinaryDocNode::GetNodes ()
 {
-  csBinaryDocNodeIterator* it = new csBinaryDocNodeIterator ();
+  csBinaryDocNodeIterator* it = doc->GetPoolNodeIterator ();
   it->SetTo (nodeData, this);
   return csPtr<iDocumentNodeIterator> (it);
 }
 
 csRef<iDocumentNodeIterator> csBinaryDocNode::GetNodes (const char* value)
 {
-  csBinaryDocNodeIterator* it = new csBinaryDocNodeIterator ();
+  csBinaryDocNodeIterator* it = doc->GetPoolNodeIterator ();
   it->SetTo (nodeData, this, value);
   return csPtr<iDocumentNodeIterator> (it);
 }
@@ -1228,7 +1245,7 @@ float csBinaryDocNode::GetContentsValueAsFloat ()
 
 csRef<iDocumentAttributeIterator> csBinaryDocNode::GetAttributes ()
 {
-  csBinaryDocAttributeIterator* it = new csBinaryDocAttributeIterator ();
+  csBinaryDocAttributeIterator* it = doc->GetPoolAttrIterator ();
   it->SetTo (nodeData, this);
   return csPtr<iDocumentAttributeIterator> (it);
 }
@@ -1505,13 +1522,30 @@ void csBinaryDocNode::Store (csMemFile* nodesFile)
   }
 }
 
+// =================================================
+//  csBdMappedDataBuffer
+// =================================================
+
+/// Data buffer for a document file mapped into memory.
+class csBdMappedDataBuffer :
+  public scfImplementation1<csBdMappedDataBuffer, iDataBuffer>
+{
+  csRef<csMemoryMapping> mapping;
+public:
+  csBdMappedDataBuffer (csMemoryMapping* mapping) :
+    scfImplementationType (this), mapping (mapping) {}
+
+  virtual size_t GetSize () const { return mapping->GetLength(); }
+  virtual char* GetData () const { return (char*)mapping->GetData(); }
+};
+
 // =================================================
 //  csBinaryDocument
 // =================================================
 
-csBinaryDocument::csBinaryDocument () : scfImplementationType (this),
-  oldStyleFloats (false), root (0), attrAlloc (2000), nodeAlloc (2000),
-  outStrHash (0)
+csBinaryDocument::csBinaryDocument (iVFS* vfs) : scfImplementationType (this),
+  oldStyleFloats (false), root (0), vfs (vfs), attrAlloc (2000),
+  nodeAlloc (2000), outStrHash (0)
 {
 }
 
@@ -1557,6 +1591,16 @@ csBinaryDocAttribute* csBinaryDocument::GetPoolAttr (csBdAttr* ptr,
   return new (attrPool) csBinaryDocAttribute (ptr, owner);
 }
 
+csBinaryDocNodeIterator* csBinaryDocument::GetPoolNodeIterator ()
+{
+  return new (nodeIteratorPool) csBinaryDocNodeIterator ();
+}
+
+csBinaryDocAttributeIterator* csBinaryDocument::GetPoolAttrIterator ()
+{
+  return new (attrIteratorPool) csBinaryDocAttributeIterator ();
+}
+
 #include "csutil/custom_new_enable.h"
 
 csBinaryDocNode* csBinaryDocument::GetRootNode ()
@@ -1619,8 +1663,41 @@ csRef<iDocumentNode> csBinaryDocument::GetRoot ()
 
 const char* csBinaryDocument::Parse (iFile* file, bool collapse)
 {
-  csRef<iDataBuffer> newBuffer = csPtr<iDataBuffer> 
-    (file->GetAllData());
+  /* Look at the header first so files of other formats (which are handed
+     to us e.g. by the document system multiplexer) aren't read or mapped
+     in vain. */
+  size_t oldpos = file->GetPos ();
+  bdHeader head;
+  size_t headSize = file->Read ((char*)&head, sizeof (head));
+  file->SetPos (oldpos);
+  if (headSize < sizeof (head))
+    return "Not enough data";
+  if ((head.magic != (uint32)BD_HEADER_MAGIC)
+      && (head.magic != (uint32)BD_HEADER_MAGIC_OLDFLOAT))
+    return "Not a binary CS document";
+
+  /* Binary documents are used in place, so map the file into memory:
+     nothing has to be read or copied and untouched parts of the file are
+     never paged in. VFS only maps large files by itself. Files that can't
+     be mapped (e.g. those in archives) are read as usual. */
+  csRef<iDataBuffer> newBuffer;
+  csRef<iVFS> fileSystem (vfs);
+  const char* name = file->GetName ();
+  size_t size = file->GetSize ();
+  if (fileSystem && name && (size == csLittleEndian::UInt32 (head.size)))
+  {
+    csMemoryMappedIO mmio (name, fileSystem);
+    if (mmio.IsValid ())
+    {
+      csRef<csMemoryMapping> mapping (mmio.GetData (0, size));
+      if (mapping.IsValid () && (mapping->GetLength () == size))
+        newBuffer.AttachNew (new csBdMappedDataBuffer (mapping));
+    }
+  }
+  if (!newBuffer.IsValid ())
+    newBuffer = csPtr<iDataBuffer> (file->GetAllData());
+  if (!newBuffer.IsValid ())
+    return "Could not read data";
   return Parse (newBuffer, collapse);
 }
 
@@ -26,6 +26,8 @@
 #include "csutil/parray.h"
 #include "csutil/pooledscfclass.h"
 #include "csutil/strset.h"
+#include "csutil/weakref.h"
+#include "iutil/vfs.h"
 
 struct iDataBuffer;
 class csMemFile;
@@ -257,8 +259,11 @@ struct csBdNode;
 struct csBdAttr;
 
 struct csBinaryDocAttributeIterator : 
-  public scfImplementation1<csBinaryDocAttributeIterator, 
-                            iDocumentAttributeIterator>
+  public scfImplementationPooled<scfImplementation1<
+                                   csBinaryDocAttributeIterator, 
+                                   iDocumentAttributeIterator>,
+                                 CS::Memory::AllocatorMalloc,
+                                 true>
 {
 private:
   friend struct csBinaryDocument;
@@ -270,9 +275,11 @@ private:
   /// The node whose attributes we're iterating.
   csBdNode* iteratedNode;
   /// Owning node.
-  csBinaryDocNode* parentNode;
+  csRef<csBinaryDocNode> parentNode;
 
 public:
+  void DecRef ();
+
   csBinaryDocAttributeIterator ();
   virtual ~csBinaryDocAttributeIterator();
   void SetTo (csBdNode* node,
@@ -331,7 +338,7 @@ private:
   /// Pointer to data
   csBdAttr* attrPtr;
   /// buffer for int/float values requested as strings
-  char* vstr;
+  char vstr[24];
   /// attrPtr for which vstr is valid
   csBdAttr* vsptr;
 
@@ -356,8 +363,10 @@ public:
 };
 
 struct csBinaryDocNodeIterator : 
-  public scfImplementation1<csBinaryDocNodeIterator,
-                            iDocumentNodeIterator>
+  public scfImplementationPooled<scfImplementation1<csBinaryDocNodeIterator,
+                                                    iDocumentNodeIterator>,
+                                 CS::Memory::AllocatorMalloc,
+                                 true>
 {
 private:
   friend struct csBinaryDocument;
@@ -370,12 +379,21 @@ private:
   uint pos;
   /// Only iterate through nodes w/ this name
   char* value;
+  /**
+   * Storage for 'value' if it is short enough, which is the case for
+   * almost all element names. Saves a heap allocation per iterator.
+   */
+  char valueBuf[32];
   /// Node whose childen we're iterating.
   csBdNode* iteratedNode;
 
   /// Skip to next node with value 'value'.
   void FastForward();
+  /// Release 'value' if it was allocated on the heap.
+  void FreeValue ();
 public:
+  void DecRef ();
+
   csBinaryDocNodeIterator ();
   virtual ~csBinaryDocNodeIterator ();
   void SetTo (csBdNode* node,
@@ -462,7 +480,7 @@ private:
   csBdNode* nodeData;
   csRef<csBinaryDocument> doc;
   /// buffer for int/float values requested as strings
-  char* vstr;
+  char vstr[24];
   /// nodeData for which vstr is valid
   csBdNode* vsptr;
   csRef<csBinaryDocNode> Parent;
@@ -540,6 +558,10 @@ private:
   csBdNode* root;	
   csBinaryDocNode::Pool nodePool;
   csBinaryDocAttribute::Pool attrPool;
+  csBinaryDocNodeIterator::Pool nodeIteratorPool;
+  csBinaryDocAttributeIterator::Pool attrIteratorPool;
+  /// To map files to memory in Parse (iFile*).
+  csWeakRef<iVFS> vfs;
 
   CS::Memory::BlockAllocatorSafe<csBdAttr> attrAlloc;
   CS::Memory::BlockAllocatorSafe<csBdNode> nodeAlloc;
@@ -553,10 +575,12 @@ private:
     csBinaryDocNode* parent);
   csBinaryDocAttribute* GetPoolAttr (csBdAttr* ptr,
     csBinaryDocNode* owner);
+  csBinaryDocNodeIterator* GetPoolNodeIterator ();
+  csBinaryDocAttributeIterator* GetPoolAttrIterator ();
 
   csBinaryDocNode* GetRootNode ();
 public:
-  csBinaryDocument ();
+  csBinaryDocument (iVFS* vfs = 0);
   virtual ~csBinaryDocument ();
 
   csBdAttr* AllocBdAttr ();
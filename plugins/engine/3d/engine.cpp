@@ -59,6 +59,7 @@
 #include "iutil/selfdestruct.h"
 #include "ivaria/engseq.h"
 #include "ivaria/pmeter.h"
+#include "ivaria/profile.h"
 #include "ivaria/reporter.h"
 #include "ivideo/graph3d.h"
 #include "ivideo/halo.h"
@@ -81,6 +82,10 @@
 
 using namespace CS_PLUGIN_NAMESPACE_NAME(Engine);
 
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(csEngine_ControlMeshes)
+CS_DECLARE_PROFILER_ZONE(csEngine_FireStartFrame)
+CS_DECLARE_PROFILER_ZONE(csEngine_PrecacheDraw)
 
 
 bool csEngine::doVerbose = false;
@@ -623,7 +628,7 @@ bool csEngine::Initialize (iObjectRegistry *objectRegistry)
   csConfigAccess cfg (objectRegistry, "/config/engine.cfg");
   ReadConfig (cfg);
 
-  csLightManager* light_mgr = new csLightManager ();
+  csLightManager* light_mgr = new csLightManager (this);
   objectRegistry->Register (light_mgr, "iLightManager");
   light_mgr->DecRef ();
 
@@ -1110,6 +1115,7 @@ void csEngine::PrecacheMesh (iMeshWrapper* s, iRenderView* rview)
 
 void csEngine::PrecacheDraw (iCollection* collection)
 {
+  CS_PROFILER_ZONE(csEngine_PrecacheDraw)
   currentFrameNumber++;
 
   csRef<iCamera> c = CreateCamera ();
@@ -1311,6 +1317,7 @@ iLight *csEngine::FindLight (const char *name, bool regionOnly) const
 
 void csEngine::ControlMeshes ()
 {
+  CS_PROFILER_ZONE(csEngine_ControlMeshes)
   nextframePending = virtualClock->GetCurrentTicks ();
 
   // Delete particle systems that self-destructed now.
@@ -2360,6 +2367,7 @@ void csEngine::RemoveEngineFrameCallback (iEngineFrameCallback* cb)
 
 void csEngine::FireStartFrame (iRenderView* rview)
 {
+  CS_PROFILER_ZONE(csEngine_FireStartFrame)
   size_t i = frameCallbacks.GetSize ();
   while (i > 0)
   {
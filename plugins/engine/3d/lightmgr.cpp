@@ -17,12 +17,14 @@
 */
 
 #include "cssysdef.h"
+#include "plugins/engine/3d/engine.h"
 #include "plugins/engine/3d/light.h"
 #include "plugins/engine/3d/lightmgr.h"
 #include "plugins/engine/3d/meshobj.h"
 #include "plugins/engine/3d/sector.h"
 
 #include "csgeom/sphere.h"
+#include "iutil/verbositymanager.h"
 
 using namespace CS_PLUGIN_NAMESPACE_NAME(Engine);
 
@@ -53,9 +55,17 @@ static csLightInfluence MakeInfluence (csLight* light,
 
 // ---------------------------------------------------------------------------
 
-csLightManager::csLightManager ()
-  : scfImplementationType (this), tempInfluencesUsed (false)
+csLightManager::csLightManager (csEngine* engine)
+  : scfImplementationType (this), tempInfluencesUsed (false), engine (engine),
+    lightSphereArena (16*1024), lightSphereSlots (0),
+    lightSphereSlotsNum (0), lightSphereCount (0),
+    lightSphereCacheFrame ((uint)~0)
 {
+  // Only on explicit request, as a report is made for every frame
+  csRef<iVerbosityManager> verbosity =
+    csQueryRegistry<iVerbosityManager> (engine->GetObjectRegistry ());
+  reportArena = verbosity
+    && verbosity->Enabled ("engine.lightmanager.arena", false);
 }
 
 csLightManager::~csLightManager ()
@@ -516,3 +526,217 @@ void csLightManager::GetRelevantLightsSorted (iSector* sector,
   // return only first numLights lights
   numLights = csMin (numLights, maxLights);
 }
+
+// ---------------------------------------------------------------------------
+
+const csLightManager::CachedLightSphere& csLightManager::GetCachedLightSphere (
+  csLight* light)
+{
+  const uint frame = engine->GetCurrentFrameNumber ();
+  if (frame != lightSphereCacheFrame)
+  {
+    /* Drop all spheres at once. After the first frames the arena has a
+       single block big enough for a whole frame, so no heap allocations
+       are made for the cache any more. */
+    lightSphereArena.Reset ();
+    if (reportArena && (lightSphereCacheFrame != (uint)~0))
+      engine->Report ("Light sphere cache of frame %u used %zu bytes of "
+        "arena memory (peak %zu)", lightSphereCacheFrame,
+        lightSphereArena.GetLastUsedBytes (),
+        lightSphereArena.GetPeakUsedBytes ());
+    lightSphereSlots = 0;
+    lightSphereSlotsNum = 0;
+    lightSphereCount = 0;
+    lightSphereCacheFrame = frame;
+  }
+
+  iMovable* movable = light->GetMovable ();
+  const long updateNumber = movable->GetUpdateNumber ();
+  const float radius = light->GetCutoffDistance ();
+  if ((lightSphereCount + 1) * 2 > lightSphereSlotsNum)
+    GrowLightSphereSlots ();
+  CachedLightSphere** slot = GetLightSphereSlot (light);
+  CachedLightSphere* cached = *slot;
+  if (cached && (cached->updateNumber == updateNumber)
+      && (cached->radius == radius))
+    return *cached;
+
+  if (!cached)
+  {
+    // Spheres are never destroyed, they only hold plain data
+#include "csutil/custom_new_disable.h"
+    cached = new (lightSphereArena.Alloc (sizeof (CachedLightSphere)))
+      CachedLightSphere;
+#include "csutil/custom_new_enable.h"
+    *slot = cached;
+    lightSphereCount++;
+  }
+  cached->light = light;
+  cached->center = movable->GetFullPosition ();
+  cached->radius = radius;
+  cached->worldBox.Set (cached->center - csVector3 (radius),
+    cached->center + csVector3 (radius));
+  cached->lightType = LightExtraAABBNodeData::GetLightType (light);
+  cached->updateNumber = updateNumber;
+  return *cached;
+}
+
+csLightManager::CachedLightSphere** csLightManager::GetLightSphereSlot (
+  csLight* light)
+{
+  const size_t mask = lightSphereSlotsNum - 1;
+  // Scramble the bits of the (aligned) pointer
+  size_t slot = size_t ((uintptr_t (light) >> 4) * 2654435761u) & mask;
+  while (lightSphereSlots[slot] && (lightSphereSlots[slot]->light != light))
+    slot = (slot + 1) & mask;
+  return lightSphereSlots + slot;
+}
+
+void csLightManager::GrowLightSphereSlots ()
+{
+  CachedLightSphere** oldSlots = lightSphereSlots;
+  const size_t oldSlotsNum = lightSphereSlotsNum;
+
+  lightSphereSlotsNum = csMax (oldSlotsNum * 2, size_t (64));
+  lightSphereSlots = static_cast<CachedLightSphere**> (
+    lightSphereArena.Alloc (lightSphereSlotsNum * sizeof (CachedLightSphere*)));
+  memset (lightSphereSlots, 0,
+    lightSphereSlotsNum * sizeof (CachedLightSphere*));
+  // The old table stays in the arena until the next frame
+  for (size_t i = 0; i < oldSlotsNum; i++)
+  {
+    if (oldSlots[i])
+      *GetLightSphereSlot (oldSlots[i]->light) = oldSlots[i];
+  }
+}
+
+struct LightCollectBatchCandidates
+{
+  LightCollectBatchCandidates (csLightManager& lightMgr,
+    const csBox3& boxWorld, uint lightFilter)
+    : lightMgr (lightMgr), testBoxWorld (boxWorld), lightFilter (lightFilter)
+  {}
+
+  bool operator() (const csSectorLightList::LightAABBTree::Node* node)
+  {
+    if ((node->lightTypes & lightFilter) == 0)
+      return true;
+  
+    if (!testBoxWorld.TestIntersect (node->GetBBox ()))
+      return true;
+
+    for (size_t i = 0; i < node->GetObjectCount (); ++i)
+    {
+      lightMgr.batchCandidates.Push (
+        lightMgr.GetCachedLightSphere (node->GetLeafData (i)));
+    }
+    return true;
+  }
+
+  csLightManager& lightMgr;
+  const csBox3& testBoxWorld;
+  uint lightFilter;
+};
+
+static uint GetLightFilter (uint flags)
+{
+  uint lightFilter = 0;
+  if (flags & CS_LIGHTQUERY_GET_TYPE_STATIC)
+    lightFilter |= LightExtraAABBNodeData::ltStatic;
+  if (flags & CS_LIGHTQUERY_GET_TYPE_DYNAMIC)
+    lightFilter |= LightExtraAABBNodeData::ltDynamic;
+  return lightFilter;
+}
+
+size_t csLightManager::GetRelevantLightsBatch (iSector* sector,
+                                               csLightBatchQuery* queries,
+                                               size_t numQueries,
+                                               csLightInfluence* influences,
+                                               size_t maxInfluences,
+                                               size_t maxLights,
+                                               bool sorted)
+{
+  iLightList* llist = sector->GetLights ();
+  csSectorLightList* sectorLightList = static_cast<csSectorLightList*> (llist);
+
+  /* Collect the lights touching any of the boxes with one traversal of the
+   * light tree. The world space boxes are kept around for the per-box tests
+   * below. */
+  batchBoxesWorld.SetSize (numQueries);
+  csBox3* boxesWorld = batchBoxesWorld.GetArray ();
+  csBox3 allBoxesWorld;
+  uint allLightFilter = 0;
+  for (size_t q = 0; q < numQueries; q++)
+  {
+    const csLightBatchQuery& query = queries[q];
+    if (!query.bboxToWorld || query.bboxToWorld->IsIdentity())
+      boxesWorld[q] = *query.boundingBox;
+    else
+      boxesWorld[q] = query.bboxToWorld->This2Other (*query.boundingBox);
+    allBoxesWorld += boxesWorld[q];
+    allLightFilter |= GetLightFilter (query.flags);
+  }
+
+  //@@TODO: Implement cross-sector lookups
+  batchCandidates.Empty ();
+  if (allLightFilter != 0)
+  {
+    const csSectorLightList::LightAABBTree& aabbTree =
+      sectorLightList->GetLightAABBTree ();
+    IntersectInnerBBoxAndLightFilter inner (allBoxesWorld, allLightFilter);
+    LightCollectBatchCandidates leaf (*this, allBoxesWorld, allLightFilter);
+    aabbTree.Traverse (inner, leaf);
+  }
+
+  // Now match each box against the lights found
+  size_t numInfluences = 0;
+  size_t neededInfluences = 0;
+  for (size_t q = 0; q < numQueries; q++)
+  {
+    csLightBatchQuery& query = queries[q];
+    const csBox3& box = *query.boundingBox;
+    const csBox3& boxWorld = boxesWorld[q];
+    const csReversibleTransform* bboxToWorld =
+      (query.bboxToWorld && !query.bboxToWorld->IsIdentity())
+        ? query.bboxToWorld : 0;
+    const uint lightFilter = GetLightFilter (query.flags);
+    const size_t queryMax = sorted ? (size_t)~0 : maxLights;
+
+    size_t found = 0;
+    for (size_t c = 0; (c < batchCandidates.GetSize ()) && (found < queryMax);
+         c++)
+    {
+      const CachedLightSphere& candidate = batchCandidates[c];
+      if ((candidate.lightType & lightFilter) == 0)
+        continue;
+      if (!boxWorld.TestIntersect (candidate.worldBox))
+        continue;
+
+      csSphere lightSphere (candidate.center, candidate.radius);
+      if (bboxToWorld)
+        lightSphere = bboxToWorld->Other2This (lightSphere);
+      if (!csIntersect3::BoxSphere (box, lightSphere.GetCenter(),
+          lightSphere.GetRadius()*lightSphere.GetRadius()))
+        continue;
+
+      if (numInfluences + found < maxInfluences)
+      {
+        influences[numInfluences + found] = MakeInfluence (candidate.light,
+          box, lightSphere.GetCenter());
+      }
+      found++;
+    }
+
+    neededInfluences = csMax (neededInfluences, numInfluences + found);
+    if (sorted && (numInfluences + found <= maxInfluences))
+    {
+      qsort (influences + numInfluences, found, sizeof (csLightInfluence),
+        SortInfluenceByIntensity);
+    }
+    query.firstInfluence = numInfluences;
+    query.numInfluences = csMin (found, maxLights);
+    numInfluences += query.numInfluences;
+  }
+
+  return neededInfluences;
+}
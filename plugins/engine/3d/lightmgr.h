@@ -19,10 +19,21 @@
 #ifndef __CS_CSENGINE_LIGHTMGR_H__
 #define __CS_CSENGINE_LIGHTMGR_H__
 
+#include "csgeom/box.h"
 #include "csutil/fixedsizeallocator.h"
+#include "csutil/hash.h"
+#include "csutil/lineararena.h"
 #include "csutil/scf_implementation.h"
 #include "iengine/lightmgr.h"
 
+CS_PLUGIN_NAMESPACE_BEGIN(Engine)
+{
+  class csLight;
+}
+CS_PLUGIN_NAMESPACE_END(Engine)
+
+class csEngine;
+
 /**
  * Engine implementation of the light manager.
  */
@@ -37,8 +48,44 @@ private:
       CS::Memory::AllocatorMalloc, true> >
   TempInfluences;
   TempInfluences tempInfluences;
+
+  csEngine* engine;
+  typedef CS_PLUGIN_NAMESPACE_NAME(Engine)::csLight csLight;
+  /// World space bounding sphere of a light, as used by batched queries
+  struct CachedLightSphere
+  {
+    csLight* light;
+    csVector3 center;
+    float radius;
+    csBox3 worldBox;
+    uint lightType;
+    long updateNumber;
+  };
+  /**
+   * Memory for the light spheres computed in the current frame and the
+   * table to look them up. Released at once when the frame changes.
+   */
+  CS::Memory::LinearArena lightSphereArena;
+  /// Open addressing table of the light spheres, at most half full
+  CachedLightSphere** lightSphereSlots;
+  size_t lightSphereSlotsNum;
+  size_t lightSphereCount;
+  uint lightSphereCacheFrame;
+  /// Whether the arena usage is reported for every frame
+  bool reportArena;
+  /// Lights found by the traversal in GetRelevantLightsBatch()
+  csDirtyAccessArray<CachedLightSphere> batchCandidates;
+  /// World space boxes of the queries in GetRelevantLightsBatch()
+  csDirtyAccessArray<csBox3> batchBoxesWorld;
+
+  const CachedLightSphere& GetCachedLightSphere (csLight* light);
+  /// Get the slot for the sphere of \a light in the light sphere table
+  CachedLightSphere** GetLightSphereSlot (csLight* light);
+  /// Double the size of the light sphere table
+  void GrowLightSphereSlots ();
+  friend struct LightCollectBatchCandidates;
 public:
-  csLightManager ();
+  csLightManager (csEngine* engine);
   virtual ~csLightManager ();
 
   virtual void GetRelevantLights (iMeshWrapper* meshObject, 
@@ -82,6 +129,11 @@ public:
     size_t& numLights, size_t maxLights = (size_t)~0,
     const csReversibleTransform* bboxToWorld = 0,
     uint flags = CS_LIGHTQUERY_GET_ALL);
+
+  virtual size_t GetRelevantLightsBatch (iSector* sector,
+    csLightBatchQuery* queries, size_t numQueries,
+    csLightInfluence* influences, size_t maxInfluences,
+    size_t maxLights = (size_t)~0, bool sorted = false);
 protected:
   template<typename BoxSpace>
   void GetRelevantLightsWorker (
@@ -51,11 +51,13 @@
 #include "csutil/strset.h"
 #include "csutil/sysfunc.h"
 #include "csutil/syspath.h"
+#include "csutil/threading/thread.h"
 #include "csutil/util.h"
 #include "csutil/vfsplat.h"
 #include "iutil/databuff.h"
 #include "iutil/objreg.h"
 #include "iutil/verbositymanager.h"
+#include "ivaria/profile.h"
 
 #define NEW_CONFIG_SCANNING
 
@@ -143,6 +145,8 @@ private:
   void *fh;
   // buffer, where read mode data is contained
   csRef<iDataBuffer> databuf;
+  // reads data from the archive mapping if databuf is not used
+  csArchiveEntryStream stream;
   // whether databuf is null-terminated
   bool buffernt;
   // current data pointer
@@ -170,6 +174,9 @@ public:
   csPtr<iFile> GetPartialView (size_t offset, size_t size = (size_t)~0);
   /// Set current file pointer
   virtual bool SetPos (size_t newpos);
+private:
+  // Read the complete stream into databuf
+  void FetchStreamData ();
 };
 
 class VfsArchive : public csArchive
@@ -186,6 +193,13 @@ public:
   int Writing;
   // Verbosity flags.
   unsigned int verbosity;
+  /* Memory mapping of the archive file. Files are streamed from it without
+     taking archive_mutex, as long as the archive was not modified. */
+  csRef<iDataBuffer> mapping;
+  // Set once the archive is modified; files are then read under the lock
+  int32 modified;
+  // Number of threads currently opening a stream without the lock
+  int32 streamOpeners;
 
   bool IsVerbose(unsigned int mask) const
   {
@@ -216,13 +230,49 @@ public:
       (csGetTicks () - LastUseTime > VFS_KEEP_UNUSED_ARCHIVE_TIME);
   }
   VfsArchive (const char *filename, unsigned int verbosity) : csArchive (filename),
-    RefCount (1)
+    RefCount (1), modified (0), streamOpeners (0)
   {
     Writing = 0;
     VfsArchive::verbosity = verbosity;
     UpdateTime ();
     if (IsVerbose(csVFS::VERBOSITY_DEBUG))
       csPrintf ("VFS_DEBUG: opening archive %s\n", CS::Quote::Double (filename));
+    MapArchive ();
+  }
+
+  // Set up the memory mapping of the archive file
+  void MapArchive ();
+
+  /**
+   * Try to set up \a stream for reading the given file from the mapping.
+   * Fails if there is no mapping or the archive was modified.
+   */
+  bool OpenStream (const char* name, csArchiveEntryStream& stream)
+  {
+    if (!mapping) return false;
+    CS::Threading::AtomicOperations::Increment (&streamOpeners);
+    bool result = false;
+    /* The directory only changes on a Flush() after a modification, and
+       MarkModified() waits for us, so it can be read without the lock. */
+    if (CS::Threading::AtomicOperations::Read (&modified) == 0)
+    {
+      void* entry = FindName (name);
+      result = entry && OpenEntryStream (entry, mapping, stream);
+    }
+    CS::Threading::AtomicOperations::Decrement (&streamOpeners);
+    return result;
+  }
+
+  /**
+   * Called before the archive is modified. Makes further reads use the
+   * lock and waits for the streams being opened without it.
+   */
+  void MarkModified ()
+  {
+    if (CS::Threading::AtomicOperations::Read (&modified) != 0) return;
+    CS::Threading::AtomicOperations::Set (&modified, 1);
+    while (CS::Threading::AtomicOperations::Read (&streamOpeners) != 0)
+      CS::Threading::Thread::Yield ();
   }
   virtual ~VfsArchive ()
   {
@@ -469,6 +519,21 @@ csMMapDataBuffer::csMMapDataBuffer (const char* filename, size_t fileSize) :
     mapping = mmio->GetData (0, fileSize);
 }
 
+void VfsArchive::MapArchive ()
+{
+  struct stat st;
+  if ((stat (GetName (), &st) != 0) || (st.st_size == 0)
+      || (GetFile (0) == 0))
+    return;
+
+  csRef<csMMapDataBuffer> buf;
+  buf.AttachNew (new csMMapDataBuffer (GetName (), st.st_size));
+  if (!buf->GetStatus()) return;
+  mapping = buf;
+  // Don't overwrite the mapped file when the archive is changed
+  SetPreserveFileOnFlush (true);
+}
+
 #ifndef O_BINARY
 #  define O_BINARY 0
 #endif
@@ -974,7 +1039,6 @@ ArchiveFile::ArchiveFile (int Mode, VfsNode *ParentNode, size_t RIndex,
   bool const debug = IsVerbose(csVFS::VERBOSITY_DEBUG);
   buffernt = false;
 
-  CS::Threading::RecursiveMutexScopedLock lock (Archive->archive_mutex);
   Archive->UpdateTime ();
   ArchiveCache->CheckUp ();
 
@@ -982,6 +1046,16 @@ ArchiveFile::ArchiveFile (int Mode, VfsNode *ParentNode, size_t RIndex,
     csPrintf ("VFS_DEBUG: Trying to open file %s from archive %s\n",
 	      CS::Quote::Double (NameSuffix), CS::Quote::Double (Archive->GetName ()));
 
+  if (((Mode & VFS_FILE_MODE) == VFS_FILE_READ)
+    && Archive->OpenStream (NameSuffix, stream))
+  {
+    // Data is read (and inflated) on demand, without holding the lock
+    Size = stream.GetSize ();
+    Error = VFS_STATUS_OK;
+    return;
+  }
+
+  CS::Threading::RecursiveMutexScopedLock lock (Archive->archive_mutex);
   if ((Mode & VFS_FILE_MODE) == VFS_FILE_READ)
   {
     // If reading a file, flush all pending operations
@@ -996,6 +1070,7 @@ ArchiveFile::ArchiveFile (int Mode, VfsNode *ParentNode, size_t RIndex,
   }
   else if ((Mode & VFS_FILE_MODE) == VFS_FILE_WRITE)
   {
+    Archive->MarkModified ();
     if ((fh = Archive->NewFile(NameSuffix,0,!(Mode & VFS_FILE_UNCOMPRESSED))))
     {
       Error = VFS_STATUS_OK;
@@ -1010,14 +1085,22 @@ ArchiveFile::~ArchiveFile ()
     csPrintf("VFS_DEBUG: Closing a file from archive %s\n",
 	     CS::Quote::Double (Archive->GetName()));
 
-  CS::Threading::RecursiveMutexScopedLock lock (Archive->archive_mutex);
   if (fh)
+  {
+    CS::Threading::RecursiveMutexScopedLock lock (Archive->archive_mutex);
     Archive->Writing--;
+  }
 }
 
 size_t ArchiveFile::Read (char *Data, size_t DataSize)
 {
-  if (databuf.IsValid())
+  if (stream.IsValid() && !databuf.IsValid())
+  {
+    size_t sz = stream.Read (Data, DataSize);
+    fpos = stream.GetPos ();
+    return sz;
+  }
+  else if (databuf.IsValid())
   {
     size_t sz = DataSize;
     if (fpos + sz > Size)
@@ -1035,7 +1118,7 @@ size_t ArchiveFile::Read (char *Data, size_t DataSize)
 
 size_t ArchiveFile::Write (const char *Data, size_t DataSize)
 {
-  if (databuf.IsValid())
+  if (databuf.IsValid() || stream.IsValid())
   {
     Error = VFS_STATUS_ACCESSDENIED;
     return 0;
@@ -1060,7 +1143,7 @@ void ArchiveFile::Flush ()
 
 bool ArchiveFile::AtEOF ()
 {
-  if (databuf.IsValid())
+  if (databuf.IsValid() || stream.IsValid())
     return fpos + 1 >= Size;
   else
     return true;
@@ -1073,7 +1156,13 @@ size_t ArchiveFile::GetPos ()
 
 bool ArchiveFile::SetPos (size_t newpos)
 {
-  if (databuf.IsValid())
+  if (stream.IsValid() && !databuf.IsValid())
+  {
+    bool result = stream.SetPos (newpos);
+    fpos = stream.GetPos ();
+    return result;
+  }
+  else if (databuf.IsValid())
   {
     fpos = (newpos > Size) ? Size : newpos;
     return true;
@@ -1084,8 +1173,25 @@ bool ArchiveFile::SetPos (size_t newpos)
   }
 }
 
+void ArchiveFile::FetchStreamData ()
+{
+  if (databuf.IsValid() || !stream.IsValid()) return;
+
+  // Stored files need no copy
+  databuf = stream.GetStoredData ();
+  if (databuf.IsValid()) return;
+
+  CS::DataBuffer<VfsHeap>* dbuf =
+    new CS::DataBuffer<VfsHeap> (Size, Node->vfs->heap);
+  databuf.AttachNew (dbuf);
+  if (!stream.SetPos (0)
+    || (stream.Read (databuf->GetData(), Size) != Size))
+    Error = VFS_STATUS_IOERROR;
+}
+
 csPtr<iDataBuffer> ArchiveFile::GetAllData (bool nullterm)
 {
+  FetchStreamData ();
   if (nullterm && !buffernt)
   {
     // However, a null-terminated buffer is requested,
@@ -1104,6 +1210,7 @@ csPtr<iDataBuffer> ArchiveFile::GetAllData (bool nullterm)
 
 csPtr<iDataBuffer> ArchiveFile::GetAllData (CS::Memory::iAllocator* alloc)
 {
+  FetchStreamData ();
   return csPtr<iDataBuffer> (databuf);
 }
 
@@ -1518,7 +1625,10 @@ bool VfsNode::Delete (const char *Suffix)
     return false;
 
   if (a)
+  {
+    a->MarkModified ();
     return a->DeleteFile (fname);
+  }
   else
   {
     // Remove trailing path separator. (At least needed on Win32.)
@@ -1631,6 +1741,11 @@ int csVFS::VfsVector::Compare (VfsNode* const& Item1, VfsNode* const& Item2)
 
 // --------------------------------------------------------------- csVFS --- //
 
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(csVFS_Open)
+CS_DECLARE_PROFILER_ZONE(csVFS_ReadFile)
+CS_DECLARE_PROFILER_ZONE(csVFS_WriteFile)
+
 SCF_IMPLEMENT_FACTORY (csVFS)
 
 csVFS::VfsTls::VfsTls() : dirstack (8, 8)
@@ -2094,6 +2209,7 @@ csPtr<iStringArray> csVFS::FindFiles (const char *Path)
 
 csPtr<iFile> csVFS::Open (const char *FileName, int Mode)
 {
+  CS_PROFILER_ZONE(csVFS_Open)
   if (!FileName)
     return 0;
   VfsNode *node;
@@ -2115,6 +2231,7 @@ bool csVFS::Sync ()
 
 csPtr<iDataBuffer> csVFS::ReadFile (const char *FileName, bool nullterm)
 {
+  CS_PROFILER_ZONE(csVFS_ReadFile)
   csRef<iFile> F (Open (FileName, VFS_FILE_READ));
   if (!F)
     return 0;
@@ -2143,6 +2260,7 @@ csPtr<iDataBuffer> csVFS::ReadFile (const char *FileName, bool nullterm)
 
 bool csVFS::WriteFile (const char *FileName, const char *Data, size_t Size)
 {
+  CS_PROFILER_ZONE(csVFS_WriteFile)
   csRef<iFile> F (Open (FileName, VFS_FILE_WRITE));
   if (!F)
     return false;
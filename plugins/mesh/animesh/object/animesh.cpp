@@ -27,6 +27,8 @@
 #include "csgfx/vertexlistwalker.h"
 #include "cstool/rviewclipper.h"
 #include "csutil/objreg.h"
+#include "csutil/cfgacc.h"
+#include "csutil/parallelfor.h"
 #include "csutil/scf.h"
 #include "csutil/scfarray.h"
 #include "csutil/sysfunc.h"
@@ -69,7 +71,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
   // --------------------------  AnimeshObjectType  --------------------------
 
   AnimeshObjectType::AnimeshObjectType (iBase* parent)
-    : scfImplementationType (this, parent)
+    : scfImplementationType (this, parent), skinningSIMD (true),
+    skinningWorkers (0), skinningParallelMinVertices (8192)
   {
   }
 
@@ -101,6 +104,21 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
     svNameBoneTransforms = strset->Request ("bone transform real");
     svNameBoneTransforms = strset->Request ("bone transform dual");
 
+    csConfigAccess cfg (object_reg, "/config/animesh.cfg");
+    skinningSIMD = cfg->GetBool ("Mesh.Animesh.Skinning.SIMD", true);
+    // 0 means one thread per processor
+    int threads = cfg->GetInt ("Mesh.Animesh.Skinning.Threads", 0);
+    if (threads != 1)
+    {
+      // The thread requesting the skinning also works on the batches
+      skinningJobQueue = CS::Threading::GetParallelForJobQueue (object_reg,
+        skinningWorkers);
+      if (threads > 1)
+        skinningWorkers = csMin (size_t (threads - 1), skinningWorkers);
+    }
+    skinningParallelMinVertices = csMax (cfg->GetInt (
+      "Mesh.Animesh.Skinning.ParallelMinVertices", 8192), 1);
+
     return true;
   }
 
@@ -1063,6 +1081,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
   {
     bufferAccessor.AttachNew (new RenderBufferAccessor (this));
     postMorphVertices = factory->vertexBuffer;
+    skinner.SetSIMDEnabled (factory->objectType->skinningSIMD);
     SetupSubmeshes ();
     SetupSockets ();
 
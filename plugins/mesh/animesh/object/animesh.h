@@ -21,6 +21,7 @@
 
 #include "csgeom/box.h"
 #include "csgfx/shadervarcontext.h"
+#include "cstool/animeshskinning.h"
 #include "cstool/objmodel.h"
 #include "cstool/rendermeshholder.h"
 #include "csutil/dirtyaccessarray.h"
@@ -33,6 +34,7 @@
 #include "imesh/animesh.h"
 #include "imesh/object.h"
 #include "iutil/comp.h"
+#include "iutil/job.h"
 #include "ivaria/decal.h"
 
 #include "morphtarget.h"
@@ -68,6 +70,14 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
     //-- iComponent
     virtual bool Initialize (iObjectRegistry*);
 
+    // CPU skinning settings
+    bool skinningSIMD;
+    /// Job queue used for parallel CPU skinning (0 to skin serially)
+    csRef<iJobQueue> skinningJobQueue;
+    /// Number of jobs parallel CPU skinning is spread over
+    size_t skinningWorkers;
+    size_t skinningParallelMinVertices;
+
   private:
     iObjectRegistry* object_reg;
   };
@@ -572,6 +582,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
     // Hold the bone transforms
     csRef<csShaderVariable> boneTransformArray;
     csRef<CS::Animation::AnimatedMeshState> lastSkeletonState;
+    CS::Mesh::DualQuaternionSkinner skinner;
 
     csRenderMeshHolder rmHolder;
     csDirtyAccessArray<CS::Graphics::RenderMesh*> renderMeshList;
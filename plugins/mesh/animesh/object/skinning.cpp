@@ -20,6 +20,7 @@
 
 #include "csgfx/renderbuffer.h"
 #include "csgfx/vertexlistwalker.h"
+#include "cstool/rbuflock.h"
 #include "imesh/skeleton2.h"
 #include "imesh/animnode/skeleton2anim.h"
 
@@ -100,6 +101,15 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
 
 #include "csutil/custom_new_enable.h"
 
+  // Whether a buffer can be accessed directly as an array of csVector3
+  static bool IsPackedVector3 (iRenderBuffer* buffer)
+  {
+    return buffer
+      && buffer->GetComponentType () == CS_BUFCOMP_FLOAT
+      && buffer->GetComponentCount () == 3
+      && buffer->GetElementDistance () == sizeof (csVector3);
+  }
+
   // We use a template version to benefit of optimizations from the compiler
   template<bool SkinV, bool SkinN, bool SkinTB>
   void AnimeshObject::Skin ()
@@ -116,6 +126,64 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
 	       && skinnedBinormals->GetElementCount () >= factory->vertexCount
 	       : true);
 
+    const size_t influencesPerVertex = factory->GetBoneInfluencesPerVertex ();
+    CS::Mesh::AnimatedMeshBoneInfluence* influence = factory->boneInfluences.GetArray ();
+
+    // Use the batched skinner if the source data is tightly packed
+    if ((!SkinV || IsPackedVector3 (postMorphVertices))
+	&& (!SkinN || IsPackedVector3 (factory->normalBuffer))
+	&& (!SkinTB || (IsPackedVector3 (factory->tangentBuffer)
+			&& IsPackedVector3 (factory->binormalBuffer))))
+    {
+      csRenderBufferLock<csVector3> srcVerts (
+        SkinV ? (iRenderBuffer*)postMorphVertices : 0, CS_BUF_LOCK_READ);
+      csRenderBufferLock<csVector3> dstVerts (
+        SkinV ? (iRenderBuffer*)skinnedVertices : 0);
+      csRenderBufferLock<csVector3> srcNormals (
+        SkinN ? (iRenderBuffer*)factory->normalBuffer : 0, CS_BUF_LOCK_READ);
+      csRenderBufferLock<csVector3> dstNormals (
+        SkinN ? (iRenderBuffer*)skinnedNormals : 0);
+      csRenderBufferLock<csVector3> srcTangents (
+        SkinTB ? (iRenderBuffer*)factory->tangentBuffer : 0, CS_BUF_LOCK_READ);
+      csRenderBufferLock<csVector3> dstTangents (
+        SkinTB ? (iRenderBuffer*)skinnedTangents : 0);
+      csRenderBufferLock<csVector3> srcBinormals (
+        SkinTB ? (iRenderBuffer*)factory->binormalBuffer : 0, CS_BUF_LOCK_READ);
+      csRenderBufferLock<csVector3> dstBinormals (
+        SkinTB ? (iRenderBuffer*)skinnedBinormals : 0);
+
+      CS::Mesh::DualQuaternionSkinner::Buffers buffers;
+      if (SkinV)
+      {
+	buffers.srcVertices = srcVerts.Lock ();
+	buffers.dstVertices = dstVerts.Lock ();
+      }
+      if (SkinN)
+      {
+	buffers.srcNormals = srcNormals.Lock ();
+	buffers.dstNormals = dstNormals.Lock ();
+      }
+      if (SkinTB)
+      {
+	buffers.srcTangents = srcTangents.Lock ();
+	buffers.dstTangents = dstTangents.Lock ();
+	buffers.srcBinormals = srcBinormals.Lock ();
+	buffers.dstBinormals = dstBinormals.Lock ();
+      }
+
+      skinner.SetupBones (lastSkeletonState);
+
+      AnimeshObjectType* type = factory->objectType;
+      if (type->skinningJobQueue
+	  && factory->vertexCount >= type->skinningParallelMinVertices)
+	skinner.SkinParallel (type->skinningJobQueue, type->skinningWorkers, buffers,
+	  influence, influencesPerVertex, factory->vertexCount);
+      else
+	skinner.Skin (buffers, influence, influencesPerVertex, 0,
+	  factory->vertexCount);
+      return;
+    }
+
     // Setup some local data
     csVertexListWalker<float, csVector3> srcVerts (postMorphVertices);
     csRenderBufferLock<csVector3> dstVerts (skinnedVertices);
@@ -129,8 +197,6 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
 
     CS::Animation::AnimatedMeshState* skeletonState = lastSkeletonState;
 
-    CS::Mesh::AnimatedMeshBoneInfluence* influence = factory->boneInfluences.GetArray ();
-
     for (size_t i = 0; i < factory->vertexCount; ++i)
     {
       // Accumulate data for the vertex
@@ -139,7 +205,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
       csDualQuaternion dq (csQuaternion (0,0,0,0), csQuaternion (0,0,0,0)); 
       csQuaternion pivot;
 
-      for (size_t j = 0; j < 4; ++j, ++influence) // @@SOLVE 4
+      for (size_t j = 0; j < influencesPerVertex; ++j, ++influence)
       {
         if (influence->influenceWeight > SMALL_EPSILON)
         {
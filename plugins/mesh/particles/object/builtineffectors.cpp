@@ -102,6 +102,32 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     }
   }
 
+  void ParticleEffectorForce::EffectParticleStreams (
+    iParticleSystemBase* system, const csParticleStreams& streams,
+    const csParticleBuffer& particleBuffer, float dt, float totalTime)
+  {
+    if (!do_randomAcceleration)
+    {
+      StreamOps::ApplyForce (streams, acceleration, force, dt);
+      return;
+    }
+
+    for (size_t idx = 0; idx < streams.particleCount; ++idx)
+    {
+      csVector3 a = acceleration;
+
+      csVector3 r = GetVGen()->Get ();
+      a.x += r.x * randomAcceleration.x;
+      a.y += r.y * randomAcceleration.y;
+      a.z += r.z * randomAcceleration.z;
+
+      const float invMass = 1.0f / streams.mass[idx];
+      streams.linearVelocityX[idx] += (a.x + force.x * invMass) * dt;
+      streams.linearVelocityY[idx] += (a.y + force.y * invMass) * dt;
+      streams.linearVelocityZ[idx] += (a.z + force.z * invMass) * dt;
+    }
+  }
+
   ParticleEffectorLinColor::ParticleEffectorLinColor (iObjectRegistry* object_reg)
     : scfImplementationType (this),
     precalcInvalid (true)
@@ -147,6 +173,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     }
   }
 
+  void ParticleEffectorLinColor::EffectParticleStreams (
+    iParticleSystemBase* system, const csParticleStreams& streams,
+    const csParticleBuffer& particleBuffer, float dt, float totalTime)
+  {
+    Precalc ();
+
+    if (precalcList.GetSize () == 0)
+      return;
+
+    StreamOps::ApplyColorRamp (streams, precalcList.GetArray (),
+      precalcList.GetSize ());
+  }
+
   size_t ParticleEffectorLinColor::AddColor (const csColor4& color, float maxTTL)
   {
     ColorEntry c;
@@ -293,6 +332,58 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     }
   }
 
+  void ParticleEffectorLinear::EffectParticleStreams (
+    iParticleSystemBase* system, const csParticleStreams& streams,
+    const csParticleBuffer& particleBuffer, float dt, float totalTime)
+  {
+    Precalc ();
+
+    if (precalcList.GetSize () == 0)
+      return;
+
+    for (size_t idx = 0; idx < streams.particleCount; ++idx)
+    {
+      // Parameters not kept in the streams are still in the records
+      csParticle& particle = particleBuffer.particleData[idx];
+      csParticleAux& particleAux = particleBuffer.particleAuxData[idx];
+
+      float ttl = streams.timeToLive[idx];
+
+      //Classify
+      size_t aSpan;
+      for(aSpan = 0; aSpan < precalcList.GetSize (); ++aSpan)
+      {
+        if (ttl < precalcList[aSpan].maxTTL)
+          break;
+      }
+
+      aSpan = csMin (aSpan, precalcList.GetSize ()-1);
+
+      const PrecalcEntry& ei = precalcList[aSpan];
+      if (mask & CS_PARTICLE_MASK_MASS)
+      {
+        streams.mass[idx] = ei.add.mass + ei.mult.mass * ttl;
+      }
+      if (mask & CS_PARTICLE_MASK_LINEARVELOCITY)
+      {
+        const csVector3 v = ei.add.linearVelocity + ei.mult.linearVelocity * ttl;
+        streams.linearVelocityX[idx] = v.x;
+        streams.linearVelocityY[idx] = v.y;
+        streams.linearVelocityZ[idx] = v.z;
+      }
+      if (mask & CS_PARTICLE_MASK_ANGULARVELOCITY) { INTERPOLATE_PARAMETER (angularVelocity) }
+      if (mask & CS_PARTICLE_MASK_COLOR)
+      {
+        const csColor4 c = ei.add.color + ei.mult.color * ttl;
+        streams.colorRed[idx] = c.red;
+        streams.colorGreen[idx] = c.green;
+        streams.colorBlue[idx] = c.blue;
+        streams.colorAlpha[idx] = c.alpha;
+      }
+      if (mask & CS_PARTICLE_MASK_PARTICLESIZE) { INTERPOLATE_PARAMETER_AUX (particleSize) }
+    }
+  }
+
   size_t ParticleEffectorLinear::AddParameterSet (const csParticleParameterSet& param, float maxTTL)
   {
     ParamEntry c;
@@ -419,6 +510,28 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       }
     }
 
+    // Same for particle streams
+    template<typename FnType>
+    void StepParticles (FnType& fn, const csParticleStreams& streams, 
+      float dt, float t0 = 0)
+    {
+      const float maxDt = 1/30.0f;
+      dt = csMin (dt, maxDt);
+
+      for (size_t idx = 0; idx < streams.particleCount; ++idx)
+      {
+        const csVector3 oldPos (streams.positionX[idx],
+          streams.positionY[idx], streams.positionZ[idx]);
+        csVector3 newPos;
+
+        CS::Math::Ode45::Step<FnType, float> (fn, dt, t0, oldPos, newPos);
+
+        streams.positionX[idx] = newPos.x;
+        streams.positionY[idx] = newPos.y;
+        streams.positionZ[idx] = newPos.z;
+      }
+    }
+
     // Spiral functor
     struct SpiralFunc
     {
@@ -479,6 +592,23 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     if (particleBuffer.particleCount == 0)
       return;
 
+    StepField (particleBuffer, dt, totalTime);
+  }
+
+  void ParticleEffectorVelocityField::EffectParticleStreams (
+    iParticleSystemBase* system, const csParticleStreams& streams,
+    const csParticleBuffer& particleBuffer, float dt, float totalTime)
+  {
+    if (streams.particleCount == 0)
+      return;
+
+    StepField (streams, dt, totalTime);
+  }
+
+  template<typename ParticlesType>
+  void ParticleEffectorVelocityField::StepField (const ParticlesType& particles,
+    float dt, float totalTime)
+  {
     switch (type)
     {
     case CS_PARTICLE_BUILTIN_SPIRAL:
@@ -496,7 +626,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
         if (fparams.GetSize () >= 1)
           func.spreadFactor = fparams[0];
 
-        StepParticles (func, particleBuffer, dt, totalTime);
+        StepParticles (func, particles, dt, totalTime);
       }
       break;
     case CS_PARTICLE_BUILTIN_RADIALPOINT:
@@ -513,7 +643,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
         if (fparams.GetSize () >= 2)
           func.scale2 = fparams[1];
 
-        StepParticles (func, particleBuffer, dt, totalTime);
+        StepParticles (func, particles, dt, totalTime);
       }
       break;
     default:
@@ -571,18 +701,18 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     return newPtr;
   }
 
-  void ParticleEffectorLight::EffectParticles (iParticleSystemBase* system,
-    const csParticleBuffer& particleBuffer, float dt, float totalTime)
+  bool ParticleEffectorLight::SetupLights (iParticleSystemBase* system,
+    size_t particleCount)
   {
     ParticlesMeshObject* meshObject = dynamic_cast<ParticlesMeshObject*> (system);
     iMovable* meshMovable = meshObject->GetMeshWrapper ()->GetMovable ();
 
     if (!engine)
       engine = csQueryRegistry<iEngine> (meshObject->factory->objectType->object_reg);
-    if (!engine) return;
+    if (!engine) return false;
 
     // Remove the lights of the particles that are no more active
-    while (lights.GetSize () > particleBuffer.particleCount)
+    while (lights.GetSize () > particleCount)
     {
       // Remove the light from the scene
       csRef<iLight> light = lights.Pop ();
@@ -594,7 +724,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     }
 
     // Create the lights for the new particles
-    while (lights.GetSize () < particleBuffer.particleCount)
+    while (lights.GetSize () < particleCount)
     {
       csRef<iLight> light;
       if (allocatedLights.GetSize ())
@@ -613,6 +743,15 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       lights.Push (light);
     }
 
+    return true;
+  }
+
+  void ParticleEffectorLight::EffectParticles (iParticleSystemBase* system,
+    const csParticleBuffer& particleBuffer, float dt, float totalTime)
+  {
+    if (!SetupLights (system, particleBuffer.particleCount))
+      return;
+
     // Update the light parameters
     for (size_t idx = 0; idx < particleBuffer.particleCount; ++idx)
     {
@@ -629,5 +768,29 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     }
   }
 
+  void ParticleEffectorLight::EffectParticleStreams (
+    iParticleSystemBase* system, const csParticleStreams& streams,
+    const csParticleBuffer& particleBuffer, float dt, float totalTime)
+  {
+    if (!SetupLights (system, streams.particleCount))
+      return;
+
+    for (size_t idx = 0; idx < streams.particleCount; ++idx)
+    {
+      const csParticle& particle = particleBuffer.particleData[idx];
+      const csColor4 color (streams.colorRed[idx], streams.colorGreen[idx],
+        streams.colorBlue[idx], streams.colorAlpha[idx]);
+      iLight* light = lights[idx];
+
+      light->GetMovable ()->SetPosition (csVector3 (streams.positionX[idx],
+        streams.positionY[idx], streams.positionZ[idx]));
+      light->GetMovable ()->SetTransform (csMatrix3 (particle.orientation));
+      light->GetMovable ()->UpdateMove ();
+      light->SetColor (color);
+      light->SetSpecularColor (color);
+      light->SetCutoffDistance (color.alpha * cutoffDistance);
+    }
+  }
+
 }
 CS_PLUGIN_NAMESPACE_END(Particles)
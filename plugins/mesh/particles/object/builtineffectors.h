@@ -20,11 +20,14 @@
 #define __CS_MESH_BUILTINEFFECTORS_H__
 
 #include "cstool/modifiableimpl.h"
+#include "csutil/dirtyaccessarray.h"
 #include "csutil/scf_implementation.h"
 
 #include "imesh/particles.h"
 #include "iutil/comp.h"
 
+#include "particlestreams.h"
+
 struct iLight;
 
 CS_PLUGIN_NAMESPACE_BEGIN(Particles)
@@ -66,9 +69,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
   //------------------------------------------------------------------------
 
   class ParticleEffectorForce : public 
-    scfImplementation3<ParticleEffectorForce,
+    scfImplementation4<ParticleEffectorForce,
                        iParticleBuiltinEffectorForce,
                        scfFakeInterface<iParticleEffector>,
+                       iParticleStreamEffector,
                        CS::Utility::iModifiable>
   {
   public:
@@ -85,6 +89,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     virtual void EffectParticles (iParticleSystemBase* system,
       const csParticleBuffer& particleBuffer, float dt, float totalTime);
 
+    //-- iParticleStreamEffector
+    virtual void EffectParticleStreams (iParticleSystemBase* system,
+      const csParticleStreams& streams, const csParticleBuffer& particleBuffer,
+      float dt, float totalTime);
+
     //-- iParticleBuiltinEffectorForce
     virtual void SetAcceleration (const csVector3& acceleration)
     {
@@ -154,9 +163,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
   //------------------------------------------------------------------------
 
   class ParticleEffectorLinColor : public
-    scfImplementation3<ParticleEffectorLinColor,
+    scfImplementation4<ParticleEffectorLinColor,
                        iParticleBuiltinEffectorLinColor,
                        scfFakeInterface<iParticleEffector>,
+                       iParticleStreamEffector,
                        CS::Utility::iModifiable>
   {
   public:
@@ -169,6 +179,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     virtual void EffectParticles (iParticleSystemBase* system,
       const csParticleBuffer& particleBuffer, float dt, float totalTime);
 
+    //-- iParticleStreamEffector
+    virtual void EffectParticleStreams (iParticleSystemBase* system,
+      const csParticleStreams& streams, const csParticleBuffer& particleBuffer,
+      float dt, float totalTime);
+
 
     //-- iParticleBuiltinEffectorLinColor
     virtual size_t AddColor (const csColor4& color, float maxTTL);
@@ -224,22 +239,18 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 
     static int ColorEntryCompare(const ColorEntry& e0, const ColorEntry& e1);
 
-    struct PrecalcEntry
-    {
-      csColor4 mult;
-      csColor4 add;
-      float maxTTL;
-    };
+    typedef ColorRampEntry PrecalcEntry;
     bool precalcInvalid;
-    csArray<PrecalcEntry> precalcList;
+    csDirtyAccessArray<PrecalcEntry> precalcList;
   };
 
   //------------------------------------------------------------------------
 
   class ParticleEffectorLinear : public
-    scfImplementation3<ParticleEffectorLinear,
+    scfImplementation4<ParticleEffectorLinear,
                        iParticleBuiltinEffectorLinear,
                        scfFakeInterface<iParticleEffector>,
+                       iParticleStreamEffector,
                        CS::Utility::iModifiable>
   {
   public:
@@ -252,6 +263,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     virtual void EffectParticles (iParticleSystemBase* system,
       const csParticleBuffer& particleBuffer, float dt, float totalTime);
 
+    //-- iParticleStreamEffector
+    virtual void EffectParticleStreams (iParticleSystemBase* system,
+      const csParticleStreams& streams, const csParticleBuffer& particleBuffer,
+      float dt, float totalTime);
+
     //-- iParticleBuiltinEffectorLinear
     virtual void SetMask (int mask)
     {
@@ -329,9 +345,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
   //------------------------------------------------------------------------
 
   class ParticleEffectorVelocityField : public 
-    scfImplementation3<ParticleEffectorVelocityField,
+    scfImplementation4<ParticleEffectorVelocityField,
                        iParticleBuiltinEffectorVelocityField,
                        scfFakeInterface<iParticleEffector>,
+                       iParticleStreamEffector,
                        CS::Utility::iModifiable>
   {
   public:
@@ -347,6 +364,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     virtual void EffectParticles (iParticleSystemBase* system,
       const csParticleBuffer& particleBuffer, float dt, float totalTime);
 
+    //-- iParticleStreamEffector
+    virtual void EffectParticleStreams (iParticleSystemBase* system,
+      const csParticleStreams& streams, const csParticleBuffer& particleBuffer,
+      float dt, float totalTime);
+
     //-- iParticleBuiltinEffectorForce
     virtual void SetType (csParticleBuiltinEffectorVFType type)
     {
@@ -427,6 +449,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     MODIF_SETPARAMETERVALUE_END ();
 
   private:
+    // Move the particles through the field
+    template<typename ParticlesType>
+    void StepField (const ParticlesType& particles, float dt, float totalTime);
+
     csParticleBuiltinEffectorVFType type;
     csArray<csVector3> vparams;
     csArray<float> fparams;
@@ -435,9 +461,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
   //------------------------------------------------------------------------
 
   class ParticleEffectorLight : public
-    scfImplementation2<ParticleEffectorLight,
+    scfImplementation3<ParticleEffectorLight,
                        iParticleBuiltinEffectorLight,
-                       scfFakeInterface<iParticleEffector> >
+                       scfFakeInterface<iParticleEffector>,
+                       iParticleStreamEffector>
   {
   public:
     //-- ParticleEffectorLight
@@ -450,11 +477,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     virtual void EffectParticles (iParticleSystemBase* system,
       const csParticleBuffer& particleBuffer, float dt, float totalTime);
 
+    //-- iParticleStreamEffector
+    virtual void EffectParticleStreams (iParticleSystemBase* system,
+      const csParticleStreams& streams, const csParticleBuffer& particleBuffer,
+      float dt, float totalTime);
+
     //-- iParticleBuiltinEffectorLight
     virtual void SetInitialCutoffDistance (float distance);
     virtual float GetInitialCutoffDistance () const;
 
   private:
+    /// Make sure there is one light per particle; returns false on failure
+    bool SetupLights (iParticleSystemBase* system, size_t particleCount);
+
     float cutoffDistance;
 
     csRef<iEngine> engine;
@@ -25,6 +25,7 @@
 #include "cstool/rbuflock.h"
 #include "cstool/rviewclipper.h"
 #include "csutil/algorithms.h"
+#include "csutil/cfgacc.h"
 #include "csutil/sysfunc.h"
 #include "csutil/radixsort.h"
 #include "csutil/floatrand.h"
@@ -52,7 +53,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 
   //-- Object type
   ParticlesMeshObjectType::ParticlesMeshObjectType (iBase* parent)
-    : scfImplementationType (this, parent)
+    : scfImplementationType (this, parent), useParticleStreams (false)
   {
   }
 
@@ -63,6 +64,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
   bool ParticlesMeshObjectType::Initialize (iObjectRegistry* object_reg)
   {
     this->object_reg = object_reg;
+
+    csConfigAccess cfg (object_reg, "/config/particles.cfg");
+    useParticleStreams = cfg->GetBool ("Mesh.Particles.Streams", false);
+
     return true;
   }
 
@@ -188,7 +193,9 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     meshWrapper (0), mixMode (CS_FX_COPY), lastUpdateTime (0),
     lastFrameNumber (0), totalParticleTime (0.0f),
     radius (1.0f), minRadius (1.0f), rawBuffer (0), particleAllocatedSize (0),
-    externalControl (false)
+    externalControl (false),
+    useStreams (factory->objectType->useParticleStreams),
+    recordsCurrent (true), streamsCurrent (true)
   {
     particleBuffer.particleCount = 0;
 
@@ -229,7 +236,53 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       rawBuffer = newBuf;
 
       particleAllocatedSize = newSize;
+
+      if (useStreams)
+        streamStorage.Reserve (newSize);
+    }
+  }
+
+  void ParticlesMeshObject::SyncStreams ()
+  {
+    if (!useStreams || streamsCurrent)
+      return;
+
+    streamStorage.CopyFromRecords (particleBuffer, 0,
+      particleBuffer.particleCount);
+    streamsCurrent = true;
+  }
+
+  void ParticlesMeshObject::SyncRecords ()
+  {
+    if (!useStreams || recordsCurrent)
+      return;
+
+    streamStorage.CopyToRecords (particleBuffer, 0,
+      particleBuffer.particleCount);
+    recordsCurrent = true;
+  }
+
+  void ParticlesMeshObject::SetUseParticleStreams (bool useStreams)
+  {
+    // Externally controlled particles are always kept in the records
+    if (externalControl || useStreams == this->useStreams)
+      return;
+
+    if (useStreams)
+    {
+      streamStorage.Reserve (particleAllocatedSize);
+      streamStorage.SetParticleCount (particleBuffer.particleCount);
+      streamStorage.CopyFromRecords (particleBuffer, 0,
+        particleBuffer.particleCount);
     }
+    else
+    {
+      SyncRecords ();
+      streamStorage.Clear ();
+    }
+
+    this->useStreams = useStreams;
+    recordsCurrent = streamsCurrent = true;
   }
 
   void ParticlesMeshObject::SetupIndexBuffer (csRenderBufferHolder* bufferHolder, 
@@ -286,20 +339,46 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       {
         const csVector3& camPos = o2c.GetOrigin ();
 
-        for (unsigned int i = 0; i < particleBuffer.particleCount; ++i)
+        if (useStreams)
+        {
+          const csParticleStreams& streams = streamStorage.GetStreams ();
+          for (unsigned int i = 0; i < particleBuffer.particleCount; ++i)
+          {
+            const csVector3 position (streams.positionX[i],
+              streams.positionY[i], streams.positionZ[i]);
+            sortValues[i] = -(position - camPos).SquaredNorm ();
+          }
+        }
+        else
         {
-          const csParticle& particle = particleBuffer.particleData[i];
-          sortValues[i] = -(particle.position - camPos).SquaredNorm ();
+          for (unsigned int i = 0; i < particleBuffer.particleCount; ++i)
+          {
+            const csParticle& particle = particleBuffer.particleData[i];
+            sortValues[i] = -(particle.position - camPos).SquaredNorm ();
+          }
         }
       }
       else if (sortMode == CS_PARTICLE_SORT_DOT)
       {
         const csVector3& camFwd = o2c.GetFront ();
 
-        for (unsigned int i = 0; i < particleBuffer.particleCount; ++i)
+        if (useStreams)
+        {
+          const csParticleStreams& streams = streamStorage.GetStreams ();
+          for (unsigned int i = 0; i < particleBuffer.particleCount; ++i)
+          {
+            sortValues[i] = -(streams.positionX[i] * camFwd.x
+              + streams.positionY[i] * camFwd.y
+              + streams.positionZ[i] * camFwd.z);
+          }
+        }
+        else
         {
-          const csParticle& particle = particleBuffer.particleData[i];
-          sortValues[i] = -(particle.position * camFwd);
+          for (unsigned int i = 0; i < particleBuffer.particleCount; ++i)
+          {
+            const csParticle& particle = particleBuffer.particleData[i];
+            sortValues[i] = -(particle.position * camFwd);
+          }
         }
       }
 
@@ -354,7 +433,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 
     vertexSetup->Init (o2c, commonDirection, particleSize);
 
-    vertexSetup->SetupVertices (particleBuffer, vertices);
+    if (useStreams)
+      vertexSetup->SetupVertices (streamStorage.GetStreams (), particleBuffer,
+        vertices);
+    else
+      vertexSetup->SetupVertices (particleBuffer, vertices);
   }
 
   void ParticlesMeshObject::UpdateTexCoordBuffer ()
@@ -435,6 +518,26 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     csRenderBufferLock<csColor4> bufferLock (colorBuffer);
     csColor4 *color = bufferLock.Lock ();
 
+    if (useStreams)
+    {
+      SyncStreams ();
+      const csParticleStreams& streams = streamStorage.GetStreams ();
+      for (unsigned int idx = 0; idx < particleBuffer.particleCount; ++idx)
+      {
+        const unsigned int cIdx = idx*4;
+
+        const csColor4 particleColor (streams.colorRed[idx],
+          streams.colorGreen[idx], streams.colorBlue[idx],
+          streams.colorAlpha[idx]);
+
+        color[cIdx+0] = particleColor;
+        color[cIdx+1] = particleColor;
+        color[cIdx+2] = particleColor;
+        color[cIdx+3] = particleColor;
+      }
+      return;
+    }
+
     for (unsigned int idx = 0; idx < particleBuffer.particleCount; ++idx)
     {
       const unsigned int cIdx = idx*4;
@@ -462,6 +565,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     newMesh->mixMode = mixMode;
 
     newMesh->minRadius = minRadius;
+    newMesh->useStreams = useStreams;
 
     newMesh->particleOrientation = particleOrientation;
     newMesh->rotationMode = rotationMode;
@@ -533,6 +637,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     mesh->object2world = obj2world;
     mesh->bbox = GetObjectBoundingBox();
 
+    SyncStreams ();
     SetupIndexBuffer (mesh->buffers, obj2cam);
     SetupVertexBuffer (mesh->buffers, obj2cam);
 
@@ -549,10 +654,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       radiusSq = currDistSq;
   }
 
-  void IntegrateLinearAngular (csParticle& particle, float& radiusSq, float dt)
+  void IntegrateAngular (csParticle& particle, float dt)
   {
-    particle.position += particle.linearVelocity * dt;
-
     // Use closed-form quaternion integrator
     float w = particle.angularVelocity.SquaredNorm ();
     if (w != 0)
@@ -567,11 +670,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       csQuaternion res = qVel * particle.orientation;
       particle.orientation = res + particle.orientation * q;
     }
+  }
 
-
-    float currDistSq = particle.position.SquaredNorm ();
-    if (currDistSq > radiusSq)
-      radiusSq = currDistSq;
+  void IntegrateLinearAngular (csParticle& particle, float& radiusSq, float dt)
+  {
+    IntegrateLinear (particle, radiusSq, dt);
+    IntegrateAngular (particle, dt);
   }
 
   CS_IMPLEMENT_STATIC_VAR(GetFGen, csRandomFloatGen, ());
@@ -583,6 +687,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     if (externalControl)
       return;
 
+    if (useStreams)
+    {
+      AdvanceStreams (dt, newRadiusSq);
+      return;
+    }
+
     // Retire the old particles
     size_t currentParticleIdx = 0;
     while (currentParticleIdx < particleBuffer.particleCount)
@@ -684,6 +794,96 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     }
   }
 
+  void ParticlesMeshObject::AdvanceStreams (float dt, float& newRadiusSq)
+  {
+    SyncStreams ();
+
+    // Retire the old particles
+    StreamOps::RetireParticles (streamStorage, particleBuffer, dt);
+
+    // Apply all emitters. They initialize the particle records, which are
+    // then copied into the streams.
+    size_t totalEmitted = 0;
+    csReversibleTransform t = meshWrapper->GetMovable ()->GetFullTransform ();
+    csReversibleTransform* tptr = transformMode == CS_PARTICLE_LOCAL_EMITTER ? 
+      &t : 0;
+    for (size_t idx = 0; idx < emitters.GetSize (); ++idx)
+    {
+      iParticleEmitter* emitter = emitters[idx];
+      size_t numParticles = emitter->ParticlesToEmit (this, dt, totalParticleTime);
+      if (numParticles == 0)
+        continue;
+
+      ReserveNewParticles (numParticles);
+      totalEmitted += numParticles;
+
+      csParticleBuffer tmpBuf;
+      tmpBuf.particleCount = numParticles;
+      tmpBuf.particleData = particleBuffer.particleData + particleBuffer.particleCount;
+      tmpBuf.particleAuxData = particleBuffer.particleAuxData + particleBuffer.particleCount;
+      
+      emitter->EmitParticles (this, tmpBuf, dt, totalParticleTime, tptr);
+
+      streamStorage.CopyFromRecords (particleBuffer,
+        particleBuffer.particleCount,
+        particleBuffer.particleCount + numParticles);
+      particleBuffer.particleCount += numParticles;
+      streamStorage.SetParticleCount (particleBuffer.particleCount);
+    }
+
+    // Apply all effectors. Effectors not supporting the streams need the
+    // data in the particle records.
+    for (size_t idx = 0; idx < effectors.GetSize (); ++idx)
+    {
+      iParticleEffector* effector = effectors[idx];
+      csRef<iParticleStreamEffector> streamEffector =
+        scfQueryInterface<iParticleStreamEffector> (effector);
+
+      if (streamEffector)
+      {
+        SyncStreams ();
+        streamEffector->EffectParticleStreams (this,
+          streamStorage.GetStreams (), particleBuffer, dt, totalParticleTime);
+        recordsCurrent = false;
+      }
+      else
+      {
+        SyncRecords ();
+        effector->EffectParticles (this, particleBuffer, dt, totalParticleTime);
+        streamsCurrent = false;
+      }
+    }
+    SyncStreams ();
+
+    if (integrationMode == CS_PARTICLE_INTEGRATE_NONE)
+      return;
+
+    // Integrate the positions and rotations of the particles; the newly
+    // emitted ones only for a random part of the time step. The rotations
+    // are only stored in the particle records.
+    const csParticleStreams& streams = streamStorage.GetStreams ();
+    const bool integrateAngular =
+      integrationMode == CS_PARTICLE_INTEGRATE_BOTH;
+    const size_t numOld = particleBuffer.particleCount - totalEmitted;
+
+    StreamOps::IntegrateLinear (streams, 0, numOld, dt, newRadiusSq);
+    if (integrateAngular)
+    {
+      for (size_t i = 0; i < numOld; ++i)
+        IntegrateAngular (particleBuffer.particleData[i], dt);
+    }
+
+    for (size_t i = numOld; i < particleBuffer.particleCount; ++i)
+    {
+      const float particleDt = dt * GetFGen ()->Get ();
+      StreamOps::IntegrateLinear (streams, i, i + 1, particleDt, newRadiusSq);
+      if (integrateAngular)
+        IntegrateAngular (particleBuffer.particleData[i], particleDt);
+    }
+
+    recordsCurrent = false;
+  }
+
   void ParticlesMeshObject::NextFrame (csTicks current_time, const csVector3& pos,
     uint currentFrame)
   {
@@ -771,6 +971,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
   csParticleBuffer* ParticlesMeshObject::LockForExternalControl (
     size_t maxParticles)
   {
+    // The external controller works on the particle records
+    useStreams = false;
+    recordsCurrent = streamsCurrent = true;
+    streamStorage.Clear ();
+
     particleBuffer.particleCount = 0;
     particleBuffer.particleData = 0;
     particleBuffer.particleAuxData = 0;
@@ -33,6 +33,8 @@
 #include "iutil/modifiable.h"
 #include "ivideo/rndbuf.h"
 
+#include "particlestreams.h"
+
 CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 {
   struct iVertexSetup;
@@ -56,6 +58,9 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 
   public:
     iObjectRegistry* object_reg;
+
+    /// Default for iParticleSystem::SetUseParticleStreams()
+    bool useParticleStreams;
   };
 
   class ParticleBase : public CS::Utility::iModifiable
@@ -445,6 +450,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     /// Invalidate vertex setup
     void InvalidateVertexSetup ();
 
+    /// Make sure the particle streams hold the current particle data
+    void SyncStreams ();
+    /// Make sure the particle records hold the current particle data
+    void SyncRecords ();
+
 
     /**\name iMeshObject implementation
      * @{ */
@@ -579,17 +589,29 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 
     virtual csParticle* GetParticle (size_t index)
     {
+      // The caller might modify the particle
+      SyncRecords ();
+      if (useStreams) streamsCurrent = false;
       return particleBuffer.particleData+index;
     }
 
     virtual csParticleAux* GetParticleAux (size_t index)
     {
+      SyncRecords ();
+      if (useStreams) streamsCurrent = false;
       return particleBuffer.particleAuxData+index;
     }
 
     virtual csParticleBuffer* LockForExternalControl (size_t maxParticles);
     
     virtual void Advance (csTicks time);
+
+    virtual void SetUseParticleStreams (bool useStreams);
+
+    virtual bool GetUseParticleStreams () const
+    {
+      return useStreams;
+    }
     /** @} */
 
     /**\name iParticleSystemBase implementation
@@ -753,6 +775,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
      *  cause undesired effects like "particle system explosion".
      */
     void Advance (float dt, float& newRadiusSq);
+    /// Advance particle system using the particle streams
+    void AdvanceStreams (float dt, float& newRadiusSq);
 
     //-- iMeshObject
     iMeshWrapper* meshWrapper;
@@ -778,6 +802,14 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     size_t particleAllocatedSize;
     bool externalControl;
 
+    /* When using the particle streams, the stream members of the particle
+       records are only up to date if recordsCurrent is set, the streams only
+       if streamsCurrent is set. */
+    bool useStreams;
+    bool recordsCurrent;
+    bool streamsCurrent;
+    ParticleStreamStorage streamStorage;
+
     csRefArray<iParticleEmitter> emitters;
     csRefArray<iParticleEffector> effectors;
 
@@ -0,0 +1,411 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csutil/alignedalloc.h"
+#include "csutil/processorspecdetection.h"
+
+#include "particlestreams.h"
+
+#if defined (CS_PROCESSOR_X86) && (defined (__SSE__) || defined (_M_X64) \
+  || (defined (_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define CS_PARTICLESTREAMS_SSE
+#include <xmmintrin.h>
+#endif
+
+CS_PLUGIN_NAMESPACE_BEGIN(Particles)
+{
+  enum
+  {
+    // Number of float streams in csParticleStreams
+    numStreams = 12,
+    // Particles processed at once by the SIMD code
+    simdWidth = 4
+  };
+
+  ParticleStreamStorage::ParticleStreamStorage ()
+    : block (0), allocatedSize (0)
+  {
+    memset (&streams, 0, sizeof (streams));
+  }
+
+  ParticleStreamStorage::~ParticleStreamStorage ()
+  {
+    CS::Memory::AlignedFree (block);
+  }
+
+  void ParticleStreamStorage::Reserve (size_t size)
+  {
+    if (size <= allocatedSize)
+      return;
+
+    // Round up so each stream starts on a 16 byte boundary
+    size_t newSize = (size + simdWidth - 1) & ~size_t (simdWidth - 1);
+    float* newBlock = static_cast<float*> (CS::Memory::AlignedMalloc (
+      newSize * numStreams * sizeof (float), 16));
+
+    float** streamPtrs[numStreams] = {
+      &streams.positionX, &streams.positionY, &streams.positionZ,
+      &streams.linearVelocityX, &streams.linearVelocityY,
+      &streams.linearVelocityZ, &streams.mass, &streams.timeToLive,
+      &streams.colorRed, &streams.colorGreen, &streams.colorBlue,
+      &streams.colorAlpha };
+
+    for (size_t s = 0; s < numStreams; s++)
+    {
+      float* newStream = newBlock + s * newSize;
+      if (streams.particleCount)
+        memcpy (newStream, *streamPtrs[s],
+          streams.particleCount * sizeof (float));
+      *streamPtrs[s] = newStream;
+    }
+
+    CS::Memory::AlignedFree (block);
+    block = newBlock;
+    allocatedSize = newSize;
+  }
+
+  void ParticleStreamStorage::Clear ()
+  {
+    CS::Memory::AlignedFree (block);
+    block = 0;
+    allocatedSize = 0;
+    memset (&streams, 0, sizeof (streams));
+  }
+
+  void ParticleStreamStorage::CopyFromRecords (const csParticleBuffer& buffer,
+    size_t first, size_t last)
+  {
+    for (size_t i = first; i < last; i++)
+    {
+      const csParticle& particle = buffer.particleData[i];
+      const csParticleAux& aux = buffer.particleAuxData[i];
+
+      streams.positionX[i] = particle.position.x;
+      streams.positionY[i] = particle.position.y;
+      streams.positionZ[i] = particle.position.z;
+      streams.linearVelocityX[i] = particle.linearVelocity.x;
+      streams.linearVelocityY[i] = particle.linearVelocity.y;
+      streams.linearVelocityZ[i] = particle.linearVelocity.z;
+      streams.mass[i] = particle.mass;
+      streams.timeToLive[i] = particle.timeToLive;
+      streams.colorRed[i] = aux.color.red;
+      streams.colorGreen[i] = aux.color.green;
+      streams.colorBlue[i] = aux.color.blue;
+      streams.colorAlpha[i] = aux.color.alpha;
+    }
+  }
+
+  void ParticleStreamStorage::CopyToRecords (const csParticleBuffer& buffer,
+    size_t first, size_t last) const
+  {
+    for (size_t i = first; i < last; i++)
+    {
+      csParticle& particle = buffer.particleData[i];
+      csParticleAux& aux = buffer.particleAuxData[i];
+
+      particle.position.Set (streams.positionX[i], streams.positionY[i],
+        streams.positionZ[i]);
+      particle.linearVelocity.Set (streams.linearVelocityX[i],
+        streams.linearVelocityY[i], streams.linearVelocityZ[i]);
+      particle.mass = streams.mass[i];
+      particle.timeToLive = streams.timeToLive[i];
+      aux.color.Set (streams.colorRed[i], streams.colorGreen[i],
+        streams.colorBlue[i], streams.colorAlpha[i]);
+    }
+  }
+
+  void ParticleStreamStorage::MoveParticle (size_t from, size_t to)
+  {
+    streams.positionX[to] = streams.positionX[from];
+    streams.positionY[to] = streams.positionY[from];
+    streams.positionZ[to] = streams.positionZ[from];
+    streams.linearVelocityX[to] = streams.linearVelocityX[from];
+    streams.linearVelocityY[to] = streams.linearVelocityY[from];
+    streams.linearVelocityZ[to] = streams.linearVelocityZ[from];
+    streams.mass[to] = streams.mass[from];
+    streams.timeToLive[to] = streams.timeToLive[from];
+    streams.colorRed[to] = streams.colorRed[from];
+    streams.colorGreen[to] = streams.colorGreen[from];
+    streams.colorBlue[to] = streams.colorBlue[from];
+    streams.colorAlpha[to] = streams.colorAlpha[from];
+  }
+
+  //------------------------------------------------------------------------
+
+  namespace StreamOps
+  {
+    bool IsSIMDAvailable ()
+    {
+#ifdef CS_PARTICLESTREAMS_SSE
+      static int available = -1;
+      if (available < 0)
+      {
+        CS::Platform::ProcessorSpecDetection procSpec;
+        available = procSpec.HasSSE () ? 1 : 0;
+      }
+      return available != 0;
+#else
+      return false;
+#endif
+    }
+
+    void RetireParticles (ParticleStreamStorage& storage,
+      csParticleBuffer& buffer, float dt)
+    {
+      const csParticleStreams& streams = storage.GetStreams ();
+      float* timeToLive = streams.timeToLive;
+      size_t count = streams.particleCount;
+
+      size_t i = 0;
+#ifdef CS_PARTICLESTREAMS_SSE
+      if (IsSIMDAvailable ())
+      {
+        // Update all times to live at once, then only visit the groups
+        // containing dead particles
+        const __m128 vdt = _mm_set1_ps (dt);
+        const __m128 zero = _mm_setzero_ps ();
+        size_t simdCount = count & ~size_t (simdWidth - 1);
+        for (size_t g = 0; g < simdCount; g += simdWidth)
+        {
+          __m128 ttl = _mm_sub_ps (_mm_load_ps (timeToLive + g), vdt);
+          _mm_store_ps (timeToLive + g, ttl);
+        }
+        for (size_t g = simdCount; g < count; g++)
+          timeToLive[g] -= dt;
+
+        while (i < count)
+        {
+          if ((i & (simdWidth - 1)) == 0 && i + simdWidth <= count
+            && _mm_movemask_ps (_mm_cmplt_ps (_mm_load_ps (timeToLive + i),
+              zero)) == 0)
+          {
+            i += simdWidth;
+            continue;
+          }
+
+          if (timeToLive[i] < 0)
+          {
+            // The last particle was already updated, so just move it
+            --count;
+            storage.MoveParticle (count, i);
+            buffer.particleData[i] = buffer.particleData[count];
+            buffer.particleAuxData[i] = buffer.particleAuxData[count];
+            continue;
+          }
+          i++;
+        }
+
+        storage.SetParticleCount (count);
+        buffer.particleCount = count;
+        return;
+      }
+#endif
+
+      while (i < count)
+      {
+        timeToLive[i] -= dt;
+        if (timeToLive[i] < 0)
+        {
+          --count;
+          storage.MoveParticle (count, i);
+          buffer.particleData[i] = buffer.particleData[count];
+          buffer.particleAuxData[i] = buffer.particleAuxData[count];
+          continue;
+        }
+        i++;
+      }
+
+      storage.SetParticleCount (count);
+      buffer.particleCount = count;
+    }
+
+    void IntegrateLinear (const csParticleStreams& streams, size_t first,
+      size_t last, float dt, float& radiusSq)
+    {
+      float* px = streams.positionX;
+      float* py = streams.positionY;
+      float* pz = streams.positionZ;
+      const float* vx = streams.linearVelocityX;
+      const float* vy = streams.linearVelocityY;
+      const float* vz = streams.linearVelocityZ;
+
+      size_t i = first;
+#ifdef CS_PARTICLESTREAMS_SSE
+      if (IsSIMDAvailable ())
+      {
+        for (; (i < last) && (i & (simdWidth - 1)); i++)
+        {
+          px[i] += vx[i] * dt;
+          py[i] += vy[i] * dt;
+          pz[i] += vz[i] * dt;
+          radiusSq = csMax (radiusSq, px[i]*px[i] + py[i]*py[i] + pz[i]*pz[i]);
+        }
+
+        const __m128 vdt = _mm_set1_ps (dt);
+        __m128 maxSq = _mm_set1_ps (radiusSq);
+        for (; i + simdWidth <= last; i += simdWidth)
+        {
+          __m128 x = _mm_add_ps (_mm_load_ps (px + i),
+            _mm_mul_ps (_mm_load_ps (vx + i), vdt));
+          __m128 y = _mm_add_ps (_mm_load_ps (py + i),
+            _mm_mul_ps (_mm_load_ps (vy + i), vdt));
+          __m128 z = _mm_add_ps (_mm_load_ps (pz + i),
+            _mm_mul_ps (_mm_load_ps (vz + i), vdt));
+          _mm_store_ps (px + i, x);
+          _mm_store_ps (py + i, y);
+          _mm_store_ps (pz + i, z);
+
+          __m128 distSq = _mm_add_ps (_mm_add_ps (_mm_mul_ps (x, x),
+            _mm_mul_ps (y, y)), _mm_mul_ps (z, z));
+          maxSq = _mm_max_ps (maxSq, distSq);
+        }
+
+        maxSq = _mm_max_ps (maxSq, _mm_movehl_ps (maxSq, maxSq));
+        maxSq = _mm_max_ss (maxSq, _mm_shuffle_ps (maxSq, maxSq, 1));
+        _mm_store_ss (&radiusSq, maxSq);
+      }
+#endif
+
+      for (; i < last; i++)
+      {
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+        radiusSq = csMax (radiusSq, px[i]*px[i] + py[i]*py[i] + pz[i]*pz[i]);
+      }
+    }
+
+    void ApplyForce (const csParticleStreams& streams,
+      const csVector3& acceleration, const csVector3& force, float dt)
+    {
+      float* vx = streams.linearVelocityX;
+      float* vy = streams.linearVelocityY;
+      float* vz = streams.linearVelocityZ;
+      const float* mass = streams.mass;
+      const size_t count = streams.particleCount;
+
+      size_t i = 0;
+#ifdef CS_PARTICLESTREAMS_SSE
+      if (IsSIMDAvailable ())
+      {
+        const __m128 one = _mm_set1_ps (1.0f);
+        const __m128 vdt = _mm_set1_ps (dt);
+        const __m128 ax = _mm_set1_ps (acceleration.x);
+        const __m128 ay = _mm_set1_ps (acceleration.y);
+        const __m128 az = _mm_set1_ps (acceleration.z);
+        const __m128 fx = _mm_set1_ps (force.x);
+        const __m128 fy = _mm_set1_ps (force.y);
+        const __m128 fz = _mm_set1_ps (force.z);
+        for (; i + simdWidth <= count; i += simdWidth)
+        {
+          __m128 invMass = _mm_div_ps (one, _mm_load_ps (mass + i));
+          _mm_store_ps (vx + i, _mm_add_ps (_mm_load_ps (vx + i), _mm_mul_ps (
+            _mm_add_ps (ax, _mm_mul_ps (fx, invMass)), vdt)));
+          _mm_store_ps (vy + i, _mm_add_ps (_mm_load_ps (vy + i), _mm_mul_ps (
+            _mm_add_ps (ay, _mm_mul_ps (fy, invMass)), vdt)));
+          _mm_store_ps (vz + i, _mm_add_ps (_mm_load_ps (vz + i), _mm_mul_ps (
+            _mm_add_ps (az, _mm_mul_ps (fz, invMass)), vdt)));
+        }
+      }
+#endif
+
+      for (; i < count; i++)
+      {
+        float invMass = 1.0f / mass[i];
+        vx[i] += (acceleration.x + force.x * invMass) * dt;
+        vy[i] += (acceleration.y + force.y * invMass) * dt;
+        vz[i] += (acceleration.z + force.z * invMass) * dt;
+      }
+    }
+
+    void ApplyColorRamp (const csParticleStreams& streams,
+      const ColorRampEntry* ramp, size_t numEntries)
+    {
+      const float* timeToLive = streams.timeToLive;
+      const size_t count = streams.particleCount;
+
+      size_t i = 0;
+#ifdef CS_PARTICLESTREAMS_SSE
+      if (IsSIMDAvailable ())
+      {
+        const ColorRampEntry& lastEntry = ramp[numEntries - 1];
+        for (; i + simdWidth <= count; i += simdWidth)
+        {
+          const __m128 ttl = _mm_load_ps (timeToLive + i);
+
+          // Walk the entries backwards, so the first matching one wins
+          __m128 mr = _mm_set1_ps (lastEntry.mult.red);
+          __m128 mg = _mm_set1_ps (lastEntry.mult.green);
+          __m128 mb = _mm_set1_ps (lastEntry.mult.blue);
+          __m128 ma = _mm_set1_ps (lastEntry.mult.alpha);
+          __m128 ar = _mm_set1_ps (lastEntry.add.red);
+          __m128 ag = _mm_set1_ps (lastEntry.add.green);
+          __m128 ab = _mm_set1_ps (lastEntry.add.blue);
+          __m128 aa = _mm_set1_ps (lastEntry.add.alpha);
+          for (size_t e = numEntries - 1; e-- > 0; )
+          {
+            const ColorRampEntry& entry = ramp[e];
+            __m128 sel = _mm_cmplt_ps (ttl, _mm_set1_ps (entry.maxTTL));
+            if (_mm_movemask_ps (sel) == 0)
+              continue;
+
+#define SELECT(dst, value) \
+            dst = _mm_or_ps (_mm_and_ps (sel, _mm_set1_ps (value)), \
+              _mm_andnot_ps (sel, dst))
+            SELECT (mr, entry.mult.red);
+            SELECT (mg, entry.mult.green);
+            SELECT (mb, entry.mult.blue);
+            SELECT (ma, entry.mult.alpha);
+            SELECT (ar, entry.add.red);
+            SELECT (ag, entry.add.green);
+            SELECT (ab, entry.add.blue);
+            SELECT (aa, entry.add.alpha);
+#undef SELECT
+          }
+
+          _mm_store_ps (streams.colorRed + i, _mm_add_ps (ar, _mm_mul_ps (mr, ttl)));
+          _mm_store_ps (streams.colorGreen + i, _mm_add_ps (ag, _mm_mul_ps (mg, ttl)));
+          _mm_store_ps (streams.colorBlue + i, _mm_add_ps (ab, _mm_mul_ps (mb, ttl)));
+          _mm_store_ps (streams.colorAlpha + i, _mm_add_ps (aa, _mm_mul_ps (ma, ttl)));
+        }
+      }
+#endif
+
+      for (; i < count; i++)
+      {
+        const float ttl = timeToLive[i];
+
+        size_t e;
+        for (e = 0; e < numEntries - 1; e++)
+        {
+          if (ttl < ramp[e].maxTTL)
+            break;
+        }
+
+        const ColorRampEntry& entry = ramp[e];
+        streams.colorRed[i] = entry.add.red + entry.mult.red * ttl;
+        streams.colorGreen[i] = entry.add.green + entry.mult.green * ttl;
+        streams.colorBlue[i] = entry.add.blue + entry.mult.blue * ttl;
+        streams.colorAlpha[i] = entry.add.alpha + entry.mult.alpha * ttl;
+      }
+    }
+  } // namespace StreamOps
+}
+CS_PLUGIN_NAMESPACE_END(Particles)
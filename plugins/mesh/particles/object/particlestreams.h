@@ -0,0 +1,111 @@
+/*
+  Copyright (C) 2026 by Crystal Space Development Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_MESH_PARTICLESTREAMS_H__
+#define __CS_MESH_PARTICLESTREAMS_H__
+
+#include "imesh/particles.h"
+
+/**\file
+ * Storage of and operations on particle streams
+ */
+
+CS_PLUGIN_NAMESPACE_BEGIN(Particles)
+{
+  /**
+   * Owner of the memory of a csParticleStreams.
+   */
+  class ParticleStreamStorage
+  {
+  public:
+    ParticleStreamStorage ();
+    ~ParticleStreamStorage ();
+
+    /// Make room for \a size particles, keeping the current ones.
+    void Reserve (size_t size);
+    /// Free all memory
+    void Clear ();
+
+    const csParticleStreams& GetStreams () const { return streams; }
+    size_t GetParticleCount () const { return streams.particleCount; }
+    void SetParticleCount (size_t count) { streams.particleCount = count; }
+
+    /// Copy the stream members of the given particle records into the streams
+    void CopyFromRecords (const csParticleBuffer& buffer, size_t first,
+      size_t last);
+    /// Copy the streams into the given particle records
+    void CopyToRecords (const csParticleBuffer& buffer, size_t first,
+      size_t last) const;
+    /// Copy the data of particle \a from over particle \a to
+    void MoveParticle (size_t from, size_t to);
+
+  private:
+    csParticleStreams streams;
+    float* block;
+    size_t allocatedSize;
+  };
+
+  /// Linear interpolation of the color for a time to live span
+  struct ColorRampEntry
+  {
+    csColor4 mult;
+    csColor4 add;
+    float maxTTL;
+  };
+
+  /**
+   * Operations on particle streams. If supported by the processor, these
+   * process four particles at once.
+   */
+  namespace StreamOps
+  {
+    /// Whether the operations use SIMD instructions
+    bool IsSIMDAvailable ();
+
+    /**
+     * Decrease the time to live of all particles by \a dt. Particles with
+     * a negative time to live are removed by moving the last particle
+     * over them, both in the streams and in \a buffer.
+     */
+    void RetireParticles (ParticleStreamStorage& storage,
+      csParticleBuffer& buffer, float dt);
+
+    /**
+     * Move the particles from \a first to \a last (exclusive) along
+     * their linear velocity. \a radiusSq is increased to the largest
+     * squared distance of these particles to the origin.
+     */
+    void IntegrateLinear (const csParticleStreams& streams, size_t first,
+      size_t last, float dt, float& radiusSq);
+
+    /// Add <tt>(acceleration + force / mass) * dt</tt> to the velocities.
+    void ApplyForce (const csParticleStreams& streams,
+      const csVector3& acceleration, const csVector3& force, float dt);
+
+    /**
+     * Set the color of each particle from the first entry of \a ramp
+     * whose maximum time to live is larger than the time to live of the
+     * particle, or from the last entry if there is none.
+     */
+    void ApplyColorRamp (const csParticleStreams& streams,
+      const ColorRampEntry* ramp, size_t numEntries);
+  } // namespace StreamOps
+}
+CS_PLUGIN_NAMESPACE_END(Particles)
+
+#endif
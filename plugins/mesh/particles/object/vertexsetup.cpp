@@ -25,6 +25,74 @@
 CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 {
 
+  // Access to the particle data stored in the particle records
+  class RecordAccess
+  {
+  public:
+    CS_FORCEINLINE RecordAccess (const csParticleBuffer& buffer)
+      : buffer (buffer)
+    {}
+
+    CS_FORCEINLINE const csVector3& GetPosition (size_t idx) const
+    {
+      return buffer.particleData[idx].position;
+    }
+
+    CS_FORCEINLINE const csVector3& GetLinearVelocity (size_t idx) const
+    {
+      return buffer.particleData[idx].linearVelocity;
+    }
+
+    CS_FORCEINLINE const csQuaternion& GetOrientation (size_t idx) const
+    {
+      return buffer.particleData[idx].orientation;
+    }
+
+    CS_FORCEINLINE const csVector2& GetParticleSize (size_t idx) const
+    {
+      return buffer.particleAuxData[idx].particleSize;
+    }
+
+  private:
+    const csParticleBuffer& buffer;
+  };
+
+  // Access to the particle data stored in the particle streams
+  class StreamAccess
+  {
+  public:
+    CS_FORCEINLINE StreamAccess (const csParticleStreams& streams,
+                                 const csParticleBuffer& buffer)
+      : streams (streams), buffer (buffer)
+    {}
+
+    CS_FORCEINLINE csVector3 GetPosition (size_t idx) const
+    {
+      return csVector3 (streams.positionX[idx], streams.positionY[idx],
+        streams.positionZ[idx]);
+    }
+
+    CS_FORCEINLINE csVector3 GetLinearVelocity (size_t idx) const
+    {
+      return csVector3 (streams.linearVelocityX[idx],
+        streams.linearVelocityY[idx], streams.linearVelocityZ[idx]);
+    }
+
+    CS_FORCEINLINE const csQuaternion& GetOrientation (size_t idx) const
+    {
+      return buffer.particleData[idx].orientation;
+    }
+
+    CS_FORCEINLINE const csVector2& GetParticleSize (size_t idx) const
+    {
+      return buffer.particleAuxData[idx].particleSize;
+    }
+
+  private:
+    const csParticleStreams& streams;
+    const csParticleBuffer& buffer;
+  };
+
   // Different ways to compute the XY coordinates
   class ConstantCameraDir
   {
@@ -39,7 +107,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       y = o2c.GetUp ();
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {}
 
     CS_FORCEINLINE const csVector3& GetX () const
@@ -69,9 +138,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       camUp = o2c.GetUp ();
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {
-      const csVector3 camDir = particle.position - camCenter;
+      const csVector3 camDir = access.GetPosition (idx) - camCenter;
 
       // Calculate x and y dir
       x = (camUp % camDir).Unit ();
@@ -106,7 +176,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       y = commonDir;
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {
     }
 
@@ -137,9 +208,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       y = commonDir;
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {
-      const csVector3 camDir = particle.position - camCenter;
+      const csVector3 camDir = access.GetPosition (idx) - camCenter;
 
       // Calculate x and y dir
 
@@ -172,16 +244,18 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       camCenter = o2c.GetOrigin ();
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {
-      const csVector3 camDir = particle.position - camCenter;
+      const csVector3 camDir = access.GetPosition (idx) - camCenter;
 
       // Calculate x and y dir
-      float vnSq = particle.linearVelocity.SquaredNorm ();
+      const csVector3 linearVelocity = access.GetLinearVelocity (idx);
+      float vnSq = linearVelocity.SquaredNorm ();
       if (vnSq == 0)
         y.Set (0.0f, 1.0f, 0.0f);
       else
-        y = particle.linearVelocity / sqrtf(vnSq);
+        y = linearVelocity / sqrtf(vnSq);
 
       x = (y % camDir).Unit ();
     }
@@ -211,9 +285,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     {
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {
-      const csMatrix3 base = particle.orientation.GetMatrix ();
+      const csMatrix3 base = access.GetOrientation (idx).GetMatrix ();
       x = base.Col1 ();
       y = base.Col2 ();
     }
@@ -244,11 +319,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       camCenter = o2c.GetOrigin ();
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {
-      const csVector3 camDir = particle.position - camCenter;
+      const csVector3 camDir = access.GetPosition (idx) - camCenter;
 
-      const csMatrix3 base = particle.orientation.GetMatrix ();
+      const csMatrix3 base = access.GetOrientation (idx).GetMatrix ();
       if (base.Col3 () * camDir > 0)
         x = base.Col1 ();
       else
@@ -286,8 +362,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       size = s;
     }
 
-    CS_FORCEINLINE void Update (const csParticle& particle, 
-      const csParticleAux& aux)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {}
 
     CS_FORCEINLINE float GetX () const
@@ -313,10 +389,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
     CS_FORCEINLINE void Init (const csVector2& s)
     {}
 
-    CS_FORCEINLINE void Update (const csParticle& particle, 
-      const csParticleAux& aux)
+    template<class Access>
+    CS_FORCEINLINE void Update (const Access& access, size_t idx)
     {
-      size = aux.particleSize;
+      size = access.GetParticleSize (idx);
     }
 
     CS_FORCEINLINE float GetX () const
@@ -353,11 +429,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       partSize.Init (particleSize);
     }
 
+    template<class Access>
     CS_FORCEINLINE_TEMPLATEMETHOD
-    void Update (const csParticle& particle, const csParticleAux& aux)
+    void Update (const Access& access, size_t idx)
     {
-      partDir.Update (particle);
-      partSize.Update (particle, aux);
+      partDir.Update (access, idx);
+      partSize.Update (access, idx);
     }
    
   protected:
@@ -376,21 +453,33 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       : BaseVertexSetup<ParticleDirT, ParticleSizeT> ()
     {}
 
-    CS_FORCEINLINE_TEMPLATEMETHOD
     void SetupVertices (const csParticleBuffer particleBuffer,
       csVector3* vertexBuffer)
     {
-      for (size_t pidx = 0; pidx < particleBuffer.particleCount; ++pidx)
-      {
-        const csParticle& particle = particleBuffer.particleData[pidx];
-        const csParticleAux& aux = particleBuffer.particleAuxData[pidx];
+      Setup (RecordAccess (particleBuffer), particleBuffer.particleCount,
+        vertexBuffer);
+    }
+
+    void SetupVertices (const csParticleStreams& particleStreams,
+      const csParticleBuffer particleBuffer, csVector3* vertexBuffer)
+    {
+      Setup (StreamAccess (particleStreams, particleBuffer),
+        particleBuffer.particleCount, vertexBuffer);
+    }
 
-        this->Update (particle, aux);
+    template<class Access>
+    CS_FORCEINLINE_TEMPLATEMETHOD
+    void Setup (const Access& access, size_t particleCount,
+      csVector3* vertexBuffer)
+    {
+      for (size_t pidx = 0; pidx < particleCount; ++pidx)
+      {
+        this->Update (access, pidx);
         
         const csVector3 partX = this->partDir.GetX () * this->partSize.GetX ();
         const csVector3 partY = this->partDir.GetY () * this->partSize.GetY ();
 
-        const csVector3& particleCenter = particle.position;
+        const csVector3 particleCenter = access.GetPosition (pidx);
 
         vertexBuffer[0] = particleCenter - partX + partY;
         vertexBuffer[1] = particleCenter + partX + partY;
@@ -412,20 +501,32 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
       : BaseVertexSetup<ParticleDirT, ParticleSizeT> ()
     {}
 
-    CS_FORCEINLINE_TEMPLATEMETHOD
     void SetupVertices (const csParticleBuffer particleBuffer,
       csVector3* vertexBuffer)
     {
-      for (size_t pidx = 0; pidx < particleBuffer.particleCount; ++pidx)
-      {
-        const csParticle& particle = particleBuffer.particleData[pidx];
-        const csParticleAux& aux = particleBuffer.particleAuxData[pidx];
+      Setup (RecordAccess (particleBuffer), particleBuffer.particleCount,
+        vertexBuffer);
+    }
 
-        this->Update (particle, aux);
+    void SetupVertices (const csParticleStreams& particleStreams,
+      const csParticleBuffer particleBuffer, csVector3* vertexBuffer)
+    {
+      Setup (StreamAccess (particleStreams, particleBuffer),
+        particleBuffer.particleCount, vertexBuffer);
+    }
+
+    template<class Access>
+    CS_FORCEINLINE_TEMPLATEMETHOD
+    void Setup (const Access& access, size_t particleCount,
+      csVector3* vertexBuffer)
+    {
+      for (size_t pidx = 0; pidx < particleCount; ++pidx)
+      {
+        this->Update (access, pidx);
 
         csVector3 tmpV;
         float rot;
-        particle.orientation.GetAxisAngle (tmpV, rot);
+        access.GetOrientation (pidx).GetAxisAngle (tmpV, rot);
         const float r = rot + PI/4;
         const float s = sinf(r);
         const float c = cosf(r);
@@ -436,7 +537,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
         csVector3 partX = this->partDir.GetX () * (pX*c - pY*s);
         csVector3 partY = this->partDir.GetY () * (pX*s + pY*c);
 
-        const csVector3& particleCenter = particle.position;
+        const csVector3 particleCenter = access.GetPosition (pidx);
 
         vertexBuffer[0] = particleCenter - partX + partY;
         vertexBuffer[2] = particleCenter + partX - partY;
@@ -37,6 +37,9 @@ CS_PLUGIN_NAMESPACE_BEGIN(Particles)
 
     virtual void SetupVertices (const csParticleBuffer particleBuffer,
       csVector3* vertexBuffer) = 0;
+
+    virtual void SetupVertices (const csParticleStreams& particleStreams,
+      const csParticleBuffer particleBuffer, csVector3* vertexBuffer) = 0;
   };
 
   // Function to get a pointer to a vertex setup
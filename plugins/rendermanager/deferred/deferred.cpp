@@ -37,6 +37,7 @@
 #include "iengine.h"
 #include "ivideo.h"
 #include "ivaria/reporter.h"
+#include "ivaria/profile.h"
 #include "csutil/cfgacc.h"
 
 #include "deferredoperations.h"
@@ -51,6 +52,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
 
 SCF_IMPLEMENT_FACTORY(RMDeferred);
 
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(RMDeferred_RenderView)
+CS_DECLARE_PROFILER_ZONE(RMDeferred_RenderView_Setup)
+CS_DECLARE_PROFILER_ZONE(RMDeferred_RenderView_Targets)
+CS_DECLARE_PROFILER_ZONE(RMDeferred_RenderView_Draw)
+
 //----------------------------------------------------------------------
 
 template<typename RenderTreeType, typename LayerConfigType>
@@ -437,6 +444,12 @@ bool RMDeferred::Initialize(iObjectRegistry *registry)
   viewHeight = graphics2D->GetHeight ();
 
   treePersistent.Initialize (shaderManager);
+  treePersistent.SetupParallelOperations (registry,
+    cfg->GetInt ("RenderManager.OperationThreads", 0));
+  treePersistent.SetupFrameArenaReport (registry);
+  treePersistent.instanceBatching.SetEnabled (
+    cfg->GetBool ("RenderManager.InstanceBatching", true));
+  treePersistent.instanceBatching.EnableShaderLoading (registry);
   portalPersistent.Initialize (objRegistry, treePersistent.debugPersist);
   lightPersistent.shadowPersist.SetConfigPrefix ("RenderManager.Deferred");
   lightPersistent.Initialize (registry, treePersistent.debugPersist);
@@ -475,6 +488,7 @@ bool RMDeferred::Initialize(iObjectRegistry *registry)
 #include "csutil/deprecated_warn_off.h"
 bool RMDeferred::RenderView(iView *view, bool recursePortals)
 {
+  CS_PROFILER_ZONE(RMDeferred_RenderView)
   iGraphics3D *graphics3D = view->GetContext ();
 
   int frameWidth = graphics3D->GetWidth ();
@@ -539,6 +553,7 @@ bool RMDeferred::RenderView(iView *view, bool recursePortals)
 
   // Setup the main context
   {
+    CS_PROFILER_ZONE(RMDeferred_RenderView_Setup)
     ContextSetupType contextSetup (this, renderLayer);
     ContextSetupType::PortalSetupType::ContextSetupData portalData (startContext);
 
@@ -551,6 +566,7 @@ bool RMDeferred::RenderView(iView *view, bool recursePortals)
   // Setup all dependent targets
   while (targets.HaveMoreTargets ())
   {
+    CS_PROFILER_ZONE(RMDeferred_RenderView_Targets)
     TargetManagerType::TargetSettings ts;
     targets.GetNextTarget (ts);
 
@@ -561,6 +577,7 @@ bool RMDeferred::RenderView(iView *view, bool recursePortals)
 
   // Render all contexts.
   {
+    CS_PROFILER_ZONE(RMDeferred_RenderView_Draw)
     DeferredTreeRenderer<RenderTreeType, ShadowType>
     render(graphics3D, shaderManager, lightRenderPersistent, gbuffer,
 	   deferredLayer, lightingLayer, zonlyLayer, drawLightVolumes);
@@ -266,6 +266,12 @@ struct WrapShadowParams<RMOSM::ShadowType>
 
     csRef<iGraphics3D> g3d = csQueryRegistry<iGraphics3D> (objectReg);
     treePersistent.Initialize (shaderManager);
+    treePersistent.SetupParallelOperations (objectReg,
+      cfg->GetInt ("RenderManager.OperationThreads", 0));
+    treePersistent.SetupFrameArenaReport (objectReg);
+    treePersistent.instanceBatching.SetEnabled (
+      cfg->GetBool ("RenderManager.InstanceBatching", true));
+    treePersistent.instanceBatching.EnableShaderLoading (objectReg);
     dbgFlagClipPlanes =
       treePersistent.debugPersist.RegisterDebugFlag ("draw.clipplanes.view");
 
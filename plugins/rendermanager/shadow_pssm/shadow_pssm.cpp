@@ -39,6 +39,7 @@
 
 #include "iutil/verbositymanager.h"
 #include "ivaria/reporter.h"
+#include "ivaria/profile.h"
 #include "csutil/stringquote.h"
 
 using namespace CS::RenderManager;
@@ -48,6 +49,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMShadowedPSSM)
 
 SCF_IMPLEMENT_FACTORY(RMShadowedPSSM)
 
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(RMShadowedPSSM_RenderView)
+CS_DECLARE_PROFILER_ZONE(RMShadowedPSSM_RenderView_Setup)
+CS_DECLARE_PROFILER_ZONE(RMShadowedPSSM_RenderView_Targets)
+CS_DECLARE_PROFILER_ZONE(RMShadowedPSSM_RenderView_Draw)
+
 
 /* Template magic to deal with different initializers for different
    ShadowType::ShadowParameter types. */
@@ -367,6 +374,7 @@ RMShadowedPSSM::RMShadowedPSSM (iBase* parent)
 #include "csutil/deprecated_warn_off.h"
 bool RMShadowedPSSM::RenderView (iView* view, bool recursePortals)
 {
+  CS_PROFILER_ZONE(RMShadowedPSSM_RenderView)
   // Setup a rendering view
   csRef<CS::RenderManager::RenderView> rview;
   rview = treePersistent.renderViews.GetRenderView (view);
@@ -407,6 +415,7 @@ bool RMShadowedPSSM::RenderView (iView* view, bool recursePortals)
 
   // Setup the main context
   {
+    CS_PROFILER_ZONE(RMShadowedPSSM_RenderView_Setup)
     ContextSetupType contextSetup (this, lightPersistent, renderLayer);
     ContextSetupType::PortalSetupType::ContextSetupData portalData (startContext);
 
@@ -419,6 +428,7 @@ bool RMShadowedPSSM::RenderView (iView* view, bool recursePortals)
   // Setup all dependent targets
   while (targets.HaveMoreTargets ())
   {
+    CS_PROFILER_ZONE(RMShadowedPSSM_RenderView_Targets)
     TargetManagerType::TargetSettings ts;
     targets.GetNextTarget (ts);
 
@@ -429,6 +439,7 @@ bool RMShadowedPSSM::RenderView (iView* view, bool recursePortals)
   
   // Render all contexts, back to front
   {
+    CS_PROFILER_ZONE(RMShadowedPSSM_RenderView_Draw)
     view->GetContext()->SetZMode (CS_ZBUF_MESH);
 
     SimpleTreeRenderer<RenderTreeType> render (rview->GetGraphics3D (),
@@ -573,6 +584,12 @@ bool RMShadowedPSSM::Initialize(iObjectRegistry* objectReg)
   
   csRef<iGraphics3D> g3d = csQueryRegistry<iGraphics3D> (objectReg);
   treePersistent.Initialize (shaderManager);
+  treePersistent.SetupParallelOperations (objectReg,
+    cfg->GetInt ("RenderManager.OperationThreads", 0));
+  treePersistent.SetupFrameArenaReport (objectReg);
+  treePersistent.instanceBatching.SetEnabled (
+    cfg->GetBool ("RenderManager.InstanceBatching", true));
+  treePersistent.instanceBatching.EnableShaderLoading (objectReg);
   dbgFlagClipPlanes =
     treePersistent.debugPersist.RegisterDebugFlag ("draw.clipplanes.view");
   PostEffectsSupport::Initialize (objectReg, "RenderManager.ShadowPSSM");
@@ -39,6 +39,7 @@
 
 #include "iutil/verbositymanager.h"
 #include "ivaria/reporter.h"
+#include "ivaria/profile.h"
 #include "csutil/cfgacc.h"
 #include "csutil/stringquote.h"
 
@@ -49,6 +50,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMUnshadowed)
 
 SCF_IMPLEMENT_FACTORY(RMUnshadowed)
 
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(RMUnshadowed_RenderView)
+CS_DECLARE_PROFILER_ZONE(RMUnshadowed_RenderView_Setup)
+CS_DECLARE_PROFILER_ZONE(RMUnshadowed_RenderView_Targets)
+CS_DECLARE_PROFILER_ZONE(RMUnshadowed_RenderView_Draw)
+
 
 template<typename RenderTreeType, typename LayerConfigType>
 class StandardContextSetup
@@ -225,6 +232,7 @@ RMUnshadowed::RMUnshadowed (iBase* parent)
 #include "csutil/deprecated_warn_off.h"
 bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
 {
+  CS_PROFILER_ZONE(RMUnshadowed_RenderView)
   // Setup a rendering view
   csRef<CS::RenderManager::RenderView> rview;
   rview = treePersistent.renderViews.GetRenderView (view);
@@ -266,6 +274,7 @@ bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
 
   // Setup the main context
   {
+    CS_PROFILER_ZONE(RMUnshadowed_RenderView_Setup)
     ContextSetupType contextSetup (this, renderLayer);
     ContextSetupType::PortalSetupType::ContextSetupData portalData (startContext);
 
@@ -278,6 +287,7 @@ bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
   // Setup all dependent targets
   while (targets.HaveMoreTargets ())
   {
+    CS_PROFILER_ZONE(RMUnshadowed_RenderView_Targets)
     TargetManagerType::TargetSettings ts;
     targets.GetNextTarget (ts);
 
@@ -288,6 +298,7 @@ bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
 
   // Render all contexts, back to front
   {
+    CS_PROFILER_ZONE(RMUnshadowed_RenderView_Draw)
     view->GetContext()->SetZMode (CS_ZBUF_MESH);
 
     SimpleTreeRenderer<RenderTreeType> render (rview->GetGraphics3D (),
@@ -431,6 +442,12 @@ bool RMUnshadowed::Initialize(iObjectRegistry* objectReg)
   
   csRef<iGraphics3D> g3d = csQueryRegistry<iGraphics3D> (objectReg);
   treePersistent.Initialize (shaderManager);
+  treePersistent.SetupParallelOperations (objectReg,
+    cfg->GetInt ("RenderManager.OperationThreads", 0));
+  treePersistent.SetupFrameArenaReport (objectReg);
+  treePersistent.instanceBatching.SetEnabled (
+    cfg->GetBool ("RenderManager.InstanceBatching", true));
+  treePersistent.instanceBatching.EnableShaderLoading (objectReg);
   dbgFlagClipPlanes =
     treePersistent.debugPersist.RegisterDebugFlag ("draw.clipplanes.view");
     
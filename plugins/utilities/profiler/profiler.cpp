@@ -22,6 +22,7 @@
 
 #include "profiler.h"
 #include "csutil/csstring.h"
+#include "csutil/databuf.h"
 #include "csutil/platformfile.h"
 #include "csutil/scf.h"
 #include "iutil/vfs.h"
@@ -61,15 +62,35 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
   }
 
 
+  enum
+  {
+    /// Number of events buffered per thread between collections
+    threadBufferCapacity = 16384
+  };
+
+  // Called when a thread with an event buffer exits
+  static void ReleaseThreadBuffer (void* buffer)
+  {
+    CS::Threading::AtomicOperations::Set (
+      &static_cast<ProfileEventBuffer*> (buffer)->released, 1);
+  }
+
   Profiler::Profiler ()
-    : scfImplementationType (this), nativeLogfile (0),
-    logfileNameHelper ("profile_log0000.csv"), isLogging (false)
+    : scfImplementationType (this), ProfileEventRecorder (ReleaseThreadBuffer),
+    nextThreadId (0), recordingStartTime (0), droppedEvents (0),
+    nativeLogfile (0), logfileNameHelper ("profile_log0000.csv"),
+    isLogging (false)
   {    
+    calibrationTimestamp = ProfileTimestamp ();
+    calibrationMicroTicks = csGetMicroTicks ();
+    microsecondsPerTimestamp = 1;
   }
 
   Profiler::~Profiler ()
   {
-
+    recording = 0;
+    for (size_t i = 0; i < threadBuffers.GetSize (); ++i)
+      delete threadBuffers[i];
   }
 
   static int ZoneFindFun (ProfileZone* const& zone, csString const& name)
@@ -79,6 +100,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
   CS::Debug::ProfileZone* Profiler::GetProfileZone (const char* zonename)
   {
+    CS::Threading::MutexScopedLock lock (listMutex);
     ProfileZone* zone = 0;
 
     size_t index = allZones.FindKey (csArrayCmp<ProfileZone* , csString> (zonename, ZoneFindFun));
@@ -88,6 +110,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
       //Allocate a new one
       zone = zoneAllocator.Alloc ();
       zone->zoneName = csStrNew (zonename);
+      zone->recorder = this;
       allZones.Push (zone);
     }
     else
@@ -105,6 +128,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
   CS::Debug::ProfileCounter* Profiler::GetProfileCounter (const char* countername)
   {
+    CS::Threading::MutexScopedLock lock (listMutex);
     ProfileCounter* counter = 0;
     size_t index = allCounters.FindKey (csArrayCmp<ProfileCounter* , csString> (countername, CounterFindFun));
 
@@ -125,13 +149,22 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
   void Profiler::Reset ()
   {
+    // Keep the thread buffers from overflowing
+    if (recording)
+      CollectEvents ();
+
+    CS::Threading::MutexScopedLock lock (listMutex);
+
     // Dump to file if we have one
     if (isLogging && allZones.GetSize () > 0)
     {
+      UpdateCalibration ();
       csString data, data2;
       for (size_t i = 0; i < allZones.GetSize (); ++i)
       {
-        data2.Format ("%" PRIu64 ", %u, ", allZones[i]->totalTime, allZones[i]->enterCount);
+        data2.Format ("%" PRIu64 ", %u, ",
+          uint64 (TimestampToMicroseconds (allZones[i]->GetTotalTime ())),
+          allZones[i]->GetEnterCount ());
         data.Append (data2);
       }
       data.Append ("\n");
@@ -142,14 +175,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
     for (size_t i = 0; i < allZones.GetSize (); ++i)
     {
       ProfileZone* zone = allZones[i];
-      zone->totalTime = 0;
-      zone->enterCount = 0;
+      zone->threadTimes.Reset ();
     }
 
     for (size_t i = 0; i < allCounters.GetSize(); ++i)
     {
       ProfileCounter* counter = allCounters[i];
-      counter->counterValue = 0;
+      counter->threadValues.Reset ();
     }
   }
 
@@ -163,6 +195,18 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
     return allCounters;
   }
 
+  // Name of the trace file written along with a log file
+  static csString TraceFilename (const csString& logFilename)
+  {
+    csString filename (logFilename);
+    size_t dot = filename.FindLast ('.');
+    size_t slash = filename.FindLast ('/');
+    if ((dot != (size_t)-1) && ((slash == (size_t)-1) || (dot > slash)))
+      filename.Truncate (dot);
+    filename.Append (".json");
+    return filename;
+  }
+
   void Profiler::StartLogging (const char* filenamebase, iObjectRegistry* objectreg)
   {
     // Get a vfs pointer
@@ -183,19 +227,29 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
     {
       csVfsDirectoryChanger dirCh (vfs);
       dirCh.ChangeTo ("/tmp");
-      logfile = vfs->Open (logfileNameHelper.FindNextFilename (vfs), VFS_FILE_WRITE);
+      csString filename (logfileNameHelper.FindNextFilename (vfs));
+      logfile = vfs->Open (filename, VFS_FILE_WRITE);
 
       if (logfile)
+      {
         isLogging = true;
+        traceVFS = vfs;
+        traceFilename = TraceFilename (filename);
+      }
     }
     {
       // Use native logging
-      nativeLogfile = CS::Platform::File::Open (logfileNameHelper.FindNextFilename (), "w");
+      csString filename (logfileNameHelper.FindNextFilename ());
+      nativeLogfile = CS::Platform::File::Open (filename, "w");
       if (nativeLogfile)
+      {
         isLogging = true;
+        nativeTraceFilename = TraceFilename (filename);
+      }
     }
 
-
+    if (isLogging)
+      StartEventRecording ();
   }
 
   void Profiler::StopLogging ()
@@ -203,8 +257,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
     if (!isLogging)
       return;
 
+    StopEventRecording ();
+    WriteTrace ();
+
     // Write column headers at the end. This isn't really csv format, but we do
     // this to cope with any added columns during profiling
+    CS::Threading::MutexScopedLock lock (listMutex);
     csString data, data2;
     for (size_t i = 0; i < allZones.GetSize (); ++i)
     {
@@ -227,9 +285,203 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
       nativeLogfile = 0;
     }
 
+    traceVFS.Invalidate ();
+    traceFilename.Empty ();
+    nativeTraceFilename.Empty ();
     isLogging = false;
   }
 
+  double Profiler::TimestampToMicroseconds (uint64 timestamp)
+  {
+    return timestamp * microsecondsPerTimestamp;
+  }
+
+  void Profiler::UpdateCalibration ()
+  {
+    uint64 timestamp = ProfileTimestamp ();
+    int64 microTicks = csGetMicroTicks ();
+    /* The longer the span the more precise the result; below a millisecond
+       the resolution of csGetMicroTicks() dominates. */
+    if ((microTicks - calibrationMicroTicks < 1000)
+        || (timestamp <= calibrationTimestamp))
+      return;
+    microsecondsPerTimestamp = double (microTicks - calibrationMicroTicks)
+      / double (timestamp - calibrationTimestamp);
+  }
+
+  CS::Debug::ProfileEventBuffer* Profiler::CreateThreadBuffer ()
+  {
+    CS::Threading::MutexScopedLock lock (eventMutex);
+
+    uint32 threadId = uint32 (
+      CS::Threading::AtomicOperations::Increment (&nextThreadId));
+    // Reuse the buffer of a thread that exited
+    for (size_t i = 0; i < threadBuffers.GetSize (); ++i)
+    {
+      ProfileEventBuffer* buffer = threadBuffers[i];
+      if (!CS::Threading::AtomicOperations::Read (&buffer->released))
+        continue;
+
+      ProfileEvent event;
+      while (buffer->Pop (event))
+      {
+        RecordedEvent& recorded = recordedEvents.GetExtend (
+          recordedEvents.GetSize ());
+        recorded.event = event;
+        recorded.threadId = buffer->threadId;
+      }
+      droppedEvents += buffer->droppedEvents;
+      buffer->droppedEvents = 0;
+      buffer->threadId = threadId;
+      buffer->released = 0;
+      return buffer;
+    }
+
+    ProfileEventBuffer* buffer = new ProfileEventBuffer (threadId,
+      threadBufferCapacity);
+    threadBuffers.Push (buffer);
+    return buffer;
+  }
+
+  void Profiler::CollectEvents ()
+  {
+    CS::Threading::MutexScopedLock lock (eventMutex);
+
+    for (size_t i = 0; i < threadBuffers.GetSize (); ++i)
+    {
+      ProfileEventBuffer* buffer = threadBuffers[i];
+      ProfileEvent event;
+      while (buffer->Pop (event))
+      {
+        RecordedEvent& recorded = recordedEvents.GetExtend (
+          recordedEvents.GetSize ());
+        recorded.event = event;
+        recorded.threadId = buffer->threadId;
+      }
+    }
+  }
+
+  void Profiler::StartEventRecording ()
+  {
+    {
+      CS::Threading::MutexScopedLock lock (eventMutex);
+      // Discard anything left over from earlier recordings
+      for (size_t i = 0; i < threadBuffers.GetSize (); ++i)
+      {
+        ProfileEventBuffer* buffer = threadBuffers[i];
+        ProfileEvent event;
+        while (buffer->Pop (event)) {}
+        buffer->droppedEvents = 0;
+      }
+      recordedEvents.Empty ();
+      droppedEvents = 0;
+      recordingStartTime = ProfileTimestamp ();
+    }
+    CS::Threading::AtomicOperations::Set ((int32*)&recording, 1);
+  }
+
+  void Profiler::StopEventRecording ()
+  {
+    CS::Threading::AtomicOperations::Set ((int32*)&recording, 0);
+    CollectEvents ();
+    UpdateCalibration ();
+  }
+
+  // Append a string as JSON string literal
+  static void AppendJSONString (csString& out, const char* str)
+  {
+    out.Append ('"');
+    for (; *str; str++)
+    {
+      switch (*str)
+      {
+        case '"':  out.Append ("\\\""); break;
+        case '\\': out.Append ("\\\\"); break;
+        default:
+          if ((unsigned char)*str < 0x20)
+            out.AppendFmt ("\\u%04x", (unsigned char)*str);
+          else
+            out.Append (*str);
+      }
+    }
+    out.Append ('"');
+  }
+
+  csPtr<iDataBuffer> Profiler::GetChromeTrace ()
+  {
+    if (recording)
+      CollectEvents ();
+    UpdateCalibration ();
+
+    CS::Threading::MutexScopedLock lock (eventMutex);
+
+    csString trace ("{\"traceEvents\":[\n");
+    bool first = true;
+
+    // Name the threads; the ids are assigned in order of first appearance
+    int32 numThreads = CS::Threading::AtomicOperations::Read (&nextThreadId);
+    for (int32 t = 1; t <= numThreads; t++)
+    {
+      if (!first) trace.Append (",\n");
+      first = false;
+      trace.AppendFmt ("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+        "\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}", t, t);
+    }
+
+    for (size_t i = 0; i < recordedEvents.GetSize (); ++i)
+    {
+      const RecordedEvent& recorded = recordedEvents[i];
+      const ProfileEvent& event = recorded.event;
+      // Events may have started before the recording did
+      double start = (event.startTime >= recordingStartTime)
+        ? TimestampToMicroseconds (event.startTime - recordingStartTime)
+        : -TimestampToMicroseconds (recordingStartTime - event.startTime);
+      double duration = TimestampToMicroseconds (
+        event.endTime - event.startTime);
+
+      if (!first) trace.Append (",\n");
+      first = false;
+      trace.Append ("{\"name\":");
+      AppendJSONString (trace, event.zone->zoneName);
+      trace.AppendFmt (",\"cat\":\"cs\",\"ph\":\"X\",\"ts\":%.3f,"
+        "\"dur\":%.3f,\"pid\":1,\"tid\":%u}", start, duration,
+        recorded.threadId);
+    }
+
+    uint32 dropped = droppedEvents;
+    for (size_t i = 0; i < threadBuffers.GetSize (); ++i)
+      dropped += threadBuffers[i]->droppedEvents;
+    trace.AppendFmt ("\n],\"displayTimeUnit\":\"ms\","
+      "\"otherData\":{\"droppedEvents\":%u}}\n", dropped);
+
+    csRef<iDataBuffer> buffer;
+    buffer.AttachNew (new CS::DataBuffer<> (trace.Length ()));
+    memcpy (buffer->GetData (), trace.GetData (), trace.Length ());
+    return csPtr<iDataBuffer> (buffer);
+  }
+
+  void Profiler::WriteTrace ()
+  {
+    csRef<iDataBuffer> trace (GetChromeTrace ());
+
+    if (traceVFS && !traceFilename.IsEmpty ())
+    {
+      csVfsDirectoryChanger dirCh (traceVFS);
+      dirCh.ChangeTo ("/tmp");
+      traceVFS->WriteFile (traceFilename, trace->GetData (), trace->GetSize ());
+    }
+
+    if (!nativeTraceFilename.IsEmpty ())
+    {
+      FILE* file = CS::Platform::File::Open (nativeTraceFilename, "w");
+      if (file)
+      {
+        fwrite (trace->GetData (), 1, trace->GetSize (), file);
+        fclose (file);
+      }
+    }
+  }
+
   void Profiler::WriteLogEntry (const csString& entry, bool flush /* = false */)
   {
     if (logfile)
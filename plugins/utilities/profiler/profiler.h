@@ -23,8 +23,10 @@
 #include "csutil/scf_implementation.h"
 #include "cstool/numberedfilenamehelper.h"
 #include "csutil/csstring.h"
+#include "csutil/threading/mutex.h"
 
 struct iFile;
+struct iVFS;
 
 CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 {
@@ -41,7 +43,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
 
   class Profiler : 
-    public scfImplementation1<Profiler, iProfiler>
+    public scfImplementation1<Profiler, iProfiler>,
+    public CS::Debug::ProfileEventRecorder
   {
   public:
     Profiler ();
@@ -60,21 +63,61 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
     void StartLogging (const char* filenamebase, iObjectRegistry* objectreg);
     void StopLogging ();
 
+    double TimestampToMicroseconds (uint64 timestamp);
+
+    void StartEventRecording ();
+    void StopEventRecording ();
+    csPtr<iDataBuffer> GetChromeTrace ();
+
+  protected:
+    CS::Debug::ProfileEventBuffer* CreateThreadBuffer ();
+
   private:
+    // Protects the zone and counter lists
+    CS::Threading::Mutex listMutex;
     csArray<CS::Debug::ProfileZone*> allZones;
     csArray<CS::Debug::ProfileCounter*> allCounters;
 
     csBlockAllocator<CS::Debug::ProfileZone> zoneAllocator;
     csBlockAllocator<CS::Debug::ProfileCounter> counterAllocator;
 
+    // Event recording related
+    struct RecordedEvent
+    {
+      CS::Debug::ProfileEvent event;
+      uint32 threadId;
+    };
+    // Protects the thread buffers and the recorded events
+    CS::Threading::Mutex eventMutex;
+    csArray<CS::Debug::ProfileEventBuffer*> threadBuffers;
+    csArray<RecordedEvent> recordedEvents;
+    int32 nextThreadId;
+    uint64 recordingStartTime;
+    uint32 droppedEvents;
+
+    // Timestamp calibration
+    uint64 calibrationTimestamp;
+    int64 calibrationMicroTicks;
+    double microsecondsPerTimestamp;
+
     // Logging related
     csRef<iFile> logfile;
     FILE* nativeLogfile;
     CS::NumberedFilenameHelper logfileNameHelper;
     bool isLogging;
+    csRef<iVFS> traceVFS;
+    csString traceFilename;
+    csString nativeTraceFilename;
 
     // Helper function to write a string to the logfile (independent of type)
     void WriteLogEntry (const csString& entry, bool flush = false);
+
+    // Move the events from the thread buffers to recordedEvents
+    void CollectEvents ();
+    // Measure the timestamp frequency against csGetMicroTicks()
+    void UpdateCalibration ();
+    // Write the Chrome trace to the files named at StartLogging ()
+    void WriteTrace ();
   };
 
 }
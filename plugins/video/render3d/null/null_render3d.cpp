@@ -61,6 +61,8 @@ csNullGraphics3D::csNullGraphics3D (iBase *iParent) :
   Caps.StencilShadows = false;
 
   current_drawflags = 0;
+  frameDraws = frameInstances = 0;
+  lastFrameDraws = lastFrameInstances = 0;
 }
 
 csNullGraphics3D::~csNullGraphics3D ()
@@ -351,6 +353,9 @@ void csNullGraphics3D::Print (csRect const*area)
 {
   if (bugplug)
     bugplug->ResetCounter ("Triangle Count");
+  lastFrameDraws = frameDraws;
+  lastFrameInstances = frameInstances;
+  frameDraws = frameInstances = 0;
   G2D->Print (area);
 }
 
@@ -407,9 +412,11 @@ void csNullGraphics3D::SetTextureState (int*, iTextureHandle**, int)
 }
 
 void csNullGraphics3D::DrawMesh (const csCoreRenderMesh* mymesh,
-    const csRenderMeshModes& /*modes*/,
+    const csRenderMeshModes& modes,
     const csShaderVariableStack& /*stacks*/)
 {
+  frameDraws++;
+  frameInstances += modes.doInstancing ? uint (modes.instanceNum) : 1;
   if (bugplug)
   {
     int num_tri = (mymesh->indexend-mymesh->indexstart);
@@ -442,6 +449,19 @@ void csNullGraphics3D::DrawMesh (const csCoreRenderMesh* mymesh,
     bugplug->AddCounter ("Mesh Count", 1);
   }  
 }
+bool csNullGraphics3D::PerformExtensionV (char const* command, va_list args)
+{
+  if (!strcasecmp (command, "getdrawstats"))
+  {
+    uint* draws = va_arg (args, uint*);
+    uint* instances = va_arg (args, uint*);
+    if (draws) *draws = lastFrameDraws;
+    if (instances) *instances = lastFrameInstances;
+    return true;
+  }
+  return false;
+}
+
 void csNullGraphics3D::SetWriteMask (bool red, bool green, bool blue, bool alpha)
 {
   red_mask = red;
@@ -176,9 +176,13 @@ public:
   void DrawSimpleMeshes (const csSimpleRenderMesh* /*meshes*/,
     size_t /*numMeshes*/, uint /*flags*/ = 0) { }
 
-  bool PerformExtension (char const* /*command*/, ...) { return false; }
-  bool PerformExtensionV (char const* /*command*/, va_list /*args*/)
-  { return false; }
+  /**
+   * Supported extensions:
+   * - "getdrawstats" (uint* draws, uint* instances): Get the number of
+   *   DrawMesh() calls and of drawn instances (a non-instanced draw counting
+   *   as one) of the last completed frame.
+   */
+  bool PerformExtensionV (char const* command, va_list args);
 
   /**
    * Initialise a set of occlusion queries.
@@ -241,6 +245,11 @@ private:
   csZBufMode zmode;
 
   bool red_mask, green_mask, blue_mask, alpha_mask;
+
+  /// Draws and instances of the current frame
+  uint frameDraws, frameInstances;
+  /// Draws and instances of the last completed frame
+  uint lastFrameDraws, lastFrameInstances;
   
   enum { numTargets = 2 };
   csRef<iTextureHandle> render_targets[numTargets];
@@ -65,6 +65,31 @@ CondOperation ConditionIDMapper::GetCondition (csConditionID condition)
 
 //---------------------------------------------------------------------------
 
+CondProgram::CondProgram () : size (0)
+{
+  memset (blocks, 0, sizeof (blocks));
+}
+
+CondProgram::~CondProgram ()
+{
+  for (size_t b = 0; b < maxBlocks; b++)
+    cs_free (blocks[b]);
+}
+
+void CondProgram::Append (csConditionID condition, const Instruction& insn)
+{
+  CS_ASSERT(condition == (csConditionID)size);
+  size_t block = condition >> blockShift;
+  CS_ASSERT(block < maxBlocks);
+  if (blocks[block] == 0)
+    blocks[block] = (Instruction*)cs_malloc (blockSize * sizeof (Instruction));
+  blocks[block][condition & (blockSize-1)] = insn;
+  // Publish the instruction only after it was written
+  CS::Threading::AtomicOperations::Set (&size, int32 (condition + 1));
+}
+
+//---------------------------------------------------------------------------
+
 template<typename T>
 static void SetSizeFill1 (T& array, size_t newSize)
 {
@@ -81,12 +106,15 @@ static void SetSizeFill1 (T& array, size_t newSize)
 
 csConditionEvaluator::csConditionEvaluator (iShaderVarStringSet* strings,
   const csConditionConstants& constants) :
-  strings(strings), ticketEvalPool (0),
-  evalStatePool (0), constants(constants)
+  strings(strings), constants(constants)
 {
 }
 
 csConditionEvaluator::~csConditionEvaluator ()
+{
+}
+
+csConditionEvaluator::ThreadPools::~ThreadPools ()
 {
   while (ticketEvalPool != 0)
   {
@@ -98,6 +126,7 @@ csConditionEvaluator::~csConditionEvaluator ()
   {
     EvalState* p = evalStatePool;
     evalStatePool = p->poolNext;
+    p->~EvalState();
     cs_free (p);
   }
 }
@@ -330,8 +359,7 @@ csConditionID csConditionEvaluator::FindOptimizedConditionInternal (
   if (condID == (csConditionID)~0)
   {
     condID = conditions.GetConditionID (operation, true);
-    MarkAffectionBySVs (condID, operation.left);
-    MarkAffectionBySVs (condID, operation.right);
+    CompileCondition (condID, operation);
   }
   return condID;
 }
@@ -898,112 +926,43 @@ bool csConditionEvaluator::IsConditionPartOf (csConditionID condition,
   return IsConditionPartOfInternal (condition, containerCondition);
 }
 
-/* Default value for 'last SV' array.
-   Use a unique pointer value instead of 0 as it can happen that an affecting
-   SV gets added after the eval cache setup; it's "last" value at the next
-   eval cache setup is 0 - which is a valid value for an SV in an SV stack and
-   thus may result in incorrect use of a cached eval result. */
-static const csShaderVariable definitelyUniqueSV;
-
-void csConditionEvaluator::SetupEvalCacheInternal (const csShaderVariableStack* stack)
-{
-  if (stack != 0)
-  {
-    if (evalCache.lastShaderVars.GetSize() != svAffectedConditions.GetSize())
-    {
-      evalCache.lastShaderVars.DeleteAll();
-      evalCache.lastShaderVars.SetSize (svAffectedConditions.GetSize(),
-	&definitelyUniqueSV);
-    }
-	
-    for (size_t i = 0; i < svAffectedConditions.GetSize(); i++)
-    {
-      SVAffection& affection = svAffectedConditions[i];
-      csShaderVariable* sv = (affection.svName < stack->GetSize()) ?
-	(*stack)[affection.svName] : 0;
-      if (evalCache.lastShaderVars[i] != sv)
-      {
-	if (affection.affectedConditions.GetSize() != evalCache.condChecked.GetSize())
-	{
-	  /* Sometimes the affected conditions mask is bigger,
-	   * sometimes the condition checked mask - the former can happen
-	   * when a fallback shader or new tech is loaded that uses hitherto
-	   * unknown conditions */
-	  size_t newCondSize = csMax (affection.affectedConditions.GetSize(),
-	    evalCache.condChecked.GetSize());
-	  SetSizeFill1 (affection.affectedConditions, newCondSize);
-	  evalCache.condChecked.SetSize (newCondSize);
-	  evalCache.condResult.SetSize (newCondSize);
-	}
-	evalCache.condChecked &= affection.affectedConditions;
-	evalCache.lastShaderVars[i] = sv;
-      }
-    }
-    /* Checking against last buffer value is expensive, so just mask all
-       conditions depending on buffer values */
-    MyBitArrayMalloc& bitarray = bufferAffectConditions;
-    if (bitarray.GetSize() != evalCache.condChecked.GetSize())
-    {
-      size_t newCondSize = csMax (bitarray.GetSize(),
-	evalCache.condChecked.GetSize());
-      SetSizeFill1 (bitarray, newCondSize);
-      evalCache.condChecked.SetSize (newCondSize);
-      evalCache.condResult.SetSize (newCondSize);
-    }
-    evalCache.condChecked &= bitarray;
-  }
-}
-
-
 csPtr<csConditionEvaluator::TicketEvaluator> csConditionEvaluator::BeginTicketEvaluationCaching (
   const CS::Graphics::RenderMeshModes& modes,
   const csShaderVariableStack* stack)
 {
-  mutex.Lock();
+  EvalState* evalState = AllocEvalState ();
+  evalState->condChecked.Clear();
 
-  EvalState* evalState = &evalCache;
   EvaluatorShadervar eval (*this, evalState, &modes, stack);
-  
-  void* newp;
-  if (ticketEvalPool != 0)
-  {
-    newp = ticketEvalPool;
-    ticketEvalPool = ticketEvalPool->poolNext;
-  }
-  else
-  {
-    newp = cs_malloc (sizeof (TicketEvaluator));
-  }
-#include "csutil/custom_new_disable.h"
-  TicketEvaluator* newEval = new (newp) TicketEvaluator (this, true, evalState, eval);
-#include "csutil/custom_new_enable.h"
-  {
-    uint currentFrame = ~0;
-    if (engine.IsValid()) currentFrame = engine->GetCurrentFrameNumber();
-    if ((evalCache.lastEvalFrame != currentFrame)
-      || (currentFrame == (uint)~0)) // be conservative in case we don't have an engine
-    {
-      evalCache.condChecked.SetSize (conditions.GetNumConditions ());
-      evalCache.condChecked.Clear();
-      evalCache.condResult.SetSize (conditions.GetNumConditions ());
-      evalCache.lastShaderVars.DeleteAll();
-      evalCache.lastEvalFrame = currentFrame;
-    }
-  }
-  SetupEvalCacheInternal (stack);
-  
-  return csPtr<TicketEvaluator> (newEval);
+  return csPtr<TicketEvaluator> (AllocTicketEvaluator (evalState, eval));
 }
 
 csPtr<csConditionEvaluator::TicketEvaluator> csConditionEvaluator::BeginTicketEvaluation (
   const csBitArray& condSet,
   const csBitArray& condResults)
 {
+  EvalState* evalState = AllocEvalState ();
+  evalState->condChecked.Clear();
+  evalState->condResult.Clear();
+
+  for (size_t i = 0; i < condResults.GetSize(); i++)
+  {
+    evalState->condChecked.Set (i, condSet[i]);
+    evalState->condResult.Set (i, condResults[i]);
+  }
+
+  EvaluatorShadervar eval (*this, evalState, 0, 0);
+  return csPtr<TicketEvaluator> (AllocTicketEvaluator (evalState, eval));
+}
+
+csConditionEvaluator::EvalState* csConditionEvaluator::AllocEvalState ()
+{
+  ThreadPools& pools = threadPools;
   EvalState* evalState;
-  if (evalStatePool != 0)
+  if (pools.evalStatePool != 0)
   {
-    evalState = evalStatePool;
-    evalStatePool = evalStatePool->poolNext;
+    evalState = pools.evalStatePool;
+    pools.evalStatePool = evalState->poolNext;
   }
   else
   {
@@ -1016,37 +975,32 @@ csPtr<csConditionEvaluator::TicketEvaluator> csConditionEvaluator::BeginTicketEv
    * are added (notably when a shader source is retrieved from an
    * external source). Make sure the cache is large enough.
    */
-  if (evalState->condChecked.GetSize() < conditions.GetNumConditions ())
-  {
-    evalState->condChecked.SetSize (conditions.GetNumConditions ());
-    evalState->condResult.SetSize (conditions.GetNumConditions ());
-  }
-  evalState->condChecked.Clear();
-  evalState->condResult.Clear();
-
-  for (size_t i = 0; i < condResults.GetSize(); i++)
+  size_t numConditions = program.GetSize ();
+  if (evalState->condChecked.GetSize() < numConditions)
   {
-    evalState->condChecked.Set (i, condSet[i]);
-    evalState->condResult.Set (i, condResults[i]);
+    evalState->condChecked.SetSize (numConditions);
+    evalState->condResult.SetSize (numConditions);
   }
+  return evalState;
+}
 
-  EvaluatorShadervar eval (*this, evalState, 0, 0);
-  
+csConditionEvaluator::TicketEvaluator* csConditionEvaluator::AllocTicketEvaluator (
+  EvalState* evalState, EvaluatorShadervar& eval)
+{
+  ThreadPools& pools = threadPools;
   void* newp;
-  if (ticketEvalPool != 0)
+  if (pools.ticketEvalPool != 0)
   {
-    newp = ticketEvalPool;
-    ticketEvalPool = ticketEvalPool->poolNext;
+    newp = pools.ticketEvalPool;
+    pools.ticketEvalPool = pools.ticketEvalPool->poolNext;
   }
   else
   {
     newp = cs_malloc (sizeof (TicketEvaluator));
   }
 #include "csutil/custom_new_disable.h"
-  TicketEvaluator* newEval = new (newp) TicketEvaluator (this, false, evalState, eval);
+  return new (newp) TicketEvaluator (this, evalState, eval);
 #include "csutil/custom_new_enable.h"
-
-  return csPtr<TicketEvaluator> (newEval);
 }
 
 bool csConditionEvaluator::EvaluateCachedInternal (EvalState* evalState,
@@ -1062,10 +1016,11 @@ bool csConditionEvaluator::EvaluateCachedInternal (EvalState* evalState,
    * are added (notably when a shader source is retrieved from an
    * external source). Make sure the cache is large enough.
    */
-  if (evalState->condChecked.GetSize() < conditions.GetNumConditions ())
+  if (evalState->condChecked.GetSize() <= condition)
   {
-    evalState->condChecked.SetSize (conditions.GetNumConditions ());
-    evalState->condResult.SetSize (conditions.GetNumConditions ());
+    size_t numConditions = program.GetSize ();
+    evalState->condChecked.SetSize (numConditions);
+    evalState->condResult.SetSize (numConditions);
   }
 
   if (evalState->condChecked.IsBitSet (condition))
@@ -1073,7 +1028,7 @@ bool csConditionEvaluator::EvaluateCachedInternal (EvalState* evalState,
     return evalState->condResult.IsBitSet (condition);
   }
 
-  bool result = EvaluateInternal (eval, condition);
+  bool result = EvaluateCompiled (eval, condition);
 
   evalState->condChecked.Set (condition, true);
   evalState->condResult.Set (condition, result);
@@ -1446,49 +1401,155 @@ csString csConditionEvaluator::GetConditionString (csConditionID id)
   return GetConditionStringInternal (id);
 }
 
-void csConditionEvaluator::MarkAffectionBySVs (csConditionID condition,
-					       const CondOperand& operand)
+bool csConditionEvaluator::IsFloatOperand (const CondOperand& operand)
 {
   switch (operand.type)
   {
-    case operandSV:
-    case operandSVValueBuffer:
+    case operandFloat:
     case operandSVValueFloat:
-    case operandSVValueTexture:
-    case operandSVValueInt:
     case operandSVValueX:
     case operandSVValueY:
     case operandSVValueZ:
     case operandSVValueW:
-      {
-	MyBitArrayMalloc* bits;
-	if (operand.svLocation.bufferName != CS_BUFFER_NONE)
-	  bits = &bufferAffectConditions;
-	else
-	{
-	  size_t idx = svAffectedConditions.FindSortedKey (
-	    csArrayCmp<SVAffection, CS::ShaderVarStringID> (operand.svLocation.svName));
-	  if (idx == csArrayItemNotFound)
-	    idx = svAffectedConditions.InsertSorted (SVAffection (operand.svLocation.svName));
-	  SVAffection& affectedConds = svAffectedConditions[idx];
-	  bits = &affectedConds.affectedConditions;
-	}
-	if (bits->GetSize() <= condition)
-	  SetSizeFill1 (*bits, condition+1);
-	bits->ClearBit (condition);
-      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+void csConditionEvaluator::CompileCondition (csConditionID condition,
+					     const CondOperation& operation)
+{
+  CondProgram::Instruction insn;
+  insn.left = operation.left;
+  insn.right = operation.right;
+
+  // Same choice of comparison as EvaluateInternal()
+  bool compareFloat = IsFloatOperand (operation.left)
+    || IsFloatOperand (operation.right);
+  bool compareBool = OpTypesCompatible (operation.left.type, operandBoolean) 
+    && OpTypesCompatible (operation.right.type, operandBoolean);
+  switch (operation.operation)
+  {
+    case opAnd:
+      insn.opcode = CondProgram::copAnd;
       break;
-    case operandOperation:
-      {
-	CondOperation operation = conditions.GetCondition (operand.operation);
-	MarkAffectionBySVs (condition, operation.left);
-	MarkAffectionBySVs (condition, operation.right);
-      }
+    case opOr:
+      insn.opcode = CondProgram::copOr;
       break;
-    default:
-      // Do nothing
+    case opEqual:
+      insn.opcode = compareFloat ? CondProgram::copEqualF
+	: (compareBool ? CondProgram::copEqualB : CondProgram::copEqualI);
+      break;
+    case opNEqual:
+      insn.opcode = compareFloat ? CondProgram::copNEqualF
+	: (compareBool ? CondProgram::copNEqualB : CondProgram::copNEqualI);
+      break;
+    case opLesser:
+      insn.opcode = compareFloat ? CondProgram::copLesserF
+	: CondProgram::copLesserI;
+      break;
+    case opLesserEq:
+      insn.opcode = compareFloat ? CondProgram::copLesserEqF
+	: CondProgram::copLesserEqI;
       break;
+    default:
+      CS_ASSERT (false);
   }
+
+  program.Append (condition, insn);
+}
+
+bool csConditionEvaluator::UsesRenderBuffers (const CondOperand& operand)
+{
+  if (operand.type == operandOperation)
+  {
+    const CondProgram::Instruction& insn = program.Get (operand.operation);
+    return UsesRenderBuffers (insn.left) || UsesRenderBuffers (insn.right);
+  }
+  return (operand.type == operandSVValueBuffer)
+    && (operand.svLocation.bufferName != CS_BUFFER_NONE);
+}
+
+bool csConditionEvaluator::CollectUsedSVs (csConditionID condition,
+                                           csBitArray& usedSVs)
+{
+  if ((condition == csCondAlwaysFalse) || (condition == csCondAlwaysTrue))
+    return false;
+
+  MyBitArrayTemp affectedSVs;
+  GetUsedSVs (condition, affectedSVs);
+  if (usedSVs.GetSize() < affectedSVs.GetSize())
+    usedSVs.SetSize (affectedSVs.GetSize());
+  for (size_t i = 0; i < affectedSVs.GetSize(); i++)
+  {
+    if (affectedSVs.IsBitSet (i)) usedSVs.SetBit (i);
+  }
+
+  const CondProgram::Instruction& insn = program.Get (condition);
+  return UsesRenderBuffers (insn.left) || UsesRenderBuffers (insn.right);
+}
+
+static uint HashTicketMemoKey (const void* owner,
+  const csShaderVariable* const* shaderVars, size_t numSVs)
+{
+  uint hash = csHashCompute ((const char*)&owner, sizeof (owner));
+  if (numSVs > 0)
+    hash ^= csHashCompute ((const char*)shaderVars,
+      numSVs * sizeof (const csShaderVariable*));
+  return hash;
+}
+
+csConditionEvaluator::TicketMemo* csConditionEvaluator::GetTicketMemo ()
+{
+  if (!engine.IsValid()) return 0;
+  uint currentFrame = engine->GetCurrentFrameNumber();
+
+  TicketMemo* memo = ticketMemo.operator->();
+  if (memo->frame != currentFrame)
+  {
+    memo->entries.Empty();
+    memo->shaderVars.Empty();
+    memo->frame = currentFrame;
+  }
+  return memo;
+}
+
+bool csConditionEvaluator::GetMemoizedTicket (const void* owner,
+  const csShaderVariable* const* shaderVars, size_t numSVs, size_t& ticket)
+{
+  TicketMemo* memo = GetTicketMemo ();
+  if (!memo) return false;
+
+  csHash<TicketMemo::Entry, uint>::Iterator it (memo->entries.GetIterator (
+    HashTicketMemoKey (owner, shaderVars, numSVs)));
+  while (it.HasNext())
+  {
+    const TicketMemo::Entry& entry = it.Next();
+    if ((entry.owner != owner) || (entry.numSVs != numSVs)) continue;
+    if ((numSVs > 0) && (memcmp (memo->shaderVars.GetArray() + entry.firstSV,
+	shaderVars, numSVs * sizeof (const csShaderVariable*)) != 0))
+      continue;
+    ticket = entry.ticket;
+    return true;
+  }
+  return false;
+}
+
+void csConditionEvaluator::MemoizeTicket (const void* owner,
+  const csShaderVariable* const* shaderVars, size_t numSVs, size_t ticket)
+{
+  TicketMemo* memo = GetTicketMemo ();
+  if (!memo) return;
+
+  TicketMemo::Entry entry;
+  entry.owner = owner;
+  entry.firstSV = memo->shaderVars.GetSize();
+  entry.numSVs = numSVs;
+  entry.ticket = ticket;
+  for (size_t i = 0; i < numSVs; i++)
+    memo->shaderVars.Push (shaderVars[i]);
+  memo->entries.Put (HashTicketMemoKey (owner, shaderVars, numSVs), entry);
 }
 
 csString csConditionEvaluator::OperationToString (const CondOperation& operation)
@@ -1603,24 +1664,24 @@ Logic3 csConditionEvaluator::CheckConditionResults (
 
   void csConditionEvaluator::RecycleTicketEvaluator (TicketEvaluator* p)
   {
-    p->poolNext = ticketEvalPool;
-    ticketEvalPool = p;
+    ThreadPools& pools = threadPools;
+    p->poolNext = pools.ticketEvalPool;
+    pools.ticketEvalPool = p;
   }
 
   void csConditionEvaluator::RecycleEvalState (EvalState* p)
   {
-    if (p == &evalCache) return;
-    p->poolNext = evalStatePool;
-    evalStatePool = p;
+    ThreadPools& pools = threadPools;
+    p->poolNext = pools.evalStatePool;
+    pools.evalStatePool = p;
   }
 
 //---------------------------------------------------------------------------
 
   csConditionEvaluator::TicketEvaluator::TicketEvaluator (
-    csConditionEvaluator* owner, bool hasLock,
-      EvalState* evalState, EvaluatorShadervar& eval)
-    : owner (owner), mutex (owner->mutex), inEval (true), hasLock (hasLock),
-      evalState (evalState), eval (eval)
+    csConditionEvaluator* owner, EvalState* evalState,
+    EvaluatorShadervar& eval)
+    : owner (owner), inEval (true), evalState (evalState), eval (eval)
   {
   }
   
@@ -1651,10 +1712,6 @@ Logic3 csConditionEvaluator::CheckConditionResults (
   
   void csConditionEvaluator::TicketEvaluator::EndEvaluation()
   {
-    if (inEval)
-    {
-      if (hasLock) mutex.Unlock();
-    }
     inEval = false;
   }
  
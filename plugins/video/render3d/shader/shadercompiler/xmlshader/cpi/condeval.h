@@ -21,8 +21,11 @@
 #define __CS_CONDEVAL_H__
 
 #include "csplugincommon/shader/shadercachehelper.h"
+#include "csutil/dirtyaccessarray.h"
 #include "csutil/hashr.h"
 #include "csutil/memfile.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/tls.h"
 #include "csutil/weakref.h"
 #include "csgfx/shadervararrayhelper.h"
 #include "csgfx/shadervarnameparser.h"
@@ -55,6 +58,70 @@ public:
   CondOperation GetCondition (csConditionID condition);
 };
 
+/**
+ * Conditions compiled to a flat table of instructions, indexed by condition
+ * ID. The type used to compare the operands is resolved when compiling, so
+ * evaluation neither has to look up the condition nor inspect operand types.
+ *
+ * Instructions are only ever appended, and never move once appended. Any
+ * thread may read the instructions below GetSize() without locking.
+ */
+class CondProgram
+{
+public:
+  enum Opcode
+  {
+    copAnd,
+    copOr,
+    copEqualF,
+    copEqualB,
+    copEqualI,
+    copNEqualF,
+    copNEqualB,
+    copNEqualI,
+    copLesserF,
+    copLesserI,
+    copLesserEqF,
+    copLesserEqI
+  };
+  
+  struct Instruction
+  {
+    Opcode opcode;
+    CondOperand left;
+    CondOperand right;
+    
+    Instruction () : opcode (copAnd), left (), right () {}
+  };
+private:
+  enum
+  {
+    blockShift = 10,
+    blockSize = 1 << blockShift,
+    maxBlocks = 4096
+  };
+  Instruction* blocks[maxBlocks];
+  int32 size;
+public:
+  CondProgram ();
+  ~CondProgram ();
+  
+  /// Number of compiled conditions
+  size_t GetSize () const
+  { return (size_t)CS::Threading::AtomicOperations::ReadAcquire (&size); }
+  /// Get the instruction for a condition
+  const Instruction& Get (csConditionID condition) const
+  {
+    CS_ASSERT(condition < GetSize ());
+    return blocks[condition >> blockShift][condition & (blockSize-1)];
+  }
+  /**
+   * Append the instruction for a condition. Conditions must be appended in
+   * ID order, by one thread at a time.
+   */
+  void Append (csConditionID condition, const Instruction& insn);
+};
+
 struct EvaluatorShadervarValues;
 struct EvaluatorShadervarValuesSimple;
 
@@ -137,13 +204,11 @@ public:
       csConditionEvaluator* owner;
       TicketEvaluator* poolNext;
     };
-    MutexType& mutex;
-    bool inEval : 1;
-    bool hasLock : 1;
+    bool inEval;
     EvalState* evalState;
     EvaluatorShadervar eval;
     
-    TicketEvaluator (csConditionEvaluator* owner, bool hasLock,
+    TicketEvaluator (csConditionEvaluator* owner,
       EvalState* evalState, EvaluatorShadervar& eval);
     ~TicketEvaluator();
   public:
@@ -166,8 +231,11 @@ private:
   csWeakRef<iEngine> engine;
   
   ConditionIDMapper conditions;
+  /* Compiled conditions, used for evaluating against shader variables.
+     Unlike 'conditions' this can be read without holding the mutex. */
+  CondProgram program;
 
-  // Evaluation cache (checked conditions + results)
+  // Evaluation state of a ticket (checked conditions + results)
   struct EvalState
   {
     EvalState* poolNext;
@@ -178,42 +246,47 @@ private:
     EvalState() : poolNext (0) {}
     void Clear() { condChecked.Clear(); }
   };
-  // Evaluation state cache for caching between frames
-  struct EvalCacheState : public EvalState
+  
+  /* Ticket evaluators and evaluation states are pooled per thread so
+     evaluation does not need to lock. */
+  struct ThreadPools
   {
-    uint lastEvalFrame;
-    csArray<const csShaderVariable*> lastShaderVars;
-
-    EvalCacheState() { Clear(); }
-    void Clear() { lastEvalFrame = ~0; EvalState::Clear(); }
+    TicketEvaluator* ticketEvalPool;
+    EvalState* evalStatePool;
+    
+    ThreadPools () : ticketEvalPool (0), evalStatePool (0) {}
+    ~ThreadPools ();
   };
-  EvalCacheState evalCache;
-  
-  TicketEvaluator* ticketEvalPool;
+  CS::Threading::ThreadLocal<ThreadPools> threadPools;
   void RecycleTicketEvaluator (TicketEvaluator* p);
-  EvalState* evalStatePool;
+  EvalState* AllocEvalState ();
   void RecycleEvalState (EvalState* p);
+  TicketEvaluator* AllocTicketEvaluator (EvalState* evalState,
+    EvaluatorShadervar& eval);
+  
+  // Tickets memoized by the shaders, per thread and for one frame
+  struct TicketMemo
+  {
+    struct Entry
+    {
+      const void* owner;
+      size_t firstSV;
+      size_t numSVs;
+      size_t ticket;
+    };
+    uint frame;
+    csHash<Entry, uint> entries;
+    csDirtyAccessArray<const csShaderVariable*> shaderVars;
+    
+    TicketMemo () : frame (~0) {}
+  };
+  CS::Threading::ThreadLocal<TicketMemo> ticketMemo;
+  TicketMemo* GetTicketMemo ();
   
   csMemoryPool scratch;
 
   // Constants
   const csConditionConstants& constants;
-  
-  // For each shadervar, marks which conditions are affected
-  struct SVAffection
-  {
-    CS::ShaderVarStringID svName;
-    MyBitArrayMalloc affectedConditions;
-      
-    explicit SVAffection (CS::ShaderVarStringID svName) : svName (svName) {}
-    bool operator< (const SVAffection& other) const { return svName < other.svName; }
-    bool operator< (const CS::ShaderVarStringID& other) const { return svName < other; }
-    friend bool operator< (const CS::ShaderVarStringID& a,
-      const SVAffection& b)
-    { return a < b.svName; }
-  };
-  csSafeCopyArray<SVAffection> svAffectedConditions;
-  MyBitArrayMalloc bufferAffectConditions;
 
   csString lastError;
   const char* SetLastError (const char* msg, ...) CS_GNUC_PRINTF (2, 3);
@@ -241,7 +314,11 @@ private:
 
   void GetUsedSVs2 (csConditionID condition, MyBitArrayTemp& affectedSVs);
 
-  void MarkAffectionBySVs (csConditionID condition, const CondOperand& operand);
+  static bool IsFloatOperand (const CondOperand& operand);
+  void CompileCondition (csConditionID condition,
+    const CondOperation& operation);
+  bool EvaluateCompiled (EvaluatorShadervar& eval, csConditionID condition);
+  bool UsesRenderBuffers (const CondOperand& operand);
 
   csString OperandToString (const CondOperand& operand);
   csString OperationToString (const CondOperation& operation);
@@ -255,7 +332,6 @@ private:
   size_t* AllocSVIndicesInternal (size_t num);
   const char* ProcessExpressionInternal (csExpression* expression, 
     csConditionID& cond);
-  void SetupEvalCacheInternal (const csShaderVariableStack* stack);
   bool EvaluateCachedInternal (EvalState* evalState, EvaluatorShadervar& eval,
     csConditionID condition);
   Logic3 CheckConditionResultsInternal (csConditionID condition,
@@ -287,7 +363,8 @@ public:
 
   /**
    * Create an evaluator object with the given parameters.
-   * \warning Locks the csConditionEvaluator until evaluation was ended!
+   * Evaluation does not lock; any number of threads may evaluate
+   * concurrently, also while other threads add conditions.
    */
   csPtr<TicketEvaluator> BeginTicketEvaluationCaching (const CS::Graphics::RenderMeshModes& modes,
     const csShaderVariableStack* stack);
@@ -300,9 +377,20 @@ public:
   /// Get number of conditions allocated so far
   size_t GetNumConditions()
   { 
-    LockType lock (mutex);
-    return conditions.GetNumConditions(); 
+    return program.GetSize (); 
   }
+  
+  //@{
+  /**
+   * Memoize a ticket computed by \a owner for the given shader variables,
+   * or look it up. Memoized tickets are valid for the current frame and
+   * thread only; nothing is memoized if the frame number is not known.
+   */
+  bool GetMemoizedTicket (const void* owner,
+    const csShaderVariable* const* shaderVars, size_t numSVs, size_t& ticket);
+  void MemoizeTicket (const void* owner,
+    const csShaderVariable* const* shaderVars, size_t numSVs, size_t ticket);
+  //@}
 
   /*
    * Check whether a condition, given a set of possible values for
@@ -339,6 +427,11 @@ public:
 
   /// Determine which SVs are used in some condition.
   void GetUsedSVs (csConditionID condition, MyBitArrayTemp& affectedSVs);
+  /**
+   * Add the SVs used in some condition to \a usedSVs. Returns whether the
+   * condition also depends on the render buffers of the mesh.
+   */
+  bool CollectUsedSVs (csConditionID condition, csBitArray& usedSVs);
 
   /// Try to release unused temporary memory
   static void CompactMemory ();
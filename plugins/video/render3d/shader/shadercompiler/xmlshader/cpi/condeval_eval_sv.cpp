@@ -27,6 +27,51 @@
 CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 {
 
+  bool csConditionEvaluator::EvaluateCompiled (EvaluatorShadervar& eval,
+                                               csConditionID condition)
+  {
+    typedef EvaluatorShadervar::FloatType EvFloat;
+    const CondProgram::Instruction& insn = program.Get (condition);
+
+    switch (insn.opcode)
+    {
+      case CondProgram::copAnd:
+	return eval.Boolean (insn.left) && eval.Boolean (insn.right);
+      case CondProgram::copOr:
+	return eval.Boolean (insn.left) || eval.Boolean (insn.right);
+      case CondProgram::copEqualF:
+	{
+	  EvFloat f1 (eval.Float (insn.left));
+	  EvFloat f2 (eval.Float (insn.right));
+	  return f1 == f2;
+	}
+      case CondProgram::copEqualB:
+	return eval.Boolean (insn.left) == eval.Boolean (insn.right);
+      case CondProgram::copEqualI:
+	return eval.Int (insn.left) == eval.Int (insn.right);
+      case CondProgram::copNEqualF:
+	{
+	  EvFloat f1 (eval.Float (insn.left));
+	  EvFloat f2 (eval.Float (insn.right));
+	  return f1 != f2;
+	}
+      case CondProgram::copNEqualB:
+	return eval.Boolean (insn.left) != eval.Boolean (insn.right);
+      case CondProgram::copNEqualI:
+	return eval.Int (insn.left) != eval.Int (insn.right);
+      case CondProgram::copLesserF:
+	return eval.Float (insn.left) < eval.Float (insn.right);
+      case CondProgram::copLesserI:
+	return eval.Int (insn.left) < eval.Int (insn.right);
+      case CondProgram::copLesserEqF:
+	return eval.Float (insn.left) <= eval.Float (insn.right);
+      case CondProgram::copLesserEqI:
+	return eval.Int (insn.left) <= eval.Int (insn.right);
+    }
+    CS_ASSERT (false);
+    return eval.GetDefaultResult();
+  }
+
   csConditionEvaluator::EvaluatorShadervar::BoolType 
   csConditionEvaluator::EvaluatorShadervar::Boolean (
     const CondOperand& operand)
@@ -199,6 +199,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
   {
     CS_ASSERT(currentEval != 0);
 
+    return GetVariant (currentEval);
+  }
+
+  size_t csShaderConditionResolver::GetVariant (
+    csConditionEvaluator::TicketEvaluator* eval) const
+  {
     if (rootNode == 0)
     {
       return 0;
@@ -211,7 +217,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
       while (nextRoot != 0)
       {
         currentRoot = nextRoot;
-        if (currentEval->Evaluate (currentRoot->condition))
+        if (eval->Evaluate (currentRoot->condition))
         {
           nextRoot = currentRoot->trueNode;
         }
@@ -361,6 +367,17 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     CollectUsedConditions (node->trueNode, condWrite);
   }
 
+  bool csShaderConditionResolver::CollectUsedSVs (csConditionNode* node,
+    csBitArray& usedSVs)
+  {
+    if (node == 0) return false;
+
+    bool usesBuffers = evaluator.CollectUsedSVs (node->condition, usedSVs);
+    usesBuffers |= CollectUsedSVs (node->falseNode, usedSVs);
+    usesBuffers |= CollectUsedSVs (node->trueNode, usedSVs);
+    return usesBuffers;
+  }
+
   bool csShaderConditionResolver::ReadFromCache (iFile* cacheFile,
     ConditionsReader& condReader)
   {
@@ -467,7 +484,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     int forcepriority)
     : scfImplementationType (this), techsResolver (0),
     sharedEvaluator (compiler->sharedEvaluator),
-    fallbackTried (false)
+    fallbackTried (false), ticketsMemoizable (false)
   {
     InitTokenTable (xmltokens);
 
@@ -492,7 +509,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
   csXMLShader::csXMLShader (csXMLShaderCompiler* compiler)
     : scfImplementationType (this), techsResolver (0),
     sharedEvaluator (compiler->sharedEvaluator),
-    fallbackTried (false)
+    fallbackTried (false), ticketsMemoizable (false)
   {
     InitTokenTable (xmltokens);
 
@@ -956,7 +973,17 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
       size_t vc = techniques[i].resolver->GetVariantCount();
       if (vc == 0) vc = 1;
       allTechVariantCount += vc;
+      /* Allocate variant slots in advance: tickets may be computed from
+         several threads, so the arrays must not be resized later. */
+      techniques[i].variants.SetSize (vc, 0);
+      techniques[i].variantsPrepared.SetSize (vc, 0);
     }
+    {
+      size_t tvc = techsResolver->GetVariantCount();
+      if (tvc == 0) tvc = 1;
+      techVariants.SetSize (csMax (techVariants.GetSize(), tvc));
+    }
+    SetupTicketMemo ();
 
     //Load global shadervars block
     csRef<iDocumentNode> varNode = shaderRootStripped->GetNode(
@@ -1103,7 +1130,6 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
   {
     csRef<csConditionEvaluator::TicketEvaluator> eval (
       sharedEvaluator->BeginTicketEvaluationCaching (modes, &stack));
-    techsResolver->SetCurrentEval (eval);
     
     int lightCount = 0;
     if (stack.GetSize() > compiler->stringLightCount)
@@ -1115,9 +1141,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 
     size_t tvc = techsResolver->GetVariantCount();
     if (tvc == 0) tvc = 1;
-    size_t tvi = techsResolver->GetVariant ();
+    size_t tvi = techsResolver->GetVariant (eval);
 
-    techsResolver->SetCurrentEval (0);
     if (tvi != csArrayItemNotFound)
       return tvi+tvc*lightCount;
     else
@@ -1332,6 +1357,28 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     techsResolver->SetCurrentEval (0);
   }
 
+  void csXMLShader::SetupTicketMemo ()
+  {
+    ticketSVs.Empty();
+    csBitArray usedSVs;
+    bool usesBuffers = techsResolver->CollectUsedSVs (usedSVs);
+    for (size_t t = 0; t < techniques.GetSize(); t++)
+      usesBuffers |= techniques[t].resolver->CollectUsedSVs (usedSVs);
+    // The light count is checked against the techniques' light limits
+    if (usedSVs.GetSize() <= (size_t)compiler->stringLightCount)
+      usedSVs.SetSize ((size_t)compiler->stringLightCount + 1);
+    usedSVs.SetBit (compiler->stringLightCount);
+
+    for (size_t i = 0; i < usedSVs.GetSize(); i++)
+    {
+      if (usedSVs.IsBitSet (i)) ticketSVs.Push ((CS::ShaderVarStringID)i);
+    }
+    ticketSVs.ShrinkBestFit();
+    /* Conditions checking the mesh's render buffers can't be memoized by
+       shader vars alone. */
+    ticketsMemoizable = !usesBuffers;
+  }
+
   size_t csXMLShader::GetTicketForTech (const csRenderMeshModes& modes, 
     const csShaderVariableStack& stack, size_t techNum)
   {
@@ -1357,123 +1404,127 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     Technique& tech = techniques[techNum];
     if (lightCount < tech.minLights) return csArrayItemNotFound;
 
-    csRef<iHierarchicalCache> techCache;
-    tech.resolver->SetCurrentEval (eval);
-
-    size_t vi = tech.resolver->GetVariant ();
+    size_t vi = tech.resolver->GetVariant (eval);
     if (vi != csArrayItemNotFound)
     {
-      csXMLShaderTech*& var = tech.variants.GetExtend (vi);
-      tech.variantsPrepared.SetSize (csMax (tech.variantsPrepared.GetSize(),
-	vi+1));
+      CS_ASSERT(vi < tech.variantsPrepared.GetSize());
       size_t ticket = ComputeTicket (techNum, vi);
+      if (!CS::Threading::AtomicOperations::ReadAcquire (
+	  &tech.variantsPrepared[vi]))
+	PrepareTechVariant (tech, techNum, vi, ticket, eval);
+      if (tech.variants[vi] != 0)
+	return ticket;
+    }
+    
+    return csArrayItemNotFound;
+  }
 
-      csRef<iHierarchicalCache> varCache;
-      if (!tech.variantsPrepared[vi])
-      {
-	if (!techCache.IsValid() && shaderCache.IsValid())
-	{
-	  techCache = shaderCache->GetRootedCache (
-	    csString().Format ("/%s/%zu", cacheScope_tech.GetData(), techNum));
-	}
+  void csXMLShader::PrepareTechVariant (Technique& tech, size_t techNum,
+    size_t vi, size_t ticket, csConditionEvaluator::TicketEvaluator* eval)
+  {
+    CS::Threading::RecursiveMutexScopedLock lock (ticketMutex);
+    // Another thread may have prepared the variant in the meantime
+    if (tech.variantsPrepared[vi]) return;
 
-	if (techCache.IsValid())
-	{
-	  varCache.AttachNew (
-	    new CS::PluginCommon::ShaderCacheHelper::MicroArchiveCache (
-	    techCache, csString().Format ("/%zu", vi)));
-	}
+    csRef<iHierarchicalCache> techCache;
+    // Loading the variant evaluates conditions through the resolver
+    tech.resolver->SetCurrentEval (eval);
+    csXMLShaderTech*& var = tech.variants[vi];
+    csRef<iHierarchicalCache> varCache;
+    if (!techCache.IsValid() && shaderCache.IsValid())
+    {
+      techCache = shaderCache->GetRootedCache (
+	csString().Format ("/%s/%zu", cacheScope_tech.GetData(), techNum));
+    }
 
-	if (compiler->doDumpXML)
-	{
-	  csRef<iDocumentSystem> docsys;
-	  docsys.AttachNew (new csTinyDocumentSystem);
-	  csRef<iDocument> newdoc = docsys->CreateDocument();
-	  CS::DocSystem::CloneNode (tech.techNode, newdoc->CreateRoot());
-	  newdoc->Write (compiler->vfs, csString().Format ("/tmp/shader/%s_%zu_%zu.xml",
-	    GetName(), techNum, vi));
-	}
+    if (techCache.IsValid())
+    {
+      varCache.AttachNew (
+	new CS::PluginCommon::ShaderCacheHelper::MicroArchiveCache (
+	techCache, csString().Format ("/%zu", vi)));
+    }
+
+    if (compiler->doDumpXML)
+    {
+      csRef<iDocumentSystem> docsys;
+      docsys.AttachNew (new csTinyDocumentSystem);
+      csRef<iDocument> newdoc = docsys->CreateDocument();
+      CS::DocSystem::CloneNode (tech.techNode, newdoc->CreateRoot());
+      newdoc->Write (compiler->vfs, csString().Format ("/tmp/shader/%s_%zu_%zu.xml",
+	GetName(), techNum, vi));
+    }
 
-	iShaderProgram::CacheLoadResult loadResult = iShaderProgram::loadFail;
-	var = 0;
-	if (techCache.IsValid())
+    iShaderProgram::CacheLoadResult loadResult = iShaderProgram::loadFail;
+    var = 0;
+    if (techCache.IsValid())
+    {
+      var = new csXMLShaderTech (this);
+      loadResult = var->LoadFromCache (ldr_context, tech.techNode,
+	varCache, shaderRootStripped, ticket);
+      if (compiler->do_verbose)
+      {
+	switch (loadResult)
 	{
-	  var = new csXMLShaderTech (this);
-	  loadResult = var->LoadFromCache (ldr_context, tech.techNode,
-	    varCache, shaderRootStripped, ticket);
-	  if (compiler->do_verbose)
+	case iShaderProgram::loadFail:
 	  {
-	    switch (loadResult)
-	    {
-	    case iShaderProgram::loadFail:
-	      {
-		compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		  "Shader %s: Technique with priority %d<%zu> fails (from cache). Reason: %s.",
-		  CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
-	      }
-	      break;
-	    case iShaderProgram::loadSuccessShaderInvalid:
-	      {
-		compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		  "Shader %s: Technique with priority %d<%zu> succeeds (from cache) but shader is invalid.",
-		  CS::Quote::Single (GetName()), tech.priority, vi);
-	      }
-	      break;
-	    case iShaderProgram::loadSuccessShaderValid:
-	      {
-		compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		  "Shader %s: Technique with priority %d<%zu> succeeds (from cache).",
-		  CS::Quote::Single (GetName()), tech.priority, vi);
-	      }
-	      break;
-	    }
+	    compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	      "Shader %s: Technique with priority %d<%zu> fails (from cache). Reason: %s.",
+	      CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
 	  }
-	  if (loadResult != iShaderProgram::loadSuccessShaderValid)
-	  {
-	    delete var; var = 0;
-	  }
-	}
-
-	if ((var == 0)
-	  && (loadResult == iShaderProgram::loadFail))
-	{
-	  // So external files are found correctly
-	  csVfsDirectoryChanger dirChange (compiler->vfs);
-	  dirChange.ChangeTo (vfsStartDir);
-
-	  var = new csXMLShaderTech (this);
-	  bool loadResult = var->Load (ldr_context, tech.techNode, shaderRootStripped, ticket,
-	    varCache);
-	  if (loadResult)
+	  break;
+	case iShaderProgram::loadSuccessShaderInvalid:
 	  {
-	    if (compiler->do_verbose)
-	      compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-	      "Shader %s: Technique with priority %d<%zu> succeeds!",
+	    compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	      "Shader %s: Technique with priority %d<%zu> succeeds (from cache) but shader is invalid.",
 	      CS::Quote::Single (GetName()), tech.priority, vi);
 	  }
-	  else
+	  break;
+	case iShaderProgram::loadSuccessShaderValid:
 	  {
-	    if (compiler->do_verbose)
-	    {
-	      compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		"Shader %s: Technique with priority %d<%zu> fails. Reason: %s.",
-		CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
-	    }
-	    delete var; var = 0;
+	    compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	      "Shader %s: Technique with priority %d<%zu> succeeds (from cache).",
+	      CS::Quote::Single (GetName()), tech.priority, vi);
 	  }
+	  break;
 	}
+      }
+      if (loadResult != iShaderProgram::loadSuccessShaderValid)
+      {
+	delete var; var = 0;
+      }
+    }
 
-	tech.variantsPrepared[vi] = true;
+    if ((var == 0)
+      && (loadResult == iShaderProgram::loadFail))
+    {
+      // So external files are found correctly
+      csVfsDirectoryChanger dirChange (compiler->vfs);
+      dirChange.ChangeTo (vfsStartDir);
+
+      var = new csXMLShaderTech (this);
+      bool loadResult = var->Load (ldr_context, tech.techNode, shaderRootStripped, ticket,
+	varCache);
+      if (loadResult)
+      {
+	if (compiler->do_verbose)
+	  compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	  "Shader %s: Technique with priority %d<%zu> succeeds!",
+	  CS::Quote::Single (GetName()), tech.priority, vi);
       }
-      if (var != 0)
+      else
       {
-	tech.resolver->SetCurrentEval (0);
-	return ticket;
+	if (compiler->do_verbose)
+	{
+	  compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	    "Shader %s: Technique with priority %d<%zu> fails. Reason: %s.",
+	    CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
+	}
+	delete var; var = 0;
       }
     }
     tech.resolver->SetCurrentEval (0);
-    
-    return csArrayItemNotFound;
+    // Publish the variant only after it was loaded
+    CS::Threading::AtomicOperations::Set (&tech.variantsPrepared[vi], 1);
   }
   
   size_t csXMLShader::GetTicketForTechVar (const csRenderMeshModes& modes, 
@@ -1483,7 +1534,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     size_t ticket = csArrayItemNotFound;
 
     // Get the techniques variant
-    ShaderTechVariant& techVar = techVariants.GetExtend (tvi);
+    ShaderTechVariant& techVar = techVariants[tvi];
 
     csXMLShaderTech* usedTech = 0;
     for (size_t t = 0; t < techniques.GetSize(); t++)
@@ -1499,13 +1550,14 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 
     if (usedTech == 0)
     {
+      CS::Threading::RecursiveMutexScopedLock lock (ticketMutex);
       iShader* fallback;
       iXMLShaderInternal* fallbackXML;
       bool useShortcut = true;
       if (!fallbackTried)
       {
-	/* If we're going to load a shader release the lock as loading the new
-	   shader may need it. */
+	/* If we're going to load a shader end the evaluation as loading the
+	   new shader will start its own. */
 	eval->EndEvaluation();
 	useShortcut = false;
       }
@@ -1537,8 +1589,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 	    "No technique validated for shader %s TV %zu",
 	    CS::Quote::Single (GetName()), tvi);
       }
+      techVar.shownError = true;
     }
-    techVar.shownError = true;
 
     return ticket;
   }
@@ -1548,25 +1600,35 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     csConditionEvaluator::TicketEvaluator* eval, int lightCount)
   {
     size_t ticket = csArrayItemNotFound;
-    techsResolver->SetCurrentEval (eval);
 
-    size_t tvc = techsResolver->GetVariantCount();
-    if (tvc == 0) tvc = 1;
-
-    size_t tvi = techsResolver->GetVariant ();
+    size_t tvi = techsResolver->GetVariant (eval);
     if (tvi != csArrayItemNotFound)
     {
       ticket = GetTicketForTechVar (modes, stack, eval, lightCount, tvi);
     }
 
-    techsResolver->SetCurrentEval (0);
-
     return ticket;
   }
 
   size_t csXMLShader::GetTicket (const csRenderMeshModes& modes, 
     const csShaderVariableStack& stack)
   {
+    /* The ticket only depends on the shader vars used by the conditions, so
+       if the same set of variables was seen this frame the ticket is known. */
+    size_t numSVs = ticketsMemoizable ? ticketSVs.GetSize() : 0;
+    CS_ALLOC_STACK_ARRAY(const csShaderVariable*, svs, numSVs);
+    if (ticketsMemoizable)
+    {
+      for (size_t i = 0; i < numSVs; i++)
+      {
+        CS::ShaderVarStringID name = ticketSVs[i];
+        svs[i] = ((size_t)name < stack.GetSize()) ? stack[name] : 0;
+      }
+      size_t ticket;
+      if (sharedEvaluator->GetMemoizedTicket (this, svs, numSVs, ticket))
+        return ticket;
+    }
+
     csRef<csConditionEvaluator::TicketEvaluator> eval (
       sharedEvaluator->BeginTicketEvaluationCaching (modes, &stack));
 
@@ -1578,7 +1640,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
         svLightCount->GetValue (lightCount);
     }
 
-    return GetTicketNoSetupInternal (modes, stack, eval, lightCount);
+    size_t ticket = GetTicketNoSetupInternal (modes, stack, eval, lightCount);
+    // Fallback tickets depend on the fallback shader's conditions as well
+    if (ticketsMemoizable
+      && ((ticket == csArrayItemNotFound) || !IsFallbackTicket (ticket)))
+      sharedEvaluator->MemoizeTicket (this, svs, numSVs, ticket);
+    return ticket;
   }
 
   size_t csXMLShader::GetTicketNoSetup (const csRenderMeshModes& modes, 
@@ -114,6 +114,7 @@ class csShaderConditionResolver :
   
   void CollectUsedConditions (csConditionNode* node,
     ConditionsWriter& condWrite);
+  bool CollectUsedSVs (csConditionNode* node, csBitArray& usedSVs);
 
   bool ReadNode (iFile* cacheFile, const ConditionsReader& condRead,
     csConditionNode* parent, csConditionNode*& node);
@@ -141,6 +142,12 @@ public:
   virtual void FinishAdding ();
 
   size_t GetVariant ();
+  /**
+   * Get the variant for the conditions evaluated by \a eval. Unlike
+   * GetVariant() this does not use the current evaluator and may be called
+   * from any thread.
+   */
+  size_t GetVariant (csConditionEvaluator::TicketEvaluator* eval) const;
   size_t GetVariantCount () const
   { return nextVariant; }
   void SetVariantEval (size_t variant);
@@ -160,6 +167,12 @@ public:
   
   void CollectUsedConditions (ConditionsWriter& condWrite)
   { CollectUsedConditions (rootNode, condWrite); }
+  /**
+   * Add the SVs used by the conditions to \a usedSVs. Returns whether a
+   * condition also depends on the render buffers of the mesh.
+   */
+  bool CollectUsedSVs (csBitArray& usedSVs)
+  { return CollectUsedSVs (rootNode, usedSVs); }
 };
 
 // Dummy interface to 'tag' activators from XMLShader
@@ -231,7 +244,8 @@ class csXMLShader : public scfImplementationExt4<csXMLShader,
     csRef<iDocumentNode> srcNode;
     csRef<csWrappedDocumentNode> techNode;
     
-    csBitArray variantsPrepared;
+    // Per variant: nonzero once loading the variant was attempted
+    csArray<int32> variantsPrepared;
     csArray<csXMLShaderTech*> variants;
     
     typedef csHash<csString, csString> MetadataHash;
@@ -265,6 +279,17 @@ class csXMLShader : public scfImplementationExt4<csXMLShader,
   bool fallbackTried;
   void GetFallbackShader (iShader*& shader, iXMLShaderInternal*& xmlshader);
   
+  /* Guards loading technique variants and the fallback shader when
+     computing tickets. */
+  CS::Threading::RecursiveMutex ticketMutex;
+  /* SVs whose values determine the ticket; tickets are memoized per
+     combination of these SVs. */
+  csArray<CS::ShaderVarStringID> ticketSVs;
+  bool ticketsMemoizable;
+  void SetupTicketMemo ();
+  void PrepareTechVariant (Technique& tech, size_t techNum, size_t vi,
+    size_t ticket, csConditionEvaluator::TicketEvaluator* eval);
+  
   /// Identify whether a ticker refers to the fallback shader
   bool IsFallbackTicket (size_t ticket) const
   { 